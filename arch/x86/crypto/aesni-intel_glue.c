@@ -26,6 +26,7 @@
 #include <crypto/gcm.h>
 #include <crypto/xts.h>
 #include <asm/cpu_device_id.h>
+#include <asm/fpu/api.h>
 #include <asm/simd.h>
 #include <crypto/scatterwalk.h>
 #include <crypto/internal/aead.h>
@@ -184,6 +185,23 @@ asmlinkage void aesni_gcm_finalize_avx_gen4(void *ctx,
 static __ro_after_init DEFINE_STATIC_KEY_FALSE(gcm_use_avx);
 static __ro_after_init DEFINE_STATIC_KEY_FALSE(gcm_use_avx2);
 
+#ifdef CONFIG_AS_VAES
+/*
+ * Bulk XTS over multiples of 8 blocks with 256-bit VAES/VPCLMULQDQ, see
+ * aes-xts-vaes-avx2-x86_64.S.
+ */
+asmlinkage void aes_xts_encrypt_vaes_avx2(const struct crypto_aes_ctx *ctx,
+					  u8 *out, const u8 *in,
+					  unsigned int len, u8 *iv);
+asmlinkage void aes_xts_decrypt_vaes_avx2(const struct crypto_aes_ctx *ctx,
+					  u8 *out, const u8 *in,
+					  unsigned int len, u8 *iv);
+
+#define XTS_VAES_STRIDE	(8 * AES_BLOCK_SIZE)
+
+static __ro_after_init DEFINE_STATIC_KEY_FALSE(xts_use_vaes);
+#endif
+
 static inline struct
 aesni_rfc4106_gcm_ctx *aesni_rfc4106_gcm_ctx_get(struct crypto_aead *tfm)
 {
@@ -836,6 +854,47 @@ static int xts_aesni_setkey(struct crypto_skcipher *tfm, const u8 *key,
 				  key + keylen, keylen);
 }
 
+/*
+ * Encrypt or decrypt @len bytes continuing from tweak @iv.  A partial last
+ * block, and the full block in front of it, always go to the SSE code which
+ * implements ciphertext stealing.
+ */
+static void aesni_xts_crypt(struct aesni_xts_ctx *ctx, u8 *out, const u8 *in,
+			    unsigned int len, u8 *iv, bool encrypt)
+{
+	const struct crypto_aes_ctx *key = aes_ctx(ctx->raw_crypt_ctx);
+
+#ifdef CONFIG_AS_VAES
+	if (static_branch_likely(&xts_use_vaes) && len >= XTS_VAES_STRIDE) {
+		unsigned int tail = len % AES_BLOCK_SIZE;
+		unsigned int bulk = len - tail;
+
+		if (tail)
+			bulk -= AES_BLOCK_SIZE;
+		bulk = round_down(bulk, XTS_VAES_STRIDE);
+
+		if (bulk) {
+			if (encrypt)
+				aes_xts_encrypt_vaes_avx2(key, out, in, bulk,
+							  iv);
+			else
+				aes_xts_decrypt_vaes_avx2(key, out, in, bulk,
+							  iv);
+			out += bulk;
+			in += bulk;
+			len -= bulk;
+			if (!len)
+				return;
+		}
+	}
+#endif
+
+	if (encrypt)
+		aesni_xts_encrypt(key, out, in, len, iv);
+	else
+		aesni_xts_decrypt(key, out, in, len, iv);
+}
+
 static int xts_crypt(struct skcipher_request *req, bool encrypt)
 {
 	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
@@ -878,14 +937,8 @@ static int xts_crypt(struct skcipher_request *req, bool encrypt)
 		if (nbytes < walk.total)
 			nbytes &= ~(AES_BLOCK_SIZE - 1);
 
-		if (encrypt)
-			aesni_xts_encrypt(aes_ctx(ctx->raw_crypt_ctx),
-					  walk.dst.virt.addr, walk.src.virt.addr,
-					  nbytes, walk.iv);
-		else
-			aesni_xts_decrypt(aes_ctx(ctx->raw_crypt_ctx),
-					  walk.dst.virt.addr, walk.src.virt.addr,
-					  nbytes, walk.iv);
+		aesni_xts_crypt(ctx, walk.dst.virt.addr, walk.src.virt.addr,
+				nbytes, walk.iv, encrypt);
 		kernel_fpu_end();
 
 		err = skcipher_walk_done(&walk, walk.nbytes - nbytes);
@@ -910,14 +963,8 @@ static int xts_crypt(struct skcipher_request *req, bool encrypt)
 			return err;
 
 		kernel_fpu_begin();
-		if (encrypt)
-			aesni_xts_encrypt(aes_ctx(ctx->raw_crypt_ctx),
-					  walk.dst.virt.addr, walk.src.virt.addr,
-					  walk.nbytes, walk.iv);
-		else
-			aesni_xts_decrypt(aes_ctx(ctx->raw_crypt_ctx),
-					  walk.dst.virt.addr, walk.src.virt.addr,
-					  walk.nbytes, walk.iv);
+		aesni_xts_crypt(ctx, walk.dst.virt.addr, walk.src.virt.addr,
+				walk.nbytes, walk.iv, encrypt);
 		kernel_fpu_end();
 
 		err = skcipher_walk_done(&walk, 0);
@@ -1158,6 +1205,19 @@ static int __init aesni_init(void)
 		static_call_update(aesni_ctr_enc_tfm, aesni_ctr_enc_avx_tfm);
 		pr_info("AES CTR mode by8 optimization enabled\n");
 	}
+#ifdef CONFIG_AS_VAES
+	/*
+	 * Only 256-bit vectors are used, so this is a win on every CPU with
+	 * VAES, including those that lower their clock for AVX-512.
+	 */
+	if (boot_cpu_has(X86_FEATURE_AVX2) &&
+	    boot_cpu_has(X86_FEATURE_VAES) &&
+	    boot_cpu_has(X86_FEATURE_VPCLMULQDQ) &&
+	    cpu_has_xfeatures(XFEATURE_MASK_SSE | XFEATURE_MASK_YMM, NULL)) {
+		static_branch_enable(&xts_use_vaes);
+		pr_info("AES XTS mode VAES/AVX2 optimization enabled\n");
+	}
+#endif
 #endif
 
 	err = crypto_register_alg(&aesni_cipher_alg);
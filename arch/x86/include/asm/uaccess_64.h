@@ -30,7 +30,8 @@ copy_user_generic(void *to, const void *from, unsigned len)
 	unsigned ret;
 
 	/*
-	 * If CPU has ERMS feature, use copy_user_enhanced_fast_string.
+	 * If CPU has ERMS feature, use copy_user_enhanced_fast_string, which
+	 * also skips its short copy loop when FSRM is set.
 	 * Otherwise, if CPU has rep_good feature, use copy_user_generic_string.
 	 * Otherwise, use copy_user_generic_unrolled.
 	 */
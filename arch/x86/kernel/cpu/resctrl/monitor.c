@@ -412,6 +412,26 @@ void mon_event_count(void *info)
  * throttle MSRs already have low percentage values.  To avoid
  * unnecessarily restricting such rdtgroups, we also increase the bandwidth.
  */
+
+/*
+ * The bandwidth of a group scales roughly linearly with its throttle value,
+ * so when the group is above its target jump straight to the estimated
+ * throttle value instead of taking one bw_gran step per second: a noisy
+ * neighbour would otherwise keep running unrestricted for several seconds.
+ * At least one step is always taken and the hardware minimum is respected.
+ */
+static u32 mba_sc_scale_down(struct rdt_resource *r_mba, u32 cur_msr_val,
+			     u32 cur_bw, u32 user_bw)
+{
+	u32 gran = r_mba->membw.bw_gran;
+	u32 val;
+
+	val = div_u64((u64)cur_msr_val * user_bw, cur_bw);
+	val = min(roundup(val, gran), cur_msr_val - gran);
+
+	return max(val, r_mba->membw.min_bw);
+}
+
 static void update_mba_bw(struct rdtgroup *rgrp, struct rdt_domain *dom_mbm)
 {
 	u32 closid, rmid, cur_msr, cur_msr_val, new_msr_val;
@@ -466,7 +486,8 @@ static void update_mba_bw(struct rdtgroup *rgrp, struct rdt_domain *dom_mbm)
 	 * cur_bw < user_bw.
 	 */
 	if (cur_msr_val > r_mba->membw.min_bw && user_bw < cur_bw) {
-		new_msr_val = cur_msr_val - r_mba->membw.bw_gran;
+		new_msr_val = mba_sc_scale_down(r_mba, cur_msr_val, cur_bw,
+						user_bw);
 	} else if (cur_msr_val < MAX_MBA_BW &&
 		   (user_bw > (cur_bw + delta_bw))) {
 		new_msr_val = cur_msr_val + r_mba->membw.bw_gran;
@@ -487,7 +508,13 @@ static void update_mba_bw(struct rdtgroup *rgrp, struct rdt_domain *dom_mbm)
 	 * says it is linear.(2)Also since MBA is a core specific
 	 * mechanism, the delta values vary based on number of cores used
 	 * by the rdtgrp.
+	 *
+	 * Only single steps are measured, the delta of a larger jump down
+	 * would hold back the following increases for too long.
 	 */
+	if (abs((int)new_msr_val - (int)cur_msr_val) != r_mba->membw.bw_gran)
+		return;
+
 	pmbm_data->delta_comp = true;
 	list_for_each_entry(entry, head, mon.crdtgrp_list) {
 		cmbm_data = &dom_mbm->mbm_local[entry->mon.rmid];
@@ -85,6 +85,18 @@ __MODULE_PARM_TYPE(nx_huge_pages_recovery_ratio, "uint");
 static bool __read_mostly force_flush_and_sync_on_reuse;
 module_param_named(flush_on_reuse, force_flush_and_sync_on_reuse, bool, 0644);
 
+/*
+ * Split huge pages when dirty logging is enabled rather than on the first
+ * write to each of them.  The memslot is processed in chunks of
+ * eager_page_split_chunk_mb, mmu_lock is dropped between chunks; 0 splits
+ * the whole memslot in one go.
+ */
+static bool __read_mostly eager_page_split = true;
+module_param(eager_page_split, bool, 0644);
+
+static uint __read_mostly eager_page_split_chunk_mb = 1024;
+module_param(eager_page_split_chunk_mb, uint, 0644);
+
 /*
  * When setting this variable to true it enables Two-Dimensional-Paging
  * where the hardware walks 2 page tables:
@@ -179,6 +191,39 @@ kvm_mmu_calc_root_page_role(struct kvm_vcpu *vcpu);
 #define CREATE_TRACE_POINTS
 #include "mmutrace.h"
 
+/*
+ * Take mmu_lock, accounting the acquisitions that had to wait in the VM
+ * stats so that contention between vCPU faults and VM-wide operations such
+ * as dirty logging shows up in debugfs.
+ */
+static void kvm_mmu_read_lock(struct kvm *kvm)
+{
+	if (likely(read_trylock(&kvm->mmu_lock)))
+		return;
+
+	read_lock(&kvm->mmu_lock);
+	kvm->stat.mmu_lock_read_contended++;
+}
+
+static void kvm_mmu_write_lock(struct kvm *kvm)
+{
+	if (likely(write_trylock(&kvm->mmu_lock)))
+		return;
+
+	write_lock(&kvm->mmu_lock);
+	kvm->stat.mmu_lock_write_contended++;
+}
+
+/*
+ * Pairs with the release in kvm_mmu_alloc_page().  Shadow pages created
+ * after a memslot operation checked this map the memslot with its new
+ * flags already, because the memslot update waits for SRCU readers first.
+ */
+static inline bool kvm_shadow_mmu_used(struct kvm *kvm)
+{
+	return smp_load_acquire(&kvm->arch.shadow_mmu_used);
+}
+
 
 static inline bool kvm_available_flush_tlb_with_range(void)
 {
@@ -1606,6 +1651,8 @@ static struct kvm_mmu_page *kvm_mmu_alloc_page(struct kvm_vcpu *vcpu, int direct
 	sp->mmu_valid_gen = vcpu->kvm->arch.mmu_valid_gen;
 	list_add(&sp->link, &vcpu->kvm->arch.active_mmu_pages);
 	kvm_mod_used_mmu_pages(vcpu->kvm, +1);
+	if (unlikely(!vcpu->kvm->arch.shadow_mmu_used))
+		smp_store_release(&vcpu->kvm->arch.shadow_mmu_used, true);
 	return sp;
 }
 
@@ -3211,15 +3258,21 @@ static int mmu_alloc_direct_roots(struct kvm_vcpu *vcpu)
 	unsigned i;
 	int r;
 
-	write_lock(&vcpu->kvm->mmu_lock);
+	/* TDP MMU roots are looked up and added under tdp_mmu_pages_lock */
+	if (is_tdp_mmu_enabled(vcpu->kvm)) {
+		kvm_mmu_read_lock(vcpu->kvm);
+		mmu->root_hpa = kvm_tdp_mmu_get_vcpu_root_hpa(vcpu);
+		mmu->root_pgd = 0;
+		read_unlock(&vcpu->kvm->mmu_lock);
+		return 0;
+	}
+
+	kvm_mmu_write_lock(vcpu->kvm);
 	r = make_mmu_pages_available(vcpu);
 	if (r < 0)
 		goto out_unlock;
 
-	if (is_tdp_mmu_enabled(vcpu->kvm)) {
-		root = kvm_tdp_mmu_get_vcpu_root_hpa(vcpu);
-		mmu->root_hpa = root;
-	} else if (shadow_root_level >= PT64_ROOT_4LEVEL) {
+	if (shadow_root_level >= PT64_ROOT_4LEVEL) {
 		root = mmu_alloc_root(vcpu, 0, 0, shadow_root_level, true);
 		mmu->root_hpa = root;
 	} else if (shadow_root_level == PT32E_ROOT_LEVEL) {
@@ -3752,22 +3805,28 @@ static int direct_page_fault(struct kvm_vcpu *vcpu, gpa_t gpa, u32 error_code,
 	r = RET_PF_RETRY;
 
 	if (is_tdp_mmu_root(vcpu->kvm, vcpu->arch.mmu->root_hpa))
-		read_lock(&vcpu->kvm->mmu_lock);
+		kvm_mmu_read_lock(vcpu->kvm);
 	else
-		write_lock(&vcpu->kvm->mmu_lock);
+		kvm_mmu_write_lock(vcpu->kvm);
 
 	if (!is_noslot_pfn(pfn) && mmu_notifier_retry_hva(vcpu->kvm, mmu_seq, hva))
 		goto out_unlock;
-	r = make_mmu_pages_available(vcpu);
-	if (r)
-		goto out_unlock;
 
-	if (is_tdp_mmu_root(vcpu->kvm, vcpu->arch.mmu->root_hpa))
+	/*
+	 * TDP MMU pages are not accounted in n_used_mmu_pages, and reclaiming
+	 * shadow pages would need mmu_lock for write.
+	 */
+	if (is_tdp_mmu_root(vcpu->kvm, vcpu->arch.mmu->root_hpa)) {
 		r = kvm_tdp_mmu_map(vcpu, gpa, error_code, map_writable, max_level,
 				    pfn, prefault);
-	else
+	} else {
+		r = make_mmu_pages_available(vcpu);
+		if (r)
+			goto out_unlock;
+
 		r = __direct_map(vcpu, gpa, error_code, map_writable, max_level, pfn,
 				 prefault, is_tdp);
+	}
 
 out_unlock:
 	if (is_tdp_mmu_root(vcpu->kvm, vcpu->arch.mmu->root_hpa))
@@ -5433,7 +5492,7 @@ static void kvm_mmu_zap_all_fast(struct kvm *kvm)
 {
 	lockdep_assert_held(&kvm->slots_lock);
 
-	write_lock(&kvm->mmu_lock);
+	kvm_mmu_write_lock(kvm);
 	trace_kvm_mmu_zap_all_fast(kvm);
 
 	/*
@@ -5469,7 +5528,7 @@ static void kvm_mmu_zap_all_fast(struct kvm *kvm)
 	write_unlock(&kvm->mmu_lock);
 
 	if (is_tdp_mmu_enabled(kvm)) {
-		read_lock(&kvm->mmu_lock);
+		kvm_mmu_read_lock(kvm);
 		kvm_tdp_mmu_zap_invalidated_roots(kvm);
 		read_unlock(&kvm->mmu_lock);
 	}
@@ -5514,33 +5573,36 @@ void kvm_zap_gfn_range(struct kvm *kvm, gfn_t gfn_start, gfn_t gfn_end)
 	int i;
 	bool flush = false;
 
-	write_lock(&kvm->mmu_lock);
-	for (i = 0; i < KVM_ADDRESS_SPACE_NUM; i++) {
-		slots = __kvm_memslots(kvm, i);
-		kvm_for_each_memslot(memslot, slots) {
-			gfn_t start, end;
+	if (kvm_shadow_mmu_used(kvm)) {
+		kvm_mmu_write_lock(kvm);
+		for (i = 0; i < KVM_ADDRESS_SPACE_NUM; i++) {
+			slots = __kvm_memslots(kvm, i);
+			kvm_for_each_memslot(memslot, slots) {
+				gfn_t start, end;
 
-			start = max(gfn_start, memslot->base_gfn);
-			end = min(gfn_end, memslot->base_gfn + memslot->npages);
-			if (start >= end)
-				continue;
+				start = max(gfn_start, memslot->base_gfn);
+				end = min(gfn_end, memslot->base_gfn + memslot->npages);
+				if (start >= end)
+					continue;
 
-			flush = slot_handle_level_range(kvm, memslot, kvm_zap_rmapp,
-							PG_LEVEL_4K,
-							KVM_MAX_HUGEPAGE_LEVEL,
-							start, end - 1, true, flush);
+				flush = slot_handle_level_range(kvm, memslot,
+						kvm_zap_rmapp, PG_LEVEL_4K,
+						KVM_MAX_HUGEPAGE_LEVEL, start,
+						end - 1, true, flush);
+			}
 		}
-	}
 
-	if (flush)
-		kvm_flush_remote_tlbs_with_address(kvm, gfn_start, gfn_end);
+		if (flush)
+			kvm_flush_remote_tlbs_with_address(kvm, gfn_start,
+							   gfn_end);
 
-	write_unlock(&kvm->mmu_lock);
+		write_unlock(&kvm->mmu_lock);
+	}
 
 	if (is_tdp_mmu_enabled(kvm)) {
 		flush = false;
 
-		read_lock(&kvm->mmu_lock);
+		kvm_mmu_read_lock(kvm);
 		for (i = 0; i < KVM_ADDRESS_SPACE_NUM; i++)
 			flush = kvm_tdp_mmu_zap_gfn_range(kvm, i, gfn_start,
 							  gfn_end, flush, true);
@@ -5563,15 +5625,18 @@ void kvm_mmu_slot_remove_write_access(struct kvm *kvm,
 				      struct kvm_memory_slot *memslot,
 				      int start_level)
 {
-	bool flush;
+	bool flush = false;
 
-	write_lock(&kvm->mmu_lock);
-	flush = slot_handle_level(kvm, memslot, slot_rmap_write_protect,
-				start_level, KVM_MAX_HUGEPAGE_LEVEL, false);
-	write_unlock(&kvm->mmu_lock);
+	if (kvm_shadow_mmu_used(kvm)) {
+		kvm_mmu_write_lock(kvm);
+		flush = slot_handle_level(kvm, memslot, slot_rmap_write_protect,
+					  start_level, KVM_MAX_HUGEPAGE_LEVEL,
+					  false);
+		write_unlock(&kvm->mmu_lock);
+	}
 
 	if (is_tdp_mmu_enabled(kvm)) {
-		read_lock(&kvm->mmu_lock);
+		kvm_mmu_read_lock(kvm);
 		flush |= kvm_tdp_mmu_wrprot_slot(kvm, memslot, start_level);
 		read_unlock(&kvm->mmu_lock);
 	}
@@ -5591,6 +5656,33 @@ void kvm_mmu_slot_remove_write_access(struct kvm *kvm,
 		kvm_arch_flush_remote_tlbs_memslot(kvm, memslot);
 }
 
+void kvm_mmu_slot_try_split_huge_pages(struct kvm *kvm,
+				       const struct kvm_memory_slot *memslot,
+				       int target_level)
+{
+	gfn_t start = memslot->base_gfn;
+	gfn_t end = start + memslot->npages;
+	gfn_t chunk, next;
+
+	/* Only the TDP MMU can split pages outside of a vCPU context. */
+	if (!eager_page_split || !is_tdp_mmu_enabled(kvm))
+		return;
+
+	chunk = (gfn_t)READ_ONCE(eager_page_split_chunk_mb) << (20 - PAGE_SHIFT);
+
+	for (; start < end; start = next) {
+		next = chunk ? min(end, start + chunk) : end;
+
+		kvm_mmu_read_lock(kvm);
+		if (kvm_tdp_mmu_try_split_huge_pages(kvm, memslot, start, next,
+						     target_level))
+			next = end;
+		read_unlock(&kvm->mmu_lock);
+
+		cond_resched();
+	}
+}
+
 static bool kvm_mmu_zap_collapsible_spte(struct kvm *kvm,
 					 struct kvm_rmap_head *rmap_head,
 					 struct kvm_memory_slot *slot)
@@ -5638,17 +5730,20 @@ void kvm_mmu_zap_collapsible_sptes(struct kvm *kvm,
 	struct kvm_memory_slot *slot = (struct kvm_memory_slot *)memslot;
 	bool flush;
 
-	write_lock(&kvm->mmu_lock);
-	flush = slot_handle_leaf(kvm, slot, kvm_mmu_zap_collapsible_spte, true);
+	if (kvm_shadow_mmu_used(kvm)) {
+		kvm_mmu_write_lock(kvm);
+		flush = slot_handle_leaf(kvm, slot, kvm_mmu_zap_collapsible_spte,
+					 true);
 
-	if (flush)
-		kvm_arch_flush_remote_tlbs_memslot(kvm, slot);
-	write_unlock(&kvm->mmu_lock);
+		if (flush)
+			kvm_arch_flush_remote_tlbs_memslot(kvm, slot);
+		write_unlock(&kvm->mmu_lock);
+	}
 
 	if (is_tdp_mmu_enabled(kvm)) {
 		flush = false;
 
-		read_lock(&kvm->mmu_lock);
+		kvm_mmu_read_lock(kvm);
 		flush = kvm_tdp_mmu_zap_collapsible_sptes(kvm, slot, flush);
 		if (flush)
 			kvm_arch_flush_remote_tlbs_memslot(kvm, slot);
@@ -5674,14 +5769,16 @@ void kvm_arch_flush_remote_tlbs_memslot(struct kvm *kvm,
 void kvm_mmu_slot_leaf_clear_dirty(struct kvm *kvm,
 				   struct kvm_memory_slot *memslot)
 {
-	bool flush;
+	bool flush = false;
 
-	write_lock(&kvm->mmu_lock);
-	flush = slot_handle_leaf(kvm, memslot, __rmap_clear_dirty, false);
-	write_unlock(&kvm->mmu_lock);
+	if (kvm_shadow_mmu_used(kvm)) {
+		kvm_mmu_write_lock(kvm);
+		flush = slot_handle_leaf(kvm, memslot, __rmap_clear_dirty, false);
+		write_unlock(&kvm->mmu_lock);
+	}
 
 	if (is_tdp_mmu_enabled(kvm)) {
-		read_lock(&kvm->mmu_lock);
+		kvm_mmu_read_lock(kvm);
 		flush |= kvm_tdp_mmu_clear_dirty_slot(kvm, memslot);
 		read_unlock(&kvm->mmu_lock);
 	}
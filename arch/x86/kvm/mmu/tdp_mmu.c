@@ -194,10 +194,18 @@ hpa_t kvm_tdp_mmu_get_vcpu_root_hpa(struct kvm_vcpu *vcpu)
 	struct kvm *kvm = vcpu->kvm;
 	struct kvm_mmu_page *root;
 
-	lockdep_assert_held_write(&kvm->mmu_lock);
+	lockdep_assert_held_read(&kvm->mmu_lock);
 
 	role = page_role_for_level(vcpu, vcpu->arch.mmu->shadow_root_level);
 
+	/*
+	 * vCPUs can get here in parallel, do the lookup and the insertion
+	 * under tdp_mmu_pages_lock so that only one of them adds a root for
+	 * a given role.  Roots are invalidated with mmu_lock held for write,
+	 * so their role cannot change while we look at it.
+	 */
+	spin_lock(&kvm->arch.tdp_mmu_pages_lock);
+
 	/* Check for an existing root before allocating a new one. */
 	for_each_tdp_mmu_root(kvm, root, kvm_mmu_role_as_id(role)) {
 		if (root->role.word == role.word &&
@@ -207,12 +215,10 @@ hpa_t kvm_tdp_mmu_get_vcpu_root_hpa(struct kvm_vcpu *vcpu)
 
 	root = alloc_tdp_mmu_page(vcpu, 0, vcpu->arch.mmu->shadow_root_level);
 	refcount_set(&root->tdp_mmu_root_count, 1);
-
-	spin_lock(&kvm->arch.tdp_mmu_pages_lock);
 	list_add_rcu(&root->link, &kvm->arch.tdp_mmu_roots);
-	spin_unlock(&kvm->arch.tdp_mmu_pages_lock);
 
 out:
+	spin_unlock(&kvm->arch.tdp_mmu_pages_lock);
 	return __pa(root->spt);
 }
 
@@ -1256,6 +1262,160 @@ bool kvm_tdp_mmu_wrprot_slot(struct kvm *kvm, struct kvm_memory_slot *slot,
 	return spte_set;
 }
 
+static struct kvm_mmu_page *__tdp_mmu_alloc_sp_for_split(gfp_t gfp)
+{
+	struct kvm_mmu_page *sp;
+
+	gfp |= __GFP_ZERO;
+
+	sp = kmem_cache_alloc(mmu_page_header_cache, gfp);
+	if (!sp)
+		return NULL;
+
+	sp->spt = (void *)__get_free_page(gfp);
+	if (!sp->spt) {
+		kmem_cache_free(mmu_page_header_cache, sp);
+		return NULL;
+	}
+	set_page_private(virt_to_page(sp->spt), (unsigned long)sp);
+
+	return sp;
+}
+
+/*
+ * Replace the huge SPTE at @iter with a pointer to @sp, filled with SPTEs
+ * mapping the same memory one level down.  vCPUs may see a mix of the huge
+ * and the split mappings depending on what they have in their TLBs, which is
+ * fine since the translation is the same either way.
+ *
+ * Returns false if the SPTE changed under us, in which case @sp was not used.
+ */
+static bool tdp_mmu_split_huge_page(struct kvm *kvm, struct tdp_iter *iter,
+				    struct kvm_mmu_page *sp)
+{
+	struct kvm_mmu_page *parent_sp = sptep_to_sp(rcu_dereference(iter->sptep));
+	const u64 huge_spte = iter->old_spte;
+	const int level = iter->level;
+	u64 new_spte;
+	int i;
+
+	sp->role.word = parent_sp->role.word;
+	sp->role.level = level - 1;
+	sp->gfn = iter->gfn;
+	sp->tdp_mmu_page = true;
+
+	/* The page table is not reachable yet, no need for atomics. */
+	for (i = 0; i < PT64_ENT_PER_PAGE; i++)
+		sp->spt[i] = make_huge_page_split_spte(huge_spte, level, i);
+
+	new_spte = make_nonleaf_spte(sp->spt, !shadow_accessed_mask);
+	if (!tdp_mmu_set_spte_atomic_no_dirty_log(kvm, iter, new_spte))
+		return false;
+
+	tdp_mmu_link_page(kvm, sp, true, false);
+
+	/* Only the huge SPTE being replaced went through the accounting. */
+	if (level - 1 > PG_LEVEL_4K)
+		atomic64_add(PT64_ENT_PER_PAGE, (atomic64_t *)&kvm->stat.lpages);
+
+	trace_kvm_mmu_get_page(sp, true);
+	return true;
+}
+
+static int tdp_mmu_split_huge_pages_root(struct kvm *kvm,
+					 struct kvm_mmu_page *root,
+					 gfn_t start, gfn_t end,
+					 int target_level)
+{
+	struct kvm_mmu_page *sp = NULL;
+	struct tdp_iter iter;
+	int ret = 0;
+
+	rcu_read_lock();
+
+	/*
+	 * The walk is top-down, a 1G page is first split into 2M pages which
+	 * are then split to 4K as the iterator steps down into them.
+	 */
+	for_each_tdp_pte_min_level(iter, root->spt, root->role.level,
+				   target_level + 1, start, end) {
+retry:
+		if (tdp_mmu_iter_cond_resched(kvm, &iter, false, true))
+			continue;
+
+		if (!is_shadow_present_pte(iter.old_spte) ||
+		    !is_large_pte(iter.old_spte))
+			continue;
+
+		if (!sp) {
+			sp = __tdp_mmu_alloc_sp_for_split(GFP_NOWAIT |
+							  __GFP_ACCOUNT);
+			if (!sp) {
+				/* Drop the locks to allow direct reclaim. */
+				rcu_read_unlock();
+				read_unlock(&kvm->mmu_lock);
+
+				sp = __tdp_mmu_alloc_sp_for_split(GFP_KERNEL_ACCOUNT);
+
+				read_lock(&kvm->mmu_lock);
+				rcu_read_lock();
+
+				if (!sp) {
+					ret = -ENOMEM;
+					break;
+				}
+
+				tdp_iter_restart(&iter);
+				continue;
+			}
+		}
+
+		if (!tdp_mmu_split_huge_page(kvm, &iter, sp)) {
+			/*
+			 * The iter must explicitly re-read the SPTE because
+			 * the atomic cmpxchg failed.
+			 */
+			iter.old_spte = READ_ONCE(*rcu_dereference(iter.sptep));
+			goto retry;
+		}
+		sp = NULL;
+	}
+
+	rcu_read_unlock();
+
+	if (sp)
+		tdp_mmu_free_sp(sp);
+
+	return ret;
+}
+
+/*
+ * Split all huge pages mapping GFNs in [start, end) of the memslot down to
+ * target_level, with mmu_lock held for read so that vCPUs keep faulting in
+ * parallel.  Returns -ENOMEM if a page table could not be allocated, the
+ * remaining huge pages are then split on their first write as usual.
+ */
+int kvm_tdp_mmu_try_split_huge_pages(struct kvm *kvm,
+				     const struct kvm_memory_slot *slot,
+				     gfn_t start, gfn_t end, int target_level)
+{
+	struct kvm_mmu_page *root;
+	int r = 0;
+
+	lockdep_assert_held_read(&kvm->mmu_lock);
+
+	for_each_tdp_mmu_root_yield_safe(kvm, root, slot->as_id, true) {
+		r = tdp_mmu_split_huge_pages_root(kvm, root, start, end,
+						  target_level);
+		if (r) {
+			kvm_tdp_mmu_put_root(kvm, root, true);
+			break;
+		}
+	}
+
+	return r;
+}
+
 /*
  * Clear the dirty status of all the SPTEs mapping GFNs in the memslot. If
  * AD bits are enabled, this will involve clearing the dirty bit on each SPTE.
@@ -257,6 +257,8 @@ struct kvm_stats_debugfs_item debugfs_entries[] = {
 	VM_STAT("largepages", lpages, .mode = 0444),
 	VM_STAT("nx_largepages_splitted", nx_lpage_splits, .mode = 0444),
 	VM_STAT("max_mmu_page_hash_collisions", max_mmu_page_hash_collisions),
+	VM_STAT("mmu_lock_read_contended", mmu_lock_read_contended),
+	VM_STAT("mmu_lock_write_contended", mmu_lock_write_contended),
 	{ NULL }
 };
 
@@ -11106,6 +11108,18 @@ static void kvm_mmu_slot_apply_flags(struct kvm *kvm,
 		/* By default, write-protect everything to log writes. */
 		int level = PG_LEVEL_4K;
 
+		/*
+		 * Split huge pages upfront so that the guest does not take a
+		 * write fault on each of them.  This must happen before dirty
+		 * bits are cleared and SPTEs are write-protected below, as
+		 * the new 4K SPTEs inherit the huge page's bits.  With
+		 * initial-all-set small pages are not write-protected until
+		 * the dirty log is first cleared, so leave those to be split
+		 * lazily.
+		 */
+		if (!kvm_dirty_log_manual_protect_and_init_set(kvm))
+			kvm_mmu_slot_try_split_huge_pages(kvm, new, PG_LEVEL_4K);
+
 		if (kvm_x86_ops.cpu_dirty_log_size) {
 			/*
 			 * Clear all dirty bits, unless pages are treated as
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * T10 DIF CRC16 library routine accelerated with PCLMULQDQ.
+ *
+ * The folding kernel is shared with the "crct10dif-pclmul" crypto driver,
+ * but lib/crc-t10dif.c calls it directly instead of going through a
+ * crypto_shash.
+ */
+
+#include <linux/crc-t10dif.h>
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/module.h>
+#include <crypto/internal/simd.h>
+#include <asm/cpufeatures.h>
+#include <asm/simd.h>
+
+/* Below this, saving and restoring the FPU state costs more than it gains */
+#define CRC_T10DIF_PCL_MIN_LEN	16
+
+asmlinkage u16 crc_t10dif_pcl(u16 init_crc, const u8 *buf, size_t len);
+
+static DEFINE_STATIC_KEY_FALSE(have_pclmulqdq);
+
+u16 crc_t10dif_arch(u16 crc, const u8 *p, size_t len)
+{
+	if (len >= CRC_T10DIF_PCL_MIN_LEN &&
+	    static_branch_likely(&have_pclmulqdq) && crypto_simd_usable()) {
+		kernel_fpu_begin();
+		crc = crc_t10dif_pcl(crc, p, len);
+		kernel_fpu_end();
+		return crc;
+	}
+
+	return crc_t10dif_generic(crc, p, len);
+}
+EXPORT_SYMBOL(crc_t10dif_arch);
+
+bool crc_t10dif_arch_optimized(void)
+{
+	return static_key_enabled(&have_pclmulqdq);
+}
+EXPORT_SYMBOL(crc_t10dif_arch_optimized);
+
+static int __init crc_t10dif_x86_init(void)
+{
+	if (boot_cpu_has(X86_FEATURE_PCLMULQDQ))
+		static_branch_enable(&have_pclmulqdq);
+	return 0;
+}
+arch_initcall(crc_t10dif_x86_init);
+
+static void __exit crc_t10dif_x86_exit(void)
+{
+}
+module_exit(crc_t10dif_x86_exit);
+
+MODULE_DESCRIPTION("T10 DIF CRC calculation using PCLMULQDQ (library API)");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * CRC32C library routine using the SSE4.2 CRC32 instruction, and on 64-bit
+ * the three-way interleaved PCLMULQDQ variant for large buffers.
+ *
+ * The same code backs the "crc32c-intel" crypto driver; lib/libcrc32c.c
+ * calls it directly instead of going through a crypto_shash.
+ */
+
+#include <linux/crc32.h>
+#include <linux/crc32c.h>
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/module.h>
+#include <crypto/internal/simd.h>
+#include <asm/cpufeatures.h>
+#include <asm/simd.h>
+
+#define SCALE_F	sizeof(unsigned long)
+
+#ifdef CONFIG_X86_64
+#define CRC32_INST "crc32q %1, %q0"
+#else
+#define CRC32_INST "crc32l %1, %0"
+#endif
+
+#ifdef CONFIG_X86_64
+/*
+ * use carryless multiply version of crc32c when buffer
+ * size is >= 512 to account
+ * for fpu state save/restore overhead.
+ */
+#define CRC32C_PCL_BREAKEVEN	512
+
+asmlinkage unsigned int crc_pcl(const u8 *buffer, int len,
+				unsigned int crc_init);
+#endif /* CONFIG_X86_64 */
+
+static DEFINE_STATIC_KEY_FALSE(have_crc32);
+static DEFINE_STATIC_KEY_FALSE(have_pclmulqdq);
+
+static u32 crc32c_intel_le_hw_byte(u32 crc, unsigned char const *data, size_t length)
+{
+	while (length--) {
+		asm("crc32b %1, %0"
+		    : "+r" (crc) : "rm" (*data));
+		data++;
+	}
+
+	return crc;
+}
+
+static u32 __pure crc32c_intel_le_hw(u32 crc, unsigned char const *p, size_t len)
+{
+	unsigned int iquotient = len / SCALE_F;
+	unsigned int iremainder = len % SCALE_F;
+	unsigned long *ptmp = (unsigned long *)p;
+
+	while (iquotient--) {
+		asm(CRC32_INST
+		    : "+r" (crc) : "rm" (*ptmp));
+		ptmp++;
+	}
+
+	if (iremainder)
+		crc = crc32c_intel_le_hw_byte(crc, (unsigned char *)ptmp,
+				 iremainder);
+
+	return crc;
+}
+
+u32 crc32c_arch(u32 crc, const void *address, unsigned int length)
+{
+	if (!static_branch_likely(&have_crc32))
+		return __crc32c_le(crc, address, length);
+
+#ifdef CONFIG_X86_64
+	/*
+	 * use faster PCL version if datasize is large enough to
+	 * overcome kernel fpu state save/restore overhead
+	 */
+	if (length >= CRC32C_PCL_BREAKEVEN &&
+	    static_branch_likely(&have_pclmulqdq) && crypto_simd_usable()) {
+		kernel_fpu_begin();
+		crc = crc_pcl(address, length, crc);
+		kernel_fpu_end();
+		return crc;
+	}
+#endif
+
+	return crc32c_intel_le_hw(crc, address, length);
+}
+EXPORT_SYMBOL(crc32c_arch);
+
+const char *crc32c_arch_impl(void)
+{
+	if (static_key_enabled(&have_pclmulqdq))
+		return "crc32c-pcl-intel";
+	if (static_key_enabled(&have_crc32))
+		return "crc32c-intel";
+	return NULL;
+}
+EXPORT_SYMBOL(crc32c_arch_impl);
+
+static int __init crc32c_x86_init(void)
+{
+	if (!boot_cpu_has(X86_FEATURE_XMM4_2))
+		return 0;
+
+	static_branch_enable(&have_crc32);
+	if (IS_ENABLED(CONFIG_X86_64) && boot_cpu_has(X86_FEATURE_PCLMULQDQ))
+		static_branch_enable(&have_pclmulqdq);
+	return 0;
+}
+arch_initcall(crc32c_x86_init);
+
+static void __exit crc32c_x86_exit(void)
+{
+}
+module_exit(crc32c_x86_exit);
+
+MODULE_DESCRIPTION("CRC32c (Castagnoli) calculation using SSE4.2 (library API)");
+MODULE_LICENSE("GPL");
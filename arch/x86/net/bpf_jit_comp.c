@@ -955,6 +955,18 @@ static int do_jit(struct bpf_prog *bpf_prog, int *addrs, u8 *image,
 			break;
 
 		case BPF_ALU64 | BPF_MOV | BPF_X:
+			if (insn_is_mov_percpu_addr(insn)) {
+				/* mov dst, src */
+				emit_mov_reg(&prog, true, dst_reg, src_reg);
+#ifdef CONFIG_SMP
+				/* add dst, gs:[this_cpu_off] */
+				EMIT2(0x65, add_2mod(0x48, 0, dst_reg));
+				EMIT3(0x03, add_2reg(0x04, 0, dst_reg), 0x25);
+				EMIT((u32)(unsigned long)&this_cpu_off, 4);
+#endif
+				break;
+			}
+			fallthrough;
 		case BPF_ALU | BPF_MOV | BPF_X:
 			emit_mov_reg(&prog,
 				     BPF_CLASS(insn->code) == BPF_ALU64,
@@ -2360,3 +2372,8 @@ bool bpf_jit_supports_kfunc_call(void)
 {
 	return true;
 }
+
+bool bpf_jit_supports_percpu_insn(void)
+{
+	return true;
+}
@@ -184,6 +184,7 @@
 #include "blk-rq-qos.h"
 #include "blk-stat.h"
 #include "blk-wbt.h"
+#include "blk-mq-debugfs.h"
 
 #ifdef CONFIG_TRACEPOINTS
 
@@ -297,6 +298,17 @@ enum {
 	/* switch iff the conditions are met for longer than this */
 	AUTOP_CYCLE_NSEC	= 10LLU * NSEC_PER_SEC,
 
+	/*
+	 * Cost model calibration folds the vrate back into the model once
+	 * it stayed within CALIB_STABLE_BP of its average for
+	 * CALIB_STABLE_PERIODS saturated periods and that average is more
+	 * than CALIB_MIN_ADJ_BP away from 100%.  Rates are in basis points.
+	 */
+	CALIB_ONE_BP		= 10000,
+	CALIB_STABLE_BP		= 500,
+	CALIB_MIN_ADJ_BP	= 1000,
+	CALIB_STABLE_PERIODS	= 64,
+
 	/*
 	 * Count IO size in 4k pages.  The 12bit shift helps keeping
 	 * size-proportional components of cost calculation in closer
@@ -391,6 +403,15 @@ struct ioc_missed {
 	u32				last_missed;
 };
 
+/* online cost model calibration state, see ioc_calibrate() */
+struct ioc_calib {
+	u64				vrate_avg_bp;
+	u64				last_scale_bp;
+	u32				nr_samples;
+	u32				nr_stable;
+	u32				nr_updates;
+};
+
 struct ioc_pcpu_stat {
 	struct ioc_missed		missed[2];
 
@@ -441,6 +462,9 @@ struct ioc {
 	int				autop_idx;
 	bool				user_qos_params:1;
 	bool				user_cost_model:1;
+	bool				calib_cost_model:1;
+
+	struct ioc_calib		calib;
 };
 
 struct iocg_pcpu_stat {
@@ -1019,6 +1043,63 @@ static void ioc_adjust_base_vrate(struct ioc *ioc, u32 rq_wait_pct,
 	ioc_refresh_margins(ioc);
 }
 
+/*
+ * In calibration mode, the vrate tells how far the cost model is off: when
+ * the device is saturated, the vrate controller settles on the rate at
+ * which the QoS targets are just met, so a settled vrate of 150% means the
+ * device does 1.5 times what the model says.  Once the vrate has settled,
+ * scale the model accordingly and the vrate back down, which leaves the
+ * actual issue rate unchanged but keeps the model usable across vrate
+ * resets and makes the coefficients reflect the device.
+ */
+static void ioc_calibrate(struct ioc *ioc, int nr_shortages)
+{
+	struct ioc_calib *calib = &ioc->calib;
+	u64 *u = ioc->params.i_lcoefs;
+	u64 vrate_bp, scale;
+	int i;
+
+	lockdep_assert_held(&ioc->lock);
+
+	/* only saturated periods say anything about the device */
+	if (!ioc->calib_cost_model || (!nr_shortages && ioc->busy_level <= 0))
+		return;
+
+	vrate_bp = div64_u64(ioc->vtime_base_rate * CALIB_ONE_BP,
+			     VTIME_PER_USEC);
+	if (!calib->nr_samples++)
+		calib->vrate_avg_bp = vrate_bp;
+	else
+		calib->vrate_avg_bp = (calib->vrate_avg_bp * 7 + vrate_bp) / 8;
+
+	if (abs((s64)vrate_bp - (s64)calib->vrate_avg_bp) >
+	    div64_u64(calib->vrate_avg_bp * CALIB_STABLE_BP, CALIB_ONE_BP)) {
+		calib->nr_stable = 0;
+		return;
+	}
+	if (++calib->nr_stable < CALIB_STABLE_PERIODS)
+		return;
+
+	calib->nr_stable = 0;
+	scale = calib->vrate_avg_bp;
+	if (abs((s64)scale - CALIB_ONE_BP) < CALIB_MIN_ADJ_BP)
+		return;
+
+	for (i = 0; i < NR_I_LCOEFS; i++)
+		if (u[i])
+			u[i] = max_t(u64, div64_u64(u[i] * scale, CALIB_ONE_BP), 1);
+	ioc_refresh_lcoefs(ioc);
+
+	ioc->vtime_base_rate = div64_u64(ioc->vtime_base_rate * CALIB_ONE_BP,
+					 scale);
+	atomic64_set(&ioc->vtime_rate, ioc->vtime_base_rate);
+	ioc_refresh_margins(ioc);
+
+	calib->vrate_avg_bp = CALIB_ONE_BP;
+	calib->last_scale_bp = scale;
+	calib->nr_updates++;
+}
+
 /* take a snapshot of the current [v]time and vrate */
 static void ioc_now(struct ioc *ioc, struct ioc_now *now)
 {
@@ -2387,6 +2468,8 @@ static void ioc_timer_fn(struct timer_list *timer)
 	ioc_adjust_base_vrate(ioc, rq_wait_pct, nr_lagging, nr_shortages,
 			      prev_busy_level, missed_ppm);
 
+	ioc_calibrate(ioc, nr_shortages);
+
 	ioc_refresh_params(ioc, false);
 
 	ioc_forgive_debts(ioc, usage_us_sum, nr_debtors, &now);
@@ -2812,6 +2895,30 @@ static void ioc_rqos_exit(struct rq_qos *rqos)
 	kfree(ioc);
 }
 
+#ifdef CONFIG_BLK_DEBUG_FS
+static int ioc_calib_show(void *data, struct seq_file *m)
+{
+	struct ioc *ioc = rqos_to_ioc(data);
+	struct ioc_calib *calib = &ioc->calib;
+
+	spin_lock_irq(&ioc->lock);
+	seq_printf(m, "enabled=%d samples=%u stable=%u/%u vrate_avg=%llu.%02llu%%\n",
+		   ioc->calib_cost_model, calib->nr_samples, calib->nr_stable,
+		   CALIB_STABLE_PERIODS, calib->vrate_avg_bp / 100,
+		   calib->vrate_avg_bp % 100);
+	seq_printf(m, "updates=%u last_scale=%llu.%02llu%%\n",
+		   calib->nr_updates, calib->last_scale_bp / 100,
+		   calib->last_scale_bp % 100);
+	spin_unlock_irq(&ioc->lock);
+	return 0;
+}
+
+static const struct blk_mq_debugfs_attr ioc_debugfs_attrs[] = {
+	{"calib", 0400, ioc_calib_show},
+	{},
+};
+#endif
+
 static struct rq_qos_ops ioc_rqos_ops = {
 	.throttle = ioc_rqos_throttle,
 	.merge = ioc_rqos_merge,
@@ -2819,6 +2926,9 @@ static struct rq_qos_ops ioc_rqos_ops = {
 	.done = ioc_rqos_done,
 	.queue_depth_changed = ioc_rqos_queue_depth_changed,
 	.exit = ioc_rqos_exit,
+#ifdef CONFIG_BLK_DEBUG_FS
+	.debugfs_attrs = ioc_debugfs_attrs,
+#endif
 };
 
 static int blk_iocost_init(struct request_queue *q)
@@ -3291,7 +3401,8 @@ static u64 ioc_cost_model_prfill(struct seq_file *sf,
 	seq_printf(sf, "%s ctrl=%s model=linear "
 		   "rbps=%llu rseqiops=%llu rrandiops=%llu "
 		   "wbps=%llu wseqiops=%llu wrandiops=%llu\n",
-		   dname, ioc->user_cost_model ? "user" : "auto",
+		   dname, ioc->calib_cost_model ? "calibrate" :
+		   ioc->user_cost_model ? "user" : "auto",
 		   u[I_LCOEF_RBPS], u[I_LCOEF_RSEQIOPS], u[I_LCOEF_RRANDIOPS],
 		   u[I_LCOEF_WBPS], u[I_LCOEF_WSEQIOPS], u[I_LCOEF_WRANDIOPS]);
 	return 0;
@@ -3328,7 +3439,7 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	struct block_device *bdev;
 	struct ioc *ioc;
 	u64 u[NR_I_LCOEFS];
-	bool user;
+	bool user, calib;
 	char *p;
 	int ret;
 
@@ -3347,6 +3458,7 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	spin_lock_irq(&ioc->lock);
 	memcpy(u, ioc->params.i_lcoefs, sizeof(u));
 	user = ioc->user_cost_model;
+	calib = ioc->calib_cost_model;
 	spin_unlock_irq(&ioc->lock);
 
 	while ((p = strsep(&input, " \t\n"))) {
@@ -3362,9 +3474,11 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 		case COST_CTRL:
 			match_strlcpy(buf, &args[0], sizeof(buf));
 			if (!strcmp(buf, "auto"))
-				user = false;
+				user = calib = false;
 			else if (!strcmp(buf, "user"))
-				user = true;
+				user = true, calib = false;
+			else if (!strcmp(buf, "calibrate"))
+				user = calib = true;
 			else
 				goto einval;
 			continue;
@@ -3391,6 +3505,9 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	} else {
 		ioc->user_cost_model = false;
 	}
+	/* calibration starts over from the model that was just set */
+	memset(&ioc->calib, 0, sizeof(ioc->calib));
+	ioc->calib_cost_model = calib;
 	ioc_refresh_params(ioc, true);
 	spin_unlock_irq(&ioc->lock);
 
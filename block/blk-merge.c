@@ -1147,3 +1147,32 @@ bool blk_mq_sched_try_merge(struct request_queue *q, struct bio *bio,
 	}
 }
 EXPORT_SYMBOL_GPL(blk_mq_sched_try_merge);
+
+/**
+ * blk_mq_sched_try_rq_merge - try to merge @bio into a given request
+ * @q: request_queue @rq is queued on
+ * @rq: merge candidate picked by the I/O scheduler
+ * @bio: new bio being queued
+ * @nr_segs: number of segments in @bio
+ *
+ * For schedulers that keep their own merge lookup structures instead of the
+ * elevator hash.  Neither the elevator hash nor the scheduler's merge
+ * callbacks are updated, the caller has to fix up its own data structures
+ * for the returned merge type.  Returns %ELEVATOR_NO_MERGE if @bio was not
+ * merged.
+ */
+enum elv_merge blk_mq_sched_try_rq_merge(struct request_queue *q,
+		struct request *rq, struct bio *bio, unsigned int nr_segs)
+{
+	enum elv_merge type;
+
+	if (!blk_rq_merge_ok(rq, bio))
+		return ELEVATOR_NO_MERGE;
+
+	type = blk_try_merge(rq, bio);
+	if (type == ELEVATOR_NO_MERGE ||
+	    blk_attempt_bio_merge(q, rq, bio, nr_segs, true) != BIO_MERGE_OK)
+		return ELEVATOR_NO_MERGE;
+	return type;
+}
+EXPORT_SYMBOL_GPL(blk_mq_sched_try_rq_merge);
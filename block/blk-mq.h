@@ -154,6 +154,10 @@ struct blk_mq_alloc_data {
 	unsigned int shallow_depth;
 	unsigned int cmd_flags;
 
+	/* allocate this many requests, the extra ones go to @cached_rq */
+	unsigned int nr_tags;
+	struct list_head *cached_rq;
+
 	/* input & output parameter */
 	struct blk_mq_ctx *ctx;
 	struct blk_mq_hw_ctx *hctx;
@@ -164,6 +168,8 @@ static inline bool blk_mq_is_sbitmap_shared(unsigned int flags)
 	return flags & BLK_MQ_F_TAG_HCTX_SHARED;
 }
 
+void blk_mq_free_plug_rqs(struct blk_plug *plug);
+
 static inline struct blk_mq_tags *blk_mq_tags_from_data(struct blk_mq_alloc_data *data)
 {
 	if (data->q->elevator)
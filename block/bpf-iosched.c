@@ -0,0 +1,508 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * I/O scheduler whose dispatch policy is implemented by a BPF program
+ * through struct bpf_iosched_ops.
+ *
+ * Requests are kept on BPF_IOSCHED_NR_QUEUES FIFOs per request queue.  On
+ * insertion the BPF policy picks the FIFO a request goes to and on
+ * dispatch the FIFO the next request is taken from, so that policies such
+ * as per cgroup deadlines or token buckets can be built on BPF maps and
+ * replaced without rebuilding the kernel.
+ *
+ * Any misbehaviour of the policy disables it, after which the scheduler
+ * drains the FIFOs lowest number first and queues new requests on FIFO 0.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/bpf.h>
+#include <linux/bpf_verifier.h>
+#include <linux/bpf-iosched.h>
+#include <linux/btf.h>
+#include <linux/elevator.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+
+#include <trace/events/block.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+#include "blk-mq-sched.h"
+
+enum bpf_iosched_state {
+	BPF_IOSCHED_DISABLED,
+	BPF_IOSCHED_ENABLED,
+	BPF_IOSCHED_DISABLING,
+};
+
+static DEFINE_MUTEX(bpf_iosched_mutex);
+static int bpf_iosched_state = BPF_IOSCHED_DISABLED;
+static struct bpf_iosched_ops bpf_iosched_ops;
+static struct bpf_iosched_ops *bpf_iosched_kdata;
+/* Bumped on every load, tells requests queued by an older policy apart */
+static unsigned long bpf_iosched_gen;
+
+static atomic_t bpf_iosched_error = ATOMIC_INIT(0);
+static char bpf_iosched_error_msg[128];
+
+static void bpf_iosched_disable(struct bpf_iosched_ops *ops);
+
+static void bpf_iosched_disable_workfn(struct work_struct *work)
+{
+	bpf_iosched_disable(NULL);
+}
+static DECLARE_WORK(bpf_iosched_disable_work, bpf_iosched_disable_workfn);
+
+/*
+ * Record the first error of the BPF policy and disable it.  Called with
+ * the scheduler lock held, so the disabling is punted to a work item.
+ */
+static __printf(1, 2) void bpf_iosched_err(const char *fmt, ...)
+{
+	va_list args;
+
+	if (atomic_cmpxchg(&bpf_iosched_error, 0, 1))
+		return;
+
+	va_start(args, fmt);
+	vscnprintf(bpf_iosched_error_msg, sizeof(bpf_iosched_error_msg),
+		   fmt, args);
+	va_end(args);
+
+	schedule_work(&bpf_iosched_disable_work);
+}
+
+/* Callers hold rcu_read_lock(), which the unloading waits for */
+static inline bool bpf_iosched_live(void)
+{
+	return smp_load_acquire(&bpf_iosched_state) == BPF_IOSCHED_ENABLED &&
+		!atomic_read(&bpf_iosched_error);
+}
+
+#define BPF_IOSCHED_HAS_OP(op)	(bpf_iosched_live() && bpf_iosched_ops.op)
+
+/*
+ * rq->elv.priv[0] is the FIFO number plus one the request was queued on,
+ * rq->elv.priv[1] the generation of the policy that saw the insertion.
+ */
+static inline u32 bpf_iosched_rq_queue(struct request *rq)
+{
+	return (uintptr_t)rq->elv.priv[0] - 1;
+}
+
+struct bpf_iosched_data {
+	spinlock_t lock;
+	struct list_head fifo[BPF_IOSCHED_NR_QUEUES];
+	/* bit N is set while fifo[N] is not empty */
+	u32 nonempty;
+};
+
+static u32 bpf_iosched_pick_queue(struct request *rq, bool at_head)
+{
+	u32 queue = 0;
+	s32 ret;
+
+	rcu_read_lock();
+	if (BPF_IOSCHED_HAS_OP(insert_request)) {
+		ret = bpf_iosched_ops.insert_request(rq,
+				at_head ? BPF_IOSCHED_INSERT_HEAD : 0);
+		rq->elv.priv[1] = (void *)READ_ONCE(bpf_iosched_gen);
+		if (ret >= 0 && ret < BPF_IOSCHED_NR_QUEUES)
+			queue = ret;
+		else
+			bpf_iosched_err("invalid queue %d for inserted request",
+					ret);
+	}
+	rcu_read_unlock();
+
+	return queue;
+}
+
+static void bpf_iosched_insert_request(struct request_queue *q,
+				       struct request *rq, bool at_head)
+{
+	struct bpf_iosched_data *bd = q->elevator->elevator_data;
+	u32 queue;
+
+	trace_block_rq_insert(rq);
+
+	queue = bpf_iosched_pick_queue(rq, at_head);
+	rq->elv.priv[0] = (void *)(uintptr_t)(queue + 1);
+
+	if (at_head)
+		list_add(&rq->queuelist, &bd->fifo[queue]);
+	else
+		list_add_tail(&rq->queuelist, &bd->fifo[queue]);
+	bd->nonempty |= BIT(queue);
+
+	if (rq_mergeable(rq)) {
+		elv_rqhash_add(q, rq);
+		if (!q->last_merge)
+			q->last_merge = rq;
+	}
+}
+
+static void bpf_iosched_insert_requests(struct blk_mq_hw_ctx *hctx,
+					struct list_head *list, bool at_head)
+{
+	struct request_queue *q = hctx->queue;
+	struct bpf_iosched_data *bd = q->elevator->elevator_data;
+
+	spin_lock(&bd->lock);
+	while (!list_empty(list)) {
+		struct request *rq;
+
+		rq = list_first_entry(list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+		bpf_iosched_insert_request(q, rq, at_head);
+	}
+	spin_unlock(&bd->lock);
+}
+
+/* Returns the FIFO to dispatch from, or BPF_IOSCHED_DEFER */
+static s32 bpf_iosched_pick_dispatch(struct request_queue *q, u32 nonempty)
+{
+	s32 queue = __ffs(nonempty);
+	s32 ret;
+
+	rcu_read_lock();
+	if (BPF_IOSCHED_HAS_OP(dispatch_request)) {
+		ret = bpf_iosched_ops.dispatch_request(q, nonempty);
+		if (ret == BPF_IOSCHED_DEFER ||
+		    (ret >= 0 && ret < BPF_IOSCHED_NR_QUEUES &&
+		     (nonempty & BIT(ret))))
+			queue = ret;
+		else
+			bpf_iosched_err("invalid queue %d to dispatch from, nonempty %#x",
+					ret, nonempty);
+	}
+	rcu_read_unlock();
+
+	return queue;
+}
+
+static struct request *bpf_iosched_dispatch_request(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	struct bpf_iosched_data *bd = q->elevator->elevator_data;
+	struct request *rq = NULL;
+	s32 queue;
+
+	spin_lock(&bd->lock);
+	if (!bd->nonempty)
+		goto unlock;
+
+	/*
+	 * Returning no request while there is work makes blk-mq run the
+	 * hardware queue again after a short delay.
+	 */
+	queue = bpf_iosched_pick_dispatch(q, bd->nonempty);
+	if (queue == BPF_IOSCHED_DEFER)
+		goto unlock;
+
+	rq = list_first_entry(&bd->fifo[queue], struct request, queuelist);
+	list_del_init(&rq->queuelist);
+	if (list_empty(&bd->fifo[queue]))
+		bd->nonempty &= ~BIT(queue);
+
+	elv_rqhash_del(q, rq);
+	if (q->last_merge == rq)
+		q->last_merge = NULL;
+
+	rq->rq_flags |= RQF_STARTED;
+unlock:
+	spin_unlock(&bd->lock);
+
+	return rq;
+}
+
+/* Called with bd->lock held from bpf_iosched_bio_merge() */
+static void bpf_iosched_merged_requests(struct request_queue *q,
+					struct request *rq,
+					struct request *next)
+{
+	struct bpf_iosched_data *bd = q->elevator->elevator_data;
+	u32 queue = bpf_iosched_rq_queue(next);
+
+	list_del_init(&next->queuelist);
+	if (list_empty(&bd->fifo[queue]))
+		bd->nonempty &= ~BIT(queue);
+}
+
+static bool bpf_iosched_bio_merge(struct request_queue *q, struct bio *bio,
+				  unsigned int nr_segs)
+{
+	struct bpf_iosched_data *bd = q->elevator->elevator_data;
+	struct request *free = NULL;
+	bool ret;
+
+	spin_lock(&bd->lock);
+	ret = blk_mq_sched_try_merge(q, bio, nr_segs, &free);
+	spin_unlock(&bd->lock);
+
+	if (free)
+		blk_mq_free_request(free);
+
+	return ret;
+}
+
+/* Defined so that .finish_request is called upon request completion */
+static void bpf_iosched_prepare_request(struct request *rq)
+{
+	rq->elv.priv[0] = NULL;
+	rq->elv.priv[1] = NULL;
+}
+
+static void bpf_iosched_finish_request(struct request *rq)
+{
+	/* the current policy never saw this request */
+	if (!rq->elv.priv[1])
+		return;
+
+	rcu_read_lock();
+	if (BPF_IOSCHED_HAS_OP(completed) &&
+	    rq->elv.priv[1] == (void *)READ_ONCE(bpf_iosched_gen))
+		bpf_iosched_ops.completed(rq, bpf_iosched_rq_queue(rq));
+	rcu_read_unlock();
+}
+
+static bool bpf_iosched_has_work(struct blk_mq_hw_ctx *hctx)
+{
+	struct bpf_iosched_data *bd = hctx->queue->elevator->elevator_data;
+
+	return READ_ONCE(bd->nonempty);
+}
+
+static int bpf_iosched_init_sched(struct request_queue *q,
+				  struct elevator_type *e)
+{
+	struct bpf_iosched_data *bd;
+	struct elevator_queue *eq;
+	int i;
+
+	eq = elevator_alloc(q, e);
+	if (!eq)
+		return -ENOMEM;
+
+	bd = kzalloc_node(sizeof(*bd), GFP_KERNEL, q->node);
+	if (!bd) {
+		kobject_put(&eq->kobj);
+		return -ENOMEM;
+	}
+
+	spin_lock_init(&bd->lock);
+	for (i = 0; i < BPF_IOSCHED_NR_QUEUES; i++)
+		INIT_LIST_HEAD(&bd->fifo[i]);
+
+	eq->elevator_data = bd;
+	q->elevator = eq;
+	return 0;
+}
+
+static void bpf_iosched_exit_sched(struct elevator_queue *e)
+{
+	struct bpf_iosched_data *bd = e->elevator_data;
+
+	WARN_ON_ONCE(bd->nonempty);
+	kfree(bd);
+}
+
+static ssize_t bpf_iosched_policy_show(struct elevator_queue *e, char *page)
+{
+	ssize_t ret;
+
+	mutex_lock(&bpf_iosched_mutex);
+	if (bpf_iosched_state == BPF_IOSCHED_ENABLED &&
+	    !atomic_read(&bpf_iosched_error))
+		ret = sprintf(page, "%s\n", bpf_iosched_ops.name);
+	else
+		ret = sprintf(page, "none\n");
+	mutex_unlock(&bpf_iosched_mutex);
+
+	return ret;
+}
+
+static struct elv_fs_entry bpf_iosched_attrs[] = {
+	__ATTR(policy, 0444, bpf_iosched_policy_show, NULL),
+	__ATTR_NULL
+};
+
+static struct elevator_type bpf_iosched = {
+	.ops = {
+		.insert_requests	= bpf_iosched_insert_requests,
+		.dispatch_request	= bpf_iosched_dispatch_request,
+		.prepare_request	= bpf_iosched_prepare_request,
+		.finish_request		= bpf_iosched_finish_request,
+		.bio_merge		= bpf_iosched_bio_merge,
+		.requests_merged	= bpf_iosched_merged_requests,
+		.has_work		= bpf_iosched_has_work,
+		.init_sched		= bpf_iosched_init_sched,
+		.exit_sched		= bpf_iosched_exit_sched,
+	},
+
+	.elevator_attrs = bpf_iosched_attrs,
+	.elevator_name = "bpf",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init bpf_iosched_elv_init(void)
+{
+	return elv_register(&bpf_iosched);
+}
+module_init(bpf_iosched_elv_init);
+
+/*
+ * Loading and unloading of the BPF policy.
+ */
+static int bpf_iosched_enable(struct bpf_iosched_ops *ops)
+{
+	int ret = 0;
+
+	mutex_lock(&bpf_iosched_mutex);
+
+	if (bpf_iosched_state != BPF_IOSCHED_DISABLED) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	bpf_iosched_ops = *ops;
+	atomic_set(&bpf_iosched_error, 0);
+
+	if (bpf_iosched_ops.init) {
+		ret = bpf_iosched_ops.init();
+		if (ret)
+			goto unlock;
+	}
+
+	bpf_iosched_kdata = ops;
+	WRITE_ONCE(bpf_iosched_gen, bpf_iosched_gen + 1);
+	smp_store_release(&bpf_iosched_state, BPF_IOSCHED_ENABLED);
+
+	pr_info("bpf-iosched: policy \"%s\" enabled\n", bpf_iosched_ops.name);
+unlock:
+	mutex_unlock(&bpf_iosched_mutex);
+	return ret;
+}
+
+/* @ops is NULL when disabling after an error */
+static void bpf_iosched_disable(struct bpf_iosched_ops *ops)
+{
+	mutex_lock(&bpf_iosched_mutex);
+
+	if (bpf_iosched_state != BPF_IOSCHED_ENABLED)
+		goto unlock;
+	if (ops ? ops != bpf_iosched_kdata : !atomic_read(&bpf_iosched_error))
+		goto unlock;
+
+	WRITE_ONCE(bpf_iosched_state, BPF_IOSCHED_DISABLING);
+
+	/* ops are only called under rcu_read_lock() */
+	synchronize_rcu();
+
+	if (bpf_iosched_ops.exit)
+		bpf_iosched_ops.exit();
+
+	if (atomic_read(&bpf_iosched_error))
+		pr_err("bpf-iosched: policy \"%s\" disabled: %s\n",
+		       bpf_iosched_ops.name, bpf_iosched_error_msg);
+	else
+		pr_info("bpf-iosched: policy \"%s\" disabled\n",
+			bpf_iosched_ops.name);
+
+	bpf_iosched_kdata = NULL;
+	WRITE_ONCE(bpf_iosched_state, BPF_IOSCHED_DISABLED);
+unlock:
+	mutex_unlock(&bpf_iosched_mutex);
+}
+
+/*
+ * struct_ops glue.
+ */
+static bool bpf_iosched_is_valid_access(int off, int size,
+					enum bpf_access_type type,
+					const struct bpf_prog *prog,
+					struct bpf_insn_access_aux *info)
+{
+	if (off < 0 || off >= sizeof(__u64) * MAX_BPF_FUNC_ARGS)
+		return false;
+	if (type != BPF_READ)
+		return false;
+	if (off % size != 0)
+		return false;
+
+	return btf_ctx_access(off, size, type, prog, info);
+}
+
+static int bpf_iosched_btf_struct_access(struct bpf_verifier_log *log,
+					 const struct btf *btf,
+					 const struct btf_type *t, int off,
+					 int size, enum bpf_access_type atype,
+					 u32 *next_btf_id)
+{
+	if (atype == BPF_READ)
+		return btf_struct_access(log, btf, t, off, size, atype,
+					 next_btf_id);
+
+	bpf_log(log, "only read is supported\n");
+	return -EACCES;
+}
+
+static const struct bpf_func_proto *
+bpf_iosched_get_func_proto(enum bpf_func_id func_id,
+			   const struct bpf_prog *prog)
+{
+	return bpf_base_func_proto(func_id);
+}
+
+static const struct bpf_verifier_ops bpf_iosched_verifier_ops = {
+	.get_func_proto		= bpf_iosched_get_func_proto,
+	.is_valid_access	= bpf_iosched_is_valid_access,
+	.btf_struct_access	= bpf_iosched_btf_struct_access,
+};
+
+static int bpf_iosched_init_member(const struct btf_type *t,
+				   const struct btf_member *member,
+				   void *kdata, const void *udata)
+{
+	const struct bpf_iosched_ops *uops = udata;
+	struct bpf_iosched_ops *ops = kdata;
+	u32 moff = btf_member_bit_offset(t, member) / 8;
+
+	switch (moff) {
+	case offsetof(struct bpf_iosched_ops, name):
+		if (bpf_obj_name_cpy(ops->name, uops->name,
+				     sizeof(ops->name)) <= 0)
+			return -EINVAL;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int bpf_iosched_reg(void *kdata)
+{
+	return bpf_iosched_enable(kdata);
+}
+
+static void bpf_iosched_unreg(void *kdata)
+{
+	bpf_iosched_disable(kdata);
+}
+
+static int bpf_iosched_btf_init(struct btf *btf)
+{
+	return 0;
+}
+
+/* Avoid sparse warning.  It is only used in bpf_struct_ops.c. */
+extern struct bpf_struct_ops bpf_bpf_iosched_ops;
+
+struct bpf_struct_ops bpf_bpf_iosched_ops = {
+	.verifier_ops = &bpf_iosched_verifier_ops,
+	.reg = bpf_iosched_reg,
+	.unreg = bpf_iosched_unreg,
+	.init_member = bpf_iosched_init_member,
+	.init = bpf_iosched_btf_init,
+	.name = "bpf_iosched_ops",
+};
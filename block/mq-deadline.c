@@ -17,6 +17,8 @@
 #include <linux/compiler.h>
 #include <linux/rbtree.h>
 #include <linux/sbitmap.h>
+#include <linux/ioprio.h>
+#include <linux/percpu.h>
 
 #include <trace/events/block.h>
 
@@ -34,12 +36,43 @@ static const int write_expire = 5 * HZ; /* ditto for writes, these limits are SO
 static const int writes_starved = 2;    /* max times reads can starve a write */
 static const int fifo_batch = 16;       /* # of sequential requests treated as one
 				     by the above parameters. For throughput. */
+/*
+ * Time a lower priority request may be past its deadline before it is
+ * dispatched ahead of higher priority requests.
+ */
+static const int prio_aging_expire = 10 * HZ;
+
+/* Scheduling priority levels, dispatched in this order */
+enum dd_prio {
+	DD_RT_PRIO	= 0,
+	DD_BE_PRIO	= 1,
+	DD_IDLE_PRIO	= 2,
+	DD_PRIO_MAX	= 2,
+};
 
-struct deadline_data {
-	/*
-	 * run time data
-	 */
+/* Statistics are kept per I/O priority class, IOPRIO_CLASS_NONE..IDLE */
+#define DD_CLASS_COUNT	(IOPRIO_CLASS_IDLE + 1)
+
+static const enum dd_prio ioprio_class_to_prio[DD_CLASS_COUNT] = {
+	[IOPRIO_CLASS_NONE]	= DD_BE_PRIO,
+	[IOPRIO_CLASS_RT]	= DD_RT_PRIO,
+	[IOPRIO_CLASS_BE]	= DD_BE_PRIO,
+	[IOPRIO_CLASS_IDLE]	= DD_IDLE_PRIO,
+};
+
+struct dd_class_stats {
+	u64 inserted;
+	u64 dispatched;
+	u64 completed;
+	u64 lat_ns;			/* sum of allocation to completion times */
+	u64 max_lat_ns;
+};
+
+struct dd_stats {
+	struct dd_class_stats class[DD_CLASS_COUNT];
+};
 
+struct dd_per_prio {
 	/*
 	 * requests (deadline_rq s) are present on both sort_list and fifo_list
 	 */
@@ -50,9 +83,23 @@ struct deadline_data {
 	 * next in sort order. read, write or both are NULL
 	 */
 	struct request *next_rq[2];
+};
+
+/*
+ * Scheduling state is kept per hardware queue so that submitters and
+ * dispatchers on different hardware queues never contend on a lock.  Sort
+ * and fifo order, batching and write starvation are all per hardware queue.
+ */
+struct dd_hctx_data {
+	struct dd_per_prio per_prio[DD_PRIO_MAX + 1];
 	unsigned int batching;		/* number of sequential requests made */
 	unsigned int starved;		/* times reads have starved writes */
 
+	spinlock_t lock;
+	struct list_head dispatch;
+};
+
+struct deadline_data {
 	/*
 	 * settings that change how the i/o scheduler behaves
 	 */
@@ -60,18 +107,44 @@ struct deadline_data {
 	int fifo_batch;
 	int writes_starved;
 	int front_merges;
+	int prio_aging_expire;
 
-	spinlock_t lock;
+	/*
+	 * Zone write locks are shared by all hardware queues, zone_lock
+	 * serializes looking up and taking them.
+	 */
 	spinlock_t zone_lock;
-	struct list_head dispatch;
+
+	struct dd_stats __percpu *stats;
 };
 
 static inline struct rb_root *
-deadline_rb_root(struct deadline_data *dd, struct request *rq)
+deadline_rb_root(struct dd_per_prio *per_prio, struct request *rq)
+{
+	return &per_prio->sort_list[rq_data_dir(rq)];
+}
+
+static inline unsigned int dd_ioprio_class(unsigned short ioprio)
+{
+	unsigned int class = IOPRIO_PRIO_CLASS(ioprio);
+
+	return class < DD_CLASS_COUNT ? class : IOPRIO_CLASS_NONE;
+}
+
+static inline unsigned int dd_rq_class(struct request *rq)
+{
+	return dd_ioprio_class(req_get_ioprio(rq));
+}
+
+static inline struct dd_per_prio *dd_rq_per_prio(struct dd_hctx_data *dhd,
+						 struct request *rq)
 {
-	return &dd->sort_list[rq_data_dir(rq)];
+	return &dhd->per_prio[ioprio_class_to_prio[dd_rq_class(rq)]];
 }
 
+#define dd_count(dd, rq, event)						\
+	this_cpu_inc((dd)->stats->class[dd_rq_class(rq)].event)
+
 /*
  * get the request after `rq' in sector-sorted order
  */
@@ -87,104 +160,64 @@ deadline_latter_request(struct request *rq)
 }
 
 static void
-deadline_add_rq_rb(struct deadline_data *dd, struct request *rq)
+deadline_add_rq_rb(struct dd_per_prio *per_prio, struct request *rq)
 {
-	struct rb_root *root = deadline_rb_root(dd, rq);
+	struct rb_root *root = deadline_rb_root(per_prio, rq);
 
 	elv_rb_add(root, rq);
 }
 
 static inline void
-deadline_del_rq_rb(struct deadline_data *dd, struct request *rq)
+deadline_del_rq_rb(struct dd_per_prio *per_prio, struct request *rq)
 {
 	const int data_dir = rq_data_dir(rq);
 
-	if (dd->next_rq[data_dir] == rq)
-		dd->next_rq[data_dir] = deadline_latter_request(rq);
+	if (per_prio->next_rq[data_dir] == rq)
+		per_prio->next_rq[data_dir] = deadline_latter_request(rq);
 
-	elv_rb_del(deadline_rb_root(dd, rq), rq);
+	elv_rb_del(deadline_rb_root(per_prio, rq), rq);
 }
 
 /*
  * remove rq from rbtree and fifo.
  */
-static void deadline_remove_request(struct request_queue *q, struct request *rq)
+static void deadline_remove_request(struct dd_per_prio *per_prio,
+				    struct request *rq)
 {
-	struct deadline_data *dd = q->elevator->elevator_data;
-
 	list_del_init(&rq->queuelist);
 
 	/*
-	 * We might not be on the rbtree, if we are doing an insert merge
+	 * We might not be on the rbtree, if we were inserted at head
 	 */
 	if (!RB_EMPTY_NODE(&rq->rb_node))
-		deadline_del_rq_rb(dd, rq);
-
-	elv_rqhash_del(q, rq);
-	if (q->last_merge == rq)
-		q->last_merge = NULL;
-}
-
-static void dd_request_merged(struct request_queue *q, struct request *req,
-			      enum elv_merge type)
-{
-	struct deadline_data *dd = q->elevator->elevator_data;
-
-	/*
-	 * if the merge was a front merge, we need to reposition request
-	 */
-	if (type == ELEVATOR_FRONT_MERGE) {
-		elv_rb_del(deadline_rb_root(dd, req), req);
-		deadline_add_rq_rb(dd, req);
-	}
-}
-
-static void dd_merged_requests(struct request_queue *q, struct request *req,
-			       struct request *next)
-{
-	/*
-	 * if next expires before rq, assign its expire time to rq
-	 * and move into next position (next will be deleted) in fifo
-	 */
-	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
-		if (time_before((unsigned long)next->fifo_time,
-				(unsigned long)req->fifo_time)) {
-			list_move(&req->queuelist, &next->queuelist);
-			req->fifo_time = next->fifo_time;
-		}
-	}
-
-	/*
-	 * kill knowledge of next, this one is a goner
-	 */
-	deadline_remove_request(q, next);
+		deadline_del_rq_rb(per_prio, rq);
 }
 
 /*
  * move an entry to dispatch queue
  */
 static void
-deadline_move_request(struct deadline_data *dd, struct request *rq)
+deadline_move_request(struct dd_per_prio *per_prio, struct request *rq)
 {
 	const int data_dir = rq_data_dir(rq);
 
-	dd->next_rq[READ] = NULL;
-	dd->next_rq[WRITE] = NULL;
-	dd->next_rq[data_dir] = deadline_latter_request(rq);
+	per_prio->next_rq[READ] = NULL;
+	per_prio->next_rq[WRITE] = NULL;
+	per_prio->next_rq[data_dir] = deadline_latter_request(rq);
 
 	/*
 	 * take it off the sort and fifo list
 	 */
-	deadline_remove_request(rq->q, rq);
+	deadline_remove_request(per_prio, rq);
 }
 
 /*
  * deadline_check_fifo returns 0 if there are no expired requests on the fifo,
- * 1 otherwise. Requires !list_empty(&dd->fifo_list[data_dir])
+ * 1 otherwise. Requires !list_empty(&per_prio->fifo_list[data_dir])
  */
-static inline int deadline_check_fifo(struct deadline_data *dd, int ddir)
+static inline int deadline_check_fifo(struct dd_per_prio *per_prio, int ddir)
 {
-	struct request *rq = rq_entry_fifo(dd->fifo_list[ddir].next);
+	struct request *rq = rq_entry_fifo(per_prio->fifo_list[ddir].next);
 
 	/*
 	 * rq is expired!
@@ -195,23 +228,57 @@ static inline int deadline_check_fifo(struct deadline_data *dd, int ddir)
 	return 0;
 }
 
+/*
+ * Returns true if the oldest request of @per_prio in either direction is
+ * more than prio_aging_expire past its deadline.
+ */
+static bool deadline_prio_aged(struct deadline_data *dd,
+			       struct dd_per_prio *per_prio)
+{
+	int data_dir;
+
+	for (data_dir = READ; data_dir <= WRITE; data_dir++) {
+		struct request *rq;
+
+		if (list_empty(&per_prio->fifo_list[data_dir]))
+			continue;
+		rq = rq_entry_fifo(per_prio->fifo_list[data_dir].next);
+		if (time_after_eq(jiffies, (unsigned long)rq->fifo_time +
+				  dd->prio_aging_expire))
+			return true;
+	}
+
+	return false;
+}
+
+static bool dd_queued_writes(struct dd_hctx_data *dhd)
+{
+	enum dd_prio prio;
+
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
+		if (!list_empty_careful(&dhd->per_prio[prio].fifo_list[WRITE]))
+			return true;
+	return false;
+}
+
 /*
  * For the specified data direction, return the next request to
- * dispatch using arrival ordered lists.
+ * dispatch using arrival ordered lists.  For zoned writes, the caller
+ * must hold dd->zone_lock.
  */
 static struct request *
-deadline_fifo_request(struct deadline_data *dd, int data_dir)
+deadline_fifo_request(struct deadline_data *dd, struct dd_per_prio *per_prio,
+		      int data_dir)
 {
 	struct request *rq;
-	unsigned long flags;
 
 	if (WARN_ON_ONCE(data_dir != READ && data_dir != WRITE))
 		return NULL;
 
-	if (list_empty(&dd->fifo_list[data_dir]))
+	if (list_empty(&per_prio->fifo_list[data_dir]))
 		return NULL;
 
-	rq = rq_entry_fifo(dd->fifo_list[data_dir].next);
+	rq = rq_entry_fifo(per_prio->fifo_list[data_dir].next);
 	if (data_dir == READ || !blk_queue_is_zoned(rq->q))
 		return rq;
 
@@ -219,32 +286,30 @@ deadline_fifo_request(struct deadline_data *dd, int data_dir)
 	 * Look for a write request that can be dispatched, that is one with
 	 * an unlocked target zone.
 	 */
-	spin_lock_irqsave(&dd->zone_lock, flags);
-	list_for_each_entry(rq, &dd->fifo_list[WRITE], queuelist) {
+	lockdep_assert_held(&dd->zone_lock);
+	list_for_each_entry(rq, &per_prio->fifo_list[WRITE], queuelist) {
 		if (blk_req_can_dispatch_to_zone(rq))
-			goto out;
+			return rq;
 	}
-	rq = NULL;
-out:
-	spin_unlock_irqrestore(&dd->zone_lock, flags);
 
-	return rq;
+	return NULL;
 }
 
 /*
  * For the specified data direction, return the next request to
- * dispatch using sector position sorted lists.
+ * dispatch using sector position sorted lists.  For zoned writes, the
+ * caller must hold dd->zone_lock.
  */
 static struct request *
-deadline_next_request(struct deadline_data *dd, int data_dir)
+deadline_next_request(struct deadline_data *dd, struct dd_per_prio *per_prio,
+		      int data_dir)
 {
 	struct request *rq;
-	unsigned long flags;
 
 	if (WARN_ON_ONCE(data_dir != READ && data_dir != WRITE))
 		return NULL;
 
-	rq = dd->next_rq[data_dir];
+	rq = per_prio->next_rq[data_dir];
 	if (!rq)
 		return NULL;
 
@@ -255,44 +320,39 @@ deadline_next_request(struct deadline_data *dd, int data_dir)
 	 * Look for a write request that can be dispatched, that is one with
 	 * an unlocked target zone.
 	 */
-	spin_lock_irqsave(&dd->zone_lock, flags);
+	lockdep_assert_held(&dd->zone_lock);
 	while (rq) {
 		if (blk_req_can_dispatch_to_zone(rq))
 			break;
 		rq = deadline_latter_request(rq);
 	}
-	spin_unlock_irqrestore(&dd->zone_lock, flags);
 
 	return rq;
 }
 
 /*
- * deadline_dispatch_requests selects the best request according to
- * read/write expire, fifo_batch, etc
+ * deadline_dispatch_requests selects the best request of one priority level
+ * according to read/write expire, fifo_batch, etc
  */
-static struct request *__dd_dispatch_request(struct deadline_data *dd)
+static struct request *__dd_dispatch_request(struct deadline_data *dd,
+					     struct dd_hctx_data *dhd,
+					     struct dd_per_prio *per_prio)
 {
 	struct request *rq, *next_rq;
 	bool reads, writes;
 	int data_dir;
 
-	if (!list_empty(&dd->dispatch)) {
-		rq = list_first_entry(&dd->dispatch, struct request, queuelist);
-		list_del_init(&rq->queuelist);
-		goto done;
-	}
-
-	reads = !list_empty(&dd->fifo_list[READ]);
-	writes = !list_empty(&dd->fifo_list[WRITE]);
+	reads = !list_empty(&per_prio->fifo_list[READ]);
+	writes = !list_empty(&per_prio->fifo_list[WRITE]);
 
 	/*
 	 * batches are currently reads XOR writes
 	 */
-	rq = deadline_next_request(dd, WRITE);
+	rq = deadline_next_request(dd, per_prio, WRITE);
 	if (!rq)
-		rq = deadline_next_request(dd, READ);
+		rq = deadline_next_request(dd, per_prio, READ);
 
-	if (rq && dd->batching < dd->fifo_batch)
+	if (rq && dhd->batching < dd->fifo_batch)
 		/* we have a next request are still entitled to batch */
 		goto dispatch_request;
 
@@ -302,10 +362,10 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd)
 	 */
 
 	if (reads) {
-		BUG_ON(RB_EMPTY_ROOT(&dd->sort_list[READ]));
+		BUG_ON(RB_EMPTY_ROOT(&per_prio->sort_list[READ]));
 
-		if (deadline_fifo_request(dd, WRITE) &&
-		    (dd->starved++ >= dd->writes_starved))
+		if (deadline_fifo_request(dd, per_prio, WRITE) &&
+		    (dhd->starved++ >= dd->writes_starved))
 			goto dispatch_writes;
 
 		data_dir = READ;
@@ -319,9 +379,9 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd)
 
 	if (writes) {
 dispatch_writes:
-		BUG_ON(RB_EMPTY_ROOT(&dd->sort_list[WRITE]));
+		BUG_ON(RB_EMPTY_ROOT(&per_prio->sort_list[WRITE]));
 
-		dd->starved = 0;
+		dhd->starved = 0;
 
 		data_dir = WRITE;
 
@@ -334,14 +394,14 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd)
 	/*
 	 * we are not running a batch, find best request for selected data_dir
 	 */
-	next_rq = deadline_next_request(dd, data_dir);
-	if (deadline_check_fifo(dd, data_dir) || !next_rq) {
+	next_rq = deadline_next_request(dd, per_prio, data_dir);
+	if (deadline_check_fifo(per_prio, data_dir) || !next_rq) {
 		/*
 		 * A deadline has expired, the last request was in the other
 		 * direction, or we have run out of higher-sectored requests.
 		 * Start again from the request with the earliest expiry time.
 		 */
-		rq = deadline_fifo_request(dd, data_dir);
+		rq = deadline_fifo_request(dd, per_prio, data_dir);
 	} else {
 		/*
 		 * The last req was the same dir and we have a next request in
@@ -357,48 +417,131 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd)
 	if (!rq)
 		return NULL;
 
-	dd->batching = 0;
+	dhd->batching = 0;
 
 dispatch_request:
 	/*
 	 * rq is the selected appropriate request.
 	 */
-	dd->batching++;
-	deadline_move_request(dd, rq);
+	dhd->batching++;
+	deadline_move_request(per_prio, rq);
+	return rq;
+}
+
+/*
+ * Priority levels are served strictly in order, except that a lower level
+ * whose oldest request is overdue by more than prio_aging_expire goes first
+ * so that it cannot be starved forever.
+ */
+static struct request *dd_select_request(struct deadline_data *dd,
+					 struct dd_hctx_data *dhd)
+{
+	struct request *rq;
+	enum dd_prio prio;
+
+	if (!list_empty(&dhd->dispatch)) {
+		rq = list_first_entry(&dhd->dispatch, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+		goto done;
+	}
+
+	for (prio = DD_BE_PRIO; prio <= DD_PRIO_MAX; prio++) {
+		if (!deadline_prio_aged(dd, &dhd->per_prio[prio]))
+			continue;
+		rq = __dd_dispatch_request(dd, dhd, &dhd->per_prio[prio]);
+		if (rq)
+			goto done;
+	}
+
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
+		rq = __dd_dispatch_request(dd, dhd, &dhd->per_prio[prio]);
+		if (rq)
+			goto done;
+	}
+
+	return NULL;
+
 done:
 	/*
 	 * If the request needs its target zone locked, do it.
 	 */
 	blk_req_zone_write_lock(rq);
 	rq->rq_flags |= RQF_STARTED;
+	dd_count(dd, rq, dispatched);
 	return rq;
 }
 
 /*
- * One confusing aspect here is that we get called for a specific
- * hardware queue, but we may return a request that is for a
- * different hardware queue. This is because mq-deadline has shared
- * state for all hardware queues, in terms of sorting, FIFOs, etc.
+ * Requests are always dispatched from the hardware queue they were
+ * inserted on, so only that queue's lock is needed.  On zoned devices,
+ * picking a write and locking its target zone must be atomic against the
+ * other hardware queues, so dd->zone_lock is held across the whole
+ * selection whenever writes may be dispatched.
  */
 static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 {
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct dd_hctx_data *dhd = hctx->sched_data;
 	struct request *rq;
+	unsigned long flags;
+	bool zoned;
 
-	spin_lock(&dd->lock);
-	rq = __dd_dispatch_request(dd);
-	spin_unlock(&dd->lock);
+	spin_lock(&dhd->lock);
+	zoned = blk_queue_is_zoned(hctx->queue) &&
+		(dd_queued_writes(dhd) || !list_empty(&dhd->dispatch));
+	if (zoned)
+		spin_lock_irqsave(&dd->zone_lock, flags);
+	rq = dd_select_request(dd, dhd);
+	if (zoned)
+		spin_unlock_irqrestore(&dd->zone_lock, flags);
+	spin_unlock(&dhd->lock);
 
 	return rq;
 }
 
+static int dd_init_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
+{
+	struct dd_hctx_data *dhd;
+	enum dd_prio prio;
+
+	dhd = kzalloc_node(sizeof(*dhd), GFP_KERNEL, hctx->numa_node);
+	if (!dhd)
+		return -ENOMEM;
+
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
+		struct dd_per_prio *per_prio = &dhd->per_prio[prio];
+
+		INIT_LIST_HEAD(&per_prio->fifo_list[READ]);
+		INIT_LIST_HEAD(&per_prio->fifo_list[WRITE]);
+		per_prio->sort_list[READ] = RB_ROOT;
+		per_prio->sort_list[WRITE] = RB_ROOT;
+	}
+	spin_lock_init(&dhd->lock);
+	INIT_LIST_HEAD(&dhd->dispatch);
+
+	hctx->sched_data = dhd;
+	return 0;
+}
+
+static void dd_exit_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
+{
+	struct dd_hctx_data *dhd = hctx->sched_data;
+	enum dd_prio prio;
+
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
+		BUG_ON(!list_empty(&dhd->per_prio[prio].fifo_list[READ]));
+		BUG_ON(!list_empty(&dhd->per_prio[prio].fifo_list[WRITE]));
+	}
+
+	kfree(dhd);
+	hctx->sched_data = NULL;
+}
+
 static void dd_exit_queue(struct elevator_queue *e)
 {
 	struct deadline_data *dd = e->elevator_data;
 
-	BUG_ON(!list_empty(&dd->fifo_list[READ]));
-	BUG_ON(!list_empty(&dd->fifo_list[WRITE]));
-
+	free_percpu(dd->stats);
 	kfree(dd);
 }
 
@@ -415,67 +558,91 @@ static int dd_init_queue(struct request_queue *q, struct elevator_type *e)
 		return -ENOMEM;
 
 	dd = kzalloc_node(sizeof(*dd), GFP_KERNEL, q->node);
-	if (!dd) {
-		kobject_put(&eq->kobj);
-		return -ENOMEM;
-	}
+	if (!dd)
+		goto put_eq;
+
+	dd->stats = alloc_percpu_gfp(struct dd_stats, GFP_KERNEL | __GFP_ZERO);
+	if (!dd->stats)
+		goto free_dd;
 	eq->elevator_data = dd;
 
-	INIT_LIST_HEAD(&dd->fifo_list[READ]);
-	INIT_LIST_HEAD(&dd->fifo_list[WRITE]);
-	dd->sort_list[READ] = RB_ROOT;
-	dd->sort_list[WRITE] = RB_ROOT;
 	dd->fifo_expire[READ] = read_expire;
 	dd->fifo_expire[WRITE] = write_expire;
 	dd->writes_starved = writes_starved;
 	dd->front_merges = 1;
 	dd->fifo_batch = fifo_batch;
-	spin_lock_init(&dd->lock);
+	dd->prio_aging_expire = prio_aging_expire;
 	spin_lock_init(&dd->zone_lock);
-	INIT_LIST_HEAD(&dd->dispatch);
 
 	q->elevator = eq;
 	return 0;
+
+free_dd:
+	kfree(dd);
+put_eq:
+	kobject_put(&eq->kobj);
+	return -ENOMEM;
 }
 
-static int dd_request_merge(struct request_queue *q, struct request **rq,
-			    struct bio *bio)
+/*
+ * Find the request in @root that ends right where @sector starts.  The
+ * elevator merge hash is shared by all hardware queues, so back merge
+ * candidates are looked up in the per hardware queue sort tree instead.
+ */
+static struct request *deadline_find_back_merge(struct rb_root *root,
+						sector_t sector)
 {
-	struct deadline_data *dd = q->elevator->elevator_data;
-	sector_t sector = bio_end_sector(bio);
-	struct request *__rq;
-
-	if (!dd->front_merges)
-		return ELEVATOR_NO_MERGE;
+	struct rb_node *n = root->rb_node;
+	struct request *rq = NULL;
 
-	__rq = elv_rb_find(&dd->sort_list[bio_data_dir(bio)], sector);
-	if (__rq) {
-		BUG_ON(sector != blk_rq_pos(__rq));
+	while (n) {
+		struct request *__rq = rb_entry_rq(n);
 
-		if (elv_bio_merge_ok(__rq, bio)) {
-			*rq = __rq;
-			return ELEVATOR_FRONT_MERGE;
+		if (blk_rq_pos(__rq) < sector) {
+			rq = __rq;
+			n = n->rb_right;
+		} else {
+			n = n->rb_left;
 		}
 	}
 
-	return ELEVATOR_NO_MERGE;
+	if (rq && blk_rq_pos(rq) + blk_rq_sectors(rq) == sector)
+		return rq;
+	return NULL;
 }
 
 static bool dd_bio_merge(struct request_queue *q, struct bio *bio,
 		unsigned int nr_segs)
 {
 	struct deadline_data *dd = q->elevator->elevator_data;
-	struct request *free = NULL;
-	bool ret;
+	struct blk_mq_ctx *ctx = blk_mq_get_ctx(q);
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(q, bio->bi_opf, ctx);
+	struct dd_hctx_data *dhd = hctx->sched_data;
+	enum dd_prio prio = ioprio_class_to_prio[dd_ioprio_class(bio_prio(bio))];
+	struct dd_per_prio *per_prio = &dhd->per_prio[prio];
+	struct rb_root *root = &per_prio->sort_list[bio_data_dir(bio)];
+	enum elv_merge type = ELEVATOR_NO_MERGE;
+	struct request *rq;
 
-	spin_lock(&dd->lock);
-	ret = blk_mq_sched_try_merge(q, bio, nr_segs, &free);
-	spin_unlock(&dd->lock);
+	spin_lock(&dhd->lock);
+	rq = deadline_find_back_merge(root, bio->bi_iter.bi_sector);
+	if (rq)
+		type = blk_mq_sched_try_rq_merge(q, rq, bio, nr_segs);
 
-	if (free)
-		blk_mq_free_request(free);
+	if (type == ELEVATOR_NO_MERGE && dd->front_merges) {
+		rq = elv_rb_find(root, bio_end_sector(bio));
+		if (rq)
+			type = blk_mq_sched_try_rq_merge(q, rq, bio, nr_segs);
+	}
+
+	/* the start sector changed, reposition the request */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(root, rq);
+		deadline_add_rq_rb(per_prio, rq);
+	}
+	spin_unlock(&dhd->lock);
 
-	return ret;
+	return type != ELEVATOR_NO_MERGE;
 }
 
 /*
@@ -484,8 +651,9 @@ static bool dd_bio_merge(struct request_queue *q, struct bio *bio,
 static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 			      bool at_head)
 {
-	struct request_queue *q = hctx->queue;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct dd_hctx_data *dhd = hctx->sched_data;
+	struct dd_per_prio *per_prio = dd_rq_per_prio(dhd, rq);
 	const int data_dir = rq_data_dir(rq);
 
 	/*
@@ -494,37 +662,28 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 	 */
 	blk_req_zone_write_unlock(rq);
 
-	if (blk_mq_sched_try_insert_merge(q, rq))
-		return;
-
 	trace_block_rq_insert(rq);
+	dd_count(dd, rq, inserted);
 
 	if (at_head) {
-		list_add(&rq->queuelist, &dd->dispatch);
+		list_add(&rq->queuelist, &dhd->dispatch);
 	} else {
-		deadline_add_rq_rb(dd, rq);
-
-		if (rq_mergeable(rq)) {
-			elv_rqhash_add(q, rq);
-			if (!q->last_merge)
-				q->last_merge = rq;
-		}
+		deadline_add_rq_rb(per_prio, rq);
 
 		/*
 		 * set expire time and add to fifo list
 		 */
 		rq->fifo_time = jiffies + dd->fifo_expire[data_dir];
-		list_add_tail(&rq->queuelist, &dd->fifo_list[data_dir]);
+		list_add_tail(&rq->queuelist, &per_prio->fifo_list[data_dir]);
 	}
 }
 
 static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
 			       struct list_head *list, bool at_head)
 {
-	struct request_queue *q = hctx->queue;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct dd_hctx_data *dhd = hctx->sched_data;
 
-	spin_lock(&dd->lock);
+	spin_lock(&dhd->lock);
 	while (!list_empty(list)) {
 		struct request *rq;
 
@@ -532,7 +691,7 @@ static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
 		list_del_init(&rq->queuelist);
 		dd_insert_request(hctx, rq, at_head);
 	}
-	spin_unlock(&dd->lock);
+	spin_unlock(&dhd->lock);
 }
 
 /*
@@ -543,6 +702,18 @@ static void dd_prepare_request(struct request *rq)
 {
 }
 
+static void dd_account_completion(struct deadline_data *dd,
+				  struct request *rq)
+{
+	struct dd_class_stats __percpu *ps = &dd->stats->class[dd_rq_class(rq)];
+	u64 lat = ktime_get_ns() - rq->start_time_ns;
+
+	this_cpu_inc(ps->completed);
+	this_cpu_add(ps->lat_ns, lat);
+	if (lat > this_cpu_read(ps->max_lat_ns))
+		this_cpu_write(ps->max_lat_ns, lat);
+}
+
 /*
  * For zoned block devices, write unlock the target zone of
  * completed write requests. Do this while holding the zone lock
@@ -560,26 +731,45 @@ static void dd_prepare_request(struct request *rq)
 static void dd_finish_request(struct request *rq)
 {
 	struct request_queue *q = rq->q;
+	struct deadline_data *dd = q->elevator->elevator_data;
+
+	/* requests merged into another one were never dispatched */
+	if (rq->rq_flags & RQF_STARTED)
+		dd_account_completion(dd, rq);
 
 	if (blk_queue_is_zoned(q)) {
-		struct deadline_data *dd = q->elevator->elevator_data;
+		struct blk_mq_hw_ctx *hctx;
 		unsigned long flags;
+		unsigned int i;
 
+		/*
+		 * Writes to the zone being unlocked may be queued on any
+		 * hardware queue, restart all of those with writes pending.
+		 */
 		spin_lock_irqsave(&dd->zone_lock, flags);
 		blk_req_zone_write_unlock(rq);
-		if (!list_empty(&dd->fifo_list[WRITE]))
-			blk_mq_sched_mark_restart_hctx(rq->mq_hctx);
+		queue_for_each_hw_ctx(q, hctx, i) {
+			if (dd_queued_writes(hctx->sched_data))
+				blk_mq_sched_mark_restart_hctx(hctx);
+		}
 		spin_unlock_irqrestore(&dd->zone_lock, flags);
 	}
 }
 
 static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 {
-	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct dd_hctx_data *dhd = hctx->sched_data;
+	enum dd_prio prio;
+
+	if (!list_empty_careful(&dhd->dispatch))
+		return true;
 
-	return !list_empty_careful(&dd->dispatch) ||
-		!list_empty_careful(&dd->fifo_list[0]) ||
-		!list_empty_careful(&dd->fifo_list[1]);
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
+		if (!list_empty_careful(&dhd->per_prio[prio].fifo_list[READ]) ||
+		    !list_empty_careful(&dhd->per_prio[prio].fifo_list[WRITE]))
+			return true;
+
+	return false;
 }
 
 /*
@@ -613,6 +803,7 @@ SHOW_FUNCTION(deadline_write_expire_show, dd->fifo_expire[WRITE], 1);
 SHOW_FUNCTION(deadline_writes_starved_show, dd->writes_starved, 0);
 SHOW_FUNCTION(deadline_front_merges_show, dd->front_merges, 0);
 SHOW_FUNCTION(deadline_fifo_batch_show, dd->fifo_batch, 0);
+SHOW_FUNCTION(deadline_prio_aging_expire_show, dd->prio_aging_expire, 1);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -636,6 +827,7 @@ STORE_FUNCTION(deadline_write_expire_store, &dd->fifo_expire[WRITE], 0, INT_MAX,
 STORE_FUNCTION(deadline_writes_starved_store, &dd->writes_starved, INT_MIN, INT_MAX, 0);
 STORE_FUNCTION(deadline_front_merges_store, &dd->front_merges, 0, 1, 0);
 STORE_FUNCTION(deadline_fifo_batch_store, &dd->fifo_batch, 0, INT_MAX, 0);
+STORE_FUNCTION(deadline_prio_aging_expire_store, &dd->prio_aging_expire, 0, INT_MAX, 1);
 #undef STORE_FUNCTION
 
 #define DD_ATTR(name) \
@@ -647,38 +839,41 @@ static struct elv_fs_entry deadline_attrs[] = {
 	DD_ATTR(writes_starved),
 	DD_ATTR(front_merges),
 	DD_ATTR(fifo_batch),
+	DD_ATTR(prio_aging_expire),
 	__ATTR_NULL
 };
 
 #ifdef CONFIG_BLK_DEBUG_FS
-#define DEADLINE_DEBUGFS_DDIR_ATTRS(ddir, name)				\
+#define DEADLINE_DEBUGFS_DDIR_ATTRS(prio, data_dir, name)		\
 static void *deadline_##name##_fifo_start(struct seq_file *m,		\
 					  loff_t *pos)			\
-	__acquires(&dd->lock)						\
+	__acquires(&dhd->lock)						\
 {									\
-	struct request_queue *q = m->private;				\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct blk_mq_hw_ctx *hctx = m->private;			\
+	struct dd_hctx_data *dhd = hctx->sched_data;			\
+	struct dd_per_prio *per_prio = &dhd->per_prio[prio];		\
 									\
-	spin_lock(&dd->lock);						\
-	return seq_list_start(&dd->fifo_list[ddir], *pos);		\
+	spin_lock(&dhd->lock);						\
+	return seq_list_start(&per_prio->fifo_list[data_dir], *pos);	\
 }									\
 									\
 static void *deadline_##name##_fifo_next(struct seq_file *m, void *v,	\
 					 loff_t *pos)			\
 {									\
-	struct request_queue *q = m->private;				\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct blk_mq_hw_ctx *hctx = m->private;			\
+	struct dd_hctx_data *dhd = hctx->sched_data;			\
+	struct dd_per_prio *per_prio = &dhd->per_prio[prio];		\
 									\
-	return seq_list_next(v, &dd->fifo_list[ddir], pos);		\
+	return seq_list_next(v, &per_prio->fifo_list[data_dir], pos);	\
 }									\
 									\
 static void deadline_##name##_fifo_stop(struct seq_file *m, void *v)	\
-	__releases(&dd->lock)						\
+	__releases(&dhd->lock)						\
 {									\
-	struct request_queue *q = m->private;				\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct blk_mq_hw_ctx *hctx = m->private;			\
+	struct dd_hctx_data *dhd = hctx->sched_data;			\
 									\
-	spin_unlock(&dd->lock);						\
+	spin_unlock(&dhd->lock);					\
 }									\
 									\
 static const struct seq_operations deadline_##name##_fifo_seq_ops = {	\
@@ -691,61 +886,68 @@ static const struct seq_operations deadline_##name##_fifo_seq_ops = {	\
 static int deadline_##name##_next_rq_show(void *data,			\
 					  struct seq_file *m)		\
 {									\
-	struct request_queue *q = data;					\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
-	struct request *rq = dd->next_rq[ddir];				\
+	struct blk_mq_hw_ctx *hctx = data;				\
+	struct dd_hctx_data *dhd = hctx->sched_data;			\
+	struct request *rq;						\
 									\
+	spin_lock(&dhd->lock);						\
+	rq = dhd->per_prio[prio].next_rq[data_dir];			\
 	if (rq)								\
 		__blk_mq_debugfs_rq_show(m, rq);			\
+	spin_unlock(&dhd->lock);					\
 	return 0;							\
 }
-DEADLINE_DEBUGFS_DDIR_ATTRS(READ, read)
-DEADLINE_DEBUGFS_DDIR_ATTRS(WRITE, write)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_RT_PRIO, READ, read0)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_RT_PRIO, WRITE, write0)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_BE_PRIO, READ, read1)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_BE_PRIO, WRITE, write1)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_IDLE_PRIO, READ, read2)
+DEADLINE_DEBUGFS_DDIR_ATTRS(DD_IDLE_PRIO, WRITE, write2)
 #undef DEADLINE_DEBUGFS_DDIR_ATTRS
 
 static int deadline_batching_show(void *data, struct seq_file *m)
 {
-	struct request_queue *q = data;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct blk_mq_hw_ctx *hctx = data;
+	struct dd_hctx_data *dhd = hctx->sched_data;
 
-	seq_printf(m, "%u\n", dd->batching);
+	seq_printf(m, "%u\n", dhd->batching);
 	return 0;
 }
 
 static int deadline_starved_show(void *data, struct seq_file *m)
 {
-	struct request_queue *q = data;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct blk_mq_hw_ctx *hctx = data;
+	struct dd_hctx_data *dhd = hctx->sched_data;
 
-	seq_printf(m, "%u\n", dd->starved);
+	seq_printf(m, "%u\n", dhd->starved);
 	return 0;
 }
 
 static void *deadline_dispatch_start(struct seq_file *m, loff_t *pos)
-	__acquires(&dd->lock)
+	__acquires(&dhd->lock)
 {
-	struct request_queue *q = m->private;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct blk_mq_hw_ctx *hctx = m->private;
+	struct dd_hctx_data *dhd = hctx->sched_data;
 
-	spin_lock(&dd->lock);
-	return seq_list_start(&dd->dispatch, *pos);
+	spin_lock(&dhd->lock);
+	return seq_list_start(&dhd->dispatch, *pos);
 }
 
 static void *deadline_dispatch_next(struct seq_file *m, void *v, loff_t *pos)
 {
-	struct request_queue *q = m->private;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct blk_mq_hw_ctx *hctx = m->private;
+	struct dd_hctx_data *dhd = hctx->sched_data;
 
-	return seq_list_next(v, &dd->dispatch, pos);
+	return seq_list_next(v, &dhd->dispatch, pos);
 }
 
 static void deadline_dispatch_stop(struct seq_file *m, void *v)
-	__releases(&dd->lock)
+	__releases(&dhd->lock)
 {
-	struct request_queue *q = m->private;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct blk_mq_hw_ctx *hctx = m->private;
+	struct dd_hctx_data *dhd = hctx->sched_data;
 
-	spin_unlock(&dd->lock);
+	spin_unlock(&dhd->lock);
 }
 
 static const struct seq_operations deadline_dispatch_seq_ops = {
@@ -755,18 +957,64 @@ static const struct seq_operations deadline_dispatch_seq_ops = {
 	.show	= blk_mq_debugfs_rq_show,
 };
 
-#define DEADLINE_QUEUE_DDIR_ATTRS(name)						\
+static const char *const dd_class_names[DD_CLASS_COUNT] = {
+	[IOPRIO_CLASS_NONE]	= "none",
+	[IOPRIO_CLASS_RT]	= "rt",
+	[IOPRIO_CLASS_BE]	= "be",
+	[IOPRIO_CLASS_IDLE]	= "idle",
+};
+
+static int deadline_prio_stats_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	struct deadline_data *dd = q->elevator->elevator_data;
+	int class, cpu;
+
+	for (class = 0; class < DD_CLASS_COUNT; class++) {
+		struct dd_class_stats sum = {};
+
+		for_each_possible_cpu(cpu) {
+			struct dd_class_stats *ps;
+
+			ps = &per_cpu_ptr(dd->stats, cpu)->class[class];
+			sum.inserted += ps->inserted;
+			sum.dispatched += ps->dispatched;
+			sum.completed += ps->completed;
+			sum.lat_ns += ps->lat_ns;
+			sum.max_lat_ns = max(sum.max_lat_ns, ps->max_lat_ns);
+		}
+
+		seq_printf(m, "%s inserted=%llu dispatched=%llu completed=%llu avg_lat_us=%llu max_lat_us=%llu\n",
+			   dd_class_names[class], sum.inserted, sum.dispatched,
+			   sum.completed,
+			   sum.completed ?
+			   div64_u64(sum.lat_ns, sum.completed * NSEC_PER_USEC) : 0,
+			   div_u64(sum.max_lat_ns, NSEC_PER_USEC));
+	}
+	return 0;
+}
+
+static const struct blk_mq_debugfs_attr deadline_queue_debugfs_attrs[] = {
+	{"prio_stats", 0400, deadline_prio_stats_show},
+	{},
+};
+
+#define DEADLINE_HCTX_DDIR_ATTRS(name)						\
 	{#name "_fifo_list", 0400, .seq_ops = &deadline_##name##_fifo_seq_ops},	\
 	{#name "_next_rq", 0400, deadline_##name##_next_rq_show}
-static const struct blk_mq_debugfs_attr deadline_queue_debugfs_attrs[] = {
-	DEADLINE_QUEUE_DDIR_ATTRS(read),
-	DEADLINE_QUEUE_DDIR_ATTRS(write),
+static const struct blk_mq_debugfs_attr deadline_hctx_debugfs_attrs[] = {
+	DEADLINE_HCTX_DDIR_ATTRS(read0),
+	DEADLINE_HCTX_DDIR_ATTRS(write0),
+	DEADLINE_HCTX_DDIR_ATTRS(read1),
+	DEADLINE_HCTX_DDIR_ATTRS(write1),
+	DEADLINE_HCTX_DDIR_ATTRS(read2),
+	DEADLINE_HCTX_DDIR_ATTRS(write2),
 	{"batching", 0400, deadline_batching_show},
 	{"starved", 0400, deadline_starved_show},
 	{"dispatch", 0400, .seq_ops = &deadline_dispatch_seq_ops},
 	{},
 };
-#undef DEADLINE_QUEUE_DDIR_ATTRS
+#undef DEADLINE_HCTX_DDIR_ATTRS
 #endif
 
 static struct elevator_type mq_deadline = {
@@ -778,16 +1026,16 @@ static struct elevator_type mq_deadline = {
 		.next_request		= elv_rb_latter_request,
 		.former_request		= elv_rb_former_request,
 		.bio_merge		= dd_bio_merge,
-		.request_merge		= dd_request_merge,
-		.requests_merged	= dd_merged_requests,
-		.request_merged		= dd_request_merged,
 		.has_work		= dd_has_work,
 		.init_sched		= dd_init_queue,
 		.exit_sched		= dd_exit_queue,
+		.init_hctx		= dd_init_hctx,
+		.exit_hctx		= dd_exit_hctx,
 	},
 
 #ifdef CONFIG_BLK_DEBUG_FS
 	.queue_debugfs_attrs = deadline_queue_debugfs_attrs,
+	.hctx_debugfs_attrs = deadline_hctx_debugfs_attrs,
 #endif
 	.elevator_attrs = deadline_attrs,
 	.elevator_name = "mq-deadline",
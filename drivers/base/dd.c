@@ -61,6 +61,10 @@ static bool initcalls_done;
 #define ASYNC_DRV_NAMES_MAX_LEN	256
 static char async_probe_drv_names[ASYNC_DRV_NAMES_MAX_LEN];
 
+/* Same for the names of the buses whose drivers may all probe async */
+#define ASYNC_BUS_NAMES_MAX_LEN	128
+static char async_probe_bus_names[ASYNC_BUS_NAMES_MAX_LEN];
+
 /*
  * In some cases, like suspend to RAM or hibernation, It might be reasonable
  * to prohibit probing of devices as it could be unsafe.
@@ -786,6 +790,17 @@ static int __init save_async_options(char *buf)
 }
 __setup("driver_async_probe=", save_async_options);
 
+/* The option format is "bus_async_probe=bus_name1,bus_name2,..." */
+static int __init save_async_bus_options(char *buf)
+{
+	if (strlen(buf) >= ASYNC_BUS_NAMES_MAX_LEN)
+		pr_warn("Too long list of bus names for 'bus_async_probe'!\n");
+
+	strlcpy(async_probe_bus_names, buf, ASYNC_BUS_NAMES_MAX_LEN);
+	return 0;
+}
+__setup("bus_async_probe=", save_async_bus_options);
+
 bool driver_allows_async_probing(struct device_driver *drv)
 {
 	switch (drv->probe_type) {
@@ -799,6 +814,10 @@ bool driver_allows_async_probing(struct device_driver *drv)
 		if (cmdline_requested_async_probing(drv->name))
 			return true;
 
+		if (drv->bus &&
+		    parse_option_str(async_probe_bus_names, drv->bus->name))
+			return true;
+
 		if (module_requested_async_probing(drv->owner))
 			return true;
 
@@ -389,6 +389,10 @@ struct cached_dev {
 	unsigned int		writeback_rate_fp_term_mid;
 	unsigned int		writeback_rate_fp_term_high;
 	unsigned int		writeback_rate_minimum;
+	/* throttle writeback when backing device writes get slower than this */
+	unsigned int		writeback_latency_target_us;
+	/* moving average of writeback write latency, in ns */
+	uint64_t		writeback_latency_avg;
 
 	enum stop_on_failure	stop_when_cache_set_failed;
 #define DEFAULT_CACHED_DEV_ERROR_LIMIT	64
@@ -477,6 +481,8 @@ struct cache {
 struct gc_stat {
 	size_t			nodes;
 	size_t			nodes_pre;
+	/* local_clock() when the current incremental gc pass started */
+	uint64_t		pass_start;
 	size_t			key_bytes;
 
 	size_t			nkeys;
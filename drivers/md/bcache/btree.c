@@ -93,6 +93,7 @@
 #define MAX_GC_TIMES		100
 #define MIN_GC_NODES		100
 #define GC_SLEEP_MS		100
+#define GC_MAX_PASS_MS		10
 
 #define PTR_DIRTY_BIT		(((uint64_t) 1 << 36))
 
@@ -1633,8 +1634,15 @@ static int btree_gc_recurse(struct btree *b, struct btree_op *op,
 		memmove(r + 1, r, sizeof(r[0]) * (GC_MERGE_NODES - 1));
 		r->b = NULL;
 
+		/*
+		 * Yield to front side I/O after enough nodes, or once this
+		 * pass has held the btree locks above us for too long, so that
+		 * a large tree doesn't stall cached reads.
+		 */
 		if (atomic_read(&b->c->search_inflight) &&
-		    gc->nodes >= gc->nodes_pre + btree_gc_min_nodes(b->c)) {
+		    (gc->nodes >= gc->nodes_pre + btree_gc_min_nodes(b->c) ||
+		     local_clock() - gc->pass_start >
+				GC_MAX_PASS_MS * NSEC_PER_MSEC)) {
 			gc->nodes_pre =  gc->nodes;
 			ret = -EAGAIN;
 			break;
@@ -1801,6 +1809,7 @@ static void bch_btree_gc(struct cache_set *c)
 
 	/* if CACHE_SET_IO_DISABLE set, gc thread should stop too */
 	do {
+		stats.pass_start = local_clock();
 		ret = bcache_btree_root(gc_root, c, &op, &writes, &stats);
 		closure_sync(&writes);
 		cond_resched();
@@ -126,6 +126,7 @@ rw_attribute(writeback_rate_fp_term_low);
 rw_attribute(writeback_rate_fp_term_mid);
 rw_attribute(writeback_rate_fp_term_high);
 rw_attribute(writeback_rate_minimum);
+rw_attribute(writeback_latency_target_us);
 read_attribute(writeback_rate_debug);
 
 read_attribute(stripe_size);
@@ -213,6 +214,7 @@ SHOW(__bch_cached_dev)
 	var_print(writeback_rate_fp_term_mid);
 	var_print(writeback_rate_fp_term_high);
 	var_print(writeback_rate_minimum);
+	var_print(writeback_latency_target_us);
 
 	if (attr == &sysfs_writeback_rate_debug) {
 		char rate[20];
@@ -222,6 +224,7 @@ SHOW(__bch_cached_dev)
 		char integral[20];
 		char change[20];
 		s64 next_io;
+		u64 latency_us;
 
 		/*
 		 * Except for dirty and target, other values should
@@ -239,6 +242,8 @@ SHOW(__bch_cached_dev)
 		bch_hprint(change, wb ? dc->writeback_rate_change << 9 : 0);
 		next_io = wb ? div64_s64(dc->writeback_rate.next-local_clock(),
 					 NSEC_PER_MSEC) : 0;
+		latency_us = div_u64(READ_ONCE(dc->writeback_latency_avg),
+				     NSEC_PER_USEC);
 
 		return sprintf(buf,
 			       "rate:\t\t%s/sec\n"
@@ -247,9 +252,10 @@ SHOW(__bch_cached_dev)
 			       "proportional:\t%s\n"
 			       "integral:\t%s\n"
 			       "change:\t\t%s/sec\n"
-			       "next io:\t%llims\n",
+			       "next io:\t%llims\n"
+			       "latency:\t%lluus\n",
 			       rate, dirty, target, proportional,
-			       integral, change, next_io);
+			       integral, change, next_io, latency_us);
 	}
 
 	sysfs_hprint(dirty_data,
@@ -351,6 +357,8 @@ STORE(__cached_dev)
 	sysfs_strtoul_clamp(writeback_rate_minimum,
 			    dc->writeback_rate_minimum,
 			    1, UINT_MAX);
+	sysfs_strtoul(writeback_latency_target_us,
+		      dc->writeback_latency_target_us);
 
 	sysfs_strtoul_clamp(io_error_limit, dc->error_limit, 0, INT_MAX);
 
@@ -523,6 +531,7 @@ static struct attribute *bch_cached_dev_files[] = {
 	&sysfs_writeback_rate_fp_term_mid,
 	&sysfs_writeback_rate_fp_term_high,
 	&sysfs_writeback_rate_minimum,
+	&sysfs_writeback_latency_target_us,
 	&sysfs_writeback_rate_debug,
 	&sysfs_io_errors,
 	&sysfs_io_error_limit,
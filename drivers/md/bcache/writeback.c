@@ -149,6 +149,23 @@ static void __update_writeback_rate(struct cached_dev *dc)
 	new_rate = clamp_t(int32_t, (proportional_scaled + integral_scaled),
 			dc->writeback_rate_minimum, NSEC_PER_SEC);
 
+	/*
+	 * If the backing device is taking longer than the configured target
+	 * to complete writeback writes, it is saturated (most likely shared
+	 * with front side I/O): scale the rate down in proportion instead
+	 * of queueing even more writes behind it.
+	 */
+	if (dc->writeback_latency_target_us) {
+		uint64_t target_ns = (uint64_t)dc->writeback_latency_target_us *
+			NSEC_PER_USEC;
+		uint64_t avg_ns = READ_ONCE(dc->writeback_latency_avg);
+
+		if (avg_ns > target_ns)
+			new_rate = max_t(uint32_t, dc->writeback_rate_minimum,
+					 div64_u64((uint64_t)new_rate * target_ns,
+						   avg_ns));
+	}
+
 	dc->writeback_rate_proportional = proportional_scaled;
 	dc->writeback_rate_integral_scaled = integral_scaled;
 	dc->writeback_rate_change = new_rate -
@@ -284,6 +301,7 @@ struct dirty_io {
 	struct closure		cl;
 	struct cached_dev	*dc;
 	uint16_t		sequence;
+	uint64_t		start_time;
 	struct bio		bio;
 };
 
@@ -356,6 +374,13 @@ static void dirty_endio(struct bio *bio)
 	if (bio->bi_status) {
 		SET_KEY_DIRTY(&w->key, false);
 		bch_count_backing_io_errors(io->dc, bio);
+	} else {
+		struct cached_dev *dc = io->dc;
+		uint64_t avg = READ_ONCE(dc->writeback_latency_avg);
+
+		/* racy update, the average only steers the rate controller */
+		ewma_add(avg, local_clock() - io->start_time, 8, 0);
+		WRITE_ONCE(dc->writeback_latency_avg, avg);
 	}
 
 	closure_put(&io->cl);
@@ -399,6 +424,7 @@ static void write_dirty(struct closure *cl)
 		io->bio.bi_iter.bi_sector = KEY_START(&w->key);
 		bio_set_dev(&io->bio, io->dc->bdev);
 		io->bio.bi_end_io	= dirty_endio;
+		io->start_time		= local_clock();
 
 		/* I/O request sent to backing device */
 		closure_bio_submit(io->dc->disk.c, &io->bio, cl);
@@ -77,6 +77,7 @@ struct dm_crypt_io {
 	atomic_t io_pending;
 	blk_status_t error;
 	sector_t sector;
+	u64 queue_time_ns;
 
 	struct rb_node rb_node;
 } CRYPTO_MINALIGN_ATTR;
@@ -131,7 +132,8 @@ struct iv_elephant_private {
 enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
 	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD,
 	     DM_CRYPT_NO_READ_WORKQUEUE, DM_CRYPT_NO_WRITE_WORKQUEUE,
-	     DM_CRYPT_WRITE_INLINE };
+	     DM_CRYPT_WRITE_INLINE, DM_CRYPT_INLINE_SYNC,
+	     DM_CRYPT_SYNC_CIPHER };
 
 enum cipher_flags {
 	CRYPT_MODE_INTEGRITY_AEAD,	/* Use authenticated mode for cipher */
@@ -139,6 +141,15 @@ enum cipher_flags {
 	CRYPT_ENCRYPT_PREPROCESS,	/* Must preprocess data for encryption (elephant) */
 };
 
+/*
+ * Per-cpu conversion statistics, indexed by bio data direction.
+ */
+struct crypt_stats {
+	u64 ios[2];		/* bios handed to the crypto engine */
+	u64 inline_ios[2];	/* ... converted without a workqueue hop */
+	u64 nsecs[2];		/* time from queueing to end of conversion */
+};
+
 /*
  * The fields in here must be read only after initialization.
  */
@@ -147,6 +158,7 @@ struct crypt_config {
 	sector_t start;
 
 	struct percpu_counter n_allocated_pages;
+	struct crypt_stats __percpu *stats;
 
 	struct workqueue_struct *io_queue;
 	struct workqueue_struct *crypt_queue;
@@ -251,6 +263,25 @@ static struct crypto_aead *any_tfm_aead(struct crypt_config *cc)
 	return cc->cipher_tfm.tfms_aead[0];
 }
 
+/*
+ * Should bios going in direction @rw be converted in the context that
+ * submitted (writes) or completed (reads) them, rather than on kcryptd?
+ */
+static bool crypt_no_workqueue(struct crypt_config *cc, int rw)
+{
+	if (test_bit(rw == WRITE ? DM_CRYPT_NO_WRITE_WORKQUEUE :
+				   DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags))
+		return true;
+
+	/*
+	 * inline_sync_crypt: only a synchronous cipher (e.g. AES-NI or ARMv8
+	 * CE) finishes the conversion before crypt_convert() returns, offload
+	 * everything else as usual.
+	 */
+	return test_bit(DM_CRYPT_INLINE_SYNC, &cc->flags) &&
+	       test_bit(DM_CRYPT_SYNC_CIPHER, &cc->flags);
+}
+
 /*
  * Different IV generation algorithms:
  *
@@ -1962,7 +1993,7 @@ static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io, int async)
 	clone->bi_iter.bi_sector = cc->start + io->sector;
 
 	if ((likely(!async) && test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags)) ||
-	    test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags)) {
+	    crypt_no_workqueue(cc, WRITE)) {
 		submit_bio_noacct(clone);
 		return;
 	}
@@ -2065,8 +2096,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	sector += bio_sectors(clone);
 
 	crypt_inc_pending(io);
-	r = crypt_convert(cc, ctx,
-			  test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags), true);
+	r = crypt_convert(cc, ctx, crypt_no_workqueue(cc, WRITE), true);
 	/*
 	 * Crypto API backlogged the request, because its queue was full
 	 * and we're in softirq context, so continue from a workqueue
@@ -2130,8 +2160,7 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 	crypt_convert_init(cc, &io->ctx, io->base_bio, io->base_bio,
 			   io->sector);
 
-	r = crypt_convert(cc, &io->ctx,
-			  test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags), true);
+	r = crypt_convert(cc, &io->ctx, crypt_no_workqueue(cc, READ), true);
 	/*
 	 * Crypto API backlogged the request, because its queue was full
 	 * and we're in softirq context, so continue from a workqueue
@@ -2204,11 +2233,18 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 static void kcryptd_crypt(struct work_struct *work)
 {
 	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
+	/* io may be gone once the conversion returns */
+	struct crypt_config *cc = io->cc;
+	u64 queue_time_ns = io->queue_time_ns;
+	int rw = bio_data_dir(io->base_bio);
 
-	if (bio_data_dir(io->base_bio) == READ)
+	if (rw == READ)
 		kcryptd_crypt_read_convert(io);
 	else
 		kcryptd_crypt_write_convert(io);
+
+	this_cpu_inc(cc->stats->ios[rw]);
+	this_cpu_add(cc->stats->nsecs[rw], ktime_get_ns() - queue_time_ns);
 }
 
 static void kcryptd_crypt_tasklet(unsigned long work)
@@ -2219,9 +2255,11 @@ static void kcryptd_crypt_tasklet(unsigned long work)
 static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->cc;
+	int rw = bio_data_dir(io->base_bio);
+
+	io->queue_time_ns = ktime_get_ns();
 
-	if ((bio_data_dir(io->base_bio) == READ && test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags)) ||
-	    (bio_data_dir(io->base_bio) == WRITE && test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))) {
+	if (crypt_no_workqueue(cc, rw)) {
 		/*
 		 * in_irq(): Crypto API's skcipher_walk_first() refuses to work in hard IRQ context.
 		 * irqs_disabled(): the kernel may run some IO completion from the idle thread, but
@@ -2233,6 +2271,7 @@ static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 			return;
 		}
 
+		this_cpu_inc(cc->stats->inline_ios[rw]);
 		kcryptd_crypt(&io->work);
 		return;
 	}
@@ -2707,6 +2746,7 @@ static void crypt_dtr(struct dm_target *ti)
 
 	WARN_ON(percpu_counter_sum(&cc->n_allocated_pages) != 0);
 	percpu_counter_destroy(&cc->n_allocated_pages);
+	free_percpu(cc->stats);
 
 	if (cc->iv_gen_ops && cc->iv_gen_ops->dtr)
 		cc->iv_gen_ops->dtr(cc);
@@ -3059,7 +3099,7 @@ static int crypt_ctr_optional(struct dm_target *ti, unsigned int argc, char **ar
 	struct crypt_config *cc = ti->private;
 	struct dm_arg_set as;
 	static const struct dm_arg _args[] = {
-		{0, 8, "Invalid number of feature args"},
+		{0, 9, "Invalid number of feature args"},
 	};
 	unsigned int opt_params, val;
 	const char *opt_string, *sval;
@@ -3093,6 +3133,8 @@ static int crypt_ctr_optional(struct dm_target *ti, unsigned int argc, char **ar
 			set_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
 		else if (!strcasecmp(opt_string, "no_write_workqueue"))
 			set_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+		else if (!strcasecmp(opt_string, "inline_sync_crypt"))
+			set_bit(DM_CRYPT_INLINE_SYNC, &cc->flags);
 		else if (sscanf(opt_string, "integrity:%u:", &val) == 1) {
 			if (val == 0 || val > MAX_TAG_SIZE) {
 				ti->error = "Invalid integrity arguments";
@@ -3194,6 +3236,13 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	if (ret < 0)
 		goto bad;
 
+	cc->stats = alloc_percpu(struct crypt_stats);
+	if (!cc->stats) {
+		ti->error = "Cannot allocate crypt statistics";
+		ret = -ENOMEM;
+		goto bad;
+	}
+
 	/* Optional parameters need to be read before cipher constructor */
 	if (argc > 5) {
 		ret = crypt_ctr_optional(ti, argc - 5, &argv[5]);
@@ -3291,6 +3340,15 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		set_bit(DM_CRYPT_WRITE_INLINE, &cc->flags);
 	}
 
+	if (crypt_integrity_aead(cc)) {
+		if (!(crypto_aead_alg(any_tfm_aead(cc))->base.cra_flags &
+		      CRYPTO_ALG_ASYNC))
+			set_bit(DM_CRYPT_SYNC_CIPHER, &cc->flags);
+	} else if (!(crypto_skcipher_alg(any_tfm(cc))->base.cra_flags &
+		     CRYPTO_ALG_ASYNC)) {
+		set_bit(DM_CRYPT_SYNC_CIPHER, &cc->flags);
+	}
+
 	if (crypt_integrity_aead(cc) || cc->integrity_iv_size) {
 		ret = crypt_integrity_ctr(cc, ti);
 		if (ret)
@@ -3425,9 +3483,28 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 	int num_feature_args = 0;
 
 	switch (type) {
-	case STATUSTYPE_INFO:
-		result[0] = '\0';
+	case STATUSTYPE_INFO: {
+		u64 ios[2] = {}, inline_ios[2] = {}, nsecs[2] = {};
+		int cpu, rw;
+
+		for_each_possible_cpu(cpu) {
+			struct crypt_stats *s = per_cpu_ptr(cc->stats, cpu);
+
+			for (rw = READ; rw <= WRITE; rw++) {
+				ios[rw] += s->ios[rw];
+				inline_ios[rw] += s->inline_ios[rw];
+				nsecs[rw] += s->nsecs[rw];
+			}
+		}
+
+		/* <ios> <inline ios> <average crypt latency in us> per rw */
+		for (rw = READ; rw <= WRITE; rw++)
+			DMEMIT("%s%llu %llu %llu", rw == READ ? "" : " ",
+			       ios[rw], inline_ios[rw],
+			       ios[rw] ? div64_u64(nsecs[rw], ios[rw]) /
+					 NSEC_PER_USEC : 0);
 		break;
+	}
 
 	case STATUSTYPE_TABLE:
 		DMEMIT("%s ", cc->cipher_string);
@@ -3449,6 +3526,7 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		num_feature_args += test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_INLINE_SYNC, &cc->flags);
 		num_feature_args += cc->sector_size != (1 << SECTOR_SHIFT);
 		num_feature_args += test_bit(CRYPT_IV_LARGE_SECTORS, &cc->cipher_flags);
 		if (cc->on_disk_tag_size)
@@ -3465,6 +3543,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 				DMEMIT(" no_read_workqueue");
 			if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))
 				DMEMIT(" no_write_workqueue");
+			if (test_bit(DM_CRYPT_INLINE_SYNC, &cc->flags))
+				DMEMIT(" inline_sync_crypt");
 			if (cc->on_disk_tag_size)
 				DMEMIT(" integrity:%u:%s", cc->on_disk_tag_size, cc->cipher_auth);
 			if (cc->sector_size != (1 << SECTOR_SHIFT))
@@ -3577,7 +3657,7 @@ static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 23, 0},
+	.version = {1, 24, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -169,12 +169,63 @@ static int verity_hash_final(struct dm_verity *v, struct ahash_request *req,
 	return r;
 }
 
+/*
+ * Synchronous hashes are driven through shash directly, which saves setting
+ * up a scatterlist and waiting for every step.  A leading salt is hashed only
+ * once, when the table is loaded.
+ */
+static int verity_shash_init(struct dm_verity *v, struct shash_desc *desc)
+{
+	desc->tfm = v->shash_tfm;
+
+	if (likely(v->initial_hashstate))
+		return crypto_shash_import(desc, v->initial_hashstate);
+
+	return crypto_shash_init(desc);
+}
+
+static int verity_shash_final(struct dm_verity *v, struct shash_desc *desc,
+			      u8 *digest)
+{
+	if (unlikely(v->salt_size && (!v->version)))
+		return crypto_shash_finup(desc, v->salt, v->salt_size, digest);
+
+	return crypto_shash_final(desc, digest);
+}
+
+static int verity_shash(struct dm_verity *v, struct shash_desc *desc,
+			const u8 *data, size_t len, u8 *digest)
+{
+	int r;
+
+	r = verity_shash_init(v, desc);
+	if (unlikely(r < 0))
+		return r;
+
+	if (unlikely(v->salt_size && (!v->version))) {
+		r = crypto_shash_update(desc, data, len);
+		if (unlikely(r < 0))
+			return r;
+
+		return verity_shash_final(v, desc, digest);
+	}
+
+	return crypto_shash_finup(desc, data, len, digest);
+}
+
+/*
+ * With v->shash_tfm set, @req is the shash_desc of the same size.
+ */
 int verity_hash(struct dm_verity *v, struct ahash_request *req,
 		const u8 *data, size_t len, u8 *digest)
 {
 	int r;
 	struct crypto_wait wait;
 
+	if (v->shash_tfm)
+		return verity_shash(v, (struct shash_desc *)req, data, len,
+				    digest);
+
 	r = verity_hash_init(v, req, &wait);
 	if (unlikely(r < 0))
 		goto out;
@@ -408,6 +459,51 @@ static int verity_for_io_block(struct dm_verity *v, struct dm_verity_io *io,
 	return 0;
 }
 
+/*
+ * Same as verity_for_io_block() with v->shash_tfm, also computing the digest.
+ */
+static int verity_shash_io_block(struct dm_verity *v, struct dm_verity_io *io,
+				 struct bvec_iter *iter, u8 *digest)
+{
+	unsigned int todo = 1 << v->data_dev_block_bits;
+	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_io_data_size);
+	struct shash_desc *desc = verity_io_hash_desc(v, io);
+	struct bio_vec bv = bio_iter_iovec(bio, *iter);
+	u8 *page;
+	int r;
+
+	/* The block usually sits in a single page, hash it in one go. */
+	if (likely(bv.bv_len >= todo)) {
+		page = kmap_atomic(bv.bv_page);
+		r = verity_shash(v, desc, page + bv.bv_offset, todo, digest);
+		kunmap_atomic(page);
+		bio_advance_iter(bio, iter, todo);
+		return r;
+	}
+
+	r = verity_shash_init(v, desc);
+	if (unlikely(r < 0))
+		return r;
+
+	do {
+		unsigned int len;
+
+		bv = bio_iter_iovec(bio, *iter);
+		len = min(bv.bv_len, todo);
+
+		page = kmap_atomic(bv.bv_page);
+		r = crypto_shash_update(desc, page + bv.bv_offset, len);
+		kunmap_atomic(page);
+		if (unlikely(r < 0))
+			return r;
+
+		bio_advance_iter(bio, iter, len);
+		todo -= len;
+	} while (todo);
+
+	return verity_shash_final(v, desc, digest);
+}
+
 /*
  * Calls function process for 1 << v->data_dev_block_bits bytes in the bio_vec
  * starting from iter.
@@ -506,19 +602,29 @@ static int verity_verify_io(struct dm_verity_io *io)
 			continue;
 		}
 
-		r = verity_hash_init(v, req, &wait);
-		if (unlikely(r < 0))
-			return r;
-
 		start = io->iter;
-		r = verity_for_io_block(v, io, &io->iter, &wait);
-		if (unlikely(r < 0))
-			return r;
+		if (v->shash_tfm) {
+			r = verity_shash_io_block(v, io, &io->iter,
+						  verity_io_real_digest(v, io));
+			if (unlikely(r < 0)) {
+				DMERR("verity_shash_io_block failed: %d", r);
+				return r;
+			}
+		} else {
+			r = verity_hash_init(v, req, &wait);
+			if (unlikely(r < 0))
+				return r;
 
-		r = verity_hash_final(v, req, verity_io_real_digest(v, io),
-					&wait);
-		if (unlikely(r < 0))
-			return r;
+			r = verity_for_io_block(v, io, &io->iter, &wait);
+			if (unlikely(r < 0))
+				return r;
+
+			r = verity_hash_final(v, req,
+					      verity_io_real_digest(v, io),
+					      &wait);
+			if (unlikely(r < 0))
+				return r;
+		}
 
 		if (likely(memcmp(verity_io_real_digest(v, io),
 				  verity_io_want_digest(v, io), v->digest_size) == 0)) {
@@ -823,6 +929,9 @@ static void verity_dtr(struct dm_target *ti)
 	kfree(v->root_digest);
 	kfree(v->zero_digest);
 
+	kfree(v->initial_hashstate);
+	if (v->shash_tfm)
+		crypto_free_shash(v->shash_tfm);
 	if (v->tfm)
 		crypto_free_ahash(v->tfm);
 
@@ -1120,14 +1229,35 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	DMINFO("%s using implementation \"%s\"", v->alg_name,
 	       crypto_hash_alg_common(v->tfm)->base.cra_driver_name);
 
-	v->digest_size = crypto_ahash_digestsize(v->tfm);
+	/*
+	 * If the preferred implementation is synchronous anyway, skip the
+	 * ahash wrapping around it.
+	 */
+	v->shash_tfm = crypto_alloc_shash(v->alg_name, 0, 0);
+	if (!IS_ERR(v->shash_tfm) &&
+	    !strcmp(crypto_shash_driver_name(v->shash_tfm),
+		    crypto_ahash_driver_name(v->tfm))) {
+		crypto_free_ahash(v->tfm);
+		v->tfm = NULL;
+
+		v->digest_size = crypto_shash_digestsize(v->shash_tfm);
+		v->ahash_reqsize = sizeof(struct shash_desc) +
+			crypto_shash_descsize(v->shash_tfm);
+	} else {
+		if (!IS_ERR(v->shash_tfm))
+			crypto_free_shash(v->shash_tfm);
+		v->shash_tfm = NULL;
+
+		v->digest_size = crypto_ahash_digestsize(v->tfm);
+		v->ahash_reqsize = sizeof(struct ahash_request) +
+			crypto_ahash_reqsize(v->tfm);
+	}
+
 	if ((1 << v->hash_dev_block_bits) < v->digest_size * 2) {
 		ti->error = "Digest size too big";
 		r = -EINVAL;
 		goto bad;
 	}
-	v->ahash_reqsize = sizeof(struct ahash_request) +
-		crypto_ahash_reqsize(v->tfm);
 
 	v->root_digest = kmalloc(v->digest_size, GFP_KERNEL);
 	if (!v->root_digest) {
@@ -1159,6 +1289,31 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
+	if (v->shash_tfm && v->salt_size && v->version >= 1) {
+		SHASH_DESC_ON_STACK(desc, v->shash_tfm);
+
+		v->initial_hashstate =
+			kmalloc(crypto_shash_statesize(v->shash_tfm),
+				GFP_KERNEL);
+		if (!v->initial_hashstate) {
+			ti->error = "Cannot allocate initial hash state";
+			r = -ENOMEM;
+			goto bad;
+		}
+
+		desc->tfm = v->shash_tfm;
+		r = crypto_shash_init(desc);
+		if (!r)
+			r = crypto_shash_update(desc, v->salt, v->salt_size);
+		if (!r)
+			r = crypto_shash_export(desc, v->initial_hashstate);
+		shash_desc_zero(desc);
+		if (r) {
+			ti->error = "Cannot set up initial hash state";
+			goto bad;
+		}
+	}
+
 	argv += 10;
 	argc -= 10;
 
@@ -38,6 +38,8 @@ struct dm_verity {
 	struct dm_bufio_client *bufio;
 	char *alg_name;
 	struct crypto_ahash *tfm;
+	struct crypto_shash *shash_tfm;	/* used instead of tfm if synchronous */
+	u8 *initial_hashstate;	/* shash state after the leading salt */
 	u8 *root_digest;	/* digest of the root block */
 	u8 *salt;		/* salt: its size is salt_size */
 	u8 *zero_digest;	/* digest for a zero block */
@@ -84,12 +86,12 @@ struct dm_verity_io {
 	/*
 	 * Three variably-size fields follow this struct:
 	 *
-	 * u8 hash_req[v->ahash_reqsize];
+	 * u8 hash_req[v->ahash_reqsize]; (a shash_desc with v->shash_tfm)
 	 * u8 real_digest[v->digest_size];
 	 * u8 want_digest[v->digest_size];
 	 *
-	 * To access them use: verity_io_hash_req(), verity_io_real_digest()
-	 * and verity_io_want_digest().
+	 * To access them use: verity_io_hash_req() or verity_io_hash_desc(),
+	 * verity_io_real_digest() and verity_io_want_digest().
 	 */
 };
 
@@ -99,6 +101,12 @@ static inline struct ahash_request *verity_io_hash_req(struct dm_verity *v,
 	return (struct ahash_request *)(io + 1);
 }
 
+static inline struct shash_desc *verity_io_hash_desc(struct dm_verity *v,
+						     struct dm_verity_io *io)
+{
+	return (struct shash_desc *)(io + 1);
+}
+
 static inline u8 *verity_io_real_digest(struct dm_verity *v,
 					struct dm_verity_io *io)
 {
@@ -1243,6 +1243,7 @@ static int writecache_flush_thread(void *data)
 	struct dm_writecache *wc = data;
 
 	while (1) {
+		struct bio_list flushes;
 		struct bio *bio;
 
 		wc_lock(wc);
@@ -1267,11 +1268,25 @@ static int writecache_flush_thread(void *data)
 			bio_set_dev(bio, wc->dev->bdev);
 			submit_bio_noacct(bio);
 		} else {
+			/*
+			 * Group commit: all the flushes queued up to the next
+			 * discard are satisfied by one metadata commit, so
+			 * concurrent FLUSH submitters share a single write of
+			 * the superblock and metadata instead of one each.
+			 */
+			bio_list_init(&flushes);
+			bio_list_add(&flushes, bio);
+			while ((bio = bio_list_peek(&wc->flush_list)) &&
+			       bio_op(bio) != REQ_OP_DISCARD)
+				bio_list_add(&flushes, bio_list_pop(&wc->flush_list));
+
 			writecache_flush(wc);
 			wc_unlock(wc);
-			if (writecache_has_error(wc))
-				bio->bi_status = BLK_STS_IOERR;
-			bio_endio(bio);
+			while ((bio = bio_list_pop(&flushes))) {
+				if (writecache_has_error(wc))
+					bio->bi_status = BLK_STS_IOERR;
+				bio_endio(bio);
+			}
 		}
 	}
 
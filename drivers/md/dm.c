@@ -1614,6 +1614,57 @@ static void init_clone_info(struct clone_info *ci, struct mapped_device *md,
 	ci->sector = bio->bi_iter.bi_sector;
 }
 
+/*
+ * Return the target that can map @bio whole without any splitting or
+ * special handling, or NULL if @bio must take the generic path.
+ */
+static struct dm_target *dm_simple_remap_target(struct dm_table *map,
+						struct bio *bio)
+{
+	sector_t sector = bio->bi_iter.bi_sector;
+	struct dm_target *ti;
+
+	if ((bio->bi_opf & REQ_PREFLUSH) || is_abnormal_io(bio) ||
+	    op_is_zone_mgmt(bio_op(bio)) || bio_integrity(bio))
+		return NULL;
+
+	ti = dm_table_find_target(map, sector);
+	if (!ti || !dm_target_is_simple_remap(ti->type))
+		return NULL;
+	if (bio_sectors(bio) > max_io_len(ti, sector))
+		return NULL;
+	return ti;
+}
+
+/*
+ * Fast path for bios that a single simple remap target maps whole: the
+ * clone embedded in the dm_io is sent straight to the target, bypassing
+ * the clone_info machinery.
+ */
+static blk_qc_t __process_simple_bio(struct mapped_device *md,
+				     struct dm_target *ti, struct bio *bio)
+{
+	struct dm_io *io = alloc_io(md, bio);
+	struct dm_target_io *tio = &io->tio;
+	blk_qc_t ret = BLK_QC_T_NONE;
+	int error;
+
+	tio->magic = DM_TIO_MAGIC;
+	tio->io = io;
+	tio->ti = ti;
+	tio->target_bio_nr = 0;
+	tio->len_ptr = NULL;
+
+	__bio_clone_fast(&tio->clone, bio);
+	error = bio_crypt_clone(&tio->clone, bio, GFP_NOIO);
+	if (likely(!error))
+		ret = __map_bio(tio);
+
+	/* drop the extra reference count */
+	dec_pending(io, errno_to_blk_status(error));
+	return ret;
+}
+
 #define __dm_part_stat_sub(part, field, subnd)	\
 	(part_stat_get(part, field) -= (subnd))
 
@@ -1625,8 +1676,13 @@ static blk_qc_t __split_and_process_bio(struct mapped_device *md,
 {
 	struct clone_info ci;
 	blk_qc_t ret = BLK_QC_T_NONE;
+	struct dm_target *ti;
 	int error = 0;
 
+	ti = dm_simple_remap_target(map, bio);
+	if (ti)
+		return __process_simple_bio(md, ti, bio);
+
 	init_clone_info(&ci, md, map, bio);
 
 	if (bio->bi_opf & REQ_PREFLUSH) {
@@ -6427,6 +6427,8 @@ static void raid5_do_work(struct work_struct *work)
 	}
 	pr_debug("%d stripes handled\n", handled);
 
+	group->stripes_handled += handled;
+	group->work_runs++;
 	spin_unlock_irq(&conf->device_lock);
 
 	flush_deferred_bios(conf);
@@ -6862,6 +6864,7 @@ raid5_show_group_thread_cnt(struct mddev *mddev, char *page)
 static int alloc_thread_groups(struct r5conf *conf, int cnt,
 			       int *group_cnt,
 			       struct r5worker_group **worker_groups);
+static void free_worker_groups(struct r5worker_group *groups, int group_cnt);
 static ssize_t
 raid5_store_group_thread_cnt(struct mddev *mddev, const char *page, size_t len)
 {
@@ -6869,7 +6872,7 @@ raid5_store_group_thread_cnt(struct mddev *mddev, const char *page, size_t len)
 	unsigned int new;
 	int err;
 	struct r5worker_group *new_groups, *old_groups;
-	int group_cnt;
+	int group_cnt, old_group_cnt;
 
 	if (len >= PAGE_SIZE)
 		return -EINVAL;
@@ -6889,6 +6892,7 @@ raid5_store_group_thread_cnt(struct mddev *mddev, const char *page, size_t len)
 		mddev_suspend(mddev);
 
 		old_groups = conf->worker_groups;
+		old_group_cnt = conf->group_cnt;
 		if (old_groups)
 			flush_workqueue(raid5_wq);
 
@@ -6900,9 +6904,7 @@ raid5_store_group_thread_cnt(struct mddev *mddev, const char *page, size_t len)
 			conf->worker_groups = new_groups;
 			spin_unlock_irq(&conf->device_lock);
 
-			if (old_groups)
-				kfree(old_groups[0].workers);
-			kfree(old_groups);
+			free_worker_groups(old_groups, old_group_cnt);
 		}
 		mddev_resume(mddev);
 	}
@@ -6916,11 +6918,51 @@ raid5_group_thread_cnt = __ATTR(group_thread_cnt, S_IRUGO | S_IWUSR,
 				raid5_show_group_thread_cnt,
 				raid5_store_group_thread_cnt);
 
+/*
+ * One line per worker group (i.e. NUMA node):
+ *   <group> <queued stripes> <stripes handled> <worker runs>
+ */
+static ssize_t
+raid5_show_group_thread_stats(struct mddev *mddev, char *page)
+{
+	struct r5conf *conf;
+	ssize_t len = 0;
+	int err, i;
+
+	/* worker groups are only replaced with the mddev lock held */
+	err = mddev_lock(mddev);
+	if (err)
+		return err;
+	conf = mddev->private;
+	if (!conf) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	spin_lock_irq(&conf->device_lock);
+	for (i = 0; i < conf->group_cnt; i++) {
+		struct r5worker_group *group = &conf->worker_groups[i];
+
+		len += scnprintf(page + len, PAGE_SIZE - len, "%d %d %lu %lu\n",
+				 i, group->stripes_cnt, group->stripes_handled,
+				 group->work_runs);
+	}
+	spin_unlock_irq(&conf->device_lock);
+out:
+	mddev_unlock(mddev);
+	return err ?: len;
+}
+
+static struct md_sysfs_entry
+raid5_group_thread_stats = __ATTR(group_thread_stats, S_IRUGO,
+				  raid5_show_group_thread_stats, NULL);
+
 static struct attribute *raid5_attrs[] =  {
 	&raid5_stripecache_size.attr,
 	&raid5_stripecache_active.attr,
 	&raid5_preread_bypass_threshold.attr,
 	&raid5_group_thread_cnt.attr,
+	&raid5_group_thread_stats.attr,
 	&raid5_skip_copy.attr,
 	&raid5_rmw_level.attr,
 	&raid5_stripe_size.attr,
@@ -6937,8 +6979,6 @@ static int alloc_thread_groups(struct r5conf *conf, int cnt, int *group_cnt,
 			       struct r5worker_group **worker_groups)
 {
 	int i, j, k;
-	ssize_t size;
-	struct r5worker *workers;
 
 	if (cnt == 0) {
 		*group_cnt = 0;
@@ -6946,15 +6986,10 @@ static int alloc_thread_groups(struct r5conf *conf, int cnt, int *group_cnt,
 		return 0;
 	}
 	*group_cnt = num_possible_nodes();
-	size = sizeof(struct r5worker) * cnt;
-	workers = kcalloc(size, *group_cnt, GFP_NOIO);
 	*worker_groups = kcalloc(*group_cnt, sizeof(struct r5worker_group),
 				 GFP_NOIO);
-	if (!*worker_groups || !workers) {
-		kfree(workers);
-		kfree(*worker_groups);
+	if (!*worker_groups)
 		return -ENOMEM;
-	}
 
 	for (i = 0; i < *group_cnt; i++) {
 		struct r5worker_group *group;
@@ -6963,7 +6998,14 @@ static int alloc_thread_groups(struct r5conf *conf, int cnt, int *group_cnt,
 		INIT_LIST_HEAD(&group->handle_list);
 		INIT_LIST_HEAD(&group->loprio_list);
 		group->conf = conf;
-		group->workers = workers + i * cnt;
+		/* group i serves the CPUs of node i, keep its workers there */
+		group->workers = kcalloc_node(cnt, sizeof(struct r5worker),
+					      GFP_NOIO, node_online(i) ? i :
+					      NUMA_NO_NODE);
+		if (!group->workers) {
+			free_worker_groups(*worker_groups, i);
+			return -ENOMEM;
+		}
 
 		for (j = 0; j < cnt; j++) {
 			struct r5worker *worker = group->workers + j;
@@ -6978,11 +7020,19 @@ static int alloc_thread_groups(struct r5conf *conf, int cnt, int *group_cnt,
 	return 0;
 }
 
+static void free_worker_groups(struct r5worker_group *groups, int group_cnt)
+{
+	int i;
+
+	if (groups)
+		for (i = 0; i < group_cnt; i++)
+			kfree(groups[i].workers);
+	kfree(groups);
+}
+
 static void free_thread_groups(struct r5conf *conf)
 {
-	if (conf->worker_groups)
-		kfree(conf->worker_groups[0].workers);
-	kfree(conf->worker_groups);
+	free_worker_groups(conf->worker_groups, conf->group_cnt);
 	conf->worker_groups = NULL;
 }
 
@@ -515,6 +515,9 @@ struct r5worker_group {
 	struct r5conf *conf;
 	struct r5worker *workers;
 	int stripes_cnt;
+	/* statistics, protected by device_lock */
+	unsigned long stripes_handled;
+	unsigned long work_runs;
 };
 
 /*
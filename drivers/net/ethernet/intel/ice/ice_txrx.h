@@ -176,6 +176,15 @@ struct ice_rx_buf {
 	};
 };
 
+/* xdp_buff together with the descriptor it was built from, lets the
+ * xdp_metadata_ops read the descriptor fields without copying them
+ */
+struct ice_xdp_buff {
+	struct xdp_buff xdp_buff;
+	const union ice_32b_rx_flex_desc *eop_desc;
+	struct ice_ring *rx_ring;
+};
+
 struct ice_q_stats {
 	u64 pkts;
 	u64 bytes;
@@ -296,6 +305,7 @@ struct ice_ring {
 	DECLARE_BITMAP(xps_state, ICE_TX_NBITS);	/* XPS Config State */
 	struct bpf_prog *xdp_prog;
 	struct xsk_buff_pool *xsk_pool;
+	struct xdp_desc *xsk_descs;	/* AF_XDP ZC Tx batch, XDP rings only */
 	u16 rx_offset;
 	/* CL3 - 3rd cacheline starts here */
 	struct xdp_rxq_info xdp_rxq;
@@ -70,6 +70,104 @@ ice_rx_hash(struct ice_ring *rx_ring, union ice_32b_rx_flex_desc *rx_desc,
 	skb_set_hash(skb, hash, ice_ptype_to_htype(rx_ptype));
 }
 
+/**
+ * ice_ptype_to_xdp_rss_type - get the headers covered by the RSS hash
+ * @ptype: the ptype value from the descriptor
+ *
+ * Returns a combination of enum xdp_rss_hash_type bits
+ */
+static u32 ice_ptype_to_xdp_rss_type(u16 ptype)
+{
+	struct ice_rx_ptype_decoded decoded = ice_decode_rx_desc_ptype(ptype);
+	u32 rss_type;
+
+	if (!decoded.known || decoded.outer_ip != ICE_RX_PTYPE_OUTER_IP)
+		return XDP_RSS_TYPE_L2;
+
+	if (decoded.outer_ip_ver == ICE_RX_PTYPE_OUTER_IPV4)
+		rss_type = XDP_RSS_L3_IPV4;
+	else
+		rss_type = XDP_RSS_L3_IPV6;
+
+	switch (decoded.inner_prot) {
+	case ICE_RX_PTYPE_INNER_PROT_TCP:
+		rss_type |= XDP_RSS_L4 | XDP_RSS_L4_TCP;
+		break;
+	case ICE_RX_PTYPE_INNER_PROT_UDP:
+		rss_type |= XDP_RSS_L4 | XDP_RSS_L4_UDP;
+		break;
+	case ICE_RX_PTYPE_INNER_PROT_SCTP:
+		rss_type |= XDP_RSS_L4 | XDP_RSS_L4_SCTP;
+		break;
+	default:
+		break;
+	}
+
+	return rss_type;
+}
+
+/**
+ * ice_xdp_rx_hash - RSS hash of the frame for XDP programs
+ * @xdp: xdp_buff embedded in an ice_xdp_buff
+ * @hash: filled with the RSS hash
+ * @rss_type: filled with the headers covered by @hash
+ *
+ * Returns 0 on success, -ENODATA if the descriptor carries no hash
+ */
+static int ice_xdp_rx_hash(const struct xdp_buff *xdp, u32 *hash, u32 *rss_type)
+{
+	const struct ice_xdp_buff *xdp_ext =
+		container_of(xdp, struct ice_xdp_buff, xdp_buff);
+	const union ice_32b_rx_flex_desc *rx_desc = xdp_ext->eop_desc;
+	const struct ice_32b_rx_flex_desc_nic *nic_mdid;
+	u16 ptype;
+
+	if (!(xdp_ext->rx_ring->netdev->features & NETIF_F_RXHASH))
+		return -ENODATA;
+
+	if (rx_desc->wb.rxdid != ICE_RXDID_FLEX_NIC)
+		return -ENODATA;
+
+	nic_mdid = (const struct ice_32b_rx_flex_desc_nic *)rx_desc;
+	ptype = le16_to_cpu(rx_desc->wb.ptype_flex_flags0) &
+		ICE_RX_FLEX_DESC_PTYPE_M;
+
+	*hash = le32_to_cpu(nic_mdid->rss_hash);
+	*rss_type = ice_ptype_to_xdp_rss_type(ptype);
+
+	return 0;
+}
+
+/**
+ * ice_xdp_rx_vlan_tag - VLAN tag stripped off the frame for XDP programs
+ * @xdp: xdp_buff embedded in an ice_xdp_buff
+ * @vlan_proto: filled with the TPID
+ * @vlan_tci: filled with the TCI
+ *
+ * Returns 0 on success, -ENODATA if no tag was stripped
+ */
+static int ice_xdp_rx_vlan_tag(const struct xdp_buff *xdp, __be16 *vlan_proto,
+			       u16 *vlan_tci)
+{
+	const struct ice_xdp_buff *xdp_ext =
+		container_of(xdp, struct ice_xdp_buff, xdp_buff);
+	const union ice_32b_rx_flex_desc *rx_desc = xdp_ext->eop_desc;
+
+	if (!(rx_desc->wb.status_error0 &
+	      cpu_to_le16(BIT(ICE_RX_FLEX_DESC_STATUS0_L2TAG1P_S))))
+		return -ENODATA;
+
+	*vlan_proto = htons(ETH_P_8021Q);
+	*vlan_tci = le16_to_cpu(rx_desc->wb.l2tag1);
+
+	return 0;
+}
+
+const struct xdp_metadata_ops ice_xdp_md_ops = {
+	.xmo_rx_hash		= ice_xdp_rx_hash,
+	.xmo_rx_vlan_tag	= ice_xdp_rx_vlan_tag,
+};
+
 /**
  * ice_rx_csum - Indicate in skb if checksum is good
  * @ring: the ring we care about
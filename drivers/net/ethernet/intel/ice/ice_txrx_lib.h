@@ -56,4 +56,6 @@ ice_process_skb_fields(struct ice_ring *rx_ring,
 		       struct sk_buff *skb, u8 ptype);
 void
 ice_receive_skb(struct ice_ring *rx_ring, struct sk_buff *skb, u16 vlan_tag);
+
+extern const struct xdp_metadata_ops ice_xdp_md_ops;
 #endif /* !_ICE_TXRX_LIB_H_ */
@@ -615,55 +615,66 @@ int ice_clean_rx_irq_zc(struct ice_ring *rx_ring, int budget)
 }
 
 /**
- * ice_xmit_zc - Completes AF_XDP entries, and cleans XDP entries
+ * ice_xmit_pkt - Fill a Tx descriptor for one AF_XDP frame
  * @xdp_ring: XDP Tx ring
- * @budget: max number of frames to xmit
- *
- * Returns true if cleanup/transmission is done.
+ * @desc: AF_XDP descriptor to send
+ * @ntu: index of the Tx descriptor to fill
  */
-static bool ice_xmit_zc(struct ice_ring *xdp_ring, int budget)
+static void
+ice_xmit_pkt(struct ice_ring *xdp_ring, struct xdp_desc *desc, u16 ntu)
 {
-	struct ice_tx_desc *tx_desc = NULL;
-	bool work_done = true;
-	struct xdp_desc desc;
+	struct ice_tx_desc *tx_desc;
 	dma_addr_t dma;
 
-	while (likely(budget-- > 0)) {
-		struct ice_tx_buf *tx_buf;
+	dma = xsk_buff_raw_get_dma(xdp_ring->xsk_pool, desc->addr);
+	xsk_buff_raw_dma_sync_for_device(xdp_ring->xsk_pool, dma, desc->len);
 
-		if (unlikely(!ICE_DESC_UNUSED(xdp_ring))) {
-			xdp_ring->tx_stats.tx_busy++;
-			work_done = false;
-			break;
-		}
+	xdp_ring->tx_buf[ntu].bytecount = desc->len;
 
-		tx_buf = &xdp_ring->tx_buf[xdp_ring->next_to_use];
-
-		if (!xsk_tx_peek_desc(xdp_ring->xsk_pool, &desc))
-			break;
-
-		dma = xsk_buff_raw_get_dma(xdp_ring->xsk_pool, desc.addr);
-		xsk_buff_raw_dma_sync_for_device(xdp_ring->xsk_pool, dma,
-						 desc.len);
+	tx_desc = ICE_TX_DESC(xdp_ring, ntu);
+	tx_desc->buf_addr = cpu_to_le64(dma);
+	tx_desc->cmd_type_offset_bsz =
+		ice_build_ctob(ICE_TXD_LAST_DESC_CMD, 0, desc->len, 0);
+}
 
-		tx_buf->bytecount = desc.len;
+/**
+ * ice_xmit_zc - Completes AF_XDP entries, and cleans XDP entries
+ * @xdp_ring: XDP Tx ring
+ * @budget: max number of frames to xmit
+ *
+ * Returns true if cleanup/transmission is done.
+ */
+static bool ice_xmit_zc(struct ice_ring *xdp_ring, int budget)
+{
+	struct xdp_desc *descs = xdp_ring->xsk_descs;
+	u16 ntu = xdp_ring->next_to_use;
+	u32 nb_pkts, i;
+
+	budget = min3(budget, ICE_DFLT_IRQ_WORK,
+		      (int)ICE_DESC_UNUSED(xdp_ring));
+	if (unlikely(!budget)) {
+		xdp_ring->tx_stats.tx_busy++;
+		return false;
+	}
 
-		tx_desc = ICE_TX_DESC(xdp_ring, xdp_ring->next_to_use);
-		tx_desc->buf_addr = cpu_to_le64(dma);
-		tx_desc->cmd_type_offset_bsz =
-			ice_build_ctob(ICE_TXD_LAST_DESC_CMD, 0, desc.len, 0);
+	/* Peeks, reserves completion slots and releases the whole batch in
+	 * one go instead of touching the rings once per frame.
+	 */
+	nb_pkts = xsk_tx_peek_release_desc_batch(xdp_ring->xsk_pool, descs,
+						 budget);
+	if (!nb_pkts)
+		return true;
 
-		xdp_ring->next_to_use++;
-		if (xdp_ring->next_to_use == xdp_ring->count)
-			xdp_ring->next_to_use = 0;
+	for (i = 0; i < nb_pkts; i++) {
+		ice_xmit_pkt(xdp_ring, &descs[i], ntu);
+		if (++ntu == xdp_ring->count)
+			ntu = 0;
 	}
 
-	if (tx_desc) {
-		ice_xdp_ring_update_tail(xdp_ring);
-		xsk_tx_release(xdp_ring->xsk_pool);
-	}
+	xdp_ring->next_to_use = ntu;
+	ice_xdp_ring_update_tail(xdp_ring);
 
-	return budget > 0 && work_done;
+	return nb_pkts < (u32)budget;
 }
 
 /**
@@ -4786,6 +4786,9 @@ static void mlx5e_build_nic_netdev(struct net_device *netdev)
 
 	netdev->watchdog_timeo    = 15 * HZ;
 
+	/* The LSO engine rewrites the IP length fields, BIG TCP is fine */
+	netif_set_tso_max_size(netdev, GSO_MAX_SIZE);
+
 	netdev->ethtool_ops	  = &mlx5e_ethtool_ops;
 
 	netdev->vlan_features    |= NETIF_F_SG;
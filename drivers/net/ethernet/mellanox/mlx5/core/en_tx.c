@@ -34,6 +34,7 @@
 #include <linux/if_vlan.h>
 #include <net/geneve.h>
 #include <net/dsfield.h>
+#include <net/ipv6.h>
 #include "en.h"
 #include "en/txrx.h"
 #include "ipoib/ipoib.h"
@@ -715,6 +716,12 @@ netdev_tx_t mlx5e_xmit(struct sk_buff *skb, struct net_device *dev)
 		return NETDEV_TX_OK;
 	}
 
+	/* The NIC does not expect the jumbo option of an IPv6 BIG TCP packet */
+	if (unlikely(ipv6_hopopt_jumbo_remove(skb))) {
+		dev_kfree_skb_any(skb);
+		return NETDEV_TX_OK;
+	}
+
 	/* May send SKBs and WQEs. */
 	if (unlikely(!mlx5e_accel_tx_begin(dev, sq, skb, &accel)))
 		return NETDEV_TX_OK;
@@ -255,6 +255,49 @@ static struct nvme_ns *nvme_round_robin_path(struct nvme_ns_head *head,
 	return found;
 }
 
+/*
+ * Expected time for a new request to complete on @ns: the requests already
+ * outstanding on the path plus the new one, times the average latency of
+ * the path.  A path without a latency sample yet costs nothing so that it
+ * gets probed.
+ */
+static inline u64 nvme_path_service_time(struct nvme_ns *ns)
+{
+	return (u64)(atomic_read(&ns->nr_inflight) + 1) *
+		atomic64_read(&ns->lat_ewma);
+}
+
+static struct nvme_ns *nvme_service_time_path(struct nvme_ns_head *head)
+{
+	u64 found_cost = U64_MAX, fallback_cost = U64_MAX, cost;
+	struct nvme_ns *found = NULL, *fallback = NULL, *ns;
+
+	list_for_each_entry_rcu(ns, &head->list, siblings) {
+		if (nvme_path_is_disabled(ns))
+			continue;
+
+		cost = nvme_path_service_time(ns);
+		switch (ns->ana_state) {
+		case NVME_ANA_OPTIMIZED:
+			if (cost < found_cost) {
+				found_cost = cost;
+				found = ns;
+			}
+			break;
+		case NVME_ANA_NONOPTIMIZED:
+			if (cost < fallback_cost) {
+				fallback_cost = cost;
+				fallback = ns;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	return found ? found : fallback;
+}
+
 static inline bool nvme_path_is_optimized(struct nvme_ns *ns)
 {
 	return ns->ctrl->state == NVME_CTRL_LIVE &&
@@ -266,6 +309,9 @@ inline struct nvme_ns *nvme_find_path(struct nvme_ns_head *head)
 	int node = numa_node_id();
 	struct nvme_ns *ns;
 
+	if (READ_ONCE(head->subsys->iopolicy) == NVME_IOPOLICY_ST)
+		return nvme_service_time_path(head);
+
 	ns = srcu_dereference(head->current_path[node], &head->srcu);
 	if (unlikely(!ns))
 		return __nvme_find_path(head, node);
@@ -277,6 +323,49 @@ inline struct nvme_ns *nvme_find_path(struct nvme_ns_head *head)
 	return ns;
 }
 
+/* weight of a new sample in the per-path latency average, 1 / 2^N */
+#define NVME_MPATH_LAT_EWMA_SHIFT	3
+
+void nvme_mpath_start_request(struct request *rq)
+{
+	struct nvme_ns *ns = rq->q->queuedata;
+
+	/* a requeued request is still accounted from its first start */
+	if (nvme_req(rq)->flags & NVME_MPATH_IO_STATS)
+		return;
+	nvme_req(rq)->flags |= NVME_MPATH_IO_STATS;
+	nvme_req(rq)->start_time = ktime_get_ns();
+	atomic_inc(&ns->nr_inflight);
+}
+EXPORT_SYMBOL_GPL(nvme_mpath_start_request);
+
+void nvme_mpath_end_request(struct request *rq)
+{
+	struct nvme_ns *ns = rq->q->queuedata;
+	s64 lat, old, new;
+
+	nvme_req(rq)->flags &= ~NVME_MPATH_IO_STATS;
+	atomic_dec(&ns->nr_inflight);
+
+	/*
+	 * Only sample commands that the controller completed successfully,
+	 * neither errors nor requests unwound before they were issued say
+	 * anything about how fast the path is.
+	 */
+	if (!blk_mq_request_completed(rq) || nvme_req(rq)->status)
+		return;
+
+	lat = ktime_get_ns() - nvme_req(rq)->start_time;
+	old = atomic64_read(&ns->lat_ewma);
+	do {
+		if (old)
+			new = old - (old >> NVME_MPATH_LAT_EWMA_SHIFT) +
+				(lat >> NVME_MPATH_LAT_EWMA_SHIFT);
+		else
+			new = lat;
+	} while (!atomic64_try_cmpxchg(&ns->lat_ewma, &old, new));
+}
+
 static bool nvme_available_path(struct nvme_ns_head *head)
 {
 	struct nvme_ns *ns;
@@ -664,6 +753,7 @@ void nvme_mpath_stop(struct nvme_ctrl *ctrl)
 static const char *nvme_iopolicy_names[] = {
 	[NVME_IOPOLICY_NUMA]	= "numa",
 	[NVME_IOPOLICY_RR]	= "round-robin",
+	[NVME_IOPOLICY_ST]	= "service-time",
 };
 
 static ssize_t nvme_subsys_iopolicy_show(struct device *dev,
@@ -711,6 +801,24 @@ static ssize_t ana_state_show(struct device *dev, struct device_attribute *attr,
 }
 DEVICE_ATTR_RO(ana_state);
 
+static ssize_t path_inflight_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%d\n",
+			  atomic_read(&nvme_get_ns_from_dev(dev)->nr_inflight));
+}
+DEVICE_ATTR_RO(path_inflight);
+
+static ssize_t path_latency_us_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct nvme_ns *ns = nvme_get_ns_from_dev(dev);
+
+	return sysfs_emit(buf, "%llu\n",
+			  div_u64(atomic64_read(&ns->lat_ewma), NSEC_PER_USEC));
+}
+DEVICE_ATTR_RO(path_latency_us);
+
 static int nvme_lookup_ana_group_desc(struct nvme_ctrl *ctrl,
 		struct nvme_ana_group_desc *desc, void *data)
 {
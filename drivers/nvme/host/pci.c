@@ -10,6 +10,7 @@
 #include <linux/blkdev.h>
 #include <linux/blk-mq.h>
 #include <linux/blk-mq-pci.h>
+#include <linux/dim.h>
 #include <linux/dmi.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
@@ -100,6 +101,25 @@ static bool noacpi;
 module_param(noacpi, bool, 0444);
 MODULE_PARM_DESC(noacpi, "disable acpi bios quirks");
 
+static bool irq_dim;
+module_param(irq_dim, bool, 0444);
+MODULE_PARM_DESC(irq_dim,
+	"adapt interrupt coalescing to the completions per interrupt");
+
+/*
+ * Interrupt coalescing profiles stepped through by rdma_dim() for irq_dim.
+ * The aggregation time is in 100us units, the threshold is 0's based.
+ * Coalescing is disabled on the vectors of queues at profile 0, so that
+ * low queue depths see no added latency.
+ */
+static const struct nvme_dim_profile {
+	u8 time;
+	u8 thr;
+} nvme_dim_profiles[RDMA_DIM_PARAMS_NUM_PROFILES] = {
+	{ 0, 0 }, { 1, 1 }, { 1, 3 }, { 1, 7 }, { 1, 15 },
+	{ 2, 15 }, { 2, 31 }, { 4, 31 }, { 4, 63 },
+};
+
 struct nvme_dev;
 struct nvme_queue;
 
@@ -128,6 +148,9 @@ struct nvme_dev {
 	unsigned long bar_mapped_size;
 	struct work_struct remove_work;
 	struct mutex shutdown_lock;
+	/* irq_dim: protects dim_profile and the vectors' dim_coalesced */
+	struct mutex dim_lock;
+	u8 dim_profile;
 	bool subsystem;
 	u64 cmb_size;
 	bool cmb_use_sqes;
@@ -214,6 +237,8 @@ struct nvme_queue {
 	u32 *dbbuf_sq_ei;
 	u32 *dbbuf_cq_ei;
 	struct completion delete_done;
+	struct dim dim;
+	bool dim_coalesced;
 };
 
 /*
@@ -952,7 +977,7 @@ static blk_status_t nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
 			goto out_unmap_data;
 	}
 
-	blk_mq_start_request(req);
+	nvme_start_request(req);
 	nvme_submit_cmd(nvmeq, cmnd, bd->last);
 	return BLK_STS_OK;
 out_unmap_data:
@@ -962,7 +987,7 @@ static blk_status_t nvme_queue_rq(struct blk_mq_hw_ctx *hctx,
 	return ret;
 }
 
-static void nvme_pci_complete_rq(struct request *req)
+static __always_inline void nvme_pci_unmap_rq(struct request *req)
 {
 	struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
 	struct nvme_dev *dev = iod->nvmeq->dev;
@@ -972,9 +997,19 @@ static void nvme_pci_complete_rq(struct request *req)
 			       rq_integrity_vec(req)->bv_len, rq_data_dir(req));
 	if (blk_rq_nr_phys_segments(req))
 		nvme_unmap_data(dev, req);
+}
+
+static void nvme_pci_complete_rq(struct request *req)
+{
+	nvme_pci_unmap_rq(req);
 	nvme_complete_rq(req);
 }
 
+static void nvme_pci_complete_batch(struct io_comp_batch *iob)
+{
+	nvme_complete_batch(iob, nvme_pci_unmap_rq);
+}
+
 /* We read the CQE phase first to check if the rest of the entry is valid */
 static inline bool nvme_cqe_pending(struct nvme_queue *nvmeq)
 {
@@ -999,7 +1034,8 @@ static inline struct blk_mq_tags *nvme_queue_tagset(struct nvme_queue *nvmeq)
 	return nvmeq->dev->tagset.tags[nvmeq->qid - 1];
 }
 
-static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
+static inline void nvme_handle_cqe(struct nvme_queue *nvmeq,
+				   struct io_comp_batch *iob, u16 idx)
 {
 	struct nvme_completion *cqe = &nvmeq->cqes[idx];
 	__u16 command_id = READ_ONCE(cqe->command_id);
@@ -1026,7 +1062,9 @@ static inline void nvme_handle_cqe(struct nvme_queue *nvmeq, u16 idx)
 	}
 
 	trace_nvme_sq(req, cqe->sq_head, nvmeq->sq_tail);
-	if (!nvme_try_complete_req(req, cqe->status, cqe->result))
+	if (!nvme_try_complete_req(req, cqe->status, cqe->result) &&
+	    !blk_mq_add_to_batch(req, iob, nvme_req(req)->status,
+				 nvme_pci_complete_batch))
 		nvme_pci_complete_rq(req);
 }
 
@@ -1042,7 +1080,8 @@ static inline void nvme_update_cq_head(struct nvme_queue *nvmeq)
 	}
 }
 
-static inline int nvme_process_cq(struct nvme_queue *nvmeq)
+static inline int nvme_poll_cq(struct nvme_queue *nvmeq,
+			       struct io_comp_batch *iob)
 {
 	int found = 0;
 
@@ -1053,7 +1092,7 @@ static inline int nvme_process_cq(struct nvme_queue *nvmeq)
 		 * the cqe requires a full read memory barrier
 		 */
 		dma_rmb();
-		nvme_handle_cqe(nvmeq, nvmeq->cq_head);
+		nvme_handle_cqe(nvmeq, iob, nvmeq->cq_head);
 		nvme_update_cq_head(nvmeq);
 	}
 
@@ -1062,15 +1101,83 @@ static inline int nvme_process_cq(struct nvme_queue *nvmeq)
 	return found;
 }
 
+static inline int nvme_process_cq(struct nvme_queue *nvmeq)
+{
+	DEFINE_IO_COMP_BATCH(iob);
+	int found;
+
+	found = nvme_poll_cq(nvmeq, &iob);
+	if (!list_empty(&iob.req_list))
+		iob.complete(&iob);
+	return found;
+}
+
 static irqreturn_t nvme_irq(int irq, void *data)
 {
 	struct nvme_queue *nvmeq = data;
+	int found;
 
-	if (nvme_process_cq(nvmeq))
-		return IRQ_HANDLED;
-	return IRQ_NONE;
+	found = nvme_process_cq(nvmeq);
+	if (!found)
+		return IRQ_NONE;
+
+	/* vector 0 is shared with the admin queue, which can't coalesce */
+	if (irq_dim && nvmeq->cq_vector)
+		rdma_dim(&nvmeq->dim, found);
+	return IRQ_HANDLED;
+}
+
+/*
+ * Coalescing parameters are controller wide, they follow the queue with the
+ * highest profile.  Coalescing is then switched off for the vectors of all
+ * queues at profile 0.
+ */
+static void nvme_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct nvme_dev *dev = container_of(dim, struct nvme_queue, dim)->dev;
+	const struct nvme_dim_profile *p;
+	unsigned int i;
+	u8 profile = 0;
+
+	mutex_lock(&dev->dim_lock);
+	if (dev->ctrl.state != NVME_CTRL_LIVE)
+		goto out;
+
+	for (i = 1; i < dev->online_queues; i++)
+		profile = max(profile, dev->queues[i].dim.profile_ix);
+
+	if (profile != dev->dim_profile) {
+		p = &nvme_dim_profiles[profile];
+		if (nvme_set_features(&dev->ctrl, NVME_FEAT_IRQ_COALESCE,
+				      p->time << 8 | p->thr, NULL, 0, NULL))
+			goto out;
+		dev->dim_profile = profile;
+	}
+
+	for (i = 1; i < dev->online_queues; i++) {
+		struct nvme_queue *nvmeq = &dev->queues[i];
+		bool coalesce = nvmeq->dim.profile_ix;
+		u32 dword11 = nvmeq->cq_vector;
+
+		if (test_bit(NVMEQ_POLLED, &nvmeq->flags) ||
+		    !nvmeq->cq_vector || nvmeq->dim_coalesced == coalesce)
+			continue;
+
+		/* Interrupt Vector Configuration, bit 16 disables coalescing */
+		if (!coalesce)
+			dword11 |= 1 << 16;
+		if (nvme_set_features(&dev->ctrl, NVME_FEAT_IRQ_CONFIG, dword11,
+				      NULL, 0, NULL))
+			break;
+		nvmeq->dim_coalesced = coalesce;
+	}
+out:
+	mutex_unlock(&dev->dim_lock);
+	dim->state = DIM_START_MEASURE;
 }
 
+
 static irqreturn_t nvme_irq_check(int irq, void *data)
 {
 	struct nvme_queue *nvmeq = data;
@@ -1098,15 +1205,20 @@ static void nvme_poll_irqdisable(struct nvme_queue *nvmeq)
 static int nvme_poll(struct blk_mq_hw_ctx *hctx)
 {
 	struct nvme_queue *nvmeq = hctx->driver_data;
+	DEFINE_IO_COMP_BATCH(iob);
 	bool found;
 
 	if (!nvme_cqe_pending(nvmeq))
 		return 0;
 
 	spin_lock(&nvmeq->cq_poll_lock);
-	found = nvme_process_cq(nvmeq);
+	found = nvme_poll_cq(nvmeq, &iob);
 	spin_unlock(&nvmeq->cq_poll_lock);
 
+	/* the requests are ours now, end them outside of the lock */
+	if (!list_empty(&iob.req_list))
+		iob.complete(&iob);
+
 	return found;
 }
 
@@ -1366,6 +1478,11 @@ static enum blk_eh_timer_return nvme_timeout(struct request *req, bool reserved)
 
 static void nvme_free_queue(struct nvme_queue *nvmeq)
 {
+	/*
+	 * The work only sends admin commands to a live controller, and the
+	 * admin queue is gone by the time the last queues are freed.
+	 */
+	cancel_work_sync(&nvmeq->dim.work);
 	dma_free_coherent(nvmeq->dev->dev, CQ_SIZE(nvmeq),
 				(void *)nvmeq->cqes, nvmeq->cq_dma_addr);
 	if (!nvmeq->sq_cmds)
@@ -1522,6 +1639,7 @@ static int nvme_alloc_queue(struct nvme_dev *dev, int qid, int depth)
 	nvmeq->cq_phase = 1;
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
 	nvmeq->qid = qid;
+	INIT_WORK(&nvmeq->dim.work, nvme_dim_work);
 	dev->ctrl.queue_count++;
 
 	return 0;
@@ -1558,6 +1676,11 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
 	memset((void *)nvmeq->cqes, 0, CQ_SIZE(nvmeq));
 	nvme_dbbuf_init(dev, nvmeq, qid);
+	/* a reset controller coalesces on every vector, with a zero setting */
+	nvmeq->dim.state = DIM_START_MEASURE;
+	nvmeq->dim.tune_state = DIM_GOING_RIGHT;
+	nvmeq->dim.profile_ix = RDMA_DIM_START_PROFILE;
+	nvmeq->dim_coalesced = true;
 	dev->online_queues++;
 	wmb(); /* ensure the first interrupt sees the initialization */
 }
@@ -2609,6 +2732,10 @@ static void nvme_reset_work(struct work_struct *work)
 	if (result)
 		goto out_unlock;
 
+	mutex_lock(&dev->dim_lock);
+	dev->dim_profile = 0;
+	mutex_unlock(&dev->dim_lock);
+
 	result = nvme_pci_configure_admin_queue(dev);
 	if (result)
 		goto out_unlock;
@@ -2918,6 +3045,7 @@ static int nvme_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	INIT_WORK(&dev->ctrl.reset_work, nvme_reset_work);
 	INIT_WORK(&dev->remove_work, nvme_remove_dead_ctrl_work);
 	mutex_init(&dev->shutdown_lock);
+	mutex_init(&dev->dim_lock);
 
 	result = nvme_setup_prp_pools(dev);
 	if (result)
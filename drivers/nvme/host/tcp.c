@@ -1117,6 +1117,8 @@ static int nvme_tcp_try_recv(struct nvme_tcp_queue *queue)
 	rd_desc.arg.data = queue;
 	rd_desc.count = 1;
 	lock_sock(sk);
+	/* let RFS steer the flow to the CPU running io_work */
+	sock_rps_record_flow(sk);
 	queue->nr_cqe = 0;
 	consumed = sock->ops->read_sock(sk, &rd_desc, nvme_tcp_recv_skb);
 	release_sock(sk);
@@ -1370,16 +1372,35 @@ static bool nvme_tcp_poll_queue(struct nvme_tcp_queue *queue)
 static void nvme_tcp_set_queue_io_cpu(struct nvme_tcp_queue *queue)
 {
 	struct nvme_tcp_ctrl *ctrl = queue->ctrl;
+	struct blk_mq_queue_map *map = NULL;
 	int qid = nvme_tcp_queue_id(queue);
-	int n = 0;
+	int n = 0, cpu;
 
-	if (nvme_tcp_default_queue(queue))
+	if (nvme_tcp_default_queue(queue)) {
 		n = qid - 1;
-	else if (nvme_tcp_read_queue(queue))
+		map = &ctrl->tag_set.map[HCTX_TYPE_DEFAULT];
+	} else if (nvme_tcp_read_queue(queue)) {
 		n = qid - ctrl->io_queues[HCTX_TYPE_DEFAULT] - 1;
-	else if (nvme_tcp_poll_queue(queue))
+		map = &ctrl->tag_set.map[HCTX_TYPE_READ];
+	} else if (nvme_tcp_poll_queue(queue)) {
 		n = qid - ctrl->io_queues[HCTX_TYPE_DEFAULT] -
 				ctrl->io_queues[HCTX_TYPE_READ] - 1;
+		map = &ctrl->tag_set.map[HCTX_TYPE_POLL];
+	}
+
+	/*
+	 * Once the tag set is mapped, run io_work on a CPU that submits to
+	 * this queue: submissions can then be sent inline from ->queue_rq
+	 * and RFS steers the socket's receive processing to the same core.
+	 */
+	if (map && map->mq_map && map->nr_queues) {
+		for_each_online_cpu(cpu) {
+			if (map->mq_map[cpu] == qid - 1) {
+				queue->io_cpu = cpu;
+				return;
+			}
+		}
+	}
 	queue->io_cpu = cpumask_next_wrap(n - 1, cpu_online_mask, -1, false);
 }
 
@@ -1558,10 +1579,12 @@ static int nvme_tcp_start_queue(struct nvme_ctrl *nctrl, int idx)
 	struct nvme_tcp_ctrl *ctrl = to_tcp_ctrl(nctrl);
 	int ret;
 
-	if (idx)
+	if (idx) {
+		nvme_tcp_set_queue_io_cpu(&ctrl->queues[idx]);
 		ret = nvmf_connect_io_queue(nctrl, idx, false);
-	else
+	} else {
 		ret = nvmf_connect_admin_queue(nctrl);
+	}
 
 	if (!ret) {
 		set_bit(NVME_TCP_Q_LIVE, &ctrl->queues[idx].flags);
@@ -2346,7 +2369,7 @@ static blk_status_t nvme_tcp_queue_rq(struct blk_mq_hw_ctx *hctx,
 	if (unlikely(ret))
 		return ret;
 
-	blk_mq_start_request(rq);
+	nvme_start_request(rq);
 
 	nvme_tcp_queue_request(req, true, bd->last);
 
@@ -30,6 +30,7 @@
 #include <linux/interval_tree_generic.h>
 #include <linux/nospec.h>
 #include <linux/kcov.h>
+#include <linux/idr.h>
 
 #include "vhost.h"
 
@@ -187,12 +188,14 @@ EXPORT_SYMBOL_GPL(vhost_work_init);
 
 /* Init poll structure */
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
-		     __poll_t mask, struct vhost_dev *dev)
+		     __poll_t mask, struct vhost_dev *dev,
+		     struct vhost_virtqueue *vq)
 {
 	init_waitqueue_func_entry(&poll->wait, vhost_poll_wakeup);
 	init_poll_funcptr(&poll->table, vhost_poll_func);
 	poll->mask = mask;
 	poll->dev = dev;
+	poll->vq = vq;
 	poll->wqh = NULL;
 
 	vhost_work_init(&poll->work, fn);
@@ -231,17 +234,36 @@ void vhost_poll_stop(struct vhost_poll *poll)
 }
 EXPORT_SYMBOL_GPL(vhost_poll_stop);
 
-void vhost_work_flush(struct vhost_dev *dev, struct vhost_work *work)
+static void vhost_worker_queue(struct vhost_worker *worker,
+			       struct vhost_work *work)
+{
+	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
+		/* We can only add the work to the list after we're
+		 * sure it was not in the list.
+		 * test_and_set_bit() implies a memory barrier.
+		 */
+		llist_add(&work->node, &worker->work_list);
+		wake_up_process(worker->task);
+	}
+}
+
+static void vhost_worker_flush(struct vhost_worker *worker)
 {
 	struct vhost_flush_struct flush;
 
-	if (dev->worker) {
-		init_completion(&flush.wait_event);
-		vhost_work_init(&flush.work, vhost_flush_work);
+	init_completion(&flush.wait_event);
+	vhost_work_init(&flush.work, vhost_flush_work);
 
-		vhost_work_queue(dev, &flush.work);
-		wait_for_completion(&flush.wait_event);
-	}
+	vhost_worker_queue(worker, &flush.work);
+	wait_for_completion(&flush.wait_event);
+}
+
+static void vhost_worker_put(struct vhost_worker *worker);
+
+void vhost_work_flush(struct vhost_dev *dev, struct vhost_work *work)
+{
+	if (dev->worker)
+		vhost_worker_flush(dev->worker);
 }
 EXPORT_SYMBOL_GPL(vhost_work_flush);
 
@@ -249,7 +271,26 @@ EXPORT_SYMBOL_GPL(vhost_work_flush);
  * locks that are also used by the callback. */
 void vhost_poll_flush(struct vhost_poll *poll)
 {
-	vhost_work_flush(poll->dev, &poll->work);
+	struct vhost_worker *worker;
+
+	if (!poll->vq) {
+		vhost_work_flush(poll->dev, &poll->work);
+		return;
+	}
+
+	/* The virtqueue holds a reference until a grace period after it
+	 * stopped pointing to the worker, so it is safe to take one more.
+	 */
+	rcu_read_lock();
+	worker = rcu_dereference(poll->vq->worker);
+	if (worker)
+		refcount_inc(&worker->refcount);
+	rcu_read_unlock();
+
+	if (worker) {
+		vhost_worker_flush(worker);
+		vhost_worker_put(worker);
+	}
 }
 EXPORT_SYMBOL_GPL(vhost_poll_flush);
 
@@ -258,27 +299,71 @@ void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work)
 	if (!dev->worker)
 		return;
 
-	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
-		/* We can only add the work to the list after we're
-		 * sure it was not in the list.
-		 * test_and_set_bit() implies a memory barrier.
-		 */
-		llist_add(&work->node, &dev->work_list);
-		wake_up_process(dev->worker);
-	}
+	vhost_worker_queue(dev->worker, work);
 }
 EXPORT_SYMBOL_GPL(vhost_work_queue);
 
+/* Queue @work on the worker @vq is attached to */
+void vhost_vq_work_queue(struct vhost_virtqueue *vq, struct vhost_work *work)
+{
+	struct vhost_worker *worker;
+
+	rcu_read_lock();
+	worker = rcu_dereference(vq->worker);
+	if (worker)
+		vhost_worker_queue(worker, work);
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL_GPL(vhost_vq_work_queue);
+
 /* A lockless hint for busy polling code to exit the loop */
 bool vhost_has_work(struct vhost_dev *dev)
 {
-	return !llist_empty(&dev->work_list);
+	return dev->worker && !llist_empty(&dev->worker->work_list);
 }
 EXPORT_SYMBOL_GPL(vhost_has_work);
 
+/* Same as vhost_has_work() for the worker serving @vq, which may also run
+ * the virtqueues of other devices.
+ */
+bool vhost_vq_has_work(struct vhost_virtqueue *vq)
+{
+	struct vhost_worker *worker;
+	bool has_work;
+
+	rcu_read_lock();
+	worker = rcu_dereference(vq->worker);
+	has_work = worker && !llist_empty(&worker->work_list);
+	rcu_read_unlock();
+
+	return has_work;
+}
+EXPORT_SYMBOL_GPL(vhost_vq_has_work);
+
+/* Busy polling time of @vq in us, capped by the budget of its worker so
+ * that one virtqueue cannot starve the others sharing the thread.
+ */
+u32 vhost_vq_busyloop_timeout(struct vhost_virtqueue *vq)
+{
+	struct vhost_worker *worker;
+	u32 timeout = vq->busyloop_timeout;
+
+	rcu_read_lock();
+	worker = rcu_dereference(vq->worker);
+	if (worker && worker->busyloop_budget)
+		timeout = min(timeout, worker->busyloop_budget);
+	rcu_read_unlock();
+
+	return timeout;
+}
+EXPORT_SYMBOL_GPL(vhost_vq_busyloop_timeout);
+
 void vhost_poll_queue(struct vhost_poll *poll)
 {
-	vhost_work_queue(poll->dev, &poll->work);
+	if (poll->vq)
+		vhost_vq_work_queue(poll->vq, &poll->work);
+	else
+		vhost_work_queue(poll->dev, &poll->work);
 }
 EXPORT_SYMBOL_GPL(vhost_poll_queue);
 
@@ -343,11 +428,11 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 
 static int vhost_worker(void *data)
 {
-	struct vhost_dev *dev = data;
+	struct vhost_worker *worker = data;
 	struct vhost_work *work, *work_next;
 	struct llist_node *node;
 
-	kthread_use_mm(dev->mm);
+	kthread_use_mm(worker->mm);
 
 	for (;;) {
 		/* mb paired w/ kthread_stop */
@@ -358,7 +443,7 @@ static int vhost_worker(void *data)
 			break;
 		}
 
-		node = llist_del_all(&dev->work_list);
+		node = llist_del_all(&worker->work_list);
 		if (!node)
 			schedule();
 
@@ -368,14 +453,14 @@ static int vhost_worker(void *data)
 		llist_for_each_entry_safe(work, work_next, node, node) {
 			clear_bit(VHOST_WORK_QUEUED, &work->flags);
 			__set_current_state(TASK_RUNNING);
-			kcov_remote_start_common(dev->kcov_handle);
+			kcov_remote_start_common(worker->kcov_handle);
 			work->fn(work);
 			kcov_remote_stop();
 			if (need_resched())
 				schedule();
 		}
 	}
-	kthread_unuse_mm(dev->mm);
+	kthread_unuse_mm(worker->mm);
 	return 0;
 }
 
@@ -482,12 +567,13 @@ void vhost_dev_init(struct vhost_dev *dev,
 	dev->iotlb = NULL;
 	dev->mm = NULL;
 	dev->worker = NULL;
+	INIT_LIST_HEAD(&dev->workers);
+	dev->nworkers = 0;
 	dev->iov_limit = iov_limit;
 	dev->weight = weight;
 	dev->byte_weight = byte_weight;
 	dev->use_worker = use_worker;
 	dev->msg_handler = msg_handler;
-	init_llist_head(&dev->work_list);
 	init_waitqueue_head(&dev->wait);
 	INIT_LIST_HEAD(&dev->read_list);
 	INIT_LIST_HEAD(&dev->pending_list);
@@ -500,11 +586,12 @@ void vhost_dev_init(struct vhost_dev *dev,
 		vq->indirect = NULL;
 		vq->heads = NULL;
 		vq->dev = dev;
+		RCU_INIT_POINTER(vq->worker, NULL);
 		mutex_init(&vq->mutex);
 		vhost_vq_reset(dev, vq);
 		if (vq->handle_kick)
 			vhost_poll_init(&vq->poll, vq->handle_kick,
-					EPOLLIN, dev);
+					EPOLLIN, dev, vq);
 	}
 }
 EXPORT_SYMBOL_GPL(vhost_dev_init);
@@ -531,17 +618,264 @@ static void vhost_attach_cgroups_work(struct vhost_work *work)
 	s->ret = cgroup_attach_task_all(s->owner, current);
 }
 
-static int vhost_attach_cgroups(struct vhost_dev *dev)
+static int vhost_attach_cgroups(struct vhost_worker *worker)
 {
 	struct vhost_attach_cgroups_struct attach;
 
 	attach.owner = current;
 	vhost_work_init(&attach.work, vhost_attach_cgroups_work);
-	vhost_work_queue(dev, &attach.work);
-	vhost_work_flush(dev, &attach.work);
+	vhost_worker_queue(worker, &attach.work);
+	vhost_worker_flush(worker);
 	return attach.ret;
 }
 
+/* All workers, looked up by id when a virtqueue is attached to one */
+static DEFINE_IDR(vhost_workers);
+static DEFINE_MUTEX(vhost_workers_lock);
+
+static void vhost_worker_destroy(struct vhost_worker *worker)
+{
+	WARN_ON(!llist_empty(&worker->work_list));
+	kthread_stop(worker->task);
+	mmput(worker->mm);
+	kfree(worker);
+}
+
+static void vhost_worker_put(struct vhost_worker *worker)
+{
+	if (!refcount_dec_and_mutex_lock(&worker->refcount,
+					 &vhost_workers_lock))
+		return;
+
+	idr_remove(&vhost_workers, worker->id);
+	mutex_unlock(&vhost_workers_lock);
+	vhost_worker_destroy(worker);
+}
+
+/* Caller should have device mutex */
+static struct vhost_worker *vhost_worker_create(struct vhost_dev *dev,
+						int cpu, u32 busyloop_budget)
+{
+	struct vhost_worker *worker;
+	struct task_struct *task;
+	int id, ret;
+
+	worker = kzalloc(sizeof(*worker), GFP_KERNEL_ACCOUNT);
+	if (!worker)
+		return ERR_PTR(-ENOMEM);
+
+	init_llist_head(&worker->work_list);
+	refcount_set(&worker->refcount, 1);
+	worker->mm = dev->mm;
+	mmget(worker->mm);
+	worker->kcov_handle = dev->kcov_handle;
+	worker->busyloop_budget = busyloop_budget;
+
+	/* Reserve the id, the worker is published once it is running */
+	mutex_lock(&vhost_workers_lock);
+	id = idr_alloc(&vhost_workers, NULL, 0, INT_MAX, GFP_KERNEL);
+	mutex_unlock(&vhost_workers_lock);
+	if (id < 0) {
+		ret = id;
+		goto err_id;
+	}
+	worker->id = id;
+
+	task = kthread_create(vhost_worker, worker, "vhost-%d", current->pid);
+	if (IS_ERR(task)) {
+		ret = PTR_ERR(task);
+		goto err_task;
+	}
+	worker->task = task;
+
+	if (cpu >= 0) {
+		ret = set_cpus_allowed_ptr(task, cpumask_of(cpu));
+		if (ret)
+			goto err_start;
+	}
+	wake_up_process(task); /* avoid contributing to loadavg */
+
+	ret = vhost_attach_cgroups(worker);
+	if (ret)
+		goto err_start;
+
+	mutex_lock(&vhost_workers_lock);
+	idr_replace(&vhost_workers, worker, id);
+	mutex_unlock(&vhost_workers_lock);
+
+	list_add_tail(&worker->node, &dev->workers);
+	dev->nworkers++;
+	return worker;
+
+err_start:
+	kthread_stop(task);
+err_task:
+	mutex_lock(&vhost_workers_lock);
+	idr_remove(&vhost_workers, id);
+	mutex_unlock(&vhost_workers_lock);
+err_id:
+	mmput(worker->mm);
+	kfree(worker);
+	return ERR_PTR(ret);
+}
+
+/* Takes a reference to worker @id, which must run in the address space of
+ * @dev: that is what lets the devices of one owner share their workers.
+ * A shared worker stays in the cgroups of the owner that created it.
+ */
+static struct vhost_worker *vhost_worker_get(struct vhost_dev *dev, u32 id)
+{
+	struct vhost_worker *worker;
+
+	mutex_lock(&vhost_workers_lock);
+	worker = idr_find(&vhost_workers, id);
+	if (worker && worker->mm == dev->mm)
+		refcount_inc(&worker->refcount);
+	else
+		worker = NULL;
+	mutex_unlock(&vhost_workers_lock);
+
+	return worker;
+}
+
+/* Caller should have device mutex */
+static void vhost_workers_free(struct vhost_dev *dev)
+{
+	struct vhost_worker *worker, *tmp;
+	int i;
+
+	/* The backends are stopped and flushed, nothing queues works for
+	 * the virtqueues anymore.
+	 */
+	for (i = 0; i < dev->nvqs; ++i) {
+		worker = rcu_dereference_protected(dev->vqs[i]->worker, 1);
+		if (!worker)
+			continue;
+		RCU_INIT_POINTER(dev->vqs[i]->worker, NULL);
+		vhost_worker_put(worker);
+	}
+
+	list_for_each_entry_safe(worker, tmp, &dev->workers, node) {
+		list_del_init(&worker->node);
+		vhost_worker_put(worker);
+	}
+	dev->nworkers = 0;
+	dev->worker = NULL;
+}
+
+/* Caller should have device mutex */
+static long vhost_vq_attach_worker(struct vhost_virtqueue *vq, u32 id)
+{
+	struct vhost_worker *worker, *old;
+
+	worker = vhost_worker_get(vq->dev, id);
+	if (!worker)
+		return -ENOENT;
+
+	mutex_lock(&vq->mutex);
+	old = rcu_dereference_protected(vq->worker,
+					lockdep_is_held(&vq->mutex));
+	rcu_assign_pointer(vq->worker, worker);
+	mutex_unlock(&vq->mutex);
+
+	if (old) {
+		/* Once nobody can queue on the old worker anymore, let it
+		 * finish what it has so the works of the virtqueue do not
+		 * run on both threads for longer than needed.
+		 */
+		synchronize_rcu();
+		vhost_worker_flush(old);
+		vhost_worker_put(old);
+	}
+
+	return 0;
+}
+
+/* Caller should have device mutex */
+static long vhost_vring_worker_ioctl(struct vhost_dev *dev,
+				     struct vhost_virtqueue *vq,
+				     unsigned int ioctl, void __user *argp)
+{
+	struct vhost_vring_worker ring_worker;
+	struct vhost_worker *worker;
+
+	if (!dev->use_worker)
+		return -EOPNOTSUPP;
+	if (copy_from_user(&ring_worker, argp, sizeof(ring_worker)))
+		return -EFAULT;
+
+	if (ioctl == VHOST_ATTACH_VRING_WORKER)
+		return vhost_vq_attach_worker(vq, ring_worker.worker_id);
+
+	worker = rcu_dereference_protected(vq->worker,
+					   lockdep_is_held(&dev->mutex));
+	if (!worker)
+		return -EINVAL;
+
+	ring_worker.worker_id = worker->id;
+	if (copy_to_user(argp, &ring_worker, sizeof(ring_worker)))
+		return -EFAULT;
+	return 0;
+}
+
+/* Caller should have device mutex */
+static long vhost_worker_ioctl(struct vhost_dev *dev, unsigned int ioctl,
+			       void __user *argp)
+{
+	struct vhost_worker_state state;
+	struct vhost_worker *worker;
+
+	if (!dev->use_worker)
+		return -EOPNOTSUPP;
+	if (copy_from_user(&state, argp, sizeof(state)))
+		return -EFAULT;
+
+	switch (ioctl) {
+	case VHOST_NEW_WORKER:
+		if (state.cpu != -1 &&
+		    (state.cpu < 0 || state.cpu >= nr_cpu_ids ||
+		     !cpu_online(state.cpu)))
+			return -EINVAL;
+		/* One worker per virtqueue is as parallel as it gets */
+		if (dev->nworkers > dev->nvqs)
+			return -EMFILE;
+
+		worker = vhost_worker_create(dev, state.cpu,
+					     state.busyloop_budget);
+		if (IS_ERR(worker))
+			return PTR_ERR(worker);
+
+		state.worker_id = worker->id;
+		if (copy_to_user(argp, &state, sizeof(state)))
+			return -EFAULT;
+		return 0;
+	case VHOST_FREE_WORKER:
+		list_for_each_entry(worker, &dev->workers, node) {
+			if (worker->id != state.worker_id)
+				continue;
+			if (worker == dev->worker)
+				return -EBUSY;
+
+			/* Virtqueues only attach under vhost_workers_lock */
+			mutex_lock(&vhost_workers_lock);
+			if (refcount_read(&worker->refcount) != 1) {
+				mutex_unlock(&vhost_workers_lock);
+				return -EBUSY;
+			}
+			idr_remove(&vhost_workers, worker->id);
+			mutex_unlock(&vhost_workers_lock);
+
+			list_del(&worker->node);
+			dev->nworkers--;
+			vhost_worker_destroy(worker);
+			return 0;
+		}
+		return -ENOENT;
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
 /* Caller should have device mutex */
 bool vhost_dev_has_owner(struct vhost_dev *dev)
 {
@@ -582,8 +916,8 @@ static void vhost_detach_mm(struct vhost_dev *dev)
 /* Caller should have device mutex */
 long vhost_dev_set_owner(struct vhost_dev *dev)
 {
-	struct task_struct *worker;
-	int err;
+	struct vhost_worker *worker;
+	int err, i;
 
 	/* Is there an owner already? */
 	if (vhost_dev_has_owner(dev)) {
@@ -595,31 +929,26 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 
 	dev->kcov_handle = kcov_common_handle();
 	if (dev->use_worker) {
-		worker = kthread_create(vhost_worker, dev,
-					"vhost-%d", current->pid);
+		worker = vhost_worker_create(dev, -1, 0);
 		if (IS_ERR(worker)) {
 			err = PTR_ERR(worker);
 			goto err_worker;
 		}
 
 		dev->worker = worker;
-		wake_up_process(worker); /* avoid contributing to loadavg */
-
-		err = vhost_attach_cgroups(dev);
-		if (err)
-			goto err_cgroup;
+		for (i = 0; i < dev->nvqs; ++i) {
+			refcount_inc(&worker->refcount);
+			rcu_assign_pointer(dev->vqs[i]->worker, worker);
+		}
 	}
 
 	err = vhost_dev_alloc_iovecs(dev);
 	if (err)
-		goto err_cgroup;
+		goto err_iovecs;
 
 	return 0;
-err_cgroup:
-	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
-	}
+err_iovecs:
+	vhost_workers_free(dev);
 err_worker:
 	vhost_detach_mm(dev);
 	dev->kcov_handle = 0;
@@ -712,12 +1041,8 @@ void vhost_dev_cleanup(struct vhost_dev *dev)
 	dev->iotlb = NULL;
 	vhost_clear_msg(dev);
 	wake_up_interruptible_poll(&dev->wait, EPOLLIN | EPOLLRDNORM);
-	WARN_ON(!llist_empty(&dev->work_list));
-	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
-		dev->kcov_handle = 0;
-	}
+	vhost_workers_free(dev);
+	dev->kcov_handle = 0;
 	vhost_detach_mm(dev);
 }
 EXPORT_SYMBOL_GPL(vhost_dev_cleanup);
@@ -1600,6 +1925,11 @@ long vhost_vring_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *arg
 		return vhost_vring_set_num_addr(d, vq, ioctl, argp);
 	}
 
+	/* Attaching a worker flushes the old one, without the vq mutex */
+	if (ioctl == VHOST_ATTACH_VRING_WORKER ||
+	    ioctl == VHOST_GET_VRING_WORKER)
+		return vhost_vring_worker_ioctl(d, vq, ioctl, argp);
+
 	mutex_lock(&vq->mutex);
 
 	switch (ioctl) {
@@ -1758,6 +2088,10 @@ long vhost_dev_ioctl(struct vhost_dev *d, unsigned int ioctl, void __user *argp)
 		goto done;
 
 	switch (ioctl) {
+	case VHOST_NEW_WORKER:
+	case VHOST_FREE_WORKER:
+		r = vhost_worker_ioctl(d, ioctl, argp);
+		break;
 	case VHOST_SET_MEM_TABLE:
 		r = vhost_set_memory(d, argp);
 		break;
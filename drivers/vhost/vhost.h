@@ -12,6 +12,7 @@
 #include <linux/virtio_config.h>
 #include <linux/virtio_ring.h>
 #include <linux/atomic.h>
+#include <linux/refcount.h>
 #include <linux/vhost_iotlb.h>
 #include <linux/irqbypass.h>
 
@@ -25,6 +26,23 @@ struct vhost_work {
 	unsigned long		  flags;
 };
 
+/* A kthread running the works of the virtqueues attached to it.  Workers
+ * are shared between all devices owned by the same address space.
+ */
+struct vhost_worker {
+	struct task_struct	  *task;
+	struct llist_head	  work_list;
+	struct mm_struct	  *mm;
+	u64			  kcov_handle;
+	u32			  id;
+	/* Cap in us on busy polling by the virtqueues, 0 for none */
+	u32			  busyloop_budget;
+	/* One for the creating device, one per attached virtqueue */
+	refcount_t		  refcount;
+	/* Entry in the workers list of the creating device */
+	struct list_head	  node;
+};
+
 /* Poll a file (eventfd or socket) */
 /* Note: there's nothing vhost specific about this structure. */
 struct vhost_poll {
@@ -34,14 +52,20 @@ struct vhost_poll {
 	struct vhost_work	  work;
 	__poll_t		  mask;
 	struct vhost_dev	 *dev;
+	/* Virtqueue whose worker runs @work, NULL for the device worker */
+	struct vhost_virtqueue	 *vq;
 };
 
 void vhost_work_init(struct vhost_work *work, vhost_work_fn_t fn);
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work);
 bool vhost_has_work(struct vhost_dev *dev);
+void vhost_vq_work_queue(struct vhost_virtqueue *vq, struct vhost_work *work);
+bool vhost_vq_has_work(struct vhost_virtqueue *vq);
+u32 vhost_vq_busyloop_timeout(struct vhost_virtqueue *vq);
 
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
-		     __poll_t mask, struct vhost_dev *dev);
+		     __poll_t mask, struct vhost_dev *dev,
+		     struct vhost_virtqueue *vq);
 int vhost_poll_start(struct vhost_poll *poll, struct file *file);
 void vhost_poll_stop(struct vhost_poll *poll);
 void vhost_poll_flush(struct vhost_poll *poll);
@@ -69,6 +93,8 @@ struct vhost_vring_call {
 /* The virtqueue structure describes a queue attached to a device. */
 struct vhost_virtqueue {
 	struct vhost_dev *dev;
+	/* Changed with both the device and the virtqueue mutex held */
+	struct vhost_worker __rcu *worker;
 
 	/* The actual ring of buffers. */
 	struct mutex mutex;
@@ -149,8 +175,11 @@ struct vhost_dev {
 	struct vhost_virtqueue **vqs;
 	int nvqs;
 	struct eventfd_ctx *log_ctx;
-	struct llist_head work_list;
-	struct task_struct *worker;
+	/* Default worker, serving the device's own works */
+	struct vhost_worker *worker;
+	/* Workers created by this device, including the default one */
+	struct list_head workers;
+	int nworkers;
 	struct vhost_iotlb *umem;
 	struct vhost_iotlb *iotlb;
 	spinlock_t iotlb_lock;
@@ -42,6 +42,12 @@ module_param(bbm_safe_unplug, bool, 0444);
 MODULE_PARM_DESC(bbm_safe_unplug,
 	     "Use a safe unplug mechanism in BBM, avoiding long/endless loops");
 
+static bool memmap_on_memory = true;
+module_param(memmap_on_memory, bool, 0444);
+MODULE_PARM_DESC(memmap_on_memory,
+		 "Allocate the memmap of big blocks from the blocks themselves, "
+		 "if memory_hotplug.memmap_on_memory allows it. Default is 1");
+
 /*
  * virtio-mem currently supports the following modes of operation:
  *
@@ -207,6 +213,9 @@ struct virtio_mem {
 
 			/* The block size used for plugging/adding/removing. */
 			uint64_t bb_size;
+
+			/* Big blocks are added with MHP_MEMMAP_ON_MEMORY. */
+			bool memmap_on_memory;
 		} bbm;
 	};
 
@@ -594,6 +603,20 @@ static bool virtio_mem_could_add_memory(struct virtio_mem *vm, uint64_t size)
 	return atomic64_read(&vm->offline_size) + size <= vm->offline_threshold;
 }
 
+/*
+ * Size of the memmap a block of @size stores at its start. That part never
+ * gets onlined and is not accounted in vm->offline_size.
+ *
+ * In SBM, sub blocks of added memory blocks can get unplugged, including the
+ * ones that would hold the memmap: only big blocks are added that way.
+ */
+static uint64_t virtio_mem_memmap_size(struct virtio_mem *vm, uint64_t size)
+{
+	if (vm->in_sbm || !vm->bbm.memmap_on_memory)
+		return 0;
+	return PFN_DOWN(size) * sizeof(struct page);
+}
+
 /*
  * Try adding memory to Linux. Will usually only fail if out of memory.
  *
@@ -605,8 +628,13 @@ static bool virtio_mem_could_add_memory(struct virtio_mem *vm, uint64_t size)
 static int virtio_mem_add_memory(struct virtio_mem *vm, uint64_t addr,
 				 uint64_t size)
 {
+	const uint64_t memmap_size = virtio_mem_memmap_size(vm, size);
+	mhp_t mhp_flags = MHP_MERGE_RESOURCE;
 	int rc;
 
+	if (memmap_size)
+		mhp_flags |= MHP_MEMMAP_ON_MEMORY;
+
 	/*
 	 * When force-unloading the driver and we still have memory added to
 	 * Linux, the resource name has to stay.
@@ -621,11 +649,11 @@ static int virtio_mem_add_memory(struct virtio_mem *vm, uint64_t addr,
 	dev_dbg(&vm->vdev->dev, "adding memory: 0x%llx - 0x%llx\n", addr,
 		addr + size - 1);
 	/* Memory might get onlined immediately. */
-	atomic64_add(size, &vm->offline_size);
+	atomic64_add(size - memmap_size, &vm->offline_size);
 	rc = add_memory_driver_managed(vm->nid, addr, size, vm->resource_name,
-				       MHP_MERGE_RESOURCE);
+				       mhp_flags);
 	if (rc) {
-		atomic64_sub(size, &vm->offline_size);
+		atomic64_sub(size - memmap_size, &vm->offline_size);
 		dev_warn(&vm->vdev->dev, "adding memory failed: %d\n", rc);
 		/*
 		 * TODO: Linux MM does not properly clean up yet in all cases
@@ -675,7 +703,8 @@ static int virtio_mem_remove_memory(struct virtio_mem *vm, uint64_t addr,
 		addr + size - 1);
 	rc = remove_memory(vm->nid, addr, size);
 	if (!rc) {
-		atomic64_sub(size, &vm->offline_size);
+		atomic64_sub(size - virtio_mem_memmap_size(vm, size),
+			     &vm->offline_size);
 		/*
 		 * We might have freed up memory we can now unplug, retry
 		 * immediately instead of waiting.
@@ -730,7 +759,8 @@ static int virtio_mem_offline_and_remove_memory(struct virtio_mem *vm,
 
 	rc = offline_and_remove_memory(vm->nid, addr, size);
 	if (!rc) {
-		atomic64_sub(size, &vm->offline_size);
+		atomic64_sub(size - virtio_mem_memmap_size(vm, size),
+			     &vm->offline_size);
 		/*
 		 * We might have freed up memory we can now unplug, retry
 		 * immediately instead of waiting.
@@ -2461,6 +2491,13 @@ static int virtio_mem_init(struct virtio_mem *vm)
 			}
 		}
 
+		/*
+		 * Allocating the memmap from the added memory saves memory
+		 * on other nodes and makes adding big blocks a lot faster.
+		 */
+		vm->bbm.memmap_on_memory = memmap_on_memory &&
+			mhp_supports_memmap_on_memory(vm->bbm.bb_size);
+
 		/* Round up to the next aligned big block */
 		addr = max_t(uint64_t, vm->addr, pluggable_range.start) +
 		       vm->bbm.bb_size - 1;
@@ -2487,6 +2524,8 @@ static int virtio_mem_init(struct virtio_mem *vm)
 	else
 		dev_info(&vm->vdev->dev, "big block size: 0x%llx",
 			 (unsigned long long)vm->bbm.bb_size);
+	if (!vm->in_sbm && vm->bbm.memmap_on_memory)
+		dev_info(&vm->vdev->dev, "memmap on memory: enabled");
 	if (vm->nid != NUMA_NO_NODE && IS_ENABLED(CONFIG_NUMA))
 		dev_info(&vm->vdev->dev, "nid: %d", vm->nid);
 
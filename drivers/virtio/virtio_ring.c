@@ -73,6 +73,7 @@ struct vring_desc_state_split {
 struct vring_desc_state_packed {
 	void *data;			/* Data for callback. */
 	struct vring_packed_desc *indir_desc; /* Indirect descriptor, if any. */
+	u32 in_len;			/* Device writable buffer length. */
 	u16 num;			/* Descriptor list length. */
 	u16 next;			/* The next desc state in a list. */
 	u16 last;			/* The last desc state in a list. */
@@ -105,6 +106,9 @@ struct vring_virtqueue {
 	/* Host publishes avail event idx */
 	bool event;
 
+	/* Host uses buffers in the order they were made available */
+	bool in_order;
+
 	/* Head of free buffer list. */
 	unsigned int free_head;
 	/* Number we've added since last sync. */
@@ -164,6 +168,14 @@ struct vring_virtqueue {
 			 */
 			u16 event_flags_shadow;
 
+			/*
+			 * In order completion: id of the last buffer of the
+			 * batch being detached, vring.num if none, and the
+			 * length the device reported for it.
+			 */
+			u16 batch_last_id;
+			u32 batch_last_len;
+
 			/* Per-descriptor state. */
 			struct vring_desc_state_packed *desc_state;
 			struct vring_desc_extra_packed *desc_extra;
@@ -987,6 +999,7 @@ static int virtqueue_add_indirect_packed(struct vring_virtqueue *vq,
 	struct vring_packed_desc *desc;
 	struct scatterlist *sg;
 	unsigned int i, n, err_idx;
+	u32 in_len = 0;
 	u16 head, id;
 	dma_addr_t addr;
 
@@ -1015,6 +1028,8 @@ static int virtqueue_add_indirect_packed(struct vring_virtqueue *vq,
 						0 : VRING_DESC_F_WRITE);
 			desc[i].addr = cpu_to_le64(addr);
 			desc[i].len = cpu_to_le32(sg->length);
+			if (n >= out_sgs)
+				in_len += sg->length;
 			i++;
 		}
 	}
@@ -1067,6 +1082,7 @@ static int virtqueue_add_indirect_packed(struct vring_virtqueue *vq,
 	vq->packed.desc_state[id].num = 1;
 	vq->packed.desc_state[id].data = data;
 	vq->packed.desc_state[id].indir_desc = desc;
+	vq->packed.desc_state[id].in_len = in_len;
 	vq->packed.desc_state[id].last = id;
 
 	vq->num_added += 1;
@@ -1101,6 +1117,7 @@ static inline int virtqueue_add_packed(struct virtqueue *_vq,
 	struct vring_packed_desc *desc;
 	struct scatterlist *sg;
 	unsigned int i, n, c, descs_used, err_idx;
+	u32 in_len = 0;
 	__le16 head_flags, flags;
 	u16 head, id, prev, curr, avail_used_flags;
 
@@ -1161,6 +1178,8 @@ static inline int virtqueue_add_packed(struct virtqueue *_vq,
 			desc[i].addr = cpu_to_le64(addr);
 			desc[i].len = cpu_to_le32(sg->length);
 			desc[i].id = cpu_to_le16(id);
+			if (n >= out_sgs)
+				in_len += sg->length;
 
 			if (unlikely(vq->use_dma_api)) {
 				vq->packed.desc_extra[curr].addr = addr;
@@ -1194,6 +1213,7 @@ static inline int virtqueue_add_packed(struct virtqueue *_vq,
 	vq->packed.desc_state[id].num = descs_used;
 	vq->packed.desc_state[id].data = data;
 	vq->packed.desc_state[id].indir_desc = ctx;
+	vq->packed.desc_state[id].in_len = in_len;
 	vq->packed.desc_state[id].last = prev;
 
 	/*
@@ -1290,8 +1310,14 @@ static void detach_buf_packed(struct vring_virtqueue *vq,
 	/* Clear data ptr. */
 	state->data = NULL;
 
-	vq->packed.desc_state[state->last].next = vq->free_head;
-	vq->free_head = id;
+	/*
+	 * In order, ids are ring positions and the free list stays the
+	 * identity chain, there is nothing to relink.
+	 */
+	if (!vq->in_order) {
+		vq->packed.desc_state[state->last].next = vq->free_head;
+		vq->free_head = id;
+	}
 	vq->vq.num_free += state->num;
 
 	if (unlikely(vq->use_dma_api)) {
@@ -1337,9 +1363,15 @@ static inline bool is_used_desc_packed(const struct vring_virtqueue *vq,
 	return avail == used && used == used_wrap_counter;
 }
 
+static inline bool batch_pending_packed(const struct vring_virtqueue *vq)
+{
+	return vq->packed.batch_last_id != vq->packed.vring.num;
+}
+
 static inline bool more_used_packed(const struct vring_virtqueue *vq)
 {
-	return is_used_desc_packed(vq, vq->last_used_idx,
+	return batch_pending_packed(vq) ||
+	       is_used_desc_packed(vq, vq->last_used_idx,
 			vq->packed.used_wrap_counter);
 }
 
@@ -1364,10 +1396,23 @@ static void *virtqueue_get_buf_ctx_packed(struct virtqueue *_vq,
 		return NULL;
 	}
 
+	last_used = vq->last_used_idx;
+
+	if (batch_pending_packed(vq)) {
+		/* The device already used everything up to batch_last_id. */
+		id = last_used;
+		if (id == vq->packed.batch_last_id) {
+			*len = vq->packed.batch_last_len;
+			vq->packed.batch_last_id = vq->packed.vring.num;
+		} else {
+			*len = vq->packed.desc_state[id].in_len;
+		}
+		goto detach;
+	}
+
 	/* Only get used elements after they have been exposed by host. */
 	virtio_rmb(vq->weak_barriers);
 
-	last_used = vq->last_used_idx;
 	id = le16_to_cpu(vq->packed.vring.desc[last_used].id);
 	*len = le32_to_cpu(vq->packed.vring.desc[last_used].len);
 
@@ -1375,6 +1420,25 @@ static void *virtqueue_get_buf_ctx_packed(struct virtqueue *_vq,
 		BAD_RING(vq, "id %u out of range\n", id);
 		return NULL;
 	}
+
+	/*
+	 * In order, the device may write a single used descriptor for a
+	 * batch of buffers, with the id of the last one.  The buffers are
+	 * then detached one by one, earlier ones reporting their full
+	 * writable length.
+	 */
+	if (vq->in_order && id != last_used) {
+		if (unlikely(!vq->packed.desc_state[id].data)) {
+			BAD_RING(vq, "id %u is not a head!\n", id);
+			return NULL;
+		}
+		vq->packed.batch_last_id = id;
+		vq->packed.batch_last_len = *len;
+		id = last_used;
+		*len = vq->packed.desc_state[id].in_len;
+	}
+
+detach:
 	if (unlikely(!vq->packed.desc_state[id].data)) {
 		BAD_RING(vq, "id %u is not a head!\n", id);
 		return NULL;
@@ -1393,9 +1457,12 @@ static void *virtqueue_get_buf_ctx_packed(struct virtqueue *_vq,
 	/*
 	 * If we expect an interrupt for the next entry, tell host
 	 * by writing event index and flush out the write before
-	 * the read in the next get_buf call.
+	 * the read in the next get_buf call.  Inside a batch the
+	 * device is already past that entry, so only do it once the
+	 * batch is detached.
 	 */
-	if (vq->packed.event_flags_shadow == VRING_PACKED_EVENT_FLAG_DESC)
+	if (vq->packed.event_flags_shadow == VRING_PACKED_EVENT_FLAG_DESC &&
+	    !batch_pending_packed(vq))
 		virtio_store_mb(vq->weak_barriers,
 				&vq->packed.vring.driver->off_wrap,
 				cpu_to_le16(vq->last_used_idx |
@@ -1461,6 +1528,9 @@ static bool virtqueue_poll_packed(struct virtqueue *_vq, u16 off_wrap)
 	bool wrap_counter;
 	u16 used_idx;
 
+	if (batch_pending_packed(vq))
+		return true;
+
 	wrap_counter = off_wrap >> VRING_PACKED_EVENT_F_WRAP_CTR;
 	used_idx = off_wrap & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
 
@@ -1515,9 +1585,7 @@ static bool virtqueue_enable_cb_delayed_packed(struct virtqueue *_vq)
 	 */
 	virtio_mb(vq->weak_barriers);
 
-	if (is_used_desc_packed(vq,
-				vq->last_used_idx,
-				vq->packed.used_wrap_counter)) {
+	if (more_used_packed(vq)) {
 		END_USE(vq);
 		return false;
 	}
@@ -1616,6 +1684,7 @@ static struct virtqueue *vring_create_virtqueue_packed(
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
 		!context;
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->in_order = virtio_has_feature(vdev, VIRTIO_F_IN_ORDER);
 
 	if (virtio_has_feature(vdev, VIRTIO_F_ORDER_PLATFORM))
 		vq->weak_barriers = false;
@@ -1637,6 +1706,7 @@ static struct virtqueue *vring_create_virtqueue_packed(
 	vq->packed.used_wrap_counter = 1;
 	vq->packed.event_flags_shadow = 0;
 	vq->packed.avail_used_flags = 1 << VRING_PACKED_DESC_F_AVAIL;
+	vq->packed.batch_last_id = num;
 
 	vq->packed.desc_state = kmalloc_array(num,
 			sizeof(struct vring_desc_state_packed),
@@ -1647,7 +1717,11 @@ static struct virtqueue *vring_create_virtqueue_packed(
 	memset(vq->packed.desc_state, 0,
 		num * sizeof(struct vring_desc_state_packed));
 
-	/* Put everything in free lists. */
+	/*
+	 * Put everything in free lists.  The last entry wraps to the first
+	 * one, which in order keeps handing out ids equal to the ring
+	 * position of the buffer.
+	 */
 	vq->free_head = 0;
 	for (i = 0; i < num-1; i++)
 		vq->packed.desc_state[i].next = i + 1;
@@ -2073,6 +2147,7 @@ struct virtqueue *__vring_new_virtqueue(unsigned int index,
 		return NULL;
 
 	vq->packed_ring = false;
+	vq->in_order = false;
 	vq->vq.callback = callback;
 	vq->vq.vdev = vdev;
 	vq->vq.name = name;
@@ -2234,6 +2309,11 @@ void vring_transport_features(struct virtio_device *vdev)
 			break;
 		case VIRTIO_F_ORDER_PLATFORM:
 			break;
+		case VIRTIO_F_IN_ORDER:
+			/* Only the packed ring knows about in order batches. */
+			if (!__virtio_test_bit(vdev, VIRTIO_F_RING_PACKED))
+				__virtio_clear_bit(vdev, i);
+			break;
 		default:
 			/* We don't understand this bit. */
 			__virtio_clear_bit(vdev, i);
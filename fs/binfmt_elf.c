@@ -46,6 +46,9 @@
 #include <linux/cred.h>
 #include <linux/dax.h>
 #include <linux/uaccess.h>
+#include <linux/hash.h>
+#include <linux/iversion.h>
+#include <linux/rseq.h>
 #include <asm/param.h>
 #include <asm/page.h>
 
@@ -275,6 +278,10 @@ create_elf_tables(struct linux_binprm *bprm, const struct elfhdr *exec,
 	NEW_AUX_ENT(AT_HWCAP2, ELF_HWCAP2);
 #endif
 	NEW_AUX_ENT(AT_EXECFN, bprm->exec);
+#ifdef CONFIG_RSEQ
+	NEW_AUX_ENT(AT_RSEQ_FEATURE_SIZE, offsetof(struct rseq, end));
+	NEW_AUX_ENT(AT_RSEQ_ALIGN, __alignof__(struct rseq));
+#endif
 	if (k_platform) {
 		NEW_AUX_ENT(AT_PLATFORM,
 			    (elf_addr_t)(unsigned long)u_platform);
@@ -448,6 +455,117 @@ static unsigned long maximum_alignment(struct elf_phdr *cmds, int nr)
 	return ELF_PAGEALIGN(alignment);
 }
 
+/*
+ * Program headers of recently executed binaries, so that spawning the same
+ * few programs over and over does not read them from the file every time.
+ * An entry is only used while the inode looks unchanged: same identity,
+ * size, change times and i_version, and the same ELF header as the one
+ * just read by prepare_binprm().  Files changed in the last couple of
+ * seconds are not cached, so that a later write cannot leave the coarse
+ * timestamps as they were.
+ */
+#define ELF_PHDR_CACHE_BITS	6
+#define ELF_PHDR_CACHE_MIN_AGE	2	/* seconds */
+
+struct elf_phdr_cache_entry {
+	struct rcu_head rcu;
+	const struct super_block *sb;
+	unsigned long ino;
+	u32 generation;
+	loff_t i_size;
+	struct timespec64 mtime;
+	struct timespec64 ctime;
+	u64 version;
+	struct elfhdr ehdr;
+	struct elf_phdr phdrs[];
+};
+
+static struct elf_phdr_cache_entry __rcu *
+elf_phdr_cache[1 << ELF_PHDR_CACHE_BITS];
+static DEFINE_SPINLOCK(elf_phdr_cache_lock);
+
+static unsigned int elf_phdr_cache_slot(struct inode *inode)
+{
+	return hash_long((unsigned long)inode->i_sb ^ inode->i_ino,
+			 ELF_PHDR_CACHE_BITS);
+}
+
+static u64 elf_phdr_cache_version(struct inode *inode)
+{
+	return IS_I_VERSION(inode) ? inode_peek_iversion(inode) : 0;
+}
+
+static bool elf_phdr_cache_match(const struct elf_phdr_cache_entry *e,
+				 struct inode *inode,
+				 const struct elfhdr *elf_ex)
+{
+	return e->sb == inode->i_sb && e->ino == inode->i_ino &&
+	       e->generation == inode->i_generation &&
+	       e->i_size == i_size_read(inode) &&
+	       timespec64_equal(&e->mtime, &inode->i_mtime) &&
+	       timespec64_equal(&e->ctime, &inode->i_ctime) &&
+	       e->version == elf_phdr_cache_version(inode) &&
+	       !memcmp(&e->ehdr, elf_ex, sizeof(*elf_ex));
+}
+
+static bool elf_phdr_cache_lookup(struct file *file,
+				  const struct elfhdr *elf_ex,
+				  struct elf_phdr *phdrs, unsigned int size)
+{
+	struct inode *inode = file_inode(file);
+	struct elf_phdr_cache_entry *e;
+	bool found = false;
+
+	rcu_read_lock();
+	e = rcu_dereference(elf_phdr_cache[elf_phdr_cache_slot(inode)]);
+	if (e && elf_phdr_cache_match(e, inode, elf_ex)) {
+		memcpy(phdrs, e->phdrs, size);
+		found = true;
+	}
+	rcu_read_unlock();
+
+	return found;
+}
+
+static void elf_phdr_cache_store(struct file *file,
+				 const struct elfhdr *elf_ex,
+				 const struct elf_phdr *phdrs,
+				 unsigned int size)
+{
+	struct inode *inode = file_inode(file);
+	time64_t recent = ktime_get_real_seconds() - ELF_PHDR_CACHE_MIN_AGE;
+	struct elf_phdr_cache_entry *e, *old;
+	unsigned int slot;
+
+	if (inode->i_mtime.tv_sec > recent || inode->i_ctime.tv_sec > recent)
+		return;
+
+	e = kmalloc(sizeof(*e) + size, GFP_KERNEL);
+	if (!e)
+		return;
+
+	e->sb = inode->i_sb;
+	e->ino = inode->i_ino;
+	e->generation = inode->i_generation;
+	e->i_size = i_size_read(inode);
+	e->mtime = inode->i_mtime;
+	e->ctime = inode->i_ctime;
+	/* Make sure the next change to the file bumps i_version */
+	e->version = IS_I_VERSION(inode) ? inode_query_iversion(inode) : 0;
+	e->ehdr = *elf_ex;
+	memcpy(e->phdrs, phdrs, size);
+
+	slot = elf_phdr_cache_slot(inode);
+	spin_lock(&elf_phdr_cache_lock);
+	old = rcu_dereference_protected(elf_phdr_cache[slot],
+					lockdep_is_held(&elf_phdr_cache_lock));
+	rcu_assign_pointer(elf_phdr_cache[slot], e);
+	spin_unlock(&elf_phdr_cache_lock);
+
+	if (old)
+		kfree_rcu(old, rcu);
+}
+
 /**
  * load_elf_phdrs() - load ELF program headers
  * @elf_ex:   ELF header of the binary whose program headers should be loaded
@@ -481,12 +599,18 @@ static struct elf_phdr *load_elf_phdrs(const struct elfhdr *elf_ex,
 	if (!elf_phdata)
 		goto out;
 
+	if (elf_phdr_cache_lookup(elf_file, elf_ex, elf_phdata, size)) {
+		err = 0;
+		goto out;
+	}
+
 	/* Read in the program headers */
 	retval = elf_read(elf_file, elf_phdata, size, elf_ex->e_phoff);
 	if (retval < 0) {
 		err = retval;
 		goto out;
 	}
+	elf_phdr_cache_store(elf_file, elf_ex, elf_phdata, size);
 
 	/* Success! */
 	err = 0;
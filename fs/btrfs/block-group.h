@@ -183,6 +183,15 @@ struct btrfs_block_group {
 	 */
 	int needs_free_space;
 
+	/*
+	 * Ranges freed in the running transaction that still have to be added
+	 * to the free space tree, and the link on the transaction's list of
+	 * block groups with such ranges.  Protected by free_space_lock.
+	 */
+	struct rb_root free_space_batch;
+	int free_space_batch_count;
+	struct list_head free_space_batch_list;
+
 	/* Flag indicating this block group is placed on a sequential zone */
 	bool seq_zone;
 
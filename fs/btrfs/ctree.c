@@ -1690,6 +1690,128 @@ static struct extent_buffer *btrfs_search_slot_get_root(struct btrfs_root *root,
 	return b;
 }
 
+/*
+ * Try to step from the root node to its child without locking the root node.
+ *
+ * Every search starts at the root, which makes its lock the most contended one
+ * of a tree even though it rarely changes.  If the search does not need to
+ * modify the root, binary search it locklessly, lock the child and then check
+ * that no writer locked the root in the meantime, in which case what we read
+ * is still valid.
+ *
+ * Return the locked child with the path set up the way btrfs_search_slot()
+ * would have left it after processing the root, with the root referenced but
+ * unlocked.  Return NULL if the caller has to do a locked search instead.
+ */
+static struct extent_buffer *search_root_optimistic(
+					struct btrfs_trans_handle *trans,
+					struct btrfs_root *root,
+					const struct btrfs_key *key,
+					struct btrfs_path *p, int ins_len,
+					int cow, int write_lock_level,
+					int *prev_cmp)
+{
+	struct btrfs_fs_info *fs_info = root->fs_info;
+	struct extent_buffer *b;
+	struct extent_buffer *child;
+	struct btrfs_key first_key;
+	unsigned int seq;
+	u32 nritems;
+	u64 blocknr;
+	u64 gen;
+	int child_lock;
+	int level;
+	int slot;
+	int ret;
+
+	b = btrfs_root_node(root);
+	seq = btrfs_tree_read_seq_begin(b);
+	if (seq & 1)
+		goto out_restart;
+
+	level = btrfs_header_level(b);
+	nritems = btrfs_header_nritems(b);
+	if (btrfs_tree_read_seq_retry(b, seq))
+		goto out_restart;
+
+	/*
+	 * Only go lockless if a locked search would have read locked the root
+	 * and not stopped at it, and the root doesn't need to be COWed, split
+	 * or balanced.  The nritems check also keeps the binary search below
+	 * within the buffer.
+	 */
+	if (level == 0 || level >= BTRFS_MAX_LEVEL ||
+	    level <= write_lock_level || level <= p->lowest_level)
+		goto out_fallback;
+	if (nritems == 0 || nritems >= BTRFS_NODEPTRS_PER_BLOCK(fs_info) - 3)
+		goto out_fallback;
+	if (ins_len < 0 && nritems < BTRFS_NODEPTRS_PER_BLOCK(fs_info) / 2)
+		goto out_fallback;
+	if (cow && should_cow_block(trans, root, b))
+		goto out_fallback;
+
+	ret = generic_bin_search(b, offsetof(struct btrfs_node, ptrs),
+				 sizeof(struct btrfs_key_ptr), key, nritems,
+				 &slot);
+	if (ret && slot > 0)
+		slot--;
+	if (slot == 0 && ins_len)
+		goto out_fallback;
+
+	blocknr = btrfs_node_blockptr(b, slot);
+	gen = btrfs_node_ptr_generation(b, slot);
+	btrfs_node_key_to_cpu(b, &first_key, slot);
+	if (btrfs_tree_read_seq_retry(b, seq))
+		goto out_restart;
+
+	/* Reads from disk are left to the locked search */
+	child = find_extent_buffer(fs_info, blocknr);
+	if (!child)
+		goto out_fallback;
+	if (btrfs_buffer_uptodate(child, gen, 1) <= 0) {
+		free_extent_buffer(child);
+		goto out_fallback;
+	}
+
+	if (level - 1 <= write_lock_level) {
+		btrfs_tree_lock(child);
+		child_lock = BTRFS_WRITE_LOCK;
+	} else {
+		btrfs_tree_read_lock(child);
+		child_lock = BTRFS_READ_LOCK;
+	}
+
+	if (btrfs_tree_read_seq_retry(b, seq) || READ_ONCE(root->node) != b) {
+		btrfs_tree_unlock_rw(child, child_lock);
+		free_extent_buffer(child);
+		goto out_restart;
+	}
+
+	/*
+	 * The root didn't change, so the pointer we followed was valid.  Let
+	 * the locked search deal with anything unexpected in the child.
+	 */
+	if (btrfs_verify_level_key(child, level - 1, &first_key, gen)) {
+		btrfs_tree_unlock_rw(child, child_lock);
+		free_extent_buffer(child);
+		goto out_fallback;
+	}
+
+	if (cow)
+		trans->dirty = true;
+	*prev_cmp = ret;
+	p->nodes[level] = b;
+	p->slots[level] = slot;
+	p->nodes[level - 1] = child;
+	p->locks[level - 1] = child_lock;
+	return child;
+
+out_restart:
+	atomic64_inc(&fs_info->tree_search_restarts);
+out_fallback:
+	free_extent_buffer(b);
+	return NULL;
+}
 
 /*
  * btrfs_search_slot - look for a key in a tree and perform necessary
@@ -1753,10 +1875,13 @@ int btrfs_search_slot(struct btrfs_trans_handle *trans, struct btrfs_root *root,
 		write_lock_level = 2;
 	} else if (ins_len > 0) {
 		/*
-		 * for inserting items, make sure we have a write lock on
-		 * level 1 so we can update keys
+		 * Inserts only need a write lock on level 1 if they have to
+		 * split or COW the leaf, or insert at slot 0 and update the
+		 * keys above.  All of these restart the search with a higher
+		 * write_lock_level, so start out with only the leaf write
+		 * locked.
 		 */
-		write_lock_level = 1;
+		write_lock_level = 0;
 	}
 
 	if (!cow)
@@ -1769,7 +1894,12 @@ int btrfs_search_slot(struct btrfs_trans_handle *trans, struct btrfs_root *root,
 
 again:
 	prev_cmp = -1;
-	b = btrfs_search_slot_get_root(root, p, write_lock_level);
+	b = NULL;
+	if (!p->skip_locking && !p->keep_locks && !p->search_for_split)
+		b = search_root_optimistic(trans, root, key, p, ins_len, cow,
+					   write_lock_level, &prev_cmp);
+	if (!b)
+		b = btrfs_search_slot_get_root(root, p, write_lock_level);
 	if (IS_ERR(b)) {
 		ret = PTR_ERR(b);
 		goto done;
@@ -1881,6 +2011,13 @@ int btrfs_search_slot(struct btrfs_trans_handle *trans, struct btrfs_root *root,
 				ASSERT(ins_len >= sizeof(struct btrfs_item));
 				ins_len -= sizeof(struct btrfs_item);
 			}
+			/* Inserting at slot 0 updates the keys in the parent */
+			if (ins_len > 0 && ret && slot == 0 &&
+			    write_lock_level < 1 && p->nodes[1]) {
+				write_lock_level = 1;
+				btrfs_release_path(p);
+				goto again;
+			}
 			if (ins_len > 0 &&
 			    btrfs_leaf_free_space(b) < ins_len) {
 				if (write_lock_level < 1) {
@@ -491,6 +491,8 @@ struct btrfs_discard_ctl {
 	struct list_head discard_list[BTRFS_NR_DISCARD_LISTS];
 	u64 prev_discard;
 	u64 prev_discard_time;
+	/* Moving average of the time a discard work item spent discarding */
+	u64 discard_latency_ns;
 	atomic_t discardable_extents;
 	atomic64_t discardable_bytes;
 	u64 max_discard_size;
@@ -801,6 +803,8 @@ struct btrfs_fs_info {
 	struct btrfs_workqueue *endio_freespace_worker;
 	struct btrfs_workqueue *caching_workers;
 	struct btrfs_workqueue *readahead_workers;
+	/* parallel data checksum verification of large read bios */
+	struct workqueue_struct *csum_workers;
 
 	/*
 	 * fixup workers take dirty pages that didn't properly go through
@@ -965,6 +969,16 @@ struct btrfs_fs_info {
 	struct list_head reclaim_bgs;
 	int bg_reclaim_threshold;
 
+	/* Tree lock contention, see /sys/fs/btrfs/<uuid>/tree_lock_stats */
+	atomic64_t tree_lock_contended;
+	atomic64_t tree_read_lock_contended;
+	atomic64_t tree_search_restarts;
+
+	/* Data checksum verification, see /sys/fs/btrfs/<uuid>/checksum_stats */
+	atomic64_t csum_verified_bytes;
+	atomic64_t csum_verify_ns;
+	atomic64_t csum_parallel_bios;
+
 	spinlock_t unused_bgs_lock;
 	struct list_head unused_bgs;
 	struct mutex unused_bg_unpin_mutex;
@@ -3100,8 +3114,10 @@ u64 btrfs_file_extent_end(const struct btrfs_path *path);
 /* inode.c */
 blk_status_t btrfs_submit_data_bio(struct inode *inode, struct bio *bio,
 				   int mirror_num, unsigned long bio_flags);
+unsigned long *btrfs_verify_bio_csums(struct btrfs_io_bio *io_bio);
 int btrfs_verify_data_csum(struct btrfs_io_bio *io_bio, u32 bio_offset,
-			   struct page *page, u64 start, u64 end);
+			   struct page *page, u64 start, u64 end,
+			   const unsigned long *csum_bad);
 struct extent_map *btrfs_get_extent_fiemap(struct btrfs_inode *inode,
 					   u64 start, u64 len);
 noinline int can_nocow_extent(struct inode *inode, u64 offset, u64 *len,
@@ -22,7 +22,8 @@
  * The block_groups are maintained on multiple lists to allow for multiple
  * passes with different discard filter requirements.  A delayed work item is
  * used to manage discarding with timeout determined by a max of the delay
- * incurred by the iops rate limit, the byte rate limit, and the max delay of
+ * incurred by the iops rate limit, the byte rate limit, a multiple of the time
+ * recent discards took to complete, and the max delay of
  * BTRFS_DISCARD_MAX_DELAY.
  *
  * Note, this only keeps track of block_groups that are explicitly for data.
@@ -61,6 +62,13 @@
 #define BTRFS_DISCARD_MAX_DELAY_MSEC	(1000UL)
 #define BTRFS_DISCARD_MAX_IOPS		(10U)
 
+/*
+ * Wait at least this many times as long as the previous discard took before
+ * issuing the next one, so devices that are slow to discard spend no more than
+ * a fifth of their time on async discard.
+ */
+#define BTRFS_DISCARD_LATENCY_MULT	(4U)
+
 /* Montonically decreasing minimum length filters after index 0 */
 static int discard_minlen[BTRFS_NR_DISCARD_LISTS] = {
 	0,
@@ -358,6 +366,11 @@ static void __btrfs_discard_schedule_work(struct btrfs_discard_ctl *discard_ctl,
 			delay = max(delay, bps_delay);
 		}
 
+		/* Back off when discards take long to complete */
+		if (discard_ctl->prev_discard)
+			delay = max(delay, discard_ctl->discard_latency_ns *
+					   BTRFS_DISCARD_LATENCY_MULT);
+
 		/*
 		 * This timeout is to hopefully prevent immediate discarding
 		 * in a recently allocated block group.
@@ -443,6 +456,7 @@ static void btrfs_discard_workfn(struct work_struct *work)
 	u64 trimmed = 0;
 	u64 minlen = 0;
 	u64 now = ktime_get_ns();
+	u64 start;
 
 	discard_ctl = container_of(work, struct btrfs_discard_ctl, work.work);
 
@@ -457,6 +471,7 @@ static void btrfs_discard_workfn(struct work_struct *work)
 
 	/* Perform discarding */
 	minlen = discard_minlen[discard_index];
+	start = ktime_get_ns();
 
 	if (discard_state == BTRFS_DISCARD_BITMAPS) {
 		u64 maxlen = 0;
@@ -502,6 +517,9 @@ static void btrfs_discard_workfn(struct work_struct *work)
 	spin_lock(&discard_ctl->lock);
 	discard_ctl->prev_discard = trimmed;
 	discard_ctl->prev_discard_time = now;
+	if (trimmed)
+		discard_ctl->discard_latency_ns =
+			(discard_ctl->discard_latency_ns * 7 + now - start) / 8;
 	discard_ctl->block_group = NULL;
 	__btrfs_discard_schedule_work(discard_ctl, now, false);
 	spin_unlock(&discard_ctl->lock);
@@ -710,6 +728,7 @@ void btrfs_discard_init(struct btrfs_fs_info *fs_info)
 	discard_ctl->delay_ms = BTRFS_DISCARD_MAX_DELAY_MSEC;
 	discard_ctl->iops_limit = BTRFS_DISCARD_MAX_IOPS;
 	discard_ctl->kbps_limit = 0;
+	discard_ctl->discard_latency_ns = 0;
 	discard_ctl->discard_extent_bytes = 0;
 	discard_ctl->discard_bitmap_bytes = 0;
 	atomic64_set(&discard_ctl->discard_bytes_saved, 0);
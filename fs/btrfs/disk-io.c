@@ -2149,6 +2149,8 @@ static void btrfs_stop_all_workers(struct btrfs_fs_info *fs_info)
 	btrfs_destroy_workqueue(fs_info->qgroup_rescan_workers);
 	if (fs_info->discard_ctl.discard_workers)
 		destroy_workqueue(fs_info->discard_ctl.discard_workers);
+	if (fs_info->csum_workers)
+		destroy_workqueue(fs_info->csum_workers);
 	/*
 	 * Now that all other work queues are destroyed, we can safely destroy
 	 * the queues used for metadata I/O, since tasks from those other work
@@ -2356,6 +2358,8 @@ static int btrfs_init_workqueues(struct btrfs_fs_info *fs_info,
 		btrfs_alloc_workqueue(fs_info, "qgroup-rescan", flags, 1, 0);
 	fs_info->discard_ctl.discard_workers =
 		alloc_workqueue("btrfs_discard", WQ_UNBOUND | WQ_FREEZABLE, 1);
+	fs_info->csum_workers =
+		alloc_workqueue("btrfs_csum", flags, 0);
 
 	if (!(fs_info->workers && fs_info->delalloc_workers &&
 	      fs_info->flush_workers &&
@@ -2366,7 +2370,8 @@ static int btrfs_init_workqueues(struct btrfs_fs_info *fs_info,
 	      fs_info->caching_workers && fs_info->readahead_workers &&
 	      fs_info->fixup_workers && fs_info->delayed_workers &&
 	      fs_info->qgroup_rescan_workers &&
-	      fs_info->discard_ctl.discard_workers)) {
+	      fs_info->discard_ctl.discard_workers &&
+	      fs_info->csum_workers)) {
 		return -ENOMEM;
 	}
 
@@ -4916,6 +4921,7 @@ void btrfs_cleanup_one_transaction(struct btrfs_transaction *cur_trans,
 	}
 
 	btrfs_destroy_delayed_refs(cur_trans, fs_info);
+	btrfs_release_free_space_batches(cur_trans);
 
 	cur_trans->state = TRANS_STATE_COMMIT_START;
 	wake_up(&fs_info->transaction_blocked_wait);
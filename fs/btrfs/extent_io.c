@@ -2938,11 +2938,17 @@ static void end_bio_extent_readpage(struct bio *bio)
 	 * larger than UINT_MAX, u32 here is enough.
 	 */
 	u32 bio_offset = 0;
+	unsigned long *csum_bad = NULL;
 	int mirror;
 	int ret;
 	struct bvec_iter_all iter_all;
 
 	ASSERT(!bio_flagged(bio, BIO_CLONED));
+	/* Data bios get all their checksums verified at once */
+	if (likely(uptodate) &&
+	    is_data_inode(bio_first_page_all(bio)->mapping->host))
+		csum_bad = btrfs_verify_bio_csums(io_bio);
+
 	bio_for_each_segment_all(bvec, bio, iter_all) {
 		struct page *page = bvec->bv_page;
 		struct inode *inode = page->mapping->host;
@@ -2984,7 +2990,8 @@ static void end_bio_extent_readpage(struct bio *bio)
 		if (likely(uptodate)) {
 			if (is_data_inode(inode))
 				ret = btrfs_verify_data_csum(io_bio,
-						bio_offset, page, start, end);
+						bio_offset, page, start, end,
+						csum_bad);
 			else
 				ret = btrfs_validate_metadata_buffer(io_bio,
 					page, start, end, mirror);
@@ -3065,6 +3072,7 @@ static void end_bio_extent_readpage(struct bio *bio)
 	}
 	/* Release the last extent */
 	endio_readpage_release_extent(&processed, NULL, 0, 0, false);
+	bitmap_free(csum_bad);
 	btrfs_io_bio_free_csum(io_bio);
 	bio_put(bio);
 }
@@ -5541,6 +5549,7 @@ __alloc_extent_buffer(struct btrfs_fs_info *fs_info, u64 start,
 	eb->fs_info = fs_info;
 	eb->bflags = 0;
 	init_rwsem(&eb->lock);
+	seqcount_init(&eb->lock_seq);
 
 	btrfs_leak_debug_add(&fs_info->eb_leak_lock, &eb->leak_list,
 			     &fs_info->allocated_ebs);
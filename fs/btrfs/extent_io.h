@@ -6,6 +6,7 @@
 #include <linux/rbtree.h>
 #include <linux/refcount.h>
 #include <linux/fiemap.h>
+#include <linux/seqlock.h>
 #include <linux/btrfs_tree.h>
 #include "ulist.h"
 
@@ -93,6 +94,8 @@ struct extent_buffer {
 	s8 log_index;
 
 	struct rw_semaphore lock;
+	/* odd while write locked, bumped on every write lock and unlock */
+	seqcount_t lock_seq;
 
 	struct page *pages[INLINE_EXTENT_BUFFER_PAGES];
 	struct list_head release_list;
@@ -4,6 +4,7 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/list_sort.h>
 #include <linux/sched/mm.h>
 #include "ctree.h"
 #include "disk-io.h"
@@ -810,6 +811,254 @@ int __remove_from_free_space_tree(struct btrfs_trans_handle *trans,
 	}
 }
 
+/*
+ * Batched free space tree additions
+ * =================================
+ *
+ * Extents freed while running delayed refs are not added to the free space tree
+ * right away, each addition would search the tree again for the block group's
+ * free space info and the neighbouring free space.  Instead the freed ranges
+ * are collected per block group, merged with adjacent ones, and added in
+ * order of address when the transaction commits, see commit_cowonly_roots().
+ *
+ * The free space tree only tracks a set of free ranges, and a freed range is
+ * never in the tree already, so deferring its addition is fine as long as
+ * anything that may allocate from it first applies the block group's batch.
+ * Freed extents are normally pinned until the transaction commits, but tree
+ * blocks allocated and freed in the same transaction can be reused right away,
+ * which remove_from_free_space_tree() takes care of.  Caching block groups
+ * from the free space tree uses the commit root and doesn't see the batch.
+ */
+
+/* Apply a block group's batch right away once it has this many ranges */
+#define BTRFS_FREE_SPACE_BATCH_MAX	1024
+
+struct free_space_batch_entry {
+	struct rb_node rb_node;
+	u64 start;
+	u64 size;
+};
+
+static void free_space_batch_erase(struct btrfs_block_group *block_group,
+				   struct free_space_batch_entry *entry)
+{
+	rb_erase(&entry->rb_node, &block_group->free_space_batch);
+	block_group->free_space_batch_count--;
+	kfree(entry);
+}
+
+static void free_space_batch_drop(struct btrfs_block_group *block_group)
+{
+	struct rb_node *node;
+
+	while ((node = rb_first(&block_group->free_space_batch)))
+		free_space_batch_erase(block_group,
+				       rb_entry(node, struct free_space_batch_entry,
+						rb_node));
+}
+
+/*
+ * Add [start, start + size) to the batch of @block_group, merging it with the
+ * adjacent ranges.  Must be called with free_space_lock held.
+ */
+static int free_space_batch_insert(struct btrfs_trans_handle *trans,
+				   struct btrfs_block_group *block_group,
+				   u64 start, u64 size)
+{
+	struct btrfs_transaction *cur_trans = trans->transaction;
+	struct rb_node **p = &block_group->free_space_batch.rb_node;
+	struct rb_node *parent = NULL;
+	struct free_space_batch_entry *entry;
+	struct free_space_batch_entry *prev = NULL;
+	struct free_space_batch_entry *next = NULL;
+
+	lockdep_assert_held(&block_group->free_space_lock);
+
+	while (*p) {
+		parent = *p;
+		entry = rb_entry(parent, struct free_space_batch_entry,
+				 rb_node);
+		if (start < entry->start) {
+			next = entry;
+			p = &(*p)->rb_left;
+		} else {
+			prev = entry;
+			p = &(*p)->rb_right;
+		}
+	}
+
+	if (prev && prev->start + prev->size == start) {
+		prev->size += size;
+		if (next && prev->start + prev->size == next->start) {
+			prev->size += next->size;
+			free_space_batch_erase(block_group, next);
+		}
+		return 0;
+	}
+	if (next && start + size == next->start) {
+		next->start = start;
+		next->size += size;
+		return 0;
+	}
+
+	entry = kmalloc(sizeof(*entry), GFP_NOFS);
+	if (!entry)
+		return -ENOMEM;
+	entry->start = start;
+	entry->size = size;
+	rb_link_node(&entry->rb_node, parent, p);
+	rb_insert_color(&entry->rb_node, &block_group->free_space_batch);
+	block_group->free_space_batch_count++;
+
+	if (list_empty(&block_group->free_space_batch_list)) {
+		btrfs_get_block_group(block_group);
+		spin_lock(&cur_trans->free_space_batch_lock);
+		list_add_tail(&block_group->free_space_batch_list,
+			      &cur_trans->free_space_batch_bgs);
+		spin_unlock(&cur_trans->free_space_batch_lock);
+	}
+	return 0;
+}
+
+/*
+ * Add all batched ranges of @block_group to the free space tree.  Must be called
+ * with free_space_lock held.
+ */
+static int free_space_batch_apply(struct btrfs_trans_handle *trans,
+				  struct btrfs_block_group *block_group,
+				  struct btrfs_path *path)
+{
+	struct rb_node *node;
+	int ret;
+
+	lockdep_assert_held(&block_group->free_space_lock);
+
+	while ((node = rb_first(&block_group->free_space_batch))) {
+		struct free_space_batch_entry *entry;
+
+		entry = rb_entry(node, struct free_space_batch_entry, rb_node);
+		ret = __add_to_free_space_tree(trans, block_group, path,
+					       entry->start, entry->size);
+		if (ret)
+			return ret;
+		free_space_batch_erase(block_group, entry);
+	}
+	return 0;
+}
+
+static bool free_space_batch_overlaps(struct btrfs_block_group *block_group,
+				      u64 start, u64 size)
+{
+	struct rb_node *node = block_group->free_space_batch.rb_node;
+
+	while (node) {
+		struct free_space_batch_entry *entry;
+
+		entry = rb_entry(node, struct free_space_batch_entry, rb_node);
+		if (start + size <= entry->start)
+			node = node->rb_left;
+		else if (start >= entry->start + entry->size)
+			node = node->rb_right;
+		else
+			return true;
+	}
+	return false;
+}
+
+static int free_space_bg_cmp(void *priv, const struct list_head *a,
+			     const struct list_head *b)
+{
+	struct btrfs_block_group *bg_a = list_entry(a, struct btrfs_block_group,
+						    free_space_batch_list);
+	struct btrfs_block_group *bg_b = list_entry(b, struct btrfs_block_group,
+						    free_space_batch_list);
+
+	if (bg_a->start < bg_b->start)
+		return -1;
+	if (bg_a->start > bg_b->start)
+		return 1;
+	return 0;
+}
+
+/*
+ * btrfs_run_free_space_batches - add the batched freed ranges to the tree
+ * @trans:	transaction handle of the committing transaction
+ *
+ * Called from the transaction commit, goes through the block groups in order
+ * of address.  Adding the ranges can free more extents, which end up in the
+ * batch again, so the caller has to loop until the batch is empty.
+ */
+int btrfs_run_free_space_batches(struct btrfs_trans_handle *trans)
+{
+	struct btrfs_transaction *cur_trans = trans->transaction;
+	struct btrfs_block_group *block_group;
+	struct btrfs_path *path;
+	LIST_HEAD(bgs);
+	int ret = 0;
+
+	spin_lock(&cur_trans->free_space_batch_lock);
+	list_splice_init(&cur_trans->free_space_batch_bgs, &bgs);
+	spin_unlock(&cur_trans->free_space_batch_lock);
+	if (list_empty(&bgs))
+		return 0;
+
+	list_sort(NULL, &bgs, free_space_bg_cmp);
+
+	path = btrfs_alloc_path();
+	if (!path) {
+		/* Leave them to btrfs_release_free_space_batches() */
+		spin_lock(&cur_trans->free_space_batch_lock);
+		list_splice(&bgs, &cur_trans->free_space_batch_bgs);
+		spin_unlock(&cur_trans->free_space_batch_lock);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	while (!list_empty(&bgs)) {
+		block_group = list_first_entry(&bgs, struct btrfs_block_group,
+					       free_space_batch_list);
+		mutex_lock(&block_group->free_space_lock);
+		list_del_init(&block_group->free_space_batch_list);
+		if (!ret)
+			ret = free_space_batch_apply(trans, block_group, path);
+		if (ret)
+			free_space_batch_drop(block_group);
+		mutex_unlock(&block_group->free_space_lock);
+		btrfs_put_block_group(block_group);
+	}
+
+	btrfs_free_path(path);
+out:
+	if (ret)
+		btrfs_abort_transaction(trans, ret);
+	return ret;
+}
+
+/*
+ * Drop the batched ranges of an aborted transaction.
+ */
+void btrfs_release_free_space_batches(struct btrfs_transaction *cur_trans)
+{
+	struct btrfs_block_group *block_group;
+
+	spin_lock(&cur_trans->free_space_batch_lock);
+	while (!list_empty(&cur_trans->free_space_batch_bgs)) {
+		block_group = list_first_entry(&cur_trans->free_space_batch_bgs,
+					       struct btrfs_block_group,
+					       free_space_batch_list);
+		list_del_init(&block_group->free_space_batch_list);
+		spin_unlock(&cur_trans->free_space_batch_lock);
+
+		mutex_lock(&block_group->free_space_lock);
+		free_space_batch_drop(block_group);
+		mutex_unlock(&block_group->free_space_lock);
+		btrfs_put_block_group(block_group);
+
+		spin_lock(&cur_trans->free_space_batch_lock);
+	}
+	spin_unlock(&cur_trans->free_space_batch_lock);
+}
+
 int remove_from_free_space_tree(struct btrfs_trans_handle *trans,
 				u64 start, u64 size)
 {
@@ -834,8 +1083,13 @@ int remove_from_free_space_tree(struct btrfs_trans_handle *trans,
 	}
 
 	mutex_lock(&block_group->free_space_lock);
-	ret = __remove_from_free_space_tree(trans, block_group, path, start,
-					    size);
+	/* Reusing space freed in this transaction, the batch has to go first */
+	ret = 0;
+	if (free_space_batch_overlaps(block_group, start, size))
+		ret = free_space_batch_apply(trans, block_group, path);
+	if (!ret)
+		ret = __remove_from_free_space_tree(trans, block_group, path,
+						    start, size);
 	mutex_unlock(&block_group->free_space_lock);
 
 	btrfs_put_block_group(block_group);
@@ -1003,22 +1257,21 @@ int __add_to_free_space_tree(struct btrfs_trans_handle *trans,
 	}
 }
 
+/*
+ * Add a freed range to the free space tree.  The range is batched and only
+ * added at transaction commit, unless the block group's batch is full or
+ * memory is short.
+ */
 int add_to_free_space_tree(struct btrfs_trans_handle *trans,
 			   u64 start, u64 size)
 {
 	struct btrfs_block_group *block_group;
-	struct btrfs_path *path;
+	struct btrfs_path *path = NULL;
 	int ret;
 
 	if (!btrfs_fs_compat_ro(trans->fs_info, FREE_SPACE_TREE))
 		return 0;
 
-	path = btrfs_alloc_path();
-	if (!path) {
-		ret = -ENOMEM;
-		goto out;
-	}
-
 	block_group = btrfs_lookup_block_group(trans->fs_info, start);
 	if (!block_group) {
 		ASSERT(0);
@@ -1027,9 +1280,24 @@ int add_to_free_space_tree(struct btrfs_trans_handle *trans,
 	}
 
 	mutex_lock(&block_group->free_space_lock);
-	ret = __add_to_free_space_tree(trans, block_group, path, start, size);
-	mutex_unlock(&block_group->free_space_lock);
+	ret = free_space_batch_insert(trans, block_group, start, size);
+	if (!ret &&
+	    block_group->free_space_batch_count < BTRFS_FREE_SPACE_BATCH_MAX)
+		goto out_unlock;
+
+	path = btrfs_alloc_path();
+	if (!path) {
+		ret = -ENOMEM;
+		goto out_unlock;
+	}
+	if (ret)
+		ret = __add_to_free_space_tree(trans, block_group, path, start,
+					       size);
+	else
+		ret = free_space_batch_apply(trans, block_group, path);
 
+out_unlock:
+	mutex_unlock(&block_group->free_space_lock);
 	btrfs_put_block_group(block_group);
 out:
 	btrfs_free_path(path);
@@ -1335,6 +1603,16 @@ int remove_block_group_free_space(struct btrfs_trans_handle *trans,
 		return 0;
 	}
 
+	/*
+	 * Unused block groups have nothing freed in the running transaction,
+	 * that would still be pinned, but drop any batched ranges anyway as
+	 * they are going away with the rest of the block group's free space.
+	 */
+	mutex_lock(&block_group->free_space_lock);
+	WARN_ON_ONCE(!RB_EMPTY_ROOT(&block_group->free_space_batch));
+	free_space_batch_drop(block_group);
+	mutex_unlock(&block_group->free_space_lock);
+
 	path = btrfs_alloc_path();
 	if (!path) {
 		ret = -ENOMEM;
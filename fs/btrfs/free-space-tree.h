@@ -7,6 +7,7 @@
 #define BTRFS_FREE_SPACE_TREE_H
 
 struct btrfs_caching_control;
+struct btrfs_transaction;
 
 /*
  * The default size for new free space bitmap items. The last bitmap in a block
@@ -28,6 +29,8 @@ int add_to_free_space_tree(struct btrfs_trans_handle *trans,
 			   u64 start, u64 size);
 int remove_from_free_space_tree(struct btrfs_trans_handle *trans,
 				u64 start, u64 size);
+int btrfs_run_free_space_batches(struct btrfs_trans_handle *trans);
+void btrfs_release_free_space_batches(struct btrfs_transaction *cur_trans);
 
 #ifdef CONFIG_BTRFS_FS_RUN_SANITY_TESTS
 struct btrfs_free_space_info *
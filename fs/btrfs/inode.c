@@ -3144,6 +3144,157 @@ static int check_data_csum(struct inode *inode, struct btrfs_io_bio *io_bio,
 	return -EIO;
 }
 
+/*
+ * Read bios with at least this many sectors get their checksums verified by
+ * several CPUs, each job handling at least BTRFS_CSUM_JOB_SECTORS sectors.
+ */
+#define BTRFS_CSUM_PARALLEL_SECTORS	64
+#define BTRFS_CSUM_JOB_SECTORS		32
+
+struct btrfs_csum_job {
+	struct work_struct work;
+	struct btrfs_fs_info *fs_info;
+	struct btrfs_io_bio *io_bio;
+	unsigned long *csum_bad;
+	u32 first;
+	u32 last;
+};
+
+/*
+ * Verify the checksums of sectors [@first, @last) of a read bio and set the
+ * bit of each sector that doesn't match in @csum_bad.
+ */
+static void verify_bio_csum_range(struct btrfs_fs_info *fs_info,
+				  struct btrfs_io_bio *io_bio,
+				  unsigned long *csum_bad, u32 first, u32 last)
+{
+	SHASH_DESC_ON_STACK(shash, fs_info->csum_shash);
+	const u32 sectorsize = fs_info->sectorsize;
+	const u32 csum_size = fs_info->csum_size;
+	struct bio_vec *bvec;
+	struct bvec_iter_all iter_all;
+	u32 bio_offset = 0;
+
+	shash->tfm = fs_info->csum_shash;
+	bio_for_each_segment_all(bvec, &io_bio->bio, iter_all) {
+		u32 off;
+
+		if (((bio_offset + bvec->bv_len) >> fs_info->sectorsize_bits) <=
+		    first) {
+			bio_offset += bvec->bv_len;
+			continue;
+		}
+
+		for (off = 0; off + sectorsize <= bvec->bv_len;
+		     off += sectorsize) {
+			u32 sector = (bio_offset + off) >>
+				     fs_info->sectorsize_bits;
+			u8 csum[BTRFS_CSUM_SIZE];
+			char *kaddr;
+
+			if (sector < first)
+				continue;
+			if (sector >= last)
+				return;
+
+			kaddr = kmap_atomic(bvec->bv_page);
+			crypto_shash_digest(shash, kaddr + bvec->bv_offset + off,
+					    sectorsize, csum);
+			kunmap_atomic(kaddr);
+			if (memcmp(csum, io_bio->csum + sector * csum_size,
+				   csum_size))
+				set_bit(sector, csum_bad);
+		}
+		bio_offset += bvec->bv_len;
+	}
+}
+
+static void verify_bio_csum_fn(struct work_struct *work)
+{
+	struct btrfs_csum_job *job = container_of(work, struct btrfs_csum_job,
+						  work);
+
+	verify_bio_csum_range(job->fs_info, job->io_bio, job->csum_bad,
+			      job->first, job->last);
+}
+
+/*
+ * Verify all data checksums of a completed read bio up front.
+ *
+ * Large bios are split into batches of sectors that are hashed in parallel on
+ * fs_info->csum_workers, while the end io worker hashes the first batch.
+ * Returns a bitmap with a bit set for every sector of the bio whose checksum
+ * doesn't match, to be passed to btrfs_verify_data_csum() and freed with
+ * bitmap_free() by the caller.  Returns NULL if the bio has no checksums or
+ * memory is short, btrfs_verify_data_csum() then checks each sector itself.
+ */
+unsigned long *btrfs_verify_bio_csums(struct btrfs_io_bio *io_bio)
+{
+	struct bio *bio = &io_bio->bio;
+	struct inode *inode = bio_first_page_all(bio)->mapping->host;
+	struct btrfs_fs_info *fs_info = btrfs_sb(inode->i_sb);
+	struct btrfs_csum_job *jobs = NULL;
+	struct bio_vec *bvec;
+	struct bvec_iter_all iter_all;
+	unsigned long *csum_bad;
+	u32 nr_sectors = 0;
+	u32 per_job;
+	u64 start_ns;
+	int nr_jobs = 1;
+	int i;
+
+	if (!io_bio->csum || (BTRFS_I(inode)->flags & BTRFS_INODE_NODATASUM))
+		return NULL;
+
+	bio_for_each_segment_all(bvec, bio, iter_all)
+		nr_sectors += bvec->bv_len >> fs_info->sectorsize_bits;
+	if (!nr_sectors)
+		return NULL;
+
+	csum_bad = bitmap_zalloc(nr_sectors, GFP_NOFS);
+	if (!csum_bad)
+		return NULL;
+
+	if (nr_sectors >= BTRFS_CSUM_PARALLEL_SECTORS) {
+		nr_jobs = min_t(int, num_online_cpus(),
+				nr_sectors / BTRFS_CSUM_JOB_SECTORS);
+		if (nr_jobs > 1) {
+			jobs = kcalloc(nr_jobs - 1, sizeof(*jobs), GFP_NOFS);
+			if (!jobs)
+				nr_jobs = 1;
+		}
+	}
+	per_job = DIV_ROUND_UP(nr_sectors, nr_jobs);
+
+	start_ns = ktime_get_ns();
+	for (i = 0; i < nr_jobs - 1; i++) {
+		struct btrfs_csum_job *job = &jobs[i];
+
+		INIT_WORK(&job->work, verify_bio_csum_fn);
+		job->fs_info = fs_info;
+		job->io_bio = io_bio;
+		job->csum_bad = csum_bad;
+		job->first = (i + 1) * per_job;
+		job->last = min(job->first + per_job, nr_sectors);
+		queue_work(fs_info->csum_workers, &job->work);
+	}
+
+	verify_bio_csum_range(fs_info, io_bio, csum_bad, 0,
+			      min(per_job, nr_sectors));
+
+	for (i = 0; i < nr_jobs - 1; i++)
+		flush_work(&jobs[i].work);
+	kfree(jobs);
+
+	atomic64_add(ktime_get_ns() - start_ns, &fs_info->csum_verify_ns);
+	atomic64_add((u64)nr_sectors << fs_info->sectorsize_bits,
+		     &fs_info->csum_verified_bytes);
+	if (nr_jobs > 1)
+		atomic64_inc(&fs_info->csum_parallel_bios);
+
+	return csum_bad;
+}
+
 /*
  * When reads are done, we need to check csums to verify the data is correct.
  * if there's a match, we allow the bio to finish.  If not, the code in
@@ -3152,9 +3303,12 @@ static int check_data_csum(struct inode *inode, struct btrfs_io_bio *io_bio,
  * @bio_offset:	offset to the beginning of the bio (in bytes)
  * @start:	file offset of the range start
  * @end:	file offset of the range end (inclusive)
+ * @csum_bad:	result of btrfs_verify_bio_csums() for the bio, or NULL to
+ *		verify the sectors here
  */
 int btrfs_verify_data_csum(struct btrfs_io_bio *io_bio, u32 bio_offset,
-			   struct page *page, u64 start, u64 end)
+			   struct page *page, u64 start, u64 end,
+			   const unsigned long *csum_bad)
 {
 	struct inode *inode = page->mapping->host;
 	struct extent_io_tree *io_tree = &BTRFS_I(inode)->io_tree;
@@ -3186,6 +3340,12 @@ int btrfs_verify_data_csum(struct btrfs_io_bio *io_bio, u32 bio_offset,
 	     pg_off += sectorsize, bio_offset += sectorsize) {
 		int ret;
 
+		/* Already verified, only redo the check to report the error */
+		if (csum_bad &&
+		    !test_bit(bio_offset >> root->fs_info->sectorsize_bits,
+			      csum_bad))
+			continue;
+
 		ret = check_data_csum(inode, io_bio, bio_offset, page, pg_off,
 				      page_offset(page) + pg_off);
 		if (ret < 0)
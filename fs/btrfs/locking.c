@@ -27,6 +27,14 @@
  *
  * The rwsem implementation does opportunistic spinning which reduces number of
  * times the locking task needs to sleep.
+ *
+ * Every write lock and unlock also bumps eb->lock_seq, so the sequence count is
+ * odd while a writer holds the lock.  This lets btrfs_search_slot() read the
+ * root node without taking its lock and validate afterwards that no writer
+ * got in, see btrfs_tree_read_seq_begin() and btrfs_tree_read_seq_retry().
+ *
+ * Lock requests that find the lock already taken by a writer (or, for write
+ * locks, taken at all) are counted in the per filesystem tree lock stats.
  */
 
 /*
@@ -44,6 +52,9 @@ void __btrfs_tree_read_lock(struct extent_buffer *eb, enum btrfs_lock_nesting ne
 	if (trace_btrfs_tree_read_lock_enabled())
 		start_ns = ktime_get_ns();
 
+	if (raw_read_seqcount(&eb->lock_seq) & 1)
+		atomic64_inc(&eb->fs_info->tree_read_lock_contended);
+
 	down_read_nested(&eb->lock, nest);
 	eb->lock_owner = current->pid;
 	trace_btrfs_tree_read_lock(eb, start_ns);
@@ -77,6 +88,7 @@ int btrfs_try_tree_read_lock(struct extent_buffer *eb)
 int btrfs_try_tree_write_lock(struct extent_buffer *eb)
 {
 	if (down_write_trylock(&eb->lock)) {
+		raw_write_seqcount_begin(&eb->lock_seq);
 		eb->lock_owner = current->pid;
 		trace_btrfs_try_tree_write_lock(eb);
 		return 1;
@@ -109,7 +121,11 @@ void __btrfs_tree_lock(struct extent_buffer *eb, enum btrfs_lock_nesting nest)
 	if (trace_btrfs_tree_lock_enabled())
 		start_ns = ktime_get_ns();
 
+	if (rwsem_is_locked(&eb->lock))
+		atomic64_inc(&eb->fs_info->tree_lock_contended);
+
 	down_write_nested(&eb->lock, nest);
+	raw_write_seqcount_begin(&eb->lock_seq);
 	eb->lock_owner = current->pid;
 	trace_btrfs_tree_lock(eb, start_ns);
 }
@@ -126,6 +142,7 @@ void btrfs_tree_unlock(struct extent_buffer *eb)
 {
 	trace_btrfs_tree_unlock(eb);
 	eb->lock_owner = 0;
+	raw_write_seqcount_end(&eb->lock_seq);
 	up_write(&eb->lock);
 }
 
@@ -105,6 +105,23 @@ static inline void btrfs_assert_tree_locked(struct extent_buffer *eb) { }
 
 void btrfs_unlock_up_safe(struct btrfs_path *path, int level);
 
+/*
+ * Optimistic lockless read of an extent buffer: sample the sequence count with
+ * btrfs_tree_read_seq_begin(), read the buffer and only trust what was read if
+ * btrfs_tree_read_seq_retry() returns false.  The buffer must be pinned by a
+ * reference for the whole time.
+ */
+static inline unsigned int btrfs_tree_read_seq_begin(struct extent_buffer *eb)
+{
+	return raw_read_seqcount(&eb->lock_seq);
+}
+
+static inline bool btrfs_tree_read_seq_retry(struct extent_buffer *eb,
+					     unsigned int seq)
+{
+	return (seq & 1) || read_seqcount_retry(&eb->lock_seq, seq);
+}
+
 static inline void btrfs_tree_unlock_rw(struct extent_buffer *eb, int rw)
 {
 	if (rw == BTRFS_WRITE_LOCK)
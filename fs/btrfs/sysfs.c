@@ -456,6 +456,17 @@ static ssize_t btrfs_discard_extent_bytes_show(struct kobject *kobj,
 }
 BTRFS_ATTR(discard, discard_extent_bytes, btrfs_discard_extent_bytes_show);
 
+static ssize_t btrfs_discard_latency_show(struct kobject *kobj,
+					  struct kobj_attribute *a,
+					  char *buf)
+{
+	struct btrfs_fs_info *fs_info = discard_to_fs_info(kobj);
+
+	return scnprintf(buf, PAGE_SIZE, "%llu\n",
+			READ_ONCE(fs_info->discard_ctl.discard_latency_ns));
+}
+BTRFS_ATTR(discard, discard_latency_ns, btrfs_discard_latency_show);
+
 static ssize_t btrfs_discard_iops_limit_show(struct kobject *kobj,
 					     struct kobj_attribute *a,
 					     char *buf)
@@ -553,6 +564,7 @@ static const struct attribute *discard_debug_attrs[] = {
 	BTRFS_ATTR_PTR(discard, discard_bitmap_bytes),
 	BTRFS_ATTR_PTR(discard, discard_bytes_saved),
 	BTRFS_ATTR_PTR(discard, discard_extent_bytes),
+	BTRFS_ATTR_PTR(discard, discard_latency_ns),
 	BTRFS_ATTR_PTR(discard, iops_limit),
 	BTRFS_ATTR_PTR(discard, kbps_limit),
 	BTRFS_ATTR_PTR(discard, max_discard_size),
@@ -868,6 +880,26 @@ static ssize_t btrfs_checksum_show(struct kobject *kobj,
 
 BTRFS_ATTR(, checksum, btrfs_checksum_show);
 
+static ssize_t btrfs_checksum_stats_show(struct kobject *kobj,
+					 struct kobj_attribute *a, char *buf)
+{
+	struct btrfs_fs_info *fs_info = to_fs_info(kobj);
+	u64 bytes = atomic64_read(&fs_info->csum_verified_bytes);
+	u64 ns = atomic64_read(&fs_info->csum_verify_ns);
+
+	return scnprintf(buf, PAGE_SIZE,
+			 "algorithm %s\n"
+			 "verified_bytes %llu\n"
+			 "verify_ns %llu\n"
+			 "verify_mb_per_sec %llu\n"
+			 "parallel_bios %lld\n",
+			 crypto_shash_driver_name(fs_info->csum_shash),
+			 bytes, ns,
+			 ns ? div64_u64(bytes * 1000, ns) : 0,
+			 atomic64_read(&fs_info->csum_parallel_bios));
+}
+BTRFS_ATTR(, checksum_stats, btrfs_checksum_stats_show);
+
 static ssize_t btrfs_exclusive_operation_show(struct kobject *kobj,
 		struct kobj_attribute *a, char *buf)
 {
@@ -1014,6 +1046,21 @@ static ssize_t btrfs_bg_reclaim_threshold_store(struct kobject *kobj,
 BTRFS_ATTR_RW(, bg_reclaim_threshold, btrfs_bg_reclaim_threshold_show,
 	      btrfs_bg_reclaim_threshold_store);
 
+static ssize_t btrfs_tree_lock_stats_show(struct kobject *kobj,
+					  struct kobj_attribute *a, char *buf)
+{
+	struct btrfs_fs_info *fs_info = to_fs_info(kobj);
+
+	return scnprintf(buf, PAGE_SIZE,
+			 "write_lock_contended %lld\n"
+			 "read_lock_contended %lld\n"
+			 "search_restarts %lld\n",
+			 atomic64_read(&fs_info->tree_lock_contended),
+			 atomic64_read(&fs_info->tree_read_lock_contended),
+			 atomic64_read(&fs_info->tree_search_restarts));
+}
+BTRFS_ATTR(, tree_lock_stats, btrfs_tree_lock_stats_show);
+
 static const struct attribute *btrfs_attrs[] = {
 	BTRFS_ATTR_PTR(, label),
 	BTRFS_ATTR_PTR(, nodesize),
@@ -1022,10 +1069,12 @@ static const struct attribute *btrfs_attrs[] = {
 	BTRFS_ATTR_PTR(, quota_override),
 	BTRFS_ATTR_PTR(, metadata_uuid),
 	BTRFS_ATTR_PTR(, checksum),
+	BTRFS_ATTR_PTR(, checksum_stats),
 	BTRFS_ATTR_PTR(, exclusive_operation),
 	BTRFS_ATTR_PTR(, generation),
 	BTRFS_ATTR_PTR(, read_policy),
 	BTRFS_ATTR_PTR(, bg_reclaim_threshold),
+	BTRFS_ATTR_PTR(, tree_lock_stats),
 	NULL,
 };
 
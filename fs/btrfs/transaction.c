@@ -22,6 +22,7 @@
 #include "block-group.h"
 #include "space-info.h"
 #include "zoned.h"
+#include "free-space-tree.h"
 
 #define BTRFS_ROOT_TRANS_TAG 0
 
@@ -386,6 +387,8 @@ static noinline int join_transaction(struct btrfs_fs_info *fs_info,
 	spin_lock_init(&cur_trans->dropped_roots_lock);
 	INIT_LIST_HEAD(&cur_trans->releasing_ebs);
 	spin_lock_init(&cur_trans->releasing_ebs_lock);
+	INIT_LIST_HEAD(&cur_trans->free_space_batch_bgs);
+	spin_lock_init(&cur_trans->free_space_batch_lock);
 	atomic64_set(&cur_trans->chunk_bytes_reserved, 0);
 	init_waitqueue_head(&cur_trans->chunk_reserve_wait);
 	list_add_tail(&cur_trans->list, &fs_info->trans_list);
@@ -1269,6 +1272,15 @@ static noinline int commit_cowonly_roots(struct btrfs_trans_handle *trans)
 		return ret;
 
 again:
+	/*
+	 * Add this transaction's freed extents to the free space tree, which
+	 * frees and allocates tree blocks and thus generates delayed refs that
+	 * are run below, which in turn may free more extents.
+	 */
+	ret = btrfs_run_free_space_batches(trans);
+	if (ret)
+		return ret;
+
 	while (!list_empty(&fs_info->dirty_cowonly_roots)) {
 		struct btrfs_root *root;
 		next = fs_info->dirty_cowonly_roots.next;
@@ -1305,7 +1317,8 @@ static noinline int commit_cowonly_roots(struct btrfs_trans_handle *trans)
 			return ret;
 	}
 
-	if (!list_empty(&fs_info->dirty_cowonly_roots))
+	if (!list_empty(&fs_info->dirty_cowonly_roots) ||
+	    !list_empty(&trans->transaction->free_space_batch_bgs))
 		goto again;
 
 	list_add_tail(&fs_info->extent_root->dirty_list,
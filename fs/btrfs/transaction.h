@@ -97,6 +97,10 @@ struct btrfs_transaction {
 	spinlock_t releasing_ebs_lock;
 	struct list_head releasing_ebs;
 
+	/* Block groups with batched free space tree additions */
+	spinlock_t free_space_batch_lock;
+	struct list_head free_space_batch_bgs;
+
 	/*
 	 * The number of bytes currently reserved, by all transaction handles
 	 * attached to this transaction, for metadata extents of the chunk tree.
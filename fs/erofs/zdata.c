@@ -1040,12 +1040,13 @@ static int z_erofs_decompress_pcluster(struct super_block *sb,
 	return err;
 }
 
-static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
-				     struct list_head *pagepool)
+/* decompress at most @nr pclusters of the chain starting at @owned */
+static void z_erofs_decompress_pclusters(struct super_block *sb,
+					 z_erofs_next_pcluster_t owned,
+					 unsigned int nr,
+					 struct list_head *pagepool)
 {
-	z_erofs_next_pcluster_t owned = io->head;
-
-	while (owned != Z_EROFS_PCLUSTER_TAIL_CLOSED) {
+	while (nr-- && owned != Z_EROFS_PCLUSTER_TAIL_CLOSED) {
 		struct z_erofs_pcluster *pcl;
 
 		/* no possible that 'owned' equals Z_EROFS_WORK_TPTR_TAIL */
@@ -1057,8 +1058,98 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 		pcl = container_of(owned, struct z_erofs_pcluster, next);
 		owned = READ_ONCE(pcl->next);
 
-		z_erofs_decompress_pcluster(io->sb, pcl, pagepool);
+		z_erofs_decompress_pcluster(sb, pcl, pagepool);
+	}
+}
+
+static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
+				     struct list_head *pagepool)
+{
+	z_erofs_decompress_pclusters(io->sb, io->head, UINT_MAX, pagepool);
+}
+
+/* least number of pclusters worth handing over to another worker */
+#define Z_EROFS_PCLUSTERS_PER_JOB	4
+
+struct z_erofs_decompress_job {
+	struct work_struct work;
+	struct super_block *sb;
+	z_erofs_next_pcluster_t head;
+	unsigned int nr;
+	struct z_erofs_decompress_job *next;
+};
+
+static void z_erofs_decompress_job_work(struct work_struct *work)
+{
+	struct z_erofs_decompress_job *job =
+		container_of(work, struct z_erofs_decompress_job, work);
+	LIST_HEAD(pagepool);
+
+	z_erofs_decompress_pclusters(job->sb, job->head, job->nr, &pagepool);
+	put_pages_list(&pagepool);
+	kfree(job);
+}
+
+/*
+ * Split a large background queue (e.g. a whole readahead batch) so that its
+ * pclusters are decompressed on several CPUs instead of one after another.
+ * All pclusters but the first batch are handed over to other workers, and the
+ * number of pclusters left to the caller is returned.
+ *
+ * The chain must be completely split up before queueing any job, since a
+ * pcluster's next pointer is reset once it has been decompressed.
+ */
+static unsigned int z_erofs_fan_out_queue(const struct z_erofs_decompressqueue *io)
+{
+	struct z_erofs_decompress_job *jobs = NULL, **tail = &jobs;
+	z_erofs_next_pcluster_t owned = io->head;
+	unsigned int total = 0, per_job, nr_jobs, i;
+
+	while (owned != Z_EROFS_PCLUSTER_TAIL_CLOSED) {
+		owned = READ_ONCE(container_of(owned, struct z_erofs_pcluster,
+					       next)->next);
+		++total;
+	}
+
+	nr_jobs = min_t(unsigned int, num_online_cpus(),
+			total / Z_EROFS_PCLUSTERS_PER_JOB);
+	if (nr_jobs <= 1)
+		return UINT_MAX;
+	per_job = DIV_ROUND_UP(total, nr_jobs);
+
+	owned = io->head;
+	for (i = 0; owned != Z_EROFS_PCLUSTER_TAIL_CLOSED; ++i) {
+		struct z_erofs_decompress_job *job;
+
+		if (i && !(i % per_job)) {
+			job = kmalloc(sizeof(*job), GFP_NOIO | __GFP_NOWARN);
+			/* the last job (or the caller) takes the rest */
+			if (!job)
+				break;
+			INIT_WORK(&job->work, z_erofs_decompress_job_work);
+			job->sb = io->sb;
+			job->head = owned;
+			job->nr = per_job;
+			job->next = NULL;
+			*tail = job;
+			tail = &job->next;
+		}
+		owned = READ_ONCE(container_of(owned, struct z_erofs_pcluster,
+					       next)->next);
+	}
+	if (!jobs)
+		return UINT_MAX;
+	if (owned != Z_EROFS_PCLUSTER_TAIL_CLOSED)
+		container_of(tail, struct z_erofs_decompress_job,
+			     next)->nr = UINT_MAX;
+
+	while (jobs) {
+		struct z_erofs_decompress_job *job = jobs;
+
+		jobs = job->next;
+		queue_work(z_erofs_workqueue, &job->work);
 	}
+	return per_job;
 }
 
 static void z_erofs_decompressqueue_work(struct work_struct *work)
@@ -1068,7 +1159,8 @@ static void z_erofs_decompressqueue_work(struct work_struct *work)
 	LIST_HEAD(pagepool);
 
 	DBG_BUGON(bgq->head == Z_EROFS_PCLUSTER_TAIL_CLOSED);
-	z_erofs_decompress_queue(bgq, &pagepool);
+	z_erofs_decompress_pclusters(bgq->sb, bgq->head,
+				     z_erofs_fan_out_queue(bgq), &pagepool);
 
 	put_pages_list(&pagepool);
 	kvfree(bgq);
@@ -1801,6 +1801,7 @@ static int bprm_execve(struct linux_binprm *bprm,
 
 	check_unsafe_exec(bprm);
 	current->in_execve = 1;
+	sched_mm_cid_before_execve(current);
 
 	file = do_open_execat(fd, filename, flags);
 	retval = PTR_ERR(file);
@@ -1835,6 +1836,7 @@ static int bprm_execve(struct linux_binprm *bprm,
 	current->fs->in_exec = 0;
 	current->in_execve = 0;
 	rseq_execve(current);
+	sched_mm_cid_after_execve(current);
 	acct_update_integrals(current);
 	task_numa_free(current, false);
 	return retval;
@@ -1852,6 +1854,7 @@ static int bprm_execve(struct linux_binprm *bprm,
 out_unmark:
 	current->fs->in_exec = 0;
 	current->in_execve = 0;
+	sched_mm_cid_after_execve(current);
 
 	return retval;
 }
@@ -808,7 +808,6 @@ static  bool ext4_fc_add_dentry_tlv(struct super_block *sb, u16 tag,
  */
 static int ext4_fc_write_inode(struct inode *inode, u32 *crc)
 {
-	struct ext4_inode_info *ei = EXT4_I(inode);
 	int inode_len = EXT4_GOOD_OLD_INODE_SIZE;
 	int ret;
 	struct ext4_iloc iloc;
@@ -820,8 +819,13 @@ static int ext4_fc_write_inode(struct inode *inode, u32 *crc)
 	if (ret)
 		return ret;
 
+	/*
+	 * Log the whole on-disk inode, in-inode xattrs included, so that
+	 * xattr updates which fit into the inode don't need a full commit.
+	 * Replay copies as much of the inode as the tag length says.
+	 */
 	if (EXT4_INODE_SIZE(inode->i_sb) > EXT4_GOOD_OLD_INODE_SIZE)
-		inode_len += ei->i_extra_isize;
+		inode_len = EXT4_INODE_SIZE(inode->i_sb);
 
 	fc_inode.fc_ino = cpu_to_le32(inode->i_ino);
 	tl.fc_tag = cpu_to_le16(EXT4_FC_TAG_INODE);
@@ -2300,6 +2300,7 @@ ext4_xattr_set_handle(handle_t *handle, struct inode *inode, int name_index,
 	struct ext4_xattr_block_find bs = {
 		.s = { .not_found = -ENODATA, },
 	};
+	bool had_block;
 	int no_expand;
 	int error;
 
@@ -2309,6 +2310,7 @@ ext4_xattr_set_handle(handle_t *handle, struct inode *inode, int name_index,
 		return -ERANGE;
 
 	ext4_write_lock_xattr(inode, &no_expand);
+	had_block = EXT4_I(inode)->i_file_acl != 0;
 
 	/* Check journal credits under write lock. */
 	if (ext4_handle_valid(handle)) {
@@ -2425,7 +2427,13 @@ ext4_xattr_set_handle(handle_t *handle, struct inode *inode, int name_index,
 		if (IS_SYNC(inode))
 			ext4_handle_sync(handle);
 	}
-	ext4_fc_mark_ineligible(inode->i_sb, EXT4_FC_REASON_XATTR);
+	/*
+	 * The fast commit inode tag carries the whole on-disk inode, so
+	 * changes confined to the in-inode xattr area are covered by it.
+	 * Xattr blocks and EA inodes are not logged by fast commits.
+	 */
+	if (error || had_block || EXT4_I(inode)->i_file_acl || i.in_inode)
+		ext4_fc_mark_ineligible(inode->i_sb, EXT4_FC_REASON_XATTR);
 
 cleanup:
 	brelse(is.iloc.bh);
@@ -2503,7 +2511,6 @@ ext4_xattr_set(struct inode *inode, int name_index, const char *name,
 		if (error == 0)
 			error = error2;
 	}
-	ext4_fc_mark_ineligible(inode->i_sb, EXT4_FC_REASON_XATTR);
 
 	return error;
 }
@@ -21,6 +21,7 @@
 #include <linux/swap.h>
 #include <linux/splice.h>
 #include <linux/sched.h>
+#include <linux/io_uring.h>
 
 MODULE_ALIAS_MISCDEV(FUSE_MINOR);
 MODULE_ALIAS("devname:fuse");
@@ -222,6 +223,46 @@ const struct fuse_iqueue_ops fuse_dev_fiq_ops = {
 };
 EXPORT_SYMBOL_GPL(fuse_dev_fiq_ops);
 
+/* Per-command state of a parked FUSE_URING_CMD_FETCH */
+struct fuse_uring_pdu {
+	struct list_head list;
+	u64 buf;
+	u32 buf_len;
+};
+
+static inline struct fuse_uring_pdu *fuse_uring_pdu(struct io_uring_cmd *cmd)
+{
+	return (struct fuse_uring_pdu *)&cmd->pdu;
+}
+
+static inline struct io_uring_cmd *fuse_uring_pdu_cmd(struct fuse_uring_pdu *pdu)
+{
+	return container_of((void *)pdu, struct io_uring_cmd, pdu);
+}
+
+static void fuse_uring_cmd_work(struct io_uring_cmd *cmd);
+
+/*
+ * A request was routed to @q, hand it to a parked command if there is one.
+ * The copy to the daemon's buffer happens in the task that issued the
+ * command.
+ */
+static void fuse_uring_wake_and_unlock(struct fuse_iqueue *fiq,
+				       struct fuse_uring_queue *q)
+__releases(fiq->lock)
+{
+	struct fuse_uring_pdu *pdu;
+
+	pdu = list_first_entry_or_null(&q->cmds, struct fuse_uring_pdu, list);
+	if (pdu)
+		list_del_init(&pdu->list);
+	spin_unlock(&fiq->lock);
+
+	if (pdu)
+		io_uring_cmd_complete_in_task(fuse_uring_pdu_cmd(pdu),
+					      fuse_uring_cmd_work);
+}
+
 static void queue_request_and_unlock(struct fuse_iqueue *fiq,
 				     struct fuse_req *req)
 __releases(fiq->lock)
@@ -229,6 +270,18 @@ __releases(fiq->lock)
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		fuse_len_args(req->args->in_numargs,
 			      (struct fuse_arg *) req->args->in_args);
+
+	if (fiq->ring_cpu) {
+		struct fuse_uring_queue *q;
+
+		q = fiq->ring_cpu[raw_smp_processor_id()];
+		if (q) {
+			list_add_tail(&req->list, &q->pending);
+			fuse_uring_wake_and_unlock(fiq, q);
+			return;
+		}
+	}
+
 	list_add_tail(&req->list, &fiq->pending);
 	fiq->ops->wake_pending_and_unlock(fiq);
 }
@@ -1189,18 +1242,8 @@ __releases(fiq->lock)
  * fuse_request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
  */
-static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
-				struct fuse_copy_state *cs, size_t nbytes)
+static size_t fuse_dev_min_read(struct fuse_conn *fc)
 {
-	ssize_t err;
-	struct fuse_conn *fc = fud->fc;
-	struct fuse_iqueue *fiq = &fc->iq;
-	struct fuse_pqueue *fpq = &fud->pq;
-	struct fuse_req *req;
-	struct fuse_args *args;
-	unsigned reqsize;
-	unsigned int hash;
-
 	/*
 	 * Require sane minimum read buffer - that has capacity for fixed part
 	 * of any request header + negotiated max_write room for data.
@@ -1213,53 +1256,27 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	 * which is the absolute minimum any sane filesystem should be using
 	 * for header room.
 	 */
-	if (nbytes < max_t(size_t, FUSE_MIN_READ_BUFFER,
-			   sizeof(struct fuse_in_header) +
-			   sizeof(struct fuse_write_in) +
-			   fc->max_write))
-		return -EINVAL;
-
- restart:
-	for (;;) {
-		spin_lock(&fiq->lock);
-		if (!fiq->connected || request_pending(fiq))
-			break;
-		spin_unlock(&fiq->lock);
-
-		if (file->f_flags & O_NONBLOCK)
-			return -EAGAIN;
-		err = wait_event_interruptible_exclusive(fiq->waitq,
-				!fiq->connected || request_pending(fiq));
-		if (err)
-			return err;
-	}
-
-	if (!fiq->connected) {
-		err = fc->aborted ? -ECONNABORTED : -ENODEV;
-		goto err_unlock;
-	}
-
-	if (!list_empty(&fiq->interrupts)) {
-		req = list_entry(fiq->interrupts.next, struct fuse_req,
-				 intr_entry);
-		return fuse_read_interrupt(fiq, cs, nbytes, req);
-	}
-
-	if (forget_pending(fiq)) {
-		if (list_empty(&fiq->pending) || fiq->forget_batch-- > 0)
-			return fuse_read_forget(fc, fiq, cs, nbytes);
-
-		if (fiq->forget_batch <= -8)
-			fiq->forget_batch = 16;
-	}
-
-	req = list_entry(fiq->pending.next, struct fuse_req, list);
-	clear_bit(FR_PENDING, &req->flags);
-	list_del_init(&req->list);
-	spin_unlock(&fiq->lock);
+	return max_t(size_t, FUSE_MIN_READ_BUFFER,
+		     sizeof(struct fuse_in_header) +
+		     sizeof(struct fuse_write_in) +
+		     fc->max_write);
+}
 
-	args = req->args;
-	reqsize = req->in.h.len;
+/*
+ * Copy a request taken off a pending list to userspace and move it to the
+ * processing list of @fud.  Returns 0 if the request did not fit and was
+ * finished with an error, in which case the caller should try the next one.
+ */
+static ssize_t fuse_dev_send_req(struct fuse_dev *fud,
+				 struct fuse_copy_state *cs, size_t nbytes,
+				 struct fuse_req *req)
+{
+	ssize_t err;
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_pqueue *fpq = &fud->pq;
+	struct fuse_args *args = req->args;
+	unsigned reqsize = req->in.h.len;
+	unsigned int hash;
 
 	/* If request is too large, reply with an error and restart the read */
 	if (nbytes < reqsize) {
@@ -1268,7 +1285,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 		if (args->opcode == FUSE_SETXATTR)
 			req->out.h.error = -E2BIG;
 		fuse_request_end(req);
-		goto restart;
+		return 0;
 	}
 	spin_lock(&fpq->lock);
 	list_add(&req->list, &fpq->io);
@@ -1312,6 +1329,62 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	spin_unlock(&fpq->lock);
 	fuse_request_end(req);
 	return err;
+}
+
+static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
+				struct fuse_copy_state *cs, size_t nbytes)
+{
+	ssize_t err;
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_req *req;
+
+	if (nbytes < fuse_dev_min_read(fc))
+		return -EINVAL;
+
+ restart:
+	for (;;) {
+		spin_lock(&fiq->lock);
+		if (!fiq->connected || request_pending(fiq))
+			break;
+		spin_unlock(&fiq->lock);
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		err = wait_event_interruptible_exclusive(fiq->waitq,
+				!fiq->connected || request_pending(fiq));
+		if (err)
+			return err;
+	}
+
+	if (!fiq->connected) {
+		err = fc->aborted ? -ECONNABORTED : -ENODEV;
+		goto err_unlock;
+	}
+
+	if (!list_empty(&fiq->interrupts)) {
+		req = list_entry(fiq->interrupts.next, struct fuse_req,
+				 intr_entry);
+		return fuse_read_interrupt(fiq, cs, nbytes, req);
+	}
+
+	if (forget_pending(fiq)) {
+		if (list_empty(&fiq->pending) || fiq->forget_batch-- > 0)
+			return fuse_read_forget(fc, fiq, cs, nbytes);
+
+		if (fiq->forget_batch <= -8)
+			fiq->forget_batch = 16;
+	}
+
+	req = list_entry(fiq->pending.next, struct fuse_req, list);
+	clear_bit(FR_PENDING, &req->flags);
+	list_del_init(&req->list);
+	spin_unlock(&fiq->lock);
+
+	err = fuse_dev_send_req(fud, cs, nbytes, req);
+	if (!err)
+		goto restart;
+	return err;
 
  err_unlock:
 	spin_unlock(&fiq->lock);
@@ -2029,6 +2102,268 @@ static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 	return ret;
 }
 
+#define FUSE_URING_MONITOR_PERIOD	HZ
+
+/* Route requests queued on each CPU to the closest ring queue */
+static void fuse_uring_map_cpus(struct fuse_iqueue *fiq)
+{
+	struct fuse_uring_queue *q;
+	int cpu;
+
+	lockdep_assert_held(&fiq->lock);
+
+	for_each_possible_cpu(cpu) {
+		struct fuse_uring_queue *best = NULL;
+
+		list_for_each_entry(q, &fiq->ring_queues, entry) {
+			if (q->cpu == cpu) {
+				best = q;
+				break;
+			}
+			if (!best || (cpu_to_node(q->cpu) == cpu_to_node(cpu) &&
+				      cpu_to_node(best->cpu) != cpu_to_node(cpu)))
+				best = q;
+		}
+		fiq->ring_cpu[cpu] = best;
+	}
+}
+
+/*
+ * Take @q out of the routing and give its requests back to the readers of
+ * the device.  Parked commands are moved to @cmds for the caller to finish
+ * once fiq->lock is dropped.
+ */
+static void fuse_uring_stop_queue(struct fuse_iqueue *fiq,
+				  struct fuse_uring_queue *q,
+				  struct list_head *cmds)
+{
+	list_del_init(&q->entry);
+	fuse_uring_map_cpus(fiq);
+	list_splice_tail_init(&q->cmds, cmds);
+	if (!list_empty(&q->pending)) {
+		list_splice_tail_init(&q->pending, &fiq->pending);
+		wake_up(&fiq->waitq);
+	}
+}
+
+static void fuse_uring_end_cmds(struct list_head *head, int err)
+{
+	struct fuse_uring_pdu *pdu, *next;
+
+	list_for_each_entry_safe(pdu, next, head, list) {
+		list_del_init(&pdu->list);
+		io_uring_cmd_done(fuse_uring_pdu_cmd(pdu), err, 0);
+	}
+}
+
+/*
+ * io_uring waits for in-flight commands before a task finishes exiting, so
+ * commands parked by a daemon that went away have to be completed here.
+ */
+void fuse_uring_monitor(struct work_struct *work)
+{
+	struct fuse_iqueue *fiq = container_of(to_delayed_work(work),
+					       struct fuse_iqueue, ring_monitor);
+	struct fuse_uring_queue *q, *next;
+	LIST_HEAD(cmds);
+
+	spin_lock(&fiq->lock);
+	list_for_each_entry_safe(q, next, &fiq->ring_queues, entry) {
+		if (q->task->flags & PF_EXITING)
+			fuse_uring_stop_queue(fiq, q, &cmds);
+	}
+	if (!list_empty(&fiq->ring_queues))
+		schedule_delayed_work(&fiq->ring_monitor,
+				      FUSE_URING_MONITOR_PERIOD);
+	spin_unlock(&fiq->lock);
+
+	fuse_uring_end_cmds(&cmds, -ENOTCONN);
+}
+
+static int fuse_uring_register(struct fuse_dev *fud, u32 cpu)
+{
+	struct fuse_iqueue *fiq = &fud->fc->iq;
+	struct fuse_uring_queue **map = NULL;
+	struct fuse_uring_queue *q;
+	int err = 0;
+
+	if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+
+	q = kzalloc(sizeof(*q), GFP_KERNEL);
+	if (!q)
+		return -ENOMEM;
+	if (!READ_ONCE(fiq->ring_cpu)) {
+		map = kcalloc(nr_cpu_ids, sizeof(*map), GFP_KERNEL);
+		if (!map) {
+			kfree(q);
+			return -ENOMEM;
+		}
+	}
+	q->fud = fud;
+	q->cpu = cpu;
+	INIT_LIST_HEAD(&q->pending);
+	INIT_LIST_HEAD(&q->cmds);
+	INIT_LIST_HEAD(&q->entry);
+
+	spin_lock(&fiq->lock);
+	if (!fiq->connected) {
+		err = -ENOTCONN;
+	} else if (fud->ring) {
+		err = -EBUSY;
+	} else {
+		if (!fiq->ring_cpu)
+			swap(fiq->ring_cpu, map);
+		if (list_empty(&fiq->ring_queues))
+			schedule_delayed_work(&fiq->ring_monitor,
+					      FUSE_URING_MONITOR_PERIOD);
+		q->task = get_task_struct(current);
+		list_add_tail(&q->entry, &fiq->ring_queues);
+		fud->ring = q;
+		fuse_uring_map_cpus(fiq);
+		q = NULL;
+	}
+	spin_unlock(&fiq->lock);
+
+	kfree(map);
+	kfree(q);
+	return err;
+}
+
+static void fuse_uring_release(struct fuse_dev *fud)
+{
+	struct fuse_iqueue *fiq = &fud->fc->iq;
+	struct fuse_uring_queue *q = fud->ring;
+	LIST_HEAD(cmds);
+	bool last;
+
+	spin_lock(&fiq->lock);
+	if (!list_empty(&q->entry))
+		fuse_uring_stop_queue(fiq, q, &cmds);
+	last = list_empty(&fiq->ring_queues);
+	spin_unlock(&fiq->lock);
+
+	/* in-flight commands hold a reference to the file */
+	WARN_ON(!list_empty(&cmds));
+	if (last) {
+		cancel_delayed_work_sync(&fiq->ring_monitor);
+		/* a queue registered meanwhile still needs the monitor */
+		spin_lock(&fiq->lock);
+		if (!list_empty(&fiq->ring_queues))
+			schedule_delayed_work(&fiq->ring_monitor,
+					      FUSE_URING_MONITOR_PERIOD);
+		spin_unlock(&fiq->lock);
+	}
+
+	fud->ring = NULL;
+	put_task_struct(q->task);
+	kfree(q);
+}
+
+/*
+ * Hand the next request routed to the device's queue to @cmd, or park the
+ * command until one arrives.  Must run in the task that issued the command,
+ * as the request is copied straight to the daemon's buffer.
+ */
+static int fuse_uring_fetch(struct fuse_dev *fud, struct io_uring_cmd *cmd)
+{
+	struct fuse_uring_pdu *pdu = fuse_uring_pdu(cmd);
+	struct fuse_uring_queue *q = fud->ring;
+	struct fuse_conn *fc = fud->fc;
+	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_copy_state cs;
+	struct fuse_req *req;
+	struct iov_iter iter;
+	struct iovec iov;
+	ssize_t ret;
+
+	ret = import_single_range(READ, u64_to_user_ptr(pdu->buf),
+				  pdu->buf_len, &iov, &iter);
+	if (ret)
+		return ret;
+
+	do {
+		spin_lock(&fiq->lock);
+		if (!fiq->connected) {
+			spin_unlock(&fiq->lock);
+			return fc->aborted ? -ECONNABORTED : -ENODEV;
+		}
+		if (list_empty(&q->entry)) {
+			spin_unlock(&fiq->lock);
+			return -ENOTCONN;
+		}
+		req = list_first_entry_or_null(&q->pending, struct fuse_req,
+					       list);
+		if (!req) {
+			list_add_tail(&pdu->list, &q->cmds);
+			spin_unlock(&fiq->lock);
+			return -EIOCBQUEUED;
+		}
+		clear_bit(FR_PENDING, &req->flags);
+		list_del_init(&req->list);
+		spin_unlock(&fiq->lock);
+
+		fuse_copy_init(&cs, 1, &iter);
+		ret = fuse_dev_send_req(fud, &cs, pdu->buf_len, req);
+	} while (!ret);
+
+	return ret;
+}
+
+static void fuse_uring_cmd_work(struct io_uring_cmd *cmd)
+{
+	int ret = -ECANCELED;
+
+	/* the fallback for an exiting task runs without its mm */
+	if (current->mm)
+		ret = fuse_uring_fetch(fuse_get_dev(cmd->file), cmd);
+	if (ret != -EIOCBQUEUED)
+		io_uring_cmd_done(cmd, ret, 0);
+}
+
+static int fuse_dev_uring_cmd(struct io_uring_cmd *cmd,
+			      unsigned int issue_flags)
+{
+	const struct fuse_uring_cmd *ucmd = cmd->cmd;
+	struct fuse_uring_pdu *pdu = fuse_uring_pdu(cmd);
+	struct fuse_dev *fud = fuse_get_dev(cmd->file);
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	struct iovec iov;
+	u32 reply_len;
+	ssize_t ret;
+
+	BUILD_BUG_ON(sizeof(*pdu) > sizeof(cmd->pdu));
+
+	if (!fud)
+		return -EPERM;
+	if (!fud->ring)
+		return -EINVAL;
+	if (cmd->cmd_op != FUSE_URING_CMD_FETCH)
+		return -EOPNOTSUPP;
+
+	/* the SQE may be reused while the command is parked */
+	pdu->buf = READ_ONCE(ucmd->buf);
+	pdu->buf_len = READ_ONCE(ucmd->buf_len);
+	reply_len = READ_ONCE(ucmd->reply_len);
+	if (pdu->buf_len < fuse_dev_min_read(fud->fc) ||
+	    reply_len > pdu->buf_len)
+		return -EINVAL;
+
+	if (reply_len) {
+		ret = import_single_range(WRITE, u64_to_user_ptr(pdu->buf),
+					  reply_len, &iov, &iter);
+		if (ret)
+			return ret;
+		fuse_copy_init(&cs, 0, &iter);
+		ret = fuse_dev_do_write(fud, &cs, reply_len);
+		if (ret < 0)
+			return ret;
+	}
+
+	return fuse_uring_fetch(fud, cmd);
+}
+
 static __poll_t fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	__poll_t mask = EPOLLOUT | EPOLLWRNORM;
@@ -2105,7 +2440,9 @@ void fuse_abort_conn(struct fuse_conn *fc)
 	if (fc->connected) {
 		struct fuse_dev *fud;
 		struct fuse_req *req, *next;
+		struct fuse_uring_queue *q;
 		LIST_HEAD(to_end);
+		LIST_HEAD(cmds);
 		unsigned int i;
 
 		/* Background queuing checks fc->connected under bg_lock */
@@ -2146,6 +2483,12 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		list_for_each_entry(req, &fiq->pending, list)
 			clear_bit(FR_PENDING, &req->flags);
 		list_splice_tail_init(&fiq->pending, &to_end);
+		list_for_each_entry(q, &fiq->ring_queues, entry) {
+			list_for_each_entry(req, &q->pending, list)
+				clear_bit(FR_PENDING, &req->flags);
+			list_splice_tail_init(&q->pending, &to_end);
+			list_splice_tail_init(&q->cmds, &cmds);
+		}
 		while (forget_pending(fiq))
 			kfree(fuse_dequeue_forget(fiq, 1, NULL));
 		wake_up_all(&fiq->waitq);
@@ -2155,6 +2498,7 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		wake_up_all(&fc->blocked_waitq);
 		spin_unlock(&fc->lock);
 
+		fuse_uring_end_cmds(&cmds, -ECONNABORTED);
 		end_requests(&to_end);
 	} else {
 		spin_unlock(&fc->lock);
@@ -2179,6 +2523,9 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 		LIST_HEAD(to_end);
 		unsigned int i;
 
+		if (fud->ring)
+			fuse_uring_release(fud);
+
 		spin_lock(&fpq->lock);
 		WARN_ON(!list_empty(&fpq->io));
 		for (i = 0; i < FUSE_PQ_HASH_SIZE; i++)
@@ -2258,6 +2605,31 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 			}
 		}
 		break;
+	case FUSE_DEV_IOC_PASSTHROUGH_OPEN: {
+		struct fuse_passthrough_out pto;
+
+		res = -EFAULT;
+		if (!copy_from_user(&pto, (void __user *)arg, sizeof(pto))) {
+			fud = fuse_get_dev(file);
+			if (!fud)
+				res = -EPERM;
+			else if (pto.flags)
+				res = -EINVAL;
+			else
+				res = fuse_passthrough_open(fud, pto.fd);
+		}
+		break;
+	}
+	case FUSE_DEV_IOC_URING_QUEUE: {
+		u32 cpu;
+
+		res = -EFAULT;
+		if (!get_user(cpu, (__u32 __user *)arg)) {
+			fud = fuse_get_dev(file);
+			res = fud ? fuse_uring_register(fud, cpu) : -EPERM;
+		}
+		break;
+	}
 	default:
 		res = -ENOTTY;
 		break;
@@ -2278,6 +2650,7 @@ const struct file_operations fuse_dev_operations = {
 	.fasync		= fuse_dev_fasync,
 	.unlocked_ioctl = fuse_dev_ioctl,
 	.compat_ioctl   = compat_ptr_ioctl,
+	.uring_cmd	= fuse_dev_uring_cmd,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
@@ -31,13 +31,17 @@
 #include <linux/pid_namespace.h>
 #include <linux/refcount.h>
 #include <linux/user_namespace.h>
+#include <linux/idr.h>
 
 /** Default max number of pages that can be used in a single read request */
 #define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
 
-/** Maximum of max_pages received in init_out */
+/** Default maximum of max_pages received in init_out */
 #define FUSE_MAX_MAX_PAGES 256
 
+/** Upper bound of the max_pages_limit module parameter (max_pages is u16) */
+#define FUSE_MAX_MAX_PAGES_LIMIT 65535
+
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
@@ -180,6 +184,12 @@ struct fuse_conn;
 struct fuse_mount;
 struct fuse_release_args;
 
+/** Backing file of a passthrough open */
+struct fuse_passthrough {
+	struct file *filp;
+	struct cred *cred;
+};
+
 /** FUSE specific file data */
 struct fuse_file {
 	/** Fuse connection for this file */
@@ -233,6 +243,9 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** Backing file for read/write/mmap, if the daemon set one up */
+	struct fuse_passthrough passthrough;
 };
 
 /** One input argument of a request */
@@ -454,6 +467,15 @@ struct fuse_iqueue {
 
 	/** Device-specific state */
 	void *priv;
+
+	/** io_uring queues of the connection */
+	struct list_head ring_queues;
+
+	/** io_uring queue that takes the requests queued on each CPU */
+	struct fuse_uring_queue **ring_cpu;
+
+	/** Stops ring queues whose task is exiting */
+	struct delayed_work ring_monitor;
 };
 
 #define FUSE_PQ_HASH_BITS 8
@@ -485,6 +507,35 @@ struct fuse_dev {
 
 	/** list entry on fc->devices */
 	struct list_head entry;
+
+	/** io_uring queue, NULL unless registered on this device */
+	struct fuse_uring_queue *ring;
+};
+
+/**
+ * io_uring transport queue of a fuse device
+ *
+ * Requests are routed to a queue by the CPU they are queued on and handed to
+ * FUSE_URING_CMD_FETCH commands issued on the device, all under fiq->lock.
+ */
+struct fuse_uring_queue {
+	/** Device the commands are issued on */
+	struct fuse_dev *fud;
+
+	/** CPU the queue serves */
+	int cpu;
+
+	/** Task that registered the queue */
+	struct task_struct *task;
+
+	/** Requests waiting for a command */
+	struct list_head pending;
+
+	/** Commands waiting for a request */
+	struct list_head cmds;
+
+	/** list entry on fiq->ring_queues, empty once the queue is stopped */
+	struct list_head entry;
 };
 
 struct fuse_fs_context {
@@ -674,6 +725,9 @@ struct fuse_conn {
 	/** Does file server support extended setxattr */
 	unsigned setxattr_ext:1;
 
+	/** Can opens forward read/write/mmap to a backing file? */
+	unsigned passthrough:1;
+
 	/** Is getxattr not implemented by fs? */
 	unsigned no_getxattr:1;
 
@@ -797,6 +851,12 @@ struct fuse_conn {
 	/** List of device instances belonging to this connection */
 	struct list_head devices;
 
+	/** Backing files registered for passthrough, not yet opened */
+	struct idr passthrough_req;
+
+	/** Protects passthrough_req */
+	spinlock_t passthrough_req_lock;
+
 #ifdef CONFIG_FUSE_DAX
 	/* Dax specific conn data, non-NULL if DAX is enabled */
 	struct fuse_conn_dax *dax;
@@ -1072,6 +1132,7 @@ struct fuse_dev *fuse_dev_alloc_install(struct fuse_conn *fc);
 struct fuse_dev *fuse_dev_alloc(void);
 void fuse_dev_install(struct fuse_dev *fud, struct fuse_conn *fc);
 void fuse_dev_free(struct fuse_dev *fud);
+void fuse_uring_monitor(struct work_struct *work);
 void fuse_send_init(struct fuse_mount *fm);
 
 /**
@@ -1188,6 +1249,16 @@ int fuse_dev_release(struct inode *inode, struct file *file);
 
 bool fuse_write_update_size(struct inode *inode, loff_t pos);
 
+/* passthrough.c */
+int fuse_passthrough_open(struct fuse_dev *fud, u32 lower_fd);
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_file *ff,
+			    struct fuse_open_out *open);
+void fuse_passthrough_release(struct fuse_passthrough *passthrough);
+void fuse_passthrough_free_all(struct fuse_conn *fc);
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *iter);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *iter);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 int fuse_flush_times(struct inode *inode, struct fuse_file *ff);
 int fuse_write_inode(struct inode *inode, struct writeback_control *wbc);
 
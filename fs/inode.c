@@ -1970,27 +1970,34 @@ EXPORT_SYMBOL(file_remove_privs);
  *	file systems who need to allocate space in order to update an inode.
  */
 
-int file_update_time(struct file *file)
+static int inode_needs_update_time(struct inode *inode, struct timespec64 *now)
 {
-	struct inode *inode = file_inode(file);
-	struct timespec64 now;
 	int sync_it = 0;
-	int ret;
 
 	/* First try to exhaust all avenues to not sync */
 	if (IS_NOCMTIME(inode))
 		return 0;
 
-	now = current_time(inode);
-	if (!timespec64_equal(&inode->i_mtime, &now))
+	if (!timespec64_equal(&inode->i_mtime, now))
 		sync_it = S_MTIME;
 
-	if (!timespec64_equal(&inode->i_ctime, &now))
+	if (!timespec64_equal(&inode->i_ctime, now))
 		sync_it |= S_CTIME;
 
 	if (IS_I_VERSION(inode) && inode_iversion_need_inc(inode))
 		sync_it |= S_VERSION;
 
+	return sync_it;
+}
+
+int file_update_time(struct file *file)
+{
+	struct inode *inode = file_inode(file);
+	struct timespec64 now = current_time(inode);
+	int sync_it;
+	int ret;
+
+	sync_it = inode_needs_update_time(inode, &now);
 	if (!sync_it)
 		return 0;
 
@@ -2025,6 +2032,43 @@ int file_modified(struct file *file)
 }
 EXPORT_SYMBOL(file_modified);
 
+/**
+ * kiocb_modified - handle mandated file changes when modifying a file
+ * @iocb: iocb being written to the file
+ *
+ * Like file_modified(), but for %IOCB_NOWAIT writes returns -EAGAIN if
+ * removing privileges or updating the timestamps would have to block.
+ *
+ * Caller must hold the file's inode lock.
+ */
+int kiocb_modified(struct kiocb *iocb)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	struct timespec64 now;
+	int kill;
+
+	if (!(iocb->ki_flags & IOCB_NOWAIT))
+		return file_modified(file);
+
+	if (!IS_NOSEC(inode) && S_ISREG(inode->i_mode)) {
+		kill = dentry_needs_remove_privs(file_dentry(file));
+		if (kill < 0)
+			return kill;
+		if (kill)
+			return -EAGAIN;
+	}
+
+	if (unlikely(file->f_mode & FMODE_NOCMTIME))
+		return 0;
+
+	now = current_time(inode);
+	if (inode_needs_update_time(inode, &now))
+		return -EAGAIN;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(kiocb_modified);
+
 int inode_needs_sync(struct inode *inode)
 {
 	if (IS_SYNC(inode))
@@ -16,6 +16,7 @@ struct shrink_control;
 struct fs_context;
 struct user_namespace;
 struct pipe_inode_info;
+struct linux_dirent64;
 
 /*
  * block_dev.c
@@ -165,6 +166,7 @@ extern struct dentry * d_alloc_pseudo(struct super_block *, const struct qstr *)
 extern char *simple_dname(struct dentry *, char *, int);
 extern void dput_to_list(struct dentry *, struct list_head *);
 extern void shrink_dentry_list(struct list_head *);
+extern void d_hash_prefetch(unsigned int hash);
 
 /*
  * read_write.c
@@ -196,6 +198,12 @@ int sb_init_dio_done_wq(struct super_block *sb);
 int do_statx(int dfd, const char __user *filename, unsigned flags,
 	     unsigned int mask, struct statx __user *buffer);
 
+/*
+ * fs/readdir.c:
+ */
+int vfs_getdents(struct file *file, struct linux_dirent64 __user *dirent,
+		 unsigned int count);
+
 /*
  * fs/splice.c:
  */
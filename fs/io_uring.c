@@ -77,6 +77,7 @@
 #include <linux/splice.h>
 #include <linux/task_work.h>
 #include <linux/pagemap.h>
+#include <linux/vmalloc.h>
 #include <linux/io_uring.h>
 
 #define CREATE_TRACE_POINTS
@@ -102,6 +103,10 @@
 
 #define IORING_MAX_REG_BUFFERS	(1U << 14)
 
+/* SQEs submitted per weight unit and round when a SQPOLL thread is shared */
+#define IORING_SQPOLL_CAP_ENTRIES_VALUE	8
+#define IORING_SQPOLL_MAX_WEIGHT	64
+
 #define SQE_VALID_FLAGS	(IOSQE_FIXED_FILE|IOSQE_IO_DRAIN|IOSQE_IO_LINK|	\
 				IOSQE_IO_HARDLINK | IOSQE_ASYNC | \
 				IOSQE_BUFFER_SELECT)
@@ -189,11 +194,6 @@ struct io_rings {
 	struct io_uring_cqe	cqes[] ____cacheline_aligned_in_smp;
 };
 
-enum io_uring_cmd_flags {
-	IO_URING_F_NONBLOCK		= 1,
-	IO_URING_F_COMPLETE_DEFER	= 2,
-};
-
 struct io_mapped_ubuf {
 	u64		ubuf;
 	u64		ubuf_end;
@@ -205,8 +205,9 @@ struct io_mapped_ubuf {
 struct io_ring_ctx;
 
 struct io_overflow_cqe {
-	struct io_uring_cqe cqe;
 	struct list_head list;
+	/* last, followed by the big_cqe part with IORING_SETUP_CQE32 */
+	struct io_uring_cqe cqe;
 };
 
 struct io_fixed_file {
@@ -257,6 +258,19 @@ struct io_buffer {
 	__u16 bid;
 };
 
+/*
+ * Ring-mapped provided buffer group. The application owns the tail, the
+ * kernel only ever moves @head. Selecting a buffer keeps no kernel state
+ * around, the request just remembers the address and bid it was given.
+ */
+struct io_buffer_ring {
+	struct io_uring_buf_ring	*buf_ring;
+	struct page			**pages;
+	int				nr_pages;
+	__u16				head;
+	__u16				mask;
+};
+
 struct io_restriction {
 	DECLARE_BITMAP(register_op, IORING_REGISTER_LAST);
 	DECLARE_BITMAP(sqe_op, IORING_OP_LAST);
@@ -337,6 +351,25 @@ struct io_submit_state {
 	unsigned int		ios_left;
 };
 
+/*
+ * Per-ring event counters, shown in fdinfo. Kept per-cpu as they're bumped
+ * from submission, io-wq and completion context alike.
+ */
+enum {
+	IO_STAT_INLINE,		/* issued inline without blocking */
+	IO_STAT_POLL_ARMED,	/* -EAGAIN, waiting on async poll */
+	IO_STAT_ASYNC,		/* punted to io-wq */
+	IO_STAT_TASK_WORK,	/* completions routed through task_work */
+	IO_STAT_CQ_OVERFLOW,	/* CQEs saved on the overflow list */
+	IO_STAT_CQ_DROPPED,	/* CQEs lost */
+
+	IO_STAT_NR,
+};
+
+struct io_ring_stats {
+	unsigned long		stat[IO_STAT_NR];
+};
+
 struct io_ring_ctx {
 	struct {
 		struct percpu_ref	refs;
@@ -365,6 +398,7 @@ struct io_ring_ctx {
 		unsigned		sq_entries;
 		unsigned		sq_mask;
 		unsigned		sq_thread_idle;
+		unsigned		sq_weight;
 		unsigned		cached_sq_dropped;
 		unsigned		cached_cq_overflow;
 		unsigned long		sq_check_overflow;
@@ -420,6 +454,7 @@ struct io_ring_ctx {
 #endif
 
 	struct xarray		io_buffers;
+	struct xarray		io_buf_rings;
 
 	struct xarray		personalities;
 	u32			pers_next;
@@ -461,6 +496,7 @@ struct io_ring_ctx {
 	struct io_mapped_ubuf		*dummy_ubuf;
 
 	struct io_restriction		restrictions;
+	struct io_ring_stats __percpu	*stats;
 
 	/* exit task_work */
 	struct callback_head		*exit_task_work;
@@ -470,6 +506,9 @@ struct io_ring_ctx {
 	struct list_head		tctx_list;
 };
 
+/* per-task registered ring files, see IORING_REGISTER_RING_FDS */
+#define IO_RINGFD_REG_MAX	16
+
 struct io_uring_task {
 	/* submission side */
 	struct xarray		xa;
@@ -484,6 +523,8 @@ struct io_uring_task {
 	struct io_wq_work_list	task_list;
 	unsigned long		task_state;
 	struct callback_head	task_work;
+
+	struct file		*registered_rings[IO_RINGFD_REG_MAX];
 };
 
 /*
@@ -582,7 +623,15 @@ struct io_sr_msg {
 	int				msg_flags;
 	int				bgid;
 	size_t				len;
-	struct io_buffer		*kbuf;
+	union {
+		struct io_buffer	*kbuf;
+		/* selected buffer, if it came from a buffer ring */
+		void __user		*rbuf;
+		/* zerocopy send buffer release notification */
+		struct io_notif		*notif;
+	};
+	/* IORING_RECVSEND_* / IORING_RECV_* flags from sqe->ioprio */
+	u16				flags;
 };
 
 struct io_open {
@@ -591,6 +640,7 @@ struct io_open {
 	struct filename			*filename;
 	struct open_how			how;
 	unsigned long			nofile;
+	u32				file_slot;
 };
 
 struct io_rsrc_update {
@@ -670,12 +720,29 @@ struct io_unlink {
 	struct filename			*filename;
 };
 
+struct io_getdents {
+	struct file			*file;
+	struct linux_dirent64 __user	*dirent;
+	unsigned int			count;
+	loff_t				pos;
+};
+
 struct io_completion {
 	struct file			*file;
 	struct list_head		list;
 	u32				cflags;
 };
 
+/*
+ * Zerocopy send notification. Skbs referencing the user pages hold a
+ * reference to ->uarg, the last put posts an IORING_CQE_F_NOTIF CQE.
+ */
+struct io_notif {
+	struct ubuf_info		uarg;
+	struct io_ring_ctx		*ctx;
+	u64				user_data;
+};
+
 struct io_async_connect {
 	struct sockaddr_storage		address;
 };
@@ -718,6 +785,8 @@ enum {
 	REQ_F_COMPLETE_INLINE_BIT,
 	REQ_F_REISSUE_BIT,
 	REQ_F_DONT_REISSUE_BIT,
+	REQ_F_BUFFER_RING_BIT,
+	REQ_F_APOLL_MULTISHOT_BIT,
 	/* keep async read/write and isreg together and in order */
 	REQ_F_ASYNC_READ_BIT,
 	REQ_F_ASYNC_WRITE_BIT,
@@ -765,6 +834,10 @@ enum {
 	REQ_F_REISSUE		= BIT(REQ_F_REISSUE_BIT),
 	/* don't attempt request reissue, see io_rw_reissue() */
 	REQ_F_DONT_REISSUE	= BIT(REQ_F_DONT_REISSUE_BIT),
+	/* selected buffer came from a ring-mapped group, see io_buffer_ring */
+	REQ_F_BUFFER_RING	= BIT(REQ_F_BUFFER_RING_BIT),
+	/* stays armed through async poll, posting CQEs with F_MORE */
+	REQ_F_APOLL_MULTISHOT	= BIT(REQ_F_APOLL_MULTISHOT_BIT),
 	/* supports async reads */
 	REQ_F_ASYNC_READ	= BIT(REQ_F_ASYNC_READ_BIT),
 	/* supports async writes */
@@ -819,6 +892,8 @@ struct io_kiocb {
 		struct io_shutdown	shutdown;
 		struct io_rename	rename;
 		struct io_unlink	unlink;
+		struct io_getdents	getdents;
+		struct io_uring_cmd	uring_cmd;
 		/* use only after cleaning per-op data, see io_clean_op() */
 		struct io_completion	compl;
 	};
@@ -837,6 +912,9 @@ struct io_kiocb {
 	atomic_t			refs;
 	struct task_struct		*task;
 	u64				user_data;
+	/* big_cqe payload, only posted with IORING_SETUP_CQE32 */
+	u64				extra1;
+	u64				extra2;
 
 	struct io_kiocb			*link;
 	struct percpu_ref		*fixed_rsrc_refs;
@@ -1031,6 +1109,21 @@ static const struct io_op_def io_op_defs[] = {
 	},
 	[IORING_OP_RENAMEAT] = {},
 	[IORING_OP_UNLINKAT] = {},
+	[IORING_OP_SEND_ZC] = {
+		.needs_file		= 1,
+		.unbound_nonreg_file	= 1,
+		.pollout		= 1,
+	},
+	[IORING_OP_GETDENTS] = {
+		.needs_file		= 1,
+	},
+	[IORING_OP_URING_CMD] = {
+		.needs_file		= 1,
+		.plug			= 1,
+		.needs_async_setup	= 1,
+		.async_size		= 2 * sizeof(struct io_uring_sqe) -
+					  offsetof(struct io_uring_sqe, cmd),
+	},
 };
 
 static bool io_disarm_next(struct io_kiocb *req);
@@ -1057,6 +1150,8 @@ static struct file *io_file_get(struct io_submit_state *state,
 				struct io_kiocb *req, int fd, bool fixed);
 static void __io_queue_sqe(struct io_kiocb *req);
 static void io_rsrc_put_work(struct work_struct *work);
+static int io_install_fixed_file(struct io_kiocb *req, struct file *file,
+				 unsigned int issue_flags, u32 slot_index);
 
 static void io_req_task_queue(struct io_kiocb *req);
 static void io_submit_flush_completions(struct io_comp_state *cs,
@@ -1172,6 +1267,10 @@ static struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
 	/* set invalid range, so io_import_fixed() fails meeting it */
 	ctx->dummy_ubuf->ubuf = -1UL;
 
+	ctx->stats = alloc_percpu(struct io_ring_stats);
+	if (!ctx->stats)
+		goto err;
+
 	if (percpu_ref_init(&ctx->refs, io_ring_ctx_ref_free,
 			    PERCPU_REF_ALLOW_REINIT, GFP_KERNEL))
 		goto err;
@@ -1183,6 +1282,7 @@ static struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
 	INIT_LIST_HEAD(&ctx->cq_overflow_list);
 	init_completion(&ctx->ref_comp);
 	xa_init_flags(&ctx->io_buffers, XA_FLAGS_ALLOC1);
+	xa_init(&ctx->io_buf_rings);
 	xa_init_flags(&ctx->personalities, XA_FLAGS_ALLOC1);
 	mutex_init(&ctx->uring_lock);
 	init_waitqueue_head(&ctx->wait);
@@ -1199,12 +1299,18 @@ static struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
 	INIT_LIST_HEAD(&ctx->submit_state.comp.locked_free_list);
 	return ctx;
 err:
+	free_percpu(ctx->stats);
 	kfree(ctx->dummy_ubuf);
 	kfree(ctx->cancel_hash);
 	kfree(ctx);
 	return NULL;
 }
 
+static inline void io_stat_inc(struct io_ring_ctx *ctx, int item)
+{
+	this_cpu_inc(ctx->stats->stat[item]);
+}
+
 static bool req_need_defer(struct io_kiocb *req, u32 seq)
 {
 	if (unlikely(req->flags & REQ_F_IO_DRAIN)) {
@@ -1275,7 +1381,8 @@ static void io_queue_async_work(struct io_kiocb *req)
 	/* init ->work of the whole link before punting */
 	io_prep_async_link(req);
 	trace_io_uring_queue_async_work(ctx, io_wq_is_hashed(&req->work), req,
-					&req->work, req->flags);
+					req->opcode, &req->work, req->flags);
+	io_stat_inc(ctx, IO_STAT_ASYNC);
 	io_wq_enqueue(tctx->io_wq, &req->work);
 	if (link)
 		io_queue_linked_timeout(link);
@@ -1381,8 +1488,18 @@ static inline struct io_uring_cqe *io_get_cqring(struct io_ring_ctx *ctx)
 	if (__io_cqring_events(ctx) == rings->cq_ring_entries)
 		return NULL;
 
-	tail = ctx->cached_cq_tail++;
-	return &rings->cqes[tail & ctx->cq_mask];
+	tail = ctx->cached_cq_tail++ & ctx->cq_mask;
+	/* big CQEs take two slots of the cqes[] array */
+	if (ctx->flags & IORING_SETUP_CQE32)
+		tail <<= 1;
+	return &rings->cqes[tail];
+}
+
+static inline size_t io_cqe_size(struct io_ring_ctx *ctx)
+{
+	if (ctx->flags & IORING_SETUP_CQE32)
+		return 2 * sizeof(struct io_uring_cqe);
+	return sizeof(struct io_uring_cqe);
 }
 
 static inline bool io_should_trigger_evfd(struct io_ring_ctx *ctx)
@@ -1449,7 +1566,7 @@ static bool __io_cqring_overflow_flush(struct io_ring_ctx *ctx, bool force)
 		ocqe = list_first_entry(&ctx->cq_overflow_list,
 					struct io_overflow_cqe, list);
 		if (cqe)
-			memcpy(cqe, &ocqe->cqe, sizeof(*cqe));
+			memcpy(cqe, &ocqe->cqe, io_cqe_size(ctx));
 		else
 			WRITE_ONCE(ctx->rings->cq_overflow,
 				   ++ctx->cached_cq_overflow);
@@ -1525,11 +1642,17 @@ static inline void req_ref_get(struct io_kiocb *req)
 }
 
 static bool io_cqring_event_overflow(struct io_ring_ctx *ctx, u64 user_data,
-				     long res, unsigned int cflags)
+				     long res, unsigned int cflags,
+				     u64 extra1, u64 extra2)
 {
 	struct io_overflow_cqe *ocqe;
+	size_t ocq_size = sizeof(*ocqe);
 
-	ocqe = kmalloc(sizeof(*ocqe), GFP_ATOMIC | __GFP_ACCOUNT);
+	if (ctx->flags & IORING_SETUP_CQE32)
+		ocq_size += sizeof(struct io_uring_cqe);
+
+	ocqe = kmalloc(ocq_size, GFP_ATOMIC | __GFP_ACCOUNT);
+	trace_io_uring_cqe_overflow(ctx, user_data, res, cflags, !ocqe);
 	if (!ocqe) {
 		/*
 		 * If we're in ring overflow flush mode, or in task cancel mode,
@@ -1537,8 +1660,10 @@ static bool io_cqring_event_overflow(struct io_ring_ctx *ctx, u64 user_data,
 		 * on the floor.
 		 */
 		WRITE_ONCE(ctx->rings->cq_overflow, ++ctx->cached_cq_overflow);
+		io_stat_inc(ctx, IO_STAT_CQ_DROPPED);
 		return false;
 	}
+	io_stat_inc(ctx, IO_STAT_CQ_OVERFLOW);
 	if (list_empty(&ctx->cq_overflow_list)) {
 		set_bit(0, &ctx->sq_check_overflow);
 		set_bit(0, &ctx->cq_check_overflow);
@@ -1547,12 +1672,17 @@ static bool io_cqring_event_overflow(struct io_ring_ctx *ctx, u64 user_data,
 	ocqe->cqe.user_data = user_data;
 	ocqe->cqe.res = res;
 	ocqe->cqe.flags = cflags;
+	if (ctx->flags & IORING_SETUP_CQE32) {
+		ocqe->cqe.big_cqe[0] = extra1;
+		ocqe->cqe.big_cqe[1] = extra2;
+	}
 	list_add_tail(&ocqe->list, &ctx->cq_overflow_list);
 	return true;
 }
 
-static inline bool __io_cqring_fill_event(struct io_ring_ctx *ctx, u64 user_data,
-					  long res, unsigned int cflags)
+static inline bool __io_fill_cqe(struct io_ring_ctx *ctx, u64 user_data,
+				 long res, unsigned int cflags,
+				 u64 extra1, u64 extra2)
 {
 	struct io_uring_cqe *cqe;
 
@@ -1568,9 +1698,20 @@ static inline bool __io_cqring_fill_event(struct io_ring_ctx *ctx, u64 user_data
 		WRITE_ONCE(cqe->user_data, user_data);
 		WRITE_ONCE(cqe->res, res);
 		WRITE_ONCE(cqe->flags, cflags);
+		if (ctx->flags & IORING_SETUP_CQE32) {
+			WRITE_ONCE(cqe->big_cqe[0], extra1);
+			WRITE_ONCE(cqe->big_cqe[1], extra2);
+		}
 		return true;
 	}
-	return io_cqring_event_overflow(ctx, user_data, res, cflags);
+	return io_cqring_event_overflow(ctx, user_data, res, cflags,
+					extra1, extra2);
+}
+
+static inline bool __io_cqring_fill_event(struct io_ring_ctx *ctx, u64 user_data,
+					  long res, unsigned int cflags)
+{
+	return __io_fill_cqe(ctx, user_data, res, cflags, 0, 0);
 }
 
 /* not as hot to bloat with inlining */
@@ -1580,6 +1721,26 @@ static noinline bool io_cqring_fill_event(struct io_ring_ctx *ctx, u64 user_data
 	return __io_cqring_fill_event(ctx, user_data, res, cflags);
 }
 
+/*
+ * Post an extra CQE on behalf of a request that stays alive, e.g. multishot
+ * accept/recv. Returns false if the CQE couldn't be posted.
+ */
+static bool io_post_aux_cqe(struct io_kiocb *req, long res, unsigned int cflags)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	bool posted;
+
+	spin_lock_irq(&ctx->completion_lock);
+	posted = io_cqring_fill_event(ctx, req->user_data, res, cflags);
+	if (posted)
+		ctx->cq_extra++;
+	io_commit_cqring(ctx);
+	spin_unlock_irq(&ctx->completion_lock);
+	if (posted)
+		io_cqring_ev_posted(ctx);
+	return posted;
+}
+
 static void io_req_complete_post(struct io_kiocb *req, long res,
 				 unsigned int cflags)
 {
@@ -1587,7 +1748,8 @@ static void io_req_complete_post(struct io_kiocb *req, long res,
 	unsigned long flags;
 
 	spin_lock_irqsave(&ctx->completion_lock, flags);
-	__io_cqring_fill_event(ctx, req->user_data, res, cflags);
+	__io_fill_cqe(ctx, req->user_data, res, cflags, req->extra1,
+		      req->extra2);
 	/*
 	 * If we're the last reference to this request, add to our locked
 	 * free_list cache.
@@ -1943,6 +2105,7 @@ static int io_req_task_work_add(struct io_kiocb *req)
 		return -ESRCH;
 
 	WARN_ON_ONCE(!tctx);
+	io_stat_inc(req->ctx, IO_STAT_TASK_WORK);
 
 	spin_lock_irqsave(&tctx->task_lock, flags);
 	wq_list_add_tail(&req->io_task_work.node, &tctx->task_list);
@@ -1957,9 +2120,16 @@ static int io_req_task_work_add(struct io_kiocb *req)
 	 * SQPOLL kernel thread doesn't need notification, just a wakeup. For
 	 * all other cases, use TWA_SIGNAL unconditionally to ensure we're
 	 * processing task_work. There's no reliable way to tell if TWA_RESUME
-	 * will do the job.
+	 * will do the job, unless the application opted into cooperative
+	 * task running and accepts that work may wait for its next kernel
+	 * entry. A task sleeping in io_cqring_wait() still gets woken below.
 	 */
-	notify = (req->ctx->flags & IORING_SETUP_SQPOLL) ? TWA_NONE : TWA_SIGNAL;
+	if (req->ctx->flags & IORING_SETUP_SQPOLL)
+		notify = TWA_NONE;
+	else if (req->ctx->flags & IORING_SETUP_COOP_TASKRUN)
+		notify = TWA_RESUME;
+	else
+		notify = TWA_SIGNAL;
 
 	if (!task_work_add(tsk, &tctx->task_work, notify)) {
 		wake_up_process(tsk);
@@ -2218,10 +2388,16 @@ static unsigned int io_put_kbuf(struct io_kiocb *req, struct io_buffer *kbuf)
 {
 	unsigned int cflags;
 
-	cflags = kbuf->bid << IORING_CQE_BUFFER_SHIFT;
+	if (req->flags & REQ_F_BUFFER_RING) {
+		/* bid was stashed in ->buf_index at selection time */
+		cflags = req->buf_index << IORING_CQE_BUFFER_SHIFT;
+		req->flags &= ~REQ_F_BUFFER_RING;
+	} else {
+		cflags = kbuf->bid << IORING_CQE_BUFFER_SHIFT;
+		kfree(kbuf);
+	}
 	cflags |= IORING_CQE_F_BUFFER;
 	req->flags &= ~REQ_F_BUFFER_SELECTED;
-	kfree(kbuf);
 	return cflags;
 }
 
@@ -2269,6 +2445,11 @@ static void io_iopoll_complete(struct io_ring_ctx *ctx, unsigned int *nr_events,
 		req = list_first_entry(done, struct io_kiocb, inflight_entry);
 		list_del(&req->inflight_entry);
 
+		/* finish the driver side of a passthrough command */
+		if (req->opcode == IORING_OP_URING_CMD &&
+		    req->uring_cmd.task_work_cb)
+			req->uring_cmd.task_work_cb(&req->uring_cmd);
+
 		if (READ_ONCE(req->result) == -EAGAIN &&
 		    !(req->flags & REQ_F_DONT_REISSUE)) {
 			req->iopoll_completed = 0;
@@ -2280,7 +2461,8 @@ static void io_iopoll_complete(struct io_ring_ctx *ctx, unsigned int *nr_events,
 		if (req->flags & REQ_F_BUFFER_SELECTED)
 			cflags = io_put_rw_kbuf(req);
 
-		__io_cqring_fill_event(ctx, req->user_data, req->result, cflags);
+		__io_fill_cqe(ctx, req->user_data, req->result, cflags,
+			      req->extra1, req->extra2);
 		(*nr_events)++;
 
 		if (req_ref_put_and_test(req))
@@ -2322,7 +2504,11 @@ static int io_do_iopoll(struct io_ring_ctx *ctx, unsigned int *nr_events,
 		if (!list_empty(&done))
 			break;
 
-		ret = kiocb->ki_filp->f_op->iopoll(kiocb, spin);
+		if (req->opcode == IORING_OP_URING_CMD)
+			ret = req->file->f_op->uring_cmd_iopoll(&req->uring_cmd,
+								spin);
+		else
+			ret = kiocb->ki_filp->f_op->iopoll(kiocb, spin);
 		if (ret < 0)
 			break;
 
@@ -2695,7 +2881,7 @@ static int io_prep_rw(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 		    !kiocb->ki_filp->f_op->iopoll)
 			return -EOPNOTSUPP;
 
-		kiocb->ki_flags |= IOCB_HIPRI;
+		kiocb->ki_flags |= IOCB_HIPRI | IOCB_ALLOC_CACHE;
 		kiocb->ki_complete = io_complete_rw_iopoll;
 		req->iopoll_completed = 0;
 	} else {
@@ -2775,11 +2961,11 @@ static void kiocb_done(struct kiocb *kiocb, ssize_t ret,
 	}
 }
 
-static int __io_import_fixed(struct io_kiocb *req, int rw, struct iov_iter *iter,
-			     struct io_mapped_ubuf *imu)
+static int __io_import_fixed(int rw, struct iov_iter *iter,
+			     struct io_mapped_ubuf *imu, u64 buf_addr,
+			     size_t len)
 {
-	size_t len = req->rw.len;
-	u64 buf_end, buf_addr = req->rw.addr;
+	u64 buf_end;
 	size_t offset;
 
 	if (unlikely(check_add_overflow(buf_addr, (u64)len, &buf_end)))
@@ -2833,7 +3019,8 @@ static int __io_import_fixed(struct io_kiocb *req, int rw, struct iov_iter *iter
 	return 0;
 }
 
-static int io_import_fixed(struct io_kiocb *req, int rw, struct iov_iter *iter)
+static int io_import_fixed(struct io_kiocb *req, int rw, struct iov_iter *iter,
+			   u64 buf_addr, size_t len)
 {
 	struct io_ring_ctx *ctx = req->ctx;
 	struct io_mapped_ubuf *imu = req->imu;
@@ -2846,7 +3033,7 @@ static int io_import_fixed(struct io_kiocb *req, int rw, struct iov_iter *iter)
 		imu = READ_ONCE(ctx->user_bufs[index]);
 		req->imu = imu;
 	}
-	return __io_import_fixed(req, rw, iter, imu);
+	return __io_import_fixed(rw, iter, imu, buf_addr, len);
 }
 
 static void io_ring_submit_unlock(struct io_ring_ctx *ctx, bool needs_lock)
@@ -2867,54 +3054,99 @@ static void io_ring_submit_lock(struct io_ring_ctx *ctx, bool needs_lock)
 		mutex_lock(&ctx->uring_lock);
 }
 
-static struct io_buffer *io_buffer_select(struct io_kiocb *req, size_t *len,
-					  int bgid, struct io_buffer *kbuf,
-					  bool needs_lock)
+static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
+					  struct io_buffer_ring *br)
+{
+	struct io_uring_buf_ring *ring = br->buf_ring;
+	struct io_uring_buf *buf;
+	__u16 head = br->head;
+	__u32 buf_len;
+
+	/* pairs with the store-release of the tail in userspace */
+	if (unlikely(smp_load_acquire(&ring->tail) == head))
+		return ERR_PTR(-ENOBUFS);
+
+	buf = &ring->bufs[head & br->mask];
+	buf_len = READ_ONCE(buf->len);
+	if (*len > buf_len)
+		*len = buf_len;
+	req->buf_index = READ_ONCE(buf->bid);
+	req->flags |= REQ_F_BUFFER_SELECTED | REQ_F_BUFFER_RING;
+	br->head = head + 1;
+	return u64_to_user_ptr(READ_ONCE(buf->addr));
+}
+
+/*
+ * Pick a buffer from group @bgid. For classic provided buffers the removed
+ * io_buffer is handed back through @kbuf and must be released with
+ * io_put_kbuf(), ring-mapped groups set REQ_F_BUFFER_RING instead.
+ */
+static void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
+				     int bgid, struct io_buffer **kbuf,
+				     bool needs_lock)
 {
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_buffer_ring *br;
 	struct io_buffer *head;
+	void __user *buf;
 
-	if (req->flags & REQ_F_BUFFER_SELECTED)
-		return kbuf;
+	io_ring_submit_lock(ctx, needs_lock);
 
-	io_ring_submit_lock(req->ctx, needs_lock);
+	lockdep_assert_held(&ctx->uring_lock);
 
-	lockdep_assert_held(&req->ctx->uring_lock);
+	br = xa_load(&ctx->io_buf_rings, bgid);
+	if (br) {
+		buf = io_ring_buffer_select(req, len, br);
+		goto out;
+	}
 
-	head = xa_load(&req->ctx->io_buffers, bgid);
+	head = xa_load(&ctx->io_buffers, bgid);
 	if (head) {
 		if (!list_empty(&head->list)) {
-			kbuf = list_last_entry(&head->list, struct io_buffer,
+			*kbuf = list_last_entry(&head->list, struct io_buffer,
 							list);
-			list_del(&kbuf->list);
+			list_del(&(*kbuf)->list);
 		} else {
-			kbuf = head;
-			xa_erase(&req->ctx->io_buffers, bgid);
+			*kbuf = head;
+			xa_erase(&ctx->io_buffers, bgid);
 		}
-		if (*len > kbuf->len)
-			*len = kbuf->len;
+		if (*len > (*kbuf)->len)
+			*len = (*kbuf)->len;
+		req->flags |= REQ_F_BUFFER_SELECTED;
+		buf = u64_to_user_ptr((*kbuf)->addr);
 	} else {
-		kbuf = ERR_PTR(-ENOBUFS);
+		buf = ERR_PTR(-ENOBUFS);
 	}
+out:
+	io_ring_submit_unlock(ctx, needs_lock);
 
-	io_ring_submit_unlock(req->ctx, needs_lock);
-
-	return kbuf;
+	return buf;
 }
 
 static void __user *io_rw_buffer_select(struct io_kiocb *req, size_t *len,
 					bool needs_lock)
 {
 	struct io_buffer *kbuf;
-	u16 bgid;
+	void __user *buf;
 
-	kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
-	bgid = req->buf_index;
-	kbuf = io_buffer_select(req, len, bgid, kbuf, needs_lock);
-	if (IS_ERR(kbuf))
-		return kbuf;
-	req->rw.addr = (u64) (unsigned long) kbuf;
-	req->flags |= REQ_F_BUFFER_SELECTED;
-	return u64_to_user_ptr(kbuf->addr);
+	if (req->flags & REQ_F_BUFFER_SELECTED) {
+		if (req->flags & REQ_F_BUFFER_RING)
+			return u64_to_user_ptr(req->rw.addr);
+		kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
+		return u64_to_user_ptr(kbuf->addr);
+	}
+
+	buf = io_buffer_select(req, len, req->buf_index, &kbuf, needs_lock);
+	if (IS_ERR(buf))
+		return buf;
+	if (req->flags & REQ_F_BUFFER_RING) {
+		/* nothing to free later, keep what a reissue needs */
+		req->rw.addr = (u64) (unsigned long) buf;
+		req->rw.len = *len;
+	} else {
+		req->rw.addr = (u64) (unsigned long) kbuf;
+	}
+	return buf;
 }
 
 #ifdef CONFIG_COMPAT
@@ -2968,7 +3200,11 @@ static ssize_t __io_iov_buffer_select(struct io_kiocb *req, struct iovec *iov,
 static ssize_t io_iov_buffer_select(struct io_kiocb *req, struct iovec *iov,
 				    bool needs_lock)
 {
-	if (req->flags & REQ_F_BUFFER_SELECTED) {
+	if (req->flags & REQ_F_BUFFER_RING) {
+		iov[0].iov_base = u64_to_user_ptr(req->rw.addr);
+		iov[0].iov_len = req->rw.len;
+		return 0;
+	} else if (req->flags & REQ_F_BUFFER_SELECTED) {
 		struct io_buffer *kbuf;
 
 		kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
@@ -2997,7 +3233,8 @@ static int io_import_iovec(int rw, struct io_kiocb *req, struct iovec **iovec,
 
 	if (opcode == IORING_OP_READ_FIXED || opcode == IORING_OP_WRITE_FIXED) {
 		*iovec = NULL;
-		return io_import_fixed(req, rw, iter);
+		return io_import_fixed(req, rw, iter, req->rw.addr,
+				       req->rw.len);
 	}
 
 	/* buffer index only valid with fixed read/write, or buffer select  */
@@ -3385,6 +3622,7 @@ static int io_write(struct io_kiocb *req, unsigned int issue_flags)
 
 	/* file path doesn't support NOWAIT for non-direct_IO */
 	if (force_nonblock && !(kiocb->ki_flags & IOCB_DIRECT) &&
+	    !(req->file->f_mode & FMODE_BUF_WASYNC) &&
 	    (req->flags & REQ_F_ISREG))
 		goto copy_iov;
 
@@ -3427,6 +3665,25 @@ static int io_write(struct io_kiocb *req, unsigned int issue_flags)
 	/* no retry on NONBLOCK nor RWF_NOWAIT */
 	if (ret2 == -EAGAIN && (req->flags & REQ_F_NOWAIT))
 		goto done;
+	/*
+	 * A nowait buffered write may stop short when it runs into a page
+	 * or an allocation it can't get without blocking. Keep what was
+	 * written and punt the rest, the iterator is already advanced.
+	 */
+	if (force_nonblock && ret2 > 0 && ret2 < io_size &&
+	    !(kiocb->ki_flags & IOCB_DIRECT) &&
+	    (req->flags & REQ_F_ISREG) && !(req->flags & REQ_F_NOWAIT)) {
+		if (io_setup_async_rw(req, iovec, inline_vecs, iter, true)) {
+			/* the iovec is freed on failure */
+			iovec = NULL;
+			goto done;
+		}
+		rw = req->async_data;
+		rw->bytes_done += ret2;
+		kiocb_end_write(req);
+		kiocb->ki_flags &= ~IOCB_WRITE;
+		return -EAGAIN;
+	}
 	if (!force_nonblock || ret2 != -EAGAIN) {
 		/* IOPOLL retry should happen for io-wq threads */
 		if ((req->ctx->flags & IORING_SETUP_IOPOLL) && ret2 == -EAGAIN)
@@ -3438,6 +3695,11 @@ static int io_write(struct io_kiocb *req, unsigned int issue_flags)
 		/* some cases will consume bytes even on error returns */
 		iov_iter_revert(iter, io_size - iov_iter_count(iter));
 		ret = io_setup_async_rw(req, iovec, inline_vecs, iter, false);
+		if (kiocb->ki_flags & IOCB_WRITE) {
+			/* the punted attempt takes its own freeze protection */
+			kiocb_end_write(req);
+			kiocb->ki_flags &= ~IOCB_WRITE;
+		}
 		return ret ?: -EAGAIN;
 	}
 out_free:
@@ -3538,6 +3800,176 @@ static int io_unlinkat(struct io_kiocb *req, unsigned int issue_flags)
 	return 0;
 }
 
+static int io_getdents_prep(struct io_kiocb *req,
+			    const struct io_uring_sqe *sqe)
+{
+	struct io_getdents *gd = &req->getdents;
+
+	if (unlikely(req->ctx->flags & IORING_SETUP_IOPOLL))
+		return -EINVAL;
+	if (sqe->ioprio || sqe->rw_flags || sqe->buf_index)
+		return -EINVAL;
+
+	gd->pos = READ_ONCE(sqe->off);
+	gd->dirent = u64_to_user_ptr(READ_ONCE(sqe->addr));
+	gd->count = READ_ONCE(sqe->len);
+	return 0;
+}
+
+static int io_getdents(struct io_kiocb *req, unsigned int issue_flags)
+{
+	struct io_getdents *gd = &req->getdents;
+	struct file *file = req->file;
+	int ret = 0;
+
+	/* iterate_dir() takes the directory's inode lock */
+	if (issue_flags & IO_URING_F_NONBLOCK)
+		return -EAGAIN;
+
+	/* serializes f_pos and ->iterate_shared() like fdget_pos() does */
+	mutex_lock(&file->f_pos_lock);
+	/* -1 reads from the current position, like IORING_OP_READ */
+	if (gd->pos != -1 && gd->pos != file->f_pos) {
+		loff_t res = vfs_llseek(file, gd->pos, SEEK_SET);
+
+		if (res < 0)
+			ret = res;
+	}
+	if (!ret)
+		ret = vfs_getdents(file, gd->dirent, gd->count);
+	mutex_unlock(&file->f_pos_lock);
+
+	if (ret < 0) {
+		if (ret == -ERESTARTSYS)
+			ret = -EINTR;
+		req_set_fail_links(req);
+	}
+	io_req_complete(req, ret);
+	return 0;
+}
+
+static void io_uring_cmd_work(struct callback_head *cb)
+{
+	struct io_kiocb *req = container_of(cb, struct io_kiocb, task_work);
+
+	req->uring_cmd.task_work_cb(&req->uring_cmd);
+}
+
+/*
+ * Called by the driver, from any context, to finish a queued command from
+ * the task context of the submitter.
+ */
+void io_uring_cmd_complete_in_task(struct io_uring_cmd *ioucmd,
+			void (*task_work_cb)(struct io_uring_cmd *))
+{
+	struct io_kiocb *req = container_of(ioucmd, struct io_kiocb, uring_cmd);
+
+	ioucmd->task_work_cb = task_work_cb;
+	/* polled rings run ->task_work_cb when reaping, io_iopoll_complete() */
+	if (req->ctx->flags & IORING_SETUP_IOPOLL) {
+		smp_wmb();
+		WRITE_ONCE(req->iopoll_completed, 1);
+		return;
+	}
+
+	req->task_work.func = io_uring_cmd_work;
+	if (unlikely(io_req_task_work_add(req)))
+		io_req_task_work_add_fallback(req, io_uring_cmd_work);
+}
+EXPORT_SYMBOL_GPL(io_uring_cmd_complete_in_task);
+
+/*
+ * Called by the driver to post the completion, @res2 goes into the big CQE
+ * with IORING_SETUP_CQE32 and is dropped otherwise.
+ */
+void io_uring_cmd_done(struct io_uring_cmd *ioucmd, ssize_t ret, ssize_t res2)
+{
+	struct io_kiocb *req = container_of(ioucmd, struct io_kiocb, uring_cmd);
+
+	if (ret < 0)
+		req_set_fail_links(req);
+	req->extra1 = res2;
+	if (req->ctx->flags & IORING_SETUP_IOPOLL) {
+		WRITE_ONCE(req->result, ret);
+		/* order with io_iopoll_complete() checking ->result */
+		smp_wmb();
+		WRITE_ONCE(req->iopoll_completed, 1);
+		return;
+	}
+	io_req_complete(req, ret);
+}
+EXPORT_SYMBOL_GPL(io_uring_cmd_done);
+
+static size_t io_uring_cmd_size(struct io_ring_ctx *ctx)
+{
+	size_t size = sizeof(struct io_uring_sqe) -
+			offsetof(struct io_uring_sqe, cmd);
+
+	if (ctx->flags & IORING_SETUP_SQE128)
+		size += sizeof(struct io_uring_sqe);
+	return size;
+}
+
+static int io_uring_cmd_prep_async(struct io_kiocb *req)
+{
+	struct io_uring_cmd *ioucmd = &req->uring_cmd;
+
+	/* the SQE may be reused once we return, keep a copy of the command */
+	memcpy(req->async_data, ioucmd->cmd, io_uring_cmd_size(req->ctx));
+	ioucmd->cmd = req->async_data;
+	return 0;
+}
+
+static int io_uring_cmd_prep(struct io_kiocb *req,
+			     const struct io_uring_sqe *sqe)
+{
+	struct io_uring_cmd *ioucmd = &req->uring_cmd;
+
+	if (sqe->rw_flags || sqe->__pad1)
+		return -EINVAL;
+	if (!req->file->f_op->uring_cmd)
+		return -EOPNOTSUPP;
+	if (req->ctx->flags & IORING_SETUP_IOPOLL) {
+		if (!req->file->f_op->uring_cmd_iopoll)
+			return -EOPNOTSUPP;
+		/* a reissue would need a fresh driver pdu */
+		req->flags |= REQ_F_DONT_REISSUE;
+	}
+
+	ioucmd->cmd = sqe->cmd;
+	ioucmd->cmd_op = READ_ONCE(sqe->cmd_op);
+	ioucmd->task_work_cb = NULL;
+	return 0;
+}
+
+static int io_uring_cmd(struct io_kiocb *req, unsigned int issue_flags)
+{
+	struct io_uring_cmd *ioucmd = &req->uring_cmd;
+	struct io_ring_ctx *ctx = req->ctx;
+	int ret;
+
+	if (ctx->flags & IORING_SETUP_SQE128)
+		issue_flags |= IO_URING_F_SQE128;
+	if (ctx->flags & IORING_SETUP_CQE32)
+		issue_flags |= IO_URING_F_CQE32;
+	if (ctx->flags & IORING_SETUP_IOPOLL)
+		issue_flags |= IO_URING_F_IOPOLL;
+
+	ret = req->file->f_op->uring_cmd(ioucmd, issue_flags);
+	if (ret == -EAGAIN) {
+		if (!req->async_data) {
+			if (io_alloc_async_data(req))
+				return -ENOMEM;
+			io_uring_cmd_prep_async(req);
+		}
+		return -EAGAIN;
+	}
+
+	if (ret != -EIOCBQUEUED)
+		io_uring_cmd_done(ioucmd, ret, 0);
+	return 0;
+}
+
 static int io_shutdown_prep(struct io_kiocb *req,
 			    const struct io_uring_sqe *sqe)
 {
@@ -3775,6 +4207,12 @@ static int __io_openat_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe
 		return ret;
 	}
 	req->open.nofile = rlimit(RLIMIT_NOFILE);
+	req->open.file_slot = READ_ONCE(sqe->file_index);
+	if (req->open.file_slot && (req->open.how.flags & O_CLOEXEC)) {
+		putname(req->open.filename);
+		req->open.filename = NULL;
+		return -EINVAL;
+	}
 	req->flags |= REQ_F_NEED_CLEANUP;
 	return 0;
 }
@@ -3818,6 +4256,7 @@ static int io_openat2(struct io_kiocb *req, unsigned int issue_flags)
 	struct file *file;
 	bool nonblock_set;
 	bool resolve_nonblock;
+	bool fixed = !!req->open.file_slot;
 	int ret;
 
 	ret = build_open_flags(&req->open.how, &op);
@@ -3836,9 +4275,11 @@ static int io_openat2(struct io_kiocb *req, unsigned int issue_flags)
 		op.open_flag |= O_NONBLOCK;
 	}
 
-	ret = __get_unused_fd_flags(req->open.how.flags, req->open.nofile);
-	if (ret < 0)
-		goto err;
+	if (!fixed) {
+		ret = __get_unused_fd_flags(req->open.how.flags, req->open.nofile);
+		if (ret < 0)
+			goto err;
+	}
 
 	file = do_filp_open(req->open.dfd, req->open.filename, &op);
 	/* only retry if RESOLVE_CACHED wasn't already set by application */
@@ -3849,19 +4290,27 @@ static int io_openat2(struct io_kiocb *req, unsigned int issue_flags)
 		 * gain for something that is now known to be a slower path.
 		 * So just put it, and we'll get a new one when we retry.
 		 */
-		put_unused_fd(ret);
+		if (!fixed)
+			put_unused_fd(ret);
 		return -EAGAIN;
 	}
 
 	if (IS_ERR(file)) {
-		put_unused_fd(ret);
+		if (!fixed)
+			put_unused_fd(ret);
 		ret = PTR_ERR(file);
-	} else {
-		if ((issue_flags & IO_URING_F_NONBLOCK) && !nonblock_set)
-			file->f_flags &= ~O_NONBLOCK;
-		fsnotify_open(file);
-		fd_install(ret, file);
+		goto err;
 	}
+
+	if ((issue_flags & IO_URING_F_NONBLOCK) && !nonblock_set)
+		file->f_flags &= ~O_NONBLOCK;
+	fsnotify_open(file);
+
+	if (!fixed)
+		fd_install(ret, file);
+	else
+		ret = io_install_fixed_file(req, file, issue_flags,
+					    req->open.file_slot - 1);
 err:
 	putname(req->open.filename);
 	req->flags &= ~REQ_F_NEED_CLEANUP;
@@ -4022,7 +4471,11 @@ static int io_provide_buffers(struct io_kiocb *req, unsigned int issue_flags)
 
 	list = head = xa_load(&ctx->io_buffers, p->bgid);
 
-	ret = io_add_buffers(p, &head);
+	/* a group is either ring-mapped or a list, never both */
+	if (unlikely(xa_load(&ctx->io_buf_rings, p->bgid)))
+		ret = -EEXIST;
+	else
+		ret = io_add_buffers(p, &head);
 	if (ret >= 0 && !list) {
 		ret = xa_insert(&ctx->io_buffers, p->bgid, head, GFP_KERNEL);
 		if (ret < 0)
@@ -4407,6 +4860,7 @@ static int io_send(struct io_kiocb *req, unsigned int issue_flags)
 	msg.msg_control = NULL;
 	msg.msg_controllen = 0;
 	msg.msg_namelen = 0;
+	msg.msg_ubuf = NULL;
 
 	flags = req->sr_msg.msg_flags;
 	if (issue_flags & IO_URING_F_NONBLOCK)
@@ -4427,6 +4881,154 @@ static int io_send(struct io_kiocb *req, unsigned int issue_flags)
 	return 0;
 }
 
+static void io_uring_tx_zerocopy_callback(struct sk_buff *skb,
+					  struct ubuf_info *uarg,
+					  bool success)
+{
+	struct io_notif *notif = container_of(uarg, struct io_notif, uarg);
+	struct io_ring_ctx *ctx = notif->ctx;
+	unsigned long flags;
+
+	if (!refcount_dec_and_test(&uarg->refcnt))
+		return;
+
+	/* may be called from any context, including softirq */
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	ctx->cq_extra++;
+	io_cqring_fill_event(ctx, notif->user_data, 0, IORING_CQE_F_NOTIF);
+	io_commit_cqring(ctx);
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+	io_cqring_ev_posted(ctx);
+
+	mm_unaccount_pinned_pages(&uarg->mmp);
+	percpu_ref_put(&ctx->refs);
+	kfree(notif);
+}
+
+static struct io_notif *io_alloc_notif(struct io_kiocb *req)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_notif *notif;
+
+	notif = kzalloc(sizeof(*notif), GFP_KERNEL);
+	if (!notif)
+		return NULL;
+
+	notif->uarg.callback = io_uring_tx_zerocopy_callback;
+	notif->uarg.flags = SKBFL_ZEROCOPY_FRAG;
+	refcount_set(&notif->uarg.refcnt, 1);
+	notif->ctx = ctx;
+	notif->user_data = req->user_data;
+	percpu_ref_get(&ctx->refs);
+	return notif;
+}
+
+/* drop a notification that was never handed to the network stack */
+static void io_free_notif(struct io_notif *notif)
+{
+	mm_unaccount_pinned_pages(&notif->uarg.mmp);
+	percpu_ref_put(&notif->ctx->refs);
+	kfree(notif);
+}
+
+static int io_send_zc_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
+{
+	struct io_sr_msg *sr = &req->sr_msg;
+	int ret;
+
+	if (unlikely(req->ctx->flags & IORING_SETUP_IOPOLL))
+		return -EINVAL;
+	if (sqe->off || sqe->splice_fd_in)
+		return -EINVAL;
+
+	sr->flags = READ_ONCE(sqe->ioprio);
+	if (sr->flags & ~IORING_RECVSEND_FIXED_BUF)
+		return -EINVAL;
+	if (sr->flags & IORING_RECVSEND_FIXED_BUF) {
+		req->imu = NULL;
+		req->buf_index = READ_ONCE(sqe->buf_index);
+		io_req_set_rsrc_node(req);
+	} else if (sqe->buf_index) {
+		return -EINVAL;
+	}
+
+	sr->buf = u64_to_user_ptr(READ_ONCE(sqe->addr));
+	sr->len = READ_ONCE(sqe->len);
+	sr->msg_flags = READ_ONCE(sqe->msg_flags) | MSG_NOSIGNAL;
+	if (sr->msg_flags & MSG_DONTWAIT)
+		req->flags |= REQ_F_NOWAIT;
+
+	sr->notif = io_alloc_notif(req);
+	if (!sr->notif)
+		return -ENOMEM;
+	req->flags |= REQ_F_NEED_CLEANUP;
+
+	/* registered buffers are already accounted at registration time */
+	if (!(sr->flags & IORING_RECVSEND_FIXED_BUF)) {
+		ret = mm_account_pinned_pages(&sr->notif->uarg.mmp, sr->len);
+		if (unlikely(ret))
+			return ret;
+	}
+	return 0;
+}
+
+static int io_send_zc(struct io_kiocb *req, unsigned int issue_flags)
+{
+	struct io_sr_msg *sr = &req->sr_msg;
+	struct io_notif *notif = sr->notif;
+	struct msghdr msg;
+	struct iovec iov;
+	struct socket *sock;
+	unsigned flags;
+	int min_ret = 0;
+	int ret;
+
+	sock = sock_from_file(req->file);
+	if (unlikely(!sock))
+		return -ENOTSOCK;
+
+	if (sr->flags & IORING_RECVSEND_FIXED_BUF)
+		ret = io_import_fixed(req, WRITE, &msg.msg_iter,
+				      (u64)(uintptr_t)sr->buf, sr->len);
+	else
+		ret = import_single_range(WRITE, sr->buf, sr->len, &iov,
+					  &msg.msg_iter);
+	if (unlikely(ret))
+		return ret;
+
+	msg.msg_name = NULL;
+	msg.msg_control = NULL;
+	msg.msg_controllen = 0;
+	msg.msg_namelen = 0;
+	msg.msg_ubuf = &notif->uarg;
+
+	flags = sr->msg_flags | MSG_ZEROCOPY;
+	if (issue_flags & IO_URING_F_NONBLOCK)
+		flags |= MSG_DONTWAIT;
+	if (flags & MSG_WAITALL)
+		min_ret = iov_iter_count(&msg.msg_iter);
+
+	msg.msg_flags = flags;
+	ret = sock_sendmsg(sock, &msg);
+	if ((issue_flags & IO_URING_F_NONBLOCK) && ret == -EAGAIN)
+		return -EAGAIN;
+	if (ret == -ERESTARTSYS)
+		ret = -EINTR;
+
+	if (ret < min_ret)
+		req_set_fail_links(req);
+	sr->notif = NULL;
+	req->flags &= ~REQ_F_NEED_CLEANUP;
+
+	/*
+	 * Post the request CQE before dropping our notification reference, so
+	 * the IORING_CQE_F_NOTIF CQE can never be observed ahead of it.
+	 */
+	__io_req_complete(req, 0, ret, IORING_CQE_F_MORE);
+	net_zcopy_put(&notif->uarg);
+	return 0;
+}
+
 static int __io_recvmsg_copy_hdr(struct io_kiocb *req,
 				 struct io_async_msghdr *iomsg)
 {
@@ -4514,19 +5116,28 @@ static int io_recvmsg_copy_hdr(struct io_kiocb *req,
 	return __io_recvmsg_copy_hdr(req, iomsg);
 }
 
-static struct io_buffer *io_recv_buffer_select(struct io_kiocb *req,
-					       bool needs_lock)
+static void __user *io_recv_buffer_select(struct io_kiocb *req,
+					  bool needs_lock)
 {
 	struct io_sr_msg *sr = &req->sr_msg;
 	struct io_buffer *kbuf;
+	void __user *buf;
+
+	if (req->flags & REQ_F_BUFFER_SELECTED) {
+		if (req->flags & REQ_F_BUFFER_RING)
+			return sr->rbuf;
+		return u64_to_user_ptr(sr->kbuf->addr);
+	}
 
-	kbuf = io_buffer_select(req, &sr->len, sr->bgid, sr->kbuf, needs_lock);
-	if (IS_ERR(kbuf))
-		return kbuf;
+	buf = io_buffer_select(req, &sr->len, sr->bgid, &kbuf, needs_lock);
+	if (IS_ERR(buf))
+		return buf;
 
-	sr->kbuf = kbuf;
-	req->flags |= REQ_F_BUFFER_SELECTED;
-	return kbuf;
+	if (req->flags & REQ_F_BUFFER_RING)
+		sr->rbuf = buf;
+	else
+		sr->kbuf = kbuf;
+	return buf;
 }
 
 static inline unsigned int io_put_recv_kbuf(struct io_kiocb *req)
@@ -4558,6 +5169,21 @@ static int io_recvmsg_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 	if (sr->msg_flags & MSG_DONTWAIT)
 		req->flags |= REQ_F_NOWAIT;
 
+	sr->flags = READ_ONCE(sqe->ioprio);
+	if (sr->flags & ~IORING_RECV_MULTISHOT)
+		return -EINVAL;
+	if (sr->flags & IORING_RECV_MULTISHOT) {
+		if (req->opcode != IORING_OP_RECV)
+			return -EINVAL;
+		/* every completion consumes a buffer, size comes from it */
+		if (!(req->flags & REQ_F_BUFFER_SELECT) || sr->len)
+			return -EINVAL;
+		if (sr->msg_flags & MSG_WAITALL)
+			return -EINVAL;
+		sr->len = MAX_RW_COUNT;
+		req->flags |= REQ_F_APOLL_MULTISHOT;
+	}
+
 #ifdef CONFIG_COMPAT
 	if (req->ctx->compat)
 		sr->msg_flags |= MSG_CMSG_COMPAT;
@@ -4569,7 +5195,7 @@ static int io_recvmsg(struct io_kiocb *req, unsigned int issue_flags)
 {
 	struct io_async_msghdr iomsg, *kmsg;
 	struct socket *sock;
-	struct io_buffer *kbuf;
+	void __user *buf;
 	unsigned flags;
 	int min_ret = 0;
 	int ret, cflags = 0;
@@ -4588,10 +5214,10 @@ static int io_recvmsg(struct io_kiocb *req, unsigned int issue_flags)
 	}
 
 	if (req->flags & REQ_F_BUFFER_SELECT) {
-		kbuf = io_recv_buffer_select(req, !force_nonblock);
-		if (IS_ERR(kbuf))
-			return PTR_ERR(kbuf);
-		kmsg->fast_iov[0].iov_base = u64_to_user_ptr(kbuf->addr);
+		buf = io_recv_buffer_select(req, !force_nonblock);
+		if (IS_ERR(buf))
+			return PTR_ERR(buf);
+		kmsg->fast_iov[0].iov_base = buf;
 		kmsg->fast_iov[0].iov_len = req->sr_msg.len;
 		iov_iter_init(&kmsg->msg.msg_iter, READ, kmsg->fast_iov,
 				1, req->sr_msg.len);
@@ -4624,7 +5250,6 @@ static int io_recvmsg(struct io_kiocb *req, unsigned int issue_flags)
 
 static int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 {
-	struct io_buffer *kbuf;
 	struct io_sr_msg *sr = &req->sr_msg;
 	struct msghdr msg;
 	void __user *buf = sr->buf;
@@ -4639,11 +5264,14 @@ static int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 	if (unlikely(!sock))
 		return -ENOTSOCK;
 
+	/* multishot needs poll driven retries, a blocking worker does one */
+	if (!force_nonblock)
+		req->flags &= ~REQ_F_APOLL_MULTISHOT;
+retry:
 	if (req->flags & REQ_F_BUFFER_SELECT) {
-		kbuf = io_recv_buffer_select(req, !force_nonblock);
-		if (IS_ERR(kbuf))
-			return PTR_ERR(kbuf);
-		buf = u64_to_user_ptr(kbuf->addr);
+		buf = io_recv_buffer_select(req, !force_nonblock);
+		if (IS_ERR(buf))
+			return PTR_ERR(buf);
 	}
 
 	ret = import_single_range(READ, buf, sr->len, &iov, &msg.msg_iter);
@@ -4671,6 +5299,12 @@ static int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 out_free:
 	if (req->flags & REQ_F_BUFFER_SELECTED)
 		cflags = io_put_recv_kbuf(req);
+	if ((req->flags & REQ_F_APOLL_MULTISHOT) && ret > 0 &&
+	    io_post_aux_cqe(req, ret, cflags | IORING_CQE_F_MORE)) {
+		sr->len = MAX_RW_COUNT;
+		cflags = 0;
+		goto retry;
+	}
 	if (ret < min_ret || ((flags & MSG_WAITALL) && (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))))
 		req_set_fail_links(req);
 	__io_req_complete(req, issue_flags, ret, cflags);
@@ -4680,11 +5314,18 @@ static int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 static int io_accept_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 {
 	struct io_accept *accept = &req->accept;
+	unsigned int flags;
 
 	if (unlikely(req->ctx->flags & IORING_SETUP_IOPOLL))
 		return -EINVAL;
-	if (sqe->ioprio || sqe->len || sqe->buf_index)
+	if (sqe->len || sqe->buf_index)
+		return -EINVAL;
+
+	flags = READ_ONCE(sqe->ioprio);
+	if (flags & ~IORING_ACCEPT_MULTISHOT)
 		return -EINVAL;
+	if (flags & IORING_ACCEPT_MULTISHOT)
+		req->flags |= REQ_F_APOLL_MULTISHOT;
 
 	accept->addr = u64_to_user_ptr(READ_ONCE(sqe->addr));
 	accept->addr_len = u64_to_user_ptr(READ_ONCE(sqe->addr2));
@@ -4700,14 +5341,22 @@ static int io_accept(struct io_kiocb *req, unsigned int issue_flags)
 	unsigned int file_flags = force_nonblock ? O_NONBLOCK : 0;
 	int ret;
 
-	if (req->file->f_flags & O_NONBLOCK)
+	/* multishot needs poll driven retries, a blocking worker does one */
+	if (!force_nonblock)
+		req->flags &= ~REQ_F_APOLL_MULTISHOT;
+	/* a multishot accept relies on poll to wait for the next connection */
+	if ((req->file->f_flags & O_NONBLOCK) &&
+	    !(req->flags & REQ_F_APOLL_MULTISHOT))
 		req->flags |= REQ_F_NOWAIT;
-
+retry:
 	ret = __sys_accept4_file(req->file, file_flags, accept->addr,
 					accept->addr_len, accept->flags,
 					accept->nofile);
 	if (ret == -EAGAIN && force_nonblock)
 		return -EAGAIN;
+	if (ret >= 0 && (req->flags & REQ_F_APOLL_MULTISHOT) &&
+	    io_post_aux_cqe(req, ret, IORING_CQE_F_MORE))
+		goto retry;
 	if (ret < 0) {
 		if (ret == -ERESTARTSYS)
 			ret = -EINTR;
@@ -4806,6 +5455,11 @@ IO_NETOP_PREP_ASYNC(connect);
 IO_NETOP_PREP(accept);
 IO_NETOP_FN(send);
 IO_NETOP_FN(recv);
+IO_NETOP_PREP(send_zc);
+
+static void io_free_notif(struct io_notif *notif)
+{
+}
 #endif /* CONFIG_NET */
 
 struct io_poll_table {
@@ -5154,7 +5808,9 @@ static bool io_arm_poll_handler(struct io_kiocb *req)
 
 	if (!req->file || !file_can_poll(req->file))
 		return false;
-	if (req->flags & REQ_F_POLLED)
+	/* only multishot requests get to go through poll more than once */
+	if ((req->flags & (REQ_F_POLLED | REQ_F_APOLL_MULTISHOT)) ==
+	    REQ_F_POLLED)
 		return false;
 	if (def->pollin)
 		rw = READ;
@@ -5166,9 +5822,15 @@ static bool io_arm_poll_handler(struct io_kiocb *req)
 	if (!io_file_supports_async(req, rw))
 		return false;
 
-	apoll = kmalloc(sizeof(*apoll), GFP_ATOMIC);
-	if (unlikely(!apoll))
-		return false;
+	if (req->flags & REQ_F_POLLED) {
+		/* re-arming a multishot request, recycle its async_poll */
+		apoll = req->apoll;
+		kfree(apoll->double_poll);
+	} else {
+		apoll = kmalloc(sizeof(*apoll), GFP_ATOMIC);
+		if (unlikely(!apoll))
+			return false;
+	}
 	apoll->double_poll = NULL;
 
 	req->flags |= REQ_F_POLLED;
@@ -5199,6 +5861,7 @@ static bool io_arm_poll_handler(struct io_kiocb *req)
 	spin_unlock_irq(&ctx->completion_lock);
 	trace_io_uring_poll_arm(ctx, req->opcode, req->user_data, mask,
 					apoll->poll.events);
+	io_stat_inc(ctx, IO_STAT_POLL_ARMED);
 	return true;
 }
 
@@ -5900,6 +6563,8 @@ static int io_req_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 	case IORING_OP_RECVMSG:
 	case IORING_OP_RECV:
 		return io_recvmsg_prep(req, sqe);
+	case IORING_OP_SEND_ZC:
+		return io_send_zc_prep(req, sqe);
 	case IORING_OP_CONNECT:
 		return io_connect_prep(req, sqe);
 	case IORING_OP_TIMEOUT:
@@ -5944,6 +6609,10 @@ static int io_req_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 		return io_renameat_prep(req, sqe);
 	case IORING_OP_UNLINKAT:
 		return io_unlinkat_prep(req, sqe);
+	case IORING_OP_GETDENTS:
+		return io_getdents_prep(req, sqe);
+	case IORING_OP_URING_CMD:
+		return io_uring_cmd_prep(req, sqe);
 	}
 
 	printk_once(KERN_WARNING "io_uring: unhandled opcode %d\n",
@@ -5971,6 +6640,8 @@ static int io_req_prep_async(struct io_kiocb *req)
 		return io_recvmsg_prep_async(req);
 	case IORING_OP_CONNECT:
 		return io_connect_prep_async(req);
+	case IORING_OP_URING_CMD:
+		return io_uring_cmd_prep_async(req);
 	}
 	printk_once(KERN_WARNING "io_uring: prep_async() bad opcode %d\n",
 		    req->opcode);
@@ -6033,7 +6704,10 @@ static int io_req_defer(struct io_kiocb *req)
 
 static void io_clean_op(struct io_kiocb *req)
 {
-	if (req->flags & REQ_F_BUFFER_SELECTED) {
+	if (req->flags & REQ_F_BUFFER_RING) {
+		/* ring buffers are owned by the application, nothing to free */
+		req->flags &= ~(REQ_F_BUFFER_SELECTED | REQ_F_BUFFER_RING);
+	} else if (req->flags & REQ_F_BUFFER_SELECTED) {
 		switch (req->opcode) {
 		case IORING_OP_READV:
 		case IORING_OP_READ_FIXED:
@@ -6085,6 +6759,10 @@ static void io_clean_op(struct io_kiocb *req)
 		case IORING_OP_UNLINKAT:
 			putname(req->unlink.filename);
 			break;
+		case IORING_OP_SEND_ZC:
+			if (req->sr_msg.notif)
+				io_free_notif(req->sr_msg.notif);
+			break;
 		}
 		req->flags &= ~REQ_F_NEED_CLEANUP;
 	}
@@ -6142,6 +6820,9 @@ static int io_issue_sqe(struct io_kiocb *req, unsigned int issue_flags)
 	case IORING_OP_SEND:
 		ret = io_send(req, issue_flags);
 		break;
+	case IORING_OP_SEND_ZC:
+		ret = io_send_zc(req, issue_flags);
+		break;
 	case IORING_OP_RECVMSG:
 		ret = io_recvmsg(req, issue_flags);
 		break;
@@ -6211,6 +6892,12 @@ static int io_issue_sqe(struct io_kiocb *req, unsigned int issue_flags)
 	case IORING_OP_UNLINKAT:
 		ret = io_unlinkat(req, issue_flags);
 		break;
+	case IORING_OP_GETDENTS:
+		ret = io_getdents(req, issue_flags);
+		break;
+	case IORING_OP_URING_CMD:
+		ret = io_uring_cmd(req, issue_flags);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -6423,6 +7110,7 @@ static void __io_queue_sqe(struct io_kiocb *req)
 	 * doesn't support non-blocking read/write attempts
 	 */
 	if (likely(!ret)) {
+		io_stat_inc(req->ctx, IO_STAT_INLINE);
 		/* drop submission reference */
 		if (req->flags & REQ_F_COMPLETE_INLINE) {
 			struct io_ring_ctx *ctx = req->ctx;
@@ -6515,6 +7203,7 @@ static int io_init_req(struct io_ring_ctx *ctx, struct io_kiocb *req,
 	atomic_set(&req->refs, 2);
 	req->task = current;
 	req->result = 0;
+	req->extra1 = req->extra2 = 0;
 	req->work.creds = NULL;
 
 	/* enforce forwards compatibility on users */
@@ -6544,7 +7233,7 @@ static int io_init_req(struct io_ring_ctx *ctx, struct io_kiocb *req,
 	 */
 	if (!state->plug_started && state->ios_left > 1 &&
 	    io_op_defs[req->opcode].plug) {
-		blk_start_plug(&state->plug);
+		blk_start_plug_nr_ios(&state->plug, state->ios_left);
 		state->plug_started = true;
 	}
 
@@ -6696,8 +7385,12 @@ static const struct io_uring_sqe *io_get_sqe(struct io_ring_ctx *ctx)
 	 *    though the application is the one updating it.
 	 */
 	head = READ_ONCE(sq_array[ctx->cached_sq_head++ & ctx->sq_mask]);
-	if (likely(head < ctx->sq_entries))
+	if (likely(head < ctx->sq_entries)) {
+		/* big SQEs take two slots of the sq_sqes[] array */
+		if (ctx->flags & IORING_SETUP_SQE128)
+			head <<= 1;
 		return &ctx->sq_sqes[head];
+	}
 
 	/* drop invalid entries */
 	ctx->cached_sq_dropped++;
@@ -6779,8 +7472,13 @@ static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 
 	to_submit = io_sqring_entries(ctx);
 	/* if we're handling multiple rings, cap submit size for fairness */
-	if (cap_entries && to_submit > 8)
-		to_submit = 8;
+	if (cap_entries) {
+		unsigned int cap = IORING_SQPOLL_CAP_ENTRIES_VALUE *
+					READ_ONCE(ctx->sq_weight);
+
+		if (to_submit > cap)
+			to_submit = cap;
+	}
 
 	if (!list_empty(&ctx->iopoll_list) || to_submit) {
 		unsigned nr_events = 0;
@@ -6872,6 +7570,9 @@ static int io_sq_thread(void *data)
 			if (!sqt_spin && (ret > 0 || !list_empty(&ctx->iopoll_list)))
 				sqt_spin = true;
 		}
+		/* don't let the first ring always go first */
+		if (cap_entries)
+			list_rotate_left(&sqd->ctx_list);
 
 		if (sqt_spin || !time_after(jiffies, timeout)) {
 			io_run_task_work();
@@ -7850,6 +8551,68 @@ static int __io_sqe_files_update(struct io_ring_ctx *ctx,
 	return done ? done : err;
 }
 
+/*
+ * Install a file opened by the ring directly into its fixed file table,
+ * replacing whatever file was registered at @slot_index.  The file never
+ * goes through the task's fdtable.  Consumes the file reference, even on
+ * failure.
+ */
+static int io_install_fixed_file(struct io_kiocb *req, struct file *file,
+				 unsigned int issue_flags, u32 slot_index)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	bool needs_lock = !(issue_flags & IO_URING_F_NONBLOCK);
+	bool needs_switch = false;
+	struct io_fixed_file *file_slot;
+	int ret = -EBADF;
+
+	io_ring_submit_lock(ctx, needs_lock);
+	if (file->f_op == &io_uring_fops)
+		goto err;
+	ret = -ENXIO;
+	if (!ctx->file_data)
+		goto err;
+	ret = -EINVAL;
+	if (slot_index >= ctx->nr_user_files)
+		goto err;
+
+	slot_index = array_index_nospec(slot_index, ctx->nr_user_files);
+	file_slot = io_fixed_file_slot(&ctx->file_table, slot_index);
+
+	if (file_slot->file_ptr) {
+		struct file *old_file;
+
+		ret = io_rsrc_node_switch_start(ctx);
+		if (ret)
+			goto err;
+
+		old_file = (struct file *)(file_slot->file_ptr & FFS_MASK);
+		ret = io_queue_rsrc_removal(ctx->file_data, slot_index,
+					    ctx->rsrc_node, old_file);
+		if (ret)
+			goto err;
+		file_slot->file_ptr = 0;
+		needs_switch = true;
+	}
+
+	ctx->file_data->tags[slot_index] = 0;
+	io_fixed_file_set(file_slot, file);
+	ret = io_sqe_file_register(ctx, file, slot_index);
+	if (ret) {
+		file_slot->file_ptr = 0;
+		goto err;
+	}
+
+	ret = 0;
+err:
+	if (needs_switch)
+		io_rsrc_node_switch(ctx, ctx->file_data);
+	io_ring_submit_unlock(ctx, needs_lock);
+	if (ret)
+		fput(file);
+	return ret;
+}
+
 static struct io_wq_work *io_free_work(struct io_wq_work *work)
 {
 	struct io_kiocb *req = container_of(work, struct io_kiocb, work);
@@ -7920,6 +8683,7 @@ static int io_uring_alloc_task_context(struct task_struct *task,
 	INIT_WQ_LIST(&tctx->task_list);
 	tctx->task_state = 0;
 	init_task_work(&tctx->task_work, tctx_task_work);
+	memset(tctx->registered_rings, 0, sizeof(tctx->registered_rings));
 	return 0;
 }
 
@@ -7968,6 +8732,7 @@ static int io_sq_offload_create(struct io_ring_ctx *ctx,
 		ctx->sq_thread_idle = msecs_to_jiffies(p->sq_thread_idle);
 		if (!ctx->sq_thread_idle)
 			ctx->sq_thread_idle = HZ;
+		ctx->sq_weight = 1;
 
 		io_sq_thread_park(sqd);
 		list_add(&ctx->sqd_list, &sqd->ctx_list);
@@ -8089,12 +8854,17 @@ static void *io_mem_alloc(size_t size)
 	return (void *) __get_free_pages(gfp_flags, get_order(size));
 }
 
-static unsigned long rings_size(unsigned sq_entries, unsigned cq_entries,
-				size_t *sq_offset)
+static unsigned long rings_size(unsigned int flags, unsigned sq_entries,
+				unsigned cq_entries, size_t *sq_offset)
 {
 	struct io_rings *rings;
 	size_t off, sq_array_size;
 
+	if (flags & IORING_SETUP_CQE32) {
+		if (check_shl_overflow(cq_entries, 1, &cq_entries))
+			return SIZE_MAX;
+	}
+
 	off = struct_size(rings, cqes, cq_entries);
 	if (off == SIZE_MAX)
 		return SIZE_MAX;
@@ -8538,13 +9308,118 @@ static int io_eventfd_unregister(struct io_ring_ctx *ctx)
 	return -ENXIO;
 }
 
+static void io_free_buf_ring(struct io_buffer_ring *br)
+{
+	vunmap(br->buf_ring);
+	unpin_user_pages(br->pages, br->nr_pages);
+	kvfree(br->pages);
+	kfree(br);
+}
+
 static void io_destroy_buffers(struct io_ring_ctx *ctx)
 {
+	struct io_buffer_ring *br;
 	struct io_buffer *buf;
 	unsigned long index;
 
 	xa_for_each(&ctx->io_buffers, index, buf)
 		__io_remove_buffers(ctx, buf, index, -1U);
+	xa_for_each(&ctx->io_buf_rings, index, br) {
+		xa_erase(&ctx->io_buf_rings, index);
+		io_free_buf_ring(br);
+	}
+}
+
+static int io_pin_buf_ring(struct io_buffer_ring *br, unsigned long addr,
+			   unsigned int entries)
+{
+	size_t size = entries * sizeof(struct io_uring_buf);
+	int nr_pages, pret, ret;
+	void *ptr;
+
+	nr_pages = DIV_ROUND_UP(size, PAGE_SIZE);
+	br->pages = kvmalloc_array(nr_pages, sizeof(struct page *), GFP_KERNEL);
+	if (!br->pages)
+		return -ENOMEM;
+
+	mmap_read_lock(current->mm);
+	pret = pin_user_pages(addr, nr_pages, FOLL_WRITE | FOLL_LONGTERM,
+			      br->pages, NULL);
+	mmap_read_unlock(current->mm);
+	if (pret != nr_pages) {
+		ret = pret < 0 ? pret : -EFAULT;
+		goto err_unpin;
+	}
+
+	ret = -ENOMEM;
+	ptr = vmap(br->pages, nr_pages, VM_MAP, PAGE_KERNEL);
+	if (!ptr)
+		goto err_unpin;
+
+	br->buf_ring = ptr;
+	br->nr_pages = nr_pages;
+	br->mask = entries - 1;
+	return 0;
+err_unpin:
+	if (pret > 0)
+		unpin_user_pages(br->pages, pret);
+	kvfree(br->pages);
+	return ret;
+}
+
+static int io_register_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
+{
+	struct io_uring_buf_reg reg;
+	struct io_buffer_ring *br;
+	int ret;
+
+	if (copy_from_user(&reg, arg, sizeof(reg)))
+		return -EFAULT;
+	if (reg.pad || reg.resv[0] || reg.resv[1] || reg.resv[2])
+		return -EINVAL;
+	if (!reg.ring_addr || (reg.ring_addr & ~PAGE_MASK))
+		return -EINVAL;
+	/* head and tail are u16, the ring can't be bigger than that */
+	if (!is_power_of_2(reg.ring_entries) || reg.ring_entries > 32768)
+		return -EINVAL;
+	if (xa_load(&ctx->io_buffers, reg.bgid))
+		return -EEXIST;
+
+	br = kzalloc(sizeof(*br), GFP_KERNEL);
+	if (!br)
+		return -ENOMEM;
+
+	ret = io_pin_buf_ring(br, reg.ring_addr, reg.ring_entries);
+	if (ret) {
+		kfree(br);
+		return ret;
+	}
+
+	ret = xa_insert(&ctx->io_buf_rings, reg.bgid, br, GFP_KERNEL);
+	if (ret) {
+		io_free_buf_ring(br);
+		return ret == -EBUSY ? -EEXIST : ret;
+	}
+	return 0;
+}
+
+static int io_unregister_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
+{
+	struct io_uring_buf_reg reg;
+	struct io_buffer_ring *br;
+
+	if (copy_from_user(&reg, arg, sizeof(reg)))
+		return -EFAULT;
+	if (reg.pad || reg.resv[0] || reg.resv[1] || reg.resv[2])
+		return -EINVAL;
+
+	br = xa_erase(&ctx->io_buf_rings, reg.bgid);
+	if (!br)
+		return -ENOENT;
+
+	/* requests keep only the address and bid, safe to drop right away */
+	io_free_buf_ring(br);
+	return 0;
 }
 
 static void io_req_cache_free(struct list_head *list, struct task_struct *tsk)
@@ -8635,6 +9510,7 @@ static void io_ring_ctx_free(struct io_ring_ctx *ctx)
 		io_wq_put_hash(ctx->hash_map);
 	kfree(ctx->cancel_hash);
 	kfree(ctx->dummy_ubuf);
+	free_percpu(ctx->stats);
 	kfree(ctx);
 }
 
@@ -9116,6 +9992,22 @@ static void io_uring_cancel_sqpoll(struct io_sq_data *sqd)
 	atomic_dec(&tctx->in_idle);
 }
 
+/*
+ * Drop the task's registered ring files, they must not pin the rings past
+ * exit/exec of the task that registered them.
+ */
+static void io_uring_unreg_ringfd(struct io_uring_task *tctx)
+{
+	int i;
+
+	for (i = 0; i < IO_RINGFD_REG_MAX; i++) {
+		if (tctx->registered_rings[i]) {
+			fput(tctx->registered_rings[i]);
+			tctx->registered_rings[i] = NULL;
+		}
+	}
+}
+
 /*
  * Find any io_uring fd that this task has registered or done IO on, and cancel
  * requests.
@@ -9126,6 +10018,7 @@ void __io_uring_cancel(struct files_struct *files)
 	DEFINE_WAIT(wait);
 	s64 inflight;
 
+	io_uring_unreg_ringfd(tctx);
 	if (tctx->io_wq)
 		io_wq_exit_start(tctx->io_wq);
 
@@ -9287,10 +10180,26 @@ SYSCALL_DEFINE6(io_uring_enter, unsigned int, fd, u32, to_submit,
 	io_run_task_work();
 
 	if (unlikely(flags & ~(IORING_ENTER_GETEVENTS | IORING_ENTER_SQ_WAKEUP |
-			       IORING_ENTER_SQ_WAIT | IORING_ENTER_EXT_ARG)))
+			       IORING_ENTER_SQ_WAIT | IORING_ENTER_EXT_ARG |
+			       IORING_ENTER_REGISTERED_RING)))
 		return -EINVAL;
 
-	f = fdget(fd);
+	/*
+	 * Ring fd has been registered via IORING_REGISTER_RING_FDS, we don't
+	 * need to grab a file reference, the task's table holds one. f.flags
+	 * stays zero, so the fdput() below is a nop for this case.
+	 */
+	if (flags & IORING_ENTER_REGISTERED_RING) {
+		struct io_uring_task *tctx = current->io_uring;
+
+		if (unlikely(!tctx || fd >= IO_RINGFD_REG_MAX))
+			return -EINVAL;
+		fd = array_index_nospec(fd, IO_RINGFD_REG_MAX);
+		f.file = tctx->registered_rings[fd];
+		f.flags = 0;
+	} else {
+		f = fdget(fd);
+	}
 	if (unlikely(!f.file))
 		return -EBADF;
 
@@ -9403,6 +10312,15 @@ static int io_uring_show_cred(struct seq_file *m, unsigned int id,
 	return 0;
 }
 
+static const char * const io_stat_names[IO_STAT_NR] = {
+	[IO_STAT_INLINE]	= "Inline",
+	[IO_STAT_POLL_ARMED]	= "PollArmed",
+	[IO_STAT_ASYNC]		= "Async",
+	[IO_STAT_TASK_WORK]	= "TaskWork",
+	[IO_STAT_CQ_OVERFLOW]	= "CqOverflow",
+	[IO_STAT_CQ_DROPPED]	= "CqDropped",
+};
+
 static void __io_uring_show_fdinfo(struct io_ring_ctx *ctx, struct seq_file *m)
 {
 	struct io_sq_data *sq = NULL;
@@ -9449,6 +10367,15 @@ static void __io_uring_show_fdinfo(struct io_ring_ctx *ctx, struct seq_file *m)
 		xa_for_each(&ctx->personalities, index, cred)
 			io_uring_show_cred(m, index, cred);
 	}
+	seq_printf(m, "Stats:\n");
+	for (i = 0; i < IO_STAT_NR; i++) {
+		unsigned long sum = 0;
+		int cpu;
+
+		for_each_possible_cpu(cpu)
+			sum += per_cpu_ptr(ctx->stats, cpu)->stat[i];
+		seq_printf(m, "  %s:\t%lu\n", io_stat_names[i], sum);
+	}
 	seq_printf(m, "PollList:\n");
 	spin_lock_irq(&ctx->completion_lock);
 	for (i = 0; i < (1U << ctx->cancel_hash_bits); i++) {
@@ -9499,7 +10426,8 @@ static int io_allocate_scq_urings(struct io_ring_ctx *ctx,
 	ctx->sq_entries = p->sq_entries;
 	ctx->cq_entries = p->cq_entries;
 
-	size = rings_size(p->sq_entries, p->cq_entries, &sq_array_offset);
+	size = rings_size(ctx->flags, p->sq_entries, p->cq_entries,
+			  &sq_array_offset);
 	if (size == SIZE_MAX)
 		return -EOVERFLOW;
 
@@ -9516,7 +10444,11 @@ static int io_allocate_scq_urings(struct io_ring_ctx *ctx,
 	ctx->sq_mask = rings->sq_ring_mask;
 	ctx->cq_mask = rings->cq_ring_mask;
 
-	size = array_size(sizeof(struct io_uring_sqe), p->sq_entries);
+	if (p->flags & IORING_SETUP_SQE128)
+		size = array_size(2 * sizeof(struct io_uring_sqe),
+				  p->sq_entries);
+	else
+		size = array_size(sizeof(struct io_uring_sqe), p->sq_entries);
 	if (size == SIZE_MAX) {
 		io_mem_free(ctx->rings);
 		ctx->rings = NULL;
@@ -9728,7 +10660,8 @@ static long io_uring_setup(u32 entries, struct io_uring_params __user *params)
 	if (p.flags & ~(IORING_SETUP_IOPOLL | IORING_SETUP_SQPOLL |
 			IORING_SETUP_SQ_AFF | IORING_SETUP_CQSIZE |
 			IORING_SETUP_CLAMP | IORING_SETUP_ATTACH_WQ |
-			IORING_SETUP_R_DISABLED))
+			IORING_SETUP_R_DISABLED | IORING_SETUP_COOP_TASKRUN |
+			IORING_SETUP_SQE128 | IORING_SETUP_CQE32))
 		return -EINVAL;
 
 	return  io_uring_create(entries, &p, params);
@@ -9956,6 +10889,173 @@ static int io_register_rsrc(struct io_ring_ctx *ctx, void __user *arg,
 	return -EINVAL;
 }
 
+static int io_ring_add_registered_fd(struct io_uring_task *tctx, int fd,
+				     int start, int end)
+{
+	struct file *file;
+	int offset;
+
+	for (offset = start; offset < end; offset++) {
+		offset = array_index_nospec(offset, IO_RINGFD_REG_MAX);
+		if (tctx->registered_rings[offset])
+			continue;
+
+		file = fget(fd);
+		if (!file)
+			return -EBADF;
+		if (file->f_op != &io_uring_fops) {
+			fput(file);
+			return -EOPNOTSUPP;
+		}
+		tctx->registered_rings[offset] = file;
+		return offset;
+	}
+	return -EBUSY;
+}
+
+/*
+ * Register ring fds in the task's private table, so io_uring_enter() can
+ * skip fdget()/fdput(). @arg is an array of io_uring_rsrc_update, with
+ * ->data holding the ring fd and ->offset the slot to use, or -1U to pick
+ * a free one. The chosen slot is copied back to ->offset.
+ */
+static int io_ringfd_register(struct io_ring_ctx *ctx, void __user *__arg,
+			      unsigned nr_args)
+{
+	struct io_uring_rsrc_update __user *arg = __arg;
+	struct io_uring_rsrc_update reg;
+	struct io_uring_task *tctx;
+	int ret, i;
+
+	if (!nr_args || nr_args > IO_RINGFD_REG_MAX)
+		return -EINVAL;
+
+	/* adding the tctx node takes ->uring_lock itself */
+	mutex_unlock(&ctx->uring_lock);
+	ret = io_uring_add_task_file(ctx);
+	mutex_lock(&ctx->uring_lock);
+	if (ret)
+		return ret;
+
+	tctx = current->io_uring;
+	for (i = 0; i < nr_args; i++) {
+		int start, end;
+
+		if (copy_from_user(&reg, &arg[i], sizeof(reg))) {
+			ret = -EFAULT;
+			break;
+		}
+		if (reg.resv) {
+			ret = -EINVAL;
+			break;
+		}
+
+		if (reg.offset == -1U) {
+			start = 0;
+			end = IO_RINGFD_REG_MAX;
+		} else {
+			if (reg.offset >= IO_RINGFD_REG_MAX) {
+				ret = -EINVAL;
+				break;
+			}
+			start = reg.offset;
+			end = start + 1;
+		}
+
+		ret = io_ring_add_registered_fd(tctx, reg.data, start, end);
+		if (ret < 0)
+			break;
+
+		reg.offset = ret;
+		if (copy_to_user(&arg[i], &reg, sizeof(reg))) {
+			fput(tctx->registered_rings[reg.offset]);
+			tctx->registered_rings[reg.offset] = NULL;
+			ret = -EFAULT;
+			break;
+		}
+	}
+
+	return i ? i : ret;
+}
+
+static int io_ringfd_unregister(struct io_ring_ctx *ctx, void __user *__arg,
+				unsigned nr_args)
+{
+	struct io_uring_rsrc_update __user *arg = __arg;
+	struct io_uring_task *tctx = current->io_uring;
+	struct io_uring_rsrc_update reg;
+	int ret = 0, i;
+
+	if (!nr_args || nr_args > IO_RINGFD_REG_MAX)
+		return -EINVAL;
+	if (!tctx)
+		return 0;
+
+	for (i = 0; i < nr_args; i++) {
+		if (copy_from_user(&reg, &arg[i], sizeof(reg))) {
+			ret = -EFAULT;
+			break;
+		}
+		if (reg.resv || reg.data || reg.offset >= IO_RINGFD_REG_MAX) {
+			ret = -EINVAL;
+			break;
+		}
+
+		reg.offset = array_index_nospec(reg.offset, IO_RINGFD_REG_MAX);
+		if (tctx->registered_rings[reg.offset]) {
+			fput(tctx->registered_rings[reg.offset]);
+			tctx->registered_rings[reg.offset] = NULL;
+		}
+	}
+
+	return i ? i : ret;
+}
+
+static int io_register_sqpoll_params(struct io_ring_ctx *ctx,
+				     void __user *arg, unsigned nr_args)
+	__must_hold(&ctx->uring_lock)
+{
+	struct io_uring_sqpoll_params p;
+	struct io_sq_data *sqd;
+
+	if (!(ctx->flags & IORING_SETUP_SQPOLL) || !ctx->sq_data)
+		return -EINVAL;
+	if (nr_args != 1)
+		return -EINVAL;
+	if (copy_from_user(&p, arg, sizeof(p)))
+		return -EFAULT;
+	if (p.resv[0] || p.resv[1] || p.resv[2])
+		return -EINVAL;
+	if (p.sq_weight > IORING_SQPOLL_MAX_WEIGHT)
+		return -EINVAL;
+
+	/*
+	 * The SQPOLL thread takes ->uring_lock with sqd->lock held, drop ours
+	 * to take them in the same order.
+	 */
+	sqd = ctx->sq_data;
+	refcount_inc(&sqd->refs);
+	mutex_unlock(&ctx->uring_lock);
+	mutex_lock(&sqd->lock);
+	mutex_lock(&ctx->uring_lock);
+
+	if (p.sq_weight)
+		WRITE_ONCE(ctx->sq_weight, p.sq_weight);
+	if (p.sq_thread_idle) {
+		ctx->sq_thread_idle = msecs_to_jiffies(p.sq_thread_idle);
+		io_sqd_update_thread_idle(sqd);
+	}
+	p.sq_weight = ctx->sq_weight;
+	p.sq_thread_idle = jiffies_to_msecs(ctx->sq_thread_idle);
+
+	mutex_unlock(&sqd->lock);
+	io_put_sq_data(sqd);
+
+	if (copy_to_user(arg, &p, sizeof(p)))
+		return -EFAULT;
+	return 0;
+}
+
 static bool io_register_op_must_quiesce(int op)
 {
 	switch (op) {
@@ -9971,6 +11071,11 @@ static bool io_register_op_must_quiesce(int op)
 	case IORING_REGISTER_FILES_UPDATE2:
 	case IORING_REGISTER_BUFFERS2:
 	case IORING_REGISTER_BUFFERS_UPDATE:
+	case IORING_REGISTER_PBUF_RING:
+	case IORING_UNREGISTER_PBUF_RING:
+	case IORING_REGISTER_RING_FDS:
+	case IORING_UNREGISTER_RING_FDS:
+	case IORING_REGISTER_SQPOLL_PARAMS:
 		return false;
 	default:
 		return true;
@@ -10110,6 +11215,27 @@ static int __io_uring_register(struct io_ring_ctx *ctx, unsigned opcode,
 		ret = io_register_rsrc_update(ctx, arg, nr_args,
 					      IORING_RSRC_BUFFER);
 		break;
+	case IORING_REGISTER_PBUF_RING:
+		ret = -EINVAL;
+		if (!arg || nr_args != 1)
+			break;
+		ret = io_register_pbuf_ring(ctx, arg);
+		break;
+	case IORING_UNREGISTER_PBUF_RING:
+		ret = -EINVAL;
+		if (!arg || nr_args != 1)
+			break;
+		ret = io_unregister_pbuf_ring(ctx, arg);
+		break;
+	case IORING_REGISTER_RING_FDS:
+		ret = io_ringfd_register(ctx, arg, nr_args);
+		break;
+	case IORING_UNREGISTER_RING_FDS:
+		ret = io_ringfd_unregister(ctx, arg, nr_args);
+		break;
+	case IORING_REGISTER_SQPOLL_PARAMS:
+		ret = io_register_sqpoll_params(ctx, arg, nr_args);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -10190,6 +11316,10 @@ static int __init io_uring_init(void)
 	BUILD_BUG_SQE_ELEM(40, __u16,  buf_index);
 	BUILD_BUG_SQE_ELEM(42, __u16,  personality);
 	BUILD_BUG_SQE_ELEM(44, __s32,  splice_fd_in);
+	BUILD_BUG_SQE_ELEM(44, __u32,  file_index);
+	BUILD_BUG_SQE_ELEM(8,  __u32,  cmd_op);
+	BUILD_BUG_ON(offsetof(struct io_uring_sqe, cmd) != 48);
+	BUILD_BUG_ON(sizeof(struct io_uring_cmd) > 64);
 
 	BUILD_BUG_ON(sizeof(struct io_uring_files_update) !=
 		     sizeof(struct io_uring_rsrc_update));
@@ -516,6 +516,7 @@ EXPORT_SYMBOL_GPL(iomap_migrate_page);
 
 enum {
 	IOMAP_WRITE_F_UNSHARE		= (1 << 0),
+	IOMAP_WRITE_F_NOWAIT		= (1 << 1),
 };
 
 static void
@@ -576,7 +577,12 @@ __iomap_write_begin(struct inode *inode, loff_t pos, unsigned len, int flags,
 				return -EIO;
 			zero_user_segments(page, poff, from, to, poff + plen);
 		} else {
-			int status = iomap_read_page_sync(block_start, page,
+			int status;
+
+			/* a read-modify-write would block on the read */
+			if (flags & IOMAP_WRITE_F_NOWAIT)
+				return -EAGAIN;
+			status = iomap_read_page_sync(block_start, page,
 					poff, plen, srcmap);
 			if (status)
 				return status;
@@ -609,14 +615,18 @@ iomap_write_begin(struct inode *inode, loff_t pos, unsigned len, unsigned flags,
 	}
 
 	page = grab_cache_page_write_begin(inode->i_mapping, pos >> PAGE_SHIFT,
-			AOP_FLAG_NOFS);
+			AOP_FLAG_NOFS | ((flags & IOMAP_WRITE_F_NOWAIT) ?
+					 AOP_FLAG_NOWAIT : 0));
 	if (!page) {
-		status = -ENOMEM;
+		status = (flags & IOMAP_WRITE_F_NOWAIT) ? -EAGAIN : -ENOMEM;
 		goto out_no_page;
 	}
 
 	if (srcmap->type == IOMAP_INLINE)
 		iomap_read_inline_data(inode, page, srcmap);
+	else if ((iomap->flags & IOMAP_F_BUFFER_HEAD) &&
+		 (flags & IOMAP_WRITE_F_NOWAIT) && !PageUptodate(page))
+		status = -EAGAIN;
 	else if (iomap->flags & IOMAP_F_BUFFER_HEAD)
 		status = __block_write_begin_int(page, pos, len, NULL, srcmap);
 	else
@@ -745,11 +755,17 @@ static size_t iomap_write_end(struct inode *inode, loff_t pos, size_t len,
 	return ret;
 }
 
+struct iomap_write_ctx {
+	struct iov_iter		*iter;
+	unsigned int		flags;	/* IOMAP_WRITE_F_* */
+};
+
 static loff_t
 iomap_write_actor(struct inode *inode, loff_t pos, loff_t length, void *data,
 		struct iomap *iomap, struct iomap *srcmap)
 {
-	struct iov_iter *i = data;
+	struct iomap_write_ctx *ctx = data;
+	struct iov_iter *i = ctx->iter;
 	long status = 0;
 	ssize_t written = 0;
 
@@ -781,8 +797,8 @@ iomap_write_actor(struct inode *inode, loff_t pos, loff_t length, void *data,
 			break;
 		}
 
-		status = iomap_write_begin(inode, pos, bytes, 0, &page, iomap,
-				srcmap);
+		status = iomap_write_begin(inode, pos, bytes, ctx->flags, &page,
+				iomap, srcmap);
 		if (unlikely(status))
 			break;
 
@@ -814,7 +830,15 @@ iomap_write_actor(struct inode *inode, loff_t pos, loff_t length, void *data,
 		written += copied;
 		length -= copied;
 
-		balance_dirty_pages_ratelimited(inode->i_mapping);
+		if (ctx->flags & IOMAP_WRITE_F_NOWAIT) {
+			/* leave throttling to the blocking retry */
+			status = balance_dirty_pages_ratelimited_flags(
+					inode->i_mapping, BDP_ASYNC);
+			if (unlikely(status))
+				break;
+		} else {
+			balance_dirty_pages_ratelimited(inode->i_mapping);
+		}
 	} while (iov_iter_count(i) && length);
 
 	return written ? written : status;
@@ -825,11 +849,18 @@ iomap_file_buffered_write(struct kiocb *iocb, struct iov_iter *iter,
 		const struct iomap_ops *ops)
 {
 	struct inode *inode = iocb->ki_filp->f_mapping->host;
+	struct iomap_write_ctx ctx = { .iter = iter };
 	loff_t pos = iocb->ki_pos, ret = 0, written = 0;
+	unsigned int flags = IOMAP_WRITE;
+
+	if (iocb->ki_flags & IOCB_NOWAIT) {
+		flags |= IOMAP_NOWAIT;
+		ctx.flags |= IOMAP_WRITE_F_NOWAIT;
+	}
 
 	while (iov_iter_count(iter)) {
 		ret = iomap_apply(inode, pos, iov_iter_count(iter),
-				IOMAP_WRITE, ops, iter, iomap_write_actor);
+				flags, ops, &ctx, iomap_write_actor);
 		if (ret <= 0)
 			break;
 		pos += ret;
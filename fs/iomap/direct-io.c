@@ -305,7 +305,7 @@ iomap_dio_bio_actor(struct inode *inode, loff_t pos, loff_t length,
 			goto out;
 		}
 
-		bio = bio_alloc(GFP_KERNEL, nr_pages);
+		bio = bio_alloc_kiocb(dio->iocb, nr_pages, &fs_bio_set);
 		bio_set_dev(bio, iomap->bdev);
 		bio->bi_iter.bi_sector = iomap_sector(iomap, pos);
 		bio->bi_write_hint = dio->iocb->ki_hint;
@@ -639,6 +639,113 @@ __iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 }
 EXPORT_SYMBOL_GPL(__iomap_dio_rw);
 
+#define IOMAP_DIO_INLINE_VECS	4
+
+static void iomap_dio_simple_end_io(struct bio *bio)
+{
+	struct task_struct *waiter = bio->bi_private;
+
+	WRITE_ONCE(bio->bi_private, NULL);
+	blk_wake_io_task(waiter);
+}
+
+/*
+ * Fast path for small synchronous reads that are covered by a single mapped
+ * extent: issue one on-stack bio and wait for it, without allocating a
+ * struct iomap_dio or going through iomap_apply().  Returns 0 if the request
+ * does not qualify and has to go through __iomap_dio_rw() instead.
+ */
+static ssize_t
+iomap_dio_read_simple(struct kiocb *iocb, struct iov_iter *iter,
+		const struct iomap_ops *ops)
+{
+	struct inode *inode = file_inode(iocb->ki_filp);
+	struct iomap iomap = { .type = IOMAP_HOLE };
+	struct iomap srcmap = { .type = IOMAP_HOLE };
+	struct bio_vec inline_vecs[IOMAP_DIO_INLINE_VECS];
+	size_t count = iov_iter_count(iter);
+	loff_t pos = iocb->ki_pos;
+	bool should_dirty = iter_is_iovec(iter);
+	struct bio bio;
+	ssize_t ret;
+	blk_qc_t qc;
+
+	if (pos + count > i_size_read(inode) ||
+	    iov_iter_npages(iter, IOMAP_DIO_INLINE_VECS + 1) >
+			IOMAP_DIO_INLINE_VECS)
+		return 0;
+
+	ret = filemap_write_and_wait_range(iocb->ki_filp->f_mapping, pos,
+					   pos + count - 1);
+	if (ret)
+		return ret;
+
+	inode_dio_begin(inode);
+
+	/* errors, including -ENOTBLK, are handled by the regular path */
+	if (ops->iomap_begin(inode, pos, count, IOMAP_DIRECT, &iomap, &srcmap)) {
+		ret = 0;
+		goto out_dio_end;
+	}
+
+	if (iomap.type != IOMAP_MAPPED || srcmap.type != IOMAP_HOLE ||
+	    iomap.offset > pos || iomap.offset + iomap.length < pos + count ||
+	    ((pos | count | iov_iter_alignment(iter)) &
+	     (bdev_logical_block_size(iomap.bdev) - 1))) {
+		ret = 0;
+		goto out_end;
+	}
+
+	bio_init(&bio, inline_vecs, IOMAP_DIO_INLINE_VECS);
+	bio_set_dev(&bio, iomap.bdev);
+	bio.bi_iter.bi_sector = iomap_sector(&iomap, pos);
+	bio.bi_ioprio = iocb->ki_ioprio;
+	bio.bi_private = current;
+	bio.bi_end_io = iomap_dio_simple_end_io;
+	bio.bi_opf = REQ_OP_READ;
+
+	ret = bio_iov_iter_get_pages(&bio, iter);
+	if (unlikely(ret) || bio.bi_iter.bi_size != count) {
+		/* let the regular path deal with it */
+		iov_iter_revert(iter, bio.bi_iter.bi_size);
+		bio_release_pages(&bio, false);
+		ret = 0;
+		goto out_uninit;
+	}
+
+	if (iocb->ki_flags & IOCB_HIPRI)
+		bio_set_polled(&bio, iocb);
+
+	qc = submit_bio(&bio);
+	for (;;) {
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		if (!READ_ONCE(bio.bi_private))
+			break;
+		if (!(iocb->ki_flags & IOCB_HIPRI) ||
+		    !blk_poll(bdev_get_queue(iomap.bdev), qc, true))
+			blk_io_schedule();
+	}
+	__set_current_state(TASK_RUNNING);
+
+	bio_release_pages(&bio, should_dirty);
+	if (unlikely(bio.bi_status)) {
+		ret = blk_status_to_errno(bio.bi_status);
+	} else {
+		ret = count;
+		iocb->ki_pos += count;
+	}
+
+out_uninit:
+	bio_uninit(&bio);
+out_end:
+	if (ops->iomap_end)
+		ops->iomap_end(inode, pos, count, ret > 0 ? ret : 0,
+			       IOMAP_DIRECT, &iomap);
+out_dio_end:
+	inode_dio_end(inode);
+	return ret;
+}
+
 ssize_t
 iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 		const struct iomap_ops *ops, const struct iomap_dio_ops *dops,
@@ -646,6 +753,18 @@ iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 {
 	struct iomap_dio *dio;
 
+	/*
+	 * Filesystems with their own completion or submission hooks always
+	 * need the full dio machinery.
+	 */
+	if (iov_iter_rw(iter) == READ && is_sync_kiocb(iocb) && !dops &&
+	    !(iocb->ki_flags & IOCB_NOWAIT) && iov_iter_count(iter)) {
+		ssize_t ret = iomap_dio_read_simple(iocb, iter, ops);
+
+		if (ret)
+			return ret;
+	}
+
 	dio = __iomap_dio_rw(iocb, iter, ops, dops, dio_flags);
 	if (IS_ERR_OR_NULL(dio))
 		return PTR_ERR_OR_ZERO(dio);
@@ -176,6 +176,63 @@ __releases(&journal->j_state_lock)
 	}
 }
 
+/*
+ * Amount of free log space below which the log is checkpointed in the
+ * background: one more maximum sized transaction than start_this_handle()
+ * needs before it blocks on __jbd2_log_wait_for_space().
+ */
+static inline unsigned long jbd2_checkpoint_low_space(journal_t *journal)
+{
+	return 2 * (unsigned long)journal->j_max_transaction_buffers;
+}
+
+/*
+ * Queue background checkpointing if the log is running low on space.
+ * Called after a commit, without any journal locks held.
+ */
+void jbd2_log_start_checkpoint(journal_t *journal)
+{
+	bool low;
+
+	read_lock(&journal->j_state_lock);
+	low = !is_journal_aborted(journal) &&
+	      jbd2_log_space_left(journal) < jbd2_checkpoint_low_space(journal);
+	read_unlock(&journal->j_state_lock);
+
+	if (low)
+		queue_work(system_unbound_wq, &journal->j_checkpoint_work);
+}
+
+/*
+ * Checkpoint transactions until the log has enough free space again.
+ * The writeback runs while kjournald2 keeps committing and new handles
+ * keep being started; only __jbd2_log_wait_for_space() callers serialize
+ * against it on j_checkpoint_mutex.
+ */
+void jbd2_checkpoint_work(struct work_struct *work)
+{
+	journal_t *journal = container_of(work, journal_t, j_checkpoint_work);
+	bool more;
+
+	mutex_lock_io(&journal->j_checkpoint_mutex);
+	for (;;) {
+		read_lock(&journal->j_state_lock);
+		more = !is_journal_aborted(journal) &&
+		       jbd2_log_space_left(journal) <
+				jbd2_checkpoint_low_space(journal);
+		read_unlock(&journal->j_state_lock);
+		if (!more)
+			break;
+
+		spin_lock(&journal->j_list_lock);
+		more = journal->j_checkpoint_transactions != NULL;
+		spin_unlock(&journal->j_list_lock);
+		if (!more || jbd2_log_do_checkpoint(journal))
+			break;
+	}
+	mutex_unlock(&journal->j_checkpoint_mutex);
+}
+
 static void
 __flush_batch(journal_t *journal, int *batch_count)
 {
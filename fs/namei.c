@@ -39,6 +39,7 @@
 #include <linux/bitops.h>
 #include <linux/init_task.h>
 #include <linux/uaccess.h>
+#include <linux/sysctl.h>
 
 #include "internal.h"
 #include "mount.h"
@@ -738,6 +739,42 @@ static bool legitimize_root(struct nameidata *nd)
  * Nothing should touch nameidata between try_to_unlazy() failure and
  * terminate_walk().
  */
+/*
+ * Per-cpu counters of walks leaving rcu-walk mode, reported through
+ * /proc/sys/fs/namei-state.  Like the dcache counters they are summed
+ * over all possible CPUs.
+ */
+static DEFINE_PER_CPU(long, nr_unlazy);
+static DEFINE_PER_CPU(long, nr_unlazy_failed);
+static DEFINE_PER_CPU(long, nr_rcu_restart);
+
+#if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
+static long sum_namei_counter(long __percpu *counter)
+{
+	long sum = 0;
+	int i;
+
+	for_each_possible_cpu(i)
+		sum += *per_cpu_ptr(counter, i);
+	return sum;
+}
+
+int proc_namei_state(struct ctl_table *table, int write, void *buffer,
+		     size_t *lenp, loff_t *ppos)
+{
+	unsigned long state[3];
+	struct ctl_table t = *table;
+
+	state[0] = sum_namei_counter(&nr_unlazy);
+	state[1] = sum_namei_counter(&nr_unlazy_failed);
+	state[2] = sum_namei_counter(&nr_rcu_restart);
+
+	t.data = state;
+	t.maxlen = sizeof(state);
+	return proc_doulongvec_minmax(&t, write, buffer, lenp, ppos);
+}
+#endif
+
 static bool try_to_unlazy(struct nameidata *nd)
 {
 	struct dentry *parent = nd->path.dentry;
@@ -753,6 +790,7 @@ static bool try_to_unlazy(struct nameidata *nd)
 		goto out;
 	rcu_read_unlock();
 	BUG_ON(nd->inode != parent->d_inode);
+	this_cpu_inc(nr_unlazy);
 	return true;
 
 out1:
@@ -760,6 +798,7 @@ static bool try_to_unlazy(struct nameidata *nd)
 	nd->path.dentry = NULL;
 out:
 	rcu_read_unlock();
+	this_cpu_inc(nr_unlazy_failed);
 	return false;
 }
 
@@ -806,6 +845,7 @@ static bool try_to_unlazy_next(struct nameidata *nd, struct dentry *dentry, unsi
 	if (unlikely(!legitimize_root(nd)))
 		goto out_dput;
 	rcu_read_unlock();
+	this_cpu_inc(nr_unlazy);
 	return true;
 
 out2:
@@ -814,10 +854,12 @@ static bool try_to_unlazy_next(struct nameidata *nd, struct dentry *dentry, unsi
 	nd->path.dentry = NULL;
 out:
 	rcu_read_unlock();
+	this_cpu_inc(nr_unlazy_failed);
 	return false;
 out_dput:
 	rcu_read_unlock();
 	dput(dentry);
+	this_cpu_inc(nr_unlazy_failed);
 	return false;
 }
 
@@ -2207,13 +2249,20 @@ static int link_path_walk(const char *name, struct nameidata *nd)
 		u64 hash_len;
 		int type;
 
+		/*
+		 * The name hash only depends on the parent and the name, so
+		 * compute it first and get the dcache bucket on its way
+		 * while may_lookup() looks at the parent inode.
+		 */
+		hash_len = hash_name(nd->path.dentry, name);
+		if (likely(!(nd->path.dentry->d_flags & DCACHE_OP_HASH)))
+			d_hash_prefetch(hashlen_hash(hash_len));
+
 		mnt_userns = mnt_user_ns(nd->path.mnt);
 		err = may_lookup(mnt_userns, nd);
 		if (err)
 			return err;
 
-		hash_len = hash_name(nd->path.dentry, name);
-
 		type = LAST_NORM;
 		if (name[0] == '.') switch (hashlen_len(hash_len)) {
 			case 2:
@@ -2452,8 +2501,10 @@ int filename_lookup(int dfd, struct filename *name, unsigned flags,
 	}
 	set_nameidata(&nd, dfd, name);
 	retval = path_lookupat(&nd, flags | LOOKUP_RCU, path);
-	if (unlikely(retval == -ECHILD))
+	if (unlikely(retval == -ECHILD)) {
+		this_cpu_inc(nr_rcu_restart);
 		retval = path_lookupat(&nd, flags, path);
+	}
 	if (unlikely(retval == -ESTALE))
 		retval = path_lookupat(&nd, flags | LOOKUP_REVAL, path);
 
@@ -2493,8 +2544,10 @@ static struct filename *filename_parentat(int dfd, struct filename *name,
 		return name;
 	set_nameidata(&nd, dfd, name);
 	retval = path_parentat(&nd, flags | LOOKUP_RCU, parent);
-	if (unlikely(retval == -ECHILD))
+	if (unlikely(retval == -ECHILD)) {
+		this_cpu_inc(nr_rcu_restart);
 		retval = path_parentat(&nd, flags, parent);
+	}
 	if (unlikely(retval == -ESTALE))
 		retval = path_parentat(&nd, flags | LOOKUP_REVAL, parent);
 	if (likely(!retval)) {
@@ -3519,8 +3572,10 @@ struct file *do_filp_open(int dfd, struct filename *pathname,
 
 	set_nameidata(&nd, dfd, pathname);
 	filp = path_openat(&nd, op, flags | LOOKUP_RCU);
-	if (unlikely(filp == ERR_PTR(-ECHILD)))
+	if (unlikely(filp == ERR_PTR(-ECHILD))) {
+		this_cpu_inc(nr_rcu_restart);
 		filp = path_openat(&nd, op, flags);
+	}
 	if (unlikely(filp == ERR_PTR(-ESTALE)))
 		filp = path_openat(&nd, op, flags | LOOKUP_REVAL);
 	restore_nameidata();
@@ -3547,8 +3602,10 @@ struct file *do_file_open_root(struct dentry *dentry, struct vfsmount *mnt,
 
 	set_nameidata(&nd, -1, filename);
 	file = path_openat(&nd, op, flags | LOOKUP_RCU);
-	if (unlikely(file == ERR_PTR(-ECHILD)))
+	if (unlikely(file == ERR_PTR(-ECHILD))) {
+		this_cpu_inc(nr_rcu_restart);
 		file = path_openat(&nd, op, flags);
+	}
 	if (unlikely(file == ERR_PTR(-ESTALE)))
 		file = path_openat(&nd, op, flags | LOOKUP_REVAL);
 	restore_nameidata();
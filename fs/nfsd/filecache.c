@@ -22,10 +22,12 @@
 
 #define NFSDDBG_FACILITY	NFSDDBG_FH
 
-/* FIXME: dynamically size this for the machine somehow? */
-#define NFSD_FILE_HASH_BITS                   12
-#define NFSD_FILE_HASH_SIZE                  (1 << NFSD_FILE_HASH_BITS)
+/* The hash table is sized from the amount of memory, within these bounds */
+#define NFSD_FILE_HASH_BITS_MIN               12
+#define NFSD_FILE_HASH_BITS_MAX               18
+#define NFSD_FILE_HASH_SIZE                  (1U << nfsd_file_hash_bits)
 #define NFSD_LAUNDRETTE_DELAY		     (2 * HZ)
+#define NFSD_FILE_GC_BATCH		     (1024UL)
 
 #define NFSD_FILE_SHUTDOWN		     (1)
 #define NFSD_FILE_LRU_THRESHOLD		     (4096UL)
@@ -42,6 +44,8 @@ struct nfsd_fcache_bucket {
 };
 
 static DEFINE_PER_CPU(unsigned long, nfsd_file_cache_hits);
+static DEFINE_PER_CPU(unsigned long, nfsd_file_cache_misses);
+static DEFINE_PER_CPU(unsigned long, nfsd_file_evictions);
 
 struct nfsd_fcache_disposal {
 	struct list_head list;
@@ -57,6 +61,7 @@ static struct workqueue_struct *nfsd_filecache_wq __read_mostly;
 static struct kmem_cache		*nfsd_file_slab;
 static struct kmem_cache		*nfsd_file_mark_slab;
 static struct nfsd_fcache_bucket	*nfsd_file_hashtbl;
+static unsigned int			nfsd_file_hash_bits __read_mostly;
 static struct list_lru			nfsd_file_lru;
 static long				nfsd_file_lru_flags;
 static struct fsnotify_group		*nfsd_file_fsnotify_group;
@@ -446,13 +451,18 @@ nfsd_file_lru_cb(struct list_head *item, struct list_lru_one *lru,
 		goto out_skip;
 
 	list_lru_isolate_move(lru, &nf->nf_lru, head);
+	this_cpu_inc(nfsd_file_evictions);
 	return LRU_REMOVED;
 out_skip:
-	return LRU_SKIP;
+	/*
+	 * Move the entry out of the way, so that the next bounded walk
+	 * starts with entries that were not looked at yet.
+	 */
+	return LRU_ROTATE;
 }
 
 static unsigned long
-nfsd_file_lru_walk_list(struct shrink_control *sc)
+nfsd_file_lru_walk_list(struct shrink_control *sc, unsigned long nr_to_walk)
 {
 	LIST_HEAD(head);
 	struct nfsd_file *nf;
@@ -464,7 +474,7 @@ nfsd_file_lru_walk_list(struct shrink_control *sc)
 	else
 		ret = list_lru_walk(&nfsd_file_lru,
 				nfsd_file_lru_cb,
-				&head, LONG_MAX);
+				&head, nr_to_walk);
 	list_for_each_entry(nf, &head, nf_lru) {
 		spin_lock(&nfsd_file_hashtbl[nf->nf_hashval].nfb_lock);
 		nfsd_file_do_unhash(nf);
@@ -474,16 +484,29 @@ nfsd_file_lru_walk_list(struct shrink_control *sc)
 	return ret;
 }
 
+/*
+ * Called synchronously when the cache grew too large, so only look at a
+ * bounded number of entries.
+ */
 static void
 nfsd_file_gc(void)
 {
-	nfsd_file_lru_walk_list(NULL);
+	nfsd_file_lru_walk_list(NULL, NFSD_FILE_GC_BATCH);
 }
 
 static void
 nfsd_file_gc_worker(struct work_struct *work)
 {
-	nfsd_file_gc();
+	unsigned long remaining = list_lru_count(&nfsd_file_lru);
+
+	/* Walk the whole LRU, dropping the lru lock between batches */
+	while (remaining) {
+		unsigned long nr = min(remaining, NFSD_FILE_GC_BATCH);
+
+		nfsd_file_lru_walk_list(NULL, nr);
+		remaining -= nr;
+		cond_resched();
+	}
 	nfsd_file_schedule_laundrette();
 }
 
@@ -496,7 +519,7 @@ nfsd_file_lru_count(struct shrinker *s, struct shrink_control *sc)
 static unsigned long
 nfsd_file_lru_scan(struct shrinker *s, struct shrink_control *sc)
 {
-	return nfsd_file_lru_walk_list(sc);
+	return nfsd_file_lru_walk_list(sc, 0);
 }
 
 static struct shrinker	nfsd_file_shrinker = {
@@ -533,7 +556,7 @@ void
 nfsd_file_close_inode_sync(struct inode *inode)
 {
 	unsigned int		hashval = (unsigned int)hash_long(inode->i_ino,
-						NFSD_FILE_HASH_BITS);
+						nfsd_file_hash_bits);
 	LIST_HEAD(dispose);
 
 	__nfsd_file_close_inode(inode, hashval, &dispose);
@@ -553,7 +576,7 @@ static void
 nfsd_file_close_inode(struct inode *inode)
 {
 	unsigned int		hashval = (unsigned int)hash_long(inode->i_ino,
-						NFSD_FILE_HASH_BITS);
+						nfsd_file_hash_bits);
 	LIST_HEAD(dispose);
 
 	__nfsd_file_close_inode(inode, hashval, &dispose);
@@ -641,7 +664,12 @@ nfsd_file_cache_init(void)
 	if (!nfsd_filecache_wq)
 		goto out;
 
-	nfsd_file_hashtbl = kcalloc(NFSD_FILE_HASH_SIZE,
+	/* one bucket per 64 pages of memory */
+	nfsd_file_hash_bits = clamp_t(int,
+				      ilog2(totalram_pages()) - 6,
+				      NFSD_FILE_HASH_BITS_MIN,
+				      NFSD_FILE_HASH_BITS_MAX);
+	nfsd_file_hashtbl = kvcalloc(NFSD_FILE_HASH_SIZE,
 				sizeof(*nfsd_file_hashtbl), GFP_KERNEL);
 	if (!nfsd_file_hashtbl) {
 		pr_err("nfsd: unable to allocate nfsd_file_hashtbl\n");
@@ -709,7 +737,7 @@ nfsd_file_cache_init(void)
 	nfsd_file_slab = NULL;
 	kmem_cache_destroy(nfsd_file_mark_slab);
 	nfsd_file_mark_slab = NULL;
-	kfree(nfsd_file_hashtbl);
+	kvfree(nfsd_file_hashtbl);
 	nfsd_file_hashtbl = NULL;
 	destroy_workqueue(nfsd_filecache_wq);
 	nfsd_filecache_wq = NULL;
@@ -855,7 +883,7 @@ nfsd_file_cache_shutdown(void)
 	fsnotify_wait_marks_destroyed();
 	kmem_cache_destroy(nfsd_file_mark_slab);
 	nfsd_file_mark_slab = NULL;
-	kfree(nfsd_file_hashtbl);
+	kvfree(nfsd_file_hashtbl);
 	nfsd_file_hashtbl = NULL;
 	destroy_workqueue(nfsd_filecache_wq);
 	nfsd_filecache_wq = NULL;
@@ -920,7 +948,7 @@ nfsd_file_is_cached(struct inode *inode)
 	struct nfsd_file	*nf;
 	unsigned int		hashval;
 
-        hashval = (unsigned int)hash_long(inode->i_ino, NFSD_FILE_HASH_BITS);
+        hashval = (unsigned int)hash_long(inode->i_ino, nfsd_file_hash_bits);
 
 	rcu_read_lock();
 	hlist_for_each_entry_rcu(nf, &nfsd_file_hashtbl[hashval].nfb_head,
@@ -953,7 +981,7 @@ nfsd_file_acquire(struct svc_rqst *rqstp, struct svc_fh *fhp,
 		return status;
 
 	inode = d_inode(fhp->fh_dentry);
-	hashval = (unsigned int)hash_long(inode->i_ino, NFSD_FILE_HASH_BITS);
+	hashval = (unsigned int)hash_long(inode->i_ino, nfsd_file_hash_bits);
 retry:
 	rcu_read_lock();
 	nf = nfsd_file_find_locked(inode, may_flags, hashval, net);
@@ -1028,6 +1056,7 @@ nfsd_file_acquire(struct svc_rqst *rqstp, struct svc_fh *fhp,
 	nfsd_file_hashtbl[hashval].nfb_maxcount = max(nfsd_file_hashtbl[hashval].nfb_maxcount,
 			nfsd_file_hashtbl[hashval].nfb_count);
 	spin_unlock(&nfsd_file_hashtbl[hashval].nfb_lock);
+	this_cpu_inc(nfsd_file_cache_misses);
 	if (atomic_long_inc_return(&nfsd_filecache_count) >= NFSD_FILE_LRU_THRESHOLD)
 		nfsd_file_gc();
 
@@ -1063,7 +1092,7 @@ nfsd_file_acquire(struct svc_rqst *rqstp, struct svc_fh *fhp,
 static int nfsd_file_cache_stats_show(struct seq_file *m, void *v)
 {
 	unsigned int i, count = 0, longest = 0;
-	unsigned long hits = 0;
+	unsigned long hits = 0, misses = 0, evictions = 0;
 
 	/*
 	 * No need for spinlocks here since we're not terribly interested in
@@ -1079,12 +1108,19 @@ static int nfsd_file_cache_stats_show(struct seq_file *m, void *v)
 	}
 	mutex_unlock(&nfsd_mutex);
 
-	for_each_possible_cpu(i)
+	for_each_possible_cpu(i) {
 		hits += per_cpu(nfsd_file_cache_hits, i);
+		misses += per_cpu(nfsd_file_cache_misses, i);
+		evictions += per_cpu(nfsd_file_evictions, i);
+	}
 
 	seq_printf(m, "total entries: %u\n", count);
+	seq_printf(m, "hash buckets:  %u\n",
+		   nfsd_file_hashtbl ? NFSD_FILE_HASH_SIZE : 0);
 	seq_printf(m, "longest chain: %u\n", longest);
 	seq_printf(m, "cache hits:    %lu\n", hits);
+	seq_printf(m, "cache misses:  %lu\n", misses);
+	seq_printf(m, "evictions:     %lu\n", evictions);
 	return 0;
 }
 
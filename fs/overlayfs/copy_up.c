@@ -141,6 +141,7 @@ static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
 	loff_t data_pos = -1;
 	loff_t hole_len;
 	bool skip_hole = false;
+	bool try_copy_range = false;
 	int error = 0;
 
 	if (len == 0)
@@ -162,6 +163,15 @@ static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
 		goto out;
 	/* Couldn't clone, so now we try to copy the data */
 
+	/*
+	 * If lower and upper are on the same kind of fs, that fs may be able
+	 * to copy the data without moving it through the page cache, e.g.
+	 * by a server side copy.  Fall back to splice on the first failure.
+	 */
+	if (new_file->f_op->copy_file_range &&
+	    new_file->f_op->copy_file_range == old_file->f_op->copy_file_range)
+		try_copy_range = true;
+
 	/* Check if lower fs supports seek operation */
 	if (old_file->f_mode & FMODE_LSEEK &&
 	    old_file->f_op->llseek)
@@ -209,6 +219,19 @@ static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
 			}
 		}
 
+		if (try_copy_range) {
+			bytes = new_file->f_op->copy_file_range(old_file,
+						old_pos, new_file, new_pos,
+						this_len, 0);
+			if (bytes > 0) {
+				old_pos += bytes;
+				new_pos += bytes;
+				len -= bytes;
+				continue;
+			}
+			try_copy_range = false;
+		}
+
 		bytes = do_splice_direct(old_file, &old_pos,
 					 new_file, &new_pos,
 					 this_len, SPLICE_F_MOVE);
@@ -37,6 +37,13 @@
  */
 unsigned int pipe_max_size = 1048576;
 
+/*
+ * The size of newly created pipes, can be set by root in
+ * /proc/sys/fs/pipe-default-size.  Non-root users still get at most
+ * pipe_max_size.
+ */
+unsigned int pipe_def_size = PIPE_DEF_BUFFERS * PAGE_SIZE;
+
 /* Maximum allocatable pages per user. Hard limit is unset by default, soft
  * matches default values.
  */
@@ -766,7 +773,7 @@ bool pipe_is_unprivileged_user(void)
 struct pipe_inode_info *alloc_pipe_info(void)
 {
 	struct pipe_inode_info *pipe;
-	unsigned long pipe_bufs = PIPE_DEF_BUFFERS;
+	unsigned long pipe_bufs = READ_ONCE(pipe_def_size) >> PAGE_SHIFT;
 	struct user_struct *user = get_current_user();
 	unsigned long user_bufs;
 	unsigned int max_size = READ_ONCE(pipe_max_size);
@@ -1342,6 +1349,19 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 	return ret;
 }
 
+/*
+ * Grow the internal pipe of splice_direct_to_actor() so that a transfer of
+ * @len bytes needs fewer trips through it.  This is only an optimisation:
+ * the usual pipe size limits apply and failure is ignored.
+ */
+void pipe_grow_direct(struct pipe_inode_info *pipe, size_t len)
+{
+	unsigned long size = min_t(unsigned long, len, READ_ONCE(pipe_max_size));
+
+	if (size > pipe->max_usage * PAGE_SIZE)
+		pipe_set_size(pipe, size);
+}
+
 /*
  * Note that i_pipe and i_cdev share the same location, so checking ->i_pipe is
  * not enough to verify that this is a pipe.
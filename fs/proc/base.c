@@ -472,14 +472,27 @@ static int proc_pid_stack(struct seq_file *m, struct pid_namespace *ns,
 static int proc_pid_schedstat(struct seq_file *m, struct pid_namespace *ns,
 			      struct pid *pid, struct task_struct *task)
 {
-	if (unlikely(!sched_info_on()))
+	int i;
+
+	if (unlikely(!sched_info_on())) {
 		seq_puts(m, "0 0 0\n");
-	else
-		seq_printf(m, "%llu %llu %lu\n",
+		return 0;
+	}
+
+	seq_printf(m, "%llu %llu %lu\n",
 		   (unsigned long long)task->se.sum_exec_runtime,
 		   (unsigned long long)task->sched_info.run_delay,
 		   task->sched_info.pcount);
 
+	/*
+	 * Second line: number of runqueue waits per power of two bucket,
+	 * below 1024ns, [1024ns, 2048ns) and so on.
+	 */
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+		seq_printf(m, "%s%u", i ? " " : "",
+			   READ_ONCE(task->sched_info.lat_hist[i]));
+	seq_putc(m, '\n');
+
 	return 0;
 }
 #endif
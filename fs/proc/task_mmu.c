@@ -383,6 +383,7 @@ struct mem_size_stats {
 	unsigned long private_clean;
 	unsigned long private_dirty;
 	unsigned long referenced;
+	unsigned long idle;
 	unsigned long anonymous;
 	unsigned long lazyfree;
 	unsigned long anonymous_thp;
@@ -449,6 +450,9 @@ static void smaps_account(struct mem_size_stats *mss, struct page *page,
 	/* Accumulate the size in pages that have been accessed. */
 	if (young || page_is_young(page) || PageReferenced(page))
 		mss->referenced += size;
+	/* Not accessed through this mapping since CLEAR_REFS_MARK_IDLE */
+	if (!young && page_is_idle(page))
+		mss->idle += size;
 
 	/*
 	 * Then accumulate quantities that may depend on sharing, or that may
@@ -797,6 +801,8 @@ static void __show_smap(struct seq_file *m, const struct mem_size_stats *mss,
 	SEQ_PUT_DEC(" kB\nPrivate_Clean:  ", mss->private_clean);
 	SEQ_PUT_DEC(" kB\nPrivate_Dirty:  ", mss->private_dirty);
 	SEQ_PUT_DEC(" kB\nReferenced:     ", mss->referenced);
+	if (IS_ENABLED(CONFIG_IDLE_PAGE_TRACKING))
+		SEQ_PUT_DEC(" kB\nIdle:           ", mss->idle);
 	SEQ_PUT_DEC(" kB\nAnonymous:      ", mss->anonymous);
 	SEQ_PUT_DEC(" kB\nLazyFree:       ", mss->lazyfree);
 	SEQ_PUT_DEC(" kB\nAnonHugePages:  ", mss->anonymous_thp);
@@ -1030,6 +1036,7 @@ enum clear_refs_types {
 	CLEAR_REFS_MAPPED,
 	CLEAR_REFS_SOFT_DIRTY,
 	CLEAR_REFS_MM_HIWATER_RSS,
+	CLEAR_REFS_MARK_IDLE,
 	CLEAR_REFS_LAST,
 };
 
@@ -1117,6 +1124,33 @@ static inline void clear_soft_dirty_pmd(struct vm_area_struct *vma,
 }
 #endif
 
+/*
+ * Like writing the page to /sys/kernel/mm/page_idle/bitmap, but found
+ * through the page tables of this mm rather than through the rmap, which
+ * makes per-process working set estimation cost a page table walk. An
+ * access seen in the pte is handed over to reclaim via the young flag.
+ * As with the bitmap, only user pages on the LRU are tracked.
+ */
+static inline void mark_page_idle_pte(struct vm_area_struct *vma,
+		unsigned long addr, pte_t *pte, struct page *page)
+{
+	if (!PageLRU(page))
+		return;
+	if (ptep_clear_young_notify(vma, addr, pte))
+		set_page_young(page);
+	set_page_idle(page);
+}
+
+static inline void mark_page_idle_pmd(struct vm_area_struct *vma,
+		unsigned long addr, pmd_t *pmd, struct page *page)
+{
+	if (!PageLRU(page))
+		return;
+	if (pmdp_clear_young_notify(vma, addr, pmd))
+		set_page_young(page);
+	set_page_idle(page);
+}
+
 static int clear_refs_pte_range(pmd_t *pmd, unsigned long addr,
 				unsigned long end, struct mm_walk *walk)
 {
@@ -1138,6 +1172,11 @@ static int clear_refs_pte_range(pmd_t *pmd, unsigned long addr,
 
 		page = pmd_page(*pmd);
 
+		if (cp->type == CLEAR_REFS_MARK_IDLE) {
+			mark_page_idle_pmd(vma, addr, pmd, page);
+			goto out;
+		}
+
 		/* Clear accessed and referenced bits. */
 		pmdp_test_and_clear_young(vma, addr, pmd);
 		test_and_clear_page_young(page);
@@ -1166,6 +1205,11 @@ static int clear_refs_pte_range(pmd_t *pmd, unsigned long addr,
 		if (!page)
 			continue;
 
+		if (cp->type == CLEAR_REFS_MARK_IDLE) {
+			mark_page_idle_pte(vma, addr, pte, page);
+			continue;
+		}
+
 		/* Clear accessed and referenced bits. */
 		ptep_test_and_clear_young(vma, addr, pte);
 		test_and_clear_page_young(page);
@@ -1190,6 +1234,7 @@ static int clear_refs_test_walk(unsigned long start, unsigned long end,
 	 * Writing 2 to /proc/pid/clear_refs only affects anonymous pages.
 	 * Writing 3 to /proc/pid/clear_refs only affects file mapped pages.
 	 * Writing 4 to /proc/pid/clear_refs affects all pages.
+	 * Writing 6 to /proc/pid/clear_refs affects all pages.
 	 */
 	if (cp->type == CLEAR_REFS_ANON && vma->vm_file)
 		return 1;
@@ -1225,6 +1270,9 @@ static ssize_t clear_refs_write(struct file *file, const char __user *buf,
 	type = (enum clear_refs_types)itype;
 	if (type < CLEAR_REFS_ALL || type >= CLEAR_REFS_LAST)
 		return -EINVAL;
+	if (type == CLEAR_REFS_MARK_IDLE &&
+	    !IS_ENABLED(CONFIG_IDLE_PAGE_TRACKING))
+		return -EINVAL;
 
 	task = get_proc_task(file_inode(file));
 	if (!task)
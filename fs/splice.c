@@ -863,6 +863,9 @@ ssize_t splice_direct_to_actor(struct file *in, struct splice_desc *sd,
 
 	WARN_ON_ONCE(!pipe_empty(pipe->head, pipe->tail));
 
+	/* Let large copies move more than PIPE_DEF_BUFFERS pages per trip */
+	pipe_grow_direct(pipe, len);
+
 	while (len) {
 		size_t read_len;
 		loff_t pos = sd->pos, prev_pos = pos;
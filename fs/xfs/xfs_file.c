@@ -435,7 +435,7 @@ xfs_file_write_checks(
 	} else
 		spin_unlock(&ip->i_flags_lock);
 
-	return file_modified(file);
+	return kiocb_modified(iocb);
 }
 
 static int
@@ -717,12 +717,15 @@ xfs_file_buffered_write(
 	bool			cleared_space = false;
 	int			iolock;
 
-	if (iocb->ki_flags & IOCB_NOWAIT)
-		return -EOPNOTSUPP;
+	/* the data integrity flush in generic_write_sync() will block */
+	if ((iocb->ki_flags & IOCB_NOWAIT) && (iocb->ki_flags & IOCB_DSYNC))
+		return -EAGAIN;
 
 write_retry:
 	iolock = XFS_IOLOCK_EXCL;
-	xfs_ilock(ip, iolock);
+	ret = xfs_ilock_iocb(iocb, iolock);
+	if (ret)
+		return ret;
 
 	ret = xfs_file_write_checks(iocb, from, &iolock);
 	if (ret)
@@ -747,7 +750,11 @@ xfs_file_buffered_write(
 	 * running at the same time.  Use a synchronous scan to increase the
 	 * effectiveness of the scan.
 	 */
-	if (ret == -EDQUOT && !cleared_space) {
+	if ((iocb->ki_flags & IOCB_NOWAIT) &&
+	    (ret == -EDQUOT || ret == -ENOSPC)) {
+		/* freeing space blocks, let the caller retry without NOWAIT */
+		ret = -EAGAIN;
+	} else if (ret == -EDQUOT && !cleared_space) {
 		xfs_iunlock(ip, iolock);
 		xfs_blockgc_free_quota(ip, XFS_EOF_FLAGS_SYNC);
 		cleared_space = true;
@@ -1187,7 +1194,7 @@ xfs_file_open(
 		return -EFBIG;
 	if (XFS_FORCED_SHUTDOWN(XFS_M(inode->i_sb)))
 		return -EIO;
-	file->f_mode |= FMODE_NOWAIT | FMODE_BUF_RASYNC;
+	file->f_mode |= FMODE_NOWAIT | FMODE_BUF_RASYNC | FMODE_BUF_WASYNC;
 	return 0;
 }
 
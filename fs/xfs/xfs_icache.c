@@ -18,6 +18,7 @@
 #include "xfs_quota.h"
 #include "xfs_trace.h"
 #include "xfs_icache.h"
+#include "xfs_bmap.h"
 #include "xfs_bmap_util.h"
 #include "xfs_dquot_item.h"
 #include "xfs_dquot.h"
@@ -203,7 +204,7 @@ xfs_perag_clear_reclaim_tag(
  * Once we get tag lookups on the radix tree, this inode flag
  * can go away.
  */
-void
+static void
 xfs_inode_set_reclaim_tag(
 	struct xfs_inode	*ip)
 {
@@ -217,6 +218,7 @@ xfs_inode_set_reclaim_tag(
 	radix_tree_tag_set(&pag->pag_ici_root, XFS_INO_TO_AGINO(mp, ip->i_ino),
 			   XFS_ICI_RECLAIM_TAG);
 	xfs_perag_set_reclaim_tag(pag);
+	__xfs_iflags_clear(ip, XFS_NEED_INACTIVE | XFS_INACTIVATING);
 	__xfs_iflags_set(ip, XFS_IRECLAIMABLE);
 
 	spin_unlock(&ip->i_flags_lock);
@@ -235,6 +237,163 @@ xfs_inode_clear_reclaim_tag(
 	xfs_perag_clear_reclaim_tag(pag);
 }
 
+#ifdef DEBUG
+static void
+xfs_check_delalloc(
+	struct xfs_inode	*ip,
+	int			whichfork)
+{
+	struct xfs_ifork	*ifp = XFS_IFORK_PTR(ip, whichfork);
+	struct xfs_bmbt_irec	got;
+	struct xfs_iext_cursor	icur;
+
+	if (!ifp || !xfs_iext_lookup_extent(ip, ifp, 0, &icur, &got))
+		return;
+	do {
+		if (isnullstartblock(got.br_startblock)) {
+			xfs_warn(ip->i_mount,
+	"ino %llx %s fork has delalloc extent at [0x%llx:0x%llx]",
+				ip->i_ino,
+				whichfork == XFS_DATA_FORK ? "data" : "cow",
+				got.br_startoff, got.br_blockcount);
+		}
+	} while (xfs_iext_next_extent(ifp, &icur, &got));
+}
+#else
+#define xfs_check_delalloc(ip, whichfork)	do { } while (0)
+#endif
+
+/*
+ * Hand an inactivated inode whose VFS inode is gone over to reclaim.
+ */
+void
+xfs_inode_mark_reclaimable(
+	struct xfs_inode	*ip)
+{
+	struct xfs_mount	*mp = ip->i_mount;
+
+	if (!XFS_FORCED_SHUTDOWN(mp) && ip->i_delayed_blks) {
+		xfs_check_delalloc(ip, XFS_DATA_FORK);
+		xfs_check_delalloc(ip, XFS_COW_FORK);
+		ASSERT(0);
+	}
+
+	XFS_STATS_INC(mp, vn_reclaim);
+
+	/*
+	 * We should never get here with one of the reclaim flags already set.
+	 */
+	ASSERT_ALWAYS(!xfs_iflags_test(ip, XFS_IRECLAIMABLE));
+	ASSERT_ALWAYS(!xfs_iflags_test(ip, XFS_IRECLAIM));
+
+	/*
+	 * We always use background reclaim here because even if the inode is
+	 * clean, it still may be under IO and hence we have wait for IO
+	 * completion to occur before we can reclaim the inode. The background
+	 * reclaim path handles this more efficiently than we can here, so
+	 * simply let background reclaim tear down all inodes.
+	 */
+	xfs_inode_set_reclaim_tag(ip);
+}
+
+/*
+ * Number of inodes an AG may have waiting for inactivation before the
+ * threads destroying more of them wait for the worker to catch up.  This
+ * bounds the memory pinned by the queued inodes.
+ */
+#define XFS_INODEGC_MAX_BACKLOG		1024
+
+/*
+ * Queue an unlinked inode for inactivation by the inodegc worker of its AG
+ * so that the final iput() in unlink and close doesn't have to free it.
+ * Returns false if the caller has to inactivate the inode itself.
+ *
+ * Only done while the filesystem is active: during mount (log recovery)
+ * and unmount inodes are still inactivated synchronously.
+ */
+bool
+xfs_inodegc_queue(
+	struct xfs_inode	*ip)
+{
+	struct xfs_mount	*mp = ip->i_mount;
+	struct xfs_perag	*pag;
+	bool			throttle;
+
+	if (VFS_I(ip)->i_mode == 0 || VFS_I(ip)->i_nlink != 0)
+		return false;
+	if (!(mp->m_super->s_flags & SB_ACTIVE) ||
+	    (mp->m_flags & XFS_MOUNT_RDONLY) || XFS_FORCED_SHUTDOWN(mp))
+		return false;
+	if (xfs_iflags_test(ip, XFS_IRECOVERY))
+		return false;
+
+	pag = xfs_perag_get(mp, XFS_INO_TO_AGNO(mp, ip->i_ino));
+	xfs_iflags_set(ip, XFS_NEED_INACTIVE);
+	llist_add(&ip->i_gclist, &pag->pag_inodegc_list);
+	throttle = atomic_inc_return(&pag->pag_inodegc_count) >
+						XFS_INODEGC_MAX_BACKLOG;
+	queue_work(mp->m_gc_workqueue, &pag->pag_inodegc_work);
+
+	/*
+	 * Don't wait from memory reclaim or from the worker itself, which
+	 * may drop the last reference to another unlinked inode.
+	 */
+	if (throttle && !(current->flags & PF_MEMALLOC) &&
+	    current_work() != &pag->pag_inodegc_work)
+		flush_work(&pag->pag_inodegc_work);
+	xfs_perag_put(pag);
+	return true;
+}
+
+void
+xfs_inodegc_worker(
+	struct work_struct	*work)
+{
+	struct xfs_perag	*pag = container_of(work, struct xfs_perag,
+						pag_inodegc_work);
+	struct llist_node	*node = llist_del_all(&pag->pag_inodegc_list);
+	struct xfs_inode	*ip, *n;
+
+	llist_for_each_entry_safe(ip, n, node, i_gclist) {
+		atomic_dec(&pag->pag_inodegc_count);
+
+		spin_lock(&ip->i_flags_lock);
+		ip->i_flags &= ~XFS_NEED_INACTIVE;
+		ip->i_flags |= XFS_INACTIVATING;
+		spin_unlock(&ip->i_flags_lock);
+
+		xfs_inactive(ip);
+		xfs_inode_mark_reclaimable(ip);
+		cond_resched();
+	}
+}
+
+/*
+ * Wait until all inodes queued for inactivation so far have been freed.
+ */
+void
+xfs_inodegc_flush(
+	struct xfs_mount	*mp)
+{
+	struct xfs_perag	*pag;
+	xfs_agnumber_t		agno;
+
+	for (agno = 0; agno < mp->m_sb.sb_agcount; agno++) {
+		pag = xfs_perag_get(mp, agno);
+		if (!pag)
+			continue;
+		/* inactivation itself can end up here through ENOSPC retries */
+		if (current_work() == &pag->pag_inodegc_work) {
+			xfs_perag_put(pag);
+			continue;
+		}
+		if (!llist_empty(&pag->pag_inodegc_list))
+			queue_work(mp->m_gc_workqueue, &pag->pag_inodegc_work);
+		flush_work(&pag->pag_inodegc_work);
+		xfs_perag_put(pag);
+	}
+}
+
 static void
 xfs_inew_wait(
 	struct xfs_inode	*ip)
@@ -366,7 +525,8 @@ xfs_iget_cache_hit(
 	 *	     wait_on_inode to wait for these flags to be cleared
 	 *	     instead of polling for it.
 	 */
-	if (ip->i_flags & (XFS_INEW|XFS_IRECLAIM)) {
+	if (ip->i_flags & (XFS_INEW | XFS_IRECLAIM | XFS_NEED_INACTIVE |
+			   XFS_INACTIVATING)) {
 		trace_xfs_iget_skip(ip);
 		XFS_STATS_INC(mp, xs_ig_frecycle);
 		error = -EAGAIN;
@@ -1637,6 +1797,9 @@ xfs_blockgc_free_space(
 {
 	trace_xfs_blockgc_free_space(mp, eofb, _RET_IP_);
 
+	/* Unlinked inodes waiting for inactivation still hold their space. */
+	xfs_inodegc_flush(mp);
+
 	return xfs_inode_walk(mp, 0, xfs_blockgc_scan_inode, eofb,
 			XFS_ICI_BLOCKGC_TAG);
 }
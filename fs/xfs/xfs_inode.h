@@ -68,6 +68,9 @@ typedef struct xfs_inode {
 	uint64_t		i_diflags2;	/* XFS_DIFLAG2_... */
 	struct timespec64	i_crtime;	/* time created */
 
+	/* link on the per-AG list of inodes waiting for inactivation */
+	struct llist_node	i_gclist;
+
 	/* VFS inode */
 	struct inode		i_vnode;	/* embedded VFS inode */
 
@@ -248,6 +251,16 @@ static inline bool xfs_inode_has_bigtime(struct xfs_inode *ip)
 #define XFS_IRECOVERY		(1 << 11)
 #define XFS_ICOWBLOCKS		(1 << 12)/* has the cowblocks tag set */
 
+/*
+ * An unlinked inode whose VFS inode has been torn down is queued for
+ * background inactivation with XFS_NEED_INACTIVE set; the inodegc worker
+ * switches it to XFS_INACTIVATING while it frees it.  Lookups must not
+ * recycle the inode in either state, and it only becomes reclaimable once
+ * inactivation is done.
+ */
+#define XFS_NEED_INACTIVE	(1 << 13)
+#define XFS_INACTIVATING	(1 << 14)
+
 /*
  * Per-lifetime flags need to be reset when re-using a reclaimable inode during
  * inode lookup. This prevents unintended behaviour on the new inode from
@@ -884,7 +884,12 @@ xfs_buffered_write_iomap_begin(
 
 	ASSERT(!XFS_IS_REALTIME_INODE(ip));
 
-	xfs_ilock(ip, XFS_ILOCK_EXCL);
+	if (flags & IOMAP_NOWAIT) {
+		if (!xfs_ilock_nowait(ip, XFS_ILOCK_EXCL))
+			return -EAGAIN;
+	} else {
+		xfs_ilock(ip, XFS_ILOCK_EXCL);
+	}
 
 	if (XFS_IS_CORRUPT(mp, !xfs_ifork_has_extents(&ip->i_df)) ||
 	    XFS_TEST_ERROR(false, mp, XFS_ERRTAG_BMAPIFORMAT)) {
@@ -892,6 +897,17 @@ xfs_buffered_write_iomap_begin(
 		goto out_unlock;
 	}
 
+	/*
+	 * Reading in the extent list and COW fork lookups that may have to
+	 * consult the refcount btree both do I/O, punt those to a context
+	 * that can block.
+	 */
+	if ((flags & IOMAP_NOWAIT) &&
+	    (xfs_need_iread_extents(&ip->i_df) || xfs_is_cow_inode(ip))) {
+		error = -EAGAIN;
+		goto out_unlock;
+	}
+
 	XFS_STATS_INC(mp, xs_blk_mapw);
 
 	error = xfs_iread_extents(NULL, ip, XFS_DATA_FORK);
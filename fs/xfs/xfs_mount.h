@@ -374,6 +374,11 @@ typedef struct xfs_perag {
 	/* background prealloc block trimming */
 	struct delayed_work	pag_blockgc_work;
 
+	/* background inactivation of unlinked inodes */
+	struct llist_head	pag_inodegc_list;
+	struct work_struct	pag_inodegc_work;
+	atomic_t		pag_inodegc_count;
+
 	/* reference count */
 	uint8_t			pagf_refcount_level;
 
@@ -795,6 +795,8 @@ xfs_qm_dqrele_all_inodes(
 	uint			flags)
 {
 	ASSERT(mp->m_quotainfo);
+	/* inodes waiting for inactivation still hold their dquots */
+	xfs_inodegc_flush(mp);
 	xfs_inode_walk(mp, XFS_INODE_WALK_INEW_WAIT, xfs_dqrele_inode,
 			&flags, XFS_ICI_NO_TAG);
 }
@@ -515,6 +515,42 @@ void blk_mq_start_request(struct request *rq);
 void blk_mq_end_request(struct request *rq, blk_status_t error);
 void __blk_mq_end_request(struct request *rq, blk_status_t error);
 
+/*
+ * Successful completions a driver collects while reaping its completion
+ * queue, to be finished together by @complete, which ends with a call to
+ * blk_mq_end_request_batch().
+ */
+struct io_comp_batch {
+	struct list_head req_list;
+	void (*complete)(struct io_comp_batch *);
+};
+
+#define DEFINE_IO_COMP_BATCH(name)					\
+	struct io_comp_batch name = {					\
+		.req_list = LIST_HEAD_INIT(name.req_list),		\
+	}
+
+void blk_mq_end_request_batch(struct io_comp_batch *iob);
+
+/*
+ * Only requests that completed without error, have no ->end_io callback and
+ * don't go through an I/O scheduler can be completed in a batch.  Returns
+ * false if @req has to be completed on its own.
+ */
+static inline bool blk_mq_add_to_batch(struct request *req,
+				       struct io_comp_batch *iob, int ioerror,
+				       void (*complete)(struct io_comp_batch *))
+{
+	if (!iob || ioerror || req->end_io || req->q->elevator)
+		return false;
+	if (!iob->complete)
+		iob->complete = complete;
+	else if (iob->complete != complete)
+		return false;
+	list_add_tail(&req->queuelist, &iob->req_list);
+	return true;
+}
+
 void blk_mq_requeue_request(struct request *rq, bool kick_requeue_list);
 void blk_mq_kick_requeue_list(struct request_queue *q);
 void blk_mq_delay_kick_requeue_list(struct request_queue *q, unsigned long msecs);
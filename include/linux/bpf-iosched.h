@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_BPF_IOSCHED_H
+#define _LINUX_BPF_IOSCHED_H
+
+/*
+ * Interface of the "bpf" I/O scheduler, whose dispatch policy is supplied
+ * by a BPF struct_ops implementing struct bpf_iosched_ops.
+ */
+
+#include <linux/types.h>
+
+#ifdef CONFIG_MQ_IOSCHED_BPF
+
+struct request;
+struct request_queue;
+
+/* Number of FIFOs per request queue the BPF policy sorts requests into */
+#define BPF_IOSCHED_NR_QUEUES	8
+
+/* ->dispatch_request() return value: dispatch nothing for now */
+#define BPF_IOSCHED_DEFER	(-1)
+
+/* ->insert_request() flags */
+#define BPF_IOSCHED_INSERT_HEAD	0x01ULL	/* queue at the head of the FIFO */
+
+#define BPF_IOSCHED_NAME_LEN	128
+
+/**
+ * struct bpf_iosched_ops - operations of a BPF I/O scheduling policy
+ *
+ * A single policy serves every request queue that uses the "bpf"
+ * elevator.  The kernel keeps the requests on BPF_IOSCHED_NR_QUEUES FIFOs
+ * per request queue, the policy decides which FIFO a request goes to and
+ * which FIFO the next request is taken from.  None of the callbacks may
+ * sleep; @completed may be called from interrupt context.
+ *
+ * Without a policy, or after it made an error, all requests go to FIFO 0
+ * and FIFOs are drained lowest number first.
+ */
+struct bpf_iosched_ops {
+	/**
+	 * insert_request - a request is handed to the scheduler
+	 * @rq: request being inserted, also called again after a requeue
+	 * @flags: BPF_IOSCHED_INSERT_*
+	 *
+	 * Returns the FIFO, below BPF_IOSCHED_NR_QUEUES, to put @rq on.
+	 */
+	s32 (*insert_request)(struct request *rq, u64 flags);
+
+	/**
+	 * dispatch_request - a hardware queue of @q wants the next request
+	 * @q: request queue to dispatch from
+	 * @nonempty: bit N is set if FIFO N holds requests
+	 *
+	 * Returns a FIFO set in @nonempty, whose oldest request is sent to
+	 * the driver, or BPF_IOSCHED_DEFER to keep all requests for now.
+	 * Deferred queues are run again within a few milliseconds.
+	 */
+	s32 (*dispatch_request)(struct request_queue *q, u32 nonempty);
+
+	/**
+	 * completed - a request inserted through @insert_request is done
+	 * @rq: request being freed
+	 * @queue: FIFO @rq was last put on
+	 *
+	 * Also called for requests merged into another one.
+	 */
+	void (*completed)(struct request *rq, u32 queue);
+
+	/**
+	 * init - the policy is being loaded
+	 *
+	 * An error aborts the load.  May sleep.
+	 */
+	s32 (*init)(void);
+
+	/**
+	 * exit - the policy was unloaded or disabled after an error
+	 *
+	 * May sleep.
+	 */
+	void (*exit)(void);
+
+	/* name of the policy, for diagnostics */
+	char name[BPF_IOSCHED_NAME_LEN];
+};
+
+#endif /* CONFIG_MQ_IOSCHED_BPF */
+
+#endif /* _LINUX_BPF_IOSCHED_H */
@@ -207,6 +207,7 @@ struct bpf_func_state {
 	struct bpf_reference_state *refs;
 	int allocated_stack;
 	bool in_callback_fn;
+	bool in_async_callback_fn;
 	struct bpf_stack_state *stack;
 };
 
@@ -299,6 +300,12 @@ struct bpf_verifier_state_list {
 	struct bpf_verifier_state state;
 	struct bpf_verifier_state_list *next;
 	int miss_cnt, hit_cnt;
+	/* summary of the innermost frame, valid once the liveness of
+	 * 'state' is final, to reject non-equivalent states cheaply
+	 */
+	bool summary_valid;
+	u32 stack_used;
+	u64 reg_types, reg_types_mask;
 };
 
 /* Possible states for alu_state member. */
@@ -390,6 +397,13 @@ struct bpf_subprog_info {
 /* single container for all structs
  * one verifier_env per bpf_check() call
  */
+/* Maximum number of register states that can exist at once */
+#define BPF_ID_MAP_SIZE (MAX_BPF_REG + MAX_BPF_STACK / BPF_REG_SIZE)
+struct bpf_id_pair {
+	u32 old;
+	u32 cur;
+};
+
 struct bpf_verifier_env {
 	u32 insn_idx;
 	u32 prev_insn_idx;
@@ -418,6 +432,7 @@ struct bpf_verifier_env {
 	const struct bpf_line_info *prev_linfo;
 	struct bpf_verifier_log log;
 	struct bpf_subprog_info subprog_info[BPF_MAX_SUBPROGS + 1];
+	struct bpf_id_pair idmap_scratch[BPF_ID_MAP_SIZE];
 	struct {
 		int *insn_state;
 		int *insn_stack;
@@ -442,6 +457,12 @@ struct bpf_verifier_env {
 	u32 peak_states;
 	/* longest register parentage chain walked for liveness marking */
 	u32 longest_mark_read_walk;
+	/* explored states compared against the current one, the part of
+	 * them rejected by their summary alone, and the pruning hits
+	 */
+	u32 states_compared;
+	u32 states_filtered;
+	u32 states_pruned;
 };
 
 __printf(2, 0) void bpf_verifier_vlog(struct bpf_verifier_log *log,
@@ -13,4 +13,8 @@ extern __u16 crc_t10dif_generic(__u16 crc, const unsigned char *buffer,
 extern __u16 crc_t10dif(unsigned char const *, size_t);
 extern __u16 crc_t10dif_update(__u16 crc, unsigned char const *, size_t);
 
+/* Direct-call implementations selected through CONFIG_CRC_T10DIF_ARCH */
+u16 crc_t10dif_arch(u16 crc, const u8 *p, size_t len);
+bool crc_t10dif_arch_optimized(void);
+
 #endif
@@ -7,6 +7,10 @@
 extern u32 crc32c(u32 crc, const void *address, unsigned int length);
 extern const char *crc32c_impl(void);
 
+/* Direct-call implementations selected through CONFIG_CRC32C_ARCH */
+u32 crc32c_arch(u32 crc, const void *address, unsigned int length);
+const char *crc32c_arch_impl(void);
+
 /* This macro exists for backwards-compatibility. */
 #define crc32c_le crc32c
 
@@ -70,6 +70,7 @@ struct dentry_stat_t {
 	long dummy;		/* Reserved for future use */
 };
 extern struct dentry_stat_t dentry_stat;
+extern unsigned long negative_dentry_limit;
 
 /*
  * Try to keep struct dentry aligned on 64 byte cachelines (this will
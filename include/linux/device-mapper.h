@@ -279,6 +279,14 @@ struct target_type {
 #define DM_TARGET_PASSES_CRYPTO		0x00000100
 #define dm_target_passes_crypto(type) ((type)->features & DM_TARGET_PASSES_CRYPTO)
 
+/*
+ * A target whose map method only redirects a bio to another device and
+ * sector and never calls dm_accept_partial_bio().  Bios that fit in a
+ * single such target are mapped without going through DM's bio splitting.
+ */
+#define DM_TARGET_SIMPLE_REMAP		0x00000400
+#define dm_target_is_simple_remap(type) ((type)->features & DM_TARGET_SIMPLE_REMAP)
+
 #ifdef CONFIG_BLK_DEV_ZONED
 #define DM_TARGET_MIXED_ZONED_MODEL	0x00000200
 #define dm_target_supports_mixed_zoned_model(type) \
@@ -277,6 +277,12 @@ extern bool initcall_debug;
  */
 #define pure_initcall(fn)		__define_initcall(fn, 0)
 
+/*
+ * Within a level, the _async variants run after all plain initcalls of
+ * the level and before its _sync ones.  With "initcall_async" on the
+ * command line they run concurrently with each other, so they may only
+ * depend on earlier levels and on the plain initcalls of their own level.
+ */
 #define core_initcall(fn)		__define_initcall(fn, 1)
 #define core_initcall_sync(fn)		__define_initcall(fn, 1s)
 #define postcore_initcall(fn)		__define_initcall(fn, 2)
@@ -284,13 +290,17 @@ extern bool initcall_debug;
 #define arch_initcall(fn)		__define_initcall(fn, 3)
 #define arch_initcall_sync(fn)		__define_initcall(fn, 3s)
 #define subsys_initcall(fn)		__define_initcall(fn, 4)
+#define subsys_initcall_async(fn)	__define_initcall(fn, 4a)
 #define subsys_initcall_sync(fn)	__define_initcall(fn, 4s)
 #define fs_initcall(fn)			__define_initcall(fn, 5)
+#define fs_initcall_async(fn)		__define_initcall(fn, 5a)
 #define fs_initcall_sync(fn)		__define_initcall(fn, 5s)
 #define rootfs_initcall(fn)		__define_initcall(fn, rootfs)
 #define device_initcall(fn)		__define_initcall(fn, 6)
+#define device_initcall_async(fn)	__define_initcall(fn, 6a)
 #define device_initcall_sync(fn)	__define_initcall(fn, 6s)
 #define late_initcall(fn)		__define_initcall(fn, 7)
+#define late_initcall_async(fn)		__define_initcall(fn, 7a)
 #define late_initcall_sync(fn)		__define_initcall(fn, 7s)
 
 #define __initcall(fn) device_initcall(fn)
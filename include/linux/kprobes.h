@@ -397,6 +397,13 @@ void unregister_kretprobe(struct kretprobe *rp);
 int register_kretprobes(struct kretprobe **rps, int num);
 void unregister_kretprobes(struct kretprobe **rps, int num);
 
+#ifdef CONFIG_KRETPROBES
+int kretprobe_init_instances(struct kretprobe *rp);
+void kretprobe_free_instances(struct kretprobe *rp);
+struct kretprobe_instance *kretprobe_hook_return(struct kretprobe *rp,
+						 struct pt_regs *regs);
+#endif
+
 void kprobe_flush_task(struct task_struct *tk);
 
 void kprobe_free_init_mem(void);
@@ -17,6 +17,8 @@
  *               to allow userspace to harvest all the dirty pages
  * @dirty_gfns:  the array to keep the dirty gfns
  * @index:       index of this dirty ring
+ * @reset_lock:  serializes resets of this ring, which can run concurrently
+ *               with the vcpu pushing to it
  */
 struct kvm_dirty_ring {
 	u32 dirty_index;
@@ -25,6 +27,7 @@ struct kvm_dirty_ring {
 	u32 soft_limit;
 	struct kvm_dirty_gfn *dirty_gfns;
 	int index;
+	struct mutex reset_lock;
 };
 
 #if (KVM_DIRTY_LOG_PAGE_OFFSET == 0)
@@ -54,9 +57,10 @@ static inline int kvm_dirty_ring_reset(struct kvm *kvm,
 	return 0;
 }
 
-static inline void kvm_dirty_ring_push(struct kvm_dirty_ring *ring,
+static inline bool kvm_dirty_ring_push(struct kvm_dirty_ring *ring,
 				       u32 slot, u64 offset)
 {
+	return false;
 }
 
 static inline struct page *kvm_dirty_ring_get_page(struct kvm_dirty_ring *ring,
@@ -81,16 +85,16 @@ int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, int index, u32 size);
 struct kvm_dirty_ring *kvm_dirty_ring_get(struct kvm *kvm);
 
 /*
- * called with kvm->slots_lock held, returns the number of
+ * called with kvm->srcu held for read, returns the number of
  * processed pages.
  */
 int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring);
 
 /*
- * returns =0: successfully pushed
- *         <0: unable to push, need to wait
+ * returns true: successfully pushed
+ *         false: the ring is full, the page needs to be logged elsewhere
  */
-void kvm_dirty_ring_push(struct kvm_dirty_ring *ring, u32 slot, u64 offset);
+bool kvm_dirty_ring_push(struct kvm_dirty_ring *ring, u32 slot, u64 offset);
 
 /* for use in vm_operations_struct */
 struct page *kvm_dirty_ring_get_page(struct kvm_dirty_ring *ring, u32 offset);
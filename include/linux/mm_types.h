@@ -9,6 +9,7 @@
 #include <linux/spinlock.h>
 #include <linux/rbtree.h>
 #include <linux/rwsem.h>
+#include <linux/mutex.h>
 #include <linux/completion.h>
 #include <linux/cpumask.h>
 #include <linux/uprobes.h>
@@ -96,6 +97,16 @@ struct page {
 			unsigned long private;
 		};
 		struct {	/* page_pool used by netstack */
+			/**
+			 * @pp_magic: magic value to avoid recycling non
+			 * page_pool allocated pages.  Aliases lru.next,
+			 * so bit 0 (compound_head) and bit 1 (pfmemalloc)
+			 * must be preserved.
+			 */
+			unsigned long pp_magic;
+			/** @pp: page_pool the page was allocated from. */
+			struct page_pool *pp;
+			unsigned long _pp_mapping_pad;
 			/**
 			 * @dma_addr: might require a 64-bit value on
 			 * 32-bit architectures.
@@ -295,6 +306,22 @@ struct vm_userfaultfd_ctx {
 struct vm_userfaultfd_ctx {};
 #endif /* CONFIG_USERFAULTFD */
 
+#ifdef CONFIG_NUMA_BALANCING
+/* Per-VMA state of the NUMA balancing scanner, see task_numa_work() */
+struct vma_numab_state {
+	/* jiffies before which the VMA is not scanned */
+	unsigned long next_scan;
+	/* jiffies at which access_pids[0] ages into access_pids[1] */
+	unsigned long next_pid_reset;
+	/* bit (pid % BITS_PER_LONG) is set for tasks faulting in the VMA */
+	unsigned long access_pids[2];
+	/* ms between scans, grows while scans migrate nothing */
+	unsigned int scan_delay;
+	/* a hinting fault migrated a page since the last full scan */
+	bool migrated;
+};
+#endif
+
 /*
  * This struct describes a virtual memory area. There is one of these
  * per VM-area/task. A VM area is any part of the process virtual memory
@@ -368,8 +395,22 @@ struct vm_area_struct {
 #endif
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
+#endif
+#ifdef CONFIG_NUMA_BALANCING
+	struct vma_numab_state numab_state;
 #endif
 	struct vm_userfaultfd_ctx vm_userfaultfd_ctx;
+#ifdef CONFIG_PER_VMA_LOCK
+	/*
+	 * Lets page faults run without mmap_lock, see lock_vma_under_rcu().
+	 * The vma is write-locked while vm_lock_seq == vm_mm->mm_lock_seq;
+	 * vm_lock itself is only held for write while vm_lock_seq is updated.
+	 */
+	int vm_lock_seq;
+	bool vm_detached;		/* No longer in the mm's vma tree */
+	struct rw_semaphore vm_lock;
+	struct rcu_head vm_rcu;		/* Lockless lookups may still see us */
+#endif
 } __randomize_layout;
 
 struct core_thread {
@@ -466,6 +507,13 @@ struct mm_struct {
 		 * cacheline.
 		 */
 		struct rw_semaphore mmap_lock;
+#ifdef CONFIG_PER_VMA_LOCK
+		/*
+		 * Bumped on every mmap_lock write unlock/downgrade, which
+		 * releases all vmas write-locked in that critical section.
+		 */
+		int mm_lock_seq;
+#endif
 
 		struct list_head mmlist; /* List of maybe swapped mm's.	These
 					  * are globally strung together off
@@ -574,12 +622,32 @@ struct mm_struct {
 
 #ifdef CONFIG_IOMMU_SUPPORT
 		u32 pasid;
+#endif
+#ifdef CONFIG_FUTEX
+		/* Hash of the private futexes, set once shared by tasks */
+		struct futex_private_hash *futex_phash;
+		/* Its size: -1 default, 0 use the global hash */
+		int futex_phash_slots;
+#endif
+#ifdef CONFIG_MEMBARRIER
+		/*
+		 * Serializes private expedited membarrier rounds, so that
+		 * concurrent callers can share one.  Each command counts its
+		 * rounds in @membarrier_seq, the low bit is set while one runs.
+		 */
+		struct mutex membarrier_mutex;
+		unsigned long membarrier_seq[3];
+#endif
+#ifdef CONFIG_SCHED_MM_CID
+		/* Protects the concurrency ID bitmap, see mm_cidmask() */
+		raw_spinlock_t cid_lock;
 #endif
 	} __randomize_layout;
 
 	/*
 	 * The mm_cpumask needs to be at the end of mm_struct, because it
-	 * is dynamically sized based on nr_cpu_ids.
+	 * is dynamically sized based on nr_cpu_ids.  With
+	 * CONFIG_SCHED_MM_CID it is followed by the mm_cidmask.
 	 */
 	unsigned long cpu_bitmap[];
 };
@@ -601,6 +669,39 @@ static inline cpumask_t *mm_cpumask(struct mm_struct *mm)
 	return (struct cpumask *)&mm->cpu_bitmap;
 }
 
+#ifdef CONFIG_SCHED_MM_CID
+/*
+ * Concurrency IDs in use by the threads of @mm, one per thread currently
+ * running, so that they stay below the number of threads running at once.
+ */
+static inline cpumask_t *mm_cidmask(struct mm_struct *mm)
+{
+	unsigned long cid_bitmap = (unsigned long)mm;
+
+	cid_bitmap += offsetof(struct mm_struct, cpu_bitmap);
+	/* Skip cpu_bitmap */
+	cid_bitmap += cpumask_size();
+	return (struct cpumask *)cid_bitmap;
+}
+
+static inline void mm_init_cid(struct mm_struct *mm)
+{
+	raw_spin_lock_init(&mm->cid_lock);
+	cpumask_clear(mm_cidmask(mm));
+}
+
+static inline unsigned int mm_cid_size(void)
+{
+	return cpumask_size();
+}
+#else /* CONFIG_SCHED_MM_CID */
+static inline void mm_init_cid(struct mm_struct *mm) { }
+static inline unsigned int mm_cid_size(void)
+{
+	return 0;
+}
+#endif /* CONFIG_SCHED_MM_CID */
+
 struct mmu_gather;
 extern void tlb_gather_mmu(struct mmu_gather *tlb, struct mm_struct *mm);
 extern void tlb_gather_mmu_fullmm(struct mmu_gather *tlb, struct mm_struct *mm);
@@ -69,6 +69,7 @@ struct udp_tunnel_nic_info;
 struct udp_tunnel_nic;
 struct bpf_prog;
 struct xdp_buff;
+struct xdp_metadata_ops;
 
 void synchronize_net(void);
 void netdev_set_default_ethtool_ops(struct net_device *dev,
@@ -316,7 +317,30 @@ struct gro_list {
  * size of gro hash buckets, must less than bit number of
  * napi_struct::gro_bitmask
  */
-#define GRO_HASH_BUCKETS	8
+#define GRO_HASH_BUCKETS	32
+
+struct napi_gro_stats {
+	unsigned long		merged;		/* skbs merged into a held packet */
+	unsigned long		held;		/* skbs starting a new GRO flow */
+	unsigned long		flushed;	/* GRO packets handed to the stack */
+	unsigned long		evicted;	/* of which pushed out by a full bucket */
+};
+
+/* Placement of threaded NAPI kthreads, see dev_set_threaded_policy() */
+enum napi_threaded_policy {
+	NAPI_THREADED_FLOAT,	/* anywhere in the thread's cpuset */
+	NAPI_THREADED_IRQ,	/* the cpu that scheduled the napi */
+	NAPI_THREADED_SOCKET,	/* the cpu consuming the napi's sockets */
+	__NAPI_THREADED_MAX
+};
+
+struct napi_thread_stats {
+	unsigned long		polls;		/* poll rounds run by the thread */
+	unsigned long		packets;	/* work done by the thread */
+	unsigned long		time_squeeze;	/* rounds that used the whole budget */
+	unsigned long		to_softirq;	/* adaptive switches to softirq */
+	unsigned long		to_thread;	/* adaptive switches back to thread */
+};
 
 /*
  * Structure for NAPI scheduling similar to tasklet but with weighting
@@ -348,6 +372,16 @@ struct napi_struct {
 	struct hlist_node	napi_hash_node;
 	unsigned int		napi_id;
 	struct task_struct	*thread;
+	/* threaded mode placement and adaptive switching, see
+	 * napi_threaded_poll()
+	 */
+	int			sched_cpu;
+	int			consumer_cpu;
+	int			thread_cpu;
+	unsigned int		thread_idle;
+	unsigned int		thread_busy;
+	struct napi_thread_stats thread_stats;
+	struct napi_gro_stats	gro_stats;
 };
 
 enum {
@@ -500,6 +534,9 @@ static inline bool napi_complete(struct napi_struct *n)
 }
 
 int dev_set_threaded(struct net_device *dev, bool threaded);
+int dev_set_threaded_policy(struct net_device *dev,
+			    enum napi_threaded_policy policy);
+void dev_set_threaded_adaptive(struct net_device *dev, bool adaptive);
 
 /**
  *	napi_disable - prevent NAPI from scheduling
@@ -1885,6 +1922,14 @@ enum netdev_ml_priv_type {
  *	@gso_max_size:	Maximum size of generic segmentation offload
  *	@gso_max_segs:	Maximum number of segments that can be passed to the
  *			NIC for GSO
+ *	@gso_ipv4_max_size:	Maximum size of generic segmentation offload
+ *				for IPv4
+ *	@tso_max_size:	Device (as in HW) limit on the max TSO request size,
+ *			bounds what @gso_max_size can be set to
+ *	@gro_max_size:	Maximum size of aggregated packet in generic
+ *			receive offload (GRO)
+ *	@gro_ipv4_max_size:	Maximum size of aggregated packet in generic
+ *				receive offload (GRO) for IPv4
  *
  *	@dcbnl_ops:	Data Center Bridging netlink ops
  *	@num_tc:	Number of traffic classes in the net device
@@ -1908,6 +1953,12 @@ enum netdev_ml_priv_type {
  *	@wol_enabled:	Wake-on-LAN is enabled
  *
  *	@threaded:	napi threaded mode is enabled
+ *	@threaded_policy:	cpu placement of the napi threads,
+ *				enum napi_threaded_policy
+ *	@threaded_adaptive:	let napi threads fall back to softirq
+ *				processing at low load
+ *	@xdp_xmit_sg:	ndo_xdp_xmit can transmit multi-buffer xdp_frames
+ *	@xdp_metadata_ops:	Rx descriptor fields exposed to XDP programs
  *
  *	@net_notifier_list:	List of per-net netdev notifier block
  *				that follow this device when it is moved
@@ -2209,10 +2260,20 @@ struct net_device {
 	const struct rtnl_link_ops *rtnl_link_ops;
 
 	/* for setting kernel sock attribute on TCP connection setup */
-#define GSO_MAX_SIZE		65536
+#define GSO_LEGACY_MAX_SIZE	65536u
+/* Packets larger than GSO_LEGACY_MAX_SIZE (BIG TCP) carry an IPv6
+ * jumbo payload option, or an IPv4 tot_len of 0.
+ */
+#define GSO_MAX_SIZE		(8 * GSO_LEGACY_MAX_SIZE)
 	unsigned int		gso_max_size;
+	unsigned int		gso_ipv4_max_size;
+	unsigned int		tso_max_size;
 #define GSO_MAX_SEGS		65535
 	u16			gso_max_segs;
+#define GRO_LEGACY_MAX_SIZE	65536u
+#define GRO_MAX_SIZE		GSO_MAX_SIZE
+	unsigned int		gro_max_size;
+	unsigned int		gro_ipv4_max_size;
 
 #ifdef CONFIG_DCB
 	const struct dcbnl_rtnl_ops *dcbnl_ops;
@@ -2234,6 +2295,10 @@ struct net_device {
 	bool			proto_down;
 	unsigned		wol_enabled:1;
 	unsigned		threaded:1;
+	u8			threaded_policy;
+	bool			threaded_adaptive;
+	unsigned		xdp_xmit_sg:1;
+	const struct xdp_metadata_ops *xdp_metadata_ops;
 
 	struct list_head	net_notifier_list;
 
@@ -2525,7 +2590,7 @@ struct napi_gro_cb {
 	/* jiffies when first packet was created/queued */
 	unsigned long age;
 
-	/* Used in ipv6_gro_receive() and foo-over-udp */
+	/* Used in inet_gro_receive(), ipv6_gro_receive() and foo-over-udp */
 	u16	proto;
 
 	/* This is non-zero if the packet may be of the same flow. */
@@ -3354,6 +3419,12 @@ struct softnet_data {
 	struct sk_buff_head	input_pkt_queue;
 	struct napi_struct	backlog;
 
+	/* Another possibly contended cache line */
+	spinlock_t		defer_lock ____cacheline_aligned_in_smp;
+	int			defer_count;
+	int			defer_ipi_scheduled;
+	struct sk_buff		*defer_list;
+	call_single_data_t	defer_csd;
 };
 
 static inline void input_queue_head_incr(struct softnet_data *sd)
@@ -4124,6 +4195,7 @@ void dev_queue_xmit_nit(struct sk_buff *skb, struct net_device *dev);
 
 extern int		netdev_budget;
 extern unsigned int	netdev_budget_usecs;
+extern unsigned int	sysctl_skb_defer_max;
 
 /* Called by rtnetlink.c:rtnl_unlock() */
 void netdev_run_todo(void);
@@ -5061,7 +5133,53 @@ static inline bool netif_needs_gso(struct sk_buff *skb,
 static inline void netif_set_gso_max_size(struct net_device *dev,
 					  unsigned int size)
 {
-	dev->gso_max_size = size;
+	/* dev->gso_max_size is read locklessly from sk_setup_caps() */
+	WRITE_ONCE(dev->gso_max_size, size);
+	if (size <= GSO_LEGACY_MAX_SIZE)
+		WRITE_ONCE(dev->gso_ipv4_max_size, size);
+}
+
+static inline void netif_set_gso_ipv4_max_size(struct net_device *dev,
+					       unsigned int size)
+{
+	/* dev->gso_ipv4_max_size is read locklessly from sk_setup_caps() */
+	WRITE_ONCE(dev->gso_ipv4_max_size, size);
+}
+
+/**
+ * netif_set_tso_max_size() - set the max size of TSO frames supported
+ * @dev:	netdev to update
+ * @size:	max skb->len of a TSO frame
+ *
+ * Set the limit on the size of TSO super-frames the device can handle.
+ * Unless explicitly set the stack will assume the value of
+ * %GSO_LEGACY_MAX_SIZE.  Going above it is what lets the administrator
+ * enable BIG TCP on the device through IFLA_GSO_MAX_SIZE.
+ */
+static inline void netif_set_tso_max_size(struct net_device *dev,
+					  unsigned int size)
+{
+	dev->tso_max_size = min(GSO_MAX_SIZE, size);
+	if (size < READ_ONCE(dev->gso_max_size))
+		netif_set_gso_max_size(dev, size);
+	if (size < READ_ONCE(dev->gso_ipv4_max_size))
+		netif_set_gso_ipv4_max_size(dev, size);
+}
+
+static inline void netif_set_gro_max_size(struct net_device *dev,
+					  unsigned int size)
+{
+	/* This pairs with the READ_ONCE() in skb_gro_receive() */
+	WRITE_ONCE(dev->gro_max_size, size);
+	if (size <= GRO_LEGACY_MAX_SIZE)
+		WRITE_ONCE(dev->gro_ipv4_max_size, size);
+}
+
+static inline void netif_set_gro_ipv4_max_size(struct net_device *dev,
+					       unsigned int size)
+{
+	/* This pairs with the READ_ONCE() in skb_gro_receive() */
+	WRITE_ONCE(dev->gro_ipv4_max_size, size);
 }
 
 static inline void skb_gso_error_unwind(struct sk_buff *skb, __be16 protocol,
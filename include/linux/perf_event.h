@@ -763,6 +763,8 @@ struct perf_event {
 	perf_overflow_handler_t		orig_overflow_handler;
 	struct bpf_prog			*prog;
 #endif
+	/* samples counted per address range, see PERF_EVENT_IOC_ADDR_AGGR */
+	struct perf_addr_aggr __rcu	*addr_aggr;
 
 #ifdef CONFIG_EVENT_TRACING
 	struct trace_event_call		*tp_event;
@@ -774,6 +776,9 @@ struct perf_event {
 
 #ifdef CONFIG_CGROUP_PERF
 	struct perf_cgroup		*cgrp; /* cgroup event is attach to */
+	/* counts per cgroup, see PERF_EVENT_IOC_SET_CGROUP_TABLE */
+	struct perf_cgrp_table __rcu	*cgrp_table;
+	struct list_head		cgrp_table_entry;
 #endif
 
 #ifdef CONFIG_SECURITY
@@ -237,6 +237,7 @@ void pipe_unlock(struct pipe_inode_info *);
 void pipe_double_lock(struct pipe_inode_info *, struct pipe_inode_info *);
 
 extern unsigned int pipe_max_size;
+extern unsigned int pipe_def_size;
 extern unsigned long pipe_user_pages_hard;
 extern unsigned long pipe_user_pages_soft;
 
@@ -267,6 +268,7 @@ bool pipe_is_unprivileged_user(void);
 int pipe_resize_ring(struct pipe_inode_info *pipe, unsigned int nr_slots);
 #endif
 long pipe_fcntl(struct file *, unsigned int, unsigned long arg);
+void pipe_grow_direct(struct pipe_inode_info *pipe, size_t len);
 struct pipe_inode_info *get_pipe_info(struct file *file, bool for_splice);
 
 int create_pipe_files(struct file **, int);
@@ -36,6 +36,7 @@ void psi_trigger_replace(void **trigger_ptr, struct psi_trigger *t);
 
 __poll_t psi_trigger_poll(void **trigger_ptr, struct file *file,
 			poll_table *wait);
+void psi_trigger_show(struct seq_file *m, void **trigger_ptr);
 #endif
 
 #else /* CONFIG_PSI */
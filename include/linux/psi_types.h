@@ -109,7 +109,7 @@ struct psi_trigger {
 	/* User-spacified threshold in ns */
 	u64 threshold;
 
-	/* List node inside triggers list */
+	/* RCU-protected list node inside triggers list */
 	struct list_head node;
 
 	/* Backpointer needed during trigger destruction */
@@ -130,6 +130,10 @@ struct psi_trigger {
 	 */
 	u64 last_event_time;
 
+	/* Number of events generated and of window updates done */
+	u64 nr_events;
+	u64 nr_updates;
+
 	/* Refcounting to prevent premature destruction */
 	struct kref refcount;
 };
@@ -153,13 +157,12 @@ struct psi_group {
 	u64 total[NR_PSI_AGGREGATORS][NR_PSI_STATES - 1];
 	unsigned long avg[NR_PSI_STATES - 1][3];
 
-	/* Monitor work control */
-	struct task_struct __rcu *poll_task;
+	/* Monitor work control, run by the shared psimon worker */
+	bool poll_enabled;
 	struct timer_list poll_timer;
-	wait_queue_head_t poll_wait;
-	atomic_t poll_wakeup;
+	struct kthread_work poll_work;
 
-	/* Protects data used by the monitor */
+	/* Serializes trigger creation and destruction */
 	struct mutex trigger_lock;
 
 	/* Configured polling triggers */
@@ -66,6 +66,18 @@ struct rhashtable_params {
 	rht_obj_cmpfn_t		obj_cmpfn;
 };
 
+/**
+ * struct rhashtable_stats - Resize statistics of a hash table
+ * @rehashes: Number of completed rehashes
+ * @max_chain: Longest chain moved by the last rehash
+ * @rehash_ns: Duration of the last rehash in nanoseconds
+ */
+struct rhashtable_stats {
+	unsigned int		rehashes;
+	unsigned int		max_chain;
+	u64			rehash_ns;
+};
+
 /**
  * struct rhashtable - Hash table handle
  * @tbl: Bucket table
@@ -77,6 +89,7 @@ struct rhashtable_params {
  * @mutex: Mutex to protect current/future table swapping
  * @lock: Spin lock to protect walker list
  * @nelems: Number of elements in table
+ * @stats: Resize statistics, protected by @mutex
  */
 struct rhashtable {
 	struct bucket_table __rcu	*tbl;
@@ -88,6 +101,7 @@ struct rhashtable {
 	struct mutex                    mutex;
 	spinlock_t			lock;
 	atomic_t			nelems;
+	struct rhashtable_stats		stats;
 };
 
 /**
@@ -9,6 +9,7 @@
  */
 
 #define SCHED_CPUFREQ_IOWAIT	(1U << 0)
+#define SCHED_CPUFREQ_UCLAMP	(1U << 1)	/* uclamp_min boosted wakeup */
 
 #ifdef CONFIG_CPU_FREQ
 struct cpufreq_policy;
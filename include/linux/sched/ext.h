@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_SCHED_EXT_H
+#define _LINUX_SCHED_EXT_H
+
+/*
+ * Interface of the extensible scheduling class, whose policy is supplied
+ * by a BPF struct_ops implementing struct sched_ext_ops.
+ */
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/time64.h>
+
+#ifdef CONFIG_SCHED_CLASS_EXT
+
+struct task_struct;
+struct scx_dispatch_q;
+
+/* Dispatch queue ids for scx_bpf_dispatch() */
+#define SCX_DSQ_GLOBAL		0ULL	/* shared by all CPUs */
+#define SCX_DSQ_LOCAL		1ULL	/* the CPU the task is enqueued on */
+
+/* Default time slice, also used when the BPF scheduler passes 0 */
+#define SCX_SLICE_DFL		(20 * NSEC_PER_MSEC)
+
+#define SCX_OPS_NAME_LEN	128
+
+/* enq_flags */
+#define SCX_ENQ_WAKEUP		0x01ULL	/* task just woke up */
+#define SCX_ENQ_HEAD		0x10ULL	/* queue at the head of the DSQ */
+
+/* deq_flags */
+#define SCX_DEQ_SLEEP		0x01ULL	/* task is going to sleep */
+
+/* sched_ext_entity::flags */
+enum scx_ent_flags {
+	SCX_TASK_QUEUED		= 1 << 0, /* on the class' runqueue */
+	SCX_TASK_OPS_ENQ	= 1 << 1, /* inside ops.enqueue() */
+	SCX_TASK_ENQ_LOCAL	= 1 << 2, /* moved by the core, skip ops */
+};
+
+/**
+ * struct sched_ext_entity - per-task state of the extensible class
+ * @dsq: dispatch queue the task is on, NULL while running or held
+ * @dsq_node: entry on @dsq
+ * @flags: SCX_TASK_* flags, protected by the task's rq lock
+ * @holding_cpu: CPU that took the task off the global DSQ to migrate it
+ * @slice: remaining time slice in ns
+ */
+struct sched_ext_entity {
+	struct scx_dispatch_q	*dsq;
+	struct list_head	dsq_node;
+	u32			flags;
+	s32			holding_cpu;
+	u64			slice;
+};
+
+/**
+ * struct sched_ext_ops - operations of a BPF scheduler
+ *
+ * All callbacks but @init and @exit are invoked with the rq lock of the
+ * CPU the operation applies to held and must not sleep.  Every callback
+ * is optional; a BPF scheduler that implements none of them behaves like
+ * a global FIFO.
+ */
+struct sched_ext_ops {
+	/**
+	 * select_cpu - pick the CPU a waking task is enqueued on
+	 * @p: task being woken up
+	 * @prev_cpu: CPU @p last ran on
+	 * @wake_flags: WF_* flags of the wakeup
+	 *
+	 * CPUs outside of @p's allowed mask are rejected by the core.
+	 */
+	s32 (*select_cpu)(struct task_struct *p, s32 prev_cpu, u64 wake_flags);
+
+	/**
+	 * enqueue - a task became runnable
+	 * @p: task being enqueued
+	 * @enq_flags: SCX_ENQ_*
+	 *
+	 * Should place @p on a dispatch queue with scx_bpf_dispatch(); tasks
+	 * that are not dispatched go to the tail of the global DSQ.
+	 */
+	void (*enqueue)(struct task_struct *p, u64 enq_flags);
+
+	/**
+	 * dequeue - a task is no longer runnable on its CPU
+	 * @p: task being dequeued
+	 * @deq_flags: SCX_DEQ_*
+	 */
+	void (*dequeue)(struct task_struct *p, u64 deq_flags);
+
+	/**
+	 * dispatch - a CPU ran out of tasks on its local DSQ
+	 * @cpu: CPU looking for work
+	 * @prev: task that was running, may not belong to this class
+	 *
+	 * Called before @cpu takes the first eligible task off the global
+	 * DSQ.
+	 */
+	void (*dispatch)(s32 cpu, struct task_struct *prev);
+
+	/**
+	 * running - a task starts running on its CPU
+	 * @p: task picked
+	 */
+	void (*running)(struct task_struct *p);
+
+	/**
+	 * init - the BPF scheduler is being loaded
+	 *
+	 * An error aborts the load.  May sleep.
+	 */
+	s32 (*init)(void);
+
+	/**
+	 * exit - the BPF scheduler was unloaded or disabled after an error
+	 *
+	 * May sleep.
+	 */
+	void (*exit)(void);
+
+	/* name of the BPF scheduler, for diagnostics */
+	char name[SCX_OPS_NAME_LEN];
+};
+
+#endif /* CONFIG_SCHED_CLASS_EXT */
+
+#endif /* _LINUX_SCHED_EXT_H */
@@ -106,6 +106,12 @@ struct sk_psock {
 	struct sk_psock_work_state	work_state;
 	struct work_struct		work;
 	struct rcu_work			rwork;
+	/* skbs redirected to this psock: delivered from the redirecting
+	 * context, passed through the backlog, or dropped
+	 */
+	atomic_long_t			redir_direct;
+	atomic_long_t			redir_backlog;
+	atomic_long_t			redir_drops;
 };
 
 int sk_msg_alloc(struct sock *sk, struct sk_msg *msg, int len,
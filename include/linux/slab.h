@@ -413,6 +413,16 @@ static __always_inline void kfree_bulk(size_t size, void **p)
 	kmem_cache_free_bulk(NULL, size, p);
 }
 
+#ifdef CONFIG_SLUB
+int kmem_cache_setup_percpu_array(struct kmem_cache *s, unsigned int count);
+#else
+static inline int kmem_cache_setup_percpu_array(struct kmem_cache *s,
+						unsigned int count)
+{
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_NUMA
 void *__kmalloc_node(size_t size, gfp_t flags, int node) __assume_kmalloc_alignment __malloc;
 void *kmem_cache_alloc_node(struct kmem_cache *, gfp_t flags, int node) __assume_slab_alignment __malloc;
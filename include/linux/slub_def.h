@@ -10,6 +10,7 @@
 #include <linux/kfence.h>
 #include <linux/kobject.h>
 #include <linux/reciprocal_div.h>
+#include <linux/local_lock.h>
 
 enum stat_item {
 	ALLOC_FASTPATH,		/* Allocation from cpu slab */
@@ -38,6 +39,10 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	ALLOC_PCA,		/* Allocation from percpu array */
+	FREE_PCA,		/* Free to percpu array */
+	PCA_REFILL,		/* Refilling empty percpu array */
+	PCA_FLUSH,		/* Flushing full percpu array */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
@@ -69,6 +74,19 @@ struct kmem_cache_cpu {
 #define slub_percpu_partial_read_once(c)	NULL
 #endif // CONFIG_SLUB_CPU_PARTIAL
 
+/*
+ * Optional per cpu array of free objects in front of the cpu slab, see
+ * kmem_cache_setup_percpu_array().  Objects are taken and returned LIFO
+ * and moved to and from the slabs @batch at a time.
+ */
+struct slub_percpu_array {
+	local_lock_t lock;
+	unsigned int count;	/* Capacity of objects[] */
+	unsigned int batch;	/* Objects per refill or flush */
+	unsigned int used;	/* Objects currently cached */
+	void *objects[];
+};
+
 /*
  * Word size structure that can be atomically updated or read and that
  * contains both the order and the number of objects that a slab of the
@@ -83,6 +101,7 @@ struct kmem_cache_order_objects {
  */
 struct kmem_cache {
 	struct kmem_cache_cpu __percpu *cpu_slab;
+	struct slub_percpu_array __percpu *cpu_array;
 	/* Used for retrieving partial slabs, etc. */
 	slab_flags_t flags;
 	unsigned long min_partial;
@@ -115,6 +115,8 @@ struct rpc_rqst {
 	 * Partial send handling
 	 */
 	u32			rq_bytes_sent;	/* Bytes we have sent */
+	u32			rq_inflight_bytes; /* accounted in
+						      xprt->inflight_bytes */
 
 	ktime_t			rq_xtime;	/* transmit time stamp */
 	int			rq_ntrans;
@@ -240,6 +242,8 @@ struct rpc_xprt {
 	 * Send stuff
 	 */
 	atomic_long_t		queuelen;
+	atomic_long_t		inflight_bytes;	/* call and reply bytes of
+						   queued requests */
 	spinlock_t		transport_lock;	/* lock transport info */
 	spinlock_t		reserve_lock;	/* lock slot table */
 	spinlock_t		queue_lock;	/* send/receive queue lock */
@@ -74,6 +74,16 @@ struct tcp_sack_block {
 	u32	end_seq;
 };
 
+/* ACKs folded together for tcp_congestion_ops::ack_batch() */
+struct tcp_ack_batch {
+	u32	acks;		/* ACKs in the batch, 0 when empty */
+	u32	ack;		/* last cumulative ACK raising cwnd */
+	u32	pkts_acked;	/* packets acked or SACKed */
+	u32	acked_sacked;	/* packets allowed to raise cwnd */
+	s32	rtt_us;		/* smallest RTT sample, -1 if none */
+	u32	in_flight;	/* packets in flight before the last ACK */
+};
+
 /*These are used to set the sack_ok field in struct tcp_options_received */
 #define TCP_SACK_SEEN     (1 << 0)   /*1 = peer is SACK capable, */
 #define TCP_DSACK_SEEN    (1 << 2)   /*1 = DSACK was received from peer*/
@@ -300,6 +310,7 @@ struct tcp_sock {
 	u64	delivered_mstamp; /* time we reached "delivered" */
 	u32	rate_delivered;    /* saved rate sample: packets delivered */
 	u32	rate_interval_us;  /* saved rate sample: time elapsed */
+	struct tcp_ack_batch ack_batch; /* pending input of ca ack_batch() */
 
  	u32	rcv_wnd;	/* Current receiver window		*/
 	u32	write_seq;	/* Tail(+1) of data held in tcp send buffer */
@@ -381,6 +392,7 @@ struct tcp_sock {
 		u32	seq;
 		u64	time;
 	} rcvq_space;
+	u32	rcvbuf_saved;	/* bytes autotuning took back from sk_rcvbuf */
 
 /* TCP-specific MTU probe information. */
 	struct {
@@ -728,6 +728,18 @@ static inline int bpf_get_perf_event_info(const struct perf_event *event,
 }
 #endif
 
+union bpf_attr;
+
+#ifdef CONFIG_FPROBE
+int bpf_kprobe_multi_link_attach(const union bpf_attr *attr, struct bpf_prog *prog);
+#else
+static inline int
+bpf_kprobe_multi_link_attach(const union bpf_attr *attr, struct bpf_prog *prog)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 enum {
 	FILTER_OTHER = 0,
 	FILTER_STATIC_STRING,
@@ -91,6 +91,18 @@ struct udp_sock {
 
 	/* This field is dirtied by udp_recvmsg() */
 	int		forward_deficit;
+
+	/* per-CPU receive queues, set once by UDP_PERCPU_RXQ */
+	struct udp_rxq __percpu	*rxq;
+};
+
+/* Packets queued by one CPU, along with the receive memory that CPU has
+ * already charged to the socket but not used yet.  Both are protected by
+ * queue.lock.
+ */
+struct udp_rxq {
+	struct sk_buff_head	queue;
+	int			reserve;
 };
 
 #define UDP_MAX_SEGMENTS	(1 << 6UL)
@@ -45,6 +45,13 @@ struct uprobe_consumer {
 	struct uprobe_consumer *next;
 };
 
+/* One probe of uprobe_register_batch() and uprobe_unregister_batch() */
+struct uprobe_batch_entry {
+	loff_t			offset;
+	loff_t			ref_ctr_offset;
+	struct uprobe_consumer	*uc;
+};
+
 #ifdef CONFIG_UPROBES
 #include <asm/uprobes.h>
 
@@ -114,6 +121,8 @@ extern int uprobe_register(struct inode *inode, loff_t offset, struct uprobe_con
 extern int uprobe_register_refctr(struct inode *inode, loff_t offset, loff_t ref_ctr_offset, struct uprobe_consumer *uc);
 extern int uprobe_apply(struct inode *inode, loff_t offset, struct uprobe_consumer *uc, bool);
 extern void uprobe_unregister(struct inode *inode, loff_t offset, struct uprobe_consumer *uc);
+extern int uprobe_register_batch(struct inode *inode, struct uprobe_batch_entry *probes, int cnt);
+extern void uprobe_unregister_batch(struct inode *inode, struct uprobe_batch_entry *probes, int cnt);
 extern int uprobe_mmap(struct vm_area_struct *vma);
 extern void uprobe_munmap(struct vm_area_struct *vma, unsigned long start, unsigned long end);
 extern void uprobe_start_dup_mmap(void);
@@ -166,6 +175,15 @@ static inline void
 uprobe_unregister(struct inode *inode, loff_t offset, struct uprobe_consumer *uc)
 {
 }
+static inline int
+uprobe_register_batch(struct inode *inode, struct uprobe_batch_entry *probes, int cnt)
+{
+	return -ENOSYS;
+}
+static inline void
+uprobe_unregister_batch(struct inode *inode, struct uprobe_batch_entry *probes, int cnt)
+{
+}
 static inline int uprobe_mmap(struct vm_area_struct *vma)
 {
 	return 0;
@@ -117,6 +117,10 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		NR_TLB_LOCAL_FLUSH_ALL,
 		NR_TLB_LOCAL_FLUSH_ONE,
 #endif /* CONFIG_DEBUG_TLBFLUSH */
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+		TLB_DEFERRED_UNMAP,	/* pte cleared, flush left to the batch */
+		TLB_BATCHED_FLUSH,	/* batched flush rounds sent */
+#endif
 #ifdef CONFIG_DEBUG_VM_VMACACHE
 		VMACACHE_FIND_CALLS,
 		VMACACHE_FIND_HITS,
@@ -128,6 +132,11 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #ifdef CONFIG_X86
 		DIRECT_MAP_LEVEL2_SPLIT,
 		DIRECT_MAP_LEVEL3_SPLIT,
+#endif
+#ifdef CONFIG_PER_VMA_LOCK
+		VMA_LOCK_SUCCESS,	/* fault handled without mmap_lock */
+		VMA_LOCK_ABORT,		/* vma lock not taken, used mmap_lock */
+		VMA_LOCK_RETRY,		/* fault retried under mmap_lock */
 #endif
 		NR_VM_EVENT_ITEMS
 };
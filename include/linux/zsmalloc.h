@@ -36,6 +36,8 @@ enum zs_mapmode {
 struct zs_pool_stats {
 	/* How many pages were migrated (freed) */
 	atomic_long_t pages_compacted;
+	/* How often compaction backed off for a waiting zs_malloc/zs_free */
+	atomic_long_t compact_stalls;
 };
 
 struct zs_pool;
@@ -126,6 +126,26 @@ static inline void skb_mark_napi_id(struct sk_buff *skb,
 #endif
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+DECLARE_STATIC_KEY_FALSE(napi_threaded_colocate_key);
+void napi_note_consumer(unsigned int napi_id);
+#endif
+
+/* used on the receive syscall side so that threaded napi with the
+ * NAPI_THREADED_SOCKET policy can follow the consuming cpu
+ */
+static inline void sk_napi_note_consumer(const struct sock *sk)
+{
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	if (static_branch_unlikely(&napi_threaded_colocate_key)) {
+		unsigned int napi_id = READ_ONCE(sk->sk_napi_id);
+
+		if (napi_id >= MIN_NAPI_ID)
+			napi_note_consumer(napi_id);
+	}
+#endif
+}
+
 /* used in the protocol hanlder to propagate the napi_id to the socket */
 static inline void sk_mark_napi_id(struct sock *sk, const struct sk_buff *skb)
 {
@@ -98,6 +98,12 @@ static inline struct net *ib_net(struct inet_bind_bucket *ib)
 #define inet_bind_bucket_for_each(tb, head) \
 	hlist_for_each_entry(tb, head, node)
 
+/* Lockless walk, buckets are SLAB_TYPESAFE_BY_RCU so anything read this way
+ * is only a hint that has to be confirmed under the bucket lock.
+ */
+#define inet_bind_bucket_for_each_rcu(tb, head) \
+	hlist_for_each_entry_rcu(tb, head, node)
+
 struct inet_bind_hashbucket {
 	spinlock_t		lock;
 	struct hlist_head	chain;
@@ -132,6 +138,10 @@ struct inet_hashinfo {
 	spinlock_t			*ehash_locks;
 	unsigned int			ehash_mask;
 	unsigned int			ehash_locks_mask;
+	/* Private ehash and listening_hash of a netns, the bind and lhash2
+	 * tables are still those of the global hashinfo it was copied from.
+	 */
+	bool				pernet;
 
 	/* Ok, let's try this, I give up, we do need a local binding
 	 * TCP hash as well as the others for fast bind/connect.
@@ -163,6 +173,16 @@ struct inet_hashinfo {
 #define inet_lhash2_for_each_icsk_rcu(__icsk, list) \
 	hlist_for_each_entry_rcu(__icsk, list, icsk_listen_portaddr_node)
 
+static inline struct inet_hashinfo *tcp_or_dccp_get_hashinfo(const struct sock *sk)
+{
+#if IS_ENABLED(CONFIG_IP_DCCP)
+	return sk->sk_prot->h.hashinfo ? :
+		sock_net(sk)->ipv4.tcp_death_row.hashinfo;
+#else
+	return sock_net(sk)->ipv4.tcp_death_row.hashinfo;
+#endif
+}
+
 static inline struct inet_listen_hashbucket *
 inet_lhash2_bucket(struct inet_hashinfo *h, u32 hash)
 {
@@ -197,6 +217,10 @@ static inline void inet_ehash_locks_free(struct inet_hashinfo *hashinfo)
 	hashinfo->ehash_locks = NULL;
 }
 
+struct inet_hashinfo *inet_pernet_hashinfo_alloc(struct inet_hashinfo *hashinfo,
+						 unsigned int ehash_entries);
+void inet_pernet_hashinfo_free(struct inet_hashinfo *hashinfo);
+
 static inline bool inet_sk_bound_dev_eq(struct net *net, int bound_dev_if,
 					int dif, int sdif)
 {
@@ -422,7 +446,10 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 			struct sock *sk, u32 port_offset,
 			int (*check_established)(struct inet_timewait_death_row *,
 						 struct sock *, __u16,
-						 struct inet_timewait_sock **));
+						 struct inet_timewait_sock **,
+						 bool rcu_lookup));
+
+void inet_port_search_stats(struct net *net, u32 probes, u32 collisions);
 
 int inet_hash_connect(struct inet_timewait_death_row *death_row,
 		      struct sock *sk);
@@ -13,6 +13,7 @@
 
 struct nf_flowtable;
 struct nf_flow_rule;
+struct nf_flow_offload_batch;
 struct flow_offload;
 enum flow_offload_tuple_dir;
 
@@ -68,6 +69,20 @@ enum nf_flowtable_flags {
 	NF_FLOWTABLE_COUNTER		= 0x2,	/* NFT_FLOWTABLE_COUNTER */
 };
 
+struct nf_flowtable_stat {
+	unsigned int	count;		/* flows currently in the table */
+	unsigned int	added;
+	unsigned int	expired;
+	unsigned int	teardown;
+	unsigned int	gc_visited;
+	unsigned int	hw_add;
+	unsigned int	hw_del;
+	unsigned int	hw_stats;
+};
+
+#define NF_FLOW_TABLE_STAT_INC(ft, count)	this_cpu_inc((ft)->stat->count)
+#define NF_FLOW_TABLE_STAT_DEC(ft, count)	this_cpu_dec((ft)->stat->count)
+
 struct nf_flowtable {
 	struct list_head		list;
 	struct rhashtable		rhashtable;
@@ -78,6 +93,16 @@ struct nf_flowtable {
 	struct flow_block		flow_block;
 	struct rw_semaphore		flow_block_lock; /* Guards flow_block */
 	possible_net_t			net;
+
+	/* expiry wheel, see nf_flow_gc_expire_slot() */
+	spinlock_t			gc_lock;	/* Guards gc_wheel */
+	struct list_head		*gc_wheel;
+	unsigned int			gc_cursor;
+	u32				gc_next;
+	bool				gc_full;
+
+	struct nf_flow_offload_batch	*offload_batch;
+	struct nf_flowtable_stat __percpu *stat;
 };
 
 static inline bool nf_flowtable_hw_offload(struct nf_flowtable *flowtable)
@@ -170,7 +195,9 @@ struct flow_offload {
 	struct nf_conn				*ct;
 	unsigned long				flags;
 	u16					type;
+	u16					gc_slot;
 	u32					timeout;
+	struct list_head			gc_node;
 	struct rcu_head				rcu_head;
 };
 
@@ -298,6 +325,8 @@ void nf_flow_offload_stats(struct nf_flowtable *flowtable,
 			   struct flow_offload *flow);
 
 void nf_flow_table_offload_flush(struct nf_flowtable *flowtable);
+int nf_flow_table_offload_batch_init(struct nf_flowtable *flowtable);
+void nf_flow_table_offload_batch_free(struct nf_flowtable *flowtable);
 int nf_flow_table_offload_setup(struct nf_flowtable *flowtable,
 				struct net_device *dev,
 				enum flow_block_command cmd);
@@ -90,6 +90,7 @@ struct ct_pcpu {
 	spinlock_t		lock;
 	struct hlist_nulls_head unconfirmed;
 	struct hlist_nulls_head dying;
+	atomic_t		count_reserve;	/* charged to the netns count */
 };
 
 struct netns_ct {
@@ -170,6 +170,7 @@ struct netns_ipv4 {
 	unsigned long sysctl_tcp_comp_sack_delay_ns;
 	unsigned long sysctl_tcp_comp_sack_slack_ns;
 	int sysctl_max_syn_backlog;
+	unsigned int sysctl_tcp_child_ehash_entries;
 	int sysctl_tcp_fastopen;
 	const struct tcp_congestion_ops __rcu  *tcp_congestion_control;
 	struct tcp_fastopen_context __rcu *tcp_fastopen_ctx;
@@ -177,6 +178,7 @@ struct netns_ipv4 {
 	unsigned int sysctl_tcp_fastopen_blackhole_timeout;
 	atomic_t tfo_active_disable_times;
 	unsigned long tfo_active_disable_stamp;
+	atomic_long_t tcp_rcvbuf_saved;
 
 	int sysctl_udp_wmem_min;
 	int sysctl_udp_rmem_min;
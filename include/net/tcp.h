@@ -347,6 +347,7 @@ void tcp_rcv_established(struct sock *sk, struct sk_buff *skb);
 void tcp_rcv_space_adjust(struct sock *sk);
 int tcp_twsk_unique(struct sock *sk, struct sock *sktw, void *twp);
 void tcp_twsk_destructor(struct sock *sk);
+void tcp_twsk_purge(struct list_head *net_exit_list, int family);
 ssize_t tcp_splice_read(struct socket *sk, loff_t *ppos,
 			struct pipe_inode_info *pipe, size_t len,
 			unsigned int flags);
@@ -1063,6 +1064,11 @@ struct tcp_congestion_ops {
 	 */
 	void (*cong_control)(struct sock *sk, const struct rate_sample *rs);
 
+	/* replaces pkts_acked and cong_avoid with one call per batch of
+	 * ACKs, a batch being all the ACKs drained from the socket backlog
+	 * at once or a single ACK otherwise. (optional)
+	 */
+	void (*ack_batch)(struct sock *sk, const struct tcp_ack_batch *batch);
 
 	/* new value of cwnd after loss (required) */
 	u32  (*undo_cwnd)(struct sock *sk);
@@ -1126,10 +1132,13 @@ static inline bool tcp_ca_needs_ecn(const struct sock *sk)
 	return icsk->icsk_ca_ops->flags & TCP_CONG_NEEDS_ECN;
 }
 
+void tcp_ca_flush_ack_batch(struct sock *sk);
+
 static inline void tcp_set_ca_state(struct sock *sk, const u8 ca_state)
 {
 	struct inet_connection_sock *icsk = inet_csk(sk);
 
+	tcp_ca_flush_ack_batch(sk);
 	if (icsk->icsk_ca_ops->set_state)
 		icsk->icsk_ca_ops->set_state(sk, ca_state);
 	icsk->icsk_ca_state = ca_state;
@@ -1397,6 +1406,17 @@ static inline int tcp_win_from_space(const struct sock *sk, int space)
 		space - (space>>tcp_adv_win_scale);
 }
 
+/* Inverse of tcp_win_from_space(): buffer space needed to back @win */
+static inline int tcp_space_from_win(const struct sock *sk, int win)
+{
+	int tcp_adv_win_scale = sock_net(sk)->ipv4.sysctl_tcp_adv_win_scale;
+
+	return tcp_adv_win_scale <= 0 ?
+		(win << (-tcp_adv_win_scale)) :
+		div_u64((u64)win << tcp_adv_win_scale,
+			(1ULL << tcp_adv_win_scale) - 1);
+}
+
 /* Note: caller must be prepared to deal with negative returns */
 static inline int tcp_space(const struct sock *sk)
 {
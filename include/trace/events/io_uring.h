@@ -136,15 +136,16 @@ TRACE_EVENT(io_uring_file_get,
  */
 TRACE_EVENT(io_uring_queue_async_work,
 
-	TP_PROTO(void *ctx, int rw, void * req, struct io_wq_work *work,
-			 unsigned int flags),
+	TP_PROTO(void *ctx, int rw, void * req, u8 opcode,
+			 struct io_wq_work *work, unsigned int flags),
 
-	TP_ARGS(ctx, rw, req, work, flags),
+	TP_ARGS(ctx, rw, req, opcode, work, flags),
 
 	TP_STRUCT__entry (
 		__field(  void *,				ctx		)
 		__field(  int,					rw		)
 		__field(  void *,				req		)
+		__field(  u8,					opcode	)
 		__field(  struct io_wq_work *,		work	)
 		__field(  unsigned int,			flags	)
 	),
@@ -153,13 +154,15 @@ TRACE_EVENT(io_uring_queue_async_work,
 		__entry->ctx	= ctx;
 		__entry->rw		= rw;
 		__entry->req	= req;
+		__entry->opcode	= opcode;
 		__entry->work	= work;
 		__entry->flags	= flags;
 	),
 
-	TP_printk("ring %p, request %p, flags %d, %s queue, work %p",
-			  __entry->ctx, __entry->req, __entry->flags,
-			  __entry->rw ? "hashed" : "normal", __entry->work)
+	TP_printk("ring %p, request %p, op %d, flags %d, %s queue, work %p",
+			  __entry->ctx, __entry->req, __entry->opcode,
+			  __entry->flags, __entry->rw ? "hashed" : "normal",
+			  __entry->work)
 );
 
 /**
@@ -463,6 +466,46 @@ TRACE_EVENT(io_uring_task_run,
 			  (unsigned long long) __entry->user_data)
 );
 
+/**
+ * io_uring_cqe_overflow - a CQE did not fit into the CQ ring
+ *
+ * @ctx:		pointer to a ring context structure
+ * @user_data:		user data associated with the request
+ * @res:		CQE result
+ * @cflags:		CQE flags
+ * @dropped:		true if the CQE could not be saved and was lost
+ *
+ * Allows to track CQ ring overflows, which mean the application isn't reaping
+ * completions fast enough for the CQ ring size it picked.
+ */
+TRACE_EVENT(io_uring_cqe_overflow,
+
+	TP_PROTO(void *ctx, u64 user_data, long res, unsigned cflags,
+		 bool dropped),
+
+	TP_ARGS(ctx, user_data, res, cflags, dropped),
+
+	TP_STRUCT__entry (
+		__field(  void *,	ctx		)
+		__field(  u64,		user_data	)
+		__field(  long,		res		)
+		__field(  unsigned,	cflags		)
+		__field(  bool,		dropped		)
+	),
+
+	TP_fast_assign(
+		__entry->ctx		= ctx;
+		__entry->user_data	= user_data;
+		__entry->res		= res;
+		__entry->cflags		= cflags;
+		__entry->dropped	= dropped;
+	),
+
+	TP_printk("ring %p, user_data 0x%llx, res %ld, cflags %x, dropped %d",
+			  __entry->ctx, (unsigned long long)__entry->user_data,
+			  __entry->res, __entry->cflags, __entry->dropped)
+);
+
 #endif /* _TRACE_IO_URING_H */
 
 /* This part must be outside protection */
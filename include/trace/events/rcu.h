@@ -559,6 +559,69 @@ TRACE_EVENT_RCU(rcu_segcb_stats,
 
 );
 
+/*
+ * Tracepoint for the registration of a single RCU callback by
+ * call_rcu_lazy().  The first argument is the type of RCU, the second
+ * argument is a pointer to the RCU callback itself, and the third
+ * element is the number of lazy callbacks held back on this CPU.
+ */
+TRACE_EVENT_RCU(rcu_lazy_callback,
+
+	TP_PROTO(const char *rcuname, struct rcu_head *rhp, long qlen),
+
+	TP_ARGS(rcuname, rhp, qlen),
+
+	TP_STRUCT__entry(
+		__field(const char *, rcuname)
+		__field(void *, rhp)
+		__field(void *, func)
+		__field(long, qlen)
+	),
+
+	TP_fast_assign(
+		__entry->rcuname = rcuname;
+		__entry->rhp = rhp;
+		__entry->func = rhp->func;
+		__entry->qlen = qlen;
+	),
+
+	TP_printk("%s rhp=%p func=%ps %ld",
+		  __entry->rcuname, __entry->rhp, __entry->func,
+		  __entry->qlen)
+);
+
+/*
+ * Tracepoint for the lazy callbacks of a CPU being queued for a grace
+ * period.  The first argument is the type of RCU, the second the CPU
+ * the callbacks were held back on, the third their number, and the
+ * fourth the reason: "Timer" once they were held back long enough or
+ * piled up, "Shrink" under memory pressure, or "Barrier" for rcu_barrier().
+ */
+TRACE_EVENT_RCU(rcu_lazy_flush,
+
+	TP_PROTO(const char *rcuname, int cpu, long qlen, const char *reason),
+
+	TP_ARGS(rcuname, cpu, qlen, reason),
+
+	TP_STRUCT__entry(
+		__field(const char *, rcuname)
+		__field(int, cpu)
+		__field(long, qlen)
+		__field(const char *, reason)
+	),
+
+	TP_fast_assign(
+		__entry->rcuname = rcuname;
+		__entry->cpu = cpu;
+		__entry->qlen = qlen;
+		__entry->reason = reason;
+	),
+
+	TP_printk("%s cpu=%d %ld %s",
+		  __entry->rcuname, __entry->cpu, __entry->qlen,
+		  __entry->reason)
+);
+
 /*
  * Tracepoint for the registration of a single RCU callback of the special
  * kvfree() form.  The first argument is the RCU type, the second argument
@@ -181,6 +181,11 @@
  *  - add FUSE_OPEN_KILL_SUIDGID
  *  - extend fuse_setxattr_in, add FUSE_SETXATTR_EXT
  *  - add FUSE_SETXATTR_ACL_KILL_SGID
+ *
+ *  7.34
+ *  - add FUSE_DEV_IOC_URING_QUEUE, FUSE_URING_CMD_FETCH and fuse_uring_cmd
+ *  - add FUSE_PASSTHROUGH, FUSE_DEV_IOC_PASSTHROUGH_OPEN and
+ *    fuse_passthrough_out, add passthrough_fh to fuse_open_out
  */
 
 #ifndef _LINUX_FUSE_H
@@ -216,7 +221,7 @@
 #define FUSE_KERNEL_VERSION 7
 
 /** Minor version number of this interface */
-#define FUSE_KERNEL_MINOR_VERSION 33
+#define FUSE_KERNEL_MINOR_VERSION 34
 
 /** The node ID of the root inode */
 #define FUSE_ROOT_ID 1
@@ -333,6 +338,7 @@ struct fuse_file_lock {
  *			write/truncate sgid is killed only if file has group
  *			execute permission. (Same as Linux VFS behavior).
  * FUSE_SETXATTR_EXT:	Server supports extended struct fuse_setxattr_in
+ * FUSE_PASSTHROUGH: opens may forward read/write/mmap to a backing file
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -364,6 +370,7 @@ struct fuse_file_lock {
 #define FUSE_SUBMOUNTS		(1 << 27)
 #define FUSE_HANDLE_KILLPRIV_V2	(1 << 28)
 #define FUSE_SETXATTR_EXT	(1 << 29)
+#define FUSE_PASSTHROUGH	(1 << 30)
 
 /**
  * CUSE INIT request/reply flags
@@ -635,7 +642,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	uint64_t	fh;
 	uint32_t	open_flags;
-	uint32_t	padding;
+	uint32_t	passthrough_fh;
 };
 
 struct fuse_release_in {
@@ -919,6 +926,37 @@ struct fuse_notify_retrieve_in {
 /* Device ioctls: */
 #define FUSE_DEV_IOC_MAGIC		229
 #define FUSE_DEV_IOC_CLONE		_IOR(FUSE_DEV_IOC_MAGIC, 0, uint32_t)
+#define FUSE_DEV_IOC_URING_QUEUE	_IOW(FUSE_DEV_IOC_MAGIC, 1, uint32_t)
+#define FUSE_DEV_IOC_PASSTHROUGH_OPEN	_IOW(FUSE_DEV_IOC_MAGIC, 2, \
+					     struct fuse_passthrough_out)
+
+/*
+ * Backing file for FUSE_DEV_IOC_PASSTHROUGH_OPEN.  The ioctl returns an id to
+ * put into fuse_open_out.passthrough_fh of the reply to FUSE_OPEN or
+ * FUSE_CREATE; read, write and mmap of that open then go to @fd directly.
+ * @flags must be zero.
+ */
+struct fuse_passthrough_out {
+	uint32_t	fd;
+	uint32_t	flags;
+};
+
+/*
+ * io_uring transport, set up per device (usually a clone per CPU) with
+ * FUSE_DEV_IOC_URING_QUEUE and the CPU the device serves.  An
+ * IORING_OP_URING_CMD with cmd_op FUSE_URING_CMD_FETCH on the device
+ * completes with the length of the next request, copied to @buf.  If
+ * @reply_len is non-zero, @buf first holds the reply to a request fetched
+ * earlier on the same device.  Interrupts, forgets and requests that could
+ * not be routed to a queue are still read from the device.
+ */
+#define FUSE_URING_CMD_FETCH		1
+
+struct fuse_uring_cmd {
+	uint64_t	buf;
+	uint32_t	buf_len;
+	uint32_t	reply_len;
+};
 
 struct fuse_lseek_in {
 	uint64_t	fh;
@@ -25,6 +25,13 @@
  * application.
  */
 #define XDP_USE_NEED_WAKEUP (1 << 3)
+/* By setting this option, the application tells that it can handle
+ * packets spread over several descriptors, see XDP_PKT_CONTD. Rx then
+ * splits packets larger than a UMEM frame, including multi-buffer XDP
+ * frames, instead of dropping them, and Tx accepts such packets. Only
+ * supported in copy mode.
+ */
+#define XDP_USE_SG	(1 << 4)
 
 /* Flags for xsk_umem_config flags */
 #define XDP_UMEM_UNALIGNED_CHUNK_FLAG (1 << 0)
@@ -106,6 +113,9 @@ struct xdp_desc {
 	__u32 options;
 };
 
+/* Flag in xdp_desc.options: the packet continues in the next descriptor */
+#define XDP_PKT_CONTD (1 << 0)
+
 /* UMEM descriptor is __u64 */
 
 #endif /* _LINUX_IF_XDP_H */
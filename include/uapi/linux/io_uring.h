@@ -22,6 +22,10 @@ struct io_uring_sqe {
 	union {
 		__u64	off;	/* offset into file */
 		__u64	addr2;
+		struct {
+			__u32	cmd_op;
+			__u32	__pad1;
+		};
 	};
 	union {
 		__u64	addr;	/* pointer to buffer or iovecs */
@@ -46,20 +50,26 @@ struct io_uring_sqe {
 		__u32		unlink_flags;
 	};
 	__u64	user_data;	/* data to be passed back at completion time */
+	/* pack this to avoid bogus arm OABI complaints */
 	union {
-		struct {
-			/* pack this to avoid bogus arm OABI complaints */
-			union {
-				/* index into fixed buffers, if used */
-				__u16	buf_index;
-				/* for grouped buffer selection */
-				__u16	buf_group;
-			} __attribute__((packed));
-			/* personality to use, if used */
-			__u16	personality;
-			__s32	splice_fd_in;
-		};
-		__u64	__pad2[3];
+		/* index into fixed buffers, if used */
+		__u16	buf_index;
+		/* for grouped buffer selection */
+		__u16	buf_group;
+	} __attribute__((packed));
+	/* personality to use, if used */
+	__u16	personality;
+	union {
+		__s32	splice_fd_in;
+		__u32	file_index;
+	};
+	union {
+		__u64	__pad2[2];
+		/*
+		 * If the ring is initialized with IORING_SETUP_SQE128, then
+		 * this field is used for 80 bytes of arbitrary command data
+		 */
+		__u8	cmd[0];
 	};
 };
 
@@ -98,6 +108,13 @@ enum {
 #define IORING_SETUP_CLAMP	(1U << 4)	/* clamp SQ/CQ ring sizes */
 #define IORING_SETUP_ATTACH_WQ	(1U << 5)	/* attach to existing wq */
 #define IORING_SETUP_R_DISABLED	(1U << 6)	/* start with ring disabled */
+/*
+ * Don't interrupt the submitting task to run completion task_work, it is
+ * run the next time the task enters the kernel or waits on the ring.
+ */
+#define IORING_SETUP_COOP_TASKRUN	(1U << 7)
+#define IORING_SETUP_SQE128	(1U << 8)	/* SQEs are 128 byte */
+#define IORING_SETUP_CQE32	(1U << 9)	/* CQEs are 32 byte */
 
 enum {
 	IORING_OP_NOP,
@@ -137,6 +154,9 @@ enum {
 	IORING_OP_SHUTDOWN,
 	IORING_OP_RENAMEAT,
 	IORING_OP_UNLINKAT,
+	IORING_OP_SEND_ZC,
+	IORING_OP_GETDENTS,
+	IORING_OP_URING_CMD,
 
 	/* this goes last, obviously */
 	IORING_OP_LAST,
@@ -174,6 +194,28 @@ enum {
 #define IORING_POLL_UPDATE_EVENTS	(1U << 1)
 #define IORING_POLL_UPDATE_USER_DATA	(1U << 2)
 
+/*
+ * send/recv flags, stored in sqe->ioprio
+ *
+ * IORING_RECVSEND_FIXED_BUF	Use registered buffer, pass it in
+ *				sqe->buf_index.
+ *
+ * IORING_RECV_MULTISHOT	Multishot recv. Requires IOSQE_BUFFER_SELECT
+ *				and sqe->len == 0, each completion uses a new
+ *				provided buffer and sets IORING_CQE_F_MORE as
+ *				long as the request stays armed.
+ */
+#define IORING_RECVSEND_FIXED_BUF	(1U << 0)
+#define IORING_RECV_MULTISHOT		(1U << 1)
+
+/*
+ * accept flags, stored in sqe->ioprio
+ *
+ * IORING_ACCEPT_MULTISHOT	Keep accepting connections, posting one CQE
+ *				with IORING_CQE_F_MORE set per new fd.
+ */
+#define IORING_ACCEPT_MULTISHOT	(1U << 0)
+
 /*
  * IO completion data structure (Completion Queue Entry)
  */
@@ -181,6 +223,12 @@ struct io_uring_cqe {
 	__u64	user_data;	/* sqe->data submission passed back */
 	__s32	res;		/* result code for this event */
 	__u32	flags;
+
+	/*
+	 * If the ring is initialized with IORING_SETUP_CQE32, then this field
+	 * contains 16 bytes of padding, doubling the size of the CQE.
+	 */
+	__u64	big_cqe[];
 };
 
 /*
@@ -188,9 +236,13 @@ struct io_uring_cqe {
  *
  * IORING_CQE_F_BUFFER	If set, the upper 16 bits are the buffer ID
  * IORING_CQE_F_MORE	If set, parent SQE will generate more CQE entries
+ * IORING_CQE_F_NOTIF	Set for zerocopy send notifications, telling the
+ *			application that the kernel no longer references the
+ *			buffers of the request with the same user_data
  */
 #define IORING_CQE_F_BUFFER		(1U << 0)
 #define IORING_CQE_F_MORE		(1U << 1)
+#define IORING_CQE_F_NOTIF		(1U << 2)
 
 enum {
 	IORING_CQE_BUFFER_SHIFT		= 16,
@@ -250,6 +302,7 @@ struct io_cqring_offsets {
 #define IORING_ENTER_SQ_WAKEUP	(1U << 1)
 #define IORING_ENTER_SQ_WAIT	(1U << 2)
 #define IORING_ENTER_EXT_ARG	(1U << 3)
+#define IORING_ENTER_REGISTERED_RING	(1U << 4)
 
 /*
  * Passed in for io_uring_setup(2). Copied back with updated info on success
@@ -306,6 +359,17 @@ enum {
 	IORING_REGISTER_BUFFERS2		= 15,
 	IORING_REGISTER_BUFFERS_UPDATE		= 16,
 
+	/* register/unregister a ring of provided buffers */
+	IORING_REGISTER_PBUF_RING		= 17,
+	IORING_UNREGISTER_PBUF_RING		= 18,
+
+	/* register ring fds in the task's private table, see ENTER flags */
+	IORING_REGISTER_RING_FDS		= 19,
+	IORING_UNREGISTER_RING_FDS		= 20,
+
+	/* tune a ring's share of a (shared) SQPOLL thread */
+	IORING_REGISTER_SQPOLL_PARAMS		= 21,
+
 	/* this goes last */
 	IORING_REGISTER_LAST
 };
@@ -340,6 +404,49 @@ struct io_uring_rsrc_update2 {
 	__u32 resv2;
 };
 
+struct io_uring_buf {
+	__u64	addr;
+	__u32	len;
+	__u16	bid;
+	__u16	resv;
+};
+
+/*
+ * Shared buffer ring for a provided buffer group. The application fills in
+ * bufs[] and publishes new entries by advancing @tail, the kernel consumes
+ * entries from its private head. @tail overlays the resv field of bufs[0].
+ */
+struct io_uring_buf_ring {
+	union {
+		struct {
+			__u64	resv1;
+			__u32	resv2;
+			__u16	resv3;
+			__u16	tail;
+		};
+		struct io_uring_buf	bufs[0];
+	};
+};
+
+/* argument for IORING_(UN)REGISTER_PBUF_RING */
+struct io_uring_buf_reg {
+	__u64	ring_addr;
+	__u32	ring_entries;
+	__u16	bgid;
+	__u16	pad;
+	__u64	resv[3];
+};
+
+/*
+ * argument for IORING_REGISTER_SQPOLL_PARAMS, zero fields are left unchanged.
+ * The current values are copied back.
+ */
+struct io_uring_sqpoll_params {
+	__u32	sq_thread_idle;	/* msecs, like io_uring_params */
+	__u32	sq_weight;	/* relative share of each SQPOLL round */
+	__u64	resv[3];
+};
+
 /* Skip updating fd indexes set to this value in the fd table */
 #define IORING_REGISTER_FILES_SKIP	(-2)
 
@@ -1083,6 +1083,7 @@ struct kvm_ppc_resize_hpt {
 #define KVM_CAP_SGX_ATTRIBUTE 196
 #define KVM_CAP_VM_COPY_ENC_CONTEXT_FROM 197
 #define KVM_CAP_PTP_KVM 198
+#define KVM_CAP_DIRTY_LOG_RING_WITH_BITMAP 199
 
 #ifdef KVM_CAP_IRQ_ROUTING
 
@@ -1594,6 +1595,8 @@ struct kvm_pv_cmd {
 
 /* Available with KVM_CAP_DIRTY_LOG_RING */
 #define KVM_RESET_DIRTY_RINGS		_IO(KVMIO, 0xc7)
+/* vcpu ioctl, available with KVM_CAP_DIRTY_LOG_RING */
+#define KVM_RESET_DIRTY_RING		_IO(KVMIO, 0xcc)
 
 /* Per-VM Xen attributes */
 #define KVM_XEN_HVM_GET_ATTR	_IOWR(KVMIO, 0xc8, struct kvm_xen_hvm_attr)
@@ -290,6 +290,10 @@ enum
 	LINUX_MIB_TCPDUPLICATEDATAREHASH,	/* TCPDuplicateDataRehash */
 	LINUX_MIB_TCPDSACKRECVSEGS,		/* TCPDSACKRecvSegs */
 	LINUX_MIB_TCPDSACKIGNOREDDUBIOUS,	/* TCPDSACKIgnoredDubious */
+	LINUX_MIB_PORTSEARCHES,			/* PortSearches */
+	LINUX_MIB_PORTSEARCHPROBES,		/* PortSearchProbes */
+	LINUX_MIB_PORTSEARCHCOLLISIONS,		/* PortSearchCollisions */
+	LINUX_MIB_TCPRCVBUFSHRINK,		/* TCPRcvBufShrink */
 	__LINUX_MIB_MAX
 };
 
@@ -342,6 +346,8 @@ enum
 	LINUX_MIB_TLSRXDEVICE,			/* TlsRxDevice */
 	LINUX_MIB_TLSDECRYPTERROR,		/* TlsDecryptError */
 	LINUX_MIB_TLSRXDEVICERESYNC,		/* TlsRxDeviceResync */
+	LINUX_MIB_TLSDECRYPTRETRY,		/* TlsDecryptRetry */
+	LINUX_MIB_TLSRXNOPADVIOL,		/* TlsRxNoPadViolation */
 	__LINUX_MIB_TLSMAX
 };
 
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_TRACE_MMAP_H_
+#define _UAPI_TRACE_MMAP_H_
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/**
+ * struct trace_buffer_meta - Ring-buffer Meta-page description
+ * @meta_page_size:	Size of this meta-page.
+ * @meta_struct_len:	Size of this structure.
+ * @subbuf_size:	Size of each sub-buffer.
+ * @nr_subbufs:		Number of sub-buffers in the ring-buffer, including the reader.
+ * @reader.lost_events:	Number of events lost before the sub-buffer handed
+ *			out by the last TRACE_MMAP_IOCTL_GET_READER.
+ * @reader.id:		subbuf ID of the current reader. ID range [0 : @nr_subbufs - 1]
+ * @reader.read:	Offset of the first event handed out in the reader
+ *			sub-buffer data.
+ * @reader.commit:	Offset right after the last event handed out.
+ * @flags:		Flags for the ring-buffer, currently unused.
+ * @entries:		Number of entries in the ring-buffer.
+ * @overrun:		Number of entries lost in the ring-buffer.
+ * @read:		Number of entries that have been read.
+ *
+ * The meta-page is mapped at offset 0 of a per-CPU trace_pipe_raw file,
+ * sub-buffer ID N at offset (N + 1) * @meta_page_size.  Each sub-buffer
+ * starts with a 64-bit time stamp and a commit field, events follow.
+ *
+ * The meta-page is only updated by TRACE_MMAP_IOCTL_GET_READER; the
+ * events in [@reader.read, @reader.commit) of the reader sub-buffer are
+ * consumed as far as the kernel is concerned and stay in place until the
+ * next call.
+ */
+struct trace_buffer_meta {
+	__u32		meta_page_size;
+	__u32		meta_struct_len;
+
+	__u32		subbuf_size;
+	__u32		nr_subbufs;
+
+	struct {
+		__u64	lost_events;
+		__u32	id;
+		__u32	read;
+		__u32	commit;
+		__u32	__reserved;
+	} reader;
+
+	__u64	flags;
+
+	__u64	entries;
+	__u64	overrun;
+	__u64	read;
+};
+
+/*
+ * Swap in the next sub-buffer holding unread events as the reader one and
+ * refresh the meta-page.
+ */
+#define TRACE_MMAP_IOCTL_GET_READER		_IO('R', 0x20)
+
+#endif /* _UAPI_TRACE_MMAP_H_ */
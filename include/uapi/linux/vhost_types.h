@@ -21,6 +21,22 @@ struct vhost_vring_state {
 	unsigned int num;
 };
 
+struct vhost_worker_state {
+	/* Returned by VHOST_NEW_WORKER, passed to VHOST_FREE_WORKER */
+	unsigned int worker_id;
+	/* CPU the worker is bound to, -1 to let it run anywhere */
+	int cpu;
+	/* Limit in us on busy polling by the virtqueues using the worker,
+	 * 0 to only apply VHOST_SET_VRING_BUSYLOOP_TIMEOUT.
+	 */
+	unsigned int busyloop_budget;
+};
+
+struct vhost_vring_worker {
+	unsigned int index;
+	unsigned int worker_id;
+};
+
 struct vhost_vring_file {
 	unsigned int index;
 	int fd; /* Pass -1 to unbind from file. */
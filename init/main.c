@@ -75,6 +75,8 @@
 #include <linux/kgdb.h>
 #include <linux/ftrace.h>
 #include <linux/async.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/shmem_fs.h>
 #include <linux/slab.h>
 #include <linux/perf_event.h>
@@ -782,6 +784,12 @@ void __init __weak pgtable_cache_init(void) { }
 bool initcall_debug;
 core_param(initcall_debug, initcall_debug, bool, 0644);
 
+static bool initcall_async;
+core_param(initcall_async, initcall_async, bool, 0444);
+
+static bool initcall_profile;
+core_param(initcall_profile, initcall_profile, bool, 0444);
+
 #ifdef TRACEPOINTS_ENABLED
 static void __init initcall_debug_enable(void);
 #else
@@ -1266,6 +1274,81 @@ int __init_or_module do_one_initcall(initcall_t fn)
 }
 
 
+/*
+ * Boot profile: one line per initcall with its level, duration in usecs,
+ * return value and name, in /sys/kernel/debug/initcall_profile.
+ */
+struct initcall_profile_entry {
+	struct list_head list;
+	int level;
+	int ret;
+	u64 usecs;
+	char name[];
+};
+
+static LIST_HEAD(initcall_profile_list);
+static DEFINE_MUTEX(initcall_profile_lock);
+
+static void __init initcall_profile_add(initcall_t fn, int level, int ret,
+					ktime_t start)
+{
+	u64 usecs = ktime_to_us(ktime_sub(ktime_get(), start));
+	struct initcall_profile_entry *entry;
+	char name[KSYM_SYMBOL_LEN];
+	size_t len;
+
+	len = snprintf(name, sizeof(name), "%ps", fn) + 1;
+	entry = kmalloc(sizeof(*entry) + len, GFP_KERNEL);
+	if (!entry)
+		return;
+
+	entry->level = level;
+	entry->ret = ret;
+	entry->usecs = usecs;
+	memcpy(entry->name, name, len);
+
+	mutex_lock(&initcall_profile_lock);
+	list_add_tail(&entry->list, &initcall_profile_list);
+	mutex_unlock(&initcall_profile_lock);
+}
+
+static int initcall_profile_show(struct seq_file *m, void *v)
+{
+	struct initcall_profile_entry *entry;
+
+	mutex_lock(&initcall_profile_lock);
+	list_for_each_entry(entry, &initcall_profile_list, list)
+		seq_printf(m, "%d %llu %d %s\n", entry->level, entry->usecs,
+			   entry->ret, entry->name);
+	mutex_unlock(&initcall_profile_lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(initcall_profile);
+
+static int __init initcall_profile_init(void)
+{
+	if (initcall_profile)
+		debugfs_create_file("initcall_profile", 0400, NULL, NULL,
+				    &initcall_profile_fops);
+	return 0;
+}
+late_initcall(initcall_profile_init);
+
+static int __init do_one_level_initcall(initcall_t fn, int level)
+{
+	ktime_t start = 0;
+	int ret;
+
+	if (initcall_profile)
+		start = ktime_get();
+
+	ret = do_one_initcall(fn);
+
+	if (initcall_profile)
+		initcall_profile_add(fn, level, ret, start);
+	return ret;
+}
+
 extern initcall_entry_t __initcall_start[];
 extern initcall_entry_t __initcall0_start[];
 extern initcall_entry_t __initcall1_start[];
@@ -1277,6 +1360,15 @@ extern initcall_entry_t __initcall6_start[];
 extern initcall_entry_t __initcall7_start[];
 extern initcall_entry_t __initcall_end[];
 
+extern initcall_entry_t __initcall0a_start[], __initcall0s_start[];
+extern initcall_entry_t __initcall1a_start[], __initcall1s_start[];
+extern initcall_entry_t __initcall2a_start[], __initcall2s_start[];
+extern initcall_entry_t __initcall3a_start[], __initcall3s_start[];
+extern initcall_entry_t __initcall4a_start[], __initcall4s_start[];
+extern initcall_entry_t __initcall5a_start[], __initcall5s_start[];
+extern initcall_entry_t __initcall6a_start[], __initcall6s_start[];
+extern initcall_entry_t __initcall7a_start[], __initcall7s_start[];
+
 static initcall_entry_t *initcall_levels[] __initdata = {
 	__initcall0_start,
 	__initcall1_start,
@@ -1289,6 +1381,26 @@ static initcall_entry_t *initcall_levels[] __initdata = {
 	__initcall_end,
 };
 
+/* Start and end of the _async initcalls of each level */
+static initcall_entry_t *initcall_async_levels[][2] __initdata = {
+	{ __initcall0a_start, __initcall0s_start },
+	{ __initcall1a_start, __initcall1s_start },
+	{ __initcall2a_start, __initcall2s_start },
+	{ __initcall3a_start, __initcall3s_start },
+	{ __initcall4a_start, __initcall4s_start },
+	{ __initcall5a_start, __initcall5s_start },
+	{ __initcall6a_start, __initcall6s_start },
+	{ __initcall7a_start, __initcall7s_start },
+};
+
+static ASYNC_DOMAIN_EXCLUSIVE(initcall_domain);
+static int initcall_async_level __initdata;
+
+static void __init do_initcall_async(void *data, async_cookie_t cookie)
+{
+	do_one_level_initcall((initcall_t)data, initcall_async_level);
+}
+
 /* Keep these in sync with initcalls in include/linux/init.h */
 static const char *initcall_level_names[] __initdata = {
 	"pure",
@@ -1318,8 +1430,24 @@ static void __init do_initcall_level(int level, char *command_line)
 		   NULL, ignore_unknown_bootoption);
 
 	trace_initcall_level(initcall_level_names[level]);
-	for (fn = initcall_levels[level]; fn < initcall_levels[level+1]; fn++)
-		do_one_initcall(initcall_from_entry(fn));
+	for (fn = initcall_levels[level]; fn < initcall_async_levels[level][0];
+	     fn++)
+		do_one_level_initcall(initcall_from_entry(fn), level);
+
+	/* The _sync initcalls of the level may depend on all _async ones */
+	initcall_async_level = level;
+	for (; fn < initcall_async_levels[level][1]; fn++) {
+		if (initcall_async)
+			async_schedule_domain(do_initcall_async,
+					      (void *)initcall_from_entry(fn),
+					      &initcall_domain);
+		else
+			do_one_level_initcall(initcall_from_entry(fn), level);
+	}
+	async_synchronize_full_domain(&initcall_domain);
+
+	for (; fn < initcall_levels[level+1]; fn++)
+		do_one_level_initcall(initcall_from_entry(fn), level);
 }
 
 static void __init do_initcalls(void)
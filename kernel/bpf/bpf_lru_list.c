@@ -228,6 +228,9 @@ __bpf_lru_list_shrink_inactive(struct bpf_lru *lru,
 			break;
 	}
 
+	if (nshrinked)
+		atomic_long_add(nshrinked, &lru->nr_evicted);
+
 	return nshrinked;
 }
 
@@ -279,6 +282,7 @@ static unsigned int __bpf_lru_list_shrink(struct bpf_lru *lru,
 		if (lru->del_from_htab(lru->del_arg, node)) {
 			__bpf_lru_node_move_to_free(l, node, free_list,
 						    tgt_free_type);
+			atomic_long_inc(&lru->nr_evicted);
 			return 1;
 		}
 	}
@@ -302,6 +306,22 @@ static void __local_list_flush(struct bpf_lru_list *l,
 	}
 }
 
+/* Unlink the nodes batched by bpf_common_lru_push_free() from the LRU
+ * list and move them to the local free list.
+ */
+static void __local_list_flush_free_batch(struct bpf_lru_list *l,
+					  struct bpf_lru_locallist *loc_l)
+{
+	unsigned int i;
+
+	for (i = 0; i < loc_l->nr_free_batch; i++)
+		__bpf_lru_node_move_to_free(l, loc_l->free_batch[i],
+					    local_free_list(loc_l),
+					    BPF_LRU_LOCAL_LIST_T_FREE);
+
+	loc_l->nr_free_batch = 0;
+}
+
 static void bpf_lru_list_push_free(struct bpf_lru_list *l,
 				   struct bpf_lru_node *node)
 {
@@ -324,6 +344,8 @@ static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
 
 	raw_spin_lock(&l->lock);
 
+	__local_list_flush_free_batch(l, loc_l);
+
 	__local_list_flush(l, loc_l);
 
 	__bpf_lru_list_rotate(lru, l);
@@ -384,6 +406,7 @@ __local_list_pop_pending(struct bpf_lru *lru, struct bpf_lru_locallist *loc_l)
 		if ((!bpf_lru_node_is_ref(node) || force) &&
 		    lru->del_from_htab(lru->del_arg, node)) {
 			list_del(&node->list);
+			atomic_long_inc(&lru->nr_evicted);
 			return node;
 		}
 	}
@@ -472,6 +495,13 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 		raw_spin_lock_irqsave(&steal_loc_l->lock, flags);
 
 		node = __local_list_pop_free(steal_loc_l);
+		if (!node && steal_loc_l->nr_free_batch) {
+			raw_spin_lock(&clru->lru_list.lock);
+			__local_list_flush_free_batch(&clru->lru_list,
+						      steal_loc_l);
+			raw_spin_unlock(&clru->lru_list.lock);
+			node = __local_list_pop_free(steal_loc_l);
+		}
 		if (!node)
 			node = __local_list_pop_pending(lru, steal_loc_l);
 
@@ -530,6 +560,34 @@ static void bpf_common_lru_push_free(struct bpf_lru *lru,
 	}
 
 check_lru_list:
+	if (lru->free_batch > 1) {
+		struct bpf_lru_list *l = &lru->common_lru.lru_list;
+		struct bpf_lru_locallist *loc_l;
+
+		if (WARN_ON_ONCE(IS_LOCAL_LIST_TYPE(node->type)))
+			return;
+
+		/* The node was already removed from the htab, so it can
+		 * stay on the LRU list until the batch is flushed: the
+		 * shrinkers will not manage to delete it from the htab,
+		 * and it cannot be handed out before it is on a free list.
+		 */
+		loc_l = per_cpu_ptr(lru->common_lru.local_list,
+				    raw_smp_processor_id());
+
+		raw_spin_lock_irqsave(&loc_l->lock, flags);
+
+		loc_l->free_batch[loc_l->nr_free_batch++] = node;
+		if (loc_l->nr_free_batch >= lru->free_batch) {
+			raw_spin_lock(&l->lock);
+			__local_list_flush_free_batch(l, loc_l);
+			raw_spin_unlock(&l->lock);
+		}
+
+		raw_spin_unlock_irqrestore(&loc_l->lock, flags);
+		return;
+	}
+
 	bpf_lru_list_push_free(&lru->common_lru.lru_list, node);
 }
 
@@ -563,6 +621,12 @@ static void bpf_common_lru_populate(struct bpf_lru *lru, void *buf,
 	struct bpf_lru_list *l = &lru->common_lru.lru_list;
 	u32 i;
 
+	/* Keep the nodes parked in the per-cpu free batches a small share
+	 * of the map, so that small maps still free nodes one at a time.
+	 */
+	lru->free_batch = clamp_t(u32, nr_elems / (4 * num_possible_cpus()),
+				  1, NR_BPF_LRU_FREE_BATCH);
+
 	for (i = 0; i < nr_elems; i++) {
 		struct bpf_lru_node *node;
 
@@ -624,6 +688,7 @@ static void bpf_lru_locallist_init(struct bpf_lru_locallist *loc_l, int cpu)
 		INIT_LIST_HEAD(&loc_l->lists[i]);
 
 	loc_l->next_steal = cpu;
+	loc_l->nr_free_batch = 0;
 
 	raw_spin_lock_init(&loc_l->lock);
 }
@@ -679,6 +744,8 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 	}
 
 	lru->percpu = percpu;
+	lru->free_batch = 1;
+	atomic_long_set(&lru->nr_evicted, 0);
 	lru->del_from_htab = del_from_htab;
 	lru->del_arg = del_arg;
 	lru->hash_offset = hash_offset;
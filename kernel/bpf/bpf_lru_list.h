@@ -4,6 +4,7 @@
 #ifndef __BPF_LRU_LIST_H_
 #define __BPF_LRU_LIST_H_
 
+#include <linux/atomic.h>
 #include <linux/list.h>
 #include <linux/spinlock_types.h>
 
@@ -11,6 +12,7 @@
 #define NR_BPF_LRU_LIST_COUNT	(2)
 #define NR_BPF_LRU_LOCAL_LIST_T (2)
 #define BPF_LOCAL_LIST_T_OFFSET NR_BPF_LRU_LIST_T
+#define NR_BPF_LRU_FREE_BATCH	(32)
 
 enum bpf_lru_list_type {
 	BPF_LRU_LIST_T_ACTIVE,
@@ -39,7 +41,12 @@ struct bpf_lru_list {
 struct bpf_lru_locallist {
 	struct list_head lists[NR_BPF_LRU_LOCAL_LIST_T];
 	u16 next_steal;
+	u16 nr_free_batch;
 	raw_spinlock_t lock;
+	/* Freed nodes still linked on the LRU list.  They are unlinked
+	 * together, taking the LRU list lock once per batch.
+	 */
+	struct bpf_lru_node *free_batch[NR_BPF_LRU_FREE_BATCH];
 };
 
 struct bpf_common_lru {
@@ -58,6 +65,8 @@ struct bpf_lru {
 	void *del_arg;
 	unsigned int hash_offset;
 	unsigned int nr_scans;
+	unsigned int free_batch;
+	atomic_long_t nr_evicted;
 	bool percpu;
 };
 
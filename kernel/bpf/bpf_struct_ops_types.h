@@ -6,4 +6,12 @@
 #include <net/tcp.h>
 BPF_STRUCT_OPS_TYPE(tcp_congestion_ops)
 #endif
+#ifdef CONFIG_SCHED_CLASS_EXT
+#include <linux/sched/ext.h>
+BPF_STRUCT_OPS_TYPE(sched_ext_ops)
+#endif
+#ifdef CONFIG_MQ_IOSCHED_BPF
+#include <linux/bpf-iosched.h>
+BPF_STRUCT_OPS_TYPE(bpf_iosched_ops)
+#endif
 #endif
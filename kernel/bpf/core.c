@@ -1429,7 +1429,12 @@ static u64 ___bpf_prog_run(u64 *regs, const struct bpf_insn *insn)
 		DST = (u32) IMM;
 		CONT;
 	ALU64_MOV_X:
-		DST = SRC;
+		/* the per-cpu form only shows up here if the JIT gave up */
+		if (unlikely(insn->off == BPF_ADDR_PERCPU))
+			DST = (unsigned long)this_cpu_ptr((void __percpu *)
+							  (unsigned long)SRC);
+		else
+			DST = SRC;
 		CONT;
 	ALU64_MOV_K:
 		DST = IMM;
@@ -1786,11 +1791,13 @@ bool bpf_prog_array_compatible(struct bpf_array *array,
 		 */
 		array->aux->type  = fp->type;
 		array->aux->jited = fp->jited;
+		array->aux->xdp_has_frags = fp->aux->xdp_has_frags;
 		return true;
 	}
 
 	return array->aux->type  == fp->type &&
-	       array->aux->jited == fp->jited;
+	       array->aux->jited == fp->jited &&
+	       array->aux->xdp_has_frags == fp->aux->xdp_has_frags;
 }
 
 static int bpf_check_tail_call(const struct bpf_prog *fp)
@@ -2354,6 +2361,14 @@ bool __weak bpf_jit_supports_kfunc_call(void)
 	return false;
 }
 
+/* Return TRUE if the JIT backend can emit BPF_MOV64_PERCPU_REG, which lets
+ * the verifier inline per-cpu lookups into the program.
+ */
+bool __weak bpf_jit_supports_percpu_insn(void)
+{
+	return false;
+}
+
 /* To execute LD_ABS/LD_IND instructions __bpf_prog_run() may call
  * skb_copy_bits(), so provide a weak definition of it for NET-less config.
  */
@@ -195,6 +195,14 @@ static int cpu_map_bpf_prog_run_xdp(struct bpf_cpu_map_entry *rcpu,
 
 		xdp_convert_frame_to_buff(xdpf, &xdp);
 
+		/* A program unaware of frags would only see the head */
+		if (unlikely(xdp_buff_has_frags(&xdp) &&
+			     !rcpu->prog->aux->xdp_has_frags)) {
+			xdp_return_frame(xdpf);
+			stats->drop++;
+			continue;
+		}
+
 		act = bpf_prog_run_xdp(rcpu->prog, &xdp);
 		switch (act) {
 		case XDP_PASS:
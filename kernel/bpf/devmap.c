@@ -431,7 +431,13 @@ static inline int __xdp_enqueue(struct net_device *dev, struct xdp_buff *xdp,
 	if (!dev->netdev_ops->ndo_xdp_xmit)
 		return -EOPNOTSUPP;
 
-	err = xdp_ok_fwd_dev(dev, xdp->data_end - xdp->data);
+	/* Frags are handed to ndo_xdp_xmit as they are, only drivers that
+	 * can map a non-linear xdp_frame may receive them.
+	 */
+	if (unlikely(xdp_buff_has_frags(xdp) && !dev->xdp_xmit_sg))
+		return -EOPNOTSUPP;
+
+	err = xdp_ok_fwd_dev(dev, xdp_get_buff_len(xdp));
 	if (unlikely(err))
 		return err;
 
@@ -483,6 +489,10 @@ int dev_map_enqueue(struct bpf_dtab_netdev *dst, struct xdp_buff *xdp,
 	struct net_device *dev = dst->dev;
 
 	if (dst->xdp_prog) {
+		if (unlikely(xdp_buff_has_frags(xdp) &&
+			     !dst->xdp_prog->aux->xdp_has_frags))
+			return -EOPNOTSUPP;
+
 		xdp = dev_map_run_prog(dev, xdp, dst->xdp_prog);
 		if (!xdp)
 			return 0;
@@ -11,6 +11,7 @@
 #include <uapi/linux/btf.h>
 #include <linux/rcupdate_trace.h>
 #include "percpu_freelist.h"
+#include "memalloc.h"
 #include "bpf_lru_list.h"
 #include "map_in_map.h"
 
@@ -89,6 +90,11 @@ struct bucket {
 #define HASHTAB_MAP_LOCK_COUNT 8
 #define HASHTAB_MAP_LOCK_MASK (HASHTAB_MAP_LOCK_COUNT - 1)
 
+/* keys and values of this many bytes are gathered before a batch operation
+ * copies them to user space
+ */
+#define HTAB_BATCH_BUF_SIZE (64 * 1024)
+
 struct bpf_htab {
 	struct bpf_map map;
 	struct bucket *buckets;
@@ -96,6 +102,7 @@ struct bpf_htab {
 	union {
 		struct pcpu_freelist freelist;
 		struct bpf_lru lru;
+		struct bpf_mem_alloc ma;	/* !prealloc */
 	};
 	struct htab_elem *__percpu *extra_elems;
 	atomic_t count;	/* number of elements in this hashtable */
@@ -517,6 +524,11 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 			if (err)
 				goto free_prealloc;
 		}
+	} else {
+		err = bpf_mem_alloc_init(&htab->ma, &htab->map,
+					 htab->elem_size);
+		if (err)
+			goto free_map_locked;
 	}
 
 	return &htab->map;
@@ -723,7 +735,12 @@ static bool htab_lru_map_delete_node(void *arg, struct bpf_lru_node *node)
 
 	htab_unlock_bucket(htab, b, tgt_l->hash, flags);
 
-	return l == tgt_l;
+	if (l != tgt_l)
+		return false;
+
+	/* the evicted element is about to be reused */
+	check_and_free_timer(htab, l);
+	return true;
 }
 
 /* Called from syscall */
@@ -785,11 +802,19 @@ static int htab_map_get_next_key(struct bpf_map *map, void *key, void *next_key)
 	return -ENOENT;
 }
 
+static void check_and_free_timer(struct bpf_htab *htab, struct htab_elem *elem)
+{
+	if (unlikely(map_value_has_timer(&htab->map)))
+		bpf_timer_cancel_and_free(elem->key +
+					  round_up(htab->map.key_size, 8) +
+					  htab->map.timer_off);
+}
+
 static void htab_elem_free(struct bpf_htab *htab, struct htab_elem *l)
 {
 	if (htab->map.map_type == BPF_MAP_TYPE_PERCPU_HASH)
 		free_percpu(htab_elem_get_ptr(l, htab->map.key_size));
-	kfree(l);
+	bpf_mem_cache_free(&htab->ma, l);
 }
 
 static void htab_elem_free_rcu(struct rcu_head *head)
@@ -814,13 +839,19 @@ static void htab_put_fd_value(struct bpf_htab *htab, struct htab_elem *l)
 static void free_htab_elem(struct bpf_htab *htab, struct htab_elem *l)
 {
 	htab_put_fd_value(htab, l);
+	check_and_free_timer(htab, l);
 
 	if (htab_is_prealloc(htab)) {
 		__pcpu_freelist_push(&htab->freelist, &l->fnode);
-	} else {
+	} else if (htab->map.map_type == BPF_MAP_TYPE_PERCPU_HASH) {
+		/* the per-cpu value must outlive RCU readers as well */
 		atomic_dec(&htab->count);
 		l->htab = htab;
 		call_rcu(&l->rcu, htab_elem_free_rcu);
+	} else {
+		/* bpf_mem_cache_free() waits for a grace period itself */
+		atomic_dec(&htab->count);
+		htab_elem_free(htab, l);
 	}
 }
 
@@ -892,6 +923,7 @@ static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab, void *key,
 			pl_new = this_cpu_ptr(htab->extra_elems);
 			l_new = *pl_new;
 			htab_put_fd_value(htab, old_elem);
+			check_and_free_timer(htab, old_elem);
 			*pl_new = old_elem;
 		} else {
 			struct pcpu_freelist_node *l;
@@ -912,14 +944,12 @@ static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab, void *key,
 				l_new = ERR_PTR(-E2BIG);
 				goto dec_count;
 			}
-		l_new = bpf_map_kmalloc_node(&htab->map, htab->elem_size,
-					     GFP_ATOMIC | __GFP_NOWARN,
-					     htab->map.numa_node);
+		l_new = bpf_mem_cache_alloc(&htab->ma);
 		if (!l_new) {
 			l_new = ERR_PTR(-ENOMEM);
 			goto dec_count;
 		}
-		check_and_init_map_lock(&htab->map,
+		check_and_init_map_value(&htab->map,
 					l_new->key + round_up(key_size, 8));
 	}
 
@@ -933,7 +963,7 @@ static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab, void *key,
 			pptr = bpf_map_alloc_percpu(&htab->map, size, 8,
 						    GFP_ATOMIC | __GFP_NOWARN);
 			if (!pptr) {
-				kfree(l_new);
+				bpf_mem_cache_free(&htab->ma, l_new);
 				l_new = ERR_PTR(-ENOMEM);
 				goto dec_count;
 			}
@@ -1067,6 +1097,12 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 	return ret;
 }
 
+static void htab_lru_push_free(struct bpf_htab *htab, struct htab_elem *elem)
+{
+	check_and_free_timer(htab, elem);
+	bpf_lru_push_free(&htab->lru, &elem->lru_node);
+}
+
 static int htab_lru_map_update_elem(struct bpf_map *map, void *key, void *value,
 				    u64 map_flags)
 {
@@ -1127,7 +1163,7 @@ static int htab_lru_map_update_elem(struct bpf_map *map, void *key, void *value,
 	if (ret)
 		bpf_lru_push_free(&htab->lru, &l_new->lru_node);
 	else if (l_old)
-		bpf_lru_push_free(&htab->lru, &l_old->lru_node);
+		htab_lru_push_free(htab, l_old);
 
 	return ret;
 }
@@ -1332,7 +1368,7 @@ static int htab_lru_map_delete_elem(struct bpf_map *map, void *key)
 
 	htab_unlock_bucket(htab, b, hash, flags);
 	if (l)
-		bpf_lru_push_free(&htab->lru, &l->lru_node);
+		htab_lru_push_free(htab, l);
 	return ret;
 }
 
@@ -1353,6 +1389,53 @@ static void delete_all_elements(struct bpf_htab *htab)
 }
 
 /* Called when map->refcnt goes to zero, either from workqueue or from syscall */
+static void htab_free_prealloced_timers(struct bpf_htab *htab)
+{
+	u32 num_entries = htab->map.max_entries;
+	int i;
+
+	if (!htab_is_lru(htab))
+		num_entries += num_possible_cpus();
+
+	for (i = 0; i < num_entries; i++) {
+		check_and_free_timer(htab, get_htab_elem(htab, i));
+		cond_resched();
+	}
+}
+
+static void htab_free_malloced_timers(struct bpf_htab *htab)
+{
+	int i;
+
+	rcu_read_lock();
+	for (i = 0; i < htab->n_buckets; i++) {
+		struct hlist_nulls_head *head = select_bucket(htab, i);
+		struct hlist_nulls_node *n;
+		struct htab_elem *l;
+
+		hlist_nulls_for_each_entry(l, n, head, hash_node)
+			check_and_free_timer(htab, l);
+		cond_resched_rcu();
+	}
+	rcu_read_unlock();
+}
+
+/* Called when the last user space reference to a map with timers is gone:
+ * don't leave timers armed by programs that nobody can reach anymore.
+ */
+static void htab_map_free_timers(struct bpf_map *map)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+
+	if (likely(!map_value_has_timer(map)) || htab_is_percpu(htab))
+		return;
+
+	if (htab_is_prealloc(htab))
+		htab_free_prealloced_timers(htab);
+	else
+		htab_free_malloced_timers(htab);
+}
+
 static void htab_map_free(struct bpf_map *map)
 {
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
@@ -1367,10 +1450,13 @@ static void htab_map_free(struct bpf_map *map)
 	 * not have executed. Wait for them.
 	 */
 	rcu_barrier();
-	if (!htab_is_prealloc(htab))
+	htab_map_free_timers(map);
+	if (!htab_is_prealloc(htab)) {
 		delete_all_elements(htab);
-	else
+		bpf_mem_alloc_destroy(&htab->ma);
+	} else {
 		prealloc_destroy(htab);
+	}
 
 	free_percpu(htab->extra_elems);
 	bpf_map_area_free(htab->buckets);
@@ -1414,13 +1500,14 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 	void __user *uvalues = u64_to_user_ptr(attr->batch.values);
 	void __user *ukeys = u64_to_user_ptr(attr->batch.keys);
 	void __user *ubatch = u64_to_user_ptr(attr->batch.in_batch);
-	u32 batch, max_count, size, bucket_size;
+	u32 batch, max_count, size, buf_size, buf_cnt;
 	struct htab_elem *node_to_free = NULL;
 	u64 elem_map_flags, map_flags;
 	struct hlist_nulls_head *head;
 	struct hlist_nulls_node *n;
 	unsigned long flags = 0;
 	bool locked = false;
+	bool done = false;
 	struct htab_elem *l;
 	struct bucket *b;
 	int ret = 0;
@@ -1455,17 +1542,21 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 	if (is_percpu)
 		value_size = size * num_possible_cpus();
 	total = 0;
+	buf_cnt = 0;
 	/* while experimenting with hash tables with sizes ranging from 10 to
-	 * 1000, it was observed that a bucket can have upto 5 entries.
+	 * 1000, it was observed that a bucket can have upto 5 entries.  Room
+	 * for more is kept so that the entries of many buckets are copied to
+	 * user space at once.
 	 */
-	bucket_size = 5;
+	buf_size = HTAB_BATCH_BUF_SIZE / (key_size + value_size);
+	buf_size = max_t(u32, min(buf_size, max_count), 5);
 
 alloc:
 	/* We cannot do copy_from_user or copy_to_user inside
 	 * the rcu_read_lock. Allocate enough space here.
 	 */
-	keys = kvmalloc(key_size * bucket_size, GFP_USER | __GFP_NOWARN);
-	values = kvmalloc(value_size * bucket_size, GFP_USER | __GFP_NOWARN);
+	keys = kvmalloc(key_size * buf_size, GFP_USER | __GFP_NOWARN);
+	values = kvmalloc(value_size * buf_size, GFP_USER | __GFP_NOWARN);
 	if (!keys || !values) {
 		ret = -ENOMEM;
 		goto after_loop;
@@ -1475,15 +1566,18 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 	bpf_disable_instrumentation();
 	rcu_read_lock();
 again_nocopy:
-	dst_key = keys;
-	dst_val = values;
+	dst_key = keys + buf_cnt * key_size;
+	dst_val = values + buf_cnt * value_size;
 	b = &htab->buckets[batch];
 	head = &b->head;
 	/* do not grab the lock unless need it (bucket_cnt > 0). */
 	if (locked) {
 		ret = htab_lock_bucket(htab, b, batch, &flags);
-		if (ret)
-			goto next_batch;
+		if (ret) {
+			rcu_read_unlock();
+			bpf_enable_instrumentation();
+			goto flush;
+		}
 	}
 
 	bucket_cnt = 0;
@@ -1495,8 +1589,8 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 		goto again_nocopy;
 	}
 
-	if (bucket_cnt > (max_count - total)) {
-		if (total == 0)
+	if (bucket_cnt > (max_count - total - buf_cnt)) {
+		if (total + buf_cnt == 0)
 			ret = -ENOSPC;
 		/* Note that since bucket_cnt > 0 here, it is implicit
 		 * that the locked was grabbed, so release it.
@@ -1504,17 +1598,21 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 		htab_unlock_bucket(htab, b, batch, flags);
 		rcu_read_unlock();
 		bpf_enable_instrumentation();
-		goto after_loop;
+		done = true;
+		goto flush;
 	}
 
-	if (bucket_cnt > bucket_size) {
-		bucket_size = bucket_cnt;
+	if (bucket_cnt > buf_size - buf_cnt) {
 		/* Note that since bucket_cnt > 0 here, it is implicit
 		 * that the locked was grabbed, so release it.
 		 */
 		htab_unlock_bucket(htab, b, batch, flags);
 		rcu_read_unlock();
 		bpf_enable_instrumentation();
+		if (buf_cnt)
+			/* make room and come back to this bucket */
+			goto flush;
+		buf_size = bucket_cnt;
 		kvfree(keys);
 		kvfree(values);
 		goto alloc;
@@ -1544,7 +1642,7 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 						      true);
 			else
 				copy_map_value(map, dst_val, value);
-			check_and_init_map_lock(map, dst_val);
+			check_and_init_map_value(map, dst_val);
 		}
 		if (do_delete) {
 			hlist_nulls_del_rcu(&l->hash_node);
@@ -1571,30 +1669,35 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 	while (node_to_free) {
 		l = node_to_free;
 		node_to_free = node_to_free->batch_flink;
-		bpf_lru_push_free(&htab->lru, &l->lru_node);
+		htab_lru_push_free(htab, l);
 	}
 
+	buf_cnt += bucket_cnt;
+
 next_batch:
-	/* If we are not copying data, we can go to next bucket and avoid
-	 * unlocking the rcu.
+	/* Keep walking buckets without unlocking the rcu as long as the
+	 * buffer has room left.
 	 */
-	if (!bucket_cnt && (batch + 1 < htab->n_buckets)) {
-		batch++;
+	batch++;
+	if (batch < htab->n_buckets && buf_cnt < buf_size)
 		goto again_nocopy;
-	}
 
 	rcu_read_unlock();
 	bpf_enable_instrumentation();
-	if (bucket_cnt && (copy_to_user(ukeys + total * key_size, keys,
-	    key_size * bucket_cnt) ||
+
+flush:
+	if (buf_cnt && (copy_to_user(ukeys + total * key_size, keys,
+	    key_size * buf_cnt) ||
 	    copy_to_user(uvalues + total * value_size, values,
-	    value_size * bucket_cnt))) {
+	    value_size * buf_cnt))) {
 		ret = -EFAULT;
-		goto after_loop;
+		goto out;
 	}
 
-	total += bucket_cnt;
-	batch++;
+	total += buf_cnt;
+	buf_cnt = 0;
+	if (ret || done)
+		goto after_loop;
 	if (batch >= htab->n_buckets) {
 		ret = -ENOENT;
 		goto after_loop;
@@ -1602,9 +1705,6 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 	goto again;
 
 after_loop:
-	if (ret == -EFAULT)
-		goto out;
-
 	/* copy # of entries and next batch */
 	ubatch = u64_to_user_ptr(attr->batch.out_batch);
 	if (copy_to_user(ubatch, &batch, sizeof(batch)) ||
@@ -1932,6 +2032,7 @@ const struct bpf_map_ops htab_map_ops = {
 	.map_alloc_check = htab_map_alloc_check,
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
+	.map_release_uref = htab_map_free_timers,
 	.map_get_next_key = htab_map_get_next_key,
 	.map_lookup_elem = htab_map_lookup_elem,
 	.map_update_elem = htab_map_update_elem,
@@ -1946,12 +2047,22 @@ const struct bpf_map_ops htab_map_ops = {
 	.iter_seq_info = &iter_seq_info,
 };
 
+static void htab_lru_map_show_fdinfo(const struct bpf_map *map,
+				     struct seq_file *m)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+
+	seq_printf(m, "lru_evictions:\t%lu\n",
+		   atomic_long_read(&htab->lru.nr_evicted));
+}
+
 static int htab_lru_map_btf_id;
 const struct bpf_map_ops htab_lru_map_ops = {
 	.map_meta_equal = bpf_map_meta_equal,
 	.map_alloc_check = htab_map_alloc_check,
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
+	.map_release_uref = htab_map_free_timers,
 	.map_get_next_key = htab_map_get_next_key,
 	.map_lookup_elem = htab_lru_map_lookup_elem,
 	.map_lookup_elem_sys_only = htab_lru_map_lookup_elem_sys,
@@ -1959,6 +2070,7 @@ const struct bpf_map_ops htab_lru_map_ops = {
 	.map_delete_elem = htab_lru_map_delete_elem,
 	.map_gen_lookup = htab_lru_map_gen_lookup,
 	.map_seq_show_elem = htab_map_seq_show_elem,
+	.map_show_fdinfo = htab_lru_map_show_fdinfo,
 	.map_set_for_each_callback_args = map_set_for_each_callback_args,
 	.map_for_each_callback = bpf_for_each_hash_elem,
 	BATCH_OPS(htab_lru),
@@ -2099,6 +2211,7 @@ const struct bpf_map_ops htab_lru_percpu_map_ops = {
 	.map_update_elem = htab_lru_percpu_map_update_elem,
 	.map_delete_elem = htab_lru_map_delete_elem,
 	.map_seq_show_elem = htab_percpu_map_seq_show_elem,
+	.map_show_fdinfo = htab_lru_map_show_fdinfo,
 	.map_set_for_each_callback_args = map_set_for_each_callback_args,
 	.map_for_each_callback = bpf_for_each_hash_elem,
 	BATCH_OPS(htab_lru_percpu),
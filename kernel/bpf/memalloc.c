@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Per-CPU caches of map elements that can be used from any context.
+ *
+ * kmalloc() cannot be called from NMI and is unsafe from tracing programs
+ * that may run with arbitrary locks held.  Each CPU therefore keeps a small
+ * list of ready objects that allocations take from with only interrupts
+ * disabled.  When the list drops below its low watermark, an irq_work
+ * refills it with GFP_NOWAIT allocations charged to the map's memory cgroup.
+ *
+ * Freed objects are queued on a lockless list and handed to call_rcu() in
+ * batches, so that programs and syscalls walking the map under RCU never
+ * see an object reused or released under them.
+ */
+#include <linux/bpf.h>
+#include <linux/irq_work.h>
+#include <linux/llist.h>
+#include <linux/slab.h>
+#include <asm/local.h>
+#include "memalloc.h"
+
+/*
+ * Every object is preceded by the list node used while it is cached or
+ * waiting to be freed, so that freeing leaves the object itself intact for
+ * RCU readers.
+ */
+#define LLIST_NODE_SZ	sizeof(struct llist_node)
+
+struct bpf_mem_cache {
+	/* ready objects, only touched with irqs off while holding @active */
+	struct llist_head free_llist;
+	local_t active;
+	int free_cnt;
+	int low_watermark;
+	int high_watermark;
+
+	const struct bpf_map *map;
+	u32 unit_size;
+	struct irq_work refill_work;
+
+	/* freed objects, released after the next grace period */
+	struct llist_head free_by_rcu;
+	struct llist_node *waiting_for_gp;
+	atomic_t call_rcu_in_progress;
+	struct rcu_head rcu;
+};
+
+static struct llist_node *__llist_del_first(struct llist_head *head)
+{
+	struct llist_node *entry = head->first;
+
+	if (entry)
+		head->first = entry->next;
+	return entry;
+}
+
+static struct llist_node *__alloc(struct bpf_mem_cache *c, gfp_t flags)
+{
+	return bpf_map_kmalloc_node(c->map, c->unit_size, flags | __GFP_NOWARN,
+				    c->map->numa_node);
+}
+
+/* Called from the refill irq_work of the CPU owning @c */
+static void alloc_bulk(struct bpf_mem_cache *c, int cnt)
+{
+	struct llist_node *obj;
+	unsigned long flags;
+
+	while (cnt--) {
+		obj = __alloc(c, GFP_NOWAIT);
+		if (!obj)
+			break;
+		local_irq_save(flags);
+		/* Only an NMI can get here meanwhile, and it backs off. */
+		WARN_ON_ONCE(local_inc_return(&c->active) != 1);
+		__llist_add(obj, &c->free_llist);
+		c->free_cnt++;
+		local_dec(&c->active);
+		local_irq_restore(flags);
+	}
+}
+
+static void free_all(struct llist_node *llnode)
+{
+	struct llist_node *pos, *t;
+
+	llist_for_each_safe(pos, t, llnode)
+		kfree(pos);
+}
+
+static void do_call_rcu(struct bpf_mem_cache *c);
+
+static void __free_rcu(struct rcu_head *head)
+{
+	struct bpf_mem_cache *c = container_of(head, struct bpf_mem_cache, rcu);
+
+	free_all(c->waiting_for_gp);
+	c->waiting_for_gp = NULL;
+	atomic_set(&c->call_rcu_in_progress, 0);
+	/* pick up what was freed during the grace period */
+	do_call_rcu(c);
+}
+
+/* Only one batch per cache waits for a grace period at any time. */
+static void do_call_rcu(struct bpf_mem_cache *c)
+{
+	struct llist_node *llnode;
+
+	do {
+		if (atomic_xchg(&c->call_rcu_in_progress, 1))
+			return;
+		llnode = llist_del_all(&c->free_by_rcu);
+		if (llnode) {
+			c->waiting_for_gp = llnode;
+			call_rcu(&c->rcu, __free_rcu);
+			return;
+		}
+		atomic_set(&c->call_rcu_in_progress, 0);
+		/* pairs with the barrier implied by llist_add() */
+		smp_mb();
+	} while (!llist_empty(&c->free_by_rcu));
+}
+
+static void bpf_mem_refill(struct irq_work *work)
+{
+	struct bpf_mem_cache *c = container_of(work, struct bpf_mem_cache,
+					       refill_work);
+	/* racy read, at worst a few objects too many are allocated */
+	int cnt = READ_ONCE(c->free_cnt);
+
+	if (cnt < c->low_watermark)
+		alloc_bulk(c, c->high_watermark - cnt);
+	do_call_rcu(c);
+}
+
+int bpf_mem_alloc_init(struct bpf_mem_alloc *ma, const struct bpf_map *map,
+		       u32 size)
+{
+	struct bpf_mem_cache *c;
+	struct llist_node *obj;
+	int cpu, i, prefill;
+
+	ma->cache = bpf_map_alloc_percpu(map, sizeof(*c), __alignof__(*c),
+					 GFP_USER);
+	if (!ma->cache)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		c = per_cpu_ptr(ma->cache, cpu);
+		c->map = map;
+		c->unit_size = size + LLIST_NODE_SZ;
+		/* keep roughly the same amount of memory cached per CPU */
+		if (c->unit_size <= 256) {
+			c->low_watermark = 32;
+			c->high_watermark = 96;
+		} else {
+			c->low_watermark = max(32 * 256 / c->unit_size, 1U);
+			c->high_watermark = max(96 * 256 / c->unit_size, 3U);
+		}
+		init_irq_work(&c->refill_work, bpf_mem_refill);
+
+		/* the map is not visible yet, no need for @active */
+		prefill = c->unit_size <= 256 ? 4 : 1;
+		for (i = 0; i < prefill; i++) {
+			obj = __alloc(c, GFP_KERNEL);
+			if (!obj)
+				break;
+			__llist_add(obj, &c->free_llist);
+			c->free_cnt++;
+		}
+	}
+	return 0;
+}
+
+void bpf_mem_alloc_destroy(struct bpf_mem_alloc *ma)
+{
+	struct bpf_mem_cache *c;
+	bool busy;
+	int cpu;
+
+	if (!ma->cache)
+		return;
+
+	for_each_possible_cpu(cpu)
+		irq_work_sync(&per_cpu_ptr(ma->cache, cpu)->refill_work);
+
+	/* __free_rcu() may queue the next batch, wait until all are done */
+	do {
+		rcu_barrier();
+		busy = false;
+		for_each_possible_cpu(cpu) {
+			c = per_cpu_ptr(ma->cache, cpu);
+			if (atomic_read(&c->call_rcu_in_progress))
+				busy = true;
+		}
+	} while (busy);
+
+	for_each_possible_cpu(cpu) {
+		c = per_cpu_ptr(ma->cache, cpu);
+		free_all(__llist_del_all(&c->free_llist));
+		free_all(llist_del_all(&c->free_by_rcu));
+	}
+	free_percpu(ma->cache);
+	ma->cache = NULL;
+}
+
+void *bpf_mem_cache_alloc(struct bpf_mem_alloc *ma)
+{
+	struct llist_node *llnode = NULL;
+	struct bpf_mem_cache *c;
+	unsigned long flags;
+	int cnt = 0;
+
+	local_irq_save(flags);
+	c = this_cpu_ptr(ma->cache);
+	/* fail rather than corrupt the list when we interrupted its user */
+	if (local_inc_return(&c->active) == 1) {
+		llnode = __llist_del_first(&c->free_llist);
+		if (llnode)
+			cnt = --c->free_cnt;
+	}
+	local_dec(&c->active);
+	if (cnt < c->low_watermark)
+		irq_work_queue(&c->refill_work);
+	local_irq_restore(flags);
+
+	return llnode ? (void *)llnode + LLIST_NODE_SZ : NULL;
+}
+
+void bpf_mem_cache_free(struct bpf_mem_alloc *ma, void *ptr)
+{
+	struct bpf_mem_cache *c = raw_cpu_ptr(ma->cache);
+
+	if (!ptr)
+		return;
+
+	llist_add(ptr - LLIST_NODE_SZ, &c->free_by_rcu);
+	/* call_rcu() is not NMI safe, let the irq_work of this CPU do it */
+	if (in_nmi())
+		irq_work_queue(&c->refill_work);
+	else
+		do_call_rcu(c);
+}
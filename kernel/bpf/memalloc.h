@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef __BPF_MEMALLOC_H__
+#define __BPF_MEMALLOC_H__
+#include <linux/types.h>
+#include <linux/percpu.h>
+
+struct bpf_map;
+struct bpf_mem_cache;
+
+/*
+ * Allocator of fixed size objects for run-time allocated map elements.
+ * bpf_mem_cache_alloc() and bpf_mem_cache_free() may be called from any
+ * context, including NMI.  Freed objects are released after a RCU grace
+ * period, memory is charged to the memory cgroup of @map.
+ */
+struct bpf_mem_alloc {
+	struct bpf_mem_cache __percpu *cache;
+};
+
+int bpf_mem_alloc_init(struct bpf_mem_alloc *ma, const struct bpf_map *map,
+		       u32 size);
+void bpf_mem_alloc_destroy(struct bpf_mem_alloc *ma);
+void *bpf_mem_cache_alloc(struct bpf_mem_alloc *ma);
+void bpf_mem_cache_free(struct bpf_mem_alloc *ma, void *ptr);
+#endif
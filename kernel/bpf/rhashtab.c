@@ -0,0 +1,295 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Resizable hash map on top of rhashtable.
+ *
+ * Unlike BPF_MAP_TYPE_HASH the number of buckets is not fixed at map
+ * creation: the table grows past 75% and shrinks below 30% utilization
+ * in the background, rehashing incrementally while lookups keep running
+ * locklessly under RCU.  max_entries only bounds the number of elements.
+ */
+#include <linux/bpf.h>
+#include <linux/btf.h>
+#include <linux/rhashtable.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include "memalloc.h"
+
+#define RHTAB_CREATE_FLAG_MASK	(BPF_F_NUMA_NODE | BPF_F_ACCESS_MASK)
+
+struct bpf_rhtab {
+	struct bpf_map map;
+	struct rhashtable ht;
+	struct rhashtable_params params;
+	struct bpf_mem_alloc ma;
+	atomic_t count;
+	u32 elem_size;
+};
+
+struct rhtab_elem {
+	struct rhash_head node;
+	char key[] __aligned(8);
+};
+
+static inline void *rhtab_elem_value(struct rhtab_elem *l, u32 key_size)
+{
+	return l->key + round_up(key_size, 8);
+}
+
+static int rhtab_map_alloc_check(union bpf_attr *attr)
+{
+	if (attr->map_flags & ~RHTAB_CREATE_FLAG_MASK ||
+	    !bpf_map_flags_access_ok(attr->map_flags))
+		return -EINVAL;
+
+	if (attr->max_entries == 0 || attr->key_size == 0 ||
+	    attr->value_size == 0)
+		return -EINVAL;
+
+	if ((u64)attr->key_size + attr->value_size >= KMALLOC_MAX_SIZE -
+	   sizeof(struct rhtab_elem))
+		return -E2BIG;
+
+	return 0;
+}
+
+static struct bpf_map *rhtab_map_alloc(union bpf_attr *attr)
+{
+	struct bpf_rhtab *rhtab;
+	int err;
+
+	rhtab = kzalloc(sizeof(*rhtab), GFP_USER | __GFP_ACCOUNT);
+	if (!rhtab)
+		return ERR_PTR(-ENOMEM);
+
+	bpf_map_init_from_attr(&rhtab->map, attr);
+
+	rhtab->elem_size = sizeof(struct rhtab_elem) +
+			   round_up(rhtab->map.key_size, 8) +
+			   round_up(rhtab->map.value_size, 8);
+
+	rhtab->params.key_len = rhtab->map.key_size;
+	rhtab->params.key_offset = offsetof(struct rhtab_elem, key);
+	rhtab->params.head_offset = offsetof(struct rhtab_elem, node);
+	rhtab->params.automatic_shrinking = true;
+
+	err = rhashtable_init(&rhtab->ht, &rhtab->params);
+	if (err)
+		goto free_rhtab;
+
+	err = bpf_mem_alloc_init(&rhtab->ma, &rhtab->map, rhtab->elem_size);
+	if (err)
+		goto free_ht;
+
+	return &rhtab->map;
+
+free_ht:
+	rhashtable_destroy(&rhtab->ht);
+free_rhtab:
+	kfree(rhtab);
+	return ERR_PTR(err);
+}
+
+static void rhtab_free_elem(void *ptr, void *arg)
+{
+	struct bpf_rhtab *rhtab = arg;
+
+	bpf_mem_cache_free(&rhtab->ma, ptr);
+}
+
+static void rhtab_map_free(struct bpf_map *map)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+
+	/* No BPF program nor the syscall side can reach the map anymore, so
+	 * elements can be handed back without unlinking them one by one.
+	 */
+	rhashtable_free_and_destroy(&rhtab->ht, rhtab_free_elem, rhtab);
+	bpf_mem_alloc_destroy(&rhtab->ma);
+	kfree(rhtab);
+}
+
+static struct rhtab_elem *rhtab_lookup(struct bpf_rhtab *rhtab, void *key)
+{
+	return rhashtable_lookup(&rhtab->ht, key, rhtab->params);
+}
+
+/* Called from syscall or from eBPF program */
+static void *rhtab_map_lookup_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l;
+
+	WARN_ON_ONCE(!rcu_read_lock_held() && !rcu_read_lock_bh_held());
+
+	l = rhtab_lookup(rhtab, key);
+	if (l)
+		return rhtab_elem_value(l, map->key_size);
+
+	return NULL;
+}
+
+/* Called from syscall or from eBPF program */
+static int rhtab_map_update_elem(struct bpf_map *map, void *key, void *value,
+				 u64 map_flags)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l_new, *l_old;
+	int ret;
+
+	if (unlikely(map_flags > BPF_EXIST))
+		/* unknown flags */
+		return -EINVAL;
+
+	WARN_ON_ONCE(!rcu_read_lock_held() && !rcu_read_lock_bh_held());
+
+	l_new = bpf_mem_cache_alloc(&rhtab->ma);
+	if (!l_new)
+		return -ENOMEM;
+
+	memcpy(l_new->key, key, map->key_size);
+	copy_map_value(map, rhtab_elem_value(l_new, map->key_size), value);
+
+again:
+	l_old = rhtab_lookup(rhtab, key);
+	if (!l_old) {
+		if (map_flags == BPF_EXIST) {
+			ret = -ENOENT;
+			goto err;
+		}
+
+		if (atomic_inc_return(&rhtab->count) > map->max_entries) {
+			atomic_dec(&rhtab->count);
+			ret = -E2BIG;
+			goto err;
+		}
+
+		l_old = rhashtable_lookup_get_insert_fast(&rhtab->ht,
+							  &l_new->node,
+							  rhtab->params);
+		if (!l_old)
+			return 0;
+
+		/* lost the race against another insert of the same key */
+		atomic_dec(&rhtab->count);
+		if (IS_ERR(l_old)) {
+			ret = PTR_ERR(l_old);
+			goto err;
+		}
+	}
+
+	if (map_flags == BPF_NOEXIST) {
+		ret = -EEXIST;
+		goto err;
+	}
+
+	ret = rhashtable_replace_fast(&rhtab->ht, &l_old->node, &l_new->node,
+				      rhtab->params);
+	if (ret == -ENOENT)
+		/* l_old was deleted or replaced meanwhile */
+		goto again;
+	if (ret)
+		goto err;
+
+	bpf_mem_cache_free(&rhtab->ma, l_old);
+	return 0;
+err:
+	bpf_mem_cache_free(&rhtab->ma, l_new);
+	return ret;
+}
+
+/* Called from syscall or from eBPF program */
+static int rhtab_map_delete_elem(struct bpf_map *map, void *key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct rhtab_elem *l;
+	int ret;
+
+	WARN_ON_ONCE(!rcu_read_lock_held() && !rcu_read_lock_bh_held());
+
+	l = rhtab_lookup(rhtab, key);
+	if (!l)
+		return -ENOENT;
+
+	ret = rhashtable_remove_fast(&rhtab->ht, &l->node, rhtab->params);
+	if (ret)
+		return ret;
+
+	atomic_dec(&rhtab->count);
+	bpf_mem_cache_free(&rhtab->ma, l);
+	return 0;
+}
+
+/* Called from syscall.  Entries that move to a new table while the walk
+ * is in progress may be skipped or returned twice.
+ */
+static int rhtab_map_get_next_key(struct bpf_map *map, void *key,
+				  void *next_key)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct bucket_table *tbl;
+	struct rhash_head *pos;
+	struct rhtab_elem *l;
+	bool found = false;
+	unsigned int i = 0;
+
+	WARN_ON_ONCE(!rcu_read_lock_held());
+
+	tbl = rht_dereference_rcu(rhtab->ht.tbl, &rhtab->ht);
+
+	if (key) {
+		i = rht_key_hashfn(&rhtab->ht, tbl, key, rhtab->params);
+		rht_for_each_entry_rcu(l, pos, tbl, i, node) {
+			if (found) {
+				memcpy(next_key, l->key, map->key_size);
+				return 0;
+			}
+			if (!memcmp(l->key, key, map->key_size))
+				found = true;
+		}
+		/* key was not found, restart from the first element */
+		i = found ? i + 1 : 0;
+	}
+
+	for (; i < tbl->size; i++) {
+		rht_for_each_entry_rcu(l, pos, tbl, i, node) {
+			memcpy(next_key, l->key, map->key_size);
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+static void rhtab_map_show_fdinfo(const struct bpf_map *map,
+				  struct seq_file *m)
+{
+	struct bpf_rhtab *rhtab = container_of(map, struct bpf_rhtab, map);
+	struct bucket_table *tbl;
+	unsigned int size;
+
+	rcu_read_lock();
+	tbl = rht_dereference_rcu(rhtab->ht.tbl, &rhtab->ht);
+	size = tbl->size;
+	rcu_read_unlock();
+
+	seq_printf(m,
+		   "elements:\t%d\n"
+		   "buckets:\t%u\n",
+		   atomic_read(&rhtab->count),
+		   size);
+}
+
+static int rhtab_map_btf_id;
+const struct bpf_map_ops rhtab_map_ops = {
+	.map_meta_equal = bpf_map_meta_equal,
+	.map_alloc_check = rhtab_map_alloc_check,
+	.map_alloc = rhtab_map_alloc,
+	.map_free = rhtab_map_free,
+	.map_get_next_key = rhtab_map_get_next_key,
+	.map_lookup_elem = rhtab_map_lookup_elem,
+	.map_update_elem = rhtab_map_update_elem,
+	.map_delete_elem = rhtab_map_delete_elem,
+	.map_show_fdinfo = rhtab_map_show_fdinfo,
+	.map_btf_name = "bpf_rhtab",
+	.map_btf_id = &rhtab_map_btf_id,
+};
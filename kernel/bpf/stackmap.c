@@ -10,14 +10,25 @@
 #include <linux/irq_work.h>
 #include <linux/btf_ids.h>
 #include <linux/buildid.h>
+#include <linux/seq_file.h>
+#include <linux/task_work.h>
 #include "percpu_freelist.h"
 
 #define STACK_CREATE_FLAG_MASK					\
 	(BPF_F_NUMA_NODE | BPF_F_RDONLY | BPF_F_WRONLY |	\
 	 BPF_F_STACK_BUILD_ID)
 
+/* Number of buckets starting at the hashed one a stack may be stored in */
+#define STACK_MAP_MAX_PROBES	4
+
 struct stack_map_bucket {
 	struct pcpu_freelist_node fnode;
+	/* deferred build_id lookup, see stack_map_queue_build_id() */
+	struct callback_head build_id_work;
+	struct bpf_stack_map *smap;
+	/* held by smap->buckets[] and by a pending build_id_work */
+	atomic_t refcnt;
+	u32 id;
 	u32 hash;
 	u32 nr;
 	u64 data[];
@@ -28,6 +39,12 @@ struct bpf_stack_map {
 	void *elems;
 	struct pcpu_freelist freelist;
 	u32 n_buckets;
+	/* stacks not stored because all their buckets were taken */
+	atomic_long_t drops_collision;
+	/* stacks not stored because all elements were in use */
+	atomic_long_t drops_nomem;
+	/* user stacks whose build_id lookup was deferred to task_work */
+	atomic_long_t build_id_deferred;
 	struct stack_map_bucket *buckets[];
 };
 
@@ -61,6 +78,23 @@ static inline int stack_map_data_size(struct bpf_map *map)
 		sizeof(struct bpf_stack_build_id) : sizeof(u64);
 }
 
+static struct stack_map_bucket *stack_map_pop_bucket(struct bpf_stack_map *smap)
+{
+	struct stack_map_bucket *bucket;
+
+	bucket = (struct stack_map_bucket *)pcpu_freelist_pop(&smap->freelist);
+	if (bucket)
+		atomic_set(&bucket->refcnt, 1);
+	return bucket;
+}
+
+static void stack_map_put_bucket(struct bpf_stack_map *smap,
+				 struct stack_map_bucket *bucket)
+{
+	if (atomic_dec_and_test(&bucket->refcnt))
+		pcpu_freelist_push(&smap->freelist, &bucket->fnode);
+}
+
 static int prealloc_elems_and_freelist(struct bpf_stack_map *smap)
 {
 	u32 elem_size = sizeof(struct stack_map_bucket) + smap->map.value_size;
@@ -144,11 +178,41 @@ static struct bpf_map *stack_map_alloc(union bpf_attr *attr)
 	return ERR_PTR(err);
 }
 
-static void stack_map_get_build_id_offset(struct bpf_stack_build_id *id_offs,
+/* Turn the ips held by @id_offs in BPF_STACK_BUILD_ID_IP form into
+ * build_id+offset pairs.  The caller holds mmap_lock of @mm.
+ */
+static void stack_map_resolve_build_ids(struct mm_struct *mm,
+					struct bpf_stack_build_id *id_offs,
+					u32 trace_nr)
+{
+	struct vm_area_struct *vma;
+	u64 ip;
+	int i;
+
+	for (i = 0; i < trace_nr; i++) {
+		if (id_offs[i].status != BPF_STACK_BUILD_ID_IP)
+			continue;
+
+		ip = id_offs[i].ip;
+		vma = find_vma(mm, ip);
+		if (!vma || build_id_parse(vma, id_offs[i].build_id, NULL)) {
+			/* per entry fall back to ips */
+			memset(id_offs[i].build_id, 0, BUILD_ID_SIZE_MAX);
+			continue;
+		}
+		id_offs[i].offset = (vma->vm_pgoff << PAGE_SHIFT) + ip
+			- vma->vm_start;
+		id_offs[i].status = BPF_STACK_BUILD_ID_VALID;
+	}
+}
+
+/* Returns false if the user stack was left as ips because current->mm
+ * could not be locked from this context.
+ */
+static bool stack_map_get_build_id_offset(struct bpf_stack_build_id *id_offs,
 					  u64 *ips, u32 trace_nr, bool user)
 {
 	int i;
-	struct vm_area_struct *vma;
 	bool irq_work_busy = false;
 	struct stack_map_irq_work *work = NULL;
 
@@ -178,37 +242,85 @@ static void stack_map_get_build_id_offset(struct bpf_stack_build_id *id_offs,
 	 * Same fallback is used for kernel stack (!user) on a stackmap
 	 * with build_id.
 	 */
-	if (!user || !current || !current->mm || irq_work_busy ||
-	    !mmap_read_trylock_non_owner(current->mm)) {
-		/* cannot access current->mm, fall back to ips */
-		for (i = 0; i < trace_nr; i++) {
-			id_offs[i].status = BPF_STACK_BUILD_ID_IP;
-			id_offs[i].ip = ips[i];
-			memset(id_offs[i].build_id, 0, BUILD_ID_SIZE_MAX);
-		}
-		return;
-	}
-
 	for (i = 0; i < trace_nr; i++) {
-		vma = find_vma(current->mm, ips[i]);
-		if (!vma || build_id_parse(vma, id_offs[i].build_id, NULL)) {
-			/* per entry fall back to ips */
-			id_offs[i].status = BPF_STACK_BUILD_ID_IP;
-			id_offs[i].ip = ips[i];
-			memset(id_offs[i].build_id, 0, BUILD_ID_SIZE_MAX);
-			continue;
-		}
-		id_offs[i].offset = (vma->vm_pgoff << PAGE_SHIFT) + ips[i]
-			- vma->vm_start;
-		id_offs[i].status = BPF_STACK_BUILD_ID_VALID;
+		id_offs[i].status = BPF_STACK_BUILD_ID_IP;
+		id_offs[i].ip = ips[i];
+		memset(id_offs[i].build_id, 0, BUILD_ID_SIZE_MAX);
 	}
 
+	if (!user || !current || !current->mm || irq_work_busy ||
+	    !mmap_read_trylock_non_owner(current->mm))
+		/* cannot access current->mm, leave the ips */
+		return false;
+
+	stack_map_resolve_build_ids(current->mm, id_offs, trace_nr);
+
 	if (!work) {
 		mmap_read_unlock_non_owner(current->mm);
 	} else {
 		work->mm = current->mm;
 		irq_work_queue(&work->irq_work);
 	}
+	return true;
+}
+
+/* Runs on return to user space of the task that hit the stack */
+static void stack_map_build_id_workfn(struct callback_head *work)
+{
+	struct stack_map_bucket *bucket, *new_bucket;
+	struct mm_struct *mm = current->mm;
+	struct bpf_stack_map *smap;
+
+	bucket = container_of(work, struct stack_map_bucket, build_id_work);
+	smap = bucket->smap;
+
+	/* the task may be exiting with its mm gone */
+	if (!mm)
+		goto out;
+
+	new_bucket = stack_map_pop_bucket(smap);
+	if (!new_bucket)
+		goto out;
+
+	new_bucket->hash = bucket->hash;
+	new_bucket->nr = bucket->nr;
+	memcpy(new_bucket->data, bucket->data,
+	       bucket->nr * sizeof(struct bpf_stack_build_id));
+
+	mmap_read_lock(mm);
+	stack_map_resolve_build_ids(mm,
+		(struct bpf_stack_build_id *)new_bucket->data, new_bucket->nr);
+	mmap_read_unlock(mm);
+
+	/* the stack id may have been deleted or reused meanwhile */
+	if (cmpxchg(&smap->buckets[bucket->id], bucket, new_bucket) == bucket)
+		stack_map_put_bucket(smap, bucket);
+	else
+		stack_map_put_bucket(smap, new_bucket);
+out:
+	stack_map_put_bucket(smap, bucket);
+	bpf_map_put(&smap->map);
+}
+
+/* Resolve build_ids of the user stack in @bucket, stored as @id, once the
+ * task can sleep on mmap_lock.  The caller holds an extra reference on
+ * @bucket for the work, which is dropped if it cannot be queued.
+ */
+static void stack_map_queue_build_id(struct bpf_stack_map *smap,
+				     struct stack_map_bucket *bucket, u32 id)
+{
+	bucket->smap = smap;
+	bucket->id = id;
+	init_task_work(&bucket->build_id_work, stack_map_build_id_workfn);
+
+	bpf_map_inc(&smap->map);
+	if (task_work_add(current, &bucket->build_id_work, TWA_RESUME)) {
+		/* the program holds a map reference, this is never the last */
+		bpf_map_put(&smap->map);
+		stack_map_put_bucket(smap, bucket);
+		return;
+	}
+	atomic_long_inc(&smap->build_id_deferred);
 }
 
 static struct perf_callchain_entry *
@@ -249,19 +361,48 @@ get_callchain_entry_for_task(struct task_struct *task, u32 init_nr)
 #endif
 }
 
+/* Look for a stored stack with @hash, and @data if not NULL, in the buckets
+ * it may live in.  Also returns the first free one of them in @empty.
+ */
+static int stack_map_find(struct bpf_stack_map *smap, u32 hash,
+			  const void *data, u32 nr, u32 len, int *empty)
+{
+	struct stack_map_bucket *bucket;
+	u32 i, id;
+
+	*empty = -1;
+	for (i = 0; i < STACK_MAP_MAX_PROBES; i++) {
+		id = (hash + i) & (smap->n_buckets - 1);
+		bucket = READ_ONCE(smap->buckets[id]);
+		if (!bucket) {
+			if (*empty < 0)
+				*empty = id;
+			continue;
+		}
+		if (bucket->hash != hash)
+			continue;
+		if (!data || (bucket->nr == nr &&
+			      memcmp(bucket->data, data, len) == 0))
+			return id;
+	}
+
+	return -ENOENT;
+}
+
 static long __bpf_get_stackid(struct bpf_map *map,
 			      struct perf_callchain_entry *trace, u64 flags)
 {
 	struct bpf_stack_map *smap = container_of(map, struct bpf_stack_map, map);
-	struct stack_map_bucket *bucket, *new_bucket, *old_bucket;
+	struct stack_map_bucket *new_bucket, *old_bucket;
 	u32 max_depth = map->value_size / stack_map_data_size(map);
 	/* stack_map_alloc() checks that max_depth <= sysctl_perf_event_max_stack */
 	u32 init_nr = sysctl_perf_event_max_stack - max_depth;
 	u32 skip = flags & BPF_F_SKIP_FIELD_MASK;
-	u32 hash, id, trace_nr, trace_len;
+	u32 hash, trace_nr, trace_len;
 	bool user = flags & BPF_F_USER_STACK;
+	bool defer = false;
+	int id, empty;
 	u64 *ips;
-	bool hash_matches;
 
 	/* get_perf_callchain() guarantees that trace->nr >= init_nr
 	 * and trace-nr <= sysctl_perf_event_max_stack, so trace_nr <= max_depth
@@ -276,55 +417,81 @@ static long __bpf_get_stackid(struct bpf_map *map,
 	trace_len = trace_nr * sizeof(u64);
 	ips = trace->ip + skip + init_nr;
 	hash = jhash2((u32 *)ips, trace_len / sizeof(u32), 0);
-	id = hash & (smap->n_buckets - 1);
-	bucket = READ_ONCE(smap->buckets[id]);
 
-	hash_matches = bucket && bucket->hash == hash;
 	/* fast cmp */
-	if (hash_matches && flags & BPF_F_FAST_STACK_CMP)
-		return id;
+	if (flags & BPF_F_FAST_STACK_CMP) {
+		id = stack_map_find(smap, hash, NULL, 0, 0, &empty);
+		if (id >= 0)
+			return id;
+	}
 
 	if (stack_map_use_build_id(map)) {
 		/* for build_id+offset, pop a bucket before slow cmp */
-		new_bucket = (struct stack_map_bucket *)
-			pcpu_freelist_pop(&smap->freelist);
+		new_bucket = stack_map_pop_bucket(smap);
 		if (unlikely(!new_bucket))
-			return -ENOMEM;
-		new_bucket->nr = trace_nr;
-		stack_map_get_build_id_offset(
-			(struct bpf_stack_build_id *)new_bucket->data,
-			ips, trace_nr, user);
+			goto drop_nomem;
+		/* the ips are resolved after the fact if the mm is busy */
+		defer = !stack_map_get_build_id_offset(
+				(struct bpf_stack_build_id *)new_bucket->data,
+				ips, trace_nr, user) &&
+			user && current->mm && !(current->flags & PF_KTHREAD);
 		trace_len = trace_nr * sizeof(struct bpf_stack_build_id);
-		if (hash_matches && bucket->nr == trace_nr &&
-		    memcmp(bucket->data, new_bucket->data, trace_len) == 0) {
-			pcpu_freelist_push(&smap->freelist, &new_bucket->fnode);
+		id = stack_map_find(smap, hash, new_bucket->data, trace_nr,
+				    trace_len, &empty);
+		if (id >= 0) {
+			stack_map_put_bucket(smap, new_bucket);
 			return id;
 		}
-		if (bucket && !(flags & BPF_F_REUSE_STACKID)) {
-			pcpu_freelist_push(&smap->freelist, &new_bucket->fnode);
-			return -EEXIST;
+		if (empty < 0 && !(flags & BPF_F_REUSE_STACKID)) {
+			stack_map_put_bucket(smap, new_bucket);
+			goto drop_collision;
 		}
 	} else {
-		if (hash_matches && bucket->nr == trace_nr &&
-		    memcmp(bucket->data, ips, trace_len) == 0)
+		id = stack_map_find(smap, hash, ips, trace_nr, trace_len,
+				    &empty);
+		if (id >= 0)
 			return id;
-		if (bucket && !(flags & BPF_F_REUSE_STACKID))
-			return -EEXIST;
+		if (empty < 0 && !(flags & BPF_F_REUSE_STACKID))
+			goto drop_collision;
 
-		new_bucket = (struct stack_map_bucket *)
-			pcpu_freelist_pop(&smap->freelist);
+		new_bucket = stack_map_pop_bucket(smap);
 		if (unlikely(!new_bucket))
-			return -ENOMEM;
+			goto drop_nomem;
 		memcpy(new_bucket->data, ips, trace_len);
 	}
 
 	new_bucket->hash = hash;
 	new_bucket->nr = trace_nr;
 
-	old_bucket = xchg(&smap->buckets[id], new_bucket);
-	if (old_bucket)
-		pcpu_freelist_push(&smap->freelist, &old_bucket->fnode);
+	/* the work's reference, taken before the bucket becomes visible */
+	if (defer)
+		atomic_inc(&new_bucket->refcnt);
+
+	if (empty >= 0 && !cmpxchg(&smap->buckets[empty], NULL, new_bucket)) {
+		id = empty;
+	} else if (flags & BPF_F_REUSE_STACKID) {
+		id = hash & (smap->n_buckets - 1);
+		old_bucket = xchg(&smap->buckets[id], new_bucket);
+		if (old_bucket)
+			stack_map_put_bucket(smap, old_bucket);
+	} else {
+		/* lost the free bucket to another stack */
+		if (defer)
+			stack_map_put_bucket(smap, new_bucket);
+		stack_map_put_bucket(smap, new_bucket);
+		goto drop_collision;
+	}
+
+	if (defer)
+		stack_map_queue_build_id(smap, new_bucket, id);
 	return id;
+
+drop_collision:
+	atomic_long_inc(&smap->drops_collision);
+	return -EEXIST;
+drop_nomem:
+	atomic_long_inc(&smap->drops_nomem);
+	return -ENOMEM;
 }
 
 BPF_CALL_3(bpf_get_stackid, struct pt_regs *, regs, struct bpf_map *, map,
@@ -632,7 +799,7 @@ int bpf_stackmap_copy(struct bpf_map *map, void *key, void *value)
 
 	old_bucket = xchg(&smap->buckets[id], bucket);
 	if (old_bucket)
-		pcpu_freelist_push(&smap->freelist, &old_bucket->fnode);
+		stack_map_put_bucket(smap, old_bucket);
 	return 0;
 }
 
@@ -683,13 +850,27 @@ static int stack_map_delete_elem(struct bpf_map *map, void *key)
 
 	old_bucket = xchg(&smap->buckets[id], NULL);
 	if (old_bucket) {
-		pcpu_freelist_push(&smap->freelist, &old_bucket->fnode);
+		stack_map_put_bucket(smap, old_bucket);
 		return 0;
 	} else {
 		return -ENOENT;
 	}
 }
 
+static void stack_map_show_fdinfo(const struct bpf_map *map,
+				  struct seq_file *m)
+{
+	struct bpf_stack_map *smap = container_of(map, struct bpf_stack_map, map);
+
+	seq_printf(m,
+		   "drops_collision:\t%lu\n"
+		   "drops_nomem:\t%lu\n"
+		   "build_id_deferred:\t%lu\n",
+		   atomic_long_read(&smap->drops_collision),
+		   atomic_long_read(&smap->drops_nomem),
+		   atomic_long_read(&smap->build_id_deferred));
+}
+
 /* Called when map->refcnt goes to zero, either from workqueue or from syscall */
 static void stack_map_free(struct bpf_map *map)
 {
@@ -711,6 +892,7 @@ const struct bpf_map_ops stack_trace_map_ops = {
 	.map_update_elem = stack_map_update_elem,
 	.map_delete_elem = stack_map_delete_elem,
 	.map_check_btf = map_check_no_btf,
+	.map_show_fdinfo = stack_map_show_fdinfo,
 	.map_btf_name = "bpf_stack_map",
 	.map_btf_id = &stack_trace_map_btf_id,
 };
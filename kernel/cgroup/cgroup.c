@@ -3550,26 +3550,29 @@ static int cpu_stat_show(struct seq_file *seq, void *v)
 }
 
 #ifdef CONFIG_PSI
-static int cgroup_io_pressure_show(struct seq_file *seq, void *v)
+static int cgroup_pressure_show(struct seq_file *seq, enum psi_res res)
 {
+	struct kernfs_open_file *of = seq->private;
 	struct cgroup *cgrp = seq_css(seq)->cgroup;
 	struct psi_group *psi = cgroup_ino(cgrp) == 1 ? &psi_system : &cgrp->psi;
+	int ret;
 
-	return psi_show(seq, psi, PSI_IO);
+	ret = psi_show(seq, psi, res);
+	if (!ret)
+		psi_trigger_show(seq, &of->priv);
+	return ret;
+}
+static int cgroup_io_pressure_show(struct seq_file *seq, void *v)
+{
+	return cgroup_pressure_show(seq, PSI_IO);
 }
 static int cgroup_memory_pressure_show(struct seq_file *seq, void *v)
 {
-	struct cgroup *cgrp = seq_css(seq)->cgroup;
-	struct psi_group *psi = cgroup_ino(cgrp) == 1 ? &psi_system : &cgrp->psi;
-
-	return psi_show(seq, psi, PSI_MEM);
+	return cgroup_pressure_show(seq, PSI_MEM);
 }
 static int cgroup_cpu_pressure_show(struct seq_file *seq, void *v)
 {
-	struct cgroup *cgrp = seq_css(seq)->cgroup;
-	struct psi_group *psi = cgroup_ino(cgrp) == 1 ? &psi_system : &cgrp->psi;
-
-	return psi_show(seq, psi, PSI_CPU);
+	return cgroup_pressure_show(seq, PSI_CPU);
 }
 
 static ssize_t cgroup_pressure_write(struct kernfs_open_file *of, char *buf,
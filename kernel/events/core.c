@@ -54,6 +54,8 @@
 #include <linux/highmem.h>
 #include <linux/pgtable.h>
 #include <linux/buildid.h>
+#include <linux/bsearch.h>
+#include <linux/sort.h>
 
 #include "internal.h"
 
@@ -3567,6 +3569,280 @@ static void perf_pmu_sched_task(struct task_struct *prev,
 static void perf_event_switch(struct task_struct *task,
 			      struct task_struct *next_prev, bool sched_in);
 
+static void perf_sched_events_inc(void)
+{
+	/*
+	 * We need the mutex here because static_branch_enable()
+	 * must complete *before* the perf_sched_count increment
+	 * becomes visible.
+	 */
+	if (atomic_inc_not_zero(&perf_sched_count))
+		return;
+
+	mutex_lock(&perf_sched_mutex);
+	if (!atomic_read(&perf_sched_count)) {
+		static_branch_enable(&perf_sched_events);
+		/*
+		 * Guarantee that all CPUs observe they key change and
+		 * call the perf scheduling hooks before proceeding to
+		 * install events that need them.
+		 */
+		synchronize_rcu();
+	}
+	/*
+	 * Now that we have waited for the sync_sched(), allow further
+	 * increments to by-pass the mutex.
+	 */
+	atomic_inc(&perf_sched_count);
+	mutex_unlock(&perf_sched_mutex);
+}
+
+static void perf_sched_events_dec(void)
+{
+	if (!atomic_add_unless(&perf_sched_count, -1, 1))
+		schedule_delayed_work(&perf_sched_work, HZ);
+}
+
+#ifdef CONFIG_CGROUP_PERF
+/*
+ * Per-cgroup counting tables.
+ *
+ * Counting N events for M cgroups with cgroup events takes N * M events
+ * per CPU, all of which are scheduled in and out on every cgroup switch.
+ * A per-CPU counting event with a cgroup table instead keeps running, and
+ * at every context switch the delta of its count is added to the table
+ * entries of the outgoing task's cgroup and its ancestors.  The table is
+ * only written on event->cpu with interrupts disabled.
+ */
+#define PERF_CGRP_TABLE_MAX	(1U << 16)
+
+static DEFINE_PER_CPU(struct pmu_event_list, perf_cgrp_table_events);
+
+struct perf_cgrp_table_entry {
+	u64			id;
+	local64_t		count;
+};
+
+struct perf_cgrp_table {
+	u64				prev;
+	bool				primed;
+	unsigned int			nr;
+	struct perf_cgrp_table_entry	entries[];
+};
+
+static int perf_cgrp_table_cmp(const void *a, const void *b)
+{
+	u64 ida = *(const u64 *)a, idb = *(const u64 *)b;
+
+	if (ida < idb)
+		return -1;
+	return ida > idb;
+}
+
+static void perf_cgrp_table_account(struct perf_event *event,
+				    struct task_struct *task)
+{
+	struct perf_cgrp_table *table = rcu_dereference_sched(event->cgrp_table);
+	struct perf_cgrp_table_entry *entry;
+	struct cgroup_subsys_state *css;
+	u64 now, delta, id;
+
+	if (!table || perf_event_read_local(event, &now, NULL, NULL))
+		return;
+
+	delta = now - table->prev;
+	table->prev = now;
+
+	/* whatever was counted before the table was installed is unassigned */
+	if (!table->primed) {
+		table->primed = true;
+		return;
+	}
+
+	if (!delta)
+		return;
+
+	for (css = &perf_cgroup_from_task(task, NULL)->css; css;
+	     css = css->parent) {
+		id = cgroup_id(css->cgroup);
+		entry = bsearch(&id, table->entries, table->nr,
+				sizeof(*entry), perf_cgrp_table_cmp);
+		if (entry)
+			local64_add(delta, &entry->count);
+	}
+}
+
+static void perf_cgrp_table_sched_out(struct task_struct *task)
+{
+	struct pmu_event_list *pel = this_cpu_ptr(&perf_cgrp_table_events);
+	struct perf_event *event;
+
+	if (list_empty(&pel->list))
+		return;
+
+	list_for_each_entry_rcu(event, &pel->list, cgrp_table_entry)
+		perf_cgrp_table_account(event, task);
+}
+
+static int __perf_cgrp_table_flush(void *info)
+{
+	perf_cgrp_table_account(info, current);
+	return 0;
+}
+
+static void perf_cgrp_table_detach(struct perf_event *event)
+{
+	struct pmu_event_list *pel;
+
+	if (!rcu_access_pointer(event->cgrp_table))
+		return;
+
+	pel = per_cpu_ptr(&perf_cgrp_table_events, event->cpu);
+	raw_spin_lock(&pel->lock);
+	list_del_rcu(&event->cgrp_table_entry);
+	raw_spin_unlock(&pel->lock);
+
+	perf_sched_events_dec();
+}
+
+static void perf_cgrp_table_free(struct perf_event *event)
+{
+	kvfree(rcu_access_pointer(event->cgrp_table));
+}
+
+static int perf_event_set_cgroup_table(struct perf_event *event, void __user *arg)
+{
+	struct perf_cgrp_table *table = NULL, *old;
+	struct perf_event_cgroup_table attr;
+	struct pmu_event_list *pel;
+	u64 __user *uids;
+	unsigned int i;
+
+	if (copy_from_user(&attr, arg, sizeof(attr)))
+		return -EFAULT;
+
+	/* counting per-CPU events only, which run across cgroup switches */
+	if ((event->attach_state & PERF_ATTACH_TASK) || event->cpu < 0 ||
+	    is_cgroup_event(event) || is_sampling_event(event))
+		return -EINVAL;
+
+	if (attr.nr > PERF_CGRP_TABLE_MAX)
+		return -E2BIG;
+
+	if (attr.nr) {
+		table = kvzalloc(struct_size(table, entries, attr.nr),
+				 GFP_KERNEL_ACCOUNT);
+		if (!table)
+			return -ENOMEM;
+
+		uids = u64_to_user_ptr(attr.ids);
+		for (i = 0; i < attr.nr; i++) {
+			if (get_user(table->entries[i].id, &uids[i])) {
+				kvfree(table);
+				return -EFAULT;
+			}
+		}
+		table->nr = attr.nr;
+
+		sort(table->entries, table->nr, sizeof(table->entries[0]),
+		     perf_cgrp_table_cmp, NULL);
+		for (i = 1; i < table->nr; i++) {
+			if (table->entries[i].id == table->entries[i - 1].id) {
+				kvfree(table);
+				return -EINVAL;
+			}
+		}
+	}
+
+	if (table && !rcu_access_pointer(event->cgrp_table)) {
+		/* the sched out hook must be live before the event is listed */
+		perf_sched_events_inc();
+
+		pel = per_cpu_ptr(&perf_cgrp_table_events, event->cpu);
+		raw_spin_lock(&pel->lock);
+		list_add_rcu(&event->cgrp_table_entry, &pel->list);
+		raw_spin_unlock(&pel->lock);
+	} else if (!table) {
+		perf_cgrp_table_detach(event);
+	}
+
+	old = rcu_replace_pointer(event->cgrp_table, table,
+				  lockdep_is_held(&event->ctx->mutex));
+	if (old) {
+		synchronize_rcu();
+		kvfree(old);
+	}
+
+	return 0;
+}
+
+static int perf_event_read_cgroup_table(struct perf_event *event, void __user *arg)
+{
+	struct perf_event_cgroup_read __user *uread = arg;
+	struct perf_cgroup_value __user *uvalues;
+	struct perf_event_cgroup_read read;
+	struct perf_cgroup_value value;
+	struct perf_cgrp_table *table;
+	unsigned int i;
+
+	table = rcu_dereference_protected(event->cgrp_table,
+					  lockdep_is_held(&event->ctx->mutex));
+	if (!table)
+		return -EINVAL;
+
+	if (copy_from_user(&read, uread, sizeof(read)))
+		return -EFAULT;
+
+	if (read.nr < table->nr) {
+		read.nr = table->nr;
+		if (copy_to_user(uread, &read, sizeof(read)))
+			return -EFAULT;
+		return -ENOSPC;
+	}
+
+	/* assign what the running task counted so far; fails if offline */
+	cpu_function_call(event->cpu, __perf_cgrp_table_flush, event);
+
+	uvalues = u64_to_user_ptr(read.values);
+	for (i = 0; i < table->nr; i++) {
+		value.id = table->entries[i].id;
+		value.count = local64_read(&table->entries[i].count);
+		if (copy_to_user(&uvalues[i], &value, sizeof(value)))
+			return -EFAULT;
+	}
+
+	read.nr = table->nr;
+	if (copy_to_user(uread, &read, sizeof(read)))
+		return -EFAULT;
+
+	return 0;
+}
+
+#else /* !CONFIG_CGROUP_PERF */
+
+static inline void perf_cgrp_table_sched_out(struct task_struct *task)
+{
+}
+
+static inline void perf_cgrp_table_detach(struct perf_event *event)
+{
+}
+
+static inline void perf_cgrp_table_free(struct perf_event *event)
+{
+}
+
+static int perf_event_set_cgroup_table(struct perf_event *event, void __user *arg)
+{
+	return -EOPNOTSUPP;
+}
+
+static int perf_event_read_cgroup_table(struct perf_event *event, void __user *arg)
+{
+	return -EOPNOTSUPP;
+}
+#endif /* CONFIG_CGROUP_PERF */
+
 #define for_each_task_context_nr(ctxn)					\
 	for ((ctxn) = 0; (ctxn) < perf_nr_task_contexts; (ctxn)++)
 
@@ -3589,6 +3865,8 @@ void __perf_event_task_sched_out(struct task_struct *task,
 	if (__this_cpu_read(perf_sched_cb_usages))
 		perf_pmu_sched_task(task, next, false);
 
+	perf_cgrp_table_sched_out(task);
+
 	if (atomic_read(&nr_switch_events))
 		perf_event_switch(task, next, false);
 
@@ -4699,6 +4977,8 @@ static void free_event_rcu(struct rcu_head *head)
 	if (event->ns)
 		put_pid_ns(event->ns);
 	perf_event_free_filter(event);
+	kvfree(rcu_access_pointer(event->addr_aggr));
+	perf_cgrp_table_free(event);
 	kmem_cache_free(perf_event_cache, event);
 }
 
@@ -4808,10 +5088,10 @@ static void unaccount_event(struct perf_event *event)
 	if (event->attr.text_poke)
 		atomic_dec(&nr_text_poke_events);
 
-	if (dec) {
-		if (!atomic_add_unless(&perf_sched_count, -1, 1))
-			schedule_delayed_work(&perf_sched_work, HZ);
-	}
+	if (dec)
+		perf_sched_events_dec();
+
+	perf_cgrp_table_detach(event);
 
 	unaccount_event_cpu(event, event->cpu);
 
@@ -5567,6 +5847,10 @@ static int perf_event_set_output(struct perf_event *event,
 				 struct perf_event *output_event);
 static int perf_event_set_filter(struct perf_event *event, void __user *arg);
 static int perf_event_set_bpf_prog(struct perf_event *event, u32 prog_fd);
+static int perf_event_set_addr_aggr(struct perf_event *event, void __user *arg);
+static int perf_event_drain_addr_aggr(struct perf_event *event, void __user *arg);
+static int perf_event_set_cgroup_table(struct perf_event *event, void __user *arg);
+static int perf_event_read_cgroup_table(struct perf_event *event, void __user *arg);
 static int perf_copy_attr(struct perf_event_attr __user *uattr,
 			  struct perf_event_attr *attr);
 
@@ -5658,6 +5942,18 @@ static long _perf_ioctl(struct perf_event *event, unsigned int cmd, unsigned lon
 
 		return perf_event_modify_attr(event,  &new_attr);
 	}
+
+	case PERF_EVENT_IOC_ADDR_AGGR:
+		return perf_event_set_addr_aggr(event, (void __user *)arg);
+
+	case PERF_EVENT_IOC_ADDR_AGGR_DRAIN:
+		return perf_event_drain_addr_aggr(event, (void __user *)arg);
+
+	case PERF_EVENT_IOC_SET_CGROUP_TABLE:
+		return perf_event_set_cgroup_table(event, (void __user *)arg);
+
+	case PERF_EVENT_IOC_READ_CGROUP_TABLE:
+		return perf_event_read_cgroup_table(event, (void __user *)arg);
 	default:
 		return -ENOTTY;
 	}
@@ -5697,6 +5993,10 @@ static long perf_compat_ioctl(struct file *file, unsigned int cmd,
 	case _IOC_NR(PERF_EVENT_IOC_ID):
 	case _IOC_NR(PERF_EVENT_IOC_QUERY_BPF):
 	case _IOC_NR(PERF_EVENT_IOC_MODIFY_ATTRIBUTES):
+	case _IOC_NR(PERF_EVENT_IOC_ADDR_AGGR):
+	case _IOC_NR(PERF_EVENT_IOC_ADDR_AGGR_DRAIN):
+	case _IOC_NR(PERF_EVENT_IOC_SET_CGROUP_TABLE):
+	case _IOC_NR(PERF_EVENT_IOC_READ_CGROUP_TABLE):
 		/* Fix up pointer size (usually 4 -> 8 in 32-on-64-bit case */
 		if (_IOC_SIZE(cmd) == sizeof(compat_uptr_t)) {
 			cmd &= ~IOCSIZE_MASK;
@@ -7421,6 +7721,175 @@ void perf_prepare_sample(struct perf_event_header *header,
 	WARN_ON_ONCE(header->size & 7);
 }
 
+/*
+ * In-kernel aggregation of sampled data addresses.
+ *
+ * Instead of a full sample record per PEBS/IBS/SPE sample, an aggregating
+ * event only counts the sample in an open addressed table keyed by the
+ * page or cache line of its data address, which user space drains with
+ * PERF_EVENT_IOC_ADDR_AGGR_DRAIN.  Slots are claimed with a cmpxchg and
+ * counted with atomics, so the NMI side needs no lock against a drain.
+ */
+#define PERF_ADDR_AGGR_PROBES		8
+#define PERF_ADDR_AGGR_SLOTS_MIN	64
+#define PERF_ADDR_AGGR_SLOTS_MAX	(1U << 20)
+
+struct perf_addr_aggr_slot {
+	unsigned long		key;	/* (addr >> shift) + 1, 0 if free */
+	atomic_long_t		count;
+	atomic_long_t		weight;
+	atomic_long_t		hitm;
+};
+
+struct perf_addr_aggr {
+	unsigned int			shift;
+	unsigned int			bits;
+	atomic_long_t			lost;
+	struct perf_addr_aggr_slot	slots[];
+};
+
+static void perf_addr_aggr_sample(struct perf_addr_aggr *aggr,
+				  struct perf_event *event,
+				  struct perf_sample_data *data)
+{
+	u64 sample_type = event->attr.sample_type;
+	struct perf_addr_aggr_slot *slot;
+	unsigned long key, cur;
+	unsigned int idx, i;
+
+	/* not every record of a PMU comes with a data address */
+	if (!data->addr)
+		return;
+
+	key = (data->addr >> aggr->shift) + 1;
+	idx = hash_long(key, aggr->bits);
+
+	for (i = 0; i < PERF_ADDR_AGGR_PROBES; i++) {
+		slot = &aggr->slots[(idx + i) & ((1U << aggr->bits) - 1)];
+
+		cur = READ_ONCE(slot->key);
+		if (!cur) {
+			cur = cmpxchg(&slot->key, 0, key);
+			if (!cur)
+				cur = key;
+		}
+		if (cur != key)
+			continue;
+
+		atomic_long_inc(&slot->count);
+		if (sample_type & PERF_SAMPLE_WEIGHT)
+			atomic_long_add(data->weight.full, &slot->weight);
+		else if (sample_type & PERF_SAMPLE_WEIGHT_STRUCT)
+			atomic_long_add(data->weight.var1_dw, &slot->weight);
+		if ((sample_type & PERF_SAMPLE_DATA_SRC) &&
+		    (data->data_src.mem_snoop & PERF_MEM_SNOOP_HITM))
+			atomic_long_inc(&slot->hitm);
+		return;
+	}
+
+	atomic_long_inc(&aggr->lost);
+}
+
+static int perf_event_set_addr_aggr(struct perf_event *event, void __user *arg)
+{
+	struct perf_addr_aggr *aggr = NULL, *old;
+	struct perf_event_addr_aggr attr;
+
+	if (copy_from_user(&attr, arg, sizeof(attr)))
+		return -EFAULT;
+
+	if (attr.shift) {
+		if (attr.shift >= BITS_PER_LONG ||
+		    attr.nr_slots < PERF_ADDR_AGGR_SLOTS_MIN ||
+		    attr.nr_slots > PERF_ADDR_AGGR_SLOTS_MAX ||
+		    !is_power_of_2(attr.nr_slots))
+			return -EINVAL;
+
+		if (!is_sampling_event(event) ||
+		    !(event->attr.sample_type & PERF_SAMPLE_ADDR))
+			return -EINVAL;
+
+		/* inherited children would keep writing sample records */
+		if (event->attr.inherit)
+			return -EINVAL;
+
+		aggr = kvzalloc(struct_size(aggr, slots, attr.nr_slots),
+				GFP_KERNEL_ACCOUNT);
+		if (!aggr)
+			return -ENOMEM;
+
+		aggr->shift = attr.shift;
+		aggr->bits = ilog2(attr.nr_slots);
+	}
+
+	old = rcu_replace_pointer(event->addr_aggr, aggr,
+				  lockdep_is_held(&event->ctx->mutex));
+	if (old) {
+		/* NMIs are RCU read-side critical sections */
+		synchronize_rcu();
+		kvfree(old);
+	}
+
+	return 0;
+}
+
+static int perf_event_drain_addr_aggr(struct perf_event *event, void __user *arg)
+{
+	struct perf_event_addr_aggr_drain __user *udrain = arg;
+	struct perf_event_addr_aggr_drain drain;
+	struct perf_addr_aggr_entry __user *uentries;
+	struct perf_addr_aggr_entry entry;
+	struct perf_addr_aggr_slot *slot;
+	struct perf_addr_aggr *aggr;
+	unsigned int i, nr = 0;
+	unsigned long key;
+
+	aggr = rcu_dereference_protected(event->addr_aggr,
+					 lockdep_is_held(&event->ctx->mutex));
+	if (!aggr)
+		return -EINVAL;
+
+	if (copy_from_user(&drain, udrain, sizeof(drain)))
+		return -EFAULT;
+
+	uentries = u64_to_user_ptr(drain.entries);
+
+	for (i = 0; i < (1U << aggr->bits) && nr < drain.nr; i++) {
+		slot = &aggr->slots[i];
+
+		key = READ_ONCE(slot->key);
+		if (!key)
+			continue;
+
+		entry.count = atomic_long_xchg(&slot->count, 0);
+		if (!entry.count) {
+			/*
+			 * Idle since the last drain, give the slot back.
+			 * A sample racing with this may be counted for the
+			 * next address claiming it.
+			 */
+			cmpxchg(&slot->key, key, 0);
+			continue;
+		}
+
+		entry.addr = (u64)(key - 1) << aggr->shift;
+		entry.weight = atomic_long_xchg(&slot->weight, 0);
+		entry.hitm = atomic_long_xchg(&slot->hitm, 0);
+
+		if (copy_to_user(&uentries[nr], &entry, sizeof(entry)))
+			return -EFAULT;
+		nr++;
+	}
+
+	drain.nr = nr;
+	drain.lost = atomic_long_xchg(&aggr->lost, 0);
+
+	if (copy_to_user(udrain, &drain, sizeof(drain)))
+		return -EFAULT;
+
+	return 0;
+}
+
 static __always_inline int
 __perf_event_output(struct perf_event *event,
 		    struct perf_sample_data *data,
@@ -7432,11 +7901,20 @@ __perf_event_output(struct perf_event *event,
 {
 	struct perf_output_handle handle;
 	struct perf_event_header header;
+	struct perf_addr_aggr *aggr;
 	int err;
 
 	/* protect the callchain buffers */
 	rcu_read_lock();
 
+	aggr = rcu_dereference(event->addr_aggr);
+	if (unlikely(aggr)) {
+		/* no record, so no callchain or other sample data either */
+		perf_addr_aggr_sample(aggr, event, data);
+		rcu_read_unlock();
+		return 0;
+	}
+
 	perf_prepare_sample(&header, data, event, regs);
 
 	err = output_begin(&handle, data, event, header.size);
@@ -10025,6 +10503,12 @@ static int perf_event_set_bpf_prog(struct perf_event *event, u32 prog_fd)
 		return -EINVAL;
 	}
 
+	/* kprobe_multi programs are only attached through a bpf_link */
+	if (is_kprobe && prog->expected_attach_type == BPF_TRACE_KPROBE_MULTI) {
+		bpf_prog_put(prog);
+		return -EINVAL;
+	}
+
 	/* Kprobe override only works for kprobes, not uprobes. */
 	if (prog->kprobe_override &&
 	    !(event->tp_event->flags & TRACE_EVENT_FL_KPROBE)) {
@@ -11368,33 +11852,8 @@ static void account_event(struct perf_event *event)
 	if (event->attr.text_poke)
 		atomic_inc(&nr_text_poke_events);
 
-	if (inc) {
-		/*
-		 * We need the mutex here because static_branch_enable()
-		 * must complete *before* the perf_sched_count increment
-		 * becomes visible.
-		 */
-		if (atomic_inc_not_zero(&perf_sched_count))
-			goto enabled;
-
-		mutex_lock(&perf_sched_mutex);
-		if (!atomic_read(&perf_sched_count)) {
-			static_branch_enable(&perf_sched_events);
-			/*
-			 * Guarantee that all CPUs observe they key change and
-			 * call the perf scheduling hooks before proceeding to
-			 * install events that need them.
-			 */
-			synchronize_rcu();
-		}
-		/*
-		 * Now that we have waited for the sync_sched(), allow further
-		 * increments to by-pass the mutex.
-		 */
-		atomic_inc(&perf_sched_count);
-		mutex_unlock(&perf_sched_mutex);
-	}
-enabled:
+	if (inc)
+		perf_sched_events_inc();
 
 	account_event_cpu(event, event->cpu);
 
@@ -13155,6 +13614,8 @@ static void __init perf_event_init_all_cpus(void)
 
 #ifdef CONFIG_CGROUP_PERF
 		INIT_LIST_HEAD(&per_cpu(cgrp_cpuctx_list, cpu));
+		INIT_LIST_HEAD(&per_cpu(perf_cgrp_table_events.list, cpu));
+		raw_spin_lock_init(&per_cpu(perf_cgrp_table_events.lock, cpu));
 #endif
 		INIT_LIST_HEAD(&per_cpu(sched_cb_list, cpu));
 	}
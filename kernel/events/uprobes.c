@@ -27,20 +27,40 @@
 #include <linux/task_work.h>
 #include <linux/shmem_fs.h>
 #include <linux/khugepaged.h>
+#include <linux/hash.h>
 
 #include <linux/uprobes.h>
 
 #define UINSNS_PER_PAGE			(PAGE_SIZE/UPROBE_XOL_SLOT_BYTES)
 #define MAX_UPROBE_XOL_SLOTS		UINSNS_PER_PAGE
 
-static struct rb_root uprobes_tree = RB_ROOT;
+/*
+ * Uprobes live in rbtrees sorted on inode:offset, one tree per hash of the
+ * inode so that registration on unrelated files does not contend.  All
+ * uprobes of an inode are in the same tree.  Breakpoint hits look uprobes
+ * up locklessly under RCU and use the seqcount to detect concurrent
+ * updates.
+ */
+#define UPROBES_TREE_BITS	6
+
+struct uprobes_tree {
+	struct rb_root		root;
+	spinlock_t		lock;	/* serialize rbtree updates */
+	seqcount_spinlock_t	seq;
+} ____cacheline_aligned_in_smp;
+
+static struct uprobes_tree uprobes_trees[1 << UPROBES_TREE_BITS];
+static atomic_t uprobes_count = ATOMIC_INIT(0);
 /*
  * allows us to skip the uprobe_mmap if there are no uprobe events active
  * at this time.  Probably a fine grained per inode count is better?
  */
-#define no_uprobe_events()	RB_EMPTY_ROOT(&uprobes_tree)
+#define no_uprobe_events()	(!atomic_read(&uprobes_count))
 
-static DEFINE_SPINLOCK(uprobes_treelock);	/* serialize rbtree access */
+static inline struct uprobes_tree *uprobe_tree_of(const struct inode *inode)
+{
+	return &uprobes_trees[hash_ptr(inode, UPROBES_TREE_BITS)];
+}
 
 #define UPROBES_HASH_SZ	13
 /* serialize uprobe->pending_list */
@@ -55,6 +75,7 @@ DEFINE_STATIC_PERCPU_RWSEM(dup_mmap_sem);
 struct uprobe {
 	struct rb_node		rb_node;	/* node in the rb tree */
 	refcount_t		ref;
+	struct rcu_head		rcu;
 	struct rw_semaphore	register_rwsem;
 	struct rw_semaphore	consumer_rwsem;
 	struct list_head	pending_list;
@@ -609,7 +630,8 @@ static void put_uprobe(struct uprobe *uprobe)
 		mutex_lock(&delayed_uprobe_lock);
 		delayed_uprobe_remove(uprobe, NULL);
 		mutex_unlock(&delayed_uprobe_lock);
-		kfree(uprobe);
+		/* find_uprobe_rcu() may still be looking at it */
+		kfree_rcu(uprobe, rcu);
 	}
 }
 
@@ -658,8 +680,9 @@ static struct uprobe *__find_uprobe(struct inode *inode, loff_t offset)
 		.inode = inode,
 		.offset = offset,
 	};
-	struct rb_node *node = rb_find(&key, &uprobes_tree, __uprobe_cmp_key);
+	struct rb_node *node;
 
+	node = rb_find(&key, &uprobe_tree_of(inode)->root, __uprobe_cmp_key);
 	if (node)
 		return get_uprobe(__node_2_uprobe(node));
 
@@ -668,34 +691,75 @@ static struct uprobe *__find_uprobe(struct inode *inode, loff_t offset)
 
 /*
  * Find a uprobe corresponding to a given inode:offset
- * Acquires uprobes_treelock
+ * Acquires the tree lock of @inode
  */
 static struct uprobe *find_uprobe(struct inode *inode, loff_t offset)
 {
+	struct uprobes_tree *tree = uprobe_tree_of(inode);
 	struct uprobe *uprobe;
 
-	spin_lock(&uprobes_treelock);
+	spin_lock(&tree->lock);
 	uprobe = __find_uprobe(inode, offset);
-	spin_unlock(&uprobes_treelock);
+	spin_unlock(&tree->lock);
 
 	return uprobe;
 }
 
+/*
+ * Lockless find_uprobe() for the breakpoint hit path, must be called under
+ * rcu_read_lock().  A uprobe whose last reference is being dropped is
+ * treated as not found.
+ */
+static struct uprobe *find_uprobe_rcu(struct inode *inode, loff_t offset)
+{
+	struct uprobes_tree *tree = uprobe_tree_of(inode);
+	struct __uprobe_key key = {
+		.inode = inode,
+		.offset = offset,
+	};
+	struct rb_node *node;
+	unsigned int seq;
+
+	RCU_LOCKDEP_WARN(!rcu_read_lock_held(), "find_uprobe_rcu() needs RCU");
+
+	do {
+		seq = read_seqcount_begin(&tree->seq);
+		node = rb_find_rcu(&key, &tree->root, __uprobe_cmp_key);
+		if (node) {
+			struct uprobe *uprobe = __node_2_uprobe(node);
+
+			if (refcount_inc_not_zero(&uprobe->ref))
+				return uprobe;
+			return NULL;
+		}
+	} while (read_seqcount_retry(&tree->seq, seq));
+
+	return NULL;
+}
+
 static struct uprobe *__insert_uprobe(struct uprobe *uprobe)
 {
+	struct uprobes_tree *tree = uprobe_tree_of(uprobe->inode);
 	struct rb_node *node;
 
-	node = rb_find_add(&uprobe->rb_node, &uprobes_tree, __uprobe_cmp);
+	/*
+	 * get access + creation ref, before find_uprobe_rcu() can see it.
+	 * If a matching uprobe exists, @uprobe is freed by the caller.
+	 */
+	refcount_set(&uprobe->ref, 2);
+
+	write_seqcount_begin(&tree->seq);
+	node = rb_find_add_rcu(&uprobe->rb_node, &tree->root, __uprobe_cmp);
+	write_seqcount_end(&tree->seq);
 	if (node)
 		return get_uprobe(__node_2_uprobe(node));
 
-	/* get access + creation ref */
-	refcount_set(&uprobe->ref, 2);
+	atomic_inc(&uprobes_count);
 	return NULL;
 }
 
 /*
- * Acquire uprobes_treelock.
+ * Acquire the tree lock of @uprobe->inode.
  * Matching uprobe already exists in rbtree;
  *	increment (access refcount) and return the matching uprobe.
  *
@@ -704,11 +768,12 @@ static struct uprobe *__insert_uprobe(struct uprobe *uprobe)
  */
 static struct uprobe *insert_uprobe(struct uprobe *uprobe)
 {
+	struct uprobes_tree *tree = uprobe_tree_of(uprobe->inode);
 	struct uprobe *u;
 
-	spin_lock(&uprobes_treelock);
+	spin_lock(&tree->lock);
 	u = __insert_uprobe(uprobe);
-	spin_unlock(&uprobes_treelock);
+	spin_unlock(&tree->lock);
 
 	return u;
 }
@@ -738,7 +803,7 @@ static struct uprobe *alloc_uprobe(struct inode *inode, loff_t offset,
 	init_rwsem(&uprobe->register_rwsem);
 	init_rwsem(&uprobe->consumer_rwsem);
 
-	/* add to uprobes_tree, sorted on inode:offset */
+	/* add to the uprobes tree of @inode, sorted on inode:offset */
 	cur_uprobe = insert_uprobe(uprobe);
 	/* a uprobe exists for this inode:offset combination */
 	if (cur_uprobe) {
@@ -937,12 +1002,17 @@ static inline bool uprobe_is_active(struct uprobe *uprobe)
  */
 static void delete_uprobe(struct uprobe *uprobe)
 {
+	struct uprobes_tree *tree = uprobe_tree_of(uprobe->inode);
+
 	if (WARN_ON(!uprobe_is_active(uprobe)))
 		return;
 
-	spin_lock(&uprobes_treelock);
-	rb_erase(&uprobe->rb_node, &uprobes_tree);
-	spin_unlock(&uprobes_treelock);
+	spin_lock(&tree->lock);
+	write_seqcount_begin(&tree->seq);
+	rb_erase(&uprobe->rb_node, &tree->root);
+	write_seqcount_end(&tree->seq);
+	spin_unlock(&tree->lock);
+	atomic_dec(&uprobes_count);
 	RB_CLEAR_NODE(&uprobe->rb_node); /* for uprobe_is_active() */
 	put_uprobe(uprobe);
 }
@@ -1030,6 +1100,11 @@ build_map_info(struct address_space *mapping, loff_t offset, bool is_register)
 	return curr;
 }
 
+/*
+ * Called with dup_mmap_sem held for write, which blocks fork() and is
+ * expensive to take (it waits for an RCU grace period), so batched
+ * registrations take it only once.
+ */
 static int
 register_for_each_vma(struct uprobe *uprobe, struct uprobe_consumer *new)
 {
@@ -1037,7 +1112,8 @@ register_for_each_vma(struct uprobe *uprobe, struct uprobe_consumer *new)
 	struct map_info *info;
 	int err = 0;
 
-	percpu_down_write(&dup_mmap_sem);
+	percpu_rwsem_assert_held(&dup_mmap_sem);
+
 	info = build_map_info(uprobe->inode->i_mapping,
 					uprobe->offset, is_register);
 	if (IS_ERR(info)) {
@@ -1080,7 +1156,6 @@ register_for_each_vma(struct uprobe *uprobe, struct uprobe_consumer *new)
 		info = free_map_info(info);
 	}
  out:
-	percpu_up_write(&dup_mmap_sem);
 	return err;
 }
 
@@ -1098,13 +1173,9 @@ __uprobe_unregister(struct uprobe *uprobe, struct uprobe_consumer *uc)
 		delete_uprobe(uprobe);
 }
 
-/*
- * uprobe_unregister - unregister an already registered probe.
- * @inode: the file in which the probe has to be removed.
- * @offset: offset from the start of the file.
- * @uc: identify which probe if multiple probes are colocated.
- */
-void uprobe_unregister(struct inode *inode, loff_t offset, struct uprobe_consumer *uc)
+/* Caller holds dup_mmap_sem for write */
+static void find_and_unregister(struct inode *inode, loff_t offset,
+				struct uprobe_consumer *uc)
 {
 	struct uprobe *uprobe;
 
@@ -1117,8 +1188,39 @@ void uprobe_unregister(struct inode *inode, loff_t offset, struct uprobe_consume
 	up_write(&uprobe->register_rwsem);
 	put_uprobe(uprobe);
 }
+
+/*
+ * uprobe_unregister - unregister an already registered probe.
+ * @inode: the file in which the probe has to be removed.
+ * @offset: offset from the start of the file.
+ * @uc: identify which probe if multiple probes are colocated.
+ */
+void uprobe_unregister(struct inode *inode, loff_t offset, struct uprobe_consumer *uc)
+{
+	percpu_down_write(&dup_mmap_sem);
+	find_and_unregister(inode, offset, uc);
+	percpu_up_write(&dup_mmap_sem);
+}
 EXPORT_SYMBOL_GPL(uprobe_unregister);
 
+/*
+ * uprobe_unregister_batch - unregister several probes of one file at once.
+ * @inode: the file in which the probes have to be removed.
+ * @probes: offsets and consumers passed to uprobe_register_batch().
+ * @cnt: number of entries in @probes.
+ */
+void uprobe_unregister_batch(struct inode *inode,
+			     struct uprobe_batch_entry *probes, int cnt)
+{
+	int i;
+
+	percpu_down_write(&dup_mmap_sem);
+	for (i = 0; i < cnt; i++)
+		find_and_unregister(inode, probes[i].offset, probes[i].uc);
+	percpu_up_write(&dup_mmap_sem);
+}
+EXPORT_SYMBOL_GPL(uprobe_unregister_batch);
+
 /*
  * __uprobe_register - register a probe
  * @inode: the file in which the probe has to be placed.
@@ -1132,7 +1234,8 @@ EXPORT_SYMBOL_GPL(uprobe_unregister);
  * @uprobe even before the register operation is complete. Creation
  * refcount is released when the last @uc for the @uprobe
  * unregisters. Caller of __uprobe_register() is required to keep @inode
- * (and the containing mount) referenced.
+ * (and the containing mount) referenced, and to hold dup_mmap_sem for
+ * write.
  *
  * Return errno if it cannot successully install probes
  * else return 0 (success)
@@ -1193,17 +1296,56 @@ static int __uprobe_register(struct inode *inode, loff_t offset,
 int uprobe_register(struct inode *inode, loff_t offset,
 		    struct uprobe_consumer *uc)
 {
-	return __uprobe_register(inode, offset, 0, uc);
+	return uprobe_register_refctr(inode, offset, 0, uc);
 }
 EXPORT_SYMBOL_GPL(uprobe_register);
 
 int uprobe_register_refctr(struct inode *inode, loff_t offset,
 			   loff_t ref_ctr_offset, struct uprobe_consumer *uc)
 {
-	return __uprobe_register(inode, offset, ref_ctr_offset, uc);
+	int ret;
+
+	percpu_down_write(&dup_mmap_sem);
+	ret = __uprobe_register(inode, offset, ref_ctr_offset, uc);
+	percpu_up_write(&dup_mmap_sem);
+
+	return ret;
 }
 EXPORT_SYMBOL_GPL(uprobe_register_refctr);
 
+/*
+ * uprobe_register_batch - register several probes of one file at once.
+ * @inode: the file in which the probes have to be placed.
+ * @probes: offset, reference counter offset and consumer of each probe.
+ * @cnt: number of entries in @probes.
+ *
+ * Like calling uprobe_register_refctr() for each entry, but fork() is
+ * blocked only once for the whole batch.  Either all probes are
+ * registered, or none is and the error of the first failure is returned.
+ */
+int uprobe_register_batch(struct inode *inode,
+			  struct uprobe_batch_entry *probes, int cnt)
+{
+	int i, ret = 0;
+
+	percpu_down_write(&dup_mmap_sem);
+	for (i = 0; i < cnt; i++) {
+		ret = __uprobe_register(inode, probes[i].offset,
+					probes[i].ref_ctr_offset, probes[i].uc);
+		if (ret)
+			break;
+	}
+	if (ret) {
+		while (--i >= 0)
+			find_and_unregister(inode, probes[i].offset,
+					    probes[i].uc);
+	}
+	percpu_up_write(&dup_mmap_sem);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(uprobe_register_batch);
+
 /*
  * uprobe_apply - unregister an already registered probe.
  * @inode: the file in which the probe has to be removed.
@@ -1222,12 +1364,14 @@ int uprobe_apply(struct inode *inode, loff_t offset,
 	if (WARN_ON(!uprobe))
 		return ret;
 
+	percpu_down_write(&dup_mmap_sem);
 	down_write(&uprobe->register_rwsem);
 	for (con = uprobe->consumers; con && con != uc ; con = con->next)
 		;
 	if (con)
 		ret = register_for_each_vma(uprobe, add ? uc : NULL);
 	up_write(&uprobe->register_rwsem);
+	percpu_up_write(&dup_mmap_sem);
 	put_uprobe(uprobe);
 
 	return ret;
@@ -1263,7 +1407,7 @@ static int unapply_uprobe(struct uprobe *uprobe, struct mm_struct *mm)
 static struct rb_node *
 find_node_in_range(struct inode *inode, loff_t min, loff_t max)
 {
-	struct rb_node *n = uprobes_tree.rb_node;
+	struct rb_node *n = uprobe_tree_of(inode)->root.rb_node;
 
 	while (n) {
 		struct uprobe *u = rb_entry(n, struct uprobe, rb_node);
@@ -1293,6 +1437,7 @@ static void build_probe_list(struct inode *inode,
 				unsigned long start, unsigned long end,
 				struct list_head *head)
 {
+	struct uprobes_tree *tree = uprobe_tree_of(inode);
 	loff_t min, max;
 	struct rb_node *n, *t;
 	struct uprobe *u;
@@ -1301,7 +1446,7 @@ static void build_probe_list(struct inode *inode,
 	min = vaddr_to_offset(vma, start);
 	max = min + (end - start) - 1;
 
-	spin_lock(&uprobes_treelock);
+	spin_lock(&tree->lock);
 	n = find_node_in_range(inode, min, max);
 	if (n) {
 		for (t = n; t; t = rb_prev(t)) {
@@ -1319,7 +1464,7 @@ static void build_probe_list(struct inode *inode,
 			get_uprobe(u);
 		}
 	}
-	spin_unlock(&uprobes_treelock);
+	spin_unlock(&tree->lock);
 }
 
 /* @vma contains reference counter, not the probed instruction. */
@@ -1401,18 +1546,20 @@ int uprobe_mmap(struct vm_area_struct *vma)
 static bool
 vma_has_uprobes(struct vm_area_struct *vma, unsigned long start, unsigned long end)
 {
+	struct uprobes_tree *tree;
 	loff_t min, max;
 	struct inode *inode;
 	struct rb_node *n;
 
 	inode = file_inode(vma->vm_file);
+	tree = uprobe_tree_of(inode);
 
 	min = vaddr_to_offset(vma, start);
 	max = min + (end - start) - 1;
 
-	spin_lock(&uprobes_treelock);
+	spin_lock(&tree->lock);
 	n = find_node_in_range(inode, min, max);
-	spin_unlock(&uprobes_treelock);
+	spin_unlock(&tree->lock);
 
 	return !!n;
 }
@@ -2052,7 +2199,9 @@ static struct uprobe *find_active_uprobe(unsigned long bp_vaddr, int *is_swbp)
 			struct inode *inode = file_inode(vma->vm_file);
 			loff_t offset = vaddr_to_offset(vma, bp_vaddr);
 
-			uprobe = find_uprobe(inode, offset);
+			rcu_read_lock();
+			uprobe = find_uprobe_rcu(inode, offset);
+			rcu_read_unlock();
 		}
 
 		if (!uprobe)
@@ -2354,5 +2503,12 @@ void __init uprobes_init(void)
 	for (i = 0; i < UPROBES_HASH_SZ; i++)
 		mutex_init(&uprobes_mmap_mutex[i]);
 
+	for (i = 0; i < ARRAY_SIZE(uprobes_trees); i++) {
+		uprobes_trees[i].root = RB_ROOT;
+		spin_lock_init(&uprobes_trees[i].lock);
+		seqcount_spinlock_init(&uprobes_trees[i].seq,
+				       &uprobes_trees[i].lock);
+	}
+
 	BUG_ON(register_die_notifier(&uprobe_exception_nb));
 }
@@ -1989,7 +1989,6 @@ int kprobe_on_func_entry(kprobe_opcode_t *addr, const char *sym, unsigned long o
 int register_kretprobe(struct kretprobe *rp)
 {
 	int ret;
-	struct kretprobe_instance *inst;
 	int i;
 	void *addr;
 
@@ -2016,6 +2015,31 @@ int register_kretprobe(struct kretprobe *rp)
 	rp->kp.post_handler = NULL;
 	rp->kp.fault_handler = NULL;
 
+	ret = kretprobe_init_instances(rp);
+	if (ret)
+		return ret;
+
+	/* Establish function entry probe point */
+	ret = register_kprobe(&rp->kp);
+	if (ret != 0)
+		free_rp_inst(rp);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(register_kretprobe);
+
+/**
+ * kretprobe_init_instances() -- allocate the return instances of @rp
+ * @rp: kretprobe to set up
+ *
+ * Done by register_kretprobe().  Users that catch function entries by
+ * other means than a kprobe call it directly and hook returns with
+ * kretprobe_hook_return().
+ */
+int kretprobe_init_instances(struct kretprobe *rp)
+{
+	struct kretprobe_instance *inst;
+	int i;
+
 	/* Pre-allocate memory for max kretprobe instances */
 	if (rp->maxactive <= 0) {
 #ifdef CONFIG_PREEMPTION
@@ -2044,13 +2068,52 @@ int register_kretprobe(struct kretprobe *rp)
 	refcount_set(&rp->rph->ref, i);
 
 	rp->nmissed = 0;
-	/* Establish function entry probe point */
-	ret = register_kprobe(&rp->kp);
-	if (ret != 0)
-		free_rp_inst(rp);
-	return ret;
+	return 0;
 }
-EXPORT_SYMBOL_GPL(register_kretprobe);
+EXPORT_SYMBOL_GPL(kretprobe_init_instances);
+
+/**
+ * kretprobe_free_instances() -- release what kretprobe_init_instances() set up
+ * @rp: kretprobe no new returns are hooked for anymore
+ *
+ * Instances still waiting for their function to return are freed when
+ * it does.
+ */
+void kretprobe_free_instances(struct kretprobe *rp)
+{
+	WRITE_ONCE(rp->rph->rp, NULL);
+	synchronize_rcu();
+	free_rp_inst(rp);
+}
+EXPORT_SYMBOL_GPL(kretprobe_free_instances);
+
+/**
+ * kretprobe_hook_return() -- make a function return through @rp->handler
+ * @rp: kretprobe set up with kretprobe_init_instances()
+ * @regs: registers at the entry of the function
+ *
+ * Returns the instance whose data area the caller may fill in for the
+ * return handler, or NULL if all instances are in use.
+ */
+struct kretprobe_instance *kretprobe_hook_return(struct kretprobe *rp,
+						 struct pt_regs *regs)
+{
+	struct kretprobe_instance *ri;
+	struct freelist_node *fn;
+
+	fn = freelist_try_get(&rp->freelist);
+	if (!fn) {
+		rp->nmissed++;
+		return NULL;
+	}
+
+	ri = container_of(fn, struct kretprobe_instance, freelist);
+	arch_prepare_kretprobe(ri, regs);
+	__llist_add(&ri->llist, &current->kretprobe_instances);
+
+	return ri;
+}
+NOKPROBE_SYMBOL(kretprobe_hook_return);
 
 int register_kretprobes(struct kretprobe **rps, int num)
 {
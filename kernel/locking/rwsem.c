@@ -58,6 +58,12 @@
  *  - OSQ is empty
  *  - rwsem is not currently writer owned
  *  - the handoff isn't set.
+ *
+ * A reader finding the rwsem owned by a running writer spins on it like a
+ * writer would, instead of sleeping and having to be woken up with all the
+ * other readers queued behind that writer. Readers never spin on a
+ * reader-owned rwsem, they either join it right away or have to wait for
+ * a handoff to a writer.
  */
 #define RWSEM_READER_OWNED	(1UL << 0)
 #define RWSEM_NONSPINNABLE	(1UL << 1)
@@ -595,6 +601,28 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 	return false;
 }
 
+/*
+ * Try to acquire read lock before the reader has been put on wait queue.
+ */
+static inline bool rwsem_try_read_lock_unqueued(struct rw_semaphore *sem)
+{
+	long count = atomic_long_read(&sem->count);
+
+	if (count & (RWSEM_WRITER_MASK | RWSEM_FLAG_HANDOFF))
+		return false;
+
+	count = atomic_long_fetch_add_acquire(RWSEM_READER_BIAS, &sem->count);
+	if (!(count & (RWSEM_WRITER_MASK | RWSEM_FLAG_HANDOFF))) {
+		rwsem_set_reader_owned(sem);
+		lockevent_inc(rwsem_opt_rlock);
+		return true;
+	}
+
+	/* Back out the change */
+	atomic_long_add(-RWSEM_READER_BIAS, &sem->count);
+	return false;
+}
+
 static inline bool owner_on_cpu(struct task_struct *owner)
 {
 	/*
@@ -733,7 +761,7 @@ static inline u64 rwsem_rspin_threshold(struct rw_semaphore *sem)
 	return sched_clock() + delta;
 }
 
-static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
+static bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool wlock)
 {
 	bool taken = false;
 	int prev_owner_state = OWNER_NULL;
@@ -762,11 +790,19 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 		/*
 		 * Try to acquire the lock
 		 */
-		taken = rwsem_try_write_lock_unqueued(sem);
+		taken = wlock ? rwsem_try_write_lock_unqueued(sem)
+			      : rwsem_try_read_lock_unqueued(sem);
 
 		if (taken)
 			break;
 
+		/*
+		 * A reader failing to join a reader-owned rwsem is held off
+		 * by a pending handoff, it has to queue up.
+		 */
+		if (!wlock && owner_state == OWNER_READER)
+			break;
+
 		/*
 		 * Time-based reader-owned rwsem optimistic spinning
 		 */
@@ -850,7 +886,10 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 	osq_unlock(&sem->osq);
 done:
 	preempt_enable();
-	lockevent_cond_inc(rwsem_opt_fail, !taken);
+	if (wlock)
+		lockevent_cond_inc(rwsem_opt_fail, !taken);
+	else
+		lockevent_cond_inc(rwsem_opt_rfail, !taken);
 	return taken;
 }
 
@@ -870,7 +909,7 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 	return false;
 }
 
-static inline bool rwsem_optimistic_spin(struct rw_semaphore *sem)
+static inline bool rwsem_optimistic_spin(struct rw_semaphore *sem, bool wlock)
 {
 	return false;
 }
@@ -928,6 +967,35 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, long count, int state)
 		return sem;
 	}
 
+	/*
+	 * Spin on a running writer rather than sleep, unless a handoff
+	 * already promises the lock to a waiter.
+	 */
+	if ((count & RWSEM_FLAG_HANDOFF) || !rwsem_can_spin_on_owner(sem))
+		goto queue;
+
+	/*
+	 * Undo read bias from down_read() and do optimistic spinning.
+	 */
+	atomic_long_add(-RWSEM_READER_BIAS, &sem->count);
+	adjustment = 0;
+	if (rwsem_optimistic_spin(sem, false)) {
+		/* rwsem_optimistic_spin() implies ACQUIRE on success */
+		/*
+		 * Wake up other readers in the wait list if the front
+		 * waiter is a reader.
+		 */
+		if (atomic_long_read(&sem->count) & RWSEM_FLAG_WAITERS) {
+			raw_spin_lock_irq(&sem->wait_lock);
+			if (!list_empty(&sem->wait_list))
+				rwsem_mark_wake(sem, RWSEM_WAKE_READ_OWNED,
+						&wake_q);
+			raw_spin_unlock_irq(&sem->wait_lock);
+			wake_up_q(&wake_q);
+		}
+		return sem;
+	}
+
 queue:
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_READ;
@@ -939,9 +1007,10 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, long count, int state)
 		 * In case the wait queue is empty and the lock isn't owned
 		 * by a writer or has the handoff bit set, this reader can
 		 * exit the slowpath and return immediately as its
-		 * RWSEM_READER_BIAS has already been set in the count.
+		 * RWSEM_READER_BIAS has already been set in the count,
+		 * unless it was backed out for spinning.
 		 */
-		if (!(atomic_long_read(&sem->count) &
+		if (adjustment && !(atomic_long_read(&sem->count) &
 		     (RWSEM_WRITER_MASK | RWSEM_FLAG_HANDOFF))) {
 			/* Provide lock ACQUIRE */
 			smp_acquire__after_ctrl_dep();
@@ -1022,7 +1091,7 @@ rwsem_down_write_slowpath(struct rw_semaphore *sem, int state)
 	DEFINE_WAKE_Q(wake_q);
 
 	/* do optimistic spinning and steal lock if possible */
-	if (rwsem_can_spin_on_owner(sem) && rwsem_optimistic_spin(sem)) {
+	if (rwsem_can_spin_on_owner(sem) && rwsem_optimistic_spin(sem, true)) {
 		/* rwsem_optimistic_spin() implies ACQUIRE on success */
 		return sem;
 	}
@@ -42,6 +42,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
 #include <linux/sched/clock.h>
@@ -2133,6 +2134,48 @@ int vprintk_store(int facility, int level,
 	return (text_len + trunc_msg_len);
 }
 
+/*
+ * Once printk_kthread is running, it prints the consoles and printk() only
+ * wakes it up, so that callers never wait for slow consoles.  The callers
+ * go back to printing directly whenever the kthread might not get to run:
+ * during an oops or a panic and while the system is going down.
+ */
+static struct task_struct *printk_kthread;
+static DECLARE_WAIT_QUEUE_HEAD(printk_kthread_wait);
+static bool printk_kthread_pending;
+
+static bool printk_direct_required(void)
+{
+	return !READ_ONCE(printk_kthread) || oops_in_progress ||
+	       atomic_read(&panic_cpu) != PANIC_CPU_INVALID ||
+	       system_state > SYSTEM_RUNNING;
+}
+
+/* Not from the scheduler or with its locks held, see defer_console_output() */
+static void printk_kthread_wake(void)
+{
+	WRITE_ONCE(printk_kthread_pending, true);
+	if (wq_has_sleeper(&printk_kthread_wait))
+		wake_up_interruptible(&printk_kthread_wait);
+}
+
+static int printk_kthread_func(void *unused)
+{
+	for (;;) {
+		wait_event_interruptible(printk_kthread_wait,
+					 READ_ONCE(printk_kthread_pending));
+		WRITE_ONCE(printk_kthread_pending, false);
+		/* Order clearing the flag against reading the records */
+		smp_mb();
+
+		/* console_unlock() prints everything and may reschedule */
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
 asmlinkage int vprintk_emit(int facility, int level,
 			    const struct dev_printk_info *dev_info,
 			    const char *fmt, va_list args)
@@ -2158,7 +2201,9 @@ asmlinkage int vprintk_emit(int facility, int level,
 	printk_safe_exit_irqrestore(flags);
 
 	/* If called from the scheduler, we can not call up(). */
-	if (!in_sched) {
+	if (!in_sched && !printk_direct_required()) {
+		printk_kthread_wake();
+	} else if (!in_sched) {
 		/*
 		 * Disable preemption to avoid being preempted while holding
 		 * console_sem which would prevent anyone from printing to
@@ -3157,8 +3202,10 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
+		if (!printk_direct_required())
+			printk_kthread_wake();
 		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
+		else if (console_trylock())
 			console_unlock();
 	}
 
@@ -3193,6 +3240,23 @@ void defer_console_output(void)
 	preempt_enable();
 }
 
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *kt;
+
+	kt = kthread_run(printk_kthread_func, NULL, "pr/console");
+	if (IS_ERR(kt)) {
+		pr_err("failed to start printing thread, printing directly\n");
+		return PTR_ERR(kt);
+	}
+
+	WRITE_ONCE(printk_kthread, kt);
+	/* Print what was logged since the last direct printing */
+	printk_kthread_wake();
+	return 0;
+}
+late_initcall(printk_kthread_init);
+
 int vprintk_deferred(const char *fmt, va_list args)
 {
 	int r;
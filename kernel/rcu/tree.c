@@ -3114,6 +3114,204 @@ void call_rcu(struct rcu_head *head, rcu_callback_t func)
 }
 EXPORT_SYMBOL_GPL(call_rcu);
 
+#ifdef CONFIG_RCU_LAZY
+/* Maximum number of jiffies a lazy callback is held back, 0 disables. */
+static ulong jiffies_lazy_flush = 10 * HZ;
+module_param(jiffies_lazy_flush, ulong, 0644);
+/* Number of lazy callbacks on a CPU that forces them to be queued. */
+static long qlazymark = 10000;
+module_param(qlazymark, long, 0644);
+
+/**
+ * struct rcu_lazy_cpu - batch up call_rcu_lazy() requests
+ * @head: List of lazy callbacks not yet queued for a grace period
+ * @count: Number of callbacks on @head
+ * @lock: Synchronize access to this structure
+ * @flush_work: Queue @head for a grace period after jiffies_lazy_flush
+ * @flush_todo: Tracks whether a @flush_work delayed work is pending
+ * @cpu: CPU this structure belongs to, for tracing
+ */
+struct rcu_lazy_cpu {
+	struct rcu_head *head;
+	long count;
+	raw_spinlock_t lock;
+	struct delayed_work flush_work;
+	bool flush_todo;
+	int cpu;
+};
+
+static DEFINE_PER_CPU(struct rcu_lazy_cpu, rcu_lazy) = {
+	.lock = __RAW_SPIN_LOCK_UNLOCKED(rcu_lazy.lock),
+};
+
+/*
+ * Queue all the lazy callbacks of @rlcp for a grace period.  Called with
+ * @rlcp->lock held, which is released.  Returns the number of callbacks.
+ */
+static long rcu_lazy_flush_unlock(struct rcu_lazy_cpu *rlcp,
+				  unsigned long flags, const char *reason)
+{
+	struct rcu_head *head, *next;
+	long count;
+
+	head = rlcp->head;
+	count = rlcp->count;
+	rlcp->head = NULL;
+	WRITE_ONCE(rlcp->count, 0);
+	raw_spin_unlock_irqrestore(&rlcp->lock, flags);
+
+	if (count)
+		trace_rcu_lazy_flush(rcu_state.name, rlcp->cpu, count, reason);
+
+	for (; head; head = next) {
+		next = head->next;
+		__call_rcu(head, head->func);
+	}
+
+	return count;
+}
+
+static void rcu_lazy_flush_fn(struct work_struct *work)
+{
+	struct rcu_lazy_cpu *rlcp = container_of(work, struct rcu_lazy_cpu,
+						 flush_work.work);
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&rlcp->lock, flags);
+	rlcp->flush_todo = false;
+	rcu_lazy_flush_unlock(rlcp, flags, TPS("Timer"));
+}
+
+/* Queue the lazy callbacks of all CPUs, for rcu_barrier(). */
+static void rcu_lazy_flush_all(void)
+{
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct rcu_lazy_cpu *rlcp = per_cpu_ptr(&rcu_lazy, cpu);
+
+		if (!READ_ONCE(rlcp->count))
+			continue;
+		raw_spin_lock_irqsave(&rlcp->lock, flags);
+		rcu_lazy_flush_unlock(rlcp, flags, TPS("Barrier"));
+	}
+}
+
+/**
+ * call_rcu_lazy() - Queue an RCU callback whose invocation may be delayed.
+ * @head: structure to be used for queueing the RCU updates.
+ * @func: actual callback function to be invoked after the grace period
+ *
+ * Like call_rcu(), but the callback is first held back on a per-CPU list
+ * for up to rcutree.jiffies_lazy_flush jiffies, until rcutree.qlazymark
+ * callbacks have piled up on the CPU, or until memory gets short,
+ * whichever comes first.  This lets a mostly idle system batch the
+ * callbacks of many updates into few grace periods instead of waking
+ * CPUs up for each of them.
+ *
+ * Meant for callbacks that only free memory and that nobody waits for,
+ * other than rcu_barrier(), which also waits for lazy callbacks.
+ */
+void call_rcu_lazy(struct rcu_head *head, rcu_callback_t func)
+{
+	struct rcu_lazy_cpu *rlcp;
+	unsigned long flags;
+	long count;
+
+	if (!READ_ONCE(jiffies_lazy_flush) ||
+	    rcu_scheduler_active != RCU_SCHEDULER_RUNNING) {
+		__call_rcu(head, func);
+		return;
+	}
+
+	local_irq_save(flags);	// For safely calling this_cpu_ptr().
+	rlcp = this_cpu_ptr(&rcu_lazy);
+	raw_spin_lock(&rlcp->lock);
+
+	head->func = func;
+	head->next = rlcp->head;
+	rlcp->head = head;
+	count = rlcp->count + 1;
+	WRITE_ONCE(rlcp->count, count);
+	trace_rcu_lazy_callback(rcu_state.name, head, count);
+
+	if (count >= READ_ONCE(qlazymark)) {
+		rlcp->flush_todo = true;
+		mod_delayed_work(system_power_efficient_wq,
+				 &rlcp->flush_work, 0);
+	} else if (!rlcp->flush_todo) {
+		rlcp->flush_todo = true;
+		queue_delayed_work(system_power_efficient_wq, &rlcp->flush_work,
+				   READ_ONCE(jiffies_lazy_flush));
+	}
+
+	raw_spin_unlock_irqrestore(&rlcp->lock, flags);
+}
+EXPORT_SYMBOL_GPL(call_rcu_lazy);
+
+static unsigned long
+rcu_lazy_shrink_count(struct shrinker *shrink, struct shrink_control *sc)
+{
+	unsigned long count = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		count += READ_ONCE(per_cpu_ptr(&rcu_lazy, cpu)->count);
+
+	return count;
+}
+
+static unsigned long
+rcu_lazy_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
+{
+	unsigned long flags, freed = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct rcu_lazy_cpu *rlcp = per_cpu_ptr(&rcu_lazy, cpu);
+		long count;
+
+		if (!READ_ONCE(rlcp->count))
+			continue;
+		raw_spin_lock_irqsave(&rlcp->lock, flags);
+		count = rcu_lazy_flush_unlock(rlcp, flags, TPS("Shrink"));
+
+		sc->nr_to_scan -= count;
+		freed += count;
+
+		if (sc->nr_to_scan <= 0)
+			break;
+	}
+
+	return freed == 0 ? SHRINK_STOP : freed;
+}
+
+static struct shrinker rcu_lazy_shrinker = {
+	.count_objects = rcu_lazy_shrink_count,
+	.scan_objects = rcu_lazy_shrink_scan,
+	.batch = 0,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static void __init rcu_lazy_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct rcu_lazy_cpu *rlcp = per_cpu_ptr(&rcu_lazy, cpu);
+
+		INIT_DELAYED_WORK(&rlcp->flush_work, rcu_lazy_flush_fn);
+		rlcp->cpu = cpu;
+	}
+	if (register_shrinker(&rcu_lazy_shrinker))
+		pr_err("Failed to register call_rcu_lazy() shrinker!\n");
+}
+#else
+static inline void rcu_lazy_flush_all(void) { }
+static inline void rcu_lazy_init(void) { }
+#endif /* #else #ifdef CONFIG_RCU_LAZY */
+
 
 /* Maximum number of jiffies to wait before draining a batch. */
 #define KFREE_DRAIN_JIFFIES (HZ / 50)
@@ -4010,8 +4208,12 @@ void rcu_barrier(void)
 {
 	uintptr_t cpu;
 	struct rcu_data *rdp;
-	unsigned long s = rcu_seq_snap(&rcu_state.barrier_sequence);
+	unsigned long s;
+
+	/* Lazy callbacks are waited for too, give them to their CPUs first. */
+	rcu_lazy_flush_all();
 
+	s = rcu_seq_snap(&rcu_state.barrier_sequence);
 	rcu_barrier_trace(TPS("Begin"), -1, s);
 
 	/* Take mutex to serialize concurrent rcu_barrier() requests. */
@@ -4710,6 +4912,7 @@ void __init rcu_init(void)
 	rcu_early_boot_tests();
 
 	kfree_rcu_batch_init();
+	rcu_lazy_init();
 	rcu_bootup_announce();
 	rcu_init_geometry();
 	rcu_init_one();
@@ -315,6 +315,20 @@ static inline void ignore_dl_rate_limit(struct sugov_cpu *sg_cpu)
 		sg_cpu->sg_policy->limits_changed = true;
 }
 
+/*
+ * Likewise for the wakeup of a uclamp_min boosted task, as long as the
+ * driver can switch frequency from the scheduler context cheaply.
+ */
+static inline void ignore_uclamp_rate_limit(struct sugov_cpu *sg_cpu,
+					    unsigned int flags)
+{
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+
+	if ((flags & SCHED_CPUFREQ_UCLAMP) &&
+	    sg_policy->policy->fast_switch_enabled)
+		sg_policy->limits_changed = true;
+}
+
 static inline bool sugov_update_single_common(struct sugov_cpu *sg_cpu,
 					      u64 time, unsigned int flags)
 {
@@ -322,6 +336,7 @@ static inline bool sugov_update_single_common(struct sugov_cpu *sg_cpu,
 	sg_cpu->last_update = time;
 
 	ignore_dl_rate_limit(sg_cpu);
+	ignore_uclamp_rate_limit(sg_cpu, flags);
 
 	if (!sugov_should_update_freq(sg_cpu->sg_policy, time))
 		return false;
@@ -442,6 +457,7 @@ sugov_update_shared(struct update_util_data *hook, u64 time, unsigned int flags)
 	sg_cpu->last_update = time;
 
 	ignore_dl_rate_limit(sg_cpu);
+	ignore_uclamp_rate_limit(sg_cpu, flags);
 
 	if (sugov_should_update_freq(sg_policy, time)) {
 		next_f = sugov_next_freq_shared(sg_cpu, time);
@@ -327,6 +327,9 @@ static __init int sched_init_debug(void)
 	debugfs_create_u32("scan_period_min_ms", 0644, numa, &sysctl_numa_balancing_scan_period_min);
 	debugfs_create_u32("scan_period_max_ms", 0644, numa, &sysctl_numa_balancing_scan_period_max);
 	debugfs_create_u32("scan_size_mb", 0644, numa, &sysctl_numa_balancing_scan_size);
+	debugfs_create_u32("hot_threshold_ms", 0644, numa, &sysctl_numa_balancing_hot_threshold);
+	debugfs_create_u32("promote_rate_limit_MBps", 0644, numa,
+			   &sysctl_numa_balancing_promote_rate_limit);
 #endif
 
 	debugfs_create_file("debug", 0444, debugfs_sched, NULL, &sched_debug_fops);
@@ -918,6 +921,8 @@ static void sched_show_numa(struct task_struct *p, struct seq_file *m)
 	task_unlock(p);
 
 	P(numa_pages_migrated);
+	P(numa_scan_pte_updates);
+	P(numa_scan_vmas_skipped);
 	P(numa_preferred_nid);
 	P(total_numa_faults);
 	SEQ_printf(m, "current_node=%d, numa_group_id=%d\n",
@@ -0,0 +1,774 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Extensible scheduling class, whose policy is implemented by a BPF program
+ * through struct sched_ext_ops.
+ *
+ * The class sits between the fair and the idle class and runs tasks with
+ * the SCHED_EXT policy while a BPF scheduler is loaded; otherwise those
+ * tasks are run by the fair class.
+ *
+ * Runnable tasks of the class are kept on dispatch queues (DSQs): a FIFO
+ * per CPU, from which that CPU picks the next task, and a global FIFO
+ * that CPUs running out of work pull from.  On enqueue the BPF scheduler
+ * decides which DSQ a task goes to and for how long it may run.
+ *
+ * Any misbehaviour of the BPF scheduler disables it, which moves all its
+ * tasks back to the fair class.
+ */
+#include "sched.h"
+
+#include <linux/bpf.h>
+#include <linux/bpf_verifier.h>
+#include <linux/btf.h>
+#include <linux/btf_ids.h>
+#include <linux/filter.h>
+
+enum scx_ops_state {
+	SCX_OPS_DISABLED,
+	SCX_OPS_ENABLED,
+	SCX_OPS_DISABLING,
+};
+
+static DEFINE_MUTEX(scx_ops_mutex);
+static int scx_ops_state = SCX_OPS_DISABLED;
+static struct sched_ext_ops scx_ops;
+static struct sched_ext_ops *scx_ops_kdata;
+
+DEFINE_STATIC_KEY_FALSE(__scx_ops_enabled);
+
+static struct scx_dispatch_q scx_dsq_global = {
+	.lock	= __RAW_SPIN_LOCK_UNLOCKED(scx_dsq_global.lock),
+	.fifo	= LIST_HEAD_INIT(scx_dsq_global.fifo),
+	.id	= SCX_DSQ_GLOBAL,
+};
+
+/* rq locked around the ops call in progress on this CPU */
+static DEFINE_PER_CPU(struct rq *, scx_locked_rq);
+
+static atomic_t scx_error = ATOMIC_INIT(0);
+static char scx_error_msg[128];
+
+static void scx_ops_disable(struct sched_ext_ops *ops);
+
+static void scx_ops_disable_workfn(struct work_struct *work)
+{
+	scx_ops_disable(NULL);
+}
+static DECLARE_WORK(scx_ops_disable_work, scx_ops_disable_workfn);
+
+static void scx_ops_error_irq_workfn(struct irq_work *irq_work)
+{
+	schedule_work(&scx_ops_disable_work);
+}
+static DEFINE_IRQ_WORK(scx_ops_error_irq_work, scx_ops_error_irq_workfn);
+
+/*
+ * Record the first error of the BPF scheduler and disable it.  Can be
+ * called with rq locks held, so the disabling is punted to a work item.
+ */
+static __printf(1, 2) void scx_ops_error(const char *fmt, ...)
+{
+	va_list args;
+
+	if (atomic_cmpxchg(&scx_error, 0, 1))
+		return;
+
+	va_start(args, fmt);
+	vscnprintf(scx_error_msg, sizeof(scx_error_msg), fmt, args);
+	va_end(args);
+
+	irq_work_queue(&scx_ops_error_irq_work);
+}
+
+static inline bool scx_ops_live(void)
+{
+	return READ_ONCE(scx_ops_state) == SCX_OPS_ENABLED &&
+		!atomic_read(&scx_error);
+}
+
+#define SCX_HAS_OP(op)	(scx_ops_live() && scx_ops.op)
+
+#define SCX_CALL_OP(rq, op, args...)					\
+do {									\
+	__this_cpu_write(scx_locked_rq, rq);				\
+	scx_ops.op(args);						\
+	__this_cpu_write(scx_locked_rq, NULL);				\
+} while (0)
+
+#define SCX_CALL_OP_RET(rq, op, args...)				\
+({									\
+	__typeof__(scx_ops.op(args)) __ret;				\
+	__this_cpu_write(scx_locked_rq, rq);				\
+	__ret = scx_ops.op(args);					\
+	__this_cpu_write(scx_locked_rq, NULL);				\
+	__ret;								\
+})
+
+static void init_dsq(struct scx_dispatch_q *dsq, u64 id)
+{
+	raw_spin_lock_init(&dsq->lock);
+	INIT_LIST_HEAD(&dsq->fifo);
+	dsq->nr = 0;
+	dsq->id = id;
+}
+
+static inline bool dsq_is_local(struct scx_dispatch_q *dsq)
+{
+	return dsq->id == SCX_DSQ_LOCAL;
+}
+
+/*
+ * Local DSQs are protected by the lock of their rq, the global DSQ by its
+ * own lock.  A task's dsq pointer only changes under the task's rq lock,
+ * except when a CPU takes it off the global DSQ to migrate it, in which
+ * case the CPU records itself in holding_cpu first.
+ */
+static void dispatch_enqueue(struct scx_dispatch_q *dsq, struct task_struct *p,
+			     u64 enq_flags)
+{
+	bool is_local = dsq_is_local(dsq);
+
+	WARN_ON_ONCE(p->scx.dsq || !list_empty(&p->scx.dsq_node));
+
+	if (!is_local)
+		raw_spin_lock(&dsq->lock);
+
+	if (enq_flags & SCX_ENQ_HEAD)
+		list_add(&p->scx.dsq_node, &dsq->fifo);
+	else
+		list_add_tail(&p->scx.dsq_node, &dsq->fifo);
+	WRITE_ONCE(dsq->nr, dsq->nr + 1);
+	p->scx.dsq = dsq;
+
+	if (!is_local)
+		raw_spin_unlock(&dsq->lock);
+}
+
+static void __dispatch_dequeue(struct scx_dispatch_q *dsq,
+			       struct task_struct *p)
+{
+	list_del_init(&p->scx.dsq_node);
+	WRITE_ONCE(dsq->nr, dsq->nr - 1);
+}
+
+/* Takes @p off its DSQ, or away from a CPU about to migrate it */
+static void dispatch_dequeue(struct task_struct *p)
+{
+	struct scx_dispatch_q *dsq = smp_load_acquire(&p->scx.dsq);
+
+	if (!dsq) {
+		p->scx.holding_cpu = -1;
+		return;
+	}
+
+	if (dsq_is_local(dsq)) {
+		__dispatch_dequeue(dsq, p);
+		p->scx.dsq = NULL;
+		return;
+	}
+
+	raw_spin_lock(&dsq->lock);
+	if (p->scx.dsq == dsq) {
+		__dispatch_dequeue(dsq, p);
+		p->scx.dsq = NULL;
+	} else {
+		p->scx.holding_cpu = -1;
+	}
+	raw_spin_unlock(&dsq->lock);
+}
+
+#ifdef CONFIG_SMP
+static void scx_kick_workfn(struct irq_work *irq_work)
+{
+	resched_cpu(smp_processor_id());
+}
+
+/* Make an idle CPU that may run @p look at the global DSQ */
+static void kick_idle_cpu(struct rq *rq, struct task_struct *p)
+{
+	int cpu;
+
+	for_each_cpu_and(cpu, p->cpus_ptr, cpu_online_mask) {
+		if (cpu != cpu_of(rq) && idle_cpu(cpu)) {
+			irq_work_queue_on(&cpu_rq(cpu)->scx.kick_work, cpu);
+			return;
+		}
+	}
+}
+
+static void dispatch_to_global(struct rq *rq, struct task_struct *p,
+			       u64 enq_flags)
+{
+	dispatch_enqueue(&scx_dsq_global, p, enq_flags);
+	kick_idle_cpu(rq, p);
+}
+#else
+/* With a single CPU, the global DSQ is the local one */
+static void dispatch_to_global(struct rq *rq, struct task_struct *p,
+			       u64 enq_flags)
+{
+	dispatch_enqueue(&rq->scx.local_dsq, p, enq_flags);
+}
+#endif
+
+static void do_enqueue_task(struct rq *rq, struct task_struct *p, u64 enq_flags)
+{
+	if (p->scx.flags & SCX_TASK_ENQ_LOCAL) {
+		p->scx.flags &= ~SCX_TASK_ENQ_LOCAL;
+		dispatch_enqueue(&rq->scx.local_dsq, p, enq_flags);
+		return;
+	}
+
+	if (SCX_HAS_OP(enqueue)) {
+		/* Cleared by scx_bpf_dispatch() */
+		p->scx.flags |= SCX_TASK_OPS_ENQ;
+		SCX_CALL_OP(rq, enqueue, p, enq_flags);
+		if (!(p->scx.flags & SCX_TASK_OPS_ENQ))
+			return;
+		p->scx.flags &= ~SCX_TASK_OPS_ENQ;
+	}
+
+	p->scx.slice = SCX_SLICE_DFL;
+	dispatch_to_global(rq, p, enq_flags);
+}
+
+static void update_curr_scx(struct rq *rq)
+{
+	struct task_struct *curr = rq->curr;
+	u64 now = rq_clock_task(rq);
+	u64 delta_exec;
+
+	if (curr->sched_class != &ext_sched_class)
+		return;
+
+	delta_exec = now - curr->se.exec_start;
+	if (unlikely((s64)delta_exec <= 0))
+		return;
+
+	schedstat_set(curr->se.statistics.exec_max,
+		      max(curr->se.statistics.exec_max, delta_exec));
+
+	curr->se.sum_exec_runtime += delta_exec;
+	account_group_exec_runtime(curr, delta_exec);
+	cgroup_account_cputime(curr, delta_exec);
+	curr->se.exec_start = now;
+
+	curr->scx.slice -= min(curr->scx.slice, delta_exec);
+}
+
+static void enqueue_task_scx(struct rq *rq, struct task_struct *p, int flags)
+{
+	u64 enq_flags = 0;
+
+	if (flags & ENQUEUE_WAKEUP)
+		enq_flags |= SCX_ENQ_WAKEUP;
+	if (flags & ENQUEUE_HEAD)
+		enq_flags |= SCX_ENQ_HEAD;
+
+	p->scx.flags |= SCX_TASK_QUEUED;
+	add_nr_running(rq, 1);
+
+	do_enqueue_task(rq, p, enq_flags);
+}
+
+static void dequeue_task_scx(struct rq *rq, struct task_struct *p, int flags)
+{
+	if (WARN_ON_ONCE(!(p->scx.flags & SCX_TASK_QUEUED)))
+		return;
+
+	if (task_current(rq, p))
+		update_curr_scx(rq);
+
+	/* Moves between CPUs done by the class are not visible to the ops */
+	if (!(p->scx.flags & SCX_TASK_ENQ_LOCAL) && SCX_HAS_OP(dequeue))
+		SCX_CALL_OP(rq, dequeue, p,
+			    (flags & DEQUEUE_SLEEP) ? SCX_DEQ_SLEEP : 0);
+
+	dispatch_dequeue(p);
+	p->scx.flags &= ~SCX_TASK_QUEUED;
+	sub_nr_running(rq, 1);
+}
+
+static void yield_task_scx(struct rq *rq)
+{
+	rq->curr->scx.slice = 0;
+}
+
+static void check_preempt_curr_scx(struct rq *rq, struct task_struct *p,
+				   int wake_flags)
+{
+	/* tasks of the class run to the end of their slice */
+}
+
+static void set_next_task_scx(struct rq *rq, struct task_struct *p, bool first)
+{
+	/* a running task is on no DSQ */
+	dispatch_dequeue(p);
+	p->se.exec_start = rq_clock_task(rq);
+
+	if (SCX_HAS_OP(running))
+		SCX_CALL_OP(rq, running, p);
+}
+
+static struct task_struct *pick_next_task_scx(struct rq *rq)
+{
+	struct task_struct *p;
+
+	p = list_first_entry_or_null(&rq->scx.local_dsq.fifo,
+				     struct task_struct, scx.dsq_node);
+	if (!p)
+		return NULL;
+
+	set_next_task_scx(rq, p, true);
+	return p;
+}
+
+static void put_prev_task_scx(struct rq *rq, struct task_struct *p)
+{
+	update_curr_scx(rq);
+
+	/* Not runnable, or already requeued by balance_scx() */
+	if (!(p->scx.flags & SCX_TASK_QUEUED) ||
+	    smp_load_acquire(&p->scx.dsq) || p->scx.holding_cpu >= 0)
+		return;
+
+	/* Preempted by a higher class, resume it first */
+	if (p->scx.slice)
+		dispatch_enqueue(&rq->scx.local_dsq, p, SCX_ENQ_HEAD);
+	else
+		do_enqueue_task(rq, p, 0);
+}
+
+#ifdef CONFIG_SMP
+/*
+ * Move @p, which this CPU took off the global DSQ, from @src_rq to the
+ * local DSQ of @rq.  Puts @p back on the global DSQ if it cannot be moved.
+ */
+static bool move_task_to_local_dsq(struct rq *rq, struct task_struct *p,
+				   struct rq *src_rq, struct rq_flags *rf)
+{
+	int cpu = cpu_of(rq);
+	bool moved = false;
+
+	rq_unpin_lock(rq, rf);
+	double_lock_balance(rq, src_rq);
+
+	/* Cleared if @p got dequeued in the meantime */
+	if (p->scx.holding_cpu == cpu) {
+		p->scx.holding_cpu = -1;
+
+		if (cpu_active(cpu) && cpumask_test_cpu(cpu, p->cpus_ptr) &&
+		    !is_migration_disabled(p) && !task_running(src_rq, p)) {
+			p->scx.flags |= SCX_TASK_ENQ_LOCAL;
+			deactivate_task(src_rq, p, 0);
+			set_task_cpu(p, cpu);
+			activate_task(rq, p, 0);
+			moved = true;
+		} else {
+			dispatch_enqueue(&scx_dsq_global, p, 0);
+		}
+	}
+
+	double_unlock_balance(rq, src_rq);
+	rq_repin_lock(rq, rf);
+
+	return moved;
+}
+
+/* Move the first task on the global DSQ that can run here to @rq */
+static bool consume_global_dsq(struct rq *rq, struct rq_flags *rf)
+{
+	struct scx_dispatch_q *dsq = &scx_dsq_global;
+	int cpu = cpu_of(rq);
+	struct task_struct *p;
+	struct rq *src_rq;
+
+retry:
+	if (!READ_ONCE(dsq->nr))
+		return false;
+
+	raw_spin_lock(&dsq->lock);
+	list_for_each_entry(p, &dsq->fifo, scx.dsq_node) {
+		src_rq = task_rq(p);
+
+		if (src_rq == rq) {
+			__dispatch_dequeue(dsq, p);
+			p->scx.dsq = NULL;
+			raw_spin_unlock(&dsq->lock);
+			dispatch_enqueue(&rq->scx.local_dsq, p, 0);
+			return true;
+		}
+
+		if (!cpu_active(cpu) || !cpumask_test_cpu(cpu, p->cpus_ptr) ||
+		    is_migration_disabled(p) || task_running(src_rq, p))
+			continue;
+
+		p->scx.holding_cpu = cpu;
+		__dispatch_dequeue(dsq, p);
+		smp_store_release(&p->scx.dsq, NULL);
+		raw_spin_unlock(&dsq->lock);
+
+		if (move_task_to_local_dsq(rq, p, src_rq, rf))
+			return true;
+		goto retry;
+	}
+	raw_spin_unlock(&dsq->lock);
+
+	return false;
+}
+
+static int balance_scx(struct rq *rq, struct task_struct *prev,
+		       struct rq_flags *rf)
+{
+	if (prev->sched_class == &ext_sched_class &&
+	    (prev->scx.flags & SCX_TASK_QUEUED)) {
+		update_curr_scx(rq);
+		if (prev->scx.slice)
+			return 1;
+		/*
+		 * Let the BPF scheduler place @prev now, so that it can be
+		 * picked again if it went to the global DSQ.
+		 */
+		do_enqueue_task(rq, prev, 0);
+	}
+
+	if (rq->scx.local_dsq.nr)
+		return 1;
+
+	if (SCX_HAS_OP(dispatch))
+		SCX_CALL_OP(rq, dispatch, cpu_of(rq), prev);
+
+	return consume_global_dsq(rq, rf);
+}
+
+static int select_task_rq_scx(struct task_struct *p, int prev_cpu,
+			      int wake_flags)
+{
+	s32 cpu;
+
+	if (!SCX_HAS_OP(select_cpu))
+		return prev_cpu;
+
+	cpu = SCX_CALL_OP_RET(NULL, select_cpu, p, prev_cpu, wake_flags);
+	if ((u32)cpu >= nr_cpu_ids) {
+		scx_ops_error("select_cpu returned invalid cpu %d", cpu);
+		return prev_cpu;
+	}
+
+	return cpu;
+}
+#endif /* CONFIG_SMP */
+
+static void task_tick_scx(struct rq *rq, struct task_struct *curr, int queued)
+{
+	update_curr_scx(rq);
+
+	if (!curr->scx.slice)
+		resched_curr(rq);
+}
+
+static void switched_to_scx(struct rq *rq, struct task_struct *p)
+{
+	if (task_on_rq_queued(p) &&
+	    rq->curr->sched_class <= &ext_sched_class)
+		resched_curr(rq);
+}
+
+static void prio_changed_scx(struct rq *rq, struct task_struct *p, int oldprio)
+{
+}
+
+DEFINE_SCHED_CLASS(ext) = {
+	.enqueue_task		= enqueue_task_scx,
+	.dequeue_task		= dequeue_task_scx,
+	.yield_task		= yield_task_scx,
+
+	.check_preempt_curr	= check_preempt_curr_scx,
+
+	.pick_next_task		= pick_next_task_scx,
+	.put_prev_task		= put_prev_task_scx,
+	.set_next_task		= set_next_task_scx,
+
+#ifdef CONFIG_SMP
+	.balance		= balance_scx,
+	.select_task_rq		= select_task_rq_scx,
+	.set_cpus_allowed	= set_cpus_allowed_common,
+#endif
+
+	.task_tick		= task_tick_scx,
+
+	.switched_to		= switched_to_scx,
+	.prio_changed		= prio_changed_scx,
+	.update_curr		= update_curr_scx,
+};
+
+void __init init_scx_rq(struct scx_rq *scx_rq)
+{
+	init_dsq(&scx_rq->local_dsq, SCX_DSQ_LOCAL);
+#ifdef CONFIG_SMP
+	init_irq_work(&scx_rq->kick_work, scx_kick_workfn);
+#endif
+}
+
+/*
+ * Kernel functions callable from the BPF scheduler.
+ */
+__diag_push();
+__diag_ignore(GCC, 8, "-Wmissing-prototypes",
+	      "Global functions as their definitions will be in vmlinux BTF");
+
+/**
+ * scx_bpf_dispatch - put the task being enqueued on a dispatch queue
+ * @p: task passed to ops.enqueue()
+ * @dsq_id: SCX_DSQ_LOCAL or SCX_DSQ_GLOBAL
+ * @slice: time slice in ns, 0 for SCX_SLICE_DFL
+ * @enq_flags: SCX_ENQ_HEAD to queue at the head
+ */
+void noinline scx_bpf_dispatch(struct task_struct *p, u64 dsq_id, u64 slice,
+			       u64 enq_flags)
+{
+	struct rq *rq = __this_cpu_read(scx_locked_rq);
+
+	if (!rq || task_rq(p) != rq || !(p->scx.flags & SCX_TASK_OPS_ENQ)) {
+		scx_ops_error("%s[%d] dispatched outside of its ops.enqueue()",
+			      p->comm, p->pid);
+		return;
+	}
+
+	enq_flags &= SCX_ENQ_HEAD;
+
+	switch (dsq_id) {
+	case SCX_DSQ_LOCAL:
+		p->scx.slice = slice ?: SCX_SLICE_DFL;
+		p->scx.flags &= ~SCX_TASK_OPS_ENQ;
+		dispatch_enqueue(&rq->scx.local_dsq, p, enq_flags);
+		break;
+	case SCX_DSQ_GLOBAL:
+		p->scx.slice = slice ?: SCX_SLICE_DFL;
+		p->scx.flags &= ~SCX_TASK_OPS_ENQ;
+		dispatch_to_global(rq, p, enq_flags);
+		break;
+	default:
+		scx_ops_error("invalid dsq_id 0x%016llx", dsq_id);
+		break;
+	}
+}
+
+/**
+ * scx_bpf_dsq_nr_queued - number of tasks on a dispatch queue
+ * @dsq_id: SCX_DSQ_LOCAL for the current CPU's, or SCX_DSQ_GLOBAL
+ */
+u32 noinline scx_bpf_dsq_nr_queued(u64 dsq_id)
+{
+	switch (dsq_id) {
+	case SCX_DSQ_LOCAL:
+		return READ_ONCE(cpu_rq(raw_smp_processor_id())->scx.local_dsq.nr);
+	case SCX_DSQ_GLOBAL:
+		return READ_ONCE(scx_dsq_global.nr);
+	default:
+		scx_ops_error("invalid dsq_id 0x%016llx", dsq_id);
+		return 0;
+	}
+}
+
+/**
+ * scx_bpf_pick_idle_cpu - find an idle CPU
+ * @cpus_allowed: CPUs to look at, usually the task's cpus_ptr
+ *
+ * Return: the first idle CPU in @cpus_allowed, or -EBUSY.
+ */
+s32 noinline scx_bpf_pick_idle_cpu(const struct cpumask *cpus_allowed)
+{
+	int cpu;
+
+	for_each_cpu_and(cpu, cpus_allowed, cpu_online_mask) {
+		if (available_idle_cpu(cpu))
+			return cpu;
+	}
+
+	return -EBUSY;
+}
+
+__diag_pop();
+
+/*
+ * Loading and unloading of the BPF scheduler.
+ */
+static void scx_switch_all_tasks(void)
+{
+	struct task_struct *g, *p;
+
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, p) {
+		if (p->policy == SCHED_EXT)
+			sched_set_normal_class(p);
+	}
+	read_unlock(&tasklist_lock);
+}
+
+static int scx_ops_enable(struct sched_ext_ops *ops)
+{
+	int ret = 0;
+
+	mutex_lock(&scx_ops_mutex);
+
+	if (scx_ops_state != SCX_OPS_DISABLED) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	scx_ops = *ops;
+	atomic_set(&scx_error, 0);
+
+	if (scx_ops.init) {
+		ret = scx_ops.init();
+		if (ret)
+			goto unlock;
+	}
+
+	scx_ops_kdata = ops;
+	WRITE_ONCE(scx_ops_state, SCX_OPS_ENABLED);
+	static_branch_enable(&__scx_ops_enabled);
+
+	scx_switch_all_tasks();
+	pr_info("sched_ext: BPF scheduler \"%s\" enabled\n", scx_ops.name);
+unlock:
+	mutex_unlock(&scx_ops_mutex);
+	return ret;
+}
+
+/* @ops is NULL when disabling after an error */
+static void scx_ops_disable(struct sched_ext_ops *ops)
+{
+	mutex_lock(&scx_ops_mutex);
+
+	if (scx_ops_state != SCX_OPS_ENABLED)
+		goto unlock;
+	if (ops ? ops != scx_ops_kdata : !atomic_read(&scx_error))
+		goto unlock;
+
+	WRITE_ONCE(scx_ops_state, SCX_OPS_DISABLING);
+	static_branch_disable(&__scx_ops_enabled);
+
+	/* ops are only called with an rq or pi lock held */
+	synchronize_rcu();
+
+	scx_switch_all_tasks();
+
+	if (scx_ops.exit)
+		scx_ops.exit();
+
+	if (atomic_read(&scx_error))
+		pr_err("sched_ext: BPF scheduler \"%s\" disabled: %s\n",
+		       scx_ops.name, scx_error_msg);
+	else
+		pr_info("sched_ext: BPF scheduler \"%s\" disabled\n",
+			scx_ops.name);
+
+	scx_ops_kdata = NULL;
+	WRITE_ONCE(scx_ops_state, SCX_OPS_DISABLED);
+unlock:
+	mutex_unlock(&scx_ops_mutex);
+}
+
+/*
+ * struct_ops glue.
+ */
+static bool bpf_scx_is_valid_access(int off, int size,
+				    enum bpf_access_type type,
+				    const struct bpf_prog *prog,
+				    struct bpf_insn_access_aux *info)
+{
+	if (off < 0 || off >= sizeof(__u64) * MAX_BPF_FUNC_ARGS)
+		return false;
+	if (type != BPF_READ)
+		return false;
+	if (off % size != 0)
+		return false;
+
+	return btf_ctx_access(off, size, type, prog, info);
+}
+
+static int bpf_scx_btf_struct_access(struct bpf_verifier_log *log,
+				     const struct btf *btf,
+				     const struct btf_type *t, int off,
+				     int size, enum bpf_access_type atype,
+				     u32 *next_btf_id)
+{
+	if (atype == BPF_READ)
+		return btf_struct_access(log, btf, t, off, size, atype,
+					 next_btf_id);
+
+	bpf_log(log, "only read is supported\n");
+	return -EACCES;
+}
+
+static const struct bpf_func_proto *
+bpf_scx_get_func_proto(enum bpf_func_id func_id, const struct bpf_prog *prog)
+{
+	return bpf_base_func_proto(func_id);
+}
+
+BTF_SET_START(scx_kfunc_ids)
+BTF_ID(func, scx_bpf_dispatch)
+BTF_ID(func, scx_bpf_dsq_nr_queued)
+BTF_ID(func, scx_bpf_pick_idle_cpu)
+BTF_SET_END(scx_kfunc_ids)
+
+static bool bpf_scx_check_kfunc_call(u32 kfunc_btf_id)
+{
+	return btf_id_set_contains(&scx_kfunc_ids, kfunc_btf_id);
+}
+
+static const struct bpf_verifier_ops bpf_scx_verifier_ops = {
+	.get_func_proto		= bpf_scx_get_func_proto,
+	.is_valid_access	= bpf_scx_is_valid_access,
+	.btf_struct_access	= bpf_scx_btf_struct_access,
+	.check_kfunc_call	= bpf_scx_check_kfunc_call,
+};
+
+static int bpf_scx_init_member(const struct btf_type *t,
+			       const struct btf_member *member,
+			       void *kdata, const void *udata)
+{
+	const struct sched_ext_ops *uops = udata;
+	struct sched_ext_ops *ops = kdata;
+	u32 moff = btf_member_bit_offset(t, member) / 8;
+
+	switch (moff) {
+	case offsetof(struct sched_ext_ops, name):
+		if (bpf_obj_name_cpy(ops->name, uops->name,
+				     sizeof(ops->name)) <= 0)
+			return -EINVAL;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int bpf_scx_reg(void *kdata)
+{
+	return scx_ops_enable(kdata);
+}
+
+static void bpf_scx_unreg(void *kdata)
+{
+	scx_ops_disable(kdata);
+}
+
+static int bpf_scx_init(struct btf *btf)
+{
+	return 0;
+}
+
+/* Avoid sparse warning.  It is only used in bpf_struct_ops.c. */
+extern struct bpf_struct_ops bpf_sched_ext_ops;
+
+struct bpf_struct_ops bpf_sched_ext_ops = {
+	.verifier_ops = &bpf_scx_verifier_ops,
+	.reg = bpf_scx_reg,
+	.unreg = bpf_scx_unreg,
+	.init_member = bpf_scx_init_member,
+	.init = bpf_scx_init,
+	.name = "sched_ext_ops",
+};
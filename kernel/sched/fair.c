@@ -1080,6 +1080,12 @@ unsigned int sysctl_numa_balancing_scan_size = 256;
 /* Scan @scan_size MB every @scan_period after an initial @scan_delay in ms */
 unsigned int sysctl_numa_balancing_scan_delay = 1000;
 
+/* The page with hint page fault latency < threshold in ms is considered hot */
+unsigned int sysctl_numa_balancing_hot_threshold = MSEC_PER_SEC;
+
+/* Restrict the NUMA promotion throughput (MB/s) for each target node. */
+unsigned int sysctl_numa_balancing_promote_rate_limit = 65536;
+
 struct numa_group {
 	refcount_t refcount;
 
@@ -1420,6 +1426,44 @@ static inline unsigned long group_weight(struct task_struct *p, int nid,
 	return 1000 * faults / total_faults;
 }
 
+/*
+ * For memory tiering mode, the hint page fault latency is the time from
+ * when the scanner made the page PROT_NONE to the fault.  It is short for
+ * pages that are accessed frequently, which are worth promoting.
+ */
+static int numa_hint_fault_latency(struct page *page)
+{
+	int last_time, time;
+
+	time = jiffies_to_msecs(jiffies);
+	last_time = xchg_page_access_time(page, time);
+
+	return (time - last_time) & PAGE_ACCESS_TIME_MASK;
+}
+
+/*
+ * For memory tiering mode, too high promotion/demotion throughput may
+ * hurt application latency.  So we provide a mechanism to rate limit
+ * the number of pages that are tried to be promoted.
+ */
+static bool numa_promotion_rate_limit(struct pglist_data *pgdat,
+				      unsigned long rate_limit, int nr)
+{
+	unsigned long nr_cand;
+	unsigned int now, start;
+
+	now = jiffies_to_msecs(jiffies);
+	mod_node_page_state(pgdat, PGPROMOTE_CANDIDATE, nr);
+	nr_cand = node_page_state(pgdat, PGPROMOTE_CANDIDATE);
+	start = pgdat->nbp_rl_start;
+	if (now - start > MSEC_PER_SEC &&
+	    cmpxchg(&pgdat->nbp_rl_start, start, now) == start)
+		pgdat->nbp_rl_nr_cand = nr_cand;
+	if (nr_cand - pgdat->nbp_rl_nr_cand >= rate_limit)
+		return true;
+	return false;
+}
+
 bool should_numa_migrate_memory(struct task_struct *p, struct page * page,
 				int src_nid, int dst_cpu)
 {
@@ -1427,6 +1471,27 @@ bool should_numa_migrate_memory(struct task_struct *p, struct page * page,
 	int dst_nid = cpu_to_node(dst_cpu);
 	int last_cpupid, this_cpupid;
 
+	/*
+	 * The pages in slow memory node should be migrated according
+	 * to hot/cold instead of private/shared.
+	 */
+	if (sysctl_numa_balancing_mode & NUMA_BALANCING_MEMORY_TIERING &&
+	    !node_is_toptier(src_nid)) {
+		struct pglist_data *pgdat;
+		unsigned long rate_limit, latency, th;
+
+		pgdat = NODE_DATA(dst_nid);
+		th = READ_ONCE(sysctl_numa_balancing_hot_threshold);
+		latency = numa_hint_fault_latency(page);
+		if (latency >= th)
+			return false;
+
+		rate_limit = READ_ONCE(sysctl_numa_balancing_promote_rate_limit) <<
+			(20 - PAGE_SHIFT);
+		return !numa_promotion_rate_limit(pgdat, rate_limit,
+						  thp_nr_pages(page));
+	}
+
 	this_cpupid = cpu_pid_to_cpupid(dst_cpu, current->pid);
 	last_cpupid = page_cpupid_xchg_last(page, this_cpupid);
 
@@ -2647,6 +2712,14 @@ void task_numa_fault(int last_cpupid, int mem_node, int pages, int flags)
 	if (!p->mm)
 		return;
 
+	/*
+	 * NUMA faults statistics are unnecessary for the slow memory
+	 * node for memory tiering mode.
+	 */
+	if (!node_is_toptier(mem_node) &&
+	    (sysctl_numa_balancing_mode & NUMA_BALANCING_MEMORY_TIERING))
+		return;
+
 	/* Allocate buffer to track faults on a per-node basis */
 	if (unlikely(!p->numa_faults)) {
 		int size = sizeof(*p->numa_faults) *
@@ -2721,6 +2794,45 @@ static void reset_ptenuma_scan(struct task_struct *p)
  * The expensive part of numa migration is done from task_work context.
  * Triggered from task_tick_numa().
  */
+/* How long a task's hinting faults keep a VMA scanned on its behalf */
+#define VMA_PID_RESET_PERIOD	(4 * sysctl_numa_balancing_scan_delay)
+
+/*
+ * Whether @p should scan @vma.  VMAs are left to the tasks that took
+ * hinting faults in them during the last two PID windows; a VMA nobody
+ * faulted in recently is scanned by anyone, to notice new accesses.
+ */
+static bool vma_is_accessed(struct task_struct *p, struct vm_area_struct *vma)
+{
+	unsigned long pids;
+
+	pids = READ_ONCE(vma->numab_state.access_pids[0]) |
+	       READ_ONCE(vma->numab_state.access_pids[1]);
+
+	return !pids || test_bit(vma_numab_pid_bit(p), &pids);
+}
+
+/*
+ * A scan of @vma completed.  If the hinting faults of the previous scan
+ * migrated nothing, the VMA is stable: back off up to the maximum scan
+ * period before marking it again.
+ */
+static void vma_numab_scan_done(struct vm_area_struct *vma, unsigned long now)
+{
+	struct vma_numab_state *ns = &vma->numab_state;
+	unsigned int delay = 0;
+
+	if (READ_ONCE(ns->migrated))
+		WRITE_ONCE(ns->migrated, false);
+	else
+		delay = clamp(ns->scan_delay * 2,
+			      sysctl_numa_balancing_scan_period_min,
+			      sysctl_numa_balancing_scan_period_max);
+
+	ns->scan_delay = delay;
+	ns->next_scan = now + msecs_to_jiffies(delay);
+}
+
 static void task_numa_work(struct callback_head *work)
 {
 	unsigned long migrate, next_scan, now = jiffies;
@@ -2812,11 +2924,41 @@ static void task_numa_work(struct callback_head *work)
 		if (!vma_is_accessible(vma))
 			continue;
 
+		/* Give a new VMA the same initial delay as a new mm */
+		if (!vma->numab_state.next_scan) {
+			vma->numab_state.next_scan = now +
+				msecs_to_jiffies(sysctl_numa_balancing_scan_delay);
+			vma->numab_state.next_pid_reset = now +
+				msecs_to_jiffies(VMA_PID_RESET_PERIOD);
+			p->numa_scan_vmas_skipped++;
+			continue;
+		}
+
+		if (time_after(now, vma->numab_state.next_pid_reset)) {
+			WRITE_ONCE(vma->numab_state.access_pids[1],
+				   vma->numab_state.access_pids[0]);
+			WRITE_ONCE(vma->numab_state.access_pids[0], 0);
+			vma->numab_state.next_pid_reset = now +
+				msecs_to_jiffies(VMA_PID_RESET_PERIOD);
+		}
+
+		/*
+		 * Resume a partially scanned VMA regardless, otherwise skip
+		 * stable VMAs and those used by other tasks only.
+		 */
+		if (start <= vma->vm_start &&
+		    (time_before(now, vma->numab_state.next_scan) ||
+		     !vma_is_accessed(p, vma))) {
+			p->numa_scan_vmas_skipped++;
+			continue;
+		}
+
 		do {
 			start = max(start, vma->vm_start);
 			end = ALIGN(start + (pages << PAGE_SHIFT), HPAGE_SIZE);
 			end = min(end, vma->vm_end);
 			nr_pte_updates = change_prot_numa(vma, start, end);
+			p->numa_scan_pte_updates += nr_pte_updates;
 
 			/*
 			 * Try to scan sysctl_numa_balancing_size worth of
@@ -2831,6 +2973,8 @@ static void task_numa_work(struct callback_head *work)
 			virtpages -= (end - start) >> PAGE_SHIFT;
 
 			start = end;
+			if (end == vma->vm_end)
+				vma_numab_scan_done(vma, now);
 			if (pages <= 0 || virtpages <= 0)
 				goto out;
 
@@ -2884,6 +3028,8 @@ void init_numa_balancing(unsigned long clone_flags, struct task_struct *p)
 	RCU_INIT_POINTER(p->numa_group, NULL);
 	p->last_task_numa_placement	= 0;
 	p->last_sum_exec_runtime	= 0;
+	p->numa_scan_pte_updates	= 0;
+	p->numa_scan_vmas_skipped	= 0;
 
 	init_task_work(&p->numa_work, task_numa_work);
 
@@ -4681,12 +4827,28 @@ static inline u64 sched_cfs_bandwidth_slice(void)
  * directly instead of rq->clock to avoid adding additional synchronization
  * around rq->lock.
  *
+ * Runtime left over from the previous period is carried forward, up to
+ * cfs_b->burst on top of the quota.  Any runtime consumed beyond the quota
+ * since the last refill is accounted as a burst.
+ *
  * requires cfs_b->lock
  */
 void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b)
 {
-	if (cfs_b->quota != RUNTIME_INF)
-		cfs_b->runtime = cfs_b->quota;
+	s64 runtime;
+
+	if (unlikely(cfs_b->quota == RUNTIME_INF))
+		return;
+
+	cfs_b->runtime += cfs_b->quota;
+	runtime = cfs_b->runtime_snap - cfs_b->runtime;
+	if (runtime > 0) {
+		cfs_b->burst_time += runtime;
+		cfs_b->nr_burst++;
+	}
+
+	cfs_b->runtime = min(cfs_b->runtime, cfs_b->quota + cfs_b->burst);
+	cfs_b->runtime_snap = cfs_b->runtime;
 }
 
 static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
@@ -4904,12 +5066,19 @@ static bool throttle_cfs_rq(struct cfs_rq *cfs_rq)
 	return true;
 }
 
+static inline int cfs_throttled_hist_bucket(u64 delta)
+{
+	return min_t(int, fls64(delta >> CFS_THROTTLED_HIST_SHIFT),
+		     CFS_THROTTLED_HIST_BUCKETS - 1);
+}
+
 void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 {
 	struct rq *rq = rq_of(cfs_rq);
 	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
 	struct sched_entity *se;
 	long task_delta, idle_task_delta;
+	u64 delta;
 
 	se = cfs_rq->tg->se[cpu_of(rq)];
 
@@ -4917,8 +5086,10 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 
 	update_rq_clock(rq);
 
+	delta = rq_clock(rq) - cfs_rq->throttled_clock;
 	raw_spin_lock(&cfs_b->lock);
-	cfs_b->throttled_time += rq_clock(rq) - cfs_rq->throttled_clock;
+	cfs_b->throttled_time += delta;
+	cfs_b->throttled_hist[cfs_throttled_hist_bucket(delta)]++;
 	list_del_rcu(&cfs_rq->throttled_list);
 	raw_spin_unlock(&cfs_b->lock);
 
@@ -4989,22 +5160,111 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 		resched_curr(rq);
 }
 
-static void distribute_cfs_runtime(struct cfs_bandwidth *cfs_b)
+#ifdef CONFIG_SMP
+static void __cfsb_csd_unthrottle(void *arg)
 {
-	struct cfs_rq *cfs_rq;
+	struct cfs_rq *cursor, *tmp;
+	struct rq *rq = arg;
+	struct rq_flags rf;
+
+	rq_lock(rq, &rf);
+
+	/*
+	 * The rq lock serializes against other users of the CSD list, RCU
+	 * keeps a cfs_rq from being freed while we walk past it.
+	 */
+	rcu_read_lock();
+
+	list_for_each_entry_safe(cursor, tmp, &rq->cfsb_csd_list,
+				 throttled_csd_list) {
+		list_del_init(&cursor->throttled_csd_list);
+
+		if (cfs_rq_throttled(cursor))
+			unthrottle_cfs_rq(cursor);
+	}
+
+	rcu_read_unlock();
+
+	rq_unlock(rq, &rf);
+}
+
+static inline void __unthrottle_cfs_rq_async(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	bool first;
+
+	if (rq == this_rq()) {
+		unthrottle_cfs_rq(cfs_rq);
+		return;
+	}
+
+	/* Already enqueued */
+	if (SCHED_WARN_ON(!list_empty(&cfs_rq->throttled_csd_list)))
+		return;
+
+	first = list_empty(&rq->cfsb_csd_list);
+	list_add_tail(&cfs_rq->throttled_csd_list, &rq->cfsb_csd_list);
+	if (first)
+		smp_call_function_single_async(cpu_of(rq), &rq->cfsb_csd);
+}
+#else
+static inline void __unthrottle_cfs_rq_async(struct cfs_rq *cfs_rq)
+{
+	unthrottle_cfs_rq(cfs_rq);
+}
+#endif
+
+/*
+ * Unthrottle a cfs_rq that has been given runtime from a remote CPU.  Rather
+ * than doing the whole enqueue walk of every refilled cfs_rq under their rq
+ * locks one after another, the owning CPU is asked to do it.
+ */
+static void unthrottle_cfs_rq_async(struct cfs_rq *cfs_rq)
+{
+	lockdep_assert_held(&rq_of(cfs_rq)->lock);
+
+	if (SCHED_WARN_ON(!cfs_rq_throttled(cfs_rq) ||
+	    cfs_rq->runtime_remaining <= 0))
+		return;
+
+	__unthrottle_cfs_rq_async(cfs_rq);
+}
+
+/*
+ * Hand out cfs_b->runtime to the throttled cfs_rqs.  Returns true if some of
+ * them are still left throttled.
+ */
+static bool distribute_cfs_runtime(struct cfs_bandwidth *cfs_b)
+{
+	struct cfs_rq *local_unthrottle = NULL;
+	int this_cpu = smp_processor_id();
 	u64 runtime, remaining = 1;
+	bool throttled = false;
+	struct cfs_rq *cfs_rq;
+	struct rq_flags rf;
+	struct rq *rq;
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(cfs_rq, &cfs_b->throttled_cfs_rq,
 				throttled_list) {
-		struct rq *rq = rq_of(cfs_rq);
-		struct rq_flags rf;
+		rq = rq_of(cfs_rq);
+
+		if (!remaining) {
+			throttled = true;
+			break;
+		}
 
 		rq_lock_irqsave(rq, &rf);
 		if (!cfs_rq_throttled(cfs_rq))
 			goto next;
 
-		/* By the above check, this should never be true */
+#ifdef CONFIG_SMP
+		/* Already queued for async unthrottle */
+		if (!list_empty(&cfs_rq->throttled_csd_list))
+			goto next;
+#endif
+
+		/* By the above checks, this should never be true */
 		SCHED_WARN_ON(cfs_rq->runtime_remaining > 0);
 
 		raw_spin_lock(&cfs_b->lock);
@@ -5018,16 +5278,30 @@ static void distribute_cfs_runtime(struct cfs_bandwidth *cfs_b)
 		cfs_rq->runtime_remaining += runtime;
 
 		/* we check whether we're throttled above */
-		if (cfs_rq->runtime_remaining > 0)
-			unthrottle_cfs_rq(cfs_rq);
+		if (cfs_rq->runtime_remaining > 0) {
+			if (cpu_of(rq) != this_cpu ||
+			    SCHED_WARN_ON(local_unthrottle))
+				unthrottle_cfs_rq_async(cfs_rq);
+			else
+				local_unthrottle = cfs_rq;
+		} else {
+			throttled = true;
+		}
 
 next:
 		rq_unlock_irqrestore(rq, &rf);
-
-		if (!remaining)
-			break;
 	}
 	rcu_read_unlock();
+
+	if (local_unthrottle) {
+		rq = cpu_rq(this_cpu);
+		rq_lock_irqsave(rq, &rf);
+		if (cfs_rq_throttled(local_unthrottle))
+			unthrottle_cfs_rq(local_unthrottle);
+		rq_unlock_irqrestore(rq, &rf);
+	}
+
+	return throttled;
 }
 
 /*
@@ -5071,10 +5345,8 @@ static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun, u
 	while (throttled && cfs_b->runtime > 0) {
 		raw_spin_unlock_irqrestore(&cfs_b->lock, flags);
 		/* we can't nest cfs_b->lock while distributing bandwidth */
-		distribute_cfs_runtime(cfs_b);
+		throttled = distribute_cfs_runtime(cfs_b);
 		raw_spin_lock_irqsave(&cfs_b->lock, flags);
-
-		throttled = !list_empty(&cfs_b->throttled_cfs_rq);
 	}
 
 	/*
@@ -5349,6 +5621,9 @@ static void init_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 {
 	cfs_rq->runtime_enabled = 0;
 	INIT_LIST_HEAD(&cfs_rq->throttled_list);
+#ifdef CONFIG_SMP
+	INIT_LIST_HEAD(&cfs_rq->throttled_csd_list);
+#endif
 }
 
 void start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
@@ -5365,12 +5640,33 @@ void start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 
 static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 {
+	int __maybe_unused i;
+
 	/* init_cfs_bandwidth() was not called */
 	if (!cfs_b->throttled_cfs_rq.next)
 		return;
 
 	hrtimer_cancel(&cfs_b->period_timer);
 	hrtimer_cancel(&cfs_b->slack_timer);
+
+#ifdef CONFIG_SMP
+	/*
+	 * The period timer may have queued some of our cfs_rqs for an async
+	 * unthrottle that the remote CPU did not get to yet.  No new ones can
+	 * be queued now, so just flush the pending CSD work inline.
+	 */
+	for_each_possible_cpu(i) {
+		struct rq *rq = cpu_rq(i);
+		unsigned long flags;
+
+		if (list_empty(&rq->cfsb_csd_list))
+			continue;
+
+		local_irq_save(flags);
+		__cfsb_csd_unthrottle(rq);
+		local_irq_restore(flags);
+	}
+#endif
 }
 
 /*
@@ -5403,10 +5699,19 @@ static void __maybe_unused update_runtime_enabled(struct rq *rq)
 static void __maybe_unused unthrottle_offline_cfs_rqs(struct rq *rq)
 {
 	struct task_group *tg;
+#ifdef CONFIG_SMP
+	struct cfs_rq *cursor, *tmp;
+#endif
 
 	lockdep_assert_held(&rq->lock);
 
 	rcu_read_lock();
+#ifdef CONFIG_SMP
+	/* the CSD may never run here again, everything is unthrottled below */
+	list_for_each_entry_safe(cursor, tmp, &rq->cfsb_csd_list,
+				 throttled_csd_list)
+		list_del_init(&cursor->throttled_csd_list);
+#endif
 	list_for_each_entry_rcu(tg, &task_groups, list) {
 		struct cfs_rq *cfs_rq = tg->cfs_rq[cpu_of(rq)];
 
@@ -5571,6 +5876,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct cfs_rq *cfs_rq;
 	struct sched_entity *se = &p->se;
 	int idle_h_nr_running = task_has_idle_policy(p);
+	unsigned int cpufreq_flags = 0;
 	int task_new = !(flags & ENQUEUE_WAKEUP);
 
 	/*
@@ -5584,10 +5890,16 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	/*
 	 * If in_iowait is set, the code below may not trigger any cpufreq
 	 * utilization updates, so do it here explicitly with the IOWAIT flag
-	 * passed.
+	 * passed. A waking uclamp_min boosted task gets the same treatment,
+	 * so that the governor can raise the frequency without waiting for
+	 * its rate limit.
 	 */
 	if (p->in_iowait)
-		cpufreq_update_util(rq, SCHED_CPUFREQ_IOWAIT);
+		cpufreq_flags |= SCHED_CPUFREQ_IOWAIT;
+	if ((flags & ENQUEUE_WAKEUP) && uclamp_task_boosted(p))
+		cpufreq_flags |= SCHED_CPUFREQ_UCLAMP;
+	if (cpufreq_flags)
+		cpufreq_update_util(rq, cpufreq_flags);
 
 	for_each_sched_entity(se) {
 		if (se->on_rq)
@@ -6090,6 +6402,41 @@ static inline int __select_idle_cpu(int cpu)
 	return -1;
 }
 
+/*
+ * Maintain sd_llc_shared->idle_cpus_span for select_idle_cpu().  Called on
+ * idle entry and from the tick of busy CPUs, and only writes the shared
+ * cacheline when the state of @cpu actually changes, so that going idle
+ * and waking up frequently does not bounce it.  CPUs running only
+ * SCHED_IDLE tasks count as idle, like in __select_idle_cpu().
+ */
+void update_idle_cpumask(int cpu, bool idle)
+{
+	struct sched_domain_shared *sds;
+	struct cpumask *idle_cpus;
+
+	if (!sched_feat(SIS_FILTER))
+		return;
+
+	if (!idle)
+		idle = sched_idle_cpu(cpu);
+
+	rcu_read_lock();
+	sds = rcu_dereference(per_cpu(sd_llc_shared, cpu));
+	if (!sds)
+		goto unlock;
+
+	idle_cpus = sds_idle_cpus(sds);
+	if (cpumask_test_cpu(cpu, idle_cpus) == idle)
+		goto unlock;
+
+	if (idle)
+		cpumask_set_cpu(cpu, idle_cpus);
+	else
+		cpumask_clear_cpu(cpu, idle_cpus);
+unlock:
+	rcu_read_unlock();
+}
+
 #ifdef CONFIG_SCHED_SMT
 DEFINE_STATIC_KEY_FALSE(sched_smt_present);
 EXPORT_SYMBOL_GPL(sched_smt_present);
@@ -6231,13 +6578,18 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, bool
 	int i, cpu, idle_cpu = -1, nr = INT_MAX;
 	int this = smp_processor_id();
 	struct sched_domain *this_sd;
+	bool filter;
 	u64 time;
 
 	this_sd = rcu_dereference(*this_cpu_ptr(&sd_llc));
 	if (!this_sd)
 		return -1;
 
-	cpumask_and(cpus, sched_domain_span(sd), p->cpus_ptr);
+	filter = sched_feat(SIS_FILTER) && sd->shared;
+	if (filter)
+		cpumask_and(cpus, sds_idle_cpus(sd->shared), p->cpus_ptr);
+	else
+		cpumask_and(cpus, sched_domain_span(sd), p->cpus_ptr);
 
 	if (sched_feat(SIS_PROP) && !has_idle_core) {
 		u64 avg_cost, avg_idle, span_avg;
@@ -6255,9 +6607,45 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, bool
 		else
 			nr = 4;
 
+		/*
+		 * Latency sensitive tasks search up to twice as deep for an
+		 * idle CPU, tolerant ones give up sooner.
+		 */
+		if (p->latency_nice)
+			nr = max(2, nr * (MAX_LATENCY_NICE + 1 - p->latency_nice) /
+				    (MAX_LATENCY_NICE + 1));
+
 		time = cpu_clock(this);
 	}
 
+	/*
+	 * On machines with clusters, first look for an idle CPU in the
+	 * cluster of target: it shares the L2 (or a cache tag) with it.
+	 */
+	if (static_branch_unlikely(&sched_cluster_active)) {
+		struct sched_domain *sd_cls = sd->child;
+
+		if (sd_cls && (sd_cls->flags & SD_CLUSTER)) {
+			for_each_cpu_wrap(cpu, sched_domain_span(sd_cls), target + 1) {
+				if (!cpumask_test_cpu(cpu, cpus))
+					continue;
+
+				if (has_idle_core) {
+					i = select_idle_core(p, cpu, cpus, &idle_cpu);
+					if ((unsigned int)i < nr_cpumask_bits)
+						return i;
+				} else {
+					if (!--nr)
+						return -1;
+					idle_cpu = __select_idle_cpu(cpu);
+					if ((unsigned int)idle_cpu < nr_cpumask_bits)
+						goto out;
+				}
+			}
+			cpumask_andnot(cpus, cpus, sched_domain_span(sd_cls));
+		}
+	}
+
 	for_each_cpu_wrap(cpu, cpus, target) {
 		if (has_idle_core) {
 			i = select_idle_core(p, cpu, cpus, &idle_cpu);
@@ -6270,9 +6658,15 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, bool
 			idle_cpu = __select_idle_cpu(cpu);
 			if ((unsigned int)idle_cpu < nr_cpumask_bits)
 				break;
+			if (filter)
+				schedstat_inc(this_rq()->sis_filter_miss);
 		}
 	}
 
+out:
+	if (filter && (unsigned int)idle_cpu < nr_cpumask_bits && !has_idle_core)
+		schedstat_inc(this_rq()->sis_filter_hit);
+
 	if (has_idle_core)
 		set_idle_cores(target, false);
 
@@ -6334,7 +6728,7 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 	bool has_idle_core = false;
 	struct sched_domain *sd;
 	unsigned long task_util;
-	int i, recent_used_cpu;
+	int i, recent_used_cpu, prev_aff = -1;
 
 	/*
 	 * On asymmetric system, update task utilization because we will check
@@ -6354,8 +6748,14 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 	 */
 	if (prev != target && cpus_share_cache(prev, target) &&
 	    (available_idle_cpu(prev) || sched_idle_cpu(prev)) &&
-	    asym_fits_capacity(task_util, prev))
-		return prev;
+	    asym_fits_capacity(task_util, prev)) {
+
+		if (!static_branch_unlikely(&sched_cluster_active) ||
+		    cpus_share_resources(prev, target))
+			return prev;
+
+		prev_aff = prev;
+	}
 
 	/*
 	 * Allow a per-cpu kthread to stack with the wakee if the
@@ -6384,7 +6784,12 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 		 * candidate for the next wake:
 		 */
 		p->recent_used_cpu = prev;
-		return recent_used_cpu;
+
+		if (!static_branch_unlikely(&sched_cluster_active) ||
+		    cpus_share_resources(recent_used_cpu, target))
+			return recent_used_cpu;
+	} else {
+		recent_used_cpu = -1;
 	}
 
 	/*
@@ -6425,6 +6830,16 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 	if ((unsigned)i < nr_cpumask_bits)
 		return i;
 
+	/*
+	 * On machines with clusters an idle CPU in the cluster of target was
+	 * preferred above; prev or recent_used_cpu still share the LLC and
+	 * beat stacking on target.
+	 */
+	if ((unsigned int)prev_aff < nr_cpumask_bits)
+		return prev_aff;
+	if ((unsigned int)recent_used_cpu < nr_cpumask_bits)
+		return recent_used_cpu;
+
 	return target;
 }
 
@@ -6845,6 +7260,10 @@ select_task_rq_fair(struct task_struct *p, int prev_cpu, int wake_flags)
 	if (wake_flags & WF_TTWU) {
 		record_wakee(p);
 
+		if ((wake_flags & WF_CURRENT_CPU) &&
+		    cpumask_test_cpu(cpu, p->cpus_ptr))
+			return cpu;
+
 		if (sched_energy_enabled()) {
 			new_cpu = find_energy_efficient_cpu(p, prev_cpu);
 			if (new_cpu >= 0)
@@ -7004,11 +7423,25 @@ static unsigned long wakeup_gran(struct sched_entity *se)
  *  w(c, s3) =  1
  *
  */
+/*
+ * How much earlier than its vruntime says 'se' may preempt 'curr', given
+ * their latency nice.  Bounded by sysctl_sched_latency either way.
+ */
+static long wakeup_latency_gran(struct sched_entity *curr,
+				struct sched_entity *se)
+{
+	long latency_offset = curr->latency_offset - se->latency_offset;
+	long latency = sysctl_sched_latency;
+
+	return clamp(latency_offset, -latency, latency);
+}
+
 static int
 wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 {
 	s64 gran, vdiff = curr->vruntime - se->vruntime;
 
+	vdiff += wakeup_latency_gran(curr, se);
 	if (vdiff <= 0)
 		return -1;
 
@@ -11260,6 +11693,31 @@ int sched_group_set_shares(struct task_group *tg, unsigned long shares)
 		rq_unlock_irqrestore(rq, &rf);
 	}
 
+done:
+	mutex_unlock(&shares_mutex);
+	return 0;
+}
+
+int sched_group_set_latency(struct task_group *tg, int latency_nice)
+{
+	long latency_offset;
+	int i;
+
+	/*
+	 * We can't change the latency of the root cgroup.
+	 */
+	if (!tg->se[0])
+		return -EINVAL;
+
+	mutex_lock(&shares_mutex);
+	if (tg->latency_nice == latency_nice)
+		goto done;
+
+	tg->latency_nice = latency_nice;
+	latency_offset = latency_nice_to_offset(latency_nice);
+	for_each_possible_cpu(i)
+		WRITE_ONCE(tg->se[i]->latency_offset, latency_offset);
+
 done:
 	mutex_unlock(&shares_mutex);
 	return 0;
@@ -11389,6 +11847,18 @@ __init void init_sched_fair_class(void)
 	nohz.next_blocked = jiffies;
 	zalloc_cpumask_var(&nohz.idle_cpus_mask, GFP_NOWAIT);
 #endif
+
+#ifdef CONFIG_CFS_BANDWIDTH
+	{
+		int i;
+
+		for_each_possible_cpu(i) {
+			INIT_CSD(&cpu_rq(i)->cfsb_csd, __cfsb_csd_unthrottle,
+				 cpu_rq(i));
+			INIT_LIST_HEAD(&cpu_rq(i)->cfsb_csd_list);
+		}
+	}
+#endif
 #endif /* SMP */
 
 }
@@ -57,6 +57,12 @@ SCHED_FEAT(TTWU_QUEUE, true)
  */
 SCHED_FEAT(SIS_PROP, true)
 
+/*
+ * Only scan the CPUs of the LLC domain that went idle since their last
+ * busy tick.
+ */
+SCHED_FEAT(SIS_FILTER, true)
+
 /*
  * Issue a WARN when we do multiple update_rq_clock() calls
  * in a single rq->lock section. Default disabled because the
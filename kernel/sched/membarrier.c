@@ -306,11 +306,25 @@ static int membarrier_global_expedited(void)
 	return 0;
 }
 
+/*
+ * Private expedited commands targeting the whole mm are batched: a caller
+ * snapshots the round counter of its command and, once it holds
+ * mm->membarrier_mutex, is done if a round started and completed after the
+ * snapshot.  Such a round scanned the runqueues after the caller's entry
+ * barrier, which is all the caller would have done itself.
+ */
+static unsigned long membarrier_seq_snap(unsigned long *seq)
+{
+	return (READ_ONCE(*seq) + 3) & ~1UL;
+}
+
 static int membarrier_private_expedited(int flags, int cpu_id)
 {
 	cpumask_var_t tmpmask;
 	struct mm_struct *mm = current->mm;
 	smp_call_func_t ipi_func = ipi_mb;
+	unsigned long *seq = &mm->membarrier_seq[flags];
+	unsigned long snap = 0;
 
 	if (flags == MEMBARRIER_FLAG_SYNC_CORE) {
 		if (!IS_ENABLED(CONFIG_ARCH_HAS_MEMBARRIER_SYNC_CORE))
@@ -343,8 +357,25 @@ static int membarrier_private_expedited(int flags, int cpu_id)
 	 */
 	smp_mb();	/* system call entry is not a mb. */
 
-	if (cpu_id < 0 && !zalloc_cpumask_var(&tmpmask, GFP_KERNEL))
-		return -ENOMEM;
+	if (cpu_id < 0) {
+		snap = membarrier_seq_snap(seq);
+		mutex_lock(&mm->membarrier_mutex);
+		if (ULONG_CMP_GE(*seq, snap)) {
+			mutex_unlock(&mm->membarrier_mutex);
+			smp_mb();	/* exit from system call is not a mb */
+			return 0;
+		}
+		if (!zalloc_cpumask_var(&tmpmask, GFP_KERNEL)) {
+			mutex_unlock(&mm->membarrier_mutex);
+			return -ENOMEM;
+		}
+		WRITE_ONCE(*seq, *seq + 1);
+		/*
+		 * Order the start of the round before the runqueue scan, for
+		 * the callers which saw the counter before it.
+		 */
+		smp_mb();
+	}
 
 	cpus_read_lock();
 
@@ -408,9 +439,12 @@ static int membarrier_private_expedited(int flags, int cpu_id)
 	}
 
 out:
-	if (cpu_id < 0)
-		free_cpumask_var(tmpmask);
 	cpus_read_unlock();
+	if (cpu_id < 0) {
+		free_cpumask_var(tmpmask);
+		WRITE_ONCE(*seq, *seq + 1);
+		mutex_unlock(&mm->membarrier_mutex);
+	}
 
 	/*
 	 * Memory barrier on the caller thread _after_ we finished
@@ -167,8 +167,10 @@ __setup("psi=", setup_psi);
 #define EXP_300s	2034		/* 1/exp(2s/300s) */
 
 /* PSI trigger definitions */
-#define WINDOW_MIN_US 500000	/* Min window size is 500ms */
+#define WINDOW_MIN_US 100000	/* Min window size is 100ms */
 #define WINDOW_MAX_US 10000000	/* Max window size is 10s */
+/* Windows below this need CAP_SYS_RESOURCE, they poll 5 times as often */
+#define WINDOW_MIN_UNPRIV_US 500000
 #define UPDATES_PER_WINDOW 10	/* 10 updates per window */
 
 /* Sampling frequency in nanoseconds */
@@ -181,6 +183,15 @@ struct psi_group psi_system = {
 };
 
 static void psi_avgs_work(struct work_struct *work);
+static void psi_poll_work(struct kthread_work *work);
+static void poll_timer_fn(struct timer_list *t);
+
+/*
+ * All groups with triggers share one SCHED_FIFO "psimon" worker, so the
+ * cost of monitoring does not grow with a kthread per group.
+ */
+static struct kthread_worker *psi_poll_worker;
+static DEFINE_MUTEX(psi_poll_worker_lock);
 
 static void group_init(struct psi_group *group)
 {
@@ -201,7 +212,9 @@ static void group_init(struct psi_group *group)
 	memset(group->polling_total, 0, sizeof(group->polling_total));
 	group->polling_next_update = ULLONG_MAX;
 	group->polling_until = 0;
-	rcu_assign_pointer(group->poll_task, NULL);
+	group->poll_enabled = false;
+	timer_setup(&group->poll_timer, poll_timer_fn, 0);
+	kthread_init_work(&group->poll_work, psi_poll_work);
 }
 
 void __init psi_init(void)
@@ -496,12 +509,12 @@ static void init_triggers(struct psi_group *group, u64 now)
 {
 	struct psi_trigger *t;
 
-	list_for_each_entry(t, &group->triggers, node)
+	list_for_each_entry_rcu(t, &group->triggers, node)
 		window_reset(&t->win, now,
 				group->total[PSI_POLL][t->state], 0);
 	memcpy(group->polling_total, group->total[PSI_POLL],
 		   sizeof(group->polling_total));
-	group->polling_next_update = now + group->poll_min_period;
+	group->polling_next_update = now + READ_ONCE(group->poll_min_period);
 }
 
 static u64 update_triggers(struct psi_group *group, u64 now)
@@ -514,7 +527,7 @@ static u64 update_triggers(struct psi_group *group, u64 now)
 	 * On subsequent updates, calculate growth deltas and let
 	 * watchers know when their specified thresholds are exceeded.
 	 */
-	list_for_each_entry(t, &group->triggers, node) {
+	list_for_each_entry_rcu(t, &group->triggers, node) {
 		u64 growth;
 
 		/* Check for stall activity */
@@ -531,6 +544,7 @@ static u64 update_triggers(struct psi_group *group, u64 now)
 
 		/* Calculate growth since last update */
 		growth = window_update(&t->win, now, total[t->state]);
+		t->nr_updates++;
 		if (growth < t->threshold)
 			continue;
 
@@ -542,20 +556,19 @@ static u64 update_triggers(struct psi_group *group, u64 now)
 		if (cmpxchg(&t->event, 0, 1) == 0)
 			wake_up_interruptible(&t->event_wait);
 		t->last_event_time = now;
+		t->nr_events++;
 	}
 
 	if (new_stall)
 		memcpy(group->polling_total, total,
 				sizeof(group->polling_total));
 
-	return now + group->poll_min_period;
+	return now + READ_ONCE(group->poll_min_period);
 }
 
 /* Schedule polling if it's not already scheduled. */
 static void psi_schedule_poll_work(struct psi_group *group, unsigned long delay)
 {
-	struct task_struct *task;
-
 	/*
 	 * Do not reschedule if already scheduled.
 	 * Possible race with a timer scheduled after this check but before
@@ -567,29 +580,37 @@ static void psi_schedule_poll_work(struct psi_group *group, unsigned long delay)
 
 	rcu_read_lock();
 
-	task = rcu_dereference(group->poll_task);
 	/*
-	 * kworker might be NULL in case psi_trigger_destroy races with
-	 * psi_task_change (hotpath) which can't use locks
+	 * Polling might have been disabled in case psi_trigger_destroy
+	 * races with psi_task_change (hotpath) which can't use locks.
+	 * The RCU read section lets the destroy side wait for us before
+	 * it stops the timer.
 	 */
-	if (likely(task))
+	if (likely(READ_ONCE(group->poll_enabled)))
 		mod_timer(&group->poll_timer, jiffies + delay);
 
 	rcu_read_unlock();
 }
 
-static void psi_poll_work(struct psi_group *group)
+/*
+ * Runs on the psimon worker, which never runs two works at once, so the
+ * polling state of a group needs no lock.  Triggers are walked under RCU
+ * and may come and go concurrently.
+ */
+static void psi_poll_work(struct kthread_work *work)
 {
+	struct psi_group *group = container_of(work, struct psi_group,
+					       poll_work);
 	u32 changed_states;
 	u64 now;
 
-	mutex_lock(&group->trigger_lock);
+	rcu_read_lock();
 
 	now = sched_clock();
 
 	collect_percpu_times(group, PSI_POLL, &changed_states);
 
-	if (changed_states & group->poll_states) {
+	if (changed_states & READ_ONCE(group->poll_states)) {
 		/* Initialize trigger windows when entering polling mode */
 		if (now > group->polling_until)
 			init_triggers(group, now);
@@ -600,7 +621,7 @@ static void psi_poll_work(struct psi_group *group)
 		 * changing.
 		 */
 		group->polling_until = now +
-			group->poll_min_period * UPDATES_PER_WINDOW;
+			READ_ONCE(group->poll_min_period) * UPDATES_PER_WINDOW;
 	}
 
 	if (now > group->polling_until) {
@@ -615,33 +636,35 @@ static void psi_poll_work(struct psi_group *group)
 		nsecs_to_jiffies(group->polling_next_update - now) + 1);
 
 out:
-	mutex_unlock(&group->trigger_lock);
+	rcu_read_unlock();
 }
 
-static int psi_poll_worker(void *data)
+static void poll_timer_fn(struct timer_list *t)
 {
-	struct psi_group *group = (struct psi_group *)data;
-
-	sched_set_fifo_low(current);
-
-	while (true) {
-		wait_event_interruptible(group->poll_wait,
-				atomic_cmpxchg(&group->poll_wakeup, 1, 0) ||
-				kthread_should_stop());
-		if (kthread_should_stop())
-			break;
+	struct psi_group *group = from_timer(group, t, poll_timer);
 
-		psi_poll_work(group);
-	}
-	return 0;
+	kthread_queue_work(psi_poll_worker, &group->poll_work);
 }
 
-static void poll_timer_fn(struct timer_list *t)
+/* The worker is created with the first trigger and then kept around */
+static int psi_poll_worker_get(void)
 {
-	struct psi_group *group = from_timer(group, t, poll_timer);
+	struct kthread_worker *worker;
+	int ret = 0;
+
+	mutex_lock(&psi_poll_worker_lock);
+	if (!psi_poll_worker) {
+		worker = kthread_create_worker(0, "psimon");
+		if (IS_ERR(worker)) {
+			ret = PTR_ERR(worker);
+		} else {
+			sched_set_fifo_low(worker->task);
+			psi_poll_worker = worker;
+		}
+	}
+	mutex_unlock(&psi_poll_worker_lock);
 
-	atomic_set(&group->poll_wakeup, 1);
-	wake_up_interruptible(&group->poll_wait);
+	return ret;
 }
 
 static void record_times(struct psi_group_cpu *groupc, u64 now)
@@ -1063,19 +1086,55 @@ int psi_show(struct seq_file *m, struct psi_group *group, enum psi_res res)
 	return 0;
 }
 
+/*
+ * Report the trigger installed through this file, if any, as
+ * "trigger <some|full> <threshold_us> <window_us> events=N updates=N"
+ */
+void psi_trigger_show(struct seq_file *m, void **trigger_ptr)
+{
+	struct psi_trigger *t;
+
+	if (static_branch_likely(&psi_disabled))
+		return;
+
+	rcu_read_lock();
+
+	t = rcu_dereference(*(void __rcu __force **)trigger_ptr);
+	if (t)
+		seq_printf(m, "trigger %s %llu %llu events=%llu updates=%llu\n",
+			   t->state & 1 ? "full" : "some",
+			   div_u64(t->threshold, NSEC_PER_USEC),
+			   div_u64(t->win.size, NSEC_PER_USEC),
+			   READ_ONCE(t->nr_events), READ_ONCE(t->nr_updates));
+
+	rcu_read_unlock();
+}
+
 static int psi_io_show(struct seq_file *m, void *v)
 {
-	return psi_show(m, &psi_system, PSI_IO);
+	int ret = psi_show(m, &psi_system, PSI_IO);
+
+	if (!ret)
+		psi_trigger_show(m, &m->private);
+	return ret;
 }
 
 static int psi_memory_show(struct seq_file *m, void *v)
 {
-	return psi_show(m, &psi_system, PSI_MEM);
+	int ret = psi_show(m, &psi_system, PSI_MEM);
+
+	if (!ret)
+		psi_trigger_show(m, &m->private);
+	return ret;
 }
 
 static int psi_cpu_show(struct seq_file *m, void *v)
 {
-	return psi_show(m, &psi_system, PSI_CPU);
+	int ret = psi_show(m, &psi_system, PSI_CPU);
+
+	if (!ret)
+		psi_trigger_show(m, &m->private);
+	return ret;
 }
 
 static int psi_open(struct file *file, int (*psi_show)(struct seq_file *, void *))
@@ -1108,6 +1167,7 @@ struct psi_trigger *psi_trigger_create(struct psi_group *group,
 	enum psi_states state;
 	u32 threshold_us;
 	u32 window_us;
+	int ret;
 
 	if (static_branch_likely(&psi_disabled))
 		return ERR_PTR(-EOPNOTSUPP);
@@ -1126,6 +1186,9 @@ struct psi_trigger *psi_trigger_create(struct psi_group *group,
 		window_us > WINDOW_MAX_US)
 		return ERR_PTR(-EINVAL);
 
+	if (window_us < WINDOW_MIN_UNPRIV_US && !capable(CAP_SYS_RESOURCE))
+		return ERR_PTR(-EPERM);
+
 	/* Check threshold */
 	if (threshold_us == 0 || threshold_us > window_us)
 		return ERR_PTR(-EINVAL);
@@ -1142,32 +1205,25 @@ struct psi_trigger *psi_trigger_create(struct psi_group *group,
 
 	t->event = 0;
 	t->last_event_time = 0;
+	t->nr_events = 0;
+	t->nr_updates = 0;
 	init_waitqueue_head(&t->event_wait);
 	kref_init(&t->refcount);
 
-	mutex_lock(&group->trigger_lock);
-
-	if (!rcu_access_pointer(group->poll_task)) {
-		struct task_struct *task;
-
-		task = kthread_create(psi_poll_worker, group, "psimon");
-		if (IS_ERR(task)) {
-			kfree(t);
-			mutex_unlock(&group->trigger_lock);
-			return ERR_CAST(task);
-		}
-		atomic_set(&group->poll_wakeup, 0);
-		init_waitqueue_head(&group->poll_wait);
-		wake_up_process(task);
-		timer_setup(&group->poll_timer, poll_timer_fn, 0);
-		rcu_assign_pointer(group->poll_task, task);
+	ret = psi_poll_worker_get();
+	if (ret) {
+		kfree(t);
+		return ERR_PTR(ret);
 	}
 
-	list_add(&t->node, &group->triggers);
-	group->poll_min_period = min(group->poll_min_period,
-		div_u64(t->win.size, UPDATES_PER_WINDOW));
+	mutex_lock(&group->trigger_lock);
+
+	list_add_rcu(&t->node, &group->triggers);
+	WRITE_ONCE(group->poll_min_period, min(group->poll_min_period,
+		div_u64(t->win.size, UPDATES_PER_WINDOW)));
 	group->nr_triggers[t->state]++;
-	group->poll_states |= (1 << t->state);
+	WRITE_ONCE(group->poll_states, group->poll_states | (1 << t->state));
+	WRITE_ONCE(group->poll_enabled, true);
 
 	mutex_unlock(&group->trigger_lock);
 
@@ -1178,7 +1234,7 @@ static void psi_trigger_destroy(struct kref *ref)
 {
 	struct psi_trigger *t = container_of(ref, struct psi_trigger, refcount);
 	struct psi_group *group = t->group;
-	struct task_struct *task_to_destroy = NULL;
+	bool stop_polling = false;
 
 	if (static_branch_likely(&psi_disabled))
 		return;
@@ -1195,47 +1251,45 @@ static void psi_trigger_destroy(struct kref *ref)
 		struct psi_trigger *tmp;
 		u64 period = ULLONG_MAX;
 
-		list_del(&t->node);
+		list_del_rcu(&t->node);
 		group->nr_triggers[t->state]--;
 		if (!group->nr_triggers[t->state])
-			group->poll_states &= ~(1 << t->state);
+			WRITE_ONCE(group->poll_states,
+				   group->poll_states & ~(1 << t->state));
 		/* reset min update period for the remaining triggers */
 		list_for_each_entry(tmp, &group->triggers, node)
 			period = min(period, div_u64(tmp->win.size,
 					UPDATES_PER_WINDOW));
-		group->poll_min_period = period;
-		/* Destroy poll_task when the last trigger is destroyed */
+		WRITE_ONCE(group->poll_min_period, period);
+		/* Stop polling when the last trigger is destroyed */
 		if (group->poll_states == 0) {
-			group->polling_until = 0;
-			task_to_destroy = rcu_dereference_protected(
-					group->poll_task,
-					lockdep_is_held(&group->trigger_lock));
-			rcu_assign_pointer(group->poll_task, NULL);
+			WRITE_ONCE(group->poll_enabled, false);
+			stop_polling = true;
 		}
 	}
 
-	mutex_unlock(&group->trigger_lock);
-
 	/*
-	 * Wait for both *trigger_ptr from psi_trigger_replace and
-	 * poll_task RCUs to complete their read-side critical sections
-	 * before destroying the trigger and optionally the poll_task
+	 * Wait for *trigger_ptr from psi_trigger_replace, the trigger list
+	 * walk in psi_poll_work and psi_schedule_poll_work to complete their
+	 * read-side critical sections before destroying the trigger and
+	 * optionally stopping the poll work
 	 */
 	synchronize_rcu();
-	/*
-	 * Destroy the kworker after releasing trigger_lock to prevent a
-	 * deadlock while waiting for psi_poll_work to acquire trigger_lock
-	 */
-	if (task_to_destroy) {
+	if (stop_polling) {
 		/*
-		 * After the RCU grace period has expired, the worker
-		 * can no longer be found through group->poll_task.
-		 * But it might have been already scheduled before
-		 * that - deschedule it cleanly before destroying it.
+		 * After the RCU grace period has expired, neither the
+		 * hotpath nor the poll work can arm the timer anymore.
+		 * But it might have been already scheduled before that -
+		 * deschedule it and the work it queued cleanly.  A trigger
+		 * created meanwhile waits for trigger_lock.
 		 */
 		del_timer_sync(&group->poll_timer);
-		kthread_stop(task_to_destroy);
+		kthread_cancel_work_sync(&group->poll_work);
+		group->polling_until = 0;
 	}
+
+	mutex_unlock(&group->trigger_lock);
+
 	kfree(t);
 }
 
@@ -163,9 +163,24 @@ static inline int idle_policy(int policy)
 {
 	return policy == SCHED_IDLE;
 }
+
+static inline int ext_policy(int policy)
+{
+#ifdef CONFIG_SCHED_CLASS_EXT
+	return policy == SCHED_EXT;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * SCHED_EXT tasks are weighted like SCHED_NORMAL ones and are run by the
+ * fair class whenever no BPF scheduler is loaded.
+ */
 static inline int fair_policy(int policy)
 {
-	return policy == SCHED_NORMAL || policy == SCHED_BATCH;
+	return policy == SCHED_NORMAL || policy == SCHED_BATCH ||
+		ext_policy(policy);
 }
 
 static inline int rt_policy(int policy)
@@ -183,6 +198,16 @@ static inline bool valid_policy(int policy)
 		rt_policy(policy) || dl_policy(policy);
 }
 
+/*
+ * Latency nice -20 lets a waking entity preempt up to one
+ * sysctl_sched_latency earlier than its vruntime alone would allow, and
+ * +19 delays it by about as much.
+ */
+static inline long latency_nice_to_offset(int latency_nice)
+{
+	return (long)sysctl_sched_latency * latency_nice / -MIN_LATENCY_NICE;
+}
+
 static inline int task_has_idle_policy(struct task_struct *p)
 {
 	return idle_policy(p->policy);
@@ -360,12 +385,22 @@ struct rt_rq;
 
 extern struct list_head task_groups;
 
+/*
+ * Throttle durations are bucketed by log2 of their length, the first bucket
+ * covers everything below 1 << CFS_THROTTLED_HIST_SHIFT ns (~65us) and the
+ * last one everything above ~1s.
+ */
+#define CFS_THROTTLED_HIST_SHIFT	16
+#define CFS_THROTTLED_HIST_BUCKETS	16
+
 struct cfs_bandwidth {
 #ifdef CONFIG_CFS_BANDWIDTH
 	raw_spinlock_t		lock;
 	ktime_t			period;
 	u64			quota;
 	u64			runtime;
+	u64			burst;
+	u64			runtime_snap;
 	s64			hierarchical_quota;
 
 	u8			idle;
@@ -378,7 +413,10 @@ struct cfs_bandwidth {
 	/* Statistics: */
 	int			nr_periods;
 	int			nr_throttled;
+	int			nr_burst;
 	u64			throttled_time;
+	u64			burst_time;
+	u64			throttled_hist[CFS_THROTTLED_HIST_BUCKETS];
 #endif
 };
 
@@ -392,6 +430,7 @@ struct task_group {
 	/* runqueue "owned" by this group on each CPU */
 	struct cfs_rq		**cfs_rq;
 	unsigned long		shares;
+	int			latency_nice;
 
 #ifdef	CONFIG_SMP
 	/*
@@ -432,6 +471,14 @@ struct task_group {
 	struct uclamp_se	uclamp[UCLAMP_CNT];
 #endif
 
+#ifdef CONFIG_SCHED_INFO
+	/* runqueue waits of the group's tasks, see sched_lat_hist_bucket() */
+	struct sched_lat_hist __percpu *lat_hist;
+#endif
+};
+
+struct sched_lat_hist {
+	u64			buckets[SCHED_LAT_HIST_BUCKETS];
 };
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -501,6 +548,7 @@ extern void sched_move_task(struct task_struct *tsk);
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
+extern int sched_group_set_latency(struct task_group *tg, int latency_nice);
 
 #ifdef CONFIG_SMP
 extern void set_task_rq_fair(struct sched_entity *se,
@@ -603,6 +651,9 @@ struct cfs_rq {
 	int			throttled;
 	int			throttle_count;
 	struct list_head	throttled_list;
+#ifdef CONFIG_SMP
+	struct list_head	throttled_csd_list;
+#endif
 #endif /* CONFIG_CFS_BANDWIDTH */
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 };
@@ -715,6 +766,26 @@ struct dl_rq {
 	u64			bw_ratio;
 };
 
+#ifdef CONFIG_SCHED_CLASS_EXT
+/* A FIFO of tasks of the extensible class */
+struct scx_dispatch_q {
+	raw_spinlock_t		lock;	/* only taken for the global DSQ */
+	struct list_head	fifo;
+	u32			nr;
+	u64			id;
+};
+
+/* Extensible class' related fields in a runqueue */
+struct scx_rq {
+	/* tasks this CPU runs next, protected by the rq lock */
+	struct scx_dispatch_q	local_dsq;
+#ifdef CONFIG_SMP
+	/* gets an idle CPU to look at the global DSQ */
+	struct irq_work		kick_work;
+#endif
+};
+#endif /* CONFIG_SCHED_CLASS_EXT */
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 /* An entity is a task if it doesn't "own" a runqueue */
 #define entity_is_task(se)	(!se->my_q)
@@ -942,6 +1013,9 @@ struct rq {
 	struct cfs_rq		cfs;
 	struct rt_rq		rt;
 	struct dl_rq		dl;
+#ifdef CONFIG_SCHED_CLASS_EXT
+	struct scx_rq		scx;
+#endif
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* list of leaf cfs_rq on this CPU: */
@@ -1063,6 +1137,10 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int		ttwu_count;
 	unsigned int		ttwu_local;
+
+	/* select_idle_cpu() stats of the LLC idle mask */
+	unsigned int		sis_filter_hit;
+	unsigned int		sis_filter_miss;
 #endif
 
 #ifdef CONFIG_CPU_IDLE
@@ -1075,6 +1153,12 @@ struct rq {
 #endif
 	unsigned int		push_busy;
 	struct cpu_stop_work	push_work;
+
+#if defined(CONFIG_CFS_BANDWIDTH) && defined(CONFIG_SMP)
+	/* throttled cfs_rqs refilled remotely, unthrottled by cfsb_csd */
+	call_single_data_t	cfsb_csd;
+	struct list_head	cfsb_csd_list;
+#endif
 };
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -1113,6 +1197,12 @@ static inline bool is_migration_disabled(struct task_struct *p)
 #endif
 }
 
+#ifdef CONFIG_SMP
+extern void update_idle_cpumask(int cpu, bool idle);
+#else
+static inline void update_idle_cpumask(int cpu, bool idle) { }
+#endif
+
 #ifdef CONFIG_SCHED_SMT
 extern void __update_idle_core(struct rq *rq);
 
@@ -1491,11 +1581,13 @@ static inline struct sched_domain *lowest_flag_domain(int cpu, int flag)
 DECLARE_PER_CPU(struct sched_domain __rcu *, sd_llc);
 DECLARE_PER_CPU(int, sd_llc_size);
 DECLARE_PER_CPU(int, sd_llc_id);
+DECLARE_PER_CPU(int, sd_share_id);
 DECLARE_PER_CPU(struct sched_domain_shared __rcu *, sd_llc_shared);
 DECLARE_PER_CPU(struct sched_domain __rcu *, sd_numa);
 DECLARE_PER_CPU(struct sched_domain __rcu *, sd_asym_packing);
 DECLARE_PER_CPU(struct sched_domain __rcu *, sd_asym_cpucapacity);
 extern struct static_key_false sched_asym_cpucapacity;
+extern struct static_key_false sched_cluster_active;
 
 struct sched_group_capacity {
 	atomic_t		ref;
@@ -1762,6 +1854,7 @@ static inline int task_on_rq_migrating(struct task_struct *p)
 #define WF_SYNC     0x10 /* Waker goes to sleep after wakeup */
 #define WF_MIGRATED 0x20 /* Internal use, task got migrated */
 #define WF_ON_CPU   0x40 /* Wakee is on_cpu */
+#define WF_CURRENT_CPU 0x80 /* Prefer to move the wakee to the current CPU */
 
 #ifdef CONFIG_SMP
 static_assert(WF_EXEC == SD_BALANCE_EXEC);
@@ -1928,8 +2021,39 @@ extern const struct sched_class stop_sched_class;
 extern const struct sched_class dl_sched_class;
 extern const struct sched_class rt_sched_class;
 extern const struct sched_class fair_sched_class;
+extern const struct sched_class ext_sched_class;
 extern const struct sched_class idle_sched_class;
 
+#ifdef CONFIG_SCHED_CLASS_EXT
+DECLARE_STATIC_KEY_FALSE(__scx_ops_enabled);
+#define scx_enabled()		static_branch_unlikely(&__scx_ops_enabled)
+
+extern void init_scx_rq(struct scx_rq *scx_rq);
+extern void sched_set_normal_class(struct task_struct *p);
+
+static inline bool task_should_scx(struct task_struct *p)
+{
+	return scx_enabled() && p->policy == SCHED_EXT;
+}
+#else
+#define scx_enabled()		false
+
+static inline bool task_should_scx(struct task_struct *p)
+{
+	return false;
+}
+#endif
+
+/* Class of a task that is neither RT nor DL, a sibling of normal_prio() */
+static inline const struct sched_class *normal_sched_class(struct task_struct *p)
+{
+#ifdef CONFIG_SCHED_CLASS_EXT
+	if (task_should_scx(p))
+		return &ext_sched_class;
+#endif
+	return &fair_sched_class;
+}
+
 static inline bool sched_stop_runnable(struct rq *rq)
 {
 	return rq->stop && task_on_rq_queued(rq->stop);
@@ -2576,6 +2700,15 @@ static inline bool uclamp_is_used(void)
 {
 	return static_branch_likely(&sched_uclamp_used);
 }
+
+/*
+ * Returns true if @p asks for a minimum utilization, so that its wakeup
+ * should be reflected in the CPU frequency right away.
+ */
+static inline bool uclamp_task_boosted(struct task_struct *p)
+{
+	return uclamp_is_used() && uclamp_eff_value(p, UCLAMP_MIN) > 0;
+}
 #else /* CONFIG_UCLAMP_TASK */
 static inline
 unsigned long uclamp_rq_util_with(struct rq *rq, unsigned long util,
@@ -2588,6 +2721,11 @@ static inline bool uclamp_is_used(void)
 {
 	return false;
 }
+
+static inline bool uclamp_task_boosted(struct task_struct *p)
+{
+	return false;
+}
 #endif /* CONFIG_UCLAMP_TASK */
 
 #ifdef arch_scale_freq_capacity
@@ -2740,6 +2878,66 @@ static inline bool is_per_cpu_kthread(struct task_struct *p)
 }
 #endif
 
+#ifdef CONFIG_SCHED_MM_CID
+static inline int __mm_cid_get(struct mm_struct *mm)
+{
+	struct cpumask *cpumask;
+	int cid;
+
+	cpumask = mm_cidmask(mm);
+	cid = cpumask_first_zero(cpumask);
+	if (cid >= nr_cpu_ids)
+		return -1;
+	__cpumask_set_cpu(cid, cpumask);
+	return cid;
+}
+
+static inline void mm_cid_put(struct mm_struct *mm, int cid)
+{
+	lockdep_assert_irqs_disabled();
+	if (cid < 0)
+		return;
+	raw_spin_lock(&mm->cid_lock);
+	__cpumask_clear_cpu(cid, mm_cidmask(mm));
+	raw_spin_unlock(&mm->cid_lock);
+}
+
+static inline int mm_cid_get(struct mm_struct *mm)
+{
+	int ret;
+
+	lockdep_assert_irqs_disabled();
+	raw_spin_lock(&mm->cid_lock);
+	ret = __mm_cid_get(mm);
+	raw_spin_unlock(&mm->cid_lock);
+	return ret;
+}
+
+static inline void switch_mm_cid(struct task_struct *prev,
+				 struct task_struct *next)
+{
+	if (prev->mm_cid_active) {
+		if (next->mm_cid_active && next->mm == prev->mm) {
+			/*
+			 * Context switch between threads in same mm, hand over
+			 * the mm_cid from prev to next.
+			 */
+			next->mm_cid = prev->mm_cid;
+			prev->mm_cid = -1;
+			return;
+		}
+		mm_cid_put(prev->mm, prev->mm_cid);
+		prev->mm_cid = -1;
+	}
+	if (next->mm_cid_active)
+		next->mm_cid = mm_cid_get(next->mm);
+}
+
+#else
+static inline void switch_mm_cid(struct task_struct *prev,
+				 struct task_struct *next) { }
+#endif
+
 extern void swake_up_all_locked(struct swait_queue_head *q);
 extern void __prepare_to_swait(struct swait_queue_head *q, struct swait_queue *wait);
 
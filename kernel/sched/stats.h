@@ -180,17 +180,46 @@ static inline void sched_info_dequeued(struct rq *rq, struct task_struct *t)
  * long it was waiting to run.  We also note when it began so that we
  * can keep stats on how long its timeslice is.
  */
+static inline unsigned int sched_lat_hist_bucket(unsigned long long delta)
+{
+	return min_t(unsigned int, fls64(delta >> SCHED_LAT_HIST_SHIFT),
+		     SCHED_LAT_HIST_BUCKETS - 1);
+}
+
+/* Lower bound of a bucket, in nanoseconds */
+static inline u64 sched_lat_hist_bucket_start(unsigned int bucket)
+{
+	return bucket ? 1ULL << (SCHED_LAT_HIST_SHIFT + bucket - 1) : 0;
+}
+
+static inline void
+sched_lat_hist_account(struct rq *rq, struct task_struct *t,
+		       unsigned long long delta)
+{
+	unsigned int bucket = sched_lat_hist_bucket(delta);
+
+	t->sched_info.lat_hist[bucket]++;
+#ifdef CONFIG_CGROUP_SCHED
+	/* the cgroup's group, not the autogroup task_group() may return */
+	per_cpu_ptr(t->sched_task_group->lat_hist, cpu_of(rq))->buckets[bucket]++;
+#endif
+}
+
 static void sched_info_arrive(struct rq *rq, struct task_struct *t)
 {
 	unsigned long long now = rq_clock(rq), delta = 0;
+	bool waited = t->sched_info.last_queued;
 
-	if (t->sched_info.last_queued)
+	if (waited)
 		delta = now - t->sched_info.last_queued;
 	sched_info_reset_dequeued(t);
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
 	t->sched_info.pcount++;
 
+	if (waited)
+		sched_lat_hist_account(rq, t, delta);
+
 	rq_sched_info_arrive(rq, delta);
 }
 
@@ -2882,6 +2882,7 @@ void exit_signals(struct task_struct *tsk)
 	 * expect stable threadgroup.
 	 */
 	cgroup_threadgroup_change_begin(tsk);
+	sched_mm_cid_exit_signals(tsk);
 
 	if (thread_group_empty(tsk) || signal_group_exit(tsk->signal)) {
 		tsk->flags |= PF_EXITING;
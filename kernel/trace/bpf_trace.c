@@ -17,6 +17,9 @@
 #include <linux/error-injection.h>
 #include <linux/btf_ids.h>
 #include <linux/bpf_lsm.h>
+#include <linux/fprobe.h>
+#include <linux/bsearch.h>
+#include <linux/sort.h>
 
 #include <net/bpf_sk_storage.h>
 
@@ -1967,3 +1970,248 @@ static int __init bpf_event_init(void)
 
 fs_initcall(bpf_event_init);
 #endif /* CONFIG_MODULES */
+
+#ifdef CONFIG_FPROBE
+struct bpf_kprobe_multi_link {
+	struct bpf_link link;
+	struct fprobe fp;
+	unsigned long *addrs;
+	u32 cnt;
+};
+
+static void bpf_kprobe_multi_link_release(struct bpf_link *link)
+{
+	struct bpf_kprobe_multi_link *kmulti_link;
+
+	kmulti_link = container_of(link, struct bpf_kprobe_multi_link, link);
+	unregister_fprobe(&kmulti_link->fp);
+}
+
+static void bpf_kprobe_multi_link_dealloc(struct bpf_link *link)
+{
+	struct bpf_kprobe_multi_link *kmulti_link;
+
+	kmulti_link = container_of(link, struct bpf_kprobe_multi_link, link);
+	kvfree(kmulti_link->addrs);
+	kfree(kmulti_link);
+}
+
+static const struct bpf_link_ops bpf_kprobe_multi_link_lops = {
+	.release = bpf_kprobe_multi_link_release,
+	.dealloc = bpf_kprobe_multi_link_dealloc,
+};
+
+static void kprobe_multi_link_handler(struct fprobe *fp, unsigned long entry_ip,
+				      struct pt_regs *regs)
+{
+	struct bpf_kprobe_multi_link *link;
+
+	link = container_of(fp, struct bpf_kprobe_multi_link, fp);
+
+	migrate_disable();
+	if (unlikely(__this_cpu_inc_return(bpf_prog_active) != 1))
+		/* same as trace_call_bpf(), don't nest bpf programs */
+		goto out;
+
+	rcu_read_lock();
+	BPF_PROG_RUN(link->link.prog, regs);
+	rcu_read_unlock();
+out:
+	__this_cpu_dec(bpf_prog_active);
+	migrate_enable();
+}
+
+static int kprobe_multi_cmp_sym(const void *a, const void *b)
+{
+	return strcmp(*(const char **)a, *(const char **)b);
+}
+
+static int kprobe_multi_cmp_addr(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+struct kprobe_multi_resolve {
+	const char **syms;	/* sorted */
+	unsigned long *addrs;	/* indexed like syms */
+	u32 cnt;
+	u32 found;
+};
+
+static int kprobe_multi_resolve_sym(void *data, const char *name,
+				    struct module *mod, unsigned long addr)
+{
+	struct kprobe_multi_resolve *res = data;
+	const char **sym;
+	u32 idx;
+
+	sym = bsearch(&name, res->syms, res->cnt, sizeof(*res->syms),
+		      kprobe_multi_cmp_sym);
+	if (!sym)
+		return 0;
+
+	/* the first symbol of a name ftrace can hook wins */
+	idx = sym - res->syms;
+	if (res->addrs[idx] || !ftrace_location(addr))
+		return 0;
+
+	res->addrs[idx] = addr;
+	return ++res->found == res->cnt;
+}
+
+/* Resolve the @cnt function names at @usyms in one walk over kallsyms
+ * instead of one kallsyms_lookup_name() per name.
+ */
+static int kprobe_multi_resolve_syms(const u64 __user *usyms, u32 cnt,
+				     unsigned long *addrs)
+{
+	struct kprobe_multi_resolve res = {
+		.addrs = addrs,
+		.cnt = cnt,
+	};
+	char *buf, *p;
+	u64 usym;
+	int err;
+	u32 i;
+
+	res.syms = kvmalloc_array(cnt, sizeof(*res.syms), GFP_KERNEL);
+	buf = kvmalloc_array(cnt, KSYM_NAME_LEN, GFP_KERNEL);
+	if (!res.syms || !buf) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (p = buf, i = 0; i < cnt; i++) {
+		if (get_user(usym, usyms + i)) {
+			err = -EFAULT;
+			goto out;
+		}
+		err = strncpy_from_user(p, u64_to_user_ptr(usym), KSYM_NAME_LEN);
+		if (err == KSYM_NAME_LEN)
+			err = -E2BIG;
+		if (err < 0)
+			goto out;
+		res.syms[i] = p;
+		p += err + 1;
+	}
+
+	sort(res.syms, cnt, sizeof(*res.syms), kprobe_multi_cmp_sym, NULL);
+	memset(addrs, 0, cnt * sizeof(*addrs));
+	kallsyms_on_each_symbol(kprobe_multi_resolve_sym, &res);
+
+	/* module functions are not covered by the walk */
+	err = 0;
+	for (i = 0; i < cnt && res.found < cnt; i++) {
+		if (addrs[i])
+			continue;
+		addrs[i] = kallsyms_lookup_name(res.syms[i]);
+		if (!addrs[i]) {
+			err = -ENOENT;
+			break;
+		}
+		res.found++;
+	}
+out:
+	kvfree(buf);
+	kvfree(res.syms);
+	return err;
+}
+
+#define MAX_KPROBE_MULTI_CNT (1U << 20)
+
+int bpf_kprobe_multi_link_attach(const union bpf_attr *attr, struct bpf_prog *prog)
+{
+	struct bpf_kprobe_multi_link *link = NULL;
+	struct bpf_link_primer link_primer;
+	void __user *uaddrs, *usyms;
+	unsigned long *addrs;
+	u32 flags, cnt, i, n;
+	int err;
+
+	/* no support for 32bit archs yet */
+	if (sizeof(u64) != sizeof(void *))
+		return -EOPNOTSUPP;
+
+	if (prog->expected_attach_type != BPF_TRACE_KPROBE_MULTI)
+		return -EINVAL;
+
+	/* bpf_override_return() needs the regs of a kprobe */
+	if (prog->kprobe_override)
+		return -EINVAL;
+
+	flags = attr->link_create.kprobe_multi.flags;
+	if (flags & ~BPF_F_KPROBE_MULTI_RETURN)
+		return -EINVAL;
+
+	uaddrs = u64_to_user_ptr(attr->link_create.kprobe_multi.addrs);
+	usyms = u64_to_user_ptr(attr->link_create.kprobe_multi.syms);
+	if (!!uaddrs == !!usyms)
+		return -EINVAL;
+
+	cnt = attr->link_create.kprobe_multi.cnt;
+	if (!cnt)
+		return -EINVAL;
+	if (cnt > MAX_KPROBE_MULTI_CNT)
+		return -E2BIG;
+
+	addrs = kvmalloc_array(cnt, sizeof(*addrs), GFP_KERNEL);
+	if (!addrs)
+		return -ENOMEM;
+
+	if (uaddrs) {
+		if (copy_from_user(addrs, uaddrs, cnt * sizeof(*addrs))) {
+			err = -EFAULT;
+			goto error;
+		}
+	} else {
+		err = kprobe_multi_resolve_syms(usyms, cnt, addrs);
+		if (err)
+			goto error;
+	}
+
+	/* a function given twice is probed once */
+	sort(addrs, cnt, sizeof(*addrs), kprobe_multi_cmp_addr, NULL);
+	for (i = 1, n = 1; i < cnt; i++)
+		if (addrs[i] != addrs[n - 1])
+			addrs[n++] = addrs[i];
+	cnt = n;
+
+	link = kzalloc(sizeof(*link), GFP_KERNEL);
+	if (!link) {
+		err = -ENOMEM;
+		goto error;
+	}
+
+	bpf_link_init(&link->link, BPF_LINK_TYPE_KPROBE_MULTI,
+		      &bpf_kprobe_multi_link_lops, prog);
+
+	err = bpf_link_prime(&link->link, &link_primer);
+	if (err)
+		goto error;
+
+	if (flags & BPF_F_KPROBE_MULTI_RETURN)
+		link->fp.exit_handler = kprobe_multi_link_handler;
+	else
+		link->fp.entry_handler = kprobe_multi_link_handler;
+
+	link->addrs = addrs;
+	link->cnt = cnt;
+
+	err = register_fprobe_ips(&link->fp, addrs, cnt);
+	if (err) {
+		/* frees link and addrs through ->dealloc() */
+		bpf_link_cleanup(&link_primer);
+		return err;
+	}
+
+	return bpf_link_settle(&link_primer);
+
+error:
+	kfree(link);
+	kvfree(addrs);
+	return err;
+}
+#endif /* CONFIG_FPROBE */
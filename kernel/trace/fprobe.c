@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * fprobe - Simple ftrace probe wrapper for function entry.
+ *
+ * One ftrace_ops with a filter hash catches the entries of all probed
+ * functions and one pool of kretprobe instances hooks their returns, so
+ * the cost of a probe does not grow with the number of functions.
+ */
+#define pr_fmt(fmt) "fprobe: " fmt
+
+#include <linux/fprobe.h>
+#include <linux/kprobes.h>
+#include <linux/slab.h>
+
+/* Default number of pending returns per CPU, see fprobe_init_rp() */
+#define FPROBE_DEFAULT_DEPTH	16
+
+static void fprobe_handler(unsigned long ip, unsigned long parent_ip,
+			   struct ftrace_ops *ops, struct ftrace_regs *fregs)
+{
+	struct kretprobe_instance *ri;
+	struct pt_regs *regs;
+	struct fprobe *fp;
+	int bit;
+
+	fp = container_of(ops, struct fprobe, ops);
+	if (fprobe_disabled(fp))
+		return;
+
+	bit = ftrace_test_recursion_trylock(ip, parent_ip);
+	if (bit < 0) {
+		fp->nmissed++;
+		return;
+	}
+
+	/* the handlers and the instance freelist expect a stable CPU */
+	preempt_disable_notrace();
+	regs = ftrace_get_regs(fregs);
+	if (fp->entry_handler)
+		fp->entry_handler(fp, ip, regs);
+
+	if (fp->exit_handler) {
+		ri = kretprobe_hook_return(&fp->rp, regs);
+		if (ri)
+			*(unsigned long *)ri->data = ip;
+		else
+			fp->nmissed++;
+	}
+
+	preempt_enable_notrace();
+	ftrace_test_recursion_unlock(bit);
+}
+NOKPROBE_SYMBOL(fprobe_handler);
+
+static int fprobe_exit_handler(struct kretprobe_instance *ri,
+			       struct pt_regs *regs)
+{
+	struct fprobe *fp = container_of(get_kretprobe(ri), struct fprobe, rp);
+
+	if (!fprobe_disabled(fp))
+		fp->exit_handler(fp, *(unsigned long *)ri->data, regs);
+	return 0;
+}
+NOKPROBE_SYMBOL(fprobe_exit_handler);
+
+static int fprobe_init_rp(struct fprobe *fp, int num)
+{
+	memset(&fp->rp, 0, sizeof(fp->rp));
+	if (!fp->exit_handler)
+		return 0;
+
+	fp->rp.handler = fprobe_exit_handler;
+	fp->rp.data_size = sizeof(unsigned long);
+	/* enough for every CPU to be some calls deep into probed functions */
+	fp->rp.maxactive = fp->nr_maxactive ? :
+		num_possible_cpus() * min(num, FPROBE_DEFAULT_DEPTH);
+
+	return kretprobe_init_instances(&fp->rp);
+}
+
+static void fprobe_init(struct fprobe *fp)
+{
+	fp->nmissed = 0;
+	fp->ops.func = fprobe_handler;
+	fp->ops.flags |= FTRACE_OPS_FL_SAVE_REGS;
+}
+
+static int fprobe_register_ops(struct fprobe *fp, int num)
+{
+	int ret;
+
+	ret = fprobe_init_rp(fp, num);
+	if (ret)
+		return ret;
+
+	ret = register_ftrace_function(&fp->ops);
+	if (ret && fp->exit_handler)
+		kretprobe_free_instances(&fp->rp);
+	return ret;
+}
+
+/**
+ * register_fprobe() - Register fprobe to ftrace by pattern.
+ * @fp: A fprobe data structure to be registered.
+ * @filter: A wildcard pattern of probed symbols.
+ * @notfilter: A wildcard pattern of NOT probed symbols.
+ *
+ * Register @fp to ftrace for enabling the probe on the symbols matched to
+ * @filter.  If @notfilter is not NULL, the symbols matched the @notfilter
+ * are not probed.
+ *
+ * Return 0 if @fp is registered successfully, -errno if not.
+ */
+int register_fprobe(struct fprobe *fp, const char *filter, const char *notfilter)
+{
+	unsigned char *str;
+	int ret;
+
+	if (!fp || !filter)
+		return -EINVAL;
+
+	fprobe_init(fp);
+
+	str = kstrdup(filter, GFP_KERNEL);
+	if (!str)
+		return -ENOMEM;
+	ret = ftrace_set_filter(&fp->ops, str, strlen(str), 0);
+	kfree(str);
+	if (ret)
+		goto out;
+
+	if (notfilter) {
+		str = kstrdup(notfilter, GFP_KERNEL);
+		if (!str) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		ret = ftrace_set_notrace(&fp->ops, str, strlen(str), 0);
+		kfree(str);
+		if (ret)
+			goto out;
+	}
+
+	/* the number of matched functions is not known, assume many */
+	ret = fprobe_register_ops(fp, FPROBE_DEFAULT_DEPTH);
+out:
+	if (ret)
+		ftrace_free_filter(&fp->ops);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(register_fprobe);
+
+/**
+ * register_fprobe_ips() - Register fprobe to ftrace by address.
+ * @fp: A fprobe data structure to be registered.
+ * @addrs: An array of target ftrace location addresses.
+ * @num: The number of entries of @addrs.
+ *
+ * Register @fp to ftrace for enabling the probe on the addresses given by
+ * @addrs.  The @addrs must be the addresses of ftrace location addresses,
+ * which may be the symbol address + arch-dependent offset.  Please use
+ * register_fprobe() if you don't know what this means.
+ *
+ * Return 0 if @fp is registered successfully, -errno if not.
+ */
+int register_fprobe_ips(struct fprobe *fp, unsigned long *addrs, int num)
+{
+	int ret;
+
+	if (!fp || !addrs || num <= 0)
+		return -EINVAL;
+
+	fprobe_init(fp);
+
+	/* one filter hash update for all of the functions */
+	ret = ftrace_set_filter_ips(&fp->ops, addrs, num, 0, 0);
+	if (ret)
+		goto out;
+
+	ret = fprobe_register_ops(fp, num);
+out:
+	if (ret)
+		ftrace_free_filter(&fp->ops);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(register_fprobe_ips);
+
+/**
+ * unregister_fprobe() - Unregister fprobe from ftrace
+ * @fp: A fprobe data structure to be unregistered.
+ *
+ * Unregister fprobe (and remove ftrace hooks from the function entries).
+ * Upon return no handler of @fp runs anymore.
+ *
+ * Return 0 if @fp is unregistered successfully, -errno if not.
+ */
+int unregister_fprobe(struct fprobe *fp)
+{
+	int ret;
+
+	if (!fp || fp->ops.func != fprobe_handler)
+		return -EINVAL;
+
+	ret = unregister_ftrace_function(&fp->ops);
+	if (ret < 0)
+		return ret;
+
+	/* returns still pending run into a kretprobe that is gone */
+	if (fp->exit_handler)
+		kretprobe_free_instances(&fp->rp);
+
+	ftrace_free_filter(&fp->ops);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(unregister_fprobe);
@@ -8,6 +8,7 @@
 #include <linux/trace_events.h>
 #include <linux/ring_buffer.h>
 #include <linux/trace_clock.h>
+#include <linux/trace_mmap.h>
 #include <linux/sched/clock.h>
 #include <linux/trace_seq.h>
 #include <linux/spinlock.h>
@@ -323,6 +324,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 id;		/* ID for external mapping */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -525,6 +527,12 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mapping, see ring_buffer_map() */
+	struct mutex			mapping_lock;
+	unsigned long			*subbuf_ids;	/* page address of each ID */
+	struct trace_buffer_meta	*meta_page;
+	int				mapped;		/* number of VMAs */
 };
 
 struct trace_buffer {
@@ -1637,6 +1645,7 @@ rb_allocate_cpu_buffer(struct trace_buffer *buffer, long nr_pages, int cpu)
 	init_irq_work(&cpu_buffer->irq_work.work, rb_wake_up_waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.full_waiters);
+	mutex_init(&cpu_buffer->mapping_lock);
 
 	bpage = kzalloc_node(ALIGN(sizeof(*bpage), cache_line_size()),
 			    GFP_KERNEL, cpu_to_node(cpu));
@@ -5071,6 +5080,20 @@ unsigned long ring_buffer_size(struct trace_buffer *buffer, int cpu)
 }
 EXPORT_SYMBOL_GPL(ring_buffer_size);
 
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer,
+				unsigned int read, unsigned int commit)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+
+	meta->reader.id = cpu_buffer->reader_page->id;
+	meta->reader.read = read;
+	meta->reader.commit = commit;
+
+	meta->entries = local_read(&cpu_buffer->entries);
+	meta->overrun = local_read(&cpu_buffer->overrun);
+	meta->read = cpu_buffer->read;
+}
+
 static void
 rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 {
@@ -5116,6 +5139,11 @@ rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 	cpu_buffer->lost_events = 0;
 	cpu_buffer->last_overrun = 0;
 
+	if (cpu_buffer->mapped) {
+		cpu_buffer->meta_page->reader.lost_events = 0;
+		rb_update_meta_page(cpu_buffer, 0, 0);
+	}
+
 	rb_head_page_activate(cpu_buffer);
 }
 
@@ -5319,6 +5347,11 @@ int ring_buffer_swap_cpu(struct trace_buffer *buffer_a,
 	if (cpu_buffer_a->nr_pages != cpu_buffer_b->nr_pages)
 		goto out;
 
+	/* the pages of a mapped buffer must stay where user space sees them */
+	ret = -EBUSY;
+	if (cpu_buffer_a->mapped || cpu_buffer_b->mapped)
+		goto out;
+
 	ret = -EAGAIN;
 
 	if (atomic_read(&buffer_a->record_disabled))
@@ -5538,19 +5571,24 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 	/*
 	 * If this page has been partially read or
 	 * if len is not big enough to read the rest of the page or
-	 * a writer is still on the page, then
+	 * a writer is still on the page or
+	 * the buffer is mapped to user space, then
 	 * we must copy the data from the page to the buffer.
 	 * Otherwise, we can simply swap the page with the one passed in.
 	 */
 	if (read || (len < (commit - read)) ||
-	    cpu_buffer->reader_page == cpu_buffer->commit_page) {
+	    cpu_buffer->reader_page == cpu_buffer->commit_page ||
+	    cpu_buffer->mapped) {
 		struct buffer_data_page *rpage = cpu_buffer->reader_page->page;
 		unsigned int rpos = read;
 		unsigned int pos = 0;
 		unsigned int size;
 
-		if (full)
+		if (full) {
+			if (cpu_buffer->mapped)
+				ret = -EBUSY;
 			goto out_unlock;
+		}
 
 		if (len > (commit - read))
 			len = (commit - read);
@@ -5652,6 +5690,297 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+static void rb_setup_ids_meta_page(struct ring_buffer_per_cpu *cpu_buffer,
+				   unsigned long *subbuf_ids)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+	struct buffer_page *subbuf = cpu_buffer->head_page;
+	unsigned int read;
+	unsigned long i;
+	int id = 0;
+
+	/* the reader page is always ID 0, the ring follows from the head */
+	subbuf_ids[id] = (unsigned long)cpu_buffer->reader_page->page;
+	cpu_buffer->reader_page->id = id++;
+
+	for (i = 0; i < cpu_buffer->nr_pages; i++) {
+		subbuf_ids[id] = (unsigned long)subbuf->page;
+		subbuf->id = id++;
+		rb_inc_page(&subbuf);
+	}
+
+	cpu_buffer->subbuf_ids = subbuf_ids;
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->subbuf_size = PAGE_SIZE;
+	meta->nr_subbufs = id;
+	meta->reader.lost_events = 0;
+
+	/* nothing of the current reader page is handed out yet */
+	read = cpu_buffer->reader_page->read;
+	rb_update_meta_page(cpu_buffer, read, read);
+}
+
+static int __rb_map_vma(struct ring_buffer_per_cpu *cpu_buffer,
+			struct vm_area_struct *vma)
+{
+	unsigned long nr_pages = vma_pages(vma);
+	unsigned long addr = vma->vm_start;
+	unsigned long i;
+	struct page *page;
+	int err;
+
+	if (vma->vm_pgoff || nr_pages > cpu_buffer->meta_page->nr_subbufs + 1)
+		return -EINVAL;
+
+	for (i = 0; i < nr_pages; i++, addr += PAGE_SIZE) {
+		if (!i)
+			page = virt_to_page(cpu_buffer->meta_page);
+		else
+			page = virt_to_page((void *)cpu_buffer->subbuf_ids[i - 1]);
+
+		err = vm_insert_page(vma, addr, page);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/**
+ * ring_buffer_map - map a per CPU buffer into user space
+ * @buffer: The ring buffer the CPU buffer belongs to
+ * @cpu: The CPU buffer to map
+ * @vma: The read-only VMA to map it into
+ *
+ * The meta page describing the buffer goes at the start of @vma, followed
+ * by the sub-buffers in ID order.  While the buffer is mapped, its pages
+ * are never swapped out of it and it can not be resized, so a consumer
+ * can parse events in place between calls of ring_buffer_map_get_reader().
+ *
+ * Returns 0 on success, a negative error code otherwise.
+ */
+int ring_buffer_map(struct trace_buffer *buffer, int cpu,
+		    struct vm_area_struct *vma)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta_page;
+	unsigned long *subbuf_ids;
+	unsigned long flags;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (cpu_buffer->mapped) {
+		err = __rb_map_vma(cpu_buffer, vma);
+		if (!err)
+			cpu_buffer->mapped++;
+		goto unlock;
+	}
+
+	/* prevent another thread from changing buffer sizes */
+	mutex_lock(&buffer->mutex);
+
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	meta_page = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!subbuf_ids || !meta_page) {
+		err = -ENOMEM;
+		goto free;
+	}
+
+	atomic_inc(&cpu_buffer->resize_disabled);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->meta_page = meta_page;
+	rb_setup_ids_meta_page(cpu_buffer, subbuf_ids);
+	cpu_buffer->mapped = 1;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	err = __rb_map_vma(cpu_buffer, vma);
+	if (!err) {
+		mutex_unlock(&buffer->mutex);
+		goto unlock;
+	}
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->mapped = 0;
+	cpu_buffer->meta_page = NULL;
+	cpu_buffer->subbuf_ids = NULL;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	atomic_dec(&cpu_buffer->resize_disabled);
+ free:
+	mutex_unlock(&buffer->mutex);
+	free_page((unsigned long)meta_page);
+	kfree(subbuf_ids);
+ unlock:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map);
+
+/**
+ * ring_buffer_map_dup - account one more VMA of an existing mapping
+ * @buffer: The ring buffer the CPU buffer belongs to
+ * @cpu: The mapped CPU buffer
+ *
+ * For VMAs created from a mapped one by splitting or moving it.
+ */
+int ring_buffer_map_dup(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+	if (cpu_buffer->mapped)
+		cpu_buffer->mapped++;
+	else
+		err = -ENODEV;
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_dup);
+
+/**
+ * ring_buffer_unmap - drop a mapping set up by ring_buffer_map()
+ * @buffer: The ring buffer the CPU buffer belongs to
+ * @cpu: The mapped CPU buffer
+ *
+ * Called once for each VMA that got unmapped.
+ */
+int ring_buffer_unmap(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct trace_buffer_meta *meta_page;
+	unsigned long *subbuf_ids;
+	unsigned long flags;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+
+	if (!cpu_buffer->mapped) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	if (cpu_buffer->mapped > 1) {
+		cpu_buffer->mapped--;
+		goto out;
+	}
+
+	mutex_lock(&buffer->mutex);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->mapped = 0;
+	meta_page = cpu_buffer->meta_page;
+	subbuf_ids = cpu_buffer->subbuf_ids;
+	cpu_buffer->meta_page = NULL;
+	cpu_buffer->subbuf_ids = NULL;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	atomic_dec(&cpu_buffer->resize_disabled);
+
+	mutex_unlock(&buffer->mutex);
+
+	free_page((unsigned long)meta_page);
+	kfree(subbuf_ids);
+ out:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_unmap);
+
+/**
+ * ring_buffer_map_get_reader - hand the next events to a mapping consumer
+ * @buffer: The ring buffer the CPU buffer belongs to
+ * @cpu: The mapped CPU buffer
+ *
+ * Swaps in a new reader page if the current one was fully handed out and
+ * records in the meta page which part of the reader page holds events
+ * not handed out before.  Those events are consumed right away, the
+ * consumer is expected to parse them before calling this again.
+ *
+ * Returns 0 on success, -ENODEV if the buffer is not mapped.
+ */
+int ring_buffer_map_get_reader(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct ring_buffer_event *event;
+	struct buffer_page *reader;
+	unsigned int read, commit;
+	unsigned long flags;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+
+	if (!cpu_buffer->mapped) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	reader = rb_get_reader_page(cpu_buffer);
+	if (!reader) {
+		/* nothing new, hand out an empty range */
+		read = commit = cpu_buffer->reader_page->read;
+		goto update;
+	}
+
+	read = reader->read;
+	commit = rb_page_commit(reader);
+
+	cpu_buffer->meta_page->reader.lost_events = cpu_buffer->lost_events;
+	cpu_buffer->lost_events = 0;
+
+	if (!read && reader != cpu_buffer->commit_page) {
+		/* a full page no writer can add to anymore */
+		cpu_buffer->read += rb_page_entries(reader);
+		reader->read = commit;
+		goto update;
+	}
+
+	while (reader->read < commit) {
+		event = rb_reader_event(cpu_buffer);
+		if (event->type_len <= RINGBUF_TYPE_DATA_TYPE_LEN_MAX)
+			cpu_buffer->read++;
+		rb_update_read_stamp(cpu_buffer, event);
+		reader->read += rb_event_length(event);
+	}
+
+ update:
+	cpu_buffer->read_bytes += commit - read;
+	rb_update_meta_page(cpu_buffer, read, commit);
+ out:
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_map_get_reader);
+
 /*
  * We only allocate new buffers, never free them if the CPU goes down.
  * If we were to free the buffer, then the user would lose any trace that was in
@@ -65,7 +65,8 @@
 	C(INVALID_SORT_MODIFIER,"Invalid sort modifier"),		\
 	C(EMPTY_SORT_FIELD,	"Empty sort field"),			\
 	C(TOO_MANY_SORT_FIELDS,	"Too many sort fields (Max = 2)"),	\
-	C(INVALID_SORT_FIELD,	"Sort field must be a key or a val"),
+	C(INVALID_SORT_FIELD,	"Sort field must be a key or a val"),	\
+	C(BAD_HIST_MODIFIER,	"Invalid histogram value modifier"),
 
 #undef C
 #define C(a, b)		HIST_ERR_##a
@@ -150,8 +151,14 @@ struct hist_field {
 	bool                            read_once;
 
 	unsigned int			var_str_idx;
+
+	/* bucket width of HIST_FIELD_FL_BUCKETS values */
+	unsigned long			buckets;
 };
 
+/* Number of buckets of .log2hist and .buckets=N values */
+#define HIST_VAL_BUCKETS	TRACING_MAP_HIST_BUCKETS_MAX
+
 static u64 hist_field_none(struct hist_field *field,
 			   struct tracing_map_elt *elt,
 			   struct trace_buffer *buffer,
@@ -317,8 +324,12 @@ enum hist_field_flags {
 	HIST_FIELD_FL_VAR_REF		= 1 << 14,
 	HIST_FIELD_FL_CPU		= 1 << 15,
 	HIST_FIELD_FL_ALIAS		= 1 << 16,
+	HIST_FIELD_FL_LOG2_HIST		= 1 << 17,
+	HIST_FIELD_FL_BUCKETS		= 1 << 18,
 };
 
+#define HIST_FIELD_FL_HIST	(HIST_FIELD_FL_LOG2_HIST | HIST_FIELD_FL_BUCKETS)
+
 struct var_defs {
 	unsigned int	n_vars;
 	char		*name[TRACING_MAP_VARS_MAX];
@@ -3677,15 +3688,63 @@ static int __create_val_field(struct hist_trigger_data *hist_data,
 	return ret;
 }
 
+/*
+ * Strip a trailing .log2hist or .buckets=N from a value.  These can't go
+ * through parse_field() as they apply to whatever the value expression
+ * evaluates to, variable references included.
+ */
+static int parse_val_hist_modifier(struct hist_trigger_data *hist_data,
+				   char *field_str, unsigned long *flags,
+				   unsigned long *width)
+{
+	struct trace_array *tr = hist_data->event_file->tr;
+	char *modifier = strrchr(field_str, '.');
+
+	if (!modifier)
+		return 0;
+
+	if (strcmp(modifier, ".log2hist") == 0) {
+		*flags |= HIST_FIELD_FL_LOG2_HIST;
+	} else if (str_has_prefix(modifier, ".buckets=")) {
+		if (kstrtoul(modifier + strlen(".buckets="), 0, width) ||
+		    !*width) {
+			hist_err(tr, HIST_ERR_BAD_HIST_MODIFIER,
+				 errpos(modifier + 1));
+			return -EINVAL;
+		}
+		*flags |= HIST_FIELD_FL_BUCKETS;
+	} else {
+		return 0;
+	}
+
+	*modifier = '\0';
+
+	return 0;
+}
+
 static int create_val_field(struct hist_trigger_data *hist_data,
 			    unsigned int val_idx,
 			    struct trace_event_file *file,
 			    char *field_str)
 {
+	unsigned long hist_flags = 0, width = 0;
+	int ret;
+
 	if (WARN_ON(val_idx >= TRACING_MAP_VALS_MAX))
 		return -EINVAL;
 
-	return __create_val_field(hist_data, val_idx, file, NULL, field_str, 0);
+	ret = parse_val_hist_modifier(hist_data, field_str, &hist_flags, &width);
+	if (ret)
+		return ret;
+
+	ret = __create_val_field(hist_data, val_idx, file, NULL, field_str, 0);
+	if (ret)
+		return ret;
+
+	hist_data->fields[val_idx]->flags |= hist_flags;
+	hist_data->fields[val_idx]->buckets = width;
+
+	return 0;
 }
 
 static int create_var_field(struct hist_trigger_data *hist_data,
@@ -4351,7 +4410,9 @@ static int create_tracing_map_fields(struct hist_trigger_data *hist_data)
 			idx = tracing_map_add_key_field(map,
 							hist_field->offset,
 							cmp_fn);
-		} else if (!(hist_field->flags & HIST_FIELD_FL_VAR))
+		} else if (hist_field->flags & HIST_FIELD_FL_HIST)
+			idx = tracing_map_add_hist_field(map, HIST_VAL_BUCKETS);
+		else if (!(hist_field->flags & HIST_FIELD_FL_VAR))
 			idx = tracing_map_add_sum_field(map);
 
 		if (idx < 0)
@@ -4424,6 +4485,24 @@ create_hist_data(unsigned int map_bits,
 	goto out;
 }
 
+static unsigned int hist_val_bucket(struct hist_field *hist_field, u64 val)
+{
+	if (hist_field->flags & HIST_FIELD_FL_LOG2_HIST)
+		return fls64(val);
+
+	/* tracing_map_update_hist() puts anything larger in the last one */
+	return min_t(u64, div64_ul(val, hist_field->buckets), HIST_VAL_BUCKETS);
+}
+
+/* Lowest value counted in bucket @b */
+static u64 hist_val_bucket_start(struct hist_field *hist_field, unsigned int b)
+{
+	if (hist_field->flags & HIST_FIELD_FL_LOG2_HIST)
+		return b ? 1ULL << (b - 1) : 0;
+
+	return (u64)b * hist_field->buckets;
+}
+
 static void hist_trigger_elt_update(struct hist_trigger_data *hist_data,
 				    struct tracing_map_elt *elt,
 				    struct trace_buffer *buffer, void *rec,
@@ -4463,6 +4542,9 @@ static void hist_trigger_elt_update(struct hist_trigger_data *hist_data,
 			continue;
 		}
 		tracing_map_update_sum(elt, i, hist_val);
+		if (hist_field->flags & HIST_FIELD_FL_HIST)
+			tracing_map_update_hist(elt, i,
+						hist_val_bucket(hist_field, hist_val));
 	}
 
 	for_each_hist_key_field(i, hist_data) {
@@ -4672,11 +4754,74 @@ static void hist_trigger_print_key(struct seq_file *m,
 	seq_puts(m, "}");
 }
 
+static void hist_val_print_percentiles(struct seq_file *m,
+				       struct hist_field *hist_field,
+				       u64 *counts)
+{
+	static const unsigned int percentiles[] = { 50, 90, 99 };
+	unsigned int b, p;
+	u64 total = 0, seen;
+
+	for (b = 0; b < HIST_VAL_BUCKETS; b++)
+		total += counts[b];
+	if (!total)
+		return;
+
+	seen = counts[0];
+	for (b = 0, p = 0; p < ARRAY_SIZE(percentiles); p++) {
+		while (seen * 100 < total * percentiles[p])
+			seen += counts[++b];
+
+		if (b == HIST_VAL_BUCKETS - 1)
+			seq_printf(m, " p%u>=%llu", percentiles[p],
+				   hist_val_bucket_start(hist_field, b));
+		else
+			seq_printf(m, " p%u<%llu", percentiles[p],
+				   hist_val_bucket_start(hist_field, b + 1));
+	}
+}
+
+/* One line per histogram value, listing the buckets that were hit */
+static void hist_val_print_buckets(struct seq_file *m,
+				   struct hist_trigger_data *hist_data,
+				   struct tracing_map_elt *elt)
+{
+	u64 counts[HIST_VAL_BUCKETS];
+	struct hist_field *hist_field;
+	unsigned int i, b;
+
+	for (i = 1; i < hist_data->n_vals; i++) {
+		hist_field = hist_data->fields[i];
+		if (!(hist_field->flags & HIST_FIELD_FL_HIST) ||
+		    hist_field->flags & HIST_FIELD_FL_EXPR)
+			continue;
+
+		tracing_map_read_hist(elt, i, counts);
+
+		seq_printf(m, "    %s buckets:", hist_field_name(hist_field, 0));
+		for (b = 0; b < HIST_VAL_BUCKETS; b++) {
+			if (!counts[b])
+				continue;
+			if (b == HIST_VAL_BUCKETS - 1)
+				seq_printf(m, " [%llu-]: %llu",
+					   hist_val_bucket_start(hist_field, b),
+					   counts[b]);
+			else
+				seq_printf(m, " [%llu-%llu): %llu",
+					   hist_val_bucket_start(hist_field, b),
+					   hist_val_bucket_start(hist_field, b + 1),
+					   counts[b]);
+		}
+		seq_puts(m, "\n");
+	}
+}
+
 static void hist_trigger_entry_print(struct seq_file *m,
 				     struct hist_trigger_data *hist_data,
 				     void *key,
 				     struct tracing_map_elt *elt)
 {
+	u64 counts[HIST_VAL_BUCKETS];
 	const char *field_name;
 	unsigned int i;
 
@@ -4699,11 +4844,19 @@ static void hist_trigger_entry_print(struct seq_file *m,
 			seq_printf(m, "  %s: %10llu", field_name,
 				   tracing_map_read_sum(elt, i));
 		}
+
+		if (hist_data->fields[i]->flags & HIST_FIELD_FL_HIST) {
+			tracing_map_read_hist(elt, i, counts);
+			hist_val_print_percentiles(m, hist_data->fields[i],
+						   counts);
+		}
 	}
 
 	print_actions(m, hist_data, elt);
 
 	seq_puts(m, "\n");
+
+	hist_val_print_buckets(m, hist_data, elt);
 }
 
 static int print_entries(struct seq_file *m,
@@ -5096,6 +5249,11 @@ static void hist_field_print(struct seq_file *m, struct hist_field *hist_field)
 				seq_printf(m, ".%s", flags);
 		}
 	}
+
+	if (hist_field->flags & HIST_FIELD_FL_LOG2_HIST)
+		seq_puts(m, ".log2hist");
+	else if (hist_field->flags & HIST_FIELD_FL_BUCKETS)
+		seq_printf(m, ".buckets=%lu", hist_field->buckets);
 }
 
 static int event_hist_trigger_print(struct seq_file *m,
@@ -5384,6 +5542,8 @@ static bool hist_trigger_match(struct event_trigger_data *data,
 			return false;
 		if (key_field->is_signed != key_field_test->is_signed)
 			return false;
+		if (key_field->buckets != key_field_test->buckets)
+			return false;
 		if (!!key_field->var.name != !!key_field_test->var.name)
 			return false;
 		if (key_field->var.name &&
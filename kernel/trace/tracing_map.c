@@ -12,6 +12,7 @@
  */
 
 #include <linux/vmalloc.h>
+#include <linux/percpu.h>
 #include <linux/jhash.h>
 #include <linux/slab.h>
 #include <linux/sort.h>
@@ -57,6 +58,57 @@ u64 tracing_map_read_sum(struct tracing_map_elt *elt, unsigned int i)
 	return (u64)atomic64_read(&elt->fields[i].sum);
 }
 
+/**
+ * tracing_map_update_hist - Count a value in a tracing_map_elt's hist field
+ * @elt: The tracing_map_elt
+ * @i: The index of the given hist field associated with the tracing_map_elt
+ * @bucket: The bucket the value falls into
+ *
+ * Increment the current CPU's count of bucket @bucket of hist field i
+ * associated with the specified tracing_map_elt instance.  The index i
+ * is the index returned by the call to tracing_map_add_hist_field() when
+ * the tracing map was set up, buckets beyond the last one are counted in
+ * the last one.
+ */
+void tracing_map_update_hist(struct tracing_map_elt *elt, unsigned int i,
+			     unsigned int bucket)
+{
+	struct tracing_map_field *field = &elt->fields[i];
+
+	if (bucket >= field->n_buckets)
+		bucket = field->n_buckets - 1;
+
+	this_cpu_inc(field->buckets[bucket]);
+}
+
+/**
+ * tracing_map_read_hist - Return the bucket counts of a tracing_map_elt's hist field
+ * @elt: The tracing_map_elt
+ * @i: The index of the given hist field associated with the tracing_map_elt
+ * @counts: Array of the field's number of buckets to return the counts in
+ *
+ * Sum up the per-CPU bucket counts of hist field i associated with the
+ * specified tracing_map_elt instance.  The index i is the index returned
+ * by the call to tracing_map_add_hist_field() when the tracing map was
+ * set up.
+ */
+void tracing_map_read_hist(struct tracing_map_elt *elt, unsigned int i,
+			   u64 *counts)
+{
+	struct tracing_map_field *field = &elt->fields[i];
+	unsigned int b;
+	int cpu;
+
+	memset(counts, 0, field->n_buckets * sizeof(*counts));
+
+	for_each_possible_cpu(cpu) {
+		u64 *buckets = per_cpu_ptr(field->buckets, cpu);
+
+		for (b = 0; b < field->n_buckets; b++)
+			counts[b] += READ_ONCE(buckets[b]);
+	}
+}
+
 /**
  * tracing_map_set_var - Assign a tracing_map_elt's variable field
  * @elt: The tracing_map_elt
@@ -228,6 +280,34 @@ int tracing_map_add_sum_field(struct tracing_map *map)
 	return tracing_map_add_field(map, tracing_map_cmp_atomic64);
 }
 
+/**
+ * tracing_map_add_hist_field - Add a field describing a tracing_map histogram
+ * @map: The tracing_map
+ * @n_buckets: The number of buckets of the histogram
+ *
+ * Add a hist field to the map and return the index identifying it in
+ * the map and associated tracing_map_elts.  A hist field is a sum field
+ * that additionally counts values in @n_buckets buckets using
+ * tracing_map_update_hist(); the counts are kept per CPU and summed up
+ * by tracing_map_read_hist().  Sorting on it sorts on the sum.
+ *
+ * Return: The index identifying the field in the map and associated
+ * tracing_map_elts, or -EINVAL on error.
+ */
+int tracing_map_add_hist_field(struct tracing_map *map, unsigned int n_buckets)
+{
+	int idx;
+
+	if (!n_buckets || n_buckets > TRACING_MAP_HIST_BUCKETS_MAX)
+		return -EINVAL;
+
+	idx = tracing_map_add_field(map, tracing_map_cmp_atomic64);
+	if (idx >= 0)
+		map->fields[idx].n_buckets = n_buckets;
+
+	return idx;
+}
+
 /**
  * tracing_map_add_var - Add a field describing a tracing_map var
  * @map: The tracing_map
@@ -356,9 +436,20 @@ static void tracing_map_elt_clear(struct tracing_map_elt *elt)
 {
 	unsigned i;
 
-	for (i = 0; i < elt->map->n_fields; i++)
-		if (elt->fields[i].cmp_fn == tracing_map_cmp_atomic64)
-			atomic64_set(&elt->fields[i].sum, 0);
+	for (i = 0; i < elt->map->n_fields; i++) {
+		struct tracing_map_field *field = &elt->fields[i];
+		int cpu;
+
+		if (field->cmp_fn == tracing_map_cmp_atomic64)
+			atomic64_set(&field->sum, 0);
+
+		if (!field->buckets)
+			continue;
+
+		for_each_possible_cpu(cpu)
+			memset(per_cpu_ptr(field->buckets, cpu), 0,
+			       field->n_buckets * sizeof(u64));
+	}
 
 	for (i = 0; i < elt->map->n_vars; i++) {
 		atomic64_set(&elt->vars[i], 0);
@@ -385,11 +476,16 @@ static void tracing_map_elt_init_fields(struct tracing_map_elt *elt)
 
 static void tracing_map_elt_free(struct tracing_map_elt *elt)
 {
+	unsigned int i;
+
 	if (!elt)
 		return;
 
 	if (elt->map->ops && elt->map->ops->elt_free)
 		elt->map->ops->elt_free(elt);
+	if (elt->fields)
+		for (i = 0; i < elt->map->n_fields; i++)
+			free_percpu(elt->fields[i].buckets);
 	kfree(elt->fields);
 	kfree(elt->vars);
 	kfree(elt->var_set);
@@ -400,6 +496,7 @@ static void tracing_map_elt_free(struct tracing_map_elt *elt)
 static struct tracing_map_elt *tracing_map_elt_alloc(struct tracing_map *map)
 {
 	struct tracing_map_elt *elt;
+	unsigned int i;
 	int err = 0;
 
 	elt = kzalloc(sizeof(*elt), GFP_KERNEL);
@@ -432,6 +529,21 @@ static struct tracing_map_elt *tracing_map_elt_alloc(struct tracing_map *map)
 		goto free;
 	}
 
+	for (i = 0; i < map->n_fields; i++) {
+		unsigned int n_buckets = map->fields[i].n_buckets;
+
+		if (!n_buckets)
+			continue;
+
+		elt->fields[i].n_buckets = n_buckets;
+		elt->fields[i].buckets = __alloc_percpu(n_buckets * sizeof(u64),
+							sizeof(u64));
+		if (!elt->fields[i].buckets) {
+			err = -ENOMEM;
+			goto free;
+		}
+	}
+
 	tracing_map_elt_init_fields(elt);
 
 	if (map->ops && map->ops->elt_alloc) {
@@ -12,6 +12,7 @@
 					 TRACING_MAP_VALS_MAX)
 #define TRACING_MAP_VARS_MAX		16
 #define TRACING_MAP_SORT_KEYS_MAX	2
+#define TRACING_MAP_HIST_BUCKETS_MAX	32
 
 typedef int (*tracing_map_cmp_fn_t) (void *val_a, void *val_b);
 
@@ -133,6 +134,9 @@ struct tracing_map_field {
 		atomic64_t			sum;
 		unsigned int			offset;
 	};
+	/* hist fields: per-CPU bucket counts, merged on read */
+	unsigned int			n_buckets;
+	u64 __percpu			*buckets;
 };
 
 struct tracing_map_elt {
@@ -245,6 +249,8 @@ tracing_map_create(unsigned int map_bits,
 extern int tracing_map_init(struct tracing_map *map);
 
 extern int tracing_map_add_sum_field(struct tracing_map *map);
+extern int tracing_map_add_hist_field(struct tracing_map *map,
+				      unsigned int n_buckets);
 extern int tracing_map_add_var(struct tracing_map *map);
 extern int tracing_map_add_key_field(struct tracing_map *map,
 				     unsigned int offset,
@@ -265,6 +271,10 @@ extern int tracing_map_cmp_none(void *val_a, void *val_b);
 
 extern void tracing_map_update_sum(struct tracing_map_elt *elt,
 				   unsigned int i, u64 n);
+extern void tracing_map_update_hist(struct tracing_map_elt *elt,
+				    unsigned int i, unsigned int bucket);
+extern void tracing_map_read_hist(struct tracing_map_elt *elt,
+				  unsigned int i, u64 *counts);
 extern void tracing_map_set_var(struct tracing_map_elt *elt,
 				unsigned int i, u64 n);
 extern bool tracing_map_var_set(struct tracing_map_elt *elt, unsigned int i);
@@ -46,6 +46,8 @@
 #include <linux/hashtable.h>
 #include <linux/rculist.h>
 #include <linux/nodemask.h>
+#include <linux/topology.h>
+#include <linux/sched/topology.h>
 #include <linux/moduleparam.h>
 #include <linux/uaccess.h>
 #include <linux/sched/isolation.h>
@@ -288,6 +290,44 @@ static cpumask_var_t *wq_numa_possible_cpumask;
 static bool wq_disable_numa;
 module_param_named(disable_numa, wq_disable_numa, bool, 0444);
 
+static const char * const wq_affn_names[WQ_AFFN_NR_TYPES] = {
+	[WQ_AFFN_DFL]		= "default",
+	[WQ_AFFN_CPU]		= "cpu",
+	[WQ_AFFN_SMT]		= "smt",
+	[WQ_AFFN_CACHE]		= "cache",
+	[WQ_AFFN_NUMA]		= "numa",
+	[WQ_AFFN_SYSTEM]	= "system",
+};
+
+static enum wq_affn_scope wq_affn_dfl = WQ_AFFN_NUMA;
+
+static int wq_affn_dfl_set(const char *val, const struct kernel_param *kp)
+{
+	int affn;
+
+	affn = sysfs_match_string(wq_affn_names, val);
+	if (affn < 0)
+		return affn;
+	/* "system" is workqueue.disable_numa */
+	if (affn == WQ_AFFN_DFL || affn == WQ_AFFN_SYSTEM)
+		return -EINVAL;
+
+	wq_affn_dfl = affn;
+	return 0;
+}
+
+static int wq_affn_dfl_get(char *buffer, const struct kernel_param *kp)
+{
+	return scnprintf(buffer, PAGE_SIZE, "%s\n", wq_affn_names[wq_affn_dfl]);
+}
+
+static const struct kernel_param_ops wq_affn_dfl_ops = {
+	.set	= wq_affn_dfl_set,
+	.get	= wq_affn_dfl_get,
+};
+
+module_param_cb(default_affinity_scope, &wq_affn_dfl_ops, NULL, 0444);
+
 /* see the comment above the definition of WQ_POWER_EFFICIENT */
 static bool wq_power_efficient = IS_ENABLED(CONFIG_WQ_POWER_EFFICIENT_DEFAULT);
 module_param_named(power_efficient, wq_power_efficient, bool, 0444);
@@ -830,12 +870,55 @@ static struct worker *first_idle_worker(struct worker_pool *pool)
  * CONTEXT:
  * raw_spin_lock_irq(pool->lock).
  */
+#ifdef CONFIG_SMP
+static bool wq_cpus_share_scope(enum wq_affn_scope affn, int cpu0, int cpu1)
+{
+	switch (affn) {
+	case WQ_AFFN_CPU:
+		return cpu0 == cpu1;
+	case WQ_AFFN_SMT:
+		return cpumask_test_cpu(cpu1, topology_sibling_cpumask(cpu0));
+	case WQ_AFFN_CACHE:
+		return cpus_share_cache(cpu0, cpu1);
+	default:
+		return true;
+	}
+}
+
+/*
+ * @worker of an unbound pool is about to be woken up for work queued from
+ * this CPU.  If it last ran outside the pool's affinity scope of this CPU,
+ * point the wakeup here, the scheduler then picks an idle CPU nearby.  The
+ * worker may still run anywhere in the pool's cpumask.
+ */
+static void wake_up_worker_hint(struct worker_pool *pool,
+				struct worker *worker)
+{
+	struct task_struct *p = worker->task;
+	int cpu = raw_smp_processor_id();
+
+	if (pool->cpu >= 0 || pool->attrs->affn_scope >= WQ_AFFN_NUMA)
+		return;
+
+	if (cpumask_test_cpu(cpu, pool->attrs->cpumask) &&
+	    !wq_cpus_share_scope(pool->attrs->affn_scope, cpu, task_cpu(p)))
+		p->wake_cpu = cpu;
+}
+#else
+static void wake_up_worker_hint(struct worker_pool *pool,
+				struct worker *worker)
+{
+}
+#endif
+
 static void wake_up_worker(struct worker_pool *pool)
 {
 	struct worker *worker = first_idle_worker(pool);
 
-	if (likely(worker))
+	if (likely(worker)) {
+		wake_up_worker_hint(pool, worker);
 		wake_up_process(worker->task);
+	}
 }
 
 /**
@@ -3386,6 +3469,20 @@ static void copy_workqueue_attrs(struct workqueue_attrs *to,
 	 * get_unbound_pool() explicitly clears ->no_numa after copying.
 	 */
 	to->no_numa = from->no_numa;
+	to->affn_scope = from->affn_scope;
+}
+
+/* the affinity scope worker pools with @attrs steer their wakeups into */
+static enum wq_affn_scope wqattrs_pool_affn(const struct workqueue_attrs *attrs)
+{
+	enum wq_affn_scope affn = attrs->affn_scope;
+
+	if (affn == WQ_AFFN_DFL)
+		affn = wq_affn_dfl;
+	/* pools are per node anyway, no steering needed */
+	if (affn > WQ_AFFN_NUMA)
+		affn = WQ_AFFN_NUMA;
+	return affn;
 }
 
 /* hash value of the content of @attr */
@@ -3394,6 +3491,7 @@ static u32 wqattrs_hash(const struct workqueue_attrs *attrs)
 	u32 hash = 0;
 
 	hash = jhash_1word(attrs->nice, hash);
+	hash = jhash_1word(wqattrs_pool_affn(attrs), hash);
 	hash = jhash(cpumask_bits(attrs->cpumask),
 		     BITS_TO_LONGS(nr_cpumask_bits) * sizeof(long), hash);
 	return hash;
@@ -3405,6 +3503,8 @@ static bool wqattrs_equal(const struct workqueue_attrs *a,
 {
 	if (a->nice != b->nice)
 		return false;
+	if (wqattrs_pool_affn(a) != wqattrs_pool_affn(b))
+		return false;
 	if (!cpumask_equal(a->cpumask, b->cpumask))
 		return false;
 	return true;
@@ -3642,6 +3742,7 @@ static struct worker_pool *get_unbound_pool(const struct workqueue_attrs *attrs)
 	 * 'struct workqueue_attrs' comments for detail.
 	 */
 	pool->attrs->no_numa = false;
+	pool->attrs->affn_scope = wqattrs_pool_affn(attrs);
 
 	if (worker_pool_assign_id(pool) < 0)
 		goto fail;
@@ -5572,6 +5673,10 @@ static ssize_t wq_numa_store(struct device *dev, struct device_attribute *attr,
 	ret = -EINVAL;
 	if (sscanf(buf, "%d", &v) == 1) {
 		attrs->no_numa = !v;
+		if (attrs->no_numa)
+			attrs->affn_scope = WQ_AFFN_SYSTEM;
+		else if (attrs->affn_scope == WQ_AFFN_SYSTEM)
+			attrs->affn_scope = WQ_AFFN_DFL;
 		ret = apply_workqueue_attrs_locked(wq, attrs);
 	}
 
@@ -5581,11 +5686,59 @@ static ssize_t wq_numa_store(struct device *dev, struct device_attribute *attr,
 	return ret ?: count;
 }
 
+static ssize_t wq_affn_scope_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	enum wq_affn_scope affn;
+	int written;
+
+	mutex_lock(&wq->mutex);
+	affn = wq->unbound_attrs->affn_scope;
+	if (affn == WQ_AFFN_DFL)
+		written = scnprintf(buf, PAGE_SIZE, "%s (%s)\n",
+				    wq_affn_names[affn],
+				    wq_affn_names[wq_affn_dfl]);
+	else
+		written = scnprintf(buf, PAGE_SIZE, "%s\n",
+				    wq_affn_names[affn]);
+	mutex_unlock(&wq->mutex);
+
+	return written;
+}
+
+static ssize_t wq_affn_scope_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int affn, ret = -ENOMEM;
+
+	affn = sysfs_match_string(wq_affn_names, buf);
+	if (affn < 0)
+		return affn;
+
+	apply_wqattrs_lock();
+
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (attrs) {
+		attrs->affn_scope = affn;
+		attrs->no_numa = affn == WQ_AFFN_SYSTEM;
+		ret = apply_workqueue_attrs_locked(wq, attrs);
+	}
+
+	apply_wqattrs_unlock();
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+
 static struct device_attribute wq_sysfs_unbound_attrs[] = {
 	__ATTR(pool_ids, 0444, wq_pool_ids_show, NULL),
 	__ATTR(nice, 0644, wq_nice_show, wq_nice_store),
 	__ATTR(cpumask, 0644, wq_cpumask_show, wq_cpumask_store),
 	__ATTR(numa, 0644, wq_numa_show, wq_numa_store),
+	__ATTR(affinity_scope, 0644, wq_affn_scope_show, wq_affn_scope_store),
 	__ATTR_NULL,
 };
 
@@ -16,6 +16,26 @@
 #include <linux/static_key.h>
 #include <linux/notifier.h>
 
+#if IS_ENABLED(CONFIG_CRC_T10DIF_ARCH)
+
+/*
+ * The architecture code is called directly: no crypto_shash lookup, no
+ * descriptor and no indirect call per buffer.
+ */
+__u16 crc_t10dif_update(__u16 crc, const unsigned char *buffer, size_t len)
+{
+	return crc_t10dif_arch(crc, buffer, len);
+}
+EXPORT_SYMBOL(crc_t10dif_update);
+
+static int crc_t10dif_transform_show(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "%s\n",
+		       crc_t10dif_arch_optimized() ? "arch" : "fallback");
+}
+
+#else /* !CONFIG_CRC_T10DIF_ARCH */
+
 static struct crypto_shash __rcu *crct10dif_tfm;
 static DEFINE_STATIC_KEY_TRUE(crct10dif_fallback);
 static DEFINE_MUTEX(crc_t10dif_mutex);
@@ -83,12 +103,6 @@ __u16 crc_t10dif_update(__u16 crc, const unsigned char *buffer, size_t len)
 }
 EXPORT_SYMBOL(crc_t10dif_update);
 
-__u16 crc_t10dif(const unsigned char *buffer, size_t len)
-{
-	return crc_t10dif_update(0, buffer, len);
-}
-EXPORT_SYMBOL(crc_t10dif);
-
 static int __init crc_t10dif_mod_init(void)
 {
 	INIT_WORK(&crct10dif_rehash_work, crc_t10dif_rehash);
@@ -124,8 +138,17 @@ static int crc_t10dif_transform_show(char *buffer, const struct kernel_param *kp
 	return len;
 }
 
+MODULE_SOFTDEP("pre: crct10dif");
+
+#endif /* !CONFIG_CRC_T10DIF_ARCH */
+
+__u16 crc_t10dif(const unsigned char *buffer, size_t len)
+{
+	return crc_t10dif_update(0, buffer, len);
+}
+EXPORT_SYMBOL(crc_t10dif);
+
 module_param_call(transform, NULL, crc_t10dif_transform_show, NULL, 0444);
 
 MODULE_DESCRIPTION("T10 DIF CRC calculation (library API)");
 MODULE_LICENSE("GPL");
-MODULE_SOFTDEP("pre: crct10dif");
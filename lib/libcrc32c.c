@@ -33,6 +33,26 @@
 #include <linux/module.h>
 #include <linux/crc32c.h>
 
+#if IS_ENABLED(CONFIG_CRC32C_ARCH)
+
+/*
+ * The architecture code is called directly: no crypto_shash lookup, no
+ * descriptor and no indirect call per buffer.
+ */
+u32 crc32c(u32 crc, const void *address, unsigned int length)
+{
+	return crc32c_arch(crc, address, length);
+}
+EXPORT_SYMBOL(crc32c);
+
+const char *crc32c_impl(void)
+{
+	return crc32c_arch_impl() ?: "crc32c-generic";
+}
+EXPORT_SYMBOL(crc32c_impl);
+
+#else /* !CONFIG_CRC32C_ARCH */
+
 static struct crypto_shash *tfm;
 
 u32 crc32c(u32 crc, const void *address, unsigned int length)
@@ -74,7 +94,10 @@ EXPORT_SYMBOL(crc32c_impl);
 module_init(libcrc32c_mod_init);
 module_exit(libcrc32c_mod_fini);
 
+MODULE_SOFTDEP("pre: crc32c");
+
+#endif /* !CONFIG_CRC32C_ARCH */
+
 MODULE_AUTHOR("Clay Haapala <chaapala@cisco.com>");
 MODULE_DESCRIPTION("CRC32c (Castagnoli) calculations");
 MODULE_LICENSE("GPL");
-MODULE_SOFTDEP("pre: crc32c");
@@ -121,19 +121,77 @@ const struct raid6_recov_calls *const raid6_recov_algos[] = {
 #define RAID6_TEST_DISKS	8
 #define RAID6_TEST_DISKS_ORDER	3
 
-static inline const struct raid6_recov_calls *raid6_choose_recov(void)
+#ifdef __KERNEL__
+/* Outcome of the selection, exported read-only through sysfs */
+static char *gen_algo;
+module_param(gen_algo, charp, 0444);
+MODULE_PARM_DESC(gen_algo, "selected gen_syndrome algorithm");
+static unsigned long gen_mbps;
+module_param(gen_mbps, ulong, 0444);
+MODULE_PARM_DESC(gen_mbps, "benchmarked gen_syndrome speed in MB/s");
+static unsigned long xor_mbps;
+module_param(xor_mbps, ulong, 0444);
+MODULE_PARM_DESC(xor_mbps, "benchmarked xor_syndrome speed in MB/s");
+static char *recov_algo;
+module_param(recov_algo, charp, 0444);
+MODULE_PARM_DESC(recov_algo, "selected data recovery algorithm");
+static unsigned long recov_mbps;
+module_param(recov_mbps, ulong, 0444);
+MODULE_PARM_DESC(recov_mbps, "benchmarked two data disk recovery speed in MB/s");
+#else
+static char *gen_algo, *recov_algo;
+static unsigned long gen_mbps, xor_mbps, recov_mbps;
+#endif
+
+static inline const struct raid6_recov_calls *raid6_choose_recov(
+	void *(*const dptrs)[RAID6_TEST_DISKS], const int disks)
 {
 	const struct raid6_recov_calls *const *algo;
 	const struct raid6_recov_calls *best;
+	unsigned long perf, bestperf, j0, j1;
+
+	for (bestperf = 0, best = NULL, algo = raid6_recov_algos; *algo; algo++) {
+		if ((*algo)->valid && !(*algo)->valid())
+			continue;
 
-	for (best = NULL, algo = raid6_recov_algos; *algo; algo++)
-		if (!best || (*algo)->priority > best->priority)
-			if (!(*algo)->valid || (*algo)->valid())
+		if (!IS_ENABLED(CONFIG_RAID6_PQ_BENCHMARK)) {
+			if (!best || (*algo)->priority > best->priority)
 				best = *algo;
+			continue;
+		}
+
+		/*
+		 * Rebuild the first two data disks over and over, the
+		 * contents don't matter for timing purposes.
+		 */
+		perf = 0;
+
+		preempt_disable();
+		j0 = jiffies;
+		while ((j1 = jiffies) == j0)
+			cpu_relax();
+		while (time_before(jiffies,
+				    j1 + (1<<RAID6_TIME_JIFFIES_LG2))) {
+			(*algo)->data2(disks, PAGE_SIZE, 0, 1, *dptrs);
+			perf++;
+		}
+		preempt_enable();
+
+		if (perf > bestperf) {
+			bestperf = perf;
+			best = *algo;
+		}
+		pr_info("raid6: %-8s recov() %5ld MB/s\n", (*algo)->name,
+			(perf * HZ * 2) >>
+			(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2));
+	}
 
 	if (best) {
 		raid6_2data_recov = best->data2;
 		raid6_datap_recov = best->datap;
+		recov_algo = (char *)best->name;
+		recov_mbps = (bestperf * HZ * 2) >>
+			(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2);
 
 		pr_info("raid6: using %s recovery algorithm\n", best->name);
 	} else
@@ -221,6 +279,11 @@ static inline const struct raid6_calls *raid6_choose_gen(
 			pr_info("raid6: skip pq benchmark and using algorithm %s\n",
 				best->name);
 		raid6_call = *best;
+		gen_algo = (char *)best->name;
+		gen_mbps = (bestgenperf * HZ * (disks-2)) >>
+			(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2);
+		xor_mbps = (bestxorperf * HZ * (disks-2)) >>
+			(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2 + 1);
 	} else
 		pr_err("raid6: Yikes!  No algorithm found!\n");
 
@@ -265,7 +328,7 @@ int __init raid6_select_algo(void)
 	gen_best = raid6_choose_gen(&dptrs, disks);
 
 	/* select raid recover functions */
-	rec_best = raid6_choose_recov();
+	rec_best = raid6_choose_recov(&dptrs, disks);
 
 	free_pages((unsigned long)disk_ptr, RAID6_TEST_DISKS_ORDER);
 
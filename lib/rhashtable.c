@@ -25,10 +25,17 @@
 #include <linux/rhashtable.h>
 #include <linux/err.h>
 #include <linux/export.h>
+#include <linux/ktime.h>
+#include <linux/cpumask.h>
+#include <linux/workqueue.h>
 
 #define HASH_DEFAULT_SIZE	64UL
 #define HASH_MIN_SIZE		4U
 
+/* Buckets of the old table per rehash worker, and the most workers used */
+#define REHASH_WORKER_BUCKETS	(1U << 16)
+#define REHASH_MAX_WORKERS	16U
+
 union nested_table {
 	union nested_table __rcu *table;
 	struct rhash_lock_head __rcu *bucket;
@@ -222,10 +229,10 @@ static struct bucket_table *rhashtable_last_table(struct rhashtable *ht,
 }
 
 static int rhashtable_rehash_one(struct rhashtable *ht,
+				 struct bucket_table *old_tbl,
 				 struct rhash_lock_head __rcu **bkt,
 				 unsigned int old_hash)
 {
-	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct bucket_table *new_tbl = rhashtable_last_table(ht, old_tbl);
 	int err = -EAGAIN;
 	struct rhash_head *head, *next, *entry;
@@ -272,23 +279,114 @@ static int rhashtable_rehash_one(struct rhashtable *ht,
 }
 
 static int rhashtable_rehash_chain(struct rhashtable *ht,
-				    unsigned int old_hash)
+				   struct bucket_table *old_tbl,
+				   unsigned int old_hash,
+				   unsigned int *max_chain)
 {
-	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct rhash_lock_head __rcu **bkt = rht_bucket_var(old_tbl, old_hash);
+	unsigned int len = 0;
 	int err;
 
 	if (!bkt)
 		return 0;
 	rht_lock(old_tbl, bkt);
 
-	while (!(err = rhashtable_rehash_one(ht, bkt, old_hash)))
-		;
+	while (!(err = rhashtable_rehash_one(ht, old_tbl, bkt, old_hash)))
+		len++;
 
 	if (err == -ENOENT)
 		err = 0;
 	rht_unlock(old_tbl, bkt);
 
+	*max_chain = max(*max_chain, len);
+	return err;
+}
+
+struct rhashtable_rehash_work {
+	struct work_struct work;
+	struct rhashtable *ht;
+	struct bucket_table *old_tbl;
+	unsigned int start;
+	unsigned int end;
+	unsigned int max_chain;
+	int err;
+};
+
+static void rhashtable_rehash_range(struct rhashtable_rehash_work *rw)
+{
+	unsigned int old_hash;
+
+	for (old_hash = rw->start; old_hash < rw->end; old_hash++) {
+		/* no ht->mutex in the helpers, future_tbl is walked under RCU */
+		rcu_read_lock();
+		rw->err = rhashtable_rehash_chain(rw->ht, rw->old_tbl, old_hash,
+						  &rw->max_chain);
+		rcu_read_unlock();
+		if (rw->err)
+			break;
+		cond_resched();
+	}
+}
+
+static void rht_rehash_worker(struct work_struct *work)
+{
+	rhashtable_rehash_range(container_of(work,
+					     struct rhashtable_rehash_work,
+					     work));
+}
+
+/*
+ * Move every chain of old_tbl to the newest table.  Large tables are split
+ * into ranges of buckets that are rehashed by unbound workers in parallel,
+ * which is safe as every chain is moved under its own bucket lock.  If the
+ * helpers cannot be allocated, the calling thread does all the work.
+ */
+static int rhashtable_rehash_buckets(struct rhashtable *ht,
+				     struct bucket_table *old_tbl,
+				     unsigned int *max_chain)
+{
+	struct rhashtable_rehash_work *works = NULL;
+	unsigned int i, nr, chunk;
+	int err = 0;
+
+	nr = min3(num_online_cpus(), old_tbl->size / REHASH_WORKER_BUCKETS,
+		  REHASH_MAX_WORKERS);
+	if (nr > 1)
+		works = kcalloc(nr, sizeof(*works), GFP_KERNEL | __GFP_NOWARN);
+	if (!works) {
+		struct rhashtable_rehash_work rw = {
+			.ht = ht,
+			.old_tbl = old_tbl,
+			.end = old_tbl->size,
+		};
+
+		rhashtable_rehash_range(&rw);
+		*max_chain = rw.max_chain;
+		return rw.err;
+	}
+
+	chunk = DIV_ROUND_UP(old_tbl->size, nr);
+	for (i = 0; i < nr; i++) {
+		works[i].ht = ht;
+		works[i].old_tbl = old_tbl;
+		works[i].start = i * chunk;
+		works[i].end = min(old_tbl->size, (i + 1) * chunk);
+		if (!i)
+			continue;
+		INIT_WORK(&works[i].work, rht_rehash_worker);
+		queue_work(system_unbound_wq, &works[i].work);
+	}
+
+	rhashtable_rehash_range(&works[0]);
+
+	for (i = 0; i < nr; i++) {
+		if (i)
+			flush_work(&works[i].work);
+		*max_chain = max(*max_chain, works[i].max_chain);
+		err = err ?: works[i].err;
+	}
+	kfree(works);
+
 	return err;
 }
 
@@ -314,19 +412,22 @@ static int rhashtable_rehash_table(struct rhashtable *ht)
 	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct bucket_table *new_tbl;
 	struct rhashtable_walker *walker;
-	unsigned int old_hash;
+	unsigned int max_chain = 0;
+	u64 start;
 	int err;
 
 	new_tbl = rht_dereference(old_tbl->future_tbl, ht);
 	if (!new_tbl)
 		return 0;
 
-	for (old_hash = 0; old_hash < old_tbl->size; old_hash++) {
-		err = rhashtable_rehash_chain(ht, old_hash);
-		if (err)
-			return err;
-		cond_resched();
-	}
+	start = ktime_get_ns();
+	err = rhashtable_rehash_buckets(ht, old_tbl, &max_chain);
+	if (err)
+		return err;
+
+	ht->stats.rehashes++;
+	ht->stats.rehash_ns = ktime_get_ns() - start;
+	ht->stats.max_chain = max_chain;
 
 	/* Publish the new table pointer. */
 	rcu_assign_pointer(ht->tbl, new_tbl);
@@ -1112,6 +1213,22 @@ static void rhashtable_free_one(struct rhashtable *ht, struct rhash_head *obj,
 	} while (list);
 }
 
+/**
+ * rhashtable_get_stats - read the resize statistics of a hash table
+ * @ht:		the hash table
+ * @stats:	filled in with the statistics of @ht
+ *
+ * Waits for a resize in progress to complete.
+ */
+void rhashtable_get_stats(struct rhashtable *ht,
+			  struct rhashtable_stats *stats)
+{
+	mutex_lock(&ht->mutex);
+	*stats = ht->stats;
+	mutex_unlock(&ht->mutex);
+}
+EXPORT_SYMBOL_GPL(rhashtable_get_stats);
+
 /**
  * rhashtable_free_and_destroy - free elements and destroy hash table
  * @ht:		the hash table to destroy
@@ -489,6 +489,51 @@ int __sbitmap_queue_get(struct sbitmap_queue *sbq)
 }
 EXPORT_SYMBOL_GPL(__sbitmap_queue_get);
 
+unsigned long __sbitmap_queue_get_batch(struct sbitmap_queue *sbq, int nr_tags,
+					unsigned int *offset)
+{
+	struct sbitmap *sb = &sbq->sb;
+	unsigned int hint, depth, index;
+	int i;
+
+	if (unlikely(sb->round_robin))
+		return 0;
+
+	depth = READ_ONCE(sb->depth);
+	hint = update_alloc_hint_before_get(sb, depth);
+	index = SB_NR_TO_INDEX(sb, hint);
+
+	for (i = 0; i < sb->map_nr; i++) {
+		struct sbitmap_word *map = &sb->map[index];
+		unsigned long mask, val, nr;
+
+		sbitmap_deferred_clear(map);
+		nr = find_first_zero_bit(&map->word, map->depth);
+		if (nr + nr_tags <= map->depth) {
+			mask = ((1UL << nr_tags) - 1) << nr;
+			val = atomic_long_fetch_or_acquire(mask,
+						(atomic_long_t *)&map->word);
+			/* keep whatever bits nobody else got first */
+			mask &= ~val;
+			if (mask) {
+				*offset = index << sb->shift;
+				hint = *offset + __fls(mask) + 1;
+				if (hint >= depth - 1)
+					hint = 0;
+				this_cpu_write(*sb->alloc_hint, hint);
+				return mask;
+			}
+		}
+
+		/* Jump to next index. */
+		if (++index >= sb->map_nr)
+			index = 0;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(__sbitmap_queue_get_batch);
+
 int __sbitmap_queue_get_shallow(struct sbitmap_queue *sbq,
 				unsigned int shallow_depth)
 {
@@ -607,6 +652,47 @@ void sbitmap_queue_clear(struct sbitmap_queue *sbq, unsigned int nr,
 }
 EXPORT_SYMBOL_GPL(sbitmap_queue_clear);
 
+void sbitmap_queue_clear_batch(struct sbitmap_queue *sbq, int offset,
+			       int *tags, int nr_tags)
+{
+	struct sbitmap *sb = &sbq->sb;
+	unsigned long *addr = NULL;
+	unsigned long mask = 0;
+	int i;
+
+	/* See sbitmap_queue_clear() for the barriers. */
+	smp_mb__before_atomic();
+	for (i = 0; i < nr_tags; i++) {
+		const int nr = tags[i] - offset;
+		unsigned long *this_addr;
+
+		/* one atomic per word for the deferred clear mask */
+		this_addr = &sb->map[SB_NR_TO_INDEX(sb, nr)].cleared;
+		if (addr && addr != this_addr) {
+			atomic_long_or(mask, (atomic_long_t *)addr);
+			mask = 0;
+		}
+		addr = this_addr;
+		mask |= 1UL << SB_NR_TO_BIT(sb, nr);
+	}
+	if (mask)
+		atomic_long_or(mask, (atomic_long_t *)addr);
+
+	smp_mb__after_atomic();
+	if (atomic_read(&sbq->ws_active)) {
+		for (i = 0; i < nr_tags; i++)
+			sbitmap_queue_wake_up(sbq);
+	}
+
+	if (likely(!sb->round_robin && nr_tags)) {
+		const int nr = tags[nr_tags - 1] - offset;
+
+		if (nr < sb->depth)
+			this_cpu_write(*sb->alloc_hint, nr);
+	}
+}
+EXPORT_SYMBOL_GPL(sbitmap_queue_clear_batch);
+
 void sbitmap_queue_wake_all(struct sbitmap_queue *sbq)
 {
 	int i, wake_index;
@@ -205,6 +205,15 @@ static void test_bucket_stats(struct rhashtable *ht, unsigned int entries)
 		pr_warn("Test failed: Total count mismatch ^^^");
 }
 
+static void test_rehash_stats(struct rhashtable *ht)
+{
+	struct rhashtable_stats stats;
+
+	rhashtable_get_stats(ht, &stats);
+	pr_info("  Rehashes: %u, last took %llu ns, longest chain moved %u\n",
+		stats.rehashes, stats.rehash_ns, stats.max_chain);
+}
+
 static s64 __init test_rhashtable(struct rhashtable *ht, struct test_obj *array,
 				  unsigned int entries)
 {
@@ -733,6 +742,7 @@ static int __init test_rht_init(void)
 		}
 
 		time = test_rhashtable(&ht, objs, entries);
+		test_rehash_stats(&ht);
 		rhashtable_destroy(&ht);
 		if (time < 0) {
 			vfree(objs);
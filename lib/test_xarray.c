@@ -401,6 +401,81 @@ static noinline void check_insert(struct xarray *xa)
 	XA_BUG_ON(xa, !xa_empty(xa));
 }
 
+static noinline void __check_insert_many(struct xarray *xa,
+		unsigned long first)
+{
+	void *entries[300];
+	unsigned int i, nr = ARRAY_SIZE(entries);
+
+	for (i = 0; i < nr; i++)
+		entries[i] = xa_mk_index(first + i);
+
+	XA_BUG_ON(xa, xa_insert_many(xa, first, entries, nr, GFP_KERNEL) != nr);
+	for (i = 0; i < nr; i++)
+		XA_BUG_ON(xa, xa_load(xa, first + i) != xa_mk_index(first + i));
+	XA_BUG_ON(xa, xa_load(xa, first + nr) != NULL);
+	if (first)
+		XA_BUG_ON(xa, xa_load(xa, first - 1) != NULL);
+
+	/* Stop at the first index which is occupied */
+	XA_BUG_ON(xa, xa_insert_many(xa, first, entries, nr, GFP_KERNEL) != 0);
+	for (i = 0; i < nr; i++)
+		if (i != 100)
+			xa_erase_index(xa, first + i);
+	XA_BUG_ON(xa, xa_insert_many(xa, first, entries, nr, GFP_KERNEL) !=
+			100);
+	for (i = 0; i <= 100; i++)
+		xa_erase_index(xa, first + i);
+	XA_BUG_ON(xa, !xa_empty(xa));
+}
+
+static noinline void check_insert_many(struct xarray *xa)
+{
+	void *entry = xa_mk_index(0);
+
+	XA_BUG_ON(xa, xa_insert_many(xa, 0, &entry, 0, GFP_KERNEL) != 0);
+	XA_BUG_ON(xa, xa_insert_many(xa, ULONG_MAX, &entry, 2, GFP_KERNEL) !=
+			-EINVAL);
+	XA_BUG_ON(xa, !xa_empty(xa));
+
+	__check_insert_many(xa, 0);
+	__check_insert_many(xa, 1);
+	__check_insert_many(xa, 63);
+	__check_insert_many(xa, 4095);
+	__check_insert_many(xa, 1UL << 24);
+}
+
+static noinline void check_insert_many_bench(struct xarray *xa)
+{
+#ifdef __KERNEL__
+	static void *entries[512];
+	unsigned int i, loop, nr = ARRAY_SIZE(entries);
+	u64 single, batched;
+	ktime_t start;
+
+	for (i = 0; i < nr; i++)
+		entries[i] = xa_mk_index(i);
+
+	start = ktime_get();
+	for (loop = 0; loop < 100; loop++) {
+		for (i = 0; i < nr; i++)
+			xa_insert(xa, i, entries[i], GFP_KERNEL);
+		xa_destroy(xa);
+	}
+	single = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	start = ktime_get();
+	for (loop = 0; loop < 100; loop++) {
+		xa_insert_many(xa, 0, entries, nr, GFP_KERNEL);
+		xa_destroy(xa);
+	}
+	batched = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	printk("XArray: inserting %u entries took %llu ns, %llu ns batched\n",
+			nr, single / 100, batched / 100);
+#endif
+}
+
 static noinline void check_cmpxchg(struct xarray *xa)
 {
 	void *FIVE = xa_mk_value(5);
@@ -1778,6 +1853,8 @@ static int xarray_checks(void)
 	check_xa_shrink(&array);
 	check_xas_erase(&array);
 	check_insert(&array);
+	check_insert_many(&array);
+	check_insert_many_bench(&array);
 	check_cmpxchg(&array);
 	check_reserve(&array);
 	check_reserve(&xa0);
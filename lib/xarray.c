@@ -364,7 +364,7 @@ static void *xas_alloc(struct xa_state *xas, unsigned int shift)
 		return NULL;
 
 	if (node) {
-		xas->xa_alloc = NULL;
+		xas->xa_alloc = rcu_dereference_raw(node->parent);
 	} else {
 		gfp_t gfp = GFP_NOWAIT | __GFP_NOWARN;
 
@@ -741,6 +741,55 @@ void xas_create_range(struct xa_state *xas)
 }
 EXPORT_SYMBOL_GPL(xas_create_range);
 
+/**
+ * xas_preload_range() - Allocate the nodes for storing a range of entries.
+ * @xas: XArray operation state, positioned at the first index.
+ * @last: Last index of the range.
+ * @gfp: Memory allocation flags.
+ *
+ * Allocates as many nodes as storing single-index entries at every index
+ * from the one in @xas to @last may need if none of them is present yet,
+ * and keeps them in @xas where xas_alloc() will find them.  This saves
+ * dropping the xa_lock to call xas_nomem() while filling a large range.
+ * Nodes which are not used are freed by the final call to xas_nomem().
+ *
+ * If an allocation fails, the nodes allocated so far are kept, and the
+ * stores allocate the rest one at a time as usual.
+ *
+ * Context: May sleep if @gfp flags permit.  Call without the xa_lock held.
+ */
+void xas_preload_range(struct xa_state *xas, unsigned long last, gfp_t gfp)
+{
+	unsigned long first = xas->xa_index;
+	unsigned long nr = 0;
+	unsigned int shift;
+
+	if (xas_error(xas) || last < first)
+		return;
+
+	/* One node per XA_CHUNK_SIZE slots at each level up to the root */
+	for (shift = XA_CHUNK_SHIFT; shift < BITS_PER_LONG;
+	     shift += XA_CHUNK_SHIFT) {
+		nr += (last >> shift) - (first >> shift) + 1;
+		if (!(last >> shift))
+			break;
+	}
+
+	if (xas->xa->xa_flags & XA_FLAGS_ACCOUNT)
+		gfp |= __GFP_ACCOUNT;
+
+	while (nr--) {
+		struct xa_node *node;
+
+		node = kmem_cache_alloc(radix_tree_node_cachep, gfp);
+		if (!node)
+			break;
+		RCU_INIT_POINTER(node->parent, xas->xa_alloc);
+		xas->xa_alloc = node;
+	}
+}
+EXPORT_SYMBOL_GPL(xas_preload_range);
+
 static void update_node(struct xa_state *xas, struct xa_node *node,
 		int count, int values)
 {
@@ -1658,6 +1707,69 @@ int __xa_insert(struct xarray *xa, unsigned long index, void *entry, gfp_t gfp)
 }
 EXPORT_SYMBOL(__xa_insert);
 
+/**
+ * xa_insert_many() - Store entries at consecutive indices if none is present.
+ * @xa: XArray.
+ * @first: Index of the first entry.
+ * @entries: Array of @nr new entries.
+ * @nr: Number of entries.
+ * @gfp: Memory allocation flags.
+ *
+ * Stores @entries[i] at index @first + i, like xa_insert(), stopping at
+ * the first index which is already occupied.  The nodes for the whole
+ * range are allocated up front, so the entries are usually all inserted
+ * under a single acquisition of the xa_lock.
+ *
+ * Context: Process context.  Takes and releases the xa_lock.  May sleep
+ * if the @gfp flags permit.
+ * Return: The number of entries inserted, which is less than @nr if an
+ * entry was present or memory ran out.  -ENOMEM if memory could not be
+ * allocated for the first entry.  -EINVAL if an entry cannot be stored
+ * in an XArray or the range wraps around.
+ */
+int xa_insert_many(struct xarray *xa, unsigned long first, void **entries,
+		unsigned int nr, gfp_t gfp)
+{
+	XA_STATE(xas, xa, first);
+	unsigned int i;
+	void *entry;
+
+	if (!nr)
+		return 0;
+	if (first + nr - 1 < first)
+		return -EINVAL;
+	for (i = 0; i < nr; i++)
+		if (WARN_ON_ONCE(xa_is_advanced(entries[i])))
+			return -EINVAL;
+
+	xas_preload_range(&xas, first + nr - 1, gfp);
+
+	i = 0;
+	do {
+		xas_lock(&xas);
+		while (i < nr) {
+			if (xas_load(&xas)) {
+				xas_set_err(&xas, -EBUSY);
+				break;
+			}
+			entry = entries[i] ? entries[i] : XA_ZERO_ENTRY;
+			xas_store(&xas, entry);
+			if (xas_error(&xas))
+				break;
+			if (xa_track_free(xa))
+				xas_clear_mark(&xas, XA_FREE_MARK);
+			if (++i < nr)
+				xas_next(&xas);
+		}
+		xas_unlock(&xas);
+	} while (xas_nomem(&xas, gfp));
+
+	if (!i && xas_error(&xas) == -ENOMEM)
+		return -ENOMEM;
+	return i;
+}
+EXPORT_SYMBOL(xa_insert_many);
+
 #ifdef CONFIG_XARRAY_MULTI
 static void xas_set_range(struct xa_state *xas, unsigned long first,
 		unsigned long last)
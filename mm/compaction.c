@@ -2620,6 +2620,16 @@ enum compact_result try_to_compact_pages(gfp_t gfp_mask, unsigned int order,
 			break;
 	}
 
+	/*
+	 * Direct compaction did not produce a page of this order, so the
+	 * next allocation will likely stall too. Have kcompactd work on
+	 * the order in the background instead of waiting for kswapd to
+	 * hand it over or for the proactive score to cross its threshold.
+	 */
+	if (rc != COMPACT_SUCCESS && ac->preferred_zoneref->zone)
+		wakeup_kcompactd(zone_pgdat(ac->preferred_zoneref->zone),
+				 order, ac->highest_zoneidx);
+
 	return rc;
 }
 
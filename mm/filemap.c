@@ -1881,6 +1881,10 @@ struct page *pagecache_get_page(struct address_space *mapping, pgoff_t index,
 			gfp_mask |= __GFP_WRITE;
 		if (fgp_flags & FGP_NOFS)
 			gfp_mask &= ~__GFP_FS;
+		if (fgp_flags & FGP_NOWAIT) {
+			gfp_mask &= ~GFP_KERNEL;
+			gfp_mask |= GFP_NOWAIT | __GFP_NOWARN;
+		}
 
 		page = __page_cache_alloc(gfp_mask);
 		if (!page)
@@ -3606,11 +3610,22 @@ struct page *grab_cache_page_write_begin(struct address_space *mapping,
 
 	if (flags & AOP_FLAG_NOFS)
 		fgp_flags |= FGP_NOFS;
+	if (flags & AOP_FLAG_NOWAIT)
+		fgp_flags |= FGP_NOWAIT;
 
 	page = pagecache_get_page(mapping, index, fgp_flags,
 			mapping_gfp_mask(mapping));
-	if (page)
-		wait_for_stable_page(page);
+	if (!page)
+		return NULL;
+
+	if ((flags & AOP_FLAG_NOWAIT) && PageWriteback(thp_head(page)) &&
+	    (mapping->host->i_sb->s_iflags & SB_I_STABLE_WRITES)) {
+		/* would have to wait for writeback to finish */
+		unlock_page(page);
+		put_page(page);
+		return NULL;
+	}
+	wait_for_stable_page(page);
 
 	return page;
 }
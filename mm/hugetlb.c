@@ -30,6 +30,8 @@
 #include <linux/numa.h>
 #include <linux/llist.h>
 #include <linux/cma.h>
+#include <linux/padata.h>
+#include <linux/ktime.h>
 
 #include <asm/page.h>
 #include <asm/pgalloc.h>
@@ -41,6 +43,7 @@
 #include <linux/node.h>
 #include <linux/page_owner.h>
 #include "internal.h"
+#include "hugetlb_vmemmap.h"
 
 int hugetlb_max_hstate __read_mostly;
 unsigned int default_hstate_idx;
@@ -1375,7 +1378,44 @@ static void remove_hugetlb_page(struct hstate *h, struct page *page,
 	h->nr_huge_pages_node[nid]--;
 }
 
-static void update_and_free_page(struct hstate *h, struct page *page)
+/*
+ * Put a page taken off the pool by remove_hugetlb_page() back, as a
+ * surplus page if @adjust_surplus.  Used when its vmemmap cannot be
+ * restored, so it cannot be freed to the buddy allocator.
+ *
+ * Must be called with hugetlb lock held.
+ */
+static void add_hugetlb_page(struct hstate *h, struct page *page,
+			     bool adjust_surplus)
+{
+	int nid = page_to_nid(page);
+
+	VM_BUG_ON_PAGE(!HPageVmemmapOptimized(page), page);
+
+	lockdep_assert_held(&hugetlb_lock);
+
+	INIT_LIST_HEAD(&page->lru);
+	h->nr_huge_pages++;
+	h->nr_huge_pages_node[nid]++;
+
+	if (adjust_surplus) {
+		h->surplus_huge_pages++;
+		h->surplus_huge_pages_node[nid]++;
+	}
+
+	set_compound_page_dtor(page, HUGETLB_PAGE_DTOR);
+
+	/*
+	 * This page is now managed by the hugetlb allocator and has
+	 * no users -- drop the last reference.
+	 */
+	if (put_page_testzero(page)) {
+		arch_clear_hugepage_flags(page);
+		enqueue_huge_page(h, page);
+	}
+}
+
+static void __update_and_free_page(struct hstate *h, struct page *page)
 {
 	int i;
 	struct page *subpage = page;
@@ -1383,6 +1423,19 @@ static void update_and_free_page(struct hstate *h, struct page *page)
 	if (hstate_is_gigantic(h) && !gigantic_page_runtime_supported())
 		return;
 
+	/* The tail page structs must be writable again before we free */
+	if (alloc_huge_page_vmemmap(h, page)) {
+		spin_lock_irq(&hugetlb_lock);
+		/*
+		 * If we cannot allocate vmemmap pages, just refuse to free the
+		 * page and put the page back on the hugetlb free list and treat
+		 * as a surplus page.
+		 */
+		add_hugetlb_page(h, page, true);
+		spin_unlock_irq(&hugetlb_lock);
+		return;
+	}
+
 	for (i = 0; i < pages_per_huge_page(h);
 	     i++, subpage = mem_map_next(subpage, page, i)) {
 		subpage->flags &= ~(1 << PG_locked | 1 << PG_error |
@@ -1398,12 +1451,74 @@ static void update_and_free_page(struct hstate *h, struct page *page)
 	}
 }
 
+/*
+ * Restoring the vmemmap of a page may sleep, which free_huge_page() can't.
+ * Pages whose vmemmap was freed are passed to a workqueue from there,
+ * linked through page->mapping, which is unused by freed huge pages and
+ * lives in the writable head page struct.
+ */
+static LLIST_HEAD(hpage_freelist);
+
+static void free_hpage_workfn(struct work_struct *work)
+{
+	struct llist_node *node;
+
+	node = llist_del_all(&hpage_freelist);
+
+	while (node) {
+		struct page *page;
+		struct hstate *h;
+
+		page = container_of((struct address_space **)node,
+				     struct page, mapping);
+		node = node->next;
+		page->mapping = NULL;
+		/*
+		 * The VM_BUG_ON_PAGE(!PageHuge(page), page) in page_hstate()
+		 * is going to trigger because a previous call to
+		 * remove_hugetlb_page() will set_compound_page_dtor(page,
+		 * NULL_COMPOUND_DTOR), so do not use page_hstate() directly.
+		 */
+		h = size_to_hstate(page_size(page));
+
+		__update_and_free_page(h, page);
+
+		cond_resched();
+	}
+}
+static DECLARE_WORK(free_hpage_work, free_hpage_workfn);
+
+static inline void flush_free_hpage_work(struct hstate *h)
+{
+	if (free_vmemmap_pages_per_hpage(h))
+		flush_work(&free_hpage_work);
+}
+
+static void update_and_free_page(struct hstate *h, struct page *page,
+				 bool atomic)
+{
+	if (!HPageVmemmapOptimized(page) || !atomic) {
+		__update_and_free_page(h, page);
+		return;
+	}
+
+	/*
+	 * Defer freeing to avoid using GFP_ATOMIC to allocate vmemmap pages.
+	 *
+	 * Only call schedule_work() if hpage_freelist is previously
+	 * empty. Otherwise, schedule_work() had been called but the workfn
+	 * hasn't retrieved the list yet.
+	 */
+	if (llist_add((struct llist_node *)&page->mapping, &hpage_freelist))
+		schedule_work(&free_hpage_work);
+}
+
 static void update_and_free_pages_bulk(struct hstate *h, struct list_head *list)
 {
 	struct page *page, *t_page;
 
 	list_for_each_entry_safe(page, t_page, list, lru) {
-		update_and_free_page(h, page);
+		update_and_free_page(h, page, false);
 		cond_resched();
 	}
 }
@@ -1470,12 +1585,12 @@ void free_huge_page(struct page *page)
 	if (HPageTemporary(page)) {
 		remove_hugetlb_page(h, page, false);
 		spin_unlock_irqrestore(&hugetlb_lock, flags);
-		update_and_free_page(h, page);
+		update_and_free_page(h, page, true);
 	} else if (h->surplus_huge_pages_node[nid]) {
 		/* remove the page from active list */
 		remove_hugetlb_page(h, page, true);
 		spin_unlock_irqrestore(&hugetlb_lock, flags);
-		update_and_free_page(h, page);
+		update_and_free_page(h, page, true);
 	} else {
 		arch_clear_hugepage_flags(page);
 		enqueue_huge_page(h, page);
@@ -1493,8 +1608,9 @@ static void __prep_account_new_huge_page(struct hstate *h, int nid)
 	h->nr_huge_pages_node[nid]++;
 }
 
-static void __prep_new_huge_page(struct page *page)
+static void __prep_new_huge_page(struct hstate *h, struct page *page)
 {
+	free_huge_page_vmemmap(h, page);
 	INIT_LIST_HEAD(&page->lru);
 	set_compound_page_dtor(page, HUGETLB_PAGE_DTOR);
 	hugetlb_set_page_subpool(page, NULL);
@@ -1504,7 +1620,7 @@ static void __prep_new_huge_page(struct page *page)
 
 static void prep_new_huge_page(struct hstate *h, struct page *page, int nid)
 {
-	__prep_new_huge_page(page);
+	__prep_new_huge_page(h, page);
 	spin_lock_irq(&hugetlb_lock);
 	__prep_account_new_huge_page(h, nid);
 	spin_unlock_irq(&hugetlb_lock);
@@ -1782,19 +1898,37 @@ int dissolve_free_huge_page(struct page *page)
 			goto retry;
 		}
 
-		/*
-		 * Move PageHWPoison flag from head page to the raw error page,
-		 * which makes any subpages rather than the error page reusable.
-		 */
-		if (PageHWPoison(head) && page != head) {
-			SetPageHWPoison(page);
-			ClearPageHWPoison(head);
-		}
 		remove_hugetlb_page(h, head, false);
 		h->max_huge_pages--;
 		spin_unlock_irq(&hugetlb_lock);
-		update_and_free_page(h, head);
-		return 0;
+
+		/*
+		 * Normally update_and_free_page() will allocate required vmemmap
+		 * before freeing the page, and put the page back in the pool if
+		 * it can't.  Do it here, so that we can fail and account for
+		 * the page staying instead.
+		 */
+		rc = alloc_huge_page_vmemmap(h, head);
+		if (!rc) {
+			/*
+			 * Move PageHWPoison flag from head page to the raw
+			 * error page, which makes any subpages rather than
+			 * the error page reusable.  The tail page structs
+			 * are only writable now.
+			 */
+			if (PageHWPoison(head) && page != head) {
+				SetPageHWPoison(page);
+				ClearPageHWPoison(head);
+			}
+			update_and_free_page(h, head, false);
+		} else {
+			spin_lock_irq(&hugetlb_lock);
+			add_hugetlb_page(h, head, false);
+			h->max_huge_pages++;
+			spin_unlock_irq(&hugetlb_lock);
+		}
+
+		return rc;
 	}
 out:
 	spin_unlock_irq(&hugetlb_lock);
@@ -2359,6 +2493,8 @@ static int alloc_and_dissolve_huge_page(struct hstate *h, struct page *old_page,
 	new_page = alloc_buddy_huge_page(h, gfp_mask, nid, NULL, NULL);
 	if (!new_page)
 		return -ENOMEM;
+	/* May sleep, so do it before taking hugetlb_lock */
+	__prep_new_huge_page(h, new_page);
 
 retry:
 	spin_lock_irq(&hugetlb_lock);
@@ -2397,14 +2533,12 @@ static int alloc_and_dissolve_huge_page(struct hstate *h, struct page *old_page,
 		remove_hugetlb_page(h, old_page, false);
 
 		/*
-		 * new_page needs to be initialized with the standard hugetlb
-		 * state. This is normally done by prep_new_huge_page() but
-		 * that takes hugetlb_lock which is already held so we need to
-		 * open code it here.
+		 * new_page was initialized with the standard hugetlb state
+		 * above, but prep_new_huge_page() would take hugetlb_lock which
+		 * is already held so we need to open code the accounting here.
 		 * Reference count trick is needed because allocator gives us
 		 * referenced page but the pool requires pages with 0 refcount.
 		 */
-		__prep_new_huge_page(new_page);
 		__prep_account_new_huge_page(h, nid);
 		page_ref_dec(new_page);
 		enqueue_huge_page(h, new_page);
@@ -2413,14 +2547,15 @@ static int alloc_and_dissolve_huge_page(struct hstate *h, struct page *old_page,
 		 * Pages have been replaced, we can safely free the old one.
 		 */
 		spin_unlock_irq(&hugetlb_lock);
-		update_and_free_page(h, old_page);
+		update_and_free_page(h, old_page, false);
 	}
 
 	return ret;
 
 free_new:
 	spin_unlock_irq(&hugetlb_lock);
-	__free_pages(new_page, huge_page_order(h));
+	set_compound_page_dtor(new_page, NULL_COMPOUND_DTOR);
+	update_and_free_page(h, new_page, false);
 
 	return ret;
 }
@@ -2635,14 +2770,27 @@ static void __init prep_compound_huge_page(struct page *page,
 }
 
 /* Put bootmem huge pages into the standard lists after mem_map is up */
-static void __init gather_bootmem_prealloc(void)
+/*
+ * Preparing a gigantic page touches every one of its struct pages, so the
+ * pages are handed out to padata threads in chunks of this many.
+ */
+#define HUGETLB_BOOT_PREP_CHUNK	8
+
+static void __init gather_bootmem_prealloc_range(unsigned long start,
+						 unsigned long end, void *arg)
 {
 	struct huge_bootmem_page *m;
+	unsigned long i = 0;
 
 	list_for_each_entry(m, &huge_boot_pages, list) {
 		struct page *page = virt_to_page(m);
 		struct hstate *h = m->hstate;
 
+		if (i++ < start)
+			continue;
+		if (i > end)
+			break;
+
 		WARN_ON(page_count(page) != 1);
 		prep_compound_huge_page(page, huge_page_order(h));
 		WARN_ON(PageReserved(page));
@@ -2661,10 +2809,110 @@ static void __init gather_bootmem_prealloc(void)
 	}
 }
 
+static void __init gather_bootmem_prealloc(void)
+{
+	struct padata_mt_job job = {
+		.thread_fn	= gather_bootmem_prealloc_range,
+		.min_chunk	= HUGETLB_BOOT_PREP_CHUNK,
+		.max_threads	= num_online_cpus(),
+	};
+	struct list_head *pos;
+	ktime_t start = ktime_get();
+
+	list_for_each(pos, &huge_boot_pages)
+		job.size++;
+	if (!job.size)
+		return;
+
+	/*
+	 * The list is only read here; page preparation and pool accounting
+	 * take hugetlb_lock where they need it.
+	 */
+	if (IS_ENABLED(CONFIG_PADATA) && job.size > job.min_chunk)
+		padata_do_multithreaded(&job);
+	else
+		gather_bootmem_prealloc_range(0, job.size, NULL);
+
+	pr_info("HugeTLB: prepared %lu boot time pages in %lld ms\n",
+		job.size, ktime_ms_delta(ktime_get(), start));
+}
+
+/*
+ * Boot time allocation of the pool of a non-gigantic hstate: each padata
+ * work fills the share of one node with __GFP_THISNODE allocations, so
+ * the struct page and page table work happens on the node it belongs to.
+ */
+struct hugetlb_boot_alloc {
+	struct hstate *h;
+	nodemask_t *node_alloc_noretry;
+	unsigned long per_node;
+	atomic_long_t remaining;
+};
+
+static void __init hugetlb_alloc_node_pages(unsigned long start,
+					    unsigned long end, void *arg)
+{
+	struct hugetlb_boot_alloc *ba = arg;
+	struct hstate *h = ba->h;
+	gfp_t gfp_mask = htlb_alloc_mask(h) | __GFP_THISNODE;
+	unsigned long nid, i;
+
+	for (nid = start; nid < end; nid++) {
+		if (!node_state(nid, N_MEMORY))
+			continue;
+
+		for (i = 0; i < ba->per_node; i++) {
+			struct page *page;
+
+			if (atomic_long_dec_if_positive(&ba->remaining) < 0)
+				return;
+
+			page = alloc_fresh_huge_page(h, gfp_mask, nid,
+						     &node_states[N_MEMORY],
+						     ba->node_alloc_noretry);
+			if (!page) {
+				atomic_long_inc(&ba->remaining);
+				break;
+			}
+			put_page(page); /* free it into the pool */
+			cond_resched();
+		}
+	}
+}
+
+/* Returns the number of pages allocated */
+static unsigned long __init hugetlb_alloc_pool_parallel(struct hstate *h,
+					nodemask_t *node_alloc_noretry)
+{
+	struct hugetlb_boot_alloc ba = {
+		.h			= h,
+		.node_alloc_noretry	= node_alloc_noretry,
+	};
+	struct padata_mt_job job = {
+		.thread_fn	= hugetlb_alloc_node_pages,
+		.fn_arg		= &ba,
+		.start		= 0,
+		.size		= nr_node_ids,
+		.min_chunk	= 1,
+		.max_threads	= nr_node_ids,
+	};
+	unsigned int nr_nodes = num_node_state(N_MEMORY);
+
+	if (!IS_ENABLED(CONFIG_PADATA) || nr_nodes < 2 || !h->max_huge_pages)
+		return 0;
+
+	ba.per_node = DIV_ROUND_UP(h->max_huge_pages, nr_nodes);
+	atomic_long_set(&ba.remaining, h->max_huge_pages);
+	padata_do_multithreaded(&job);
+
+	return h->max_huge_pages - atomic_long_read(&ba.remaining);
+}
+
 static void __init hugetlb_hstate_alloc_pages(struct hstate *h)
 {
-	unsigned long i;
+	unsigned long i = 0;
 	nodemask_t *node_alloc_noretry;
+	ktime_t start = ktime_get();
 
 	if (!hstate_is_gigantic(h)) {
 		/*
@@ -2684,7 +2932,14 @@ static void __init hugetlb_hstate_alloc_pages(struct hstate *h)
 	if (node_alloc_noretry)
 		nodes_clear(*node_alloc_noretry);
 
-	for (i = 0; i < h->max_huge_pages; ++i) {
+	/*
+	 * Spread the pool over the nodes in parallel first.  Whatever a node
+	 * could not provide is then taken round-robin from the others.
+	 */
+	if (!hstate_is_gigantic(h))
+		i = hugetlb_alloc_pool_parallel(h, node_alloc_noretry);
+
+	for (; i < h->max_huge_pages; ++i) {
 		if (hstate_is_gigantic(h)) {
 			if (hugetlb_cma_size) {
 				pr_warn_once("HugeTLB: hugetlb_cma is enabled, skip boot time allocation\n");
@@ -2706,6 +2961,10 @@ static void __init hugetlb_hstate_alloc_pages(struct hstate *h)
 			h->max_huge_pages, buf, i);
 		h->max_huge_pages = i;
 	}
+	if (!hstate_is_gigantic(h))
+		pr_info("HugeTLB: allocated %lu pages of order %u in %lld ms\n",
+			i, huge_page_order(h),
+			ktime_ms_delta(ktime_get(), start));
 free:
 	kfree(node_alloc_noretry);
 }
@@ -2834,6 +3093,8 @@ static int set_max_huge_pages(struct hstate *h, unsigned long count, int nid,
 	 * pages in hstate via the proc/sysfs interfaces.
 	 */
 	mutex_lock(&h->resize_lock);
+	/* Let deferred frees from free_huge_page() reach the pool counts */
+	flush_free_hpage_work(h);
 	spin_lock_irq(&hugetlb_lock);
 
 	/*
@@ -3450,6 +3711,7 @@ void __init hugetlb_add_hstate(unsigned int order)
 	h->next_nid_to_free = first_memory_node;
 	snprintf(h->name, HSTATE_NAME_LEN, "hugepages-%lukB",
 					huge_page_size(h)/1024);
+	hugetlb_vmemmap_init(h);
 
 	parsed_hstate = h;
 }
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Free some vmemmap pages of HugeTLB
+ *
+ * The struct page structures (page structs) are used to describe a physical
+ * page frame. By default, there is a one-to-one mapping from a page frame to
+ * its corresponding page struct.
+ *
+ * HugeTLB pages consist of multiple base page size pages and are supported by
+ * many architectures. When the system boots or a HugeTLB page is allocated at
+ * runtime, the page structs of all its base pages are in use, yet only the
+ * first few of them carry any information: the head page and the first tail
+ * pages hold the compound page metadata, and every other tail page holds
+ * exactly the same content (a pointer to the head and the same flags).
+ *
+ * With sizeof(struct page) == 64 and 4KB base pages, a 2MB HugeTLB page uses
+ * 8 pages of vmemmap and a 1GB HugeTLB page uses 4096 pages. We keep the
+ * first RESERVE_VMEMMAP_NR vmemmap pages, remap all the others read-only to
+ * the last reserved one, and give them back to the buddy allocator:
+ *
+ *    HugeTLB                  struct pages(8 pages)         page frame(8 pages)
+ * +-----------+ ---virt_to_page---> +-----------+   mapping to   +-----------+
+ * |           |                     |     0     | -------------> |     0     |
+ * |           |                     +-----------+                +-----------+
+ * |           |                     |     1     | -------------> |     1     |
+ * |           |                     +-----------+                +-----------+
+ * |           |                     |     2     | -------------> |     1     |
+ * |           |                     +-----------+    (RO)        +-----------+
+ * |           |                     |    ...    | -------------> |     1     |
+ * |           |                     +-----------+    (RO)        +-----------+
+ * |           |                     |     7     | -------------> |     1     |
+ * +-----------+                     +-----------+    (RO)        +-----------+
+ *
+ * That saves 6 of 8 vmemmap pages (24KB) per 2MB HugeTLB page and 4094 of
+ * 4096 (about 16MB) per 1GB HugeTLB page. When a HugeTLB page is freed back
+ * to the buddy allocator, its vmemmap must be allocated and remapped again
+ * first, which can fail; the page then stays in the pool as a surplus page.
+ *
+ * The vmemmap of a HugeTLB page is split from PMD to PTE mappings the first
+ * time it is optimized and never merged back.
+ *
+ * This is disabled by default and enabled with "hugetlb_free_vmemmap=on".
+ */
+#define pr_fmt(fmt)	"HugeTLB: " fmt
+
+#include "hugetlb_vmemmap.h"
+
+/*
+ * The first vmemmap page holds the head and the tail pages that carry
+ * compound page metadata; the second one only holds plain tail pages and
+ * is the one all further vmemmap pages of the HugeTLB page get mapped to.
+ */
+#define RESERVE_VMEMMAP_NR		2U
+#define RESERVE_VMEMMAP_SIZE		(RESERVE_VMEMMAP_NR << PAGE_SHIFT)
+
+static bool hugetlb_free_vmemmap_enabled __initdata;
+
+static int __init early_hugetlb_free_vmemmap_param(char *buf)
+{
+	if (!buf)
+		return -EINVAL;
+
+	if (!strcmp(buf, "on"))
+		hugetlb_free_vmemmap_enabled = true;
+	else if (!strcmp(buf, "off"))
+		hugetlb_free_vmemmap_enabled = false;
+	else
+		return -EINVAL;
+
+	return 0;
+}
+early_param("hugetlb_free_vmemmap", early_hugetlb_free_vmemmap_param);
+
+static inline unsigned long free_vmemmap_pages_size_per_hpage(struct hstate *h)
+{
+	return (unsigned long)free_vmemmap_pages_per_hpage(h) << PAGE_SHIFT;
+}
+
+/*
+ * Allocate and map back the vmemmap pages previously freed for @head.
+ * Returns zero on success, or if @head was never optimized.
+ */
+int alloc_huge_page_vmemmap(struct hstate *h, struct page *head)
+{
+	int ret;
+	unsigned long vmemmap_addr = (unsigned long)head;
+	unsigned long vmemmap_end, vmemmap_reuse;
+
+	if (!HPageVmemmapOptimized(head))
+		return 0;
+
+	vmemmap_addr += RESERVE_VMEMMAP_SIZE;
+	vmemmap_end = vmemmap_addr + free_vmemmap_pages_size_per_hpage(h);
+	vmemmap_reuse = vmemmap_addr - PAGE_SIZE;
+	ret = vmemmap_remap_alloc(vmemmap_addr, vmemmap_end, vmemmap_reuse,
+				  GFP_KERNEL | __GFP_NORETRY | __GFP_THISNODE);
+
+	if (!ret)
+		ClearHPageVmemmapOptimized(head);
+
+	return ret;
+}
+
+void free_huge_page_vmemmap(struct hstate *h, struct page *head)
+{
+	unsigned long vmemmap_addr = (unsigned long)head;
+	unsigned long vmemmap_end, vmemmap_reuse;
+
+	if (!free_vmemmap_pages_per_hpage(h))
+		return;
+
+	vmemmap_addr += RESERVE_VMEMMAP_SIZE;
+	vmemmap_end = vmemmap_addr + free_vmemmap_pages_size_per_hpage(h);
+	vmemmap_reuse = vmemmap_addr - PAGE_SIZE;
+
+	/*
+	 * Remap the vmemmap virtual address range [@vmemmap_addr, @vmemmap_end)
+	 * to the page which @vmemmap_reuse is mapped to, then free the pages
+	 * which the range [@vmemmap_addr, @vmemmap_end) is mapped to.
+	 */
+	if (!vmemmap_remap_free(vmemmap_addr, vmemmap_end, vmemmap_reuse))
+		SetHPageVmemmapOptimized(head);
+}
+
+void __init hugetlb_vmemmap_init(struct hstate *h)
+{
+	unsigned int nr_pages = pages_per_huge_page(h);
+	unsigned int vmemmap_pages;
+
+	/*
+	 * Identical tail page structs only fill whole vmemmap pages if
+	 * struct page size is a power of two.
+	 */
+	if (!hugetlb_free_vmemmap_enabled ||
+	    !is_power_of_2(sizeof(struct page)))
+		return;
+
+	vmemmap_pages = (nr_pages * sizeof(struct page)) >> PAGE_SHIFT;
+	/* Small HugeTLB pages may not use more vmemmap than we reserve */
+	if (likely(vmemmap_pages > RESERVE_VMEMMAP_NR))
+		h->nr_free_vmemmap_pages = vmemmap_pages - RESERVE_VMEMMAP_NR;
+
+	pr_info("can free %d vmemmap pages for %s\n", h->nr_free_vmemmap_pages,
+		h->name);
+}
@@ -37,6 +37,9 @@ struct mm_struct init_mm = {
 	.arg_lock	=  __SPIN_LOCK_UNLOCKED(init_mm.arg_lock),
 	.mmlist		= LIST_HEAD_INIT(init_mm.mmlist),
 	.user_ns	= &init_user_ns,
+#ifdef CONFIG_MEMBARRIER
+	.membarrier_mutex = __MUTEX_INITIALIZER(init_mm.membarrier_mutex),
+#endif
 	.cpu_bitmap	= CPU_BITS_NONE,
 	INIT_MM_CONTEXT(init_mm)
 };
@@ -1133,6 +1133,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 	if (mm_find_pmd(mm, address) != pmd)
 		goto out_up_write;
 
+	vma_start_write(vma);
 	anon_vma_lock_write(vma->anon_vma);
 
 	mmu_notifier_range_init(&range, MMU_NOTIFY_CLEAR, 0, NULL, mm,
@@ -1220,7 +1221,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 static int khugepaged_scan_pmd(struct mm_struct *mm,
 			       struct vm_area_struct *vma,
 			       unsigned long address,
-			       struct page **hpage)
+			       struct page **hpage, bool check_young)
 {
 	pmd_t *pmd;
 	pte_t *pte, *_pte;
@@ -1354,7 +1355,8 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 	}
 	if (!writable) {
 		result = SCAN_PAGE_RO;
-	} else if (!referenced || (unmapped && referenced < HPAGE_PMD_NR/2)) {
+	} else if (check_young &&
+		   (!referenced || (unmapped && referenced < HPAGE_PMD_NR/2))) {
 		result = SCAN_LACK_REFERENCED_PAGE;
 	} else {
 		result = SCAN_SUCCEED;
@@ -1374,6 +1376,63 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 	return ret;
 }
 
+/*
+ * MADV_COLLAPSE: synchronously collapse the anonymous memory in
+ * [start, end) into huge pages, instead of waiting for khugepaged to
+ * get there. The same limits on none, swap and shared ptes apply, but
+ * the range is collapsed whether or not it was recently referenced.
+ * This is best effort: ranges that cannot be collapsed are skipped.
+ *
+ * Called with mmap_lock held for read, which may be dropped; *prev is
+ * then cleared to tell madvise to look the vma up again.
+ */
+int madvise_collapse(struct vm_area_struct *vma, struct vm_area_struct **prev,
+		     unsigned long start, unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct page *hpage = NULL;
+	unsigned long hstart, hend, addr;
+	bool wait = false;
+	int ret = 0;
+
+	*prev = vma;
+	if (vma->vm_ops || !hugepage_vma_check(vma, vma->vm_flags))
+		return -EINVAL;
+	/* Never faulted in, nothing to collapse */
+	if (!vma->anon_vma)
+		return 0;
+
+	hstart = (max(start, vma->vm_start) + ~HPAGE_PMD_MASK) & HPAGE_PMD_MASK;
+	hend = min(end, vma->vm_end) & HPAGE_PMD_MASK;
+
+	for (addr = hstart; addr < hend; addr += HPAGE_PMD_SIZE) {
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			break;
+		}
+		if (!khugepaged_prealloc_page(&hpage, &wait)) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		if (!khugepaged_scan_pmd(mm, vma, addr, &hpage, false))
+			continue;
+
+		/* collapse_huge_page() returned with mmap_lock released */
+		*prev = NULL;
+		mmap_read_lock(mm);
+		if (addr + HPAGE_PMD_SIZE >= hend ||
+		    hugepage_vma_revalidate(mm, addr + HPAGE_PMD_SIZE, &vma))
+			break;
+		hend = min(end, vma->vm_end) & HPAGE_PMD_MASK;
+	}
+
+	if (!IS_ERR_OR_NULL(hpage))
+		put_page(hpage);
+
+	return ret;
+}
+
 static void collect_mm_slot(struct mm_slot *mm_slot)
 {
 	struct mm_struct *mm = mm_slot->mm;
@@ -2136,7 +2195,7 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 			} else {
 				ret = khugepaged_scan_pmd(mm, vma,
 						khugepaged_scan.address,
-						hpage);
+						hpage, true);
 			}
 			/* move to next address */
 			khugepaged_scan.address += HPAGE_PMD_SIZE;
@@ -62,6 +62,7 @@
 #include <linux/tracehook.h>
 #include <linux/psi.h>
 #include <linux/seq_buf.h>
+#include <linux/parser.h>
 #include "internal.h"
 #include <net/sock.h>
 #include <net/ip.h>
@@ -631,6 +632,65 @@ mem_cgroup_largest_soft_limit_node(struct mem_cgroup_tree_per_node *mctz)
 	return mz;
 }
 
+/*
+ * memcg and lruvec stats flushing
+ *
+ * Readers of the hierarchical stats used to flush the rstat tree of their
+ * cgroup on every read, serializing on cgroup_rstat_lock against each other
+ * and against reclaim.  Instead:
+ *
+ * 1) The whole tree is flushed asynchronously every FLUSH_TIME, so that the
+ *    rstat update tree does not grow unbounded and stats are never staler
+ *    than that.
+ *
+ * 2) Readers flush synchronously only when more than roughly
+ *    MEMCG_CHARGE_BATCH * nr_cpus stat updates have happened since the
+ *    last flush, and only one of them does, the others read what's there.
+ */
+#define FLUSH_TIME (2UL*HZ)
+
+static void flush_memcg_stats_dwork(struct work_struct *w);
+static DECLARE_DEFERRABLE_WORK(stats_flush_dwork, flush_memcg_stats_dwork);
+static DEFINE_PER_CPU(unsigned int, stats_updates);
+static atomic_t stats_flush_threshold = ATOMIC_INIT(0);
+static atomic_t stats_flush_ongoing = ATOMIC_INIT(0);
+
+static inline void memcg_rstat_updated(struct mem_cgroup *memcg)
+{
+	cgroup_rstat_updated(memcg->css.cgroup, smp_processor_id());
+	if (!(__this_cpu_inc_return(stats_updates) % MEMCG_CHARGE_BATCH))
+		atomic_inc(&stats_flush_threshold);
+}
+
+static void __mem_cgroup_flush_stats(void)
+{
+	if (atomic_read(&stats_flush_ongoing) ||
+	    atomic_xchg(&stats_flush_ongoing, 1))
+		return;
+
+	atomic_set(&stats_flush_threshold, 0);
+	cgroup_rstat_flush(root_mem_cgroup->css.cgroup);
+	atomic_set(&stats_flush_ongoing, 0);
+}
+
+/**
+ * mem_cgroup_flush_stats - bring the hierarchical memcg stats up to date
+ *
+ * Flushes only if enough updates accumulated since the last flush, so the
+ * stats read afterwards may lag behind by a bounded amount.  May sleep.
+ */
+void mem_cgroup_flush_stats(void)
+{
+	if (atomic_read(&stats_flush_threshold) > num_online_cpus())
+		__mem_cgroup_flush_stats();
+}
+
+static void flush_memcg_stats_dwork(struct work_struct *w)
+{
+	__mem_cgroup_flush_stats();
+	queue_delayed_work(system_unbound_wq, &stats_flush_dwork, FLUSH_TIME);
+}
+
 /**
  * __mod_memcg_state - update cgroup memory statistics
  * @memcg: the memory cgroup
@@ -643,7 +703,7 @@ void __mod_memcg_state(struct mem_cgroup *memcg, int idx, int val)
 		return;
 
 	__this_cpu_add(memcg->vmstats_percpu->state[idx], val);
-	cgroup_rstat_updated(memcg->css.cgroup, smp_processor_id());
+	memcg_rstat_updated(memcg);
 }
 
 /* idx can be of type enum memcg_stat_item or node_stat_item. */
@@ -795,7 +855,7 @@ void __count_memcg_events(struct mem_cgroup *memcg, enum vm_event_item idx,
 		return;
 
 	__this_cpu_add(memcg->vmstats_percpu->events[idx], count);
-	cgroup_rstat_updated(memcg->css.cgroup, smp_processor_id());
+	memcg_rstat_updated(memcg);
 }
 
 static unsigned long memcg_events(struct mem_cgroup *memcg, int event)
@@ -1398,15 +1458,11 @@ static inline unsigned long memcg_page_state_output(struct mem_cgroup *memcg,
 	return memcg_page_state(memcg, item) * memcg_page_state_unit(item);
 }
 
-static char *memory_stat_format(struct mem_cgroup *memcg)
+/* The caller is responsible for flushing the stats beforehand */
+static void memory_stat_format(struct mem_cgroup *memcg, struct seq_buf *s)
 {
-	struct seq_buf s;
 	int i;
 
-	seq_buf_init(&s, kmalloc(PAGE_SIZE, GFP_KERNEL), PAGE_SIZE);
-	if (!s.buffer)
-		return NULL;
-
 	/*
 	 * Provide statistics on the state of the memory subsystem as
 	 * well as cumulative event counters that show past behavior.
@@ -1417,55 +1473,51 @@ static char *memory_stat_format(struct mem_cgroup *memcg)
 	 *
 	 * Current memory state:
 	 */
-	cgroup_rstat_flush(memcg->css.cgroup);
-
 	for (i = 0; i < ARRAY_SIZE(memory_stats); i++) {
 		u64 size;
 
 		size = memcg_page_state_output(memcg, memory_stats[i].idx);
-		seq_buf_printf(&s, "%s %llu\n", memory_stats[i].name, size);
+		seq_buf_printf(s, "%s %llu\n", memory_stats[i].name, size);
 
 		if (unlikely(memory_stats[i].idx == NR_SLAB_UNRECLAIMABLE_B)) {
 			size += memcg_page_state_output(memcg,
 							NR_SLAB_RECLAIMABLE_B);
-			seq_buf_printf(&s, "slab %llu\n", size);
+			seq_buf_printf(s, "slab %llu\n", size);
 		}
 	}
 
 	/* Accumulated memory events */
 
-	seq_buf_printf(&s, "%s %lu\n", vm_event_name(PGFAULT),
+	seq_buf_printf(s, "%s %lu\n", vm_event_name(PGFAULT),
 		       memcg_events(memcg, PGFAULT));
-	seq_buf_printf(&s, "%s %lu\n", vm_event_name(PGMAJFAULT),
+	seq_buf_printf(s, "%s %lu\n", vm_event_name(PGMAJFAULT),
 		       memcg_events(memcg, PGMAJFAULT));
-	seq_buf_printf(&s, "%s %lu\n",  vm_event_name(PGREFILL),
+	seq_buf_printf(s, "%s %lu\n",  vm_event_name(PGREFILL),
 		       memcg_events(memcg, PGREFILL));
-	seq_buf_printf(&s, "pgscan %lu\n",
+	seq_buf_printf(s, "pgscan %lu\n",
 		       memcg_events(memcg, PGSCAN_KSWAPD) +
 		       memcg_events(memcg, PGSCAN_DIRECT));
-	seq_buf_printf(&s, "pgsteal %lu\n",
+	seq_buf_printf(s, "pgsteal %lu\n",
 		       memcg_events(memcg, PGSTEAL_KSWAPD) +
 		       memcg_events(memcg, PGSTEAL_DIRECT));
-	seq_buf_printf(&s, "%s %lu\n", vm_event_name(PGACTIVATE),
+	seq_buf_printf(s, "%s %lu\n", vm_event_name(PGACTIVATE),
 		       memcg_events(memcg, PGACTIVATE));
-	seq_buf_printf(&s, "%s %lu\n", vm_event_name(PGDEACTIVATE),
+	seq_buf_printf(s, "%s %lu\n", vm_event_name(PGDEACTIVATE),
 		       memcg_events(memcg, PGDEACTIVATE));
-	seq_buf_printf(&s, "%s %lu\n", vm_event_name(PGLAZYFREE),
+	seq_buf_printf(s, "%s %lu\n", vm_event_name(PGLAZYFREE),
 		       memcg_events(memcg, PGLAZYFREE));
-	seq_buf_printf(&s, "%s %lu\n", vm_event_name(PGLAZYFREED),
+	seq_buf_printf(s, "%s %lu\n", vm_event_name(PGLAZYFREED),
 		       memcg_events(memcg, PGLAZYFREED));
 
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
-	seq_buf_printf(&s, "%s %lu\n", vm_event_name(THP_FAULT_ALLOC),
+	seq_buf_printf(s, "%s %lu\n", vm_event_name(THP_FAULT_ALLOC),
 		       memcg_events(memcg, THP_FAULT_ALLOC));
-	seq_buf_printf(&s, "%s %lu\n", vm_event_name(THP_COLLAPSE_ALLOC),
+	seq_buf_printf(s, "%s %lu\n", vm_event_name(THP_COLLAPSE_ALLOC),
 		       memcg_events(memcg, THP_COLLAPSE_ALLOC));
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE */
 
 	/* The above should easily fit into one page */
-	WARN_ON_ONCE(seq_buf_has_overflowed(&s));
-
-	return s.buffer;
+	WARN_ON_ONCE(seq_buf_has_overflowed(s));
 }
 
 #define K(x) ((x) << (PAGE_SHIFT-10))
@@ -1501,6 +1553,7 @@ void mem_cgroup_print_oom_context(struct mem_cgroup *memcg, struct task_struct *
  */
 void mem_cgroup_print_oom_meminfo(struct mem_cgroup *memcg)
 {
+	struct seq_buf s;
 	char *buf;
 
 	pr_info("memory: usage %llukB, limit %llukB, failcnt %lu\n",
@@ -1522,9 +1575,13 @@ void mem_cgroup_print_oom_meminfo(struct mem_cgroup *memcg)
 	pr_info("Memory cgroup stats for ");
 	pr_cont_cgroup_path(memcg->css.cgroup);
 	pr_cont(":");
-	buf = memory_stat_format(memcg);
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
 	if (!buf)
 		return;
+	seq_buf_init(&s, buf, PAGE_SIZE);
+	/* The OOM report wants exact numbers */
+	cgroup_rstat_flush(memcg->css.cgroup);
+	memory_stat_format(memcg, &s);
 	pr_info("%s", buf);
 	kfree(buf);
 }
@@ -2040,13 +2097,30 @@ void unlock_page_memcg(struct page *page)
 }
 EXPORT_SYMBOL(unlock_page_memcg);
 
+#ifdef CONFIG_MEMCG_KMEM
+/*
+ * Number of obj_cgroups a CPU caches byte charges and slab stats for.
+ * Tasks of several cgroups sharing a CPU would keep draining a single
+ * cached obj_cgroup and fall back to the page counters.
+ */
+#define NR_OBJ_STOCK	4
+
+struct obj_stock {
+	struct obj_cgroup *cached_objcg;
+	struct pglist_data *cached_pgdat;
+	unsigned int nr_bytes;
+	int nr_slab_reclaimable_b;
+	int nr_slab_unreclaimable_b;
+};
+#endif
+
 struct memcg_stock_pcp {
 	struct mem_cgroup *cached; /* this never be root cgroup */
 	unsigned int nr_pages;
 
 #ifdef CONFIG_MEMCG_KMEM
-	struct obj_cgroup *cached_objcg;
-	unsigned int nr_bytes;
+	struct obj_stock obj[NR_OBJ_STOCK];
+	unsigned int obj_victim;	/* slot to be replaced next */
 #endif
 
 	struct work_struct work;
@@ -2057,12 +2131,12 @@ static DEFINE_PER_CPU(struct memcg_stock_pcp, memcg_stock);
 static DEFINE_MUTEX(percpu_charge_mutex);
 
 #ifdef CONFIG_MEMCG_KMEM
-static void drain_obj_stock(struct memcg_stock_pcp *stock);
+static void drain_obj_stocks(struct memcg_stock_pcp *stock);
 static bool obj_stock_flush_required(struct memcg_stock_pcp *stock,
 				     struct mem_cgroup *root_memcg);
 
 #else
-static inline void drain_obj_stock(struct memcg_stock_pcp *stock)
+static inline void drain_obj_stocks(struct memcg_stock_pcp *stock)
 {
 }
 static bool obj_stock_flush_required(struct memcg_stock_pcp *stock,
@@ -2138,7 +2212,7 @@ static void drain_local_stock(struct work_struct *dummy)
 	local_irq_save(flags);
 
 	stock = this_cpu_ptr(&memcg_stock);
-	drain_obj_stock(stock);
+	drain_obj_stocks(stock);
 	drain_stock(stock);
 	clear_bit(FLUSHING_CACHED_CHARGE, &stock->flags);
 
@@ -2995,17 +3069,30 @@ void __memcg_kmem_uncharge_page(struct page *page, int order)
 	obj_cgroup_put(objcg);
 }
 
+/* Must be called with irqs disabled */
+static struct obj_stock *find_obj_stock(struct memcg_stock_pcp *stock,
+					struct obj_cgroup *objcg)
+{
+	int i;
+
+	for (i = 0; i < NR_OBJ_STOCK; i++)
+		if (stock->obj[i].cached_objcg == objcg)
+			return &stock->obj[i];
+
+	return NULL;
+}
+
 static bool consume_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes)
 {
-	struct memcg_stock_pcp *stock;
+	struct obj_stock *os;
 	unsigned long flags;
 	bool ret = false;
 
 	local_irq_save(flags);
 
-	stock = this_cpu_ptr(&memcg_stock);
-	if (objcg == stock->cached_objcg && stock->nr_bytes >= nr_bytes) {
-		stock->nr_bytes -= nr_bytes;
+	os = find_obj_stock(this_cpu_ptr(&memcg_stock), objcg);
+	if (os && os->nr_bytes >= nr_bytes) {
+		os->nr_bytes -= nr_bytes;
 		ret = true;
 	}
 
@@ -3014,16 +3101,40 @@ static bool consume_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes)
 	return ret;
 }
 
-static void drain_obj_stock(struct memcg_stock_pcp *stock)
+static void flush_obj_stock_vmstat(struct obj_stock *os)
 {
-	struct obj_cgroup *old = stock->cached_objcg;
+	struct mem_cgroup *memcg;
+	struct lruvec *lruvec;
+
+	if (!os->nr_slab_reclaimable_b && !os->nr_slab_unreclaimable_b)
+		return;
+
+	rcu_read_lock();
+	memcg = obj_cgroup_memcg(os->cached_objcg);
+	lruvec = mem_cgroup_lruvec(memcg, os->cached_pgdat);
+	if (os->nr_slab_reclaimable_b) {
+		__mod_memcg_lruvec_state(lruvec, NR_SLAB_RECLAIMABLE_B,
+					 os->nr_slab_reclaimable_b);
+		os->nr_slab_reclaimable_b = 0;
+	}
+	if (os->nr_slab_unreclaimable_b) {
+		__mod_memcg_lruvec_state(lruvec, NR_SLAB_UNRECLAIMABLE_B,
+					 os->nr_slab_unreclaimable_b);
+		os->nr_slab_unreclaimable_b = 0;
+	}
+	rcu_read_unlock();
+}
+
+static void drain_obj_stock(struct obj_stock *os)
+{
+	struct obj_cgroup *old = os->cached_objcg;
 
 	if (!old)
 		return;
 
-	if (stock->nr_bytes) {
-		unsigned int nr_pages = stock->nr_bytes >> PAGE_SHIFT;
-		unsigned int nr_bytes = stock->nr_bytes & (PAGE_SIZE - 1);
+	if (os->nr_bytes) {
+		unsigned int nr_pages = os->nr_bytes >> PAGE_SHIFT;
+		unsigned int nr_bytes = os->nr_bytes & (PAGE_SIZE - 1);
 
 		if (nr_pages)
 			obj_cgroup_uncharge_pages(old, nr_pages);
@@ -3032,27 +3143,43 @@ static void drain_obj_stock(struct memcg_stock_pcp *stock)
 		 * The leftover is flushed to the centralized per-memcg value.
 		 * On the next attempt to refill obj stock it will be moved
 		 * to a per-cpu stock (probably, on an other CPU), see
-		 * refill_obj_stock().
+		 * get_obj_stock().
 		 *
 		 * How often it's flushed is a trade-off between the memory
 		 * limit enforcement accuracy and potential CPU contention,
 		 * so it might be changed in the future.
 		 */
 		atomic_add(nr_bytes, &old->nr_charged_bytes);
-		stock->nr_bytes = 0;
+		os->nr_bytes = 0;
 	}
 
+	flush_obj_stock_vmstat(os);
+	os->cached_pgdat = NULL;
+
 	obj_cgroup_put(old);
-	stock->cached_objcg = NULL;
+	os->cached_objcg = NULL;
+}
+
+static void drain_obj_stocks(struct memcg_stock_pcp *stock)
+{
+	int i;
+
+	for (i = 0; i < NR_OBJ_STOCK; i++)
+		drain_obj_stock(&stock->obj[i]);
 }
 
 static bool obj_stock_flush_required(struct memcg_stock_pcp *stock,
 				     struct mem_cgroup *root_memcg)
 {
 	struct mem_cgroup *memcg;
+	int i;
 
-	if (stock->cached_objcg) {
-		memcg = obj_cgroup_memcg(stock->cached_objcg);
+	for (i = 0; i < NR_OBJ_STOCK; i++) {
+		struct obj_cgroup *objcg = READ_ONCE(stock->obj[i].cached_objcg);
+
+		if (!objcg)
+			continue;
+		memcg = obj_cgroup_memcg(objcg);
 		if (memcg && mem_cgroup_is_descendant(memcg, root_memcg))
 			return true;
 	}
@@ -3060,25 +3187,107 @@ static bool obj_stock_flush_required(struct memcg_stock_pcp *stock,
 	return false;
 }
 
+/*
+ * Return the slot caching @objcg on this CPU, taking over a free slot or
+ * replacing the cached obj_cgroups in turn if there is none.  Must be
+ * called with irqs disabled.
+ */
+static struct obj_stock *get_obj_stock(struct memcg_stock_pcp *stock,
+				       struct obj_cgroup *objcg)
+{
+	struct obj_stock *os;
+
+	os = find_obj_stock(stock, objcg);
+	if (os)
+		return os;
+
+	os = find_obj_stock(stock, NULL);
+	if (!os) {
+		os = &stock->obj[stock->obj_victim];
+		stock->obj_victim = (stock->obj_victim + 1) % NR_OBJ_STOCK;
+		drain_obj_stock(os);
+	}
+
+	obj_cgroup_get(objcg);
+	os->cached_objcg = objcg;
+	os->nr_bytes = atomic_xchg(&objcg->nr_charged_bytes, 0);
+	return os;
+}
+
+static void __refill_obj_stock(struct obj_stock *os, unsigned int nr_bytes)
+{
+	os->nr_bytes += nr_bytes;
+
+	/* Give back whole pages, keep the slot for the next allocations */
+	if (os->nr_bytes > PAGE_SIZE) {
+		obj_cgroup_uncharge_pages(os->cached_objcg,
+					  os->nr_bytes >> PAGE_SHIFT);
+		os->nr_bytes &= PAGE_SIZE - 1;
+	}
+}
+
+static void __mod_objcg_state(struct obj_stock *os, struct pglist_data *pgdat,
+			      enum node_stat_item idx, int nr)
+{
+	int *bytes;
+
+	if (os->cached_pgdat != pgdat) {
+		flush_obj_stock_vmstat(os);
+		os->cached_pgdat = pgdat;
+	}
+
+	switch (idx) {
+	case NR_SLAB_RECLAIMABLE_B:
+		bytes = &os->nr_slab_reclaimable_b;
+		break;
+	case NR_SLAB_UNRECLAIMABLE_B:
+		bytes = &os->nr_slab_unreclaimable_b;
+		break;
+	default:
+		rcu_read_lock();
+		__mod_memcg_lruvec_state(mem_cgroup_lruvec(
+				obj_cgroup_memcg(os->cached_objcg), pgdat),
+				idx, nr);
+		rcu_read_unlock();
+		return;
+	}
+
+	/*
+	 * Like the per-cpu lruvec stats, the slab counters are allowed to
+	 * drift by a page's worth before they are folded in.
+	 */
+	*bytes += nr;
+	if (abs(*bytes) > PAGE_SIZE)
+		flush_obj_stock_vmstat(os);
+}
+
 static void refill_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes)
 {
-	struct memcg_stock_pcp *stock;
 	unsigned long flags;
 
 	local_irq_save(flags);
+	__refill_obj_stock(get_obj_stock(this_cpu_ptr(&memcg_stock), objcg),
+			   nr_bytes);
+	local_irq_restore(flags);
+}
 
-	stock = this_cpu_ptr(&memcg_stock);
-	if (stock->cached_objcg != objcg) { /* reset if necessary */
-		drain_obj_stock(stock);
-		obj_cgroup_get(objcg);
-		stock->cached_objcg = objcg;
-		stock->nr_bytes = atomic_xchg(&objcg->nr_charged_bytes, 0);
-	}
-	stock->nr_bytes += nr_bytes;
-
-	if (stock->nr_bytes > PAGE_SIZE)
-		drain_obj_stock(stock);
+/**
+ * mod_objcg_state - account a slab object to the stats of its cgroup
+ * @objcg: object cgroup the object is charged to
+ * @pgdat: node the object lives on
+ * @idx: stat item, usually NR_SLAB_{,UN}RECLAIMABLE_B
+ * @nr: bytes to add, negative on free
+ *
+ * The slab stats are batched in the per-cpu obj stock of @objcg.
+ */
+void mod_objcg_state(struct obj_cgroup *objcg, struct pglist_data *pgdat,
+		     enum node_stat_item idx, int nr)
+{
+	unsigned long flags;
 
+	local_irq_save(flags);
+	__mod_objcg_state(get_obj_stock(this_cpu_ptr(&memcg_stock), objcg),
+			  pgdat, idx, nr);
 	local_irq_restore(flags);
 }
 
@@ -3097,7 +3306,7 @@ int obj_cgroup_charge(struct obj_cgroup *objcg, gfp_t gfp, size_t size)
 	 * operations, and memcg->nr_charged_bytes can't be big,
 	 * so it's better to ignore it and try grab some new pages.
 	 * memcg->nr_charged_bytes will be flushed in
-	 * refill_obj_stock(), called from this function or
+	 * get_obj_stock(), called from this function or
 	 * independently later.
 	 */
 	nr_pages = size >> PAGE_SHIFT;
@@ -3118,6 +3327,34 @@ void obj_cgroup_uncharge(struct obj_cgroup *objcg, size_t size)
 	refill_obj_stock(objcg, size);
 }
 
+/**
+ * obj_cgroup_uncharge_objs - uncharge freed slab objects of one cgroup
+ * @objcg: object cgroup the objects were charged to
+ * @pgdat: node the objects lived on
+ * @idx: stat item the objects were accounted to
+ * @size: total size of the objects
+ * @nr_objs: number of objects, each of which held a reference to @objcg
+ *
+ * Uncharges, updates the stats and drops the references of a batch of
+ * objects with a single access to the per-cpu stock.
+ */
+void obj_cgroup_uncharge_objs(struct obj_cgroup *objcg,
+			      struct pglist_data *pgdat,
+			      enum node_stat_item idx, size_t size,
+			      unsigned int nr_objs)
+{
+	struct obj_stock *os;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	os = get_obj_stock(this_cpu_ptr(&memcg_stock), objcg);
+	__refill_obj_stock(os, size);
+	__mod_objcg_state(os, pgdat, idx, -(int)size);
+	local_irq_restore(flags);
+
+	percpu_ref_put_many(&objcg->refcnt, nr_objs);
+}
+
 #endif /* CONFIG_MEMCG_KMEM */
 
 /*
@@ -3386,7 +3623,7 @@ static unsigned long mem_cgroup_usage(struct mem_cgroup *memcg, bool swap)
 	unsigned long val;
 
 	if (mem_cgroup_is_root(memcg)) {
-		cgroup_rstat_flush(memcg->css.cgroup);
+		mem_cgroup_flush_stats();
 		val = memcg_page_state(memcg, NR_FILE_PAGES) +
 			memcg_page_state(memcg, NR_ANON_MAPPED);
 		if (swap)
@@ -3767,7 +4004,7 @@ static int memcg_numa_stat_show(struct seq_file *m, void *v)
 	int nid;
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
 
-	cgroup_rstat_flush(memcg->css.cgroup);
+	mem_cgroup_flush_stats();
 
 	for (stat = stats; stat < stats + ARRAY_SIZE(stats); stat++) {
 		seq_printf(m, "%s=%lu", stat->name,
@@ -3839,7 +4076,7 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 
 	BUILD_BUG_ON(ARRAY_SIZE(memcg1_stat_names) != ARRAY_SIZE(memcg1_stats));
 
-	cgroup_rstat_flush(memcg->css.cgroup);
+	mem_cgroup_flush_stats();
 
 	for (i = 0; i < ARRAY_SIZE(memcg1_stats); i++) {
 		unsigned long nr;
@@ -5130,6 +5367,10 @@ static int mem_cgroup_css_online(struct cgroup_subsys_state *css)
 	/* Online state pins memcg ID, memcg ID pins CSS */
 	refcount_set(&memcg->id.ref, 1);
 	css_get(css);
+
+	if (unlikely(mem_cgroup_is_root(memcg)))
+		queue_delayed_work(system_unbound_wq, &stats_flush_dwork,
+				   FLUSH_TIME);
 	return 0;
 }
 
@@ -6157,6 +6398,109 @@ static ssize_t memory_max_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+enum {
+	MEMORY_RECLAIM_SWAPPINESS = 0,
+	MEMORY_RECLAIM_NODES,
+	MEMORY_RECLAIM_NULL,
+};
+
+static const match_table_t memory_reclaim_tokens = {
+	{ MEMORY_RECLAIM_SWAPPINESS, "swappiness=%d" },
+	{ MEMORY_RECLAIM_NODES, "nodes=%s" },
+	{ MEMORY_RECLAIM_NULL, NULL },
+};
+
+/*
+ * Reading memory.reclaim reports how many bytes the last write through
+ * the same open file reclaimed, which is kept in of->priv.
+ */
+static int memory_reclaim_show(struct seq_file *m, void *v)
+{
+	struct kernfs_open_file *of = m->private;
+
+	seq_printf(m, "%lu\n", (unsigned long)of->priv);
+	return 0;
+}
+
+/*
+ * "<size> [swappiness=<0-200>] [nodes=<nodelist>]" reclaims <size> bytes
+ * from the cgroup without touching its limits.
+ */
+static ssize_t memory_reclaim(struct kernfs_open_file *of, char *buf,
+			      size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned int nr_retries = MAX_RECLAIM_RETRIES;
+	unsigned long nr_to_reclaim, nr_reclaimed = 0;
+	int swappiness, *swappinessp = NULL;
+	nodemask_t nodemask, *nodemaskp = NULL;
+	substring_t args[MAX_OPT_ARGS];
+	char *start, *p;
+	int err;
+
+	buf = strstrip(buf);
+	start = strsep(&buf, " ");
+	err = page_counter_memparse(start, "", &nr_to_reclaim);
+	if (err)
+		return err;
+
+	while ((p = strsep(&buf, " ")) != NULL) {
+		if (!*p)
+			continue;
+
+		switch (match_token(p, memory_reclaim_tokens, args)) {
+		case MEMORY_RECLAIM_SWAPPINESS:
+			if (match_int(&args[0], &swappiness))
+				return -EINVAL;
+			if (swappiness < 0 || swappiness > 200)
+				return -EINVAL;
+			swappinessp = &swappiness;
+			break;
+		case MEMORY_RECLAIM_NODES:
+			if (nodelist_parse(args[0].from, nodemask))
+				return -EINVAL;
+			nodes_and(nodemask, nodemask, node_states[N_MEMORY]);
+			if (nodes_empty(nodemask))
+				return -EINVAL;
+			nodemaskp = &nodemask;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	while (nr_reclaimed < nr_to_reclaim) {
+		unsigned long reclaimed;
+
+		if (signal_pending(current)) {
+			err = -EINTR;
+			break;
+		}
+
+		/*
+		 * This is the final attempt, drain percpu lru caches in the
+		 * hope of introducing more evictable pages.
+		 */
+		if (!nr_retries)
+			lru_add_drain_all();
+
+		reclaimed = mem_cgroup_proactive_reclaim(memcg,
+						nr_to_reclaim - nr_reclaimed,
+						swappinessp, nodemaskp);
+
+		if (!reclaimed && !nr_retries--) {
+			err = -EAGAIN;
+			break;
+		}
+
+		nr_reclaimed += reclaimed;
+	}
+
+	of->priv = (void *)(nr_reclaimed << PAGE_SHIFT);
+
+	return err ? err : nbytes;
+}
+
 static void __memory_events_show(struct seq_file *m, atomic_long_t *events)
 {
 	seq_printf(m, "low %lu\n", atomic_long_read(&events[MEMCG_LOW]));
@@ -6186,11 +6530,70 @@ static int memory_events_local_show(struct seq_file *m, void *v)
 static int memory_stat_show(struct seq_file *m, void *v)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+	struct seq_buf s;
+	char *buf;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	seq_buf_init(&s, buf, PAGE_SIZE);
+	mem_cgroup_flush_stats();
+	memory_stat_format(memcg, &s);
+	seq_puts(m, buf);
+	kfree(buf);
+	return 0;
+}
+
+/*
+ * memory.stat.subtree: memory.stat of the cgroup and of all its
+ * descendants in pre-order, each preceded by a "cgroup <path>" line, so
+ * that monitoring reads a whole hierarchy with a single open and flush.
+ */
+static void *memory_stat_subtree_start(struct seq_file *m, loff_t *pos)
+{
+	struct mem_cgroup *root = mem_cgroup_from_seq(m);
+	struct mem_cgroup *memcg;
+	loff_t n = *pos;
+
+	if (!n)
+		mem_cgroup_flush_stats();
+
+	/* The reference on the returned memcg is dropped by _next or _stop */
+	for_each_mem_cgroup_tree(memcg, root)
+		if (!n--)
+			return memcg;
+
+	return NULL;
+}
+
+static void *memory_stat_subtree_next(struct seq_file *m, void *v,
+				      loff_t *pos)
+{
+	++*pos;
+	return mem_cgroup_iter(mem_cgroup_from_seq(m), v, NULL);
+}
+
+static void memory_stat_subtree_stop(struct seq_file *m, void *v)
+{
+	if (v)
+		mem_cgroup_iter_break(mem_cgroup_from_seq(m), v);
+}
+
+static int memory_stat_subtree_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = v;
+	struct seq_buf s;
 	char *buf;
 
-	buf = memory_stat_format(memcg);
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
 	if (!buf)
 		return -ENOMEM;
+
+	cgroup_path(memcg->css.cgroup, buf, PAGE_SIZE);
+	seq_printf(m, "cgroup %s\n", buf);
+
+	seq_buf_init(&s, buf, PAGE_SIZE);
+	memory_stat_format(memcg, &s);
 	seq_puts(m, buf);
 	kfree(buf);
 	return 0;
@@ -6304,10 +6707,23 @@ static struct cftype memory_files[] = {
 		.file_offset = offsetof(struct mem_cgroup, events_local_file),
 		.seq_show = memory_events_local_show,
 	},
+	{
+		.name = "reclaim",
+		.flags = CFTYPE_NS_DELEGATABLE,
+		.seq_show = memory_reclaim_show,
+		.write = memory_reclaim,
+	},
 	{
 		.name = "stat",
 		.seq_show = memory_stat_show,
 	},
+	{
+		.name = "stat.subtree",
+		.seq_start = memory_stat_subtree_start,
+		.seq_next = memory_stat_subtree_next,
+		.seq_stop = memory_stat_subtree_stop,
+		.seq_show = memory_stat_subtree_show,
+	},
 #ifdef CONFIG_NUMA
 	{
 		.name = "numa_stat",
@@ -36,6 +36,7 @@
 #include <linux/memblock.h>
 #include <linux/compaction.h>
 #include <linux/rmap.h>
+#include <linux/padata.h>
 
 #include <asm/tlbflush.h>
 
@@ -705,6 +706,72 @@ static void node_states_set_node(int node, struct memory_notify *arg)
 		node_set_state(node, N_MEMORY);
 }
 
+/* Ranges from this size on get their memmap initialized in parallel */
+#define MEMMAP_INIT_MT_MIN_PAGES	(4 * PAGES_PER_SECTION)
+
+struct memmap_init_hotplug_arg {
+	int nid;
+	unsigned long zone_idx;
+	int migratetype;
+};
+
+static void __meminit memmap_init_hotplug_chunk(unsigned long start_pfn,
+						unsigned long end_pfn,
+						void *data)
+{
+	struct memmap_init_hotplug_arg *arg = data;
+
+	memmap_init_range(end_pfn - start_pfn, arg->nid, arg->zone_idx,
+			  start_pfn, 0, MEMINIT_HOTPLUG, NULL,
+			  arg->migratetype);
+}
+
+/*
+ * Initializing the memmap dominates onlining of big memory blocks. Spread it
+ * over the CPUs of the node, like deferred struct page init does at boot.
+ */
+static void __meminit memmap_init_hotplug(struct zone *zone,
+					  unsigned long start_pfn,
+					  unsigned long nr_pages,
+					  struct vmem_altmap *altmap,
+					  int migratetype)
+{
+	const int nid = zone_to_nid(zone);
+	const int max_threads = max_t(int, 1,
+				      cpumask_weight(cpumask_of_node(nid)));
+	struct memmap_init_hotplug_arg arg = {
+		.nid		= nid,
+		.zone_idx	= zone_idx(zone),
+		.migratetype	= migratetype,
+	};
+	struct padata_mt_job job = {
+		.thread_fn   = memmap_init_hotplug_chunk,
+		.fn_arg      = &arg,
+		.start       = start_pfn,
+		.size        = nr_pages,
+		.align       = PAGES_PER_SECTION,
+		.min_chunk   = PAGES_PER_SECTION,
+		.max_threads = max_threads,
+	};
+
+	/* The altmap describes the start of the range only, keep it serial. */
+	if (!IS_ENABLED(CONFIG_PADATA) || altmap ||
+	    nr_pages < MEMMAP_INIT_MT_MIN_PAGES) {
+		memmap_init_range(nr_pages, nid, zone_idx(zone), start_pfn, 0,
+				  MEMINIT_HOTPLUG, altmap, migratetype);
+		return;
+	}
+
+	/*
+	 * memmap_init_range() updates this without synchronization, raise it
+	 * once here so the chunks never race on it.
+	 */
+	if (highest_memmap_pfn < start_pfn + nr_pages - 1)
+		highest_memmap_pfn = start_pfn + nr_pages - 1;
+
+	padata_do_multithreaded(&job);
+}
+
 static void __meminit resize_zone_range(struct zone *zone, unsigned long start_pfn,
 		unsigned long nr_pages)
 {
@@ -749,7 +816,6 @@ void __ref move_pfn_range_to_zone(struct zone *zone, unsigned long start_pfn,
 				  struct vmem_altmap *altmap, int migratetype)
 {
 	struct pglist_data *pgdat = zone->zone_pgdat;
-	int nid = pgdat->node_id;
 	unsigned long flags;
 
 	clear_zone_contiguous(zone);
@@ -783,8 +849,7 @@ void __ref move_pfn_range_to_zone(struct zone *zone, unsigned long start_pfn,
 	 * expects the zone spans the pfn range. All the pages in the range
 	 * are reserved so nobody should be touching them so we should be safe
 	 */
-	memmap_init_range(nr_pages, nid, zone_idx(zone), start_pfn, 0,
-			 MEMINIT_HOTPLUG, altmap, migratetype);
+	memmap_init_hotplug(zone, start_pfn, nr_pages, altmap, migratetype);
 
 	set_zone_contiguous(zone);
 }
@@ -1177,6 +1242,7 @@ bool mhp_supports_memmap_on_memory(unsigned long size)
 	       IS_ALIGNED(vmemmap_size, PMD_SIZE) &&
 	       IS_ALIGNED(remaining_size, (pageblock_nr_pages << PAGE_SHIFT));
 }
+EXPORT_SYMBOL_GPL(mhp_supports_memmap_on_memory);
 
 /*
  * NOTE: The caller must call lock_device_hotplug() to serialize hotplug
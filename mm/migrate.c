@@ -47,8 +47,10 @@
 #include <linux/page_idle.h>
 #include <linux/page_owner.h>
 #include <linux/sched/mm.h>
+#include <linux/sched/sysctl.h>
 #include <linux/ptrace.h>
 #include <linux/oom.h>
+#include <linux/memory.h>
 
 #include <asm/tlbflush.h>
 
@@ -1099,7 +1101,14 @@ static int __unmap_and_move(struct page *page, struct page *newpage,
 		/* Establish migration ptes */
 		VM_BUG_ON_PAGE(PageAnon(page) && !PageKsm(page) && !anon_vma,
 				page);
-		try_to_unmap(page, TTU_MIGRATION|TTU_IGNORE_MLOCK);
+		try_to_unmap(page, TTU_MIGRATION|TTU_IGNORE_MLOCK|
+				   TTU_BATCH_FLUSH);
+		/*
+		 * One flush for all the mms the page was mapped in. It must
+		 * happen before the copy, so that no write through a stale
+		 * TLB entry can be lost.
+		 */
+		try_to_unmap_flush();
 		page_was_mapped = 1;
 	}
 
@@ -2050,8 +2059,23 @@ static int numamigrate_isolate_page(pg_data_t *pgdat, struct page *page)
 	VM_BUG_ON_PAGE(compound_order(page) && !PageTransHuge(page), page);
 
 	/* Avoid migrating to a node that is nearly full */
-	if (!migrate_balanced_pgdat(pgdat, compound_nr(page)))
+	if (!migrate_balanced_pgdat(pgdat, compound_nr(page))) {
+		int z;
+
+		if (!(sysctl_numa_balancing_mode & NUMA_BALANCING_MEMORY_TIERING))
+			return 0;
+		/*
+		 * Have kswapd demote cold pages off the fast node so that
+		 * hot pages can be promoted into the room it makes.
+		 */
+		for (z = pgdat->nr_zones - 1; z >= 0; z--) {
+			if (populated_zone(pgdat->node_zones + z))
+				break;
+		}
+		wakeup_kswapd(pgdat->node_zones + z, 0, compound_order(page),
+			      ZONE_MOVABLE);
 		return 0;
+	}
 
 	if (isolate_lru_page(page))
 		return 0;
@@ -2096,6 +2120,8 @@ int migrate_misplaced_page(struct page *page, struct vm_area_struct *vma,
 			   int node)
 {
 	pg_data_t *pgdat = NODE_DATA(node);
+	int page_nid = page_to_nid(page);
+	int nr_pages = thp_nr_pages(page);
 	int isolated;
 	int nr_remaining;
 	LIST_HEAD(migratepages);
@@ -2131,8 +2157,12 @@ int migrate_misplaced_page(struct page *page, struct vm_area_struct *vma,
 			putback_lru_page(page);
 		}
 		isolated = 0;
-	} else
+	} else {
 		count_vm_numa_event(NUMA_PAGE_MIGRATE);
+		vma_numab_set_migrated(vma);
+		if (!node_is_toptier(page_nid) && node_is_toptier(node))
+			mod_node_page_state(pgdat, PGPROMOTE_SUCCESS, nr_pages);
+	}
 	BUG_ON(!list_empty(&migratepages));
 	return isolated;
 
@@ -2253,6 +2283,9 @@ int migrate_misplaced_transhuge_page(struct mm_struct *mm,
 
 	count_vm_events(PGMIGRATE_SUCCESS, HPAGE_PMD_NR);
 	count_vm_numa_events(NUMA_PAGE_MIGRATE, HPAGE_PMD_NR);
+	vma_numab_set_migrated(vma);
+	if (!node_is_toptier(page_to_nid(page)) && node_is_toptier(node))
+		mod_node_page_state(pgdat, PGPROMOTE_SUCCESS, HPAGE_PMD_NR);
 
 	mod_node_page_state(page_pgdat(page),
 			NR_ISOLATED_ANON + page_lru,
@@ -3128,3 +3161,142 @@ void migrate_vma_finalize(struct migrate_vma *migrate)
 }
 EXPORT_SYMBOL(migrate_vma_finalize);
 #endif /* CONFIG_DEVICE_PRIVATE */
+
+#ifdef CONFIG_NUMA
+/*
+ * node_demotion[] holds the node that reclaim on a given node demotes cold
+ * pages to instead of discarding them, or NUMA_NO_NODE.  Each node with
+ * CPUs demotes to the nearest node that has memory but no CPUs; those
+ * slow nodes are the last tier and demote nowhere.  This is rebuilt as
+ * memory is onlined and offlined and read locklessly by reclaim.
+ */
+static int node_demotion[MAX_NUMNODES] __read_mostly =
+	{[0 ...  MAX_NUMNODES - 1] = NUMA_NO_NODE};
+
+bool numa_demotion_enabled;
+
+/**
+ * next_demotion_node() - Get the next node in the demotion path
+ * @node: The starting node to lookup the next node
+ *
+ * Return: node id for next memory node in the demotion path hierarchy
+ * from @node; NUMA_NO_NODE if @node is terminal.
+ */
+int next_demotion_node(int node)
+{
+	return READ_ONCE(node_demotion[node]);
+}
+
+static void set_migration_target_nodes(void)
+{
+	int node, target;
+
+	for_each_node(node) {
+		int best = NUMA_NO_NODE;
+		int best_distance = INT_MAX;
+
+		if (node_state(node, N_MEMORY) && node_is_toptier(node)) {
+			for_each_node_state(target, N_MEMORY) {
+				if (node_is_toptier(target))
+					continue;
+				if (node_distance(node, target) < best_distance) {
+					best = target;
+					best_distance = node_distance(node, target);
+				}
+			}
+		}
+		WRITE_ONCE(node_demotion[node], best);
+	}
+}
+
+#ifdef CONFIG_MEMORY_HOTPLUG
+static int __meminit migrate_on_reclaim_callback(struct notifier_block *self,
+						 unsigned long action, void *_arg)
+{
+	struct memory_notify *arg = _arg;
+
+	/* Only react to a node gaining or losing all of its memory */
+	if (arg->status_change_nid < 0)
+		return notifier_from_errno(0);
+
+	switch (action) {
+	case MEM_ONLINE:
+	case MEM_OFFLINE:
+		set_migration_target_nodes();
+		break;
+	}
+
+	return notifier_from_errno(0);
+}
+#endif
+
+static int __init migrate_on_reclaim_init(void)
+{
+	set_migration_target_nodes();
+#ifdef CONFIG_MEMORY_HOTPLUG
+	hotplug_memory_notifier(migrate_on_reclaim_callback, 100);
+#endif
+	return 0;
+}
+late_initcall(migrate_on_reclaim_init);
+
+#ifdef CONFIG_SYSFS
+static ssize_t numa_demotion_enabled_show(struct kobject *kobj,
+					  struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%s\n",
+			  numa_demotion_enabled ? "true" : "false");
+}
+
+static ssize_t numa_demotion_enabled_store(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   const char *buf, size_t count)
+{
+	bool enabled;
+	int err;
+
+	err = kstrtobool(buf, &enabled);
+	if (err)
+		return err;
+
+	WRITE_ONCE(numa_demotion_enabled, enabled);
+	return count;
+}
+
+static struct kobj_attribute numa_demotion_enabled_attr =
+	__ATTR(demotion_enabled, 0644, numa_demotion_enabled_show,
+	       numa_demotion_enabled_store);
+
+static struct attribute *numa_attrs[] = {
+	&numa_demotion_enabled_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group numa_attr_group = {
+	.attrs = numa_attrs,
+};
+
+static int __init numa_init_sysfs(void)
+{
+	int err;
+	struct kobject *numa_kobj;
+
+	numa_kobj = kobject_create_and_add("numa", mm_kobj);
+	if (!numa_kobj) {
+		pr_err("failed to create numa kobject\n");
+		return -ENOMEM;
+	}
+	err = sysfs_create_group(numa_kobj, &numa_attr_group);
+	if (err) {
+		pr_err("failed to register numa group\n");
+		goto delete_obj;
+	}
+	return 0;
+
+delete_obj:
+	kobject_put(numa_kobj);
+	return err;
+}
+subsys_initcall(numa_init_sysfs);
+#endif /* CONFIG_SYSFS */
+#endif /* CONFIG_NUMA */
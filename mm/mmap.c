@@ -652,7 +652,9 @@ void __vma_link_rb(struct mm_struct *mm, struct vm_area_struct *vma,
 	 * immediately update the gap to the correct value. Finally we
 	 * rebalance the rbtree after all augmented values have been set.
 	 */
-	rb_link_node(&vma->vm_rb, rb_parent, rb_link);
+	vma_start_write(vma);
+	/* Publish the initialized node to find_vma_rcu() */
+	rb_link_node_rcu(&vma->vm_rb, rb_parent, rb_link);
 	vma->rb_subtree_gap = 0;
 	vma_gap_update(vma);
 	vma_rb_insert(vma, &mm->mm_rb);
@@ -754,6 +756,10 @@ int __vma_adjust(struct vm_area_struct *vma, unsigned long start,
 	long adjust_next = 0;
 	int remove_next = 0;
 
+	vma_start_write(vma);
+	if (next)
+		vma_start_write(next);
+
 	if (next && !insert) {
 		struct vm_area_struct *exporter = NULL, *importer = NULL;
 
@@ -837,6 +843,9 @@ int __vma_adjust(struct vm_area_struct *vma, unsigned long start,
 		}
 	}
 again:
+	vma_start_write(vma);
+	if (next)
+		vma_start_write(next);
 	vma_adjust_trans_huge(orig_vma, start, end, adjust_next);
 
 	if (file) {
@@ -904,6 +913,7 @@ int __vma_adjust(struct vm_area_struct *vma, unsigned long start,
 		 * vma_merge has merged next into vma, and needs
 		 * us to remove next before dropping the locks.
 		 */
+		vma_mark_detached(next);
 		if (remove_next != 3)
 			__vma_unlink(mm, next, next);
 		else
@@ -2334,6 +2344,37 @@ struct vm_area_struct *find_vma(struct mm_struct *mm, unsigned long addr)
 
 EXPORT_SYMBOL(find_vma);
 
+/*
+ * Like find_vma(), but may be called under rcu_read_lock() instead of
+ * mmap_lock.  lib/rbtree.c keeps the tree loop-free for such lookups, so
+ * a walk racing with a writer may miss a vma or return a stale one, but
+ * never anything that is not a vma of some mm.  vmas are freed after an
+ * RCU grace period; the caller must revalidate the result under a lock.
+ * The per-thread vmacache is neither consulted nor updated.
+ */
+struct vm_area_struct *find_vma_rcu(struct mm_struct *mm, unsigned long addr)
+{
+	struct rb_node *rb_node;
+	struct vm_area_struct *vma = NULL;
+
+	rb_node = rcu_dereference_raw(mm->mm_rb.rb_node);
+	while (rb_node) {
+		struct vm_area_struct *tmp;
+
+		tmp = rb_entry(rb_node, struct vm_area_struct, vm_rb);
+
+		if (READ_ONCE(tmp->vm_end) > addr) {
+			vma = tmp;
+			if (READ_ONCE(tmp->vm_start) <= addr)
+				break;
+			rb_node = rcu_dereference_raw(rb_node->rb_left);
+		} else
+			rb_node = rcu_dereference_raw(rb_node->rb_right);
+	}
+
+	return vma;
+}
+
 /*
  * Same as find_vma, but also return a pointer to the previous VMA in *pprev.
  */
@@ -2697,6 +2738,7 @@ detach_vmas_to_be_unmapped(struct mm_struct *mm, struct vm_area_struct *vma,
 	insertion_point = (prev ? &prev->vm_next : &mm->mmap);
 	vma->vm_prev = NULL;
 	do {
+		vma_mark_detached(vma);
 		vma_rb_erase(vma, &mm->mm_rb);
 		mm->map_count--;
 		tail_vma = vma;
@@ -406,6 +406,47 @@ static bool move_pgt_entry(enum pgt_entry entry, struct vm_area_struct *vma,
 	return moved;
 }
 
+/*
+ * Aligning @addr down to @mask is only safe if it is the start of @vma and
+ * nothing else is mapped between the aligned address and the vma, since
+ * the page table moved along with the vma covers that range too.
+ */
+static bool can_align_down(struct vm_area_struct *vma, unsigned long addr,
+			   unsigned long mask)
+{
+	unsigned long addr_masked = addr & mask;
+
+	if (vma->vm_start != addr)
+		return false;
+
+	return find_vma_intersection(vma->vm_mm, addr_masked,
+				     vma->vm_start) == NULL;
+}
+
+/*
+ * Opportunistically move the start of both ranges down to a @mask boundary,
+ * so that whole page tables can be moved instead of copying the ptes of the
+ * first, partial, table one by one.
+ */
+static void try_realign_addr(unsigned long *old_addr,
+			     struct vm_area_struct *old_vma,
+			     unsigned long *new_addr,
+			     struct vm_area_struct *new_vma,
+			     unsigned long mask)
+{
+	/* Already aligned, or the two ranges can never share alignment */
+	if ((*old_addr & ~mask) == 0 ||
+	    (*old_addr & ~mask) != (*new_addr & ~mask))
+		return;
+
+	if (!can_align_down(old_vma, *old_addr, mask) ||
+	    !can_align_down(new_vma, *new_addr, mask))
+		return;
+
+	*old_addr &= mask;
+	*new_addr &= mask;
+}
+
 unsigned long move_page_tables(struct vm_area_struct *vma,
 		unsigned long old_addr, struct vm_area_struct *new_vma,
 		unsigned long new_addr, unsigned long len,
@@ -416,6 +457,18 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 	pmd_t *old_pmd, *new_pmd;
 
 	old_end = old_addr + len;
+
+	/*
+	 * If the move crosses a PUD or PMD boundary, try to realign the start
+	 * so the first table can be moved whole as well.
+	 */
+	if (IS_ENABLED(CONFIG_HAVE_MOVE_PUD) &&
+	    len >= PUD_SIZE - (old_addr & ~PUD_MASK))
+		try_realign_addr(&old_addr, vma, &new_addr, new_vma, PUD_MASK);
+	if (IS_ENABLED(CONFIG_HAVE_MOVE_PMD) &&
+	    len >= PMD_SIZE - (old_addr & ~PMD_MASK))
+		try_realign_addr(&old_addr, vma, &new_addr, new_vma, PMD_MASK);
+
 	flush_cache_range(vma, old_addr, old_end);
 
 	mmu_notifier_range_init(&range, MMU_NOTIFY_UNMAP, 0, vma, vma->vm_mm,
@@ -478,6 +531,13 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 
 	mmu_notifier_invalidate_range_end(&range);
 
+	/*
+	 * The start may have been realigned, do not report a negative amount
+	 * if we stopped within the first table.
+	 */
+	if (old_addr < old_end - len)
+		return 0;
+
 	return len + old_addr - old_end;	/* how much done */
 }
 
@@ -505,6 +565,9 @@ static unsigned long move_vma(struct vm_area_struct *vma,
 	if (mm->map_count >= sysctl_max_map_count - 3)
 		return -ENOMEM;
 
+	/* Page tables are about to move out from under the vma */
+	vma_start_write(vma);
+
 	if (vma->vm_ops && vma->vm_ops->may_split) {
 		if (vma->vm_start != old_addr)
 			err = vma->vm_ops->may_split(vma, old_addr);
@@ -23,6 +23,7 @@
 #include <linux/blk-cgroup.h>
 #include <linux/fadvise.h>
 #include <linux/sched/mm.h>
+#include <linux/cpuset.h>
 
 #include "internal.h"
 
@@ -171,6 +172,44 @@ static void read_pages(struct readahead_control *rac, struct list_head *pages,
  * Context: File is referenced by caller.  Mutexes may be held by caller.
  * May sleep, but will not reenter filesystem to reclaim memory.
  */
+/*
+ * Can we take readahead pages from the local node in bulk, or does the
+ * task's cpuset or mempolicy want them placed page by page?
+ */
+static bool ra_can_alloc_bulk(void)
+{
+	if (cpuset_do_page_mem_spread())
+		return false;
+#ifdef CONFIG_NUMA
+	if (current->mempolicy)
+		return false;
+#endif
+	return true;
+}
+
+/*
+ * Hand out one page cache page, refilling @batch with up to PAGEVEC_SIZE
+ * pages from the bulk allocator when it runs dry and @remaining pages
+ * are still wanted.  This saves a trip through the page allocator for
+ * most of the pages of a large readahead.
+ */
+static struct page *ra_alloc_page(gfp_t gfp, struct page **batch,
+				  unsigned int *nr, unsigned long remaining)
+{
+	if (!*nr) {
+		if (remaining < 2 || !ra_can_alloc_bulk())
+			return __page_cache_alloc(gfp);
+
+		memset(batch, 0, PAGEVEC_SIZE * sizeof(*batch));
+		*nr = alloc_pages_bulk_array(gfp,
+				min_t(unsigned long, remaining, PAGEVEC_SIZE),
+				batch);
+		if (!*nr)
+			return NULL;
+	}
+	return batch[--*nr];
+}
+
 void page_cache_ra_unbounded(struct readahead_control *ractl,
 		unsigned long nr_to_read, unsigned long lookahead_size)
 {
@@ -178,6 +217,8 @@ void page_cache_ra_unbounded(struct readahead_control *ractl,
 	unsigned long index = readahead_index(ractl);
 	LIST_HEAD(page_pool);
 	gfp_t gfp_mask = readahead_gfp_mask(mapping);
+	struct page *batch[PAGEVEC_SIZE];
+	unsigned int nr_batch = 0;
 	unsigned long i;
 
 	/*
@@ -212,7 +253,8 @@ void page_cache_ra_unbounded(struct readahead_control *ractl,
 			continue;
 		}
 
-		page = __page_cache_alloc(gfp_mask);
+		page = ra_alloc_page(gfp_mask, batch, &nr_batch,
+				     nr_to_read - i);
 		if (!page)
 			break;
 		if (mapping->a_ops->readpages) {
@@ -237,6 +279,10 @@ void page_cache_ra_unbounded(struct readahead_control *ractl,
 	 */
 	read_pages(ractl, &page_pool, false);
 	memalloc_nofs_restore(nofs);
+
+	/* Readahead was cut short, give back what we didn't use */
+	while (nr_batch)
+		put_page(batch[--nr_batch]);
 }
 EXPORT_SYMBOL_GPL(page_cache_ra_unbounded);
 
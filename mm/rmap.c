@@ -607,6 +607,7 @@ void try_to_unmap_flush(void)
 		return;
 
 	arch_tlbbatch_flush(&tlb_ubc->arch);
+	count_vm_event(TLB_BATCHED_FLUSH);
 	tlb_ubc->flush_required = false;
 	tlb_ubc->writable = false;
 }
@@ -626,6 +627,7 @@ static void set_tlb_ubc_flush_pending(struct mm_struct *mm, bool writable)
 
 	arch_tlbbatch_add_mm(&tlb_ubc->arch, mm);
 	tlb_ubc->flush_required = true;
+	count_vm_event(TLB_DEFERRED_UNMAP);
 
 	/*
 	 * Ensure compiler does not re-order the setting of tlb_flush_batched
@@ -759,6 +761,53 @@ pmd_t *mm_find_pmd(struct mm_struct *mm, unsigned long address)
 	return pmd;
 }
 
+/*
+ * When set, a young pte found by page_referenced_one() makes us also
+ * harvest the accessed bits of its neighbours in the same page table.
+ * Pages mapped close together tend to be referenced together, and the
+ * page table is already mapped and locked, so this is cheaper than
+ * finding those pages again through their own rmap walks.
+ */
+int sysctl_lru_look_around __read_mostly;
+
+/*
+ * Test and clear the accessed bit of up to SWAP_CLUSTER_MAX ptes around
+ * pvmw->address, within the same vma and page table, and mark the pages
+ * they map as accessed. Called with the pte lock held.
+ */
+static void page_referenced_look_around(struct page_vma_mapped_walk *pvmw)
+{
+	struct vm_area_struct *vma = pvmw->vma;
+	unsigned long address = pvmw->address;
+	unsigned long span = SWAP_CLUSTER_MAX * PAGE_SIZE / 2;
+	unsigned long start, end, addr;
+	pte_t *pte;
+
+	start = max3(address & PMD_MASK, vma->vm_start,
+		     address > span ? address - span : 0);
+	end = min3((address & PMD_MASK) + PMD_SIZE, vma->vm_end,
+		   address + span > address ? address + span : -PAGE_SIZE);
+
+	pte = pvmw->pte - ((address - start) >> PAGE_SHIFT);
+	for (addr = start; addr < end; addr += PAGE_SIZE, pte++) {
+		struct page *page;
+		pte_t entry = *pte;
+
+		if (addr == address || !pte_present(entry) ||
+		    !pte_young(entry))
+			continue;
+
+		page = vm_normal_page(vma, addr, entry);
+		if (!page || is_zone_device_page(page))
+			continue;
+		if (compound_head(page) == compound_head(pvmw->page))
+			continue;
+
+		if (ptep_test_and_clear_young(vma, addr, pte))
+			mark_page_accessed(page);
+	}
+}
+
 struct page_referenced_arg {
 	int mapcount;
 	int referenced;
@@ -799,8 +848,11 @@ static bool page_referenced_one(struct page *page, struct vm_area_struct *vma,
 				 * already gone, the unmap path will have set
 				 * PG_referenced or activated the page.
 				 */
-				if (likely(!(vma->vm_flags & VM_SEQ_READ)))
+				if (likely(!(vma->vm_flags & VM_SEQ_READ))) {
 					referenced++;
+					if (READ_ONCE(sysctl_lru_look_around))
+						page_referenced_look_around(&pvmw);
+				}
 			}
 		} else if (IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE)) {
 			if (pmdp_clear_flush_young_notify(vma, address,
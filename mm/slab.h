@@ -283,20 +283,6 @@ static inline bool memcg_slab_pre_alloc_hook(struct kmem_cache *s,
 	return true;
 }
 
-static inline void mod_objcg_state(struct obj_cgroup *objcg,
-				   struct pglist_data *pgdat,
-				   enum node_stat_item idx, int nr)
-{
-	struct mem_cgroup *memcg;
-	struct lruvec *lruvec;
-
-	rcu_read_lock();
-	memcg = obj_cgroup_memcg(objcg);
-	lruvec = mem_cgroup_lruvec(memcg, pgdat);
-	mod_memcg_lruvec_state(lruvec, idx, nr);
-	rcu_read_unlock();
-}
-
 static inline void memcg_slab_post_alloc_hook(struct kmem_cache *s,
 					      struct obj_cgroup *objcg,
 					      gfp_t flags, size_t size,
@@ -338,7 +324,11 @@ static inline void memcg_slab_free_hook(struct kmem_cache *s_orig,
 {
 	struct kmem_cache *s;
 	struct obj_cgroup **objcgs;
-	struct obj_cgroup *objcg;
+	struct obj_cgroup *objcg, *batch_objcg = NULL;
+	struct pglist_data *batch_pgdat = NULL;
+	enum node_stat_item batch_idx = NR_SLAB_UNRECLAIMABLE_B;
+	unsigned int batch_nr = 0;
+	size_t batch_size = 0;
 	struct page *page;
 	unsigned int off;
 	int i;
@@ -346,6 +336,10 @@ static inline void memcg_slab_free_hook(struct kmem_cache *s_orig,
 	if (!memcg_kmem_enabled())
 		return;
 
+	/*
+	 * Bulk frees tend to free objects of one cgroup and node, uncharge
+	 * runs of those in one go.
+	 */
 	for (i = 0; i < objects; i++) {
 		if (unlikely(!p[i]))
 			continue;
@@ -366,11 +360,25 @@ static inline void memcg_slab_free_hook(struct kmem_cache *s_orig,
 			continue;
 
 		objcgs[off] = NULL;
-		obj_cgroup_uncharge(objcg, obj_full_size(s));
-		mod_objcg_state(objcg, page_pgdat(page), cache_vmstat_idx(s),
-				-obj_full_size(s));
-		obj_cgroup_put(objcg);
+		if (objcg != batch_objcg || page_pgdat(page) != batch_pgdat ||
+		    cache_vmstat_idx(s) != batch_idx) {
+			if (batch_nr)
+				obj_cgroup_uncharge_objs(batch_objcg,
+							 batch_pgdat, batch_idx,
+							 batch_size, batch_nr);
+			batch_objcg = objcg;
+			batch_pgdat = page_pgdat(page);
+			batch_idx = cache_vmstat_idx(s);
+			batch_size = 0;
+			batch_nr = 0;
+		}
+		batch_size += obj_full_size(s);
+		batch_nr++;
 	}
+
+	if (batch_nr)
+		obj_cgroup_uncharge_objs(batch_objcg, batch_pgdat, batch_idx,
+					 batch_size, batch_nr);
 }
 
 #else /* CONFIG_MEMCG_KMEM */
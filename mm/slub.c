@@ -2446,6 +2446,8 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	c->tid = next_tid(c->tid);
 }
 
+static void flush_cpu_array(struct kmem_cache *s, int cpu);
+
 /*
  * Flush cpu slab.
  *
@@ -2455,6 +2457,10 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	/* First, so that objects freed to the cpu slab get flushed too */
+	if (s->cpu_array)
+		flush_cpu_array(s, cpu);
+
 	if (c->page)
 		flush_slab(s, c);
 
@@ -2473,6 +2479,9 @@ static bool has_cpu_slab(int cpu, void *info)
 	struct kmem_cache *s = info;
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	if (s->cpu_array && per_cpu_ptr(s->cpu_array, cpu)->used)
+		return true;
+
 	return c->page || slub_percpu_partial(c);
 }
 
@@ -2812,6 +2821,8 @@ static __always_inline void maybe_wipe_obj_freeptr(struct kmem_cache *s,
 			0, sizeof(void *));
 }
 
+static void *alloc_from_pca(struct kmem_cache *s, gfp_t gfp);
+
 /*
  * Inlined fastpath so that allocation functions (kmalloc, kmem_cache_alloc)
  * have the fastpath folded into their functions. So no function call
@@ -2840,6 +2851,12 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 	if (unlikely(object))
 		goto out;
 
+	if (s->cpu_array && node == NUMA_NO_NODE) {
+		object = alloc_from_pca(s, gfpflags);
+		if (likely(object))
+			goto wipe;
+	}
+
 redo:
 	/*
 	 * Must read kmem_cache cpu data via this cpu ptr. Preemption is
@@ -2907,6 +2924,7 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 		stat(s, ALLOC_FASTPATH);
 	}
 
+wipe:
 	maybe_wipe_obj_freeptr(s, object);
 	init = slab_want_init_on_alloc(gfpflags, s);
 
@@ -3157,6 +3175,8 @@ static __always_inline void do_slab_free(struct kmem_cache *s,
 
 }
 
+static void free_to_pca(struct kmem_cache *s, void *head, void *tail);
+
 static __always_inline void slab_free(struct kmem_cache *s, struct page *page,
 				      void *head, void *tail, int cnt,
 				      unsigned long addr)
@@ -3165,8 +3185,16 @@ static __always_inline void slab_free(struct kmem_cache *s, struct page *page,
 	 * With KASAN enabled slab_free_freelist_hook modifies the freelist
 	 * to remove objects, whose reuse must be delayed.
 	 */
-	if (slab_free_freelist_hook(s, &head, &tail))
-		do_slab_free(s, page, head, tail, cnt, addr);
+	if (!slab_free_freelist_hook(s, &head, &tail))
+		return;
+
+	if (s->cpu_array && !is_kfence_address(head)) {
+		memcg_slab_free_hook(s, &head, 1);
+		free_to_pca(s, head, tail);
+		return;
+	}
+
+	do_slab_free(s, page, head, tail, cnt, addr);
 }
 
 #ifdef CONFIG_KASAN_GENERIC
@@ -3303,24 +3331,42 @@ void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
 }
 EXPORT_SYMBOL(kmem_cache_free_bulk);
 
-/* Note that interrupts must be enabled when calling this function. */
-int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
-			  void **p)
+/*
+ * Return objects that already went through the free hooks to their slabs.
+ * The objects in @p are consumed.
+ */
+static void __slab_free_bulk(struct kmem_cache *s, size_t size, void **p)
+{
+	do {
+		struct detached_freelist df;
+
+		size = build_detached_freelist(s, size, p, &df);
+		if (!df.page)
+			continue;
+
+		do_slab_free(df.s, df.page, df.freelist, df.tail, df.cnt,
+			     _RET_IP_);
+	} while (likely(size));
+}
+
+/*
+ * Take objects from the slabs without running the allocation hooks.
+ * Returns the number of objects placed in @p, which can be less than
+ * @size if memory runs out.
+ */
+static int __slab_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			     void **p)
 {
 	struct kmem_cache_cpu *c;
+	unsigned long irqflags;
 	int i;
-	struct obj_cgroup *objcg = NULL;
 
-	/* memcg and kmem_cache debug support */
-	s = slab_pre_alloc_hook(s, &objcg, size, flags);
-	if (unlikely(!s))
-		return false;
 	/*
 	 * Drain objects in the per cpu slab, while disabling local
 	 * IRQs, which protects against PREEMPT and interrupts
 	 * handlers invoking normal fastpath.
 	 */
-	local_irq_disable();
+	local_irq_save(irqflags);
 	c = this_cpu_ptr(s->cpu_slab);
 
 	for (i = 0; i < size; i++) {
@@ -3349,7 +3395,7 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 			p[i] = ___slab_alloc(s, flags, NUMA_NO_NODE,
 					    _RET_IP_, c);
 			if (unlikely(!p[i]))
-				goto error;
+				break;
 
 			c = this_cpu_ptr(s->cpu_slab);
 			maybe_wipe_obj_freeptr(s, p[i]);
@@ -3361,7 +3407,26 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 		maybe_wipe_obj_freeptr(s, p[i]);
 	}
 	c->tid = next_tid(c->tid);
-	local_irq_enable();
+	local_irq_restore(irqflags);
+
+	return i;
+}
+
+/* Note that interrupts must be enabled when calling this function. */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			  void **p)
+{
+	int i;
+	struct obj_cgroup *objcg = NULL;
+
+	/* memcg and kmem_cache debug support */
+	s = slab_pre_alloc_hook(s, &objcg, size, flags);
+	if (unlikely(!s))
+		return false;
+
+	i = __slab_alloc_bulk(s, flags, size, p);
+	if (unlikely(i < size))
+		goto error;
 
 	/*
 	 * memcg and kmem_cache debug support and memory initialization.
@@ -3371,13 +3436,163 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 				slab_want_init_on_alloc(flags, s));
 	return i;
 error:
-	local_irq_enable();
 	slab_post_alloc_hook(s, objcg, flags, i, p, false);
 	__kmem_cache_free_bulk(s, i, p);
 	return 0;
 }
 EXPORT_SYMBOL(kmem_cache_alloc_bulk);
 
+/*
+ * Per cpu arrays of free objects.
+ *
+ * The lockless cpu slab freelist only helps while objects are freed on
+ * the cpu whose slab they came from.  Caches that see frees on other
+ * cpus, or bursts of allocations larger than a slab, can put an array
+ * of objects in front of it that is filled and drained in batches from
+ * and to the slabs.  Objects in the array have been through the free
+ * hooks and get the allocation hooks when they are handed out again.
+ */
+#define PCA_BATCH_MAX	32
+
+static void *alloc_from_pca(struct kmem_cache *s, gfp_t gfp)
+{
+	void *objects[PCA_BATCH_MAX];
+	struct slub_percpu_array *pca;
+	unsigned long flags;
+	unsigned int batch;
+	void *object;
+	int nr, i;
+
+	local_lock_irqsave(&s->cpu_array->lock, flags);
+	pca = this_cpu_ptr(s->cpu_array);
+	if (likely(pca->used)) {
+		object = pca->objects[--pca->used];
+		local_unlock_irqrestore(&s->cpu_array->lock, flags);
+		stat(s, ALLOC_PCA);
+		return object;
+	}
+	batch = pca->batch;
+	local_unlock_irqrestore(&s->cpu_array->lock, flags);
+
+	/* Allocating a new slab may need interrupts enabled */
+	nr = __slab_alloc_bulk(s, gfp, batch, objects);
+	if (unlikely(!nr))
+		return NULL;
+	stat(s, PCA_REFILL);
+
+	/* Keep one for the caller and stash what fits of the rest */
+	object = objects[--nr];
+	local_lock_irqsave(&s->cpu_array->lock, flags);
+	pca = this_cpu_ptr(s->cpu_array);
+	for (i = 0; i < nr && pca->used < pca->count; i++)
+		pca->objects[pca->used++] = objects[i];
+	local_unlock_irqrestore(&s->cpu_array->lock, flags);
+
+	if (unlikely(i < nr))
+		__slab_free_bulk(s, nr - i, objects + i);
+
+	return object;
+}
+
+/*
+ * Push the freelist @head..@tail onto this cpu's array.  When the array is
+ * full, its oldest and most likely cache cold objects go back to the slabs.
+ */
+static void free_to_pca(struct kmem_cache *s, void *head, void *tail)
+{
+	void *tail_obj = tail ? : head;
+	struct slub_percpu_array *pca;
+	unsigned long flags;
+	void *object = head;
+
+	local_lock_irqsave(&s->cpu_array->lock, flags);
+	pca = this_cpu_ptr(s->cpu_array);
+
+	for (;;) {
+		void *next = NULL;
+
+		if (object != tail_obj)
+			next = get_freepointer(s, object);
+
+		if (unlikely(pca->used == pca->count)) {
+			unsigned int batch = pca->batch;
+
+			__slab_free_bulk(s, batch, pca->objects);
+			pca->used -= batch;
+			memmove(pca->objects, pca->objects + batch,
+				pca->used * sizeof(void *));
+			stat(s, PCA_FLUSH);
+		}
+		pca->objects[pca->used++] = object;
+		stat(s, FREE_PCA);
+
+		if (!next)
+			break;
+		object = next;
+	}
+
+	local_unlock_irqrestore(&s->cpu_array->lock, flags);
+}
+
+/*
+ * Return all objects held in the array of @cpu.  For the current cpu this
+ * is called with interrupts disabled, like the rest of the cpu slab
+ * flushing; otherwise @cpu is dead.
+ */
+static void flush_cpu_array(struct kmem_cache *s, int cpu)
+{
+	struct slub_percpu_array *pca = per_cpu_ptr(s->cpu_array, cpu);
+
+	if (!pca->used)
+		return;
+
+	__slab_free_bulk(s, pca->used, pca->objects);
+	pca->used = 0;
+	stat(s, PCA_FLUSH);
+}
+
+/**
+ * kmem_cache_setup_percpu_array - cache free objects in per cpu arrays
+ * @s: the cache
+ * @count: number of objects each cpu may hold
+ *
+ * Meant for hot caches whose objects are often freed on a different cpu
+ * than they were allocated on.  Caches with debugging enabled keep using
+ * the slabs directly, so that every object is seen by the debug checks.
+ *
+ * Return: 0 on success or if the array is not used, -ENOMEM otherwise.
+ */
+int kmem_cache_setup_percpu_array(struct kmem_cache *s, unsigned int count)
+{
+	struct slub_percpu_array __percpu *cpu_array;
+	int cpu;
+
+	if (WARN_ON_ONCE(!count || s->cpu_array))
+		return -EINVAL;
+
+	if (kmem_cache_debug(s))
+		return 0;
+
+	cpu_array = __alloc_percpu(sizeof(struct slub_percpu_array) +
+				   count * sizeof(void *), sizeof(void *));
+	if (!cpu_array)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct slub_percpu_array *pca = per_cpu_ptr(cpu_array, cpu);
+
+		local_lock_init(&pca->lock);
+		pca->count = count;
+		pca->batch = clamp(count / 2, 1U, (unsigned int)PCA_BATCH_MAX);
+		pca->used = 0;
+	}
+
+	/* Publish the initialized arrays to the lockless fast paths */
+	smp_store_release(&s->cpu_array, cpu_array);
+	return 0;
+}
+EXPORT_SYMBOL(kmem_cache_setup_percpu_array);
+
 
 /*
  * Object placement in a slab is made very easy because we always start at
@@ -3611,6 +3826,7 @@ static void free_kmem_cache_nodes(struct kmem_cache *s)
 void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
+	free_percpu(s->cpu_array);
 	free_percpu(s->cpu_slab);
 	free_kmem_cache_nodes(s);
 }
@@ -5493,6 +5709,10 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(ALLOC_PCA, alloc_cpu_cache);
+STAT_ATTR(FREE_PCA, free_cpu_cache);
+STAT_ATTR(PCA_REFILL, cpu_cache_refill);
+STAT_ATTR(PCA_FLUSH, cpu_cache_flush);
 #endif	/* CONFIG_SLUB_STATS */
 
 static struct attribute *slab_attrs[] = {
@@ -5559,6 +5779,10 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&alloc_cpu_cache_attr.attr,
+	&free_cpu_cache_attr.attr,
+	&cpu_cache_refill_attr.attr,
+	&cpu_cache_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -234,10 +234,12 @@ sector_t swap_page_sector(struct page *page)
 
 /*
  * swap allocation tell device that a cluster of swap can now be discarded,
- * to allow the swap device to optimize its wear-levelling.
+ * to allow the swap device to optimize its wear-levelling.  The discards
+ * are only queued onto *biop, the caller submits and waits for them.
  */
 static void discard_swap_cluster(struct swap_info_struct *si,
-				 pgoff_t start_page, pgoff_t nr_pages)
+				 pgoff_t start_page, pgoff_t nr_pages,
+				 struct bio **biop)
 {
 	struct swap_extent *se = offset_to_swap_extent(si, start_page);
 
@@ -253,8 +255,8 @@ static void discard_swap_cluster(struct swap_info_struct *si,
 
 		start_block <<= PAGE_SHIFT - 9;
 		nr_blocks <<= PAGE_SHIFT - 9;
-		if (blkdev_issue_discard(si->bdev, start_block,
-					nr_blocks, GFP_NOIO, 0))
+		if (__blkdev_issue_discard(si->bdev, start_block,
+					nr_blocks, GFP_NOIO, 0, biop))
 			break;
 
 		se = next_se(se);
@@ -480,23 +482,58 @@ static void __free_cluster(struct swap_info_struct *si, unsigned long idx)
 static void swap_do_scheduled_discard(struct swap_info_struct *si)
 {
 	struct swap_cluster_info *info, *ci;
-	unsigned int idx;
+	struct swap_cluster_list batch;
+	unsigned int idx, start, nr;
+	struct blk_plug plug;
+	struct bio *bio;
 
 	info = si->cluster_info;
 
 	while (!cluster_list_empty(&si->discard_clusters)) {
-		idx = cluster_list_del_first(&si->discard_clusters, info);
+		/*
+		 * Take every cluster scheduled so far and discard them as one
+		 * batch: runs of adjacent clusters become a single range, and
+		 * all ranges are in flight together with only one wait.
+		 * Nobody else links into the batch once it is off
+		 * si->discard_clusters, so it can be walked unlocked.
+		 */
+		batch = si->discard_clusters;
+		cluster_list_init(&si->discard_clusters);
 		spin_unlock(&si->lock);
 
-		discard_swap_cluster(si, idx * SWAPFILE_CLUSTER,
-				SWAPFILE_CLUSTER);
+		bio = NULL;
+		blk_start_plug(&plug);
+		idx = start = cluster_list_first(&batch);
+		nr = 0;
+		while (1) {
+			if (idx != start + nr) {
+				discard_swap_cluster(si, start * SWAPFILE_CLUSTER,
+						     nr * SWAPFILE_CLUSTER, &bio);
+				start = idx;
+				nr = 0;
+			}
+			nr++;
+			if (idx == cluster_next(&batch.tail))
+				break;
+			idx = cluster_next(&info[idx]);
+		}
+		discard_swap_cluster(si, start * SWAPFILE_CLUSTER,
+				     nr * SWAPFILE_CLUSTER, &bio);
+		if (bio) {
+			submit_bio_wait(bio);
+			bio_put(bio);
+		}
+		blk_finish_plug(&plug);
 
 		spin_lock(&si->lock);
-		ci = lock_cluster(si, idx * SWAPFILE_CLUSTER);
-		__free_cluster(si, idx);
-		memset(si->swap_map + idx * SWAPFILE_CLUSTER,
-				0, SWAPFILE_CLUSTER);
-		unlock_cluster(ci);
+		while (!cluster_list_empty(&batch)) {
+			idx = cluster_list_del_first(&batch, info);
+			ci = lock_cluster(si, idx * SWAPFILE_CLUSTER);
+			__free_cluster(si, idx);
+			memset(si->swap_map + idx * SWAPFILE_CLUSTER,
+					0, SWAPFILE_CLUSTER);
+			unlock_cluster(ci);
+		}
 	}
 }
 
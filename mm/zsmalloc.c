@@ -1683,6 +1683,15 @@ static int migrate_zspage(struct zs_pool *pool, struct size_class *class,
 		record_obj(handle, free_obj);
 		unpin_tag(handle);
 		obj_free(class, used_obj);
+
+		/*
+		 * zs_malloc() and zs_free() are spinning on the class lock;
+		 * let them in rather than finishing the whole zspage.
+		 */
+		if (spin_is_contended(&class->lock)) {
+			ret = -EAGAIN;
+			break;
+		}
 	}
 
 	/* Remember last position in this iteration */
@@ -2217,6 +2226,7 @@ static unsigned long __zs_compact(struct zs_pool *pool,
 	struct zspage *src_zspage;
 	struct zspage *dst_zspage = NULL;
 	unsigned long pages_freed = 0;
+	int ret;
 
 	spin_lock(&class->lock);
 	while ((src_zspage = isolate_zspage(class, true))) {
@@ -2233,7 +2243,8 @@ static unsigned long __zs_compact(struct zs_pool *pool,
 			 * If there is no more space in dst_page, resched
 			 * and see if anyone had allocated another zspage.
 			 */
-			if (!migrate_zspage(pool, class, &cc))
+			ret = migrate_zspage(pool, class, &cc);
+			if (ret != -ENOMEM)
 				break;
 
 			putback_zspage(class, dst_zspage);
@@ -2248,6 +2259,12 @@ static unsigned long __zs_compact(struct zs_pool *pool,
 			free_zspage(pool, class, src_zspage);
 			pages_freed += class->pages_per_zspage;
 		}
+		/*
+		 * A partially migrated source is back on the fullness lists
+		 * and gets picked up again by isolate_zspage() afterwards.
+		 */
+		if (ret == -EAGAIN)
+			atomic_long_inc(&pool->stats.compact_stalls);
 		spin_unlock(&class->lock);
 		cond_resched();
 		spin_lock(&class->lock);
@@ -35,6 +35,7 @@
 #include <linux/writeback.h>
 #include <linux/pagemap.h>
 #include <linux/workqueue.h>
+#include <linux/shrinker.h>
 
 /*********************************
 * statistics
@@ -67,6 +68,8 @@ static u64 zswap_reject_alloc_fail;
 static u64 zswap_reject_kmemcache_fail;
 /* Duplicate store was encountered (rare) */
 static u64 zswap_duplicate_entry;
+/* Pool pages freed by the memory pressure shrinker */
+static u64 zswap_shrinker_reclaimed;
 
 /* Shrinker work queue */
 static struct workqueue_struct *shrink_wq;
@@ -125,6 +128,13 @@ static bool zswap_same_filled_pages_enabled = true;
 module_param_named(same_filled_pages_enabled, zswap_same_filled_pages_enabled,
 		   bool, 0644);
 
+/*
+ * Write back the coldest compressed pages under memory pressure instead of
+ * only when the pool limit is hit (disabled by default)
+ */
+static bool zswap_shrinker_enabled;
+module_param_named(shrinker_enabled, zswap_shrinker_enabled, bool, 0644);
+
 /*********************************
 * data structures
 **********************************/
@@ -582,6 +592,54 @@ static void shrink_worker(struct work_struct *w)
 	zswap_pool_put(pool);
 }
 
+/*
+ * The shrinker counts in pages of the compressed pool.  Reclaiming them
+ * goes through zpool_shrink(), which evicts from the tail of the
+ * allocator's LRU, so the entries written back are those stored longest
+ * ago.  Same-value filled pages have no pool storage and are never
+ * considered.
+ */
+static unsigned long zswap_shrinker_count(struct shrinker *shrinker,
+					  struct shrink_control *sc)
+{
+	if (!zswap_enabled || !zswap_shrinker_enabled)
+		return 0;
+
+	return zswap_pool_total_size >> PAGE_SHIFT;
+}
+
+static unsigned long zswap_shrinker_scan(struct shrinker *shrinker,
+					 struct shrink_control *sc)
+{
+	struct zswap_pool *pool;
+	unsigned int reclaimed = 0;
+
+	/* writeback allocates swap cache pages and issues swap I/O */
+	if (!(sc->gfp_mask & __GFP_IO))
+		return SHRINK_STOP;
+
+	pool = zswap_pool_current_get();
+	if (!pool)
+		return SHRINK_STOP;
+
+	if (zpool_evictable(pool->zpool) &&
+	    zpool_shrink(pool->zpool, sc->nr_to_scan, &reclaimed))
+		zswap_reject_reclaim_fail++;
+	zswap_pool_put(pool);
+
+	if (!reclaimed)
+		return SHRINK_STOP;
+
+	zswap_shrinker_reclaimed += reclaimed;
+	return reclaimed;
+}
+
+static struct shrinker zswap_shrinker = {
+	.count_objects = zswap_shrinker_count,
+	.scan_objects = zswap_shrinker_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
 static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 {
 	struct zswap_pool *pool;
@@ -1418,6 +1476,8 @@ static int __init zswap_debugfs_init(void)
 			   zswap_debugfs_root, &zswap_written_back_pages);
 	debugfs_create_u64("duplicate_entry", 0444,
 			   zswap_debugfs_root, &zswap_duplicate_entry);
+	debugfs_create_u64("shrinker_reclaimed_pages", 0444,
+			   zswap_debugfs_root, &zswap_shrinker_reclaimed);
 	debugfs_create_u64("pool_total_size", 0444,
 			   zswap_debugfs_root, &zswap_pool_total_size);
 	debugfs_create_atomic_t("stored_pages", 0444,
@@ -1485,6 +1545,9 @@ static int __init init_zswap(void)
 	if (!shrink_wq)
 		goto fallback_fail;
 
+	if (register_shrinker(&zswap_shrinker))
+		pr_warn("shrinker registration failed\n");
+
 	frontswap_register_ops(&zswap_frontswap_ops);
 	if (zswap_debugfs_init())
 		pr_warn("debugfs initialization failed\n");
@@ -72,6 +72,7 @@
 #include <linux/bitops.h>
 #include <linux/capability.h>
 #include <linux/cpu.h>
+#include <linux/cpuset.h>
 #include <linux/types.h>
 #include <linux/kernel.h>
 #include <linux/hash.h>
@@ -1563,6 +1564,7 @@ static int napi_kthread_create(struct napi_struct *n)
 	 * TASK_INTERRUPTIBLE mode to avoid the blocked task
 	 * warning and work with loadavg.
 	 */
+	n->thread_cpu = -1;
 	n->thread = kthread_run(napi_threaded_poll, n, "napi/%s-%d",
 				n->dev->name, n->napi_id);
 	if (IS_ERR(n->thread)) {
@@ -3852,10 +3854,34 @@ static inline int __dev_xmit_skb(struct sk_buff *skb, struct Qdisc *q,
 	qdisc_calculate_pkt_len(skb, q);
 
 	if (q->flags & TCQ_F_NOLOCK) {
+		if (q->flags & TCQ_F_CAN_BYPASS && nolock_qdisc_is_empty(q) &&
+		    qdisc_run_begin(q)) {
+			/* Retest nolock_qdisc_is_empty() within the protection
+			 * of q->seqlock to protect from racing with requeuing.
+			 */
+			if (unlikely(!nolock_qdisc_is_empty(q))) {
+				rc = q->enqueue(skb, q, &to_free) &
+					NET_XMIT_MASK;
+				__qdisc_run(q);
+				qdisc_run_end(q);
+
+				goto no_lock_out;
+			}
+
+			qdisc_bstats_cpu_update(q, skb);
+			if (sch_direct_xmit(skb, q, dev, txq, NULL, true) &&
+			    !nolock_qdisc_is_empty(q))
+				__qdisc_run(q);
+
+			qdisc_run_end(q);
+			return NET_XMIT_SUCCESS;
+		}
+
 		rc = q->enqueue(skb, q, &to_free) & NET_XMIT_MASK;
 		if (likely(!netif_xmit_frozen_or_stopped(txq)))
 			qdisc_run(q);
 
+no_lock_out:
 		if (unlikely(to_free))
 			kfree_skb_list(to_free);
 		return rc;
@@ -4335,6 +4361,7 @@ int netdev_tstamp_prequeue __read_mostly = 1;
 int netdev_budget __read_mostly = 300;
 /* Must be at least 2 jiffes to guarantee 1 jiffy timeout */
 unsigned int __read_mostly netdev_budget_usecs = 2 * USEC_PER_SEC / HZ;
+unsigned int sysctl_skb_defer_max __read_mostly = 64;
 int weight_p __read_mostly = 64;           /* old backlog weight */
 int dev_weight_rx_bias __read_mostly = 1;  /* bias for backlog weight */
 int dev_weight_tx_bias __read_mostly = 1;  /* bias for output_queue quota */
@@ -4358,6 +4385,9 @@ static inline void ____napi_schedule(struct softnet_data *sd,
 		 */
 		thread = READ_ONCE(napi->thread);
 		if (thread) {
+			/* Tells the thread where the interrupt came in */
+			if (READ_ONCE(napi->sched_cpu) != smp_processor_id())
+				WRITE_ONCE(napi->sched_cpu, smp_processor_id());
 			/* Avoid doing set_bit() if the thread is in
 			 * INTERRUPTIBLE state, cause napi_thread_wait()
 			 * makes sure to proceed with napi polling
@@ -4583,6 +4613,15 @@ static void rps_trigger_softirq(void *data)
 
 #endif /* CONFIG_RPS */
 
+/* Called from hardirq (IPI) context */
+static void trigger_rx_softirq(void *data)
+{
+	struct softnet_data *sd = data;
+
+	__raise_softirq_irqoff(NET_RX_SOFTIRQ);
+	smp_store_release(&sd->defer_ipi_scheduled, 0);
+}
+
 /*
  * Check if this softnet_data structure is another cpu one
  * If yes, queue it to our IPI list and return 1
@@ -5888,6 +5927,7 @@ static int napi_gro_complete(struct napi_struct *napi, struct sk_buff *skb)
 
 	BUILD_BUG_ON(sizeof(struct napi_gro_cb) > sizeof(skb->cb));
 
+	napi->gro_stats.flushed++;
 	if (NAPI_GRO_CB(skb)->count == 1) {
 		skb_shinfo(skb)->gso_size = 0;
 		goto out;
@@ -6041,21 +6081,33 @@ static void gro_flush_oldest(struct napi_struct *napi, struct list_head *head)
 	 * SKB to the chain.
 	 */
 	skb_list_del_init(oldest);
+	napi->gro_stats.evicted++;
 	napi_gro_complete(napi, oldest);
 }
 
 static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 {
-	u32 bucket = skb_get_hash_raw(skb) & (GRO_HASH_BUCKETS - 1);
-	struct gro_list *gro_list = &napi->gro_hash[bucket];
 	struct list_head *head = &offload_base;
 	struct packet_offload *ptype;
 	__be16 type = skb->protocol;
+	struct gro_list *gro_list;
 	struct sk_buff *pp = NULL;
 	enum gro_result ret;
+	u32 bucket;
 	int same_flow;
 	int grow;
 
+	/* Without a device provided hash every flow would land in bucket
+	 * 0 and evict each other once MAX_GRO_SKBS of them are held.  The
+	 * software hash is kept in the skb and reused by RPS and sockets.
+	 */
+	if (unlikely(!skb->hash) && !netif_elide_gro(skb->dev)) {
+		skb_set_network_header(skb, skb_gro_offset(skb));
+		__skb_get_hash(skb);
+	}
+	bucket = skb_get_hash_raw(skb) & (GRO_HASH_BUCKETS - 1);
+	gro_list = &napi->gro_hash[bucket];
+
 	if (netif_elide_gro(skb->dev))
 		goto normal;
 
@@ -6110,6 +6162,8 @@ static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff
 
 	same_flow = NAPI_GRO_CB(skb)->same_flow;
 	ret = NAPI_GRO_CB(skb)->free ? GRO_MERGED_FREE : GRO_MERGED;
+	if (same_flow)
+		napi->gro_stats.merged++;
 
 	if (pp) {
 		skb_list_del_init(pp);
@@ -6133,6 +6187,7 @@ static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff
 	NAPI_GRO_CB(skb)->last = skb;
 	skb_shinfo(skb)->gso_size = skb_gro_len(skb);
 	list_add(&skb->list, &gro_list->list);
+	napi->gro_stats.held++;
 	ret = GRO_HELD;
 
 pull:
@@ -6863,6 +6918,89 @@ int dev_set_threaded(struct net_device *dev, bool threaded)
 }
 EXPORT_SYMBOL(dev_set_threaded);
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+DEFINE_STATIC_KEY_FALSE(napi_threaded_colocate_key);
+EXPORT_SYMBOL(napi_threaded_colocate_key);
+
+/* Record the cpu that consumed data of a socket fed by @napi_id */
+void napi_note_consumer(unsigned int napi_id)
+{
+	int cpu = raw_smp_processor_id();
+	struct napi_struct *napi;
+
+	rcu_read_lock();
+	napi = napi_by_id(napi_id);
+	if (napi && READ_ONCE(napi->consumer_cpu) != cpu)
+		WRITE_ONCE(napi->consumer_cpu, cpu);
+	rcu_read_unlock();
+}
+EXPORT_SYMBOL(napi_note_consumer);
+#endif
+
+/**
+ *	dev_set_threaded_policy - choose where napi threads of a device run
+ *	@dev: device
+ *	@policy: NAPI_THREADED_FLOAT leaves the threads wherever their
+ *		cpuset allows, NAPI_THREADED_IRQ pins each thread to the
+ *		cpu its napi was last scheduled from, NAPI_THREADED_SOCKET
+ *		to the cpu that last read from a socket fed by its napi.
+ *
+ *	The threads apply the policy the next time they are woken up.
+ *	NAPI_THREADED_SOCKET needs CONFIG_NET_RX_BUSY_POLL for the socket to
+ *	napi mapping.  Caller must hold the rtnl lock.
+ */
+int dev_set_threaded_policy(struct net_device *dev,
+			    enum napi_threaded_policy policy)
+{
+	ASSERT_RTNL();
+
+	if (policy >= __NAPI_THREADED_MAX)
+		return -EINVAL;
+#ifndef CONFIG_NET_RX_BUSY_POLL
+	if (policy == NAPI_THREADED_SOCKET)
+		return -EOPNOTSUPP;
+#else
+	if (dev->threaded_policy == policy)
+		return 0;
+	if (policy == NAPI_THREADED_SOCKET)
+		static_branch_inc(&napi_threaded_colocate_key);
+	else if (dev->threaded_policy == NAPI_THREADED_SOCKET)
+		static_branch_dec(&napi_threaded_colocate_key);
+#endif
+	WRITE_ONCE(dev->threaded_policy, policy);
+
+	return 0;
+}
+EXPORT_SYMBOL(dev_set_threaded_policy);
+
+/**
+ *	dev_set_threaded_adaptive - let napi threads fall back to softirq
+ *	@dev: device
+ *	@adaptive: enable or disable
+ *
+ *	With @adaptive set, a napi thread that keeps being woken up for
+ *	little work hands its napi back to softirq processing, and a napi
+ *	that keeps exhausting its budget in softirq goes back to its
+ *	thread.  Has no effect unless threaded mode is enabled.
+ */
+void dev_set_threaded_adaptive(struct net_device *dev, bool adaptive)
+{
+	struct napi_struct *napi;
+
+	WRITE_ONCE(dev->threaded_adaptive, adaptive);
+	if (adaptive || !dev->threaded)
+		return;
+
+	/* Put back napis that were handed to softirq processing */
+	list_for_each_entry(napi, &dev->napi_list, dev_list) {
+		napi->thread_idle = 0;
+		napi->thread_busy = 0;
+		if (napi->thread)
+			set_bit(NAPI_STATE_THREADED, &napi->state);
+	}
+}
+EXPORT_SYMBOL(dev_set_threaded_adaptive);
+
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
@@ -6883,6 +7021,9 @@ void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 				weight);
 	napi->weight = weight;
 	napi->dev = dev;
+	napi->sched_cpu = -1;
+	napi->consumer_cpu = -1;
+	napi->thread_cpu = -1;
 #ifdef CONFIG_NETPOLL
 	napi->poll_owner = -1;
 #endif
@@ -7039,6 +7180,33 @@ static int __napi_poll(struct napi_struct *n, bool *repoll)
 	return work;
 }
 
+/* A threaded napi is handed back to softirq processing after this many
+ * consecutive thread wakeups that each did less than a quarter of the
+ * napi weight, and returns to its thread after this many consecutive
+ * softirq polls that used up the whole budget.
+ */
+#define NAPI_THREADED_IDLE_WAKEUPS	64
+#define NAPI_THREADED_BUSY_POLLS	4
+
+/* Called from softirq for a threaded napi that was handed to softirq */
+static void napi_softirq_adapt(struct napi_struct *n, bool busy)
+{
+	if (!READ_ONCE(n->dev->threaded_adaptive) || !busy) {
+		n->thread_busy = 0;
+		return;
+	}
+
+	if (++n->thread_busy < NAPI_THREADED_BUSY_POLLS)
+		return;
+
+	/* The switch takes effect on the next napi_schedule(), the same
+	 * as for dev_set_threaded().
+	 */
+	n->thread_busy = 0;
+	n->thread_stats.to_thread++;
+	set_bit(NAPI_STATE_THREADED, &n->state);
+}
+
 static int napi_poll(struct napi_struct *n, struct list_head *repoll)
 {
 	bool do_repoll = false;
@@ -7051,6 +7219,10 @@ static int napi_poll(struct napi_struct *n, struct list_head *repoll)
 
 	work = __napi_poll(n, &do_repoll);
 
+	if (unlikely(n->thread) && READ_ONCE(n->dev->threaded) &&
+	    !test_bit(NAPI_STATE_THREADED, &n->state))
+		napi_softirq_adapt(n, do_repoll);
+
 	if (do_repoll)
 		list_add_tail(&n->poll_list, repoll);
 
@@ -7087,32 +7259,117 @@ static int napi_thread_wait(struct napi_struct *napi)
 	return -1;
 }
 
+/* Move the napi thread according to the device's threaded_policy */
+static void napi_thread_update_affinity(struct napi_struct *napi)
+{
+	cpumask_var_t mask;
+	int cpu;
+
+	switch (READ_ONCE(napi->dev->threaded_policy)) {
+	case NAPI_THREADED_IRQ:
+		cpu = READ_ONCE(napi->sched_cpu);
+		break;
+	case NAPI_THREADED_SOCKET:
+		cpu = READ_ONCE(napi->consumer_cpu);
+		break;
+	default:
+		cpu = -1;
+		break;
+	}
+
+	if (cpu == napi->thread_cpu)
+		return;
+
+	if (cpu >= 0) {
+		/* Keep the previous placement until there is a valid cpu */
+		if (!cpu_online(cpu) ||
+		    set_cpus_allowed_ptr(current, cpumask_of(cpu)))
+			return;
+	} else {
+		/* Float again, within whatever cpuset the thread is in */
+		if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+			return;
+		cpuset_cpus_allowed(current, mask);
+		set_cpus_allowed_ptr(current, mask);
+		free_cpumask_var(mask);
+	}
+	napi->thread_cpu = cpu;
+}
+
+/* Called from the napi thread after each wakeup with the work it did */
+static void napi_thread_adapt(struct napi_struct *napi, int work)
+{
+	if (!READ_ONCE(napi->dev->threaded_adaptive) ||
+	    work >= napi->weight / 4) {
+		napi->thread_idle = 0;
+		return;
+	}
+
+	if (++napi->thread_idle < NAPI_THREADED_IDLE_WAKEUPS)
+		return;
+
+	/* Not worth a context switch per interrupt, let softirq do it */
+	napi->thread_idle = 0;
+	napi->thread_stats.to_softirq++;
+	clear_bit(NAPI_STATE_THREADED, &napi->state);
+}
+
 static int napi_threaded_poll(void *data)
 {
 	struct napi_struct *napi = data;
 	void *have;
 
 	while (!napi_thread_wait(napi)) {
+		int work = 0;
+
+		napi_thread_update_affinity(napi);
+
 		for (;;) {
 			bool repoll = false;
 
 			local_bh_disable();
 
 			have = netpoll_poll_lock(napi);
-			__napi_poll(napi, &repoll);
+			work += __napi_poll(napi, &repoll);
 			netpoll_poll_unlock(have);
 
 			local_bh_enable();
 
+			napi->thread_stats.polls++;
 			if (!repoll)
 				break;
 
+			napi->thread_stats.time_squeeze++;
 			cond_resched();
 		}
+
+		napi->thread_stats.packets += work;
+		napi_thread_adapt(napi, work);
 	}
 	return 0;
 }
 
+static void skb_defer_free_flush(struct softnet_data *sd)
+{
+	struct sk_buff *skb, *next;
+
+	/* Paired with WRITE_ONCE() in skb_attempt_defer_free() */
+	if (!READ_ONCE(sd->defer_list))
+		return;
+
+	spin_lock_irq(&sd->defer_lock);
+	skb = sd->defer_list;
+	sd->defer_list = NULL;
+	sd->defer_count = 0;
+	spin_unlock_irq(&sd->defer_lock);
+
+	while (skb != NULL) {
+		next = skb->next;
+		napi_consume_skb(skb, 1);
+		skb = next;
+	}
+}
+
 static __latent_entropy void net_rx_action(struct softirq_action *h)
 {
 	struct softnet_data *sd = this_cpu_ptr(&softnet_data);
@@ -7129,6 +7386,8 @@ static __latent_entropy void net_rx_action(struct softirq_action *h)
 	for (;;) {
 		struct napi_struct *n;
 
+		skb_defer_free_flush(sd);
+
 		if (list_empty(&list)) {
 			if (!sd_has_rps_ipi_waiting(sd) && list_empty(&repoll))
 				return;
@@ -10797,8 +11056,12 @@ struct net_device *alloc_netdev_mqs(int sizeof_priv, const char *name,
 
 	dev_net_set(dev, &init_net);
 
-	dev->gso_max_size = GSO_MAX_SIZE;
+	dev->gso_max_size = GSO_LEGACY_MAX_SIZE;
+	dev->gso_ipv4_max_size = GSO_LEGACY_MAX_SIZE;
+	dev->tso_max_size = GSO_LEGACY_MAX_SIZE;
 	dev->gso_max_segs = GSO_MAX_SEGS;
+	dev->gro_max_size = GRO_LEGACY_MAX_SIZE;
+	dev->gro_ipv4_max_size = GRO_LEGACY_MAX_SIZE;
 	dev->upper_level = 1;
 	dev->lower_level = 1;
 #ifdef CONFIG_LOCKDEP
@@ -10896,6 +11159,11 @@ void free_netdev(struct net_device *dev)
 	list_for_each_entry_safe(p, n, &dev->napi_list, dev_list)
 		netif_napi_del(p);
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	if (dev->threaded_policy == NAPI_THREADED_SOCKET)
+		static_branch_dec(&napi_threaded_colocate_key);
+#endif
+
 #ifdef CONFIG_PCPU_DEV_REFCNT
 	free_percpu(dev->pcpu_refcnt);
 	dev->pcpu_refcnt = NULL;
@@ -11292,6 +11560,19 @@ static int dev_cpu_dead(unsigned int oldcpu)
 		input_queue_head_incr(oldsd);
 	}
 
+	/* Free skbs that were queued for deferred freeing on the offline CPU */
+	spin_lock_irq(&oldsd->defer_lock);
+	skb = oldsd->defer_list;
+	oldsd->defer_list = NULL;
+	oldsd->defer_count = 0;
+	spin_unlock_irq(&oldsd->defer_lock);
+	while (skb) {
+		struct sk_buff *next = skb->next;
+
+		__kfree_skb(skb);
+		skb = next;
+	}
+
 	return 0;
 }
 
@@ -11614,6 +11895,8 @@ static int __init net_dev_init(void)
 		INIT_CSD(&sd->csd, rps_trigger_softirq, sd);
 		sd->cpu = i;
 #endif
+		INIT_CSD(&sd->defer_csd, trigger_rx_softirq, sd);
+		spin_lock_init(&sd->defer_lock);
 
 		init_gro_hash(&sd->backlog);
 		sd->backlog.poll = process_backlog;
@@ -176,6 +176,67 @@ static int softnet_seq_show(struct seq_file *seq, void *v)
 	return 0;
 }
 
+/* One line per napi instance that has a kthread, see napi_threaded_poll() */
+static int napi_threads_seq_show(struct seq_file *seq, void *v)
+{
+	struct net *net = seq_file_single_net(seq);
+	struct napi_struct *napi;
+	struct net_device *dev;
+
+	seq_puts(seq, "iface napi_id pid threaded policy cpu polls packets "
+		      "time_squeeze to_softirq to_thread\n");
+
+	rcu_read_lock();
+	for_each_netdev_rcu(net, dev) {
+		list_for_each_entry_rcu(napi, &dev->napi_list, dev_list) {
+			struct task_struct *thread = READ_ONCE(napi->thread);
+
+			if (!thread)
+				continue;
+
+			seq_printf(seq, "%s %u %d %d %u %d %lu %lu %lu %lu %lu\n",
+				   dev->name, napi->napi_id,
+				   task_pid_nr(thread),
+				   test_bit(NAPI_STATE_THREADED, &napi->state),
+				   READ_ONCE(dev->threaded_policy),
+				   READ_ONCE(napi->thread_cpu),
+				   READ_ONCE(napi->thread_stats.polls),
+				   READ_ONCE(napi->thread_stats.packets),
+				   READ_ONCE(napi->thread_stats.time_squeeze),
+				   READ_ONCE(napi->thread_stats.to_softirq),
+				   READ_ONCE(napi->thread_stats.to_thread));
+		}
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+/* GRO counters of every napi instance, see dev_gro_receive() */
+static int napi_gro_seq_show(struct seq_file *seq, void *v)
+{
+	struct net *net = seq_file_single_net(seq);
+	struct napi_struct *napi;
+	struct net_device *dev;
+
+	seq_puts(seq, "iface napi_id merged held flushed evicted\n");
+
+	rcu_read_lock();
+	for_each_netdev_rcu(net, dev) {
+		list_for_each_entry_rcu(napi, &dev->napi_list, dev_list) {
+			seq_printf(seq, "%s %u %lu %lu %lu %lu\n",
+				   dev->name, napi->napi_id,
+				   READ_ONCE(napi->gro_stats.merged),
+				   READ_ONCE(napi->gro_stats.held),
+				   READ_ONCE(napi->gro_stats.flushed),
+				   READ_ONCE(napi->gro_stats.evicted));
+		}
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
 static const struct seq_operations dev_seq_ops = {
 	.start = dev_seq_start,
 	.next  = dev_seq_next,
@@ -293,12 +354,22 @@ static int __net_init dev_proc_net_init(struct net *net)
 	if (!proc_create_net("ptype", 0444, net->proc_net, &ptype_seq_ops,
 			sizeof(struct seq_net_private)))
 		goto out_softnet;
+	if (!proc_create_net_single("napi_threads", 0444, net->proc_net,
+				    napi_threads_seq_show, NULL))
+		goto out_ptype;
+	if (!proc_create_net_single("napi_gro", 0444, net->proc_net,
+				    napi_gro_seq_show, NULL))
+		goto out_napi;
 
 	if (wext_proc_init(net))
-		goto out_ptype;
+		goto out_gro;
 	rc = 0;
 out:
 	return rc;
+out_gro:
+	remove_proc_entry("napi_gro", net->proc_net);
+out_napi:
+	remove_proc_entry("napi_threads", net->proc_net);
 out_ptype:
 	remove_proc_entry("ptype", net->proc_net);
 out_softnet:
@@ -312,6 +383,8 @@ static void __net_exit dev_proc_net_exit(struct net *net)
 {
 	wext_proc_exit(net);
 
+	remove_proc_entry("napi_gro", net->proc_net);
+	remove_proc_entry("napi_threads", net->proc_net);
 	remove_proc_entry("ptype", net->proc_net);
 	remove_proc_entry("softnet_stat", net->proc_net);
 	remove_proc_entry("dev", net->proc_net);
@@ -577,6 +577,80 @@ static ssize_t threaded_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(threaded);
 
+static ssize_t threaded_policy_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct net_device *netdev = to_net_dev(dev);
+	ssize_t ret = -EINVAL;
+
+	if (!rtnl_trylock())
+		return restart_syscall();
+
+	if (dev_isalive(netdev))
+		ret = sprintf(buf, fmt_dec, netdev->threaded_policy);
+
+	rtnl_unlock();
+	return ret;
+}
+
+static int modify_napi_threaded_policy(struct net_device *dev,
+				       unsigned long val)
+{
+	if (list_empty(&dev->napi_list))
+		return -EOPNOTSUPP;
+
+	if (val >= __NAPI_THREADED_MAX)
+		return -EINVAL;
+
+	return dev_set_threaded_policy(dev, val);
+}
+
+static ssize_t threaded_policy_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t len)
+{
+	return netdev_store(dev, attr, buf, len, modify_napi_threaded_policy);
+}
+static DEVICE_ATTR_RW(threaded_policy);
+
+static ssize_t threaded_adaptive_show(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	struct net_device *netdev = to_net_dev(dev);
+	ssize_t ret = -EINVAL;
+
+	if (!rtnl_trylock())
+		return restart_syscall();
+
+	if (dev_isalive(netdev))
+		ret = sprintf(buf, fmt_dec, netdev->threaded_adaptive);
+
+	rtnl_unlock();
+	return ret;
+}
+
+static int modify_napi_threaded_adaptive(struct net_device *dev,
+					 unsigned long val)
+{
+	if (list_empty(&dev->napi_list))
+		return -EOPNOTSUPP;
+
+	if (val != 0 && val != 1)
+		return -EOPNOTSUPP;
+
+	dev_set_threaded_adaptive(dev, val);
+
+	return 0;
+}
+
+static ssize_t threaded_adaptive_store(struct device *dev,
+				       struct device_attribute *attr,
+				       const char *buf, size_t len)
+{
+	return netdev_store(dev, attr, buf, len, modify_napi_threaded_adaptive);
+}
+static DEVICE_ATTR_RW(threaded_adaptive);
+
 static struct attribute *net_class_attrs[] __ro_after_init = {
 	&dev_attr_netdev_group.attr,
 	&dev_attr_type.attr,
@@ -610,6 +684,8 @@ static struct attribute *net_class_attrs[] __ro_after_init = {
 	&dev_attr_carrier_up_count.attr,
 	&dev_attr_carrier_down_count.attr,
 	&dev_attr_threaded.attr,
+	&dev_attr_threaded_policy.attr,
+	&dev_attr_threaded_adaptive.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(net_class);
@@ -498,7 +498,8 @@ int sk_msg_recvmsg(struct sock *sk, struct sk_psock *psock, struct msghdr *msg,
 EXPORT_SYMBOL_GPL(sk_msg_recvmsg);
 
 static struct sk_msg *sk_psock_create_ingress_msg(struct sock *sk,
-						  struct sk_buff *skb)
+						  struct sk_buff *skb,
+						  gfp_t gfp)
 {
 	struct sk_msg *msg;
 
@@ -508,7 +509,7 @@ static struct sk_msg *sk_psock_create_ingress_msg(struct sock *sk,
 	if (!sk_rmem_schedule(sk, skb, skb->truesize))
 		return NULL;
 
-	msg = kzalloc(sizeof(*msg), __GFP_NOWARN | GFP_KERNEL);
+	msg = kzalloc(sizeof(*msg), __GFP_NOWARN | gfp);
 	if (unlikely(!msg))
 		return NULL;
 
@@ -542,14 +543,15 @@ static int sk_psock_skb_ingress_enqueue(struct sk_buff *skb,
 	msg->sg.end = num_sge;
 	msg->skb = skb;
 
+	/* the caller wakes up the reader, possibly once for several skbs */
 	sk_psock_queue_msg(psock, msg);
-	sk_psock_data_ready(sk, psock);
 	return copied;
 }
 
 static int sk_psock_skb_ingress_self(struct sk_psock *psock, struct sk_buff *skb);
 
-static int sk_psock_skb_ingress(struct sk_psock *psock, struct sk_buff *skb)
+static int sk_psock_skb_ingress(struct sk_psock *psock, struct sk_buff *skb,
+				gfp_t gfp)
 {
 	struct sock *sk = psock->sk;
 	struct sk_msg *msg;
@@ -560,7 +562,7 @@ static int sk_psock_skb_ingress(struct sk_psock *psock, struct sk_buff *skb)
 	 */
 	if (unlikely(skb->sk == sk))
 		return sk_psock_skb_ingress_self(psock, skb);
-	msg = sk_psock_create_ingress_msg(sk, skb);
+	msg = sk_psock_create_ingress_msg(sk, skb, gfp);
 	if (!msg)
 		return -EAGAIN;
 
@@ -598,15 +600,15 @@ static int sk_psock_handle_skb(struct sk_psock *psock, struct sk_buff *skb,
 			return -EAGAIN;
 		return skb_send_sock(psock->sk, skb, off, len);
 	}
-	return sk_psock_skb_ingress(psock, skb);
+	return sk_psock_skb_ingress(psock, skb, GFP_KERNEL);
 }
 
 static void sk_psock_backlog(struct work_struct *work)
 {
 	struct sk_psock *psock = container_of(work, struct sk_psock, work);
 	struct sk_psock_work_state *state = &psock->work_state;
+	bool ingress, queued = false;
 	struct sk_buff *skb;
-	bool ingress;
 	u32 len, off;
 	int ret;
 
@@ -649,8 +651,13 @@ static void sk_psock_backlog(struct work_struct *work)
 
 		if (!ingress)
 			kfree_skb(skb);
+		else
+			queued = true;
 	}
 end:
+	/* one wake up for everything moved to the ingress queue */
+	if (queued)
+		sk_psock_data_ready(psock->sk, psock);
 	mutex_unlock(&psock->work_mutex);
 }
 
@@ -847,6 +854,34 @@ int sk_psock_msg_verdict(struct sock *sk, struct sk_psock *psock,
 }
 EXPORT_SYMBOL_GPL(sk_psock_msg_verdict);
 
+/* Put an skb redirected to the ingress of @psock straight on its receive
+ * queue, saving the trip through the backlog.  Only done if nothing is
+ * pending in the backlog, which has to be delivered first, and the socket
+ * can take the skb without reclaiming memory.
+ */
+static bool sk_psock_skb_redirect_direct(struct sk_psock *psock,
+					 struct sk_buff *skb)
+{
+	struct sock *sk = psock->sk;
+
+	if (!skb_bpf_ingress(skb) ||
+	    !sk_psock_test_state(psock, SK_PSOCK_TX_ENABLED) ||
+	    !skb_queue_empty(&psock->ingress_skb) ||
+	    READ_ONCE(psock->work_state.skb) ||
+	    sk_under_memory_pressure(sk))
+		return false;
+
+	skb_bpf_redirect_clear(skb);
+	if (sk_psock_skb_ingress(psock, skb, GFP_ATOMIC) < 0) {
+		/* leave it to the backlog to retry */
+		skb_bpf_set_ingress(skb);
+		return false;
+	}
+
+	sk_psock_data_ready(sk, psock);
+	return true;
+}
+
 static void sk_psock_skb_redirect(struct sk_buff *skb)
 {
 	struct sk_psock *psock_other;
@@ -865,20 +900,32 @@ static void sk_psock_skb_redirect(struct sk_buff *skb)
 	 * error that caused the pipe to break. We can't send a packet on
 	 * a socket that is in this state so we drop the skb.
 	 */
-	if (!psock_other || sock_flag(sk_other, SOCK_DEAD)) {
+	if (!psock_other) {
 		kfree_skb(skb);
 		return;
 	}
+	if (sock_flag(sk_other, SOCK_DEAD))
+		goto drop;
+
+	if (sk_psock_skb_redirect_direct(psock_other, skb)) {
+		atomic_long_inc(&psock_other->redir_direct);
+		return;
+	}
+
 	spin_lock_bh(&psock_other->ingress_lock);
 	if (!sk_psock_test_state(psock_other, SK_PSOCK_TX_ENABLED)) {
 		spin_unlock_bh(&psock_other->ingress_lock);
-		kfree_skb(skb);
-		return;
+		goto drop;
 	}
 
 	skb_queue_tail(&psock_other->ingress_skb, skb);
 	schedule_work(&psock_other->work);
 	spin_unlock_bh(&psock_other->ingress_lock);
+	atomic_long_inc(&psock_other->redir_backlog);
+	return;
+drop:
+	atomic_long_inc(&psock_other->redir_drops);
+	kfree_skb(skb);
 }
 
 static void sk_psock_tls_verdict_apply(struct sk_buff *skb, struct sock *sk, int verdict)
@@ -939,6 +986,8 @@ static void sk_psock_verdict_apply(struct sk_psock *psock,
 		 */
 		if (skb_queue_empty(&psock->ingress_skb)) {
 			err = sk_psock_skb_ingress_self(psock, skb);
+			if (err >= 0)
+				sk_psock_data_ready(sk_other, psock);
 		}
 		if (err < 0) {
 			spin_lock_bh(&psock->ingress_lock);
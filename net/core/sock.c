@@ -2030,6 +2030,26 @@ void sk_free_unlock_clone(struct sock *sk)
 }
 EXPORT_SYMBOL_GPL(sk_free_unlock_clone);
 
+static u32 sk_dst_gso_max_size(struct sock *sk, struct dst_entry *dst)
+{
+	u32 max_size;
+
+#if IS_ENABLED(CONFIG_IPV6)
+	if (sk->sk_family == AF_INET6 &&
+	    !ipv6_addr_v4mapped(&sk->sk_v6_rcv_saddr))
+		max_size = READ_ONCE(dst->dev->gso_max_size);
+	else
+#endif
+		max_size = READ_ONCE(dst->dev->gso_ipv4_max_size);
+
+	/* Only TCP knows how to build packets above the legacy limit */
+	if (max_size > GSO_LEGACY_MAX_SIZE &&
+	    (sk->sk_type != SOCK_STREAM || sk->sk_protocol != IPPROTO_TCP))
+		max_size = GSO_LEGACY_MAX_SIZE;
+
+	return max_size;
+}
+
 void sk_setup_caps(struct sock *sk, struct dst_entry *dst)
 {
 	u32 max_segs = 1;
@@ -2044,7 +2064,7 @@ void sk_setup_caps(struct sock *sk, struct dst_entry *dst)
 			sk->sk_route_caps &= ~NETIF_F_GSO_MASK;
 		} else {
 			sk->sk_route_caps |= NETIF_F_SG | NETIF_F_HW_CSUM;
-			sk->sk_gso_max_size = dst->dev->gso_max_size;
+			sk->sk_gso_max_size = sk_dst_gso_max_size(sk, dst);
 			max_segs = max_t(u32, dst->dev->gso_max_segs, 1);
 		}
 	}
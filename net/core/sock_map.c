@@ -809,6 +809,45 @@ static const struct bpf_iter_seq_info sock_map_iter_seq_info = {
 };
 
 static int sock_map_btf_id;
+static void sock_map_psock_stats(struct sock *sk, unsigned long *stats)
+{
+	struct sk_psock *psock = sk_psock(sk);
+
+	if (!psock)
+		return;
+	stats[0] += atomic_long_read(&psock->redir_direct);
+	stats[1] += atomic_long_read(&psock->redir_backlog);
+	stats[2] += atomic_long_read(&psock->redir_drops);
+}
+
+static void sock_map_show_stats(struct seq_file *m, unsigned long *stats)
+{
+	seq_printf(m,
+		   "redir_direct:\t%lu\n"
+		   "redir_backlog:\t%lu\n"
+		   "redir_drops:\t%lu\n",
+		   stats[0], stats[1], stats[2]);
+}
+
+static void sock_map_show_fdinfo(const struct bpf_map *map,
+				 struct seq_file *m)
+{
+	struct bpf_stab *stab = container_of(map, struct bpf_stab, map);
+	unsigned long stats[3] = {};
+	struct sock *sk;
+	int i;
+
+	rcu_read_lock();
+	for (i = 0; i < stab->map.max_entries; i++) {
+		sk = READ_ONCE(stab->sks[i]);
+		if (sk)
+			sock_map_psock_stats(sk, stats);
+	}
+	rcu_read_unlock();
+
+	sock_map_show_stats(m, stats);
+}
+
 const struct bpf_map_ops sock_map_ops = {
 	.map_meta_equal		= bpf_map_meta_equal,
 	.map_alloc		= sock_map_alloc,
@@ -820,6 +859,7 @@ const struct bpf_map_ops sock_map_ops = {
 	.map_lookup_elem	= sock_map_lookup,
 	.map_release_uref	= sock_map_release_progs,
 	.map_check_btf		= map_check_no_btf,
+	.map_show_fdinfo	= sock_map_show_fdinfo,
 	.map_btf_name		= "bpf_stab",
 	.map_btf_id		= &sock_map_btf_id,
 	.iter_seq_info		= &sock_map_iter_seq_info,
@@ -1401,6 +1441,23 @@ static const struct bpf_iter_seq_info sock_hash_iter_seq_info = {
 };
 
 static int sock_hash_map_btf_id;
+static void sock_hash_show_fdinfo(const struct bpf_map *map,
+				  struct seq_file *m)
+{
+	struct bpf_shtab *htab = container_of(map, struct bpf_shtab, map);
+	unsigned long stats[3] = {};
+	struct bpf_shtab_elem *elem;
+	int i;
+
+	rcu_read_lock();
+	for (i = 0; i < htab->buckets_num; i++)
+		hlist_for_each_entry_rcu(elem, &htab->buckets[i].head, node)
+			sock_map_psock_stats(elem->sk, stats);
+	rcu_read_unlock();
+
+	sock_map_show_stats(m, stats);
+}
+
 const struct bpf_map_ops sock_hash_ops = {
 	.map_meta_equal		= bpf_map_meta_equal,
 	.map_alloc		= sock_hash_alloc,
@@ -1412,6 +1469,7 @@ const struct bpf_map_ops sock_hash_ops = {
 	.map_lookup_elem_sys_only = sock_hash_lookup_sys,
 	.map_release_uref	= sock_hash_release_progs,
 	.map_check_btf		= map_check_no_btf,
+	.map_show_fdinfo	= sock_hash_show_fdinfo,
 	.map_btf_name		= "bpf_shtab",
 	.map_btf_id		= &sock_hash_map_btf_id,
 	.iter_seq_info		= &sock_hash_iter_seq_info,
@@ -117,6 +117,7 @@
 #endif
 #include <net/l3mdev.h>
 #include <net/compat.h>
+#include <net/busy_poll.h>
 
 #include <trace/events/sock.h>
 
@@ -846,8 +847,10 @@ int inet_recvmsg(struct socket *sock, struct msghdr *msg, size_t size,
 	int addr_len = 0;
 	int err;
 
-	if (likely(!(flags & MSG_ERRQUEUE)))
+	if (likely(!(flags & MSG_ERRQUEUE))) {
 		sock_rps_record_flow(sk);
+		sk_napi_note_consumer(sk);
+	}
 
 	err = INDIRECT_CALL_2(sk->sk_prot->recvmsg, tcp_recvmsg, udp_recvmsg,
 			      sk, msg, size, flags & MSG_DONTWAIT,
@@ -1455,6 +1458,7 @@ struct sk_buff *inet_gro_receive(struct list_head *head, struct sk_buff *skb)
 	}
 
 	proto = iph->protocol;
+	NAPI_GRO_CB(skb)->proto = proto;
 
 	rcu_read_lock();
 	ops = rcu_dereference(inet_offloads[proto]);
@@ -1606,9 +1610,9 @@ int inet_recv_error(struct sock *sk, struct msghdr *msg, int len, int *addr_len)
 
 int inet_gro_complete(struct sk_buff *skb, int nhoff)
 {
-	__be16 newlen = htons(skb->len - nhoff);
 	struct iphdr *iph = (struct iphdr *)(skb->data + nhoff);
 	const struct net_offload *ops;
+	__be16 totlen = iph->tot_len;
 	int proto = iph->protocol;
 	int err = -ENOSYS;
 
@@ -1617,8 +1621,8 @@ int inet_gro_complete(struct sk_buff *skb, int nhoff)
 		skb_set_inner_network_header(skb, nhoff);
 	}
 
-	csum_replace2(&iph->check, iph->tot_len, newlen);
-	iph->tot_len = newlen;
+	iph_set_totlen(iph, skb->len - nhoff);
+	csum_replace2(&iph->check, totlen, iph->tot_len);
 
 	rcu_read_lock();
 	ops = rcu_dereference(inet_offloads[proto]);
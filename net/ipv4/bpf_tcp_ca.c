@@ -20,6 +20,7 @@ static u32 optional_ops[] = {
 	offsetof(struct tcp_congestion_ops, min_tso_segs),
 	offsetof(struct tcp_congestion_ops, sndbuf_expand),
 	offsetof(struct tcp_congestion_ops, cong_control),
+	offsetof(struct tcp_congestion_ops, ack_batch),
 };
 
 static u32 unsupported_ops[] = {
@@ -58,6 +58,7 @@
 #include <linux/list.h>
 #include <linux/slab.h>
 #include <linux/export.h>
+#include <linux/hash.h>
 #include <linux/vmalloc.h>
 #include <linux/notifier.h>
 #include <net/net_namespace.h>
@@ -162,13 +163,46 @@ struct trie_stat {
 	unsigned int nodesizes[MAX_STAT_DEPTH];
 };
 
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+#define TRIE_CACHE_BITS	10
+
+/* Leaf the walk for @key reached first, valid while the trie is at @gen */
+struct trie_cache_entry {
+	t_key key;
+	unsigned int gen;
+	struct key_vector *leaf;
+};
+
+struct trie_cache {
+	struct trie_cache_entry entry[1 << TRIE_CACHE_BITS];
+};
+#endif
+
 struct trie {
 	struct key_vector kv[1];
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	struct trie_use_stats __percpu *stats;
 #endif
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	struct trie_cache __percpu *cache;
+	unsigned int gen;
+#endif
 };
 
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+/* Must be called once a change to the trie is complete, it invalidates
+ * the leaves cached by fib_table_lookup().  Caller must hold RTNL.
+ */
+static inline void trie_changed(struct trie *t)
+{
+	WRITE_ONCE(t->gen, t->gen + 1);
+}
+#else
+static inline void trie_changed(struct trie *t)
+{
+}
+#endif
+
 static struct key_vector *resize(struct trie *t, struct key_vector *tn);
 static unsigned int tnode_free_size;
 
@@ -1136,6 +1170,7 @@ static int fib_insert_node(struct trie *t, struct key_vector *tp,
 	NODE_INIT_PARENT(l, tp);
 	put_child_root(tp, key, l);
 	trie_rebalance(t, tp);
+	trie_changed(t);
 
 	return 0;
 notnode:
@@ -1176,6 +1211,7 @@ static int fib_insert_alias(struct trie *t, struct key_vector *tp,
 		l->slen = new->fa_slen;
 		node_push_suffix(tp, new->fa_slen);
 	}
+	trie_changed(t);
 
 	return 0;
 }
@@ -1441,6 +1477,11 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 	struct fib_alias *fa;
 	unsigned long index;
 	t_key cindex;
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	struct trie_cache_entry *ce = NULL;
+	bool cached = false;
+	unsigned int gen = 0;
+#endif
 
 	pn = t->kv;
 	cindex = 0;
@@ -1455,6 +1496,22 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 	this_cpu_inc(stats->gets);
 #endif
 
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	/* Lookups in softirq context can't interrupt each other, so they
+	 * can share a cache per cpu without locking.
+	 */
+	if (in_serving_softirq()) {
+		gen = READ_ONCE(t->gen);
+		ce = &this_cpu_ptr(t->cache)->entry[hash_32(key, TRIE_CACHE_BITS)];
+		if (ce->leaf && ce->key == key && ce->gen == gen) {
+			n = ce->leaf;
+			ce = NULL;
+			cached = true;
+			goto found;
+		}
+	}
+walk:
+#endif
 	/* Step 1: Travel to the longest prefix match in the trie */
 	for (;;) {
 		index = get_cindex(key, n);
@@ -1554,6 +1611,17 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 	}
 
 found:
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	/* The first leaf reached only depends on the key, not on the
+	 * flow, so it can be reused as long as the trie doesn't change.
+	 */
+	if (ce) {
+		ce->key = key;
+		ce->gen = gen;
+		ce->leaf = n;
+		ce = NULL;
+	}
+#endif
 	/* this line carries forward the xor from earlier in the function */
 	index = key ^ n->key;
 
@@ -1628,6 +1696,16 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 miss:
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	this_cpu_inc(stats->semantic_match_miss);
+#endif
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	/* there is nothing to backtrace from, walk the trie instead */
+	if (cached) {
+		cached = false;
+		n = get_child_rcu(pn, cindex);
+		if (!n)
+			goto backtrace;
+		goto walk;
+	}
 #endif
 	goto backtrace;
 }
@@ -1652,16 +1730,17 @@ static void fib_remove_alias(struct trie *t, struct key_vector *tp,
 		put_child_root(tp, l->key, NULL);
 		node_free(l);
 		trie_rebalance(t, tp);
+		trie_changed(t);
 		return;
 	}
 
 	/* only access fa if it is pointing at the last valid hlist_node */
-	if (*pprev)
-		return;
-
-	/* update the trie with the latest suffix length */
-	l->slen = fa->fa_slen;
-	node_pull_suffix(tp, fa->fa_slen);
+	if (!*pprev) {
+		/* update the trie with the latest suffix length */
+		l->slen = fa->fa_slen;
+		node_pull_suffix(tp, fa->fa_slen);
+	}
+	trie_changed(t);
 }
 
 static void fib_notify_alias_delete(struct net *net, u32 key,
@@ -1876,6 +1955,9 @@ static void fib_trie_free(struct fib_table *tb)
 
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	free_percpu(t->stats);
+#endif
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	free_percpu(t->cache);
 #endif
 	kfree(tb);
 }
@@ -2005,6 +2087,7 @@ void fib_table_flush_external(struct fib_table *tb)
 			node_free(n);
 		}
 	}
+	trie_changed(t);
 }
 
 /* Caller must hold RTNL. */
@@ -2088,6 +2171,7 @@ int fib_table_flush(struct net *net, struct fib_table *tb, bool flush_all)
 		}
 	}
 
+	trie_changed(t);
 	pr_debug("trie_flush found=%d\n", found);
 	return found;
 }
@@ -2231,12 +2315,16 @@ int fib_notify(struct net *net, struct notifier_block *nb,
 static void __trie_free_rcu(struct rcu_head *head)
 {
 	struct fib_table *tb = container_of(head, struct fib_table, rcu);
-#ifdef CONFIG_IP_FIB_TRIE_STATS
 	struct trie *t = (struct trie *)tb->tb_data;
 
-	if (tb->tb_data == tb->__data)
+	if (tb->tb_data == tb->__data) {
+#ifdef CONFIG_IP_FIB_TRIE_STATS
 		free_percpu(t->stats);
-#endif /* CONFIG_IP_FIB_TRIE_STATS */
+#endif
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+		free_percpu(t->cache);
+#endif
+	}
 	kfree(tb);
 }
 
@@ -2412,13 +2500,25 @@ struct fib_table *fib_trie_table(u32 id, struct fib_table *alias)
 	t->kv[0].slen = KEYLENGTH;
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	t->stats = alloc_percpu(struct trie_use_stats);
-	if (!t->stats) {
-		kfree(tb);
-		tb = NULL;
-	}
+	if (!t->stats)
+		goto err;
+#endif
+#ifdef CONFIG_IP_FIB_TRIE_CACHE
+	t->cache = alloc_percpu(struct trie_cache);
+	if (!t->cache)
+		goto err;
 #endif
 
 	return tb;
+
+#if defined(CONFIG_IP_FIB_TRIE_STATS) || defined(CONFIG_IP_FIB_TRIE_CACHE)
+err:
+#ifdef CONFIG_IP_FIB_TRIE_STATS
+	free_percpu(t->stats);
+#endif
+	kfree(tb);
+	return NULL;
+#endif
 }
 
 #ifdef CONFIG_PROC_FS
@@ -181,11 +181,12 @@ static int inet_csk_bind_conflict(const struct sock *sk,
 static struct inet_bind_hashbucket *
 inet_csk_find_open_port(struct sock *sk, struct inet_bind_bucket **tb_ret, int *port_ret)
 {
-	struct inet_hashinfo *hinfo = sk->sk_prot->h.hashinfo;
+	struct inet_hashinfo *hinfo = tcp_or_dccp_get_hashinfo(sk);
 	int port = 0;
 	struct inet_bind_hashbucket *head;
 	struct net *net = sock_net(sk);
 	bool relax = false;
+	u32 probes = 0, collisions = 0;
 	int i, low, high, attempt_half;
 	struct inet_bind_bucket *tb;
 	u32 remaining, offset;
@@ -224,6 +225,7 @@ inet_csk_find_open_port(struct sock *sk, struct inet_bind_bucket **tb_ret, int *
 			port -= remaining;
 		if (inet_is_local_reserved_port(net, port))
 			continue;
+		probes++;
 		head = &hinfo->bhash[inet_bhashfn(net, port,
 						  hinfo->bhash_size)];
 		spin_lock_bh(&head->lock);
@@ -232,6 +234,7 @@ inet_csk_find_open_port(struct sock *sk, struct inet_bind_bucket **tb_ret, int *
 			    tb->port == port) {
 				if (!inet_csk_bind_conflict(sk, tb, relax, false))
 					goto success;
+				collisions++;
 				goto next_port;
 			}
 		tb = NULL;
@@ -256,8 +259,10 @@ inet_csk_find_open_port(struct sock *sk, struct inet_bind_bucket **tb_ret, int *
 		relax = true;
 		goto ports_exhausted;
 	}
+	inet_port_search_stats(net, probes, collisions);
 	return NULL;
 success:
+	inet_port_search_stats(net, probes, collisions);
 	*port_ret = port;
 	*tb_ret = tb;
 	return head;
@@ -354,7 +359,7 @@ void inet_csk_update_fastreuse(struct inet_bind_bucket *tb,
 int inet_csk_get_port(struct sock *sk, unsigned short snum)
 {
 	bool reuse = sk->sk_reuse && sk->sk_state != TCP_LISTEN;
-	struct inet_hashinfo *hinfo = sk->sk_prot->h.hashinfo;
+	struct inet_hashinfo *hinfo = tcp_or_dccp_get_hashinfo(sk);
 	int ret = 1, port = snum;
 	struct inet_bind_hashbucket *head;
 	struct net *net = sock_net(sk);
@@ -690,7 +695,7 @@ EXPORT_SYMBOL(inet_rtx_syn_ack);
 /* return true if req was found in the ehash table */
 static bool reqsk_queue_unlink(struct request_sock *req)
 {
-	struct inet_hashinfo *hashinfo = req_to_sk(req)->sk_prot->h.hashinfo;
+	struct inet_hashinfo *hashinfo = tcp_or_dccp_get_hashinfo(req_to_sk(req));
 	bool found = false;
 
 	if (sk_hashed(req_to_sk(req))) {
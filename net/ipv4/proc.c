@@ -57,10 +57,11 @@ static int sockstat_seq_show(struct seq_file *seq, void *v)
 	sockets = proto_sockets_allocated_sum_positive(&tcp_prot);
 
 	socket_seq_show(seq);
-	seq_printf(seq, "TCP: inuse %d orphan %d tw %d alloc %d mem %ld\n",
+	seq_printf(seq, "TCP: inuse %d orphan %d tw %d alloc %d mem %ld rcvbuf_saved %ld\n",
 		   sock_prot_inuse_get(net, &tcp_prot), orphans,
 		   atomic_read(&net->ipv4.tcp_death_row.tw_count), sockets,
-		   proto_memory_allocated(&tcp_prot));
+		   proto_memory_allocated(&tcp_prot),
+		   atomic_long_read(&net->ipv4.tcp_rcvbuf_saved) >> PAGE_SHIFT);
 	seq_printf(seq, "UDP: inuse %d mem %ld\n",
 		   sock_prot_inuse_get(net, &udp_prot),
 		   proto_memory_allocated(&udp_prot));
@@ -295,6 +296,10 @@ static const struct snmp_mib snmp4_net_list[] = {
 	SNMP_MIB_ITEM("TcpDuplicateDataRehash", LINUX_MIB_TCPDUPLICATEDATAREHASH),
 	SNMP_MIB_ITEM("TCPDSACKRecvSegs", LINUX_MIB_TCPDSACKRECVSEGS),
 	SNMP_MIB_ITEM("TCPDSACKIgnoredDubious", LINUX_MIB_TCPDSACKIGNOREDDUBIOUS),
+	SNMP_MIB_ITEM("PortSearches", LINUX_MIB_PORTSEARCHES),
+	SNMP_MIB_ITEM("PortSearchProbes", LINUX_MIB_PORTSEARCHPROBES),
+	SNMP_MIB_ITEM("PortSearchCollisions", LINUX_MIB_PORTSEARCHCOLLISIONS),
+	SNMP_MIB_ITEM("TCPRcvBufShrink", LINUX_MIB_TCPRCVBUFSHRINK),
 	SNMP_MIB_SENTINEL
 };
 
@@ -380,7 +380,7 @@ static u32 hystart_ack_delay(struct sock *sk)
 	if (!rate)
 		return 0;
 	return min_t(u64, USEC_PER_MSEC,
-		     div64_ul((u64)GSO_MAX_SIZE * 4 * USEC_PER_SEC, rate));
+		     div64_ul((u64)GSO_LEGACY_MAX_SIZE * 4 * USEC_PER_SEC, rate));
 }
 
 static void hystart_update(struct sock *sk, u32 delay)
@@ -470,6 +470,20 @@ static void cubictcp_acked(struct sock *sk, const struct ack_sample *sample)
 		hystart_update(sk, delay);
 }
 
+static void cubictcp_ack_batch(struct sock *sk,
+			       const struct tcp_ack_batch *batch)
+{
+	struct ack_sample sample = {
+		.pkts_acked	= batch->pkts_acked,
+		.rtt_us		= batch->rtt_us,
+		.in_flight	= batch->in_flight,
+	};
+
+	cubictcp_acked(sk, &sample);
+	if (batch->acked_sacked)
+		cubictcp_cong_avoid(sk, batch->ack, batch->acked_sacked);
+}
+
 static struct tcp_congestion_ops cubictcp __read_mostly = {
 	.init		= cubictcp_init,
 	.ssthresh	= cubictcp_recalc_ssthresh,
@@ -478,6 +492,7 @@ static struct tcp_congestion_ops cubictcp __read_mostly = {
 	.undo_cwnd	= tcp_reno_undo_cwnd,
 	.cwnd_event	= cubictcp_cwnd_event,
 	.pkts_acked     = cubictcp_acked,
+	.ack_batch	= cubictcp_ack_batch,
 	.owner		= THIS_MODULE,
 	.name		= "cubic",
 };
@@ -666,6 +666,80 @@ static inline void tcp_rcv_rtt_measure_ts(struct sock *sk,
  * This function should be called every time data is copied to user space.
  * It calculates the appropriate TCP receive buffer space.
  */
+/* sk_rcvbuf needed to advertise @rcvwin bytes, bounded by tcp_rmem[2] */
+static int tcp_rcvbuf_for_window(struct sock *sk, u64 rcvwin)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	int rcvmem;
+
+	rcvmem = SKB_TRUESIZE(tp->advmss + MAX_TCP_HEADER);
+	while (tcp_win_from_space(sk, rcvmem) < tp->advmss)
+		rcvmem += 128;
+
+	do_div(rcvwin, tp->advmss);
+	return min_t(u64, rcvwin * rcvmem,
+		     sock_net(sk)->ipv4.sysctl_tcp_rmem[2]);
+}
+
+static void tcp_rcvbuf_account(struct sock *sk, int delta)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (delta < 0)
+		delta = -min_t(u32, tp->rcvbuf_saved, -delta);
+	if (!delta)
+		return;
+
+	tp->rcvbuf_saved += delta;
+	atomic_long_add(delta, &sock_net(sk)->ipv4.tcp_rcvbuf_saved);
+}
+
+/* With tcp_moderate_rcvbuf == 2 sk_rcvbuf also follows the application
+ * back down once it drains less than the buffer was sized for: by at most
+ * a quarter per RTT, or straight to what the drain rate needs under memory
+ * pressure.  The advertised window is never retracted, so the buffer keeps
+ * room for everything the peer may still send, and never goes below
+ * tcp_rmem[1].
+ */
+static void tcp_rcvbuf_shrink(struct sock *sk, u32 copied)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct net *net = sock_net(sk);
+	int rcvbuf, target, needed;
+
+	if (net->ipv4.sysctl_tcp_moderate_rcvbuf < 2 ||
+	    (sk->sk_userlocks & SOCK_RCVBUF_LOCK))
+		return;
+
+	rcvbuf = sk->sk_rcvbuf;
+	if (rcvbuf <= net->ipv4.sysctl_tcp_rmem[1])
+		return;
+
+	target = tcp_rcvbuf_for_window(sk, ((u64)copied << 1) +
+					   16 * tp->advmss);
+	if (!tcp_under_memory_pressure(sk)) {
+		if (target >= rcvbuf - (rcvbuf >> 2))
+			return;
+		target = rcvbuf - (rcvbuf >> 2);
+	}
+
+	needed = atomic_read(&sk->sk_rmem_alloc) +
+		 tcp_space_from_win(sk, tcp_receive_window(tp));
+	target = max3(target, needed, net->ipv4.sysctl_tcp_rmem[1]);
+	if (target >= rcvbuf)
+		return;
+
+	WRITE_ONCE(sk->sk_rcvbuf, target);
+	tp->window_clamp = tcp_win_from_space(sk, target);
+	tp->rcv_ssthresh = min(tp->rcv_ssthresh, tp->window_clamp);
+	/* Measure growth again from what the application drains now */
+	tp->rcvq_space.space = max_t(u32, copied,
+				     TCP_INIT_CWND * tp->advmss);
+
+	tcp_rcvbuf_account(sk, rcvbuf - target);
+	NET_INC_STATS(net, LINUX_MIB_TCPRCVBUFSHRINK);
+}
+
 void tcp_rcv_space_adjust(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
@@ -681,8 +755,10 @@ void tcp_rcv_space_adjust(struct sock *sk)
 
 	/* Number of bytes copied to user in last RTT */
 	copied = tp->copied_seq - tp->rcvq_space.seq;
-	if (copied <= tp->rcvq_space.space)
+	if (copied <= tp->rcvq_space.space) {
+		tcp_rcvbuf_shrink(sk, copied);
 		goto new_measure;
+	}
 
 	/* A bit of theory :
 	 * copied = bytes received in previous RTT, our base window
@@ -695,8 +771,8 @@ void tcp_rcv_space_adjust(struct sock *sk)
 
 	if (sock_net(sk)->ipv4.sysctl_tcp_moderate_rcvbuf &&
 	    !(sk->sk_userlocks & SOCK_RCVBUF_LOCK)) {
-		int rcvmem, rcvbuf;
 		u64 rcvwin, grow;
+		int rcvbuf;
 
 		/* minimal window to cope with packet losses, assuming
 		 * steady state. Add some cushion because of small variations.
@@ -708,14 +784,9 @@ void tcp_rcv_space_adjust(struct sock *sk)
 		do_div(grow, tp->rcvq_space.space);
 		rcvwin += (grow << 1);
 
-		rcvmem = SKB_TRUESIZE(tp->advmss + MAX_TCP_HEADER);
-		while (tcp_win_from_space(sk, rcvmem) < tp->advmss)
-			rcvmem += 128;
-
-		do_div(rcvwin, tp->advmss);
-		rcvbuf = min_t(u64, rcvwin * rcvmem,
-			       sock_net(sk)->ipv4.sysctl_tcp_rmem[2]);
+		rcvbuf = tcp_rcvbuf_for_window(sk, rcvwin);
 		if (rcvbuf > sk->sk_rcvbuf) {
+			tcp_rcvbuf_account(sk, sk->sk_rcvbuf - rcvbuf);
 			WRITE_ONCE(sk->sk_rcvbuf, rcvbuf);
 
 			/* Make the window clamp follow along.  */
@@ -2098,6 +2169,7 @@ void tcp_enter_loss(struct sock *sk)
 	struct net *net = sock_net(sk);
 	bool new_recovery = icsk->icsk_ca_state < TCP_CA_Recovery;
 
+	tcp_ca_flush_ack_batch(sk);
 	tcp_timeout_mark_lost(sk);
 
 	/* Reduce ssthresh if it has not yet been made inside this window. */
@@ -2450,6 +2522,7 @@ static void tcp_undo_cwnd_reduction(struct sock *sk, bool unmark_loss)
 	if (tp->prior_ssthresh) {
 		const struct inet_connection_sock *icsk = inet_csk(sk);
 
+		tcp_ca_flush_ack_batch(sk);
 		tp->snd_cwnd = icsk->icsk_ca_ops->undo_cwnd(sk);
 
 		if (tp->prior_ssthresh > tp->snd_ssthresh) {
@@ -2554,6 +2627,7 @@ static void tcp_init_cwnd_reduction(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 
+	tcp_ca_flush_ack_batch(sk);
 	tp->high_seq = tp->snd_nxt;
 	tp->tlp_high_seq = 0;
 	tp->snd_cwnd_cnt = 0;
@@ -3080,9 +3154,69 @@ void tcp_synack_rtt_meas(struct sock *sk, struct request_sock *req)
 static void tcp_cong_avoid(struct sock *sk, u32 ack, u32 acked)
 {
 	const struct inet_connection_sock *icsk = inet_csk(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (icsk->icsk_ca_ops->ack_batch) {
+		tp->ack_batch.ack = ack;
+		tp->ack_batch.acked_sacked += acked;
+		return;
+	}
 
 	icsk->icsk_ca_ops->cong_avoid(sk, ack, acked);
-	tcp_sk(sk)->snd_cwnd_stamp = tcp_jiffies32;
+	tp->snd_cwnd_stamp = tcp_jiffies32;
+}
+
+static void tcp_ack_batch_sample(struct tcp_sock *tp, u32 pkts_acked,
+				 long rtt_us, u32 in_flight)
+{
+	struct tcp_ack_batch *batch = &tp->ack_batch;
+
+	batch->pkts_acked += pkts_acked;
+	if (rtt_us >= 0 && (batch->rtt_us < 0 || rtt_us < batch->rtt_us))
+		batch->rtt_us = rtt_us;
+	batch->in_flight = in_flight;
+}
+
+static void __tcp_ca_flush_ack_batch(struct sock *sk)
+{
+	const struct inet_connection_sock *icsk = inet_csk(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (icsk->icsk_ca_ops->ack_batch) {
+		icsk->icsk_ca_ops->ack_batch(sk, &tp->ack_batch);
+		if (tp->ack_batch.acked_sacked)
+			tp->snd_cwnd_stamp = tcp_jiffies32;
+	}
+	memset(&tp->ack_batch, 0, sizeof(tp->ack_batch));
+	tp->ack_batch.rtt_us = -1;
+}
+
+/* Hand the pending batch to the congestion control, before anything that
+ * depends on cwnd or ssthresh being current: ca_state changes, loss and
+ * undo, or the transmit done by tcp_release_cb().
+ */
+void tcp_ca_flush_ack_batch(struct sock *sk)
+{
+	if (likely(!tcp_sk(sk)->ack_batch.acks))
+		return;
+
+	__tcp_ca_flush_ack_batch(sk);
+	if (!inet_csk(sk)->icsk_ca_ops->cong_control)
+		tcp_update_pacing_rate(sk);
+}
+EXPORT_SYMBOL(tcp_ca_flush_ack_batch);
+
+/* An ACK went through tcp_cong_control().  ACKs drained from the backlog
+ * stay pending until tcp_release_cb(), others are handed over at once.
+ */
+static void tcp_ack_batch_end(struct sock *sk)
+{
+	if (!inet_csk(sk)->icsk_ca_ops->ack_batch)
+		return;
+
+	tcp_sk(sk)->ack_batch.acks++;
+	if (!sock_owned_by_user(sk))
+		__tcp_ca_flush_ack_batch(sk);
 }
 
 /* Restart timer after forward progress on connection.
@@ -3340,7 +3474,10 @@ static int tcp_clean_rtx_queue(struct sock *sk, const struct sk_buff *ack_skb,
 		flag |= FLAG_SET_XMIT_TIMER;  /* set TLP or RTO timer */
 	}
 
-	if (icsk->icsk_ca_ops->pkts_acked) {
+	if (icsk->icsk_ca_ops->ack_batch) {
+		tcp_ack_batch_sample(tp, pkts_acked, sack->rate->rtt_us,
+				     last_in_flight);
+	} else if (icsk->icsk_ca_ops->pkts_acked) {
 		struct ack_sample sample = { .pkts_acked = pkts_acked,
 					     .rtt_us = sack->rate->rtt_us,
 					     .in_flight = last_in_flight };
@@ -3431,6 +3568,7 @@ static void tcp_cong_control(struct sock *sk, u32 ack, u32 acked_sacked,
 
 	if (icsk->icsk_ca_ops->cong_control) {
 		icsk->icsk_ca_ops->cong_control(sk, rs);
+		tcp_ack_batch_end(sk);
 		return;
 	}
 
@@ -3441,6 +3579,7 @@ static void tcp_cong_control(struct sock *sk, u32 ack, u32 acked_sacked,
 		/* Advance cwnd if state allows */
 		tcp_cong_avoid(sk, ack, acked_sacked);
 	}
+	tcp_ack_batch_end(sk);
 	tcp_update_pacing_rate(sk);
 }
 
@@ -326,7 +326,7 @@ void tcp_time_wait(struct sock *sk, int state, int timeo)
 		/* Linkage updates.
 		 * Note that access to tw after this point is illegal.
 		 */
-		inet_twsk_hashdance(tw, sk, &tcp_hashinfo);
+		inet_twsk_hashdance(tw, sk, sock_net(sk)->ipv4.tcp_death_row.hashinfo);
 		local_bh_enable();
 	} else {
 		/* Sorry, if we're out of memory, just CLOSE this
@@ -475,6 +475,7 @@ struct sock *tcp_create_openreq_child(const struct sock *sk,
 
 	/* Now setup tcp_sock */
 	newtp->pred_flags = 0;
+	newtp->rcvbuf_saved = 0;
 
 	seq = treq->rcv_isn + 1;
 	newtp->rcv_wup = seq;
@@ -1080,6 +1080,14 @@ void tcp_release_cb(struct sock *sk)
 {
 	unsigned long flags, nflags;
 
+	/* ACKs drained from the backlog left their congestion control
+	 * input pending, cwnd may have grown since they were processed.
+	 */
+	if (unlikely(tcp_sk(sk)->ack_batch.acks)) {
+		tcp_ca_flush_ack_batch(sk);
+		tcp_tsq_write(sk);
+	}
+
 	/* perform an atomic operation only if at least one flag is set */
 	do {
 		flags = sk->sk_tsq_flags;
@@ -1553,7 +1561,7 @@ int tcp_fragment(struct sock *sk, enum tcp_queue tcp_queue,
 	 * SO_SNDBUF values.
 	 * Also allow first and last skb in retransmit queue to be split.
 	 */
-	limit = sk->sk_sndbuf + 2 * SKB_TRUESIZE(GSO_MAX_SIZE);
+	limit = sk->sk_sndbuf + 2 * SKB_TRUESIZE(GSO_LEGACY_MAX_SIZE);
 	if (unlikely((sk->sk_wmem_queued >> 1) > limit &&
 		     tcp_queue != TCP_FRAG_IN_WRITE_QUEUE &&
 		     skb != tcp_rtx_queue_head(sk) &&
@@ -1506,13 +1506,212 @@ static void busylock_release(spinlock_t *busy)
 		spin_unlock(busy);
 }
 
+/* Per-CPU receive queues let producers on different CPUs queue packets
+ * without bouncing sk_receive_queue.lock.  Receive memory is charged to
+ * the socket in batches of up to UDP_RXQ_CHARGE_BATCH bytes and then
+ * consumed locally; the reader splices all the per-CPU queues in one
+ * pass while holding the reader_queue lock.
+ */
+#define UDP_RXQ_CHARGE_BATCH	(16 * SK_MEM_QUANTUM)
+
+static int udp_rxq_charge(struct sock *sk, struct udp_rxq *rxq, int size)
+{
+	struct sk_buff_head *list = &sk->sk_receive_queue;
+	int batch, rmem, delta, amt;
+
+	batch = min_t(int, UDP_RXQ_CHARGE_BATCH, sk->sk_rcvbuf >> 4);
+	batch = max(batch, size) - rxq->reserve;
+
+	/* as in __udp_enqueue_schedule_skb(), always allow a batch in */
+	rmem = atomic_add_return(batch, &sk->sk_rmem_alloc);
+	if (rmem > (batch + (unsigned int)sk->sk_rcvbuf))
+		goto uncharge;
+
+	spin_lock(&list->lock);
+	if (batch >= sk->sk_forward_alloc) {
+		amt = sk_mem_pages(batch);
+		delta = amt << SK_MEM_QUANTUM_SHIFT;
+		if (!__sk_mem_raise_allocated(sk, delta, amt, SK_MEM_RECV)) {
+			spin_unlock(&list->lock);
+			atomic_sub(batch, &sk->sk_rmem_alloc);
+			return -ENOBUFS;
+		}
+
+		sk->sk_forward_alloc += delta;
+	}
+	sk->sk_forward_alloc -= batch;
+	spin_unlock(&list->lock);
+
+	rxq->reserve += batch;
+	return 0;
+
+uncharge:
+	atomic_sub(batch, &sk->sk_rmem_alloc);
+	return -ENOMEM;
+}
+
+static int udp_rxq_enqueue(struct sock *sk, struct udp_rxq __percpu *pcpu,
+			   struct sk_buff *skb)
+{
+	struct udp_rxq *rxq = this_cpu_ptr(pcpu);
+	int size, err;
+
+	if (atomic_read(&sk->sk_rmem_alloc) > (sk->sk_rcvbuf >> 1))
+		skb_condense(skb);
+
+	size = skb->truesize;
+	udp_set_dev_scratch(skb);
+
+	spin_lock(&rxq->queue.lock);
+	if (rxq->reserve < size) {
+		err = udp_rxq_charge(sk, rxq, size);
+		if (err) {
+			spin_unlock(&rxq->queue.lock);
+			atomic_inc(&sk->sk_drops);
+			return err;
+		}
+	}
+	rxq->reserve -= size;
+
+	sock_skb_set_dropcount(sk, skb);
+	__skb_queue_tail(&rxq->queue, skb);
+	spin_unlock(&rxq->queue.lock);
+
+	if (!sock_flag(sk, SOCK_DEAD))
+		sk->sk_data_ready(sk);
+	return 0;
+}
+
+static bool udp_rxq_empty(const struct sock *sk)
+{
+	struct udp_rxq __percpu *pcpu = READ_ONCE(udp_sk(sk)->rxq);
+	int cpu;
+
+	if (!skb_queue_empty_lockless(&sk->sk_receive_queue))
+		return false;
+	if (!pcpu)
+		return true;
+
+	for_each_possible_cpu(cpu)
+		if (!skb_queue_empty_lockless(&per_cpu_ptr(pcpu, cpu)->queue))
+			return false;
+	return true;
+}
+
+/* Move everything the per-CPU queues hold to @queue, the reader queue.
+ * Under memory pressure the unused per-CPU reserves go back to the
+ * socket as well.  Called with reader_queue.lock held.
+ */
+static bool udp_rxq_splice(struct sock *sk, struct sk_buff_head *queue)
+{
+	struct udp_rxq __percpu *pcpu = READ_ONCE(udp_sk(sk)->rxq);
+	bool pressure, spliced = false;
+	int cpu, reserve = 0;
+
+	if (!pcpu)
+		return false;
+
+	pressure = atomic_read(&sk->sk_rmem_alloc) > (sk->sk_rcvbuf >> 1);
+	for_each_possible_cpu(cpu) {
+		struct udp_rxq *rxq = per_cpu_ptr(pcpu, cpu);
+
+		if (skb_queue_empty_lockless(&rxq->queue) &&
+		    !(pressure && READ_ONCE(rxq->reserve)))
+			continue;
+
+		spin_lock(&rxq->queue.lock);
+		if (!skb_queue_empty(&rxq->queue)) {
+			skb_queue_splice_tail_init(&rxq->queue, queue);
+			spliced = true;
+		}
+		if (pressure) {
+			reserve += rxq->reserve;
+			rxq->reserve = 0;
+		}
+		spin_unlock(&rxq->queue.lock);
+	}
+
+	if (reserve)
+		udp_rmem_release(sk, reserve, 0, false);
+	return spliced;
+}
+
+/* __skb_wait_for_more_packets() only watches sk_receive_queue */
+static int udp_rxq_wait(struct sock *sk, int *err, long *timeo_p)
+{
+	DEFINE_WAIT(wait);
+	int error;
+
+	prepare_to_wait_exclusive(sk_sleep(sk), &wait, TASK_INTERRUPTIBLE);
+
+	error = sock_error(sk);
+	if (error)
+		goto out_err;
+
+	if (!udp_rxq_empty(sk))
+		goto out;
+
+	if (sk->sk_shutdown & RCV_SHUTDOWN) {
+		*err = 0;
+		error = 1;
+		goto out;
+	}
+
+	if (signal_pending(current)) {
+		error = sock_intr_errno(*timeo_p);
+		goto out_err;
+	}
+
+	*timeo_p = schedule_timeout(*timeo_p);
+out:
+	finish_wait(sk_sleep(sk), &wait);
+	return error;
+out_err:
+	*err = error;
+	goto out;
+}
+
+/* nests inside the reader_queue lock, which shares the default class */
+static struct lock_class_key udp_rxq_lock_key;
+
+static int udp_rxq_enable(struct sock *sk)
+{
+	struct udp_rxq __percpu *pcpu;
+	int cpu;
+
+	pcpu = alloc_percpu(struct udp_rxq);
+	if (!pcpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct udp_rxq *rxq = per_cpu_ptr(pcpu, cpu);
+
+		skb_queue_head_init(&rxq->queue);
+		lockdep_set_class(&rxq->queue.lock, &udp_rxq_lock_key);
+	}
+
+	lock_sock(sk);
+	if (!udp_sk(sk)->rxq) {
+		smp_store_release(&udp_sk(sk)->rxq, pcpu);
+		pcpu = NULL;
+	}
+	release_sock(sk);
+
+	free_percpu(pcpu);
+	return 0;
+}
+
 int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 {
 	struct sk_buff_head *list = &sk->sk_receive_queue;
+	struct udp_rxq __percpu *pcpu = READ_ONCE(udp_sk(sk)->rxq);
 	int rmem, delta, amt, err = -ENOMEM;
 	spinlock_t *busy = NULL;
 	int size;
 
+	if (pcpu)
+		return udp_rxq_enqueue(sk, pcpu, skb);
+
 	/* try to avoid the costly atomic add/sub pair when the receive
 	 * queue is full; always allow at least a packet
 	 */
@@ -1588,6 +1787,19 @@ void udp_destruct_sock(struct sock *sk)
 	struct sk_buff *skb;
 
 	skb_queue_splice_tail_init(&sk->sk_receive_queue, &up->reader_queue);
+	if (up->rxq) {
+		int cpu;
+
+		for_each_possible_cpu(cpu) {
+			struct udp_rxq *rxq = per_cpu_ptr(up->rxq, cpu);
+
+			skb_queue_splice_tail_init(&rxq->queue,
+						   &up->reader_queue);
+			total += rxq->reserve;
+		}
+		free_percpu(up->rxq);
+		up->rxq = NULL;
+	}
 	while ((skb = __skb_dequeue(&up->reader_queue)) != NULL) {
 		total += skb->truesize;
 		kfree_skb(skb);
@@ -1675,6 +1887,8 @@ static int first_packet_length(struct sock *sk)
 
 		skb = __first_packet_length(sk, rcvq, &total);
 	}
+	if (!skb && udp_rxq_splice(sk, rcvq))
+		skb = __first_packet_length(sk, rcvq, &total);
 	res = skb ? skb->len : -1;
 	if (total)
 		udp_rmem_release(sk, total, 1, false);
@@ -1735,6 +1949,10 @@ struct sk_buff *__skb_recv_udp(struct sock *sk, unsigned int flags,
 			spin_lock_bh(&queue->lock);
 			skb = __skb_try_recv_from_queue(sk, queue, flags, off,
 							err, &last);
+			/* a single splice feeds a whole recvmmsg() batch */
+			if (!skb && udp_rxq_splice(sk, queue))
+				skb = __skb_try_recv_from_queue(sk, queue, flags,
+								off, err, &last);
 			if (skb) {
 				if (!(flags & MSG_PEEK))
 					udp_skb_destructor(sk, skb);
@@ -1769,13 +1987,15 @@ struct sk_buff *__skb_recv_udp(struct sock *sk, unsigned int flags,
 				break;
 
 			sk_busy_loop(sk, flags & MSG_DONTWAIT);
-		} while (!skb_queue_empty_lockless(sk_queue));
+		} while (!udp_rxq_empty(sk));
 
 		/* sk_queue is empty, reader_queue may contain peeked packets */
 	} while (timeo &&
-		 !__skb_wait_for_more_packets(sk, &sk->sk_receive_queue,
-					      &error, &timeo,
-					      (struct sk_buff *)sk_queue));
+		 !(READ_ONCE(udp_sk(sk)->rxq) ?
+		   udp_rxq_wait(sk, &error, &timeo) :
+		   __skb_wait_for_more_packets(sk, &sk->sk_receive_queue,
+					       &error, &timeo,
+					       (struct sk_buff *)sk_queue)));
 
 	*err = error;
 	return NULL;
@@ -2707,6 +2927,14 @@ int udp_lib_setsockopt(struct sock *sk, int level, int optname,
 		release_sock(sk);
 		break;
 
+	case UDP_PERCPU_RXQ:
+		/* can't be turned off, producers may hold a queue */
+		if (valbool)
+			err = udp_rxq_enable(sk);
+		else if (up->rxq)
+			err = -EINVAL;
+		break;
+
 	/*
 	 * 	UDP-Lite's partial checksum coverage (RFC 3828).
 	 */
@@ -2795,6 +3023,10 @@ int udp_lib_getsockopt(struct sock *sk, int level, int optname,
 		val = up->gro_enabled;
 		break;
 
+	case UDP_PERCPU_RXQ:
+		val = !!READ_ONCE(up->rxq);
+		break;
+
 	/* The following two cannot be changed on UDP sockets, the return is
 	 * always 0 (which corresponds to the full checksum coverage of UDP). */
 	case UDPLITE_SEND_CSCOV:
@@ -2843,7 +3075,8 @@ __poll_t udp_poll(struct file *file, struct socket *sock, poll_table *wait)
 	__poll_t mask = datagram_poll(file, sock, wait);
 	struct sock *sk = sock->sk;
 
-	if (!skb_queue_empty_lockless(&udp_sk(sk)->reader_queue))
+	if (!skb_queue_empty_lockless(&udp_sk(sk)->reader_queue) ||
+	    (READ_ONCE(udp_sk(sk)->rxq) && !udp_rxq_empty(sk)))
 		mask |= EPOLLIN | EPOLLRDNORM;
 
 	/* Check for false positives due to checksum errors */
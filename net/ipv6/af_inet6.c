@@ -62,6 +62,7 @@
 #include <net/rpl.h>
 #include <net/compat.h>
 #include <net/xfrm.h>
+#include <net/busy_poll.h>
 
 #include <linux/uaccess.h>
 #include <linux/mroute6.h>
@@ -652,8 +653,10 @@ int inet6_recvmsg(struct socket *sock, struct msghdr *msg, size_t size,
 	int addr_len = 0;
 	int err;
 
-	if (likely(!(flags & MSG_ERRQUEUE)))
+	if (likely(!(flags & MSG_ERRQUEUE))) {
 		sock_rps_record_flow(sk);
+		sk_napi_note_consumer(sk);
+	}
 
 	err = INDIRECT_CALL_2(sk->sk_prot->recvmsg, tcp_recvmsg, udpv6_recvmsg,
 			      sk, msg, size, flags & MSG_DONTWAIT,
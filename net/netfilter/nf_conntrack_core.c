@@ -1477,6 +1477,61 @@ static void conntrack_gc_work_init(struct conntrack_gc_work *gc_work)
 	gc_work->exiting = false;
 }
 
+/* Every cpu keeps a few entries of the per-netns conntrack count charged
+ * in advance, so that creating and freeing conntracks at a high rate does
+ * not bounce the shared counter between cpus.  Close to nf_conntrack_max
+ * the reserves are not refilled and each entry is accounted for exactly,
+ * so the table-full and early drop behaviour is unchanged.
+ */
+#define NF_CT_COUNT_BATCH	32
+
+static bool nf_ct_count_near_max(const struct nf_conntrack_net *cnet)
+{
+	unsigned int max = READ_ONCE(nf_conntrack_max);
+
+	return max && (unsigned int)atomic_read(&cnet->count) +
+		      2 * NF_CT_COUNT_BATCH * nr_cpu_ids >= max;
+}
+
+static bool nf_ct_count_get_cached(struct net *net)
+{
+	struct ct_pcpu *pcpu = raw_cpu_ptr(net->ct.pcpu_lists);
+
+	return atomic_dec_if_positive(&pcpu->count_reserve) >= 0;
+}
+
+static void nf_ct_count_put(struct net *net, struct nf_conntrack_net *cnet)
+{
+	struct ct_pcpu *pcpu;
+	int reserve;
+
+	/* A dying netns waits for the count to drop to zero. */
+	if (!check_net(net) || nf_ct_count_near_max(cnet)) {
+		atomic_dec(&cnet->count);
+		return;
+	}
+
+	pcpu = raw_cpu_ptr(net->ct.pcpu_lists);
+	reserve = atomic_inc_return(&pcpu->count_reserve);
+	if (unlikely(reserve > 2 * NF_CT_COUNT_BATCH)) {
+		reserve = atomic_xchg(&pcpu->count_reserve, NF_CT_COUNT_BATCH);
+		atomic_sub(reserve - NF_CT_COUNT_BATCH, &cnet->count);
+	}
+}
+
+/* Give the per-cpu reserves back to the netns count. */
+static void nf_ct_count_drain(struct net *net)
+{
+	struct nf_conntrack_net *cnet = net_generic(net, nf_conntrack_net_id);
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct ct_pcpu *pcpu = per_cpu_ptr(net->ct.pcpu_lists, cpu);
+
+		atomic_sub(atomic_xchg(&pcpu->count_reserve, 0), &cnet->count);
+	}
+}
+
 static struct nf_conn *
 __nf_conntrack_alloc(struct net *net,
 		     const struct nf_conntrack_zone *zone,
@@ -1485,11 +1540,23 @@ __nf_conntrack_alloc(struct net *net,
 		     gfp_t gfp, u32 hash)
 {
 	struct nf_conntrack_net *cnet = net_generic(net, nf_conntrack_net_id);
-	unsigned int ct_count;
+	unsigned int ct_count, batch;
 	struct nf_conn *ct;
 
+	if (nf_ct_count_get_cached(net))
+		goto alloc;
+
+	batch = nf_ct_count_near_max(cnet) ? 0 : NF_CT_COUNT_BATCH;
+
 	/* We don't want any race condition at early drop stage */
-	ct_count = atomic_inc_return(&cnet->count);
+	ct_count = atomic_add_return(1 + batch, &cnet->count);
+
+	if (unlikely(batch && nf_conntrack_max && ct_count > nf_conntrack_max)) {
+		/* raced with other cpus filling up the table */
+		atomic_sub(batch, &cnet->count);
+		ct_count -= batch;
+		batch = 0;
+	}
 
 	if (nf_conntrack_max && unlikely(ct_count > nf_conntrack_max)) {
 		if (!early_drop(net, hash)) {
@@ -1501,6 +1568,10 @@ __nf_conntrack_alloc(struct net *net,
 		}
 	}
 
+	if (batch)
+		atomic_add(batch, &raw_cpu_ptr(net->ct.pcpu_lists)->count_reserve);
+alloc:
+
 	/*
 	 * Do not use kmem_cache_zalloc(), as this cache uses
 	 * SLAB_TYPESAFE_BY_RCU.
@@ -1530,7 +1601,7 @@ __nf_conntrack_alloc(struct net *net,
 	atomic_set(&ct->ct_general.use, 0);
 	return ct;
 out:
-	atomic_dec(&cnet->count);
+	nf_ct_count_put(net, cnet);
 	return ERR_PTR(-ENOMEM);
 }
 
@@ -1559,7 +1630,7 @@ void nf_conntrack_free(struct nf_conn *ct)
 	cnet = net_generic(net, nf_conntrack_net_id);
 
 	smp_mb__before_atomic();
-	atomic_dec(&cnet->count);
+	nf_ct_count_put(net, cnet);
 }
 EXPORT_SYMBOL_GPL(nf_conntrack_free);
 
@@ -2452,6 +2523,7 @@ void nf_conntrack_cleanup_net_list(struct list_head *net_exit_list)
 		struct nf_conntrack_net *cnet = net_generic(net, nf_conntrack_net_id);
 
 		nf_ct_iterate_cleanup(kill_all, net, 0, 0);
+		nf_ct_count_drain(net);
 		if (atomic_read(&cnet->count) != 0)
 			busy = 1;
 	}
@@ -2751,6 +2823,7 @@ int nf_conntrack_init_net(struct net *net)
 		spin_lock_init(&pcpu->lock);
 		INIT_HLIST_NULLS_HEAD(&pcpu->unconfirmed, UNCONFIRMED_NULLS_VAL);
 		INIT_HLIST_NULLS_HEAD(&pcpu->dying, DYING_NULLS_VAL);
+		atomic_set(&pcpu->count_reserve, 0);
 	}
 
 	net->ct.stat = alloc_percpu(struct ip_conntrack_stat);
@@ -513,10 +513,16 @@ static void nf_conntrack_standalone_fini_proc(struct net *net)
 u32 nf_conntrack_count(const struct net *net)
 {
 	const struct nf_conntrack_net *cnet;
+	int count, cpu;
 
 	cnet = net_generic(net, nf_conntrack_net_id);
+	count = atomic_read(&cnet->count);
 
-	return atomic_read(&cnet->count);
+	/* leave out what the cpus hold in reserve */
+	for_each_possible_cpu(cpu)
+		count -= atomic_read(&per_cpu_ptr(net->ct.pcpu_lists, cpu)->count_reserve);
+
+	return max(count, 0);
 }
 EXPORT_SYMBOL_GPL(nf_conntrack_count);
 
@@ -547,6 +553,17 @@ nf_conntrack_hash_sysctl(struct ctl_table *table, int write,
 	return ret;
 }
 
+static int
+nf_conntrack_count_sysctl(struct ctl_table *table, int write,
+			  void *buffer, size_t *lenp, loff_t *ppos)
+{
+	int count = nf_conntrack_count(table->data);
+	struct ctl_table tmp = *table;
+
+	tmp.data = &count;
+	return proc_dointvec(&tmp, write, buffer, lenp, ppos);
+}
+
 static struct ctl_table_header *nf_ct_netfilter_header;
 
 enum nf_ct_sysctl_index {
@@ -625,7 +642,7 @@ static struct ctl_table nf_ct_sysctl_table[] = {
 		.procname	= "nf_conntrack_count",
 		.maxlen		= sizeof(int),
 		.mode		= 0444,
-		.proc_handler	= proc_dointvec,
+		.proc_handler	= nf_conntrack_count_sysctl,
 	},
 	[NF_SYSCTL_CT_BUCKETS] = {
 		.procname       = "nf_conntrack_buckets",
@@ -1043,7 +1060,7 @@ static int nf_conntrack_standalone_init_sysctl(struct net *net)
 	if (!table)
 		return -ENOMEM;
 
-	table[NF_SYSCTL_CT_COUNT].data = &cnet->count;
+	table[NF_SYSCTL_CT_COUNT].data = net;
 	table[NF_SYSCTL_CT_CHECKSUM].data = &net->ct.sysctl_checksum;
 	table[NF_SYSCTL_CT_LOG_INVALID].data = &net->ct.sysctl_log_invalid;
 	table[NF_SYSCTL_CT_ACCT].data = &net->ct.sysctl_acct;
@@ -5,6 +5,8 @@
 #include <linux/netfilter.h>
 #include <linux/rhashtable.h>
 #include <linux/netdevice.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include <net/ip.h>
 #include <net/ip6_route.h>
 #include <net/netfilter/nf_tables.h>
@@ -17,6 +19,15 @@
 static DEFINE_MUTEX(flowtable_lock);
 static LIST_HEAD(flowtables);
 
+/* Flows sit on a wheel of one second slots, keyed by the time they are
+ * expected to expire.  The datapath only refreshes flow->timeout, so the
+ * garbage collector visits each flow about once per NF_FLOW_TIMEOUT and
+ * requeues it lazily instead of walking the whole table every second.
+ */
+#define NF_FLOW_GC_SLOTS	64
+#define NF_FLOW_GC_UNLINKED	U16_MAX
+#define NF_FLOW_GC_BATCH	1024
+
 static void
 flow_offload_fill_dir(struct flow_offload *flow,
 		      enum flow_offload_tuple_dir dir)
@@ -56,6 +67,8 @@ struct flow_offload *flow_offload_alloc(struct nf_conn *ct)
 		goto err_ct_refcnt;
 
 	flow->ct = ct;
+	flow->gc_slot = NF_FLOW_GC_UNLINKED;
+	INIT_LIST_HEAD(&flow->gc_node);
 
 	flow_offload_fill_dir(flow, FLOW_OFFLOAD_DIR_ORIGINAL);
 	flow_offload_fill_dir(flow, FLOW_OFFLOAD_DIR_REPLY);
@@ -268,17 +281,48 @@ static const struct rhashtable_params nf_flow_offload_rhash_params = {
 	.automatic_shrinking	= true,
 };
 
+/* Called with gc_lock held. Never picks the slot being expired. */
+static void nf_flow_gc_queue(struct nf_flowtable *flow_table,
+			     struct flow_offload *flow, u32 when)
+{
+	s32 delta = (s32)(when - flow_table->gc_next);
+	unsigned int ticks = 1;
+
+	if (delta > 0)
+		ticks = clamp_t(unsigned int, DIV_ROUND_UP(delta, HZ), 1,
+				NF_FLOW_GC_SLOTS - 1);
+
+	flow->gc_slot = (flow_table->gc_cursor + ticks) % NF_FLOW_GC_SLOTS;
+	list_add_tail(&flow->gc_node, &flow_table->gc_wheel[flow->gc_slot]);
+}
+
+static void nf_flow_gc_unlink(struct nf_flowtable *flow_table,
+			      struct flow_offload *flow)
+{
+	spin_lock_bh(&flow_table->gc_lock);
+	if (flow->gc_slot != NF_FLOW_GC_UNLINKED) {
+		list_del_init(&flow->gc_node);
+		flow->gc_slot = NF_FLOW_GC_UNLINKED;
+	}
+	spin_unlock_bh(&flow_table->gc_lock);
+}
+
 int flow_offload_add(struct nf_flowtable *flow_table, struct flow_offload *flow)
 {
 	int err;
 
 	flow->timeout = nf_flowtable_time_stamp + NF_FLOW_TIMEOUT;
 
+	/* on the wheel before it can be found, so that gc sees every flow */
+	spin_lock_bh(&flow_table->gc_lock);
+	nf_flow_gc_queue(flow_table, flow, flow->timeout);
+	spin_unlock_bh(&flow_table->gc_lock);
+
 	err = rhashtable_insert_fast(&flow_table->rhashtable,
 				     &flow->tuplehash[0].node,
 				     nf_flow_offload_rhash_params);
 	if (err < 0)
-		return err;
+		goto err_unlink;
 
 	err = rhashtable_insert_fast(&flow_table->rhashtable,
 				     &flow->tuplehash[1].node,
@@ -287,9 +331,12 @@ int flow_offload_add(struct nf_flowtable *flow_table, struct flow_offload *flow)
 		rhashtable_remove_fast(&flow_table->rhashtable,
 				       &flow->tuplehash[0].node,
 				       nf_flow_offload_rhash_params);
-		return err;
+		goto err_unlink;
 	}
 
+	NF_FLOW_TABLE_STAT_INC(flow_table, added);
+	NF_FLOW_TABLE_STAT_INC(flow_table, count);
+
 	nf_ct_offload_timeout(flow->ct);
 
 	if (nf_flowtable_hw_offload(flow_table)) {
@@ -298,6 +345,10 @@ int flow_offload_add(struct nf_flowtable *flow_table, struct flow_offload *flow)
 	}
 
 	return 0;
+
+err_unlink:
+	nf_flow_gc_unlink(flow_table, flow);
+	return err;
 }
 EXPORT_SYMBOL_GPL(flow_offload_add);
 
@@ -328,12 +379,18 @@ static void flow_offload_del(struct nf_flowtable *flow_table,
 			       &flow->tuplehash[FLOW_OFFLOAD_DIR_REPLY].node,
 			       nf_flow_offload_rhash_params);
 
+	nf_flow_gc_unlink(flow_table, flow);
+
 	clear_bit(IPS_OFFLOAD_BIT, &flow->ct->status);
 
-	if (nf_flow_has_expired(flow))
+	if (nf_flow_has_expired(flow)) {
 		flow_offload_fixup_ct(flow->ct);
-	else
+		NF_FLOW_TABLE_STAT_INC(flow_table, expired);
+	} else {
 		flow_offload_fixup_ct_timeout(flow->ct);
+		NF_FLOW_TABLE_STAT_INC(flow_table, teardown);
+	}
+	NF_FLOW_TABLE_STAT_DEC(flow_table, count);
 
 	flow_offload_free(flow);
 }
@@ -448,12 +505,115 @@ static void nf_flow_offload_gc_step(struct flow_offload *flow, void *data)
 	}
 }
 
+/* Called with gc_lock held when the slot of @flow comes up.  Returns true
+ * if the flow has to be released, otherwise it goes back on the wheel.
+ */
+static bool nf_flow_gc_visit(struct nf_flowtable *flow_table,
+			     struct flow_offload *flow)
+{
+	u32 now = nf_flowtable_time_stamp;
+	bool hw = test_bit(NF_FLOW_HW, &flow->flags);
+	s32 delta = nf_flow_timeout_delta(flow->timeout);
+
+	NF_FLOW_TABLE_STAT_INC(flow_table, gc_visited);
+
+	/* The hardware may have kept the flow alive since it was last
+	 * asked, check once more before giving up on it.
+	 */
+	if (hw && delta <= 0 && delta > -HZ &&
+	    !test_bit(NF_FLOW_TEARDOWN, &flow->flags)) {
+		nf_flow_offload_stats(flow_table, flow);
+		nf_flow_gc_queue(flow_table, flow, now + HZ);
+		return false;
+	}
+
+	if (delta <= 0 ||
+	    nf_ct_is_dying(flow->ct) ||
+	    nf_flow_has_stale_dst(flow))
+		set_bit(NF_FLOW_TEARDOWN, &flow->flags);
+
+	if (test_bit(NF_FLOW_TEARDOWN, &flow->flags)) {
+		if (!hw || test_bit(NF_FLOW_HW_DEAD, &flow->flags))
+			return true;
+
+		if (!test_bit(NF_FLOW_HW_DYING, &flow->flags))
+			nf_flow_offload_del(flow_table, flow);
+		nf_flow_gc_queue(flow_table, flow, now + HZ);
+		return false;
+	}
+
+	if (hw) {
+		nf_flow_offload_stats(flow_table, flow);
+		nf_flow_gc_queue(flow_table, flow,
+				 min_t(u32, delta, NF_FLOW_TIMEOUT / 2) + now);
+	} else {
+		nf_flow_gc_queue(flow_table, flow, flow->timeout);
+	}
+
+	return false;
+}
+
+static void nf_flow_gc_reap(struct nf_flowtable *flow_table,
+			    struct list_head *reap)
+{
+	struct flow_offload *flow, *next;
+
+	list_for_each_entry_safe(flow, next, reap, gc_node) {
+		list_del_init(&flow->gc_node);
+		flow_offload_del(flow_table, flow);
+	}
+}
+
+static void nf_flow_gc_expire_slot(struct nf_flowtable *flow_table)
+{
+	struct flow_offload *flow;
+	struct list_head *slot;
+	unsigned int n = 0;
+	LIST_HEAD(reap);
+
+	spin_lock_bh(&flow_table->gc_lock);
+	slot = &flow_table->gc_wheel[flow_table->gc_cursor];
+	while (!list_empty(slot)) {
+		flow = list_first_entry(slot, struct flow_offload, gc_node);
+		list_del_init(&flow->gc_node);
+		flow->gc_slot = NF_FLOW_GC_UNLINKED;
+
+		if (nf_flow_gc_visit(flow_table, flow))
+			list_add_tail(&flow->gc_node, &reap);
+
+		if (++n % NF_FLOW_GC_BATCH)
+			continue;
+
+		/* new flows never land on this slot, see nf_flow_gc_queue() */
+		spin_unlock_bh(&flow_table->gc_lock);
+		nf_flow_gc_reap(flow_table, &reap);
+		cond_resched();
+		spin_lock_bh(&flow_table->gc_lock);
+	}
+	flow_table->gc_cursor = (flow_table->gc_cursor + 1) % NF_FLOW_GC_SLOTS;
+	flow_table->gc_next += HZ;
+	spin_unlock_bh(&flow_table->gc_lock);
+
+	nf_flow_gc_reap(flow_table, &reap);
+}
+
 static void nf_flow_offload_work_gc(struct work_struct *work)
 {
 	struct nf_flowtable *flow_table;
+	int slots = 0;
 
 	flow_table = container_of(work, struct nf_flowtable, gc_work.work);
-	nf_flow_table_iterate(flow_table, nf_flow_offload_gc_step, flow_table);
+
+	if (READ_ONCE(flow_table->gc_full)) {
+		WRITE_ONCE(flow_table->gc_full, false);
+		nf_flow_table_iterate(flow_table, nf_flow_offload_gc_step,
+				      flow_table);
+	}
+
+	while (nf_flow_timeout_delta(flow_table->gc_next) <= 0 &&
+	       slots++ < NF_FLOW_GC_SLOTS)
+		nf_flow_gc_expire_slot(flow_table);
+
 	queue_delayed_work(system_power_efficient_wq, &flow_table->gc_work, HZ);
 }
 
@@ -547,16 +707,37 @@ EXPORT_SYMBOL_GPL(nf_flow_dnat_port);
 
 int nf_flow_table_init(struct nf_flowtable *flowtable)
 {
-	int err;
+	int err, i;
 
 	INIT_DELAYED_WORK(&flowtable->gc_work, nf_flow_offload_work_gc);
 	flow_block_init(&flowtable->flow_block);
 	init_rwsem(&flowtable->flow_block_lock);
 
+	spin_lock_init(&flowtable->gc_lock);
+	flowtable->gc_wheel = kmalloc_array(NF_FLOW_GC_SLOTS,
+					    sizeof(*flowtable->gc_wheel),
+					    GFP_KERNEL);
+	if (!flowtable->gc_wheel)
+		return -ENOMEM;
+	for (i = 0; i < NF_FLOW_GC_SLOTS; i++)
+		INIT_LIST_HEAD(&flowtable->gc_wheel[i]);
+	flowtable->gc_cursor = 0;
+	flowtable->gc_next = nf_flowtable_time_stamp + HZ;
+	flowtable->gc_full = false;
+
+	err = -ENOMEM;
+	flowtable->stat = alloc_percpu(struct nf_flowtable_stat);
+	if (!flowtable->stat)
+		goto err_stat;
+
+	err = nf_flow_table_offload_batch_init(flowtable);
+	if (err < 0)
+		goto err_batch;
+
 	err = rhashtable_init(&flowtable->rhashtable,
 			      &nf_flow_offload_rhash_params);
 	if (err < 0)
-		return err;
+		goto err_rhashtable;
 
 	queue_delayed_work(system_power_efficient_wq,
 			   &flowtable->gc_work, HZ);
@@ -566,6 +747,14 @@ int nf_flow_table_init(struct nf_flowtable *flowtable)
 	mutex_unlock(&flowtable_lock);
 
 	return 0;
+
+err_rhashtable:
+	nf_flow_table_offload_batch_free(flowtable);
+err_batch:
+	free_percpu(flowtable->stat);
+err_stat:
+	kfree(flowtable->gc_wheel);
+	return err;
 }
 EXPORT_SYMBOL_GPL(nf_flow_table_init);
 
@@ -588,6 +777,10 @@ void nf_flow_table_gc_cleanup(struct nf_flowtable *flowtable,
 			      struct net_device *dev)
 {
 	nf_flow_table_iterate(flowtable, nf_flow_table_do_cleanup, dev);
+
+	/* torn down flows may be far from their slot, sweep the table */
+	WRITE_ONCE(flowtable->gc_full, true);
+	mod_delayed_work(system_power_efficient_wq, &flowtable->gc_work, 0);
 	flush_delayed_work(&flowtable->gc_work);
 	nf_flow_table_offload_flush(flowtable);
 }
@@ -617,16 +810,114 @@ void nf_flow_table_free(struct nf_flowtable *flow_table)
 		nf_flow_table_iterate(flow_table, nf_flow_offload_gc_step,
 				      flow_table);
 	rhashtable_destroy(&flow_table->rhashtable);
+	nf_flow_table_offload_batch_free(flow_table);
+	free_percpu(flow_table->stat);
+	kfree(flow_table->gc_wheel);
 }
 EXPORT_SYMBOL_GPL(nf_flow_table_free);
 
+#ifdef CONFIG_PROC_FS
+static void *nf_flow_table_seq_start(struct seq_file *seq, loff_t *pos)
+{
+	mutex_lock(&flowtable_lock);
+	return seq_list_start_head(&flowtables, *pos);
+}
+
+static void *nf_flow_table_seq_next(struct seq_file *seq, void *v, loff_t *pos)
+{
+	return seq_list_next(v, &flowtables, pos);
+}
+
+static void nf_flow_table_seq_stop(struct seq_file *seq, void *v)
+{
+	mutex_unlock(&flowtable_lock);
+}
+
+static int nf_flow_table_seq_show(struct seq_file *seq, void *v)
+{
+	struct nf_flowtable_stat sum = {};
+	struct nf_flowtable *flowtable;
+	int cpu;
+
+	if (v == &flowtables) {
+		seq_puts(seq, "priority flags entries added expired teardown "
+			      "gc_visited hw_add hw_del hw_stats\n");
+		return 0;
+	}
+
+	flowtable = list_entry(v, struct nf_flowtable, list);
+	if (!net_eq(read_pnet(&flowtable->net), seq_file_net(seq)))
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		const struct nf_flowtable_stat *st;
+
+		st = per_cpu_ptr(flowtable->stat, cpu);
+		sum.count	+= st->count;
+		sum.added	+= st->added;
+		sum.expired	+= st->expired;
+		sum.teardown	+= st->teardown;
+		sum.gc_visited	+= st->gc_visited;
+		sum.hw_add	+= st->hw_add;
+		sum.hw_del	+= st->hw_del;
+		sum.hw_stats	+= st->hw_stats;
+	}
+
+	seq_printf(seq, "%8d %08x %08x %08x %08x %08x %08x %08x %08x %08x\n",
+		   flowtable->priority, flowtable->flags, sum.count,
+		   sum.added, sum.expired, sum.teardown, sum.gc_visited,
+		   sum.hw_add, sum.hw_del, sum.hw_stats);
+	return 0;
+}
+
+static const struct seq_operations nf_flow_table_seq_ops = {
+	.start	= nf_flow_table_seq_start,
+	.next	= nf_flow_table_seq_next,
+	.stop	= nf_flow_table_seq_stop,
+	.show	= nf_flow_table_seq_show,
+};
+
+static int __net_init nf_flow_table_init_net(struct net *net)
+{
+	if (!proc_create_net("nf_flowtable", 0444, net->proc_net_stat,
+			     &nf_flow_table_seq_ops,
+			     sizeof(struct seq_net_private)))
+		return -ENOMEM;
+	return 0;
+}
+
+static void __net_exit nf_flow_table_exit_net(struct net *net)
+{
+	remove_proc_entry("nf_flowtable", net->proc_net_stat);
+}
+
+static struct pernet_operations nf_flow_table_net_ops = {
+	.init = nf_flow_table_init_net,
+	.exit = nf_flow_table_exit_net,
+};
+#endif /* CONFIG_PROC_FS */
+
 static int __init nf_flow_table_module_init(void)
 {
-	return nf_flow_table_offload_init();
+	int err;
+
+	err = nf_flow_table_offload_init();
+	if (err)
+		return err;
+
+#ifdef CONFIG_PROC_FS
+	err = register_pernet_subsys(&nf_flow_table_net_ops);
+	if (err)
+		nf_flow_table_offload_exit();
+#endif
+	return err;
 }
 
 static void __exit nf_flow_table_module_exit(void)
 {
+#ifdef CONFIG_PROC_FS
+	unregister_pernet_subsys(&nf_flow_table_net_ops);
+#endif
 	nf_flow_table_offload_exit();
 }
 
@@ -37,6 +37,23 @@ static int nf_flow_state_check(struct flow_offload *flow, int proto,
 	return 0;
 }
 
+/* The garbage collector only looks at a flow about once per timeout,
+ * catch route changes on the packet path instead.
+ */
+static bool nf_flow_dst_check(struct flow_offload *flow,
+			      const struct flow_offload_tuple *tuple)
+{
+	if (tuple->xmit_type != FLOW_OFFLOAD_XMIT_NEIGH &&
+	    tuple->xmit_type != FLOW_OFFLOAD_XMIT_XFRM)
+		return true;
+
+	if (likely(dst_check(tuple->dst_cache, tuple->dst_cookie)))
+		return true;
+
+	flow_offload_teardown(flow);
+	return false;
+}
+
 static void nf_flow_nat_ip_tcp(struct sk_buff *skb, unsigned int thoff,
 			       __be32 addr, __be32 new_addr)
 {
@@ -364,6 +381,9 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	if (nf_flow_state_check(flow, iph->protocol, skb, thoff))
 		return NF_ACCEPT;
 
+	if (!nf_flow_dst_check(flow, &tuplehash->tuple))
+		return NF_ACCEPT;
+
 	if (skb_try_make_writable(skb, thoff + hdrsize))
 		return NF_DROP;
 
@@ -600,6 +620,9 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	if (nf_flow_state_check(flow, ip6h->nexthdr, skb, thoff))
 		return NF_ACCEPT;
 
+	if (!nf_flow_dst_check(flow, &tuplehash->tuple))
+		return NF_ACCEPT;
+
 	if (skb_try_make_writable(skb, thoff + hdrsize))
 		return NF_DROP;
 
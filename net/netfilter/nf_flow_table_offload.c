@@ -4,6 +4,8 @@
 #include <linux/netfilter.h>
 #include <linux/rhashtable.h>
 #include <linux/netdevice.h>
+#include <linux/llist.h>
+#include <linux/hash.h>
 #include <linux/tc_act/tc_csum.h>
 #include <net/flow_offload.h>
 #include <net/netfilter/nf_flow_table.h>
@@ -18,12 +20,34 @@ static struct workqueue_struct *nf_flow_offload_del_wq;
 static struct workqueue_struct *nf_flow_offload_stats_wq;
 
 struct flow_offload_work {
-	struct list_head	list;
+	struct llist_node	llnode;
 	enum flow_cls_command	cmd;
 	int			priority;
 	struct nf_flowtable	*flowtable;
 	struct flow_offload	*flow;
+};
+
+/* Requests are queued on a per-flowtable batch, picked by command and by
+ * a hash of the flow so that one flowtable still keeps several workers
+ * busy.  A batch worker goes through its requests with flow_block_lock
+ * taken once per NF_FLOW_OFFLOAD_BATCH driver calls.
+ */
+#define NF_FLOW_OFFLOAD_SHARDS_LOG	4
+#define NF_FLOW_OFFLOAD_SHARDS		(1 << NF_FLOW_OFFLOAD_SHARDS_LOG)
+#define NF_FLOW_OFFLOAD_BATCH		64
+
+enum {
+	NF_FLOW_OFFLOAD_Q_ADD,
+	NF_FLOW_OFFLOAD_Q_DEL,
+	NF_FLOW_OFFLOAD_Q_STATS,
+	NF_FLOW_OFFLOAD_Q_MAX,
+};
+
+struct nf_flow_offload_batch {
+	struct llist_head	requests;
 	struct work_struct	work;
+	struct nf_flowtable	*flowtable;
+	struct workqueue_struct	*wq;
 };
 
 #define NF_FLOW_DISSECTOR(__match, __type, __field)	\
@@ -841,7 +865,7 @@ static int nf_flow_offload_tuple(struct nf_flowtable *flowtable,
 	if (cmd == FLOW_CLS_REPLACE)
 		cls_flow.rule = flow_rule->rule;
 
-	down_read(&flowtable->flow_block_lock);
+	/* flow_block_lock is held by flow_offload_batch_work() */
 	list_for_each_entry(block_cb, block_cb_list, list) {
 		err = block_cb->cb(TC_SETUP_CLSFLOWER, &cls_flow,
 				   block_cb->cb_priv);
@@ -850,7 +874,6 @@ static int nf_flow_offload_tuple(struct nf_flowtable *flowtable,
 
 		i++;
 	}
-	up_read(&flowtable->flow_block_lock);
 
 	if (cmd == FLOW_CLS_STATS)
 		memcpy(stats, &cls_flow.stats, sizeof(*stats));
@@ -951,11 +974,8 @@ static void flow_offload_work_stats(struct flow_offload_work *offload)
 	}
 }
 
-static void flow_offload_work_handler(struct work_struct *work)
+static void flow_offload_work_handler(struct flow_offload_work *offload)
 {
-	struct flow_offload_work *offload;
-
-	offload = container_of(work, struct flow_offload_work, work);
 	switch (offload->cmd) {
 		case FLOW_CLS_REPLACE:
 			flow_offload_work_add(offload);
@@ -974,14 +994,51 @@ static void flow_offload_work_handler(struct work_struct *work)
 	kfree(offload);
 }
 
+static void flow_offload_batch_work(struct work_struct *work)
+{
+	struct flow_offload_work *offload, *next;
+	struct nf_flow_offload_batch *batch;
+	struct rw_semaphore *lock;
+	struct llist_node *requests;
+	unsigned int n = 0;
+
+	batch = container_of(work, struct nf_flow_offload_batch, work);
+	lock = &batch->flowtable->flow_block_lock;
+
+	requests = llist_reverse_order(llist_del_all(&batch->requests));
+
+	down_read(lock);
+	llist_for_each_entry_safe(offload, next, requests, llnode) {
+		flow_offload_work_handler(offload);
+
+		if (++n % NF_FLOW_OFFLOAD_BATCH)
+			continue;
+
+		up_read(lock);
+		cond_resched();
+		down_read(lock);
+	}
+	up_read(lock);
+}
+
 static void flow_offload_queue_work(struct flow_offload_work *offload)
 {
+	struct nf_flow_offload_batch *batch;
+	unsigned int q;
+
 	if (offload->cmd == FLOW_CLS_REPLACE)
-		queue_work(nf_flow_offload_add_wq, &offload->work);
+		q = NF_FLOW_OFFLOAD_Q_ADD;
 	else if (offload->cmd == FLOW_CLS_DESTROY)
-		queue_work(nf_flow_offload_del_wq, &offload->work);
+		q = NF_FLOW_OFFLOAD_Q_DEL;
 	else
-		queue_work(nf_flow_offload_stats_wq, &offload->work);
+		q = NF_FLOW_OFFLOAD_Q_STATS;
+
+	batch = &offload->flowtable->offload_batch[q * NF_FLOW_OFFLOAD_SHARDS +
+			hash_ptr(offload->flow, NF_FLOW_OFFLOAD_SHARDS_LOG)];
+
+	/* whoever finds the batch empty kicks the worker */
+	if (llist_add(&offload->llnode, &batch->requests))
+		queue_work(batch->wq, &batch->work);
 }
 
 static struct flow_offload_work *
@@ -1003,7 +1060,6 @@ nf_flow_offload_work_alloc(struct nf_flowtable *flowtable,
 	offload->flow = flow;
 	offload->priority = flowtable->priority;
 	offload->flowtable = flowtable;
-	INIT_WORK(&offload->work, flow_offload_work_handler);
 
 	return offload;
 }
@@ -1018,6 +1074,7 @@ void nf_flow_offload_add(struct nf_flowtable *flowtable,
 	if (!offload)
 		return;
 
+	NF_FLOW_TABLE_STAT_INC(flowtable, hw_add);
 	flow_offload_queue_work(offload);
 }
 
@@ -1031,6 +1088,7 @@ void nf_flow_offload_del(struct nf_flowtable *flowtable,
 		return;
 
 	set_bit(NF_FLOW_HW_DYING, &flow->flags);
+	NF_FLOW_TABLE_STAT_INC(flowtable, hw_del);
 	flow_offload_queue_work(offload);
 }
 
@@ -1048,9 +1106,46 @@ void nf_flow_offload_stats(struct nf_flowtable *flowtable,
 	if (!offload)
 		return;
 
+	NF_FLOW_TABLE_STAT_INC(flowtable, hw_stats);
 	flow_offload_queue_work(offload);
 }
 
+int nf_flow_table_offload_batch_init(struct nf_flowtable *flowtable)
+{
+	struct workqueue_struct *wq[NF_FLOW_OFFLOAD_Q_MAX] = {
+		[NF_FLOW_OFFLOAD_Q_ADD]		= nf_flow_offload_add_wq,
+		[NF_FLOW_OFFLOAD_Q_DEL]		= nf_flow_offload_del_wq,
+		[NF_FLOW_OFFLOAD_Q_STATS]	= nf_flow_offload_stats_wq,
+	};
+	struct nf_flow_offload_batch *batch;
+	int i;
+
+	batch = kcalloc(NF_FLOW_OFFLOAD_Q_MAX * NF_FLOW_OFFLOAD_SHARDS,
+			sizeof(*batch), GFP_KERNEL);
+	if (!batch)
+		return -ENOMEM;
+
+	for (i = 0; i < NF_FLOW_OFFLOAD_Q_MAX * NF_FLOW_OFFLOAD_SHARDS; i++) {
+		init_llist_head(&batch[i].requests);
+		INIT_WORK(&batch[i].work, flow_offload_batch_work);
+		batch[i].flowtable = flowtable;
+		batch[i].wq = wq[i / NF_FLOW_OFFLOAD_SHARDS];
+	}
+	flowtable->offload_batch = batch;
+
+	return 0;
+}
+
+void nf_flow_table_offload_batch_free(struct nf_flowtable *flowtable)
+{
+	int i;
+
+	for (i = 0; i < NF_FLOW_OFFLOAD_Q_MAX * NF_FLOW_OFFLOAD_SHARDS; i++)
+		cancel_work_sync(&flowtable->offload_batch[i].work);
+
+	kfree(flowtable->offload_batch);
+}
+
 void nf_flow_table_offload_flush(struct nf_flowtable *flowtable)
 {
 	if (nf_flowtable_hw_offload(flowtable)) {
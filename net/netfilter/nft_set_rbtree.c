@@ -10,15 +10,37 @@
 #include <linux/module.h>
 #include <linux/list.h>
 #include <linux/rbtree.h>
+#include <linux/vmalloc.h>
 #include <linux/netlink.h>
 #include <linux/netfilter.h>
 #include <linux/netfilter/nf_tables.h>
 #include <net/netfilter/nf_tables_core.h>
 
+/* Flat copy of the tree, in ascending key order, used by lookups for large
+ * sets: a binary search over packed keys touches far fewer cache lines than
+ * walking the tree.  It is only valid for the tree generation it was built
+ * from (@seq) and is rebuilt from a work item shortly after the tree
+ * changes, lookups fall back to the tree in the meantime.
+ */
+struct nft_rbtree_array {
+	unsigned int			seq;
+	unsigned int			num;
+	unsigned int			stride;
+	const struct nft_rbtree_elem	**elems;
+	struct rcu_head			rcu;
+	u8				keys[];
+};
+
+#define NFT_RBTREE_ARRAY_MIN	128
+#define NFT_RBTREE_ARRAY_DELAY	(HZ / 10)
+
 struct nft_rbtree {
 	struct rb_root		root;
 	rwlock_t		lock;
 	seqcount_rwlock_t	count;
+	unsigned int		nelems;
+	struct nft_rbtree_array __rcu *array;
+	struct delayed_work	array_work;
 	struct delayed_work	gc_work;
 };
 
@@ -107,13 +129,67 @@ static bool __nft_rbtree_lookup(const struct net *net, const struct nft_set *set
 	return false;
 }
 
+static bool nft_rbtree_array_lookup(const struct net *net,
+				    const struct nft_set *set,
+				    const struct nft_rbtree_array *array,
+				    const u32 *key, const struct nft_set_ext **ext)
+{
+	const struct nft_rbtree_elem *rbe;
+	u8 genmask = nft_genmask_cur(net);
+	unsigned int lo = 0, hi = array->num;
+	int i;
+
+	/* Find the last element with a key lower than or equal to @key. */
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (memcmp(array->keys + mid * array->stride, key,
+			   set->klen) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* Elements that are not part of the current generation don't bound
+	 * any interval, skip them.  For equal keys, end elements sort before
+	 * start elements, so adjacent intervals resolve to the one starting
+	 * at @key.
+	 */
+	for (i = lo - 1; i >= 0; i--) {
+		rbe = array->elems[i];
+		if (nft_set_elem_active(&rbe->ext, genmask))
+			break;
+	}
+	if (i < 0)
+		return false;
+
+	if (nft_set_elem_expired(&rbe->ext) || nft_rbtree_interval_end(rbe))
+		return false;
+
+	if (!(set->flags & NFT_SET_INTERVAL) &&
+	    memcmp(array->keys + i * array->stride, key, set->klen))
+		return false;
+
+	*ext = &rbe->ext;
+	return true;
+}
+
 static bool nft_rbtree_lookup(const struct net *net, const struct nft_set *set,
 			      const u32 *key, const struct nft_set_ext **ext)
 {
 	struct nft_rbtree *priv = nft_set_priv(set);
 	unsigned int seq = read_seqcount_begin(&priv->count);
+	const struct nft_rbtree_array *array;
 	bool ret;
 
+	array = rcu_dereference(priv->array);
+	if (array && array->seq == seq) {
+		ret = nft_rbtree_array_lookup(net, set, array, key, ext);
+		if (!read_seqcount_retry(&priv->count, seq))
+			return ret;
+		seq = read_seqcount_begin(&priv->count);
+	}
+
 	ret = __nft_rbtree_lookup(net, set, key, ext, seq);
 	if (ret || !read_seqcount_retry(&priv->count, seq))
 		return ret;
@@ -360,9 +436,78 @@ static int __nft_rbtree_insert(const struct net *net, const struct nft_set *set,
 
 	rb_link_node_rcu(&new->node, parent, p);
 	rb_insert_color(&new->node, &priv->root);
+	priv->nelems++;
 	return 0;
 }
 
+static void nft_rbtree_array_schedule(struct nft_rbtree *priv)
+{
+	if (priv->nelems >= NFT_RBTREE_ARRAY_MIN ||
+	    rcu_access_pointer(priv->array))
+		queue_delayed_work(system_power_efficient_wq, &priv->array_work,
+				   NFT_RBTREE_ARRAY_DELAY);
+}
+
+static void nft_rbtree_array_replace(struct nft_rbtree *priv,
+				     struct nft_rbtree_array *array)
+{
+	struct nft_rbtree_array *old;
+
+	old = rcu_replace_pointer(priv->array, array, true);
+	if (old)
+		kvfree_rcu(old, rcu);
+}
+
+static void nft_rbtree_array_build(struct work_struct *work)
+{
+	struct nft_rbtree_array *array;
+	const struct nft_rbtree_elem *rbe;
+	unsigned int num, stride, i = 0;
+	struct nft_rbtree *priv;
+	struct rb_node *node;
+	struct nft_set *set;
+
+	priv = container_of(work, struct nft_rbtree, array_work.work);
+	set  = nft_set_container_of(priv);
+
+	num = READ_ONCE(priv->nelems);
+	if (num < NFT_RBTREE_ARRAY_MIN) {
+		nft_rbtree_array_replace(priv, NULL);
+		return;
+	}
+
+	stride = round_up(set->klen, sizeof(u32));
+	array = kvmalloc(struct_size(array, keys, (size_t)num * stride) +
+			 (num + 1) * sizeof(*array->elems), GFP_KERNEL);
+	if (!array)
+		return;
+
+	array->stride = stride;
+	array->elems = (void *)PTR_ALIGN(array->keys + (size_t)num * stride,
+					 sizeof(*array->elems));
+
+	read_lock_bh(&priv->lock);
+	if (priv->nelems != num) {
+		/* changed meanwhile, a new build is already queued */
+		read_unlock_bh(&priv->lock);
+		kvfree(array);
+		return;
+	}
+
+	/* The tree keeps larger keys to the left, walk it backwards. */
+	for (node = rb_last(&priv->root); node; node = rb_prev(node)) {
+		rbe = rb_entry(node, struct nft_rbtree_elem, node);
+		memcpy(array->keys + i * stride, nft_set_ext_key(&rbe->ext),
+		       set->klen);
+		array->elems[i++] = rbe;
+	}
+	array->num = i;
+	array->seq = raw_read_seqcount(&priv->count);
+	read_unlock_bh(&priv->lock);
+
+	nft_rbtree_array_replace(priv, array);
+}
+
 static int nft_rbtree_insert(const struct net *net, const struct nft_set *set,
 			     const struct nft_set_elem *elem,
 			     struct nft_set_ext **ext)
@@ -375,6 +520,8 @@ static int nft_rbtree_insert(const struct net *net, const struct nft_set *set,
 	write_seqcount_begin(&priv->count);
 	err = __nft_rbtree_insert(net, set, rbe, ext);
 	write_seqcount_end(&priv->count);
+	if (!err)
+		nft_rbtree_array_schedule(priv);
 	write_unlock_bh(&priv->lock);
 
 	return err;
@@ -390,7 +537,9 @@ static void nft_rbtree_remove(const struct net *net,
 	write_lock_bh(&priv->lock);
 	write_seqcount_begin(&priv->count);
 	rb_erase(&rbe->node, &priv->root);
+	priv->nelems--;
 	write_seqcount_end(&priv->count);
+	nft_rbtree_array_schedule(priv);
 	write_unlock_bh(&priv->lock);
 }
 
@@ -493,6 +642,7 @@ static void nft_rbtree_gc(struct work_struct *work)
 {
 	struct nft_rbtree_elem *rbe, *rbe_end = NULL, *rbe_prev = NULL;
 	struct nft_set_gc_batch *gcb = NULL;
+	unsigned int nelems;
 	struct nft_rbtree *priv;
 	struct rb_node *node;
 	struct nft_set *set;
@@ -502,6 +652,7 @@ static void nft_rbtree_gc(struct work_struct *work)
 
 	write_lock_bh(&priv->lock);
 	write_seqcount_begin(&priv->count);
+	nelems = priv->nelems;
 	for (node = rb_first(&priv->root); node != NULL; node = rb_next(node)) {
 		rbe = rb_entry(node, struct nft_rbtree_elem, node);
 
@@ -516,6 +667,7 @@ static void nft_rbtree_gc(struct work_struct *work)
 
 		if (rbe_prev) {
 			rb_erase(&rbe_prev->node, &priv->root);
+			priv->nelems--;
 			rbe_prev = NULL;
 		}
 		gcb = nft_set_gc_batch_check(set, gcb, GFP_ATOMIC);
@@ -530,15 +682,20 @@ static void nft_rbtree_gc(struct work_struct *work)
 			atomic_dec(&set->nelems);
 			nft_set_gc_batch_add(gcb, rbe_end);
 			rb_erase(&rbe_end->node, &priv->root);
+			priv->nelems--;
 			rbe_end = NULL;
 		}
 		node = rb_next(node);
 		if (!node)
 			break;
 	}
-	if (rbe_prev)
+	if (rbe_prev) {
 		rb_erase(&rbe_prev->node, &priv->root);
+		priv->nelems--;
+	}
 	write_seqcount_end(&priv->count);
+	if (priv->nelems != nelems)
+		nft_rbtree_array_schedule(priv);
 	write_unlock_bh(&priv->lock);
 
 	rbe = nft_set_catchall_gc(set);
@@ -568,7 +725,10 @@ static int nft_rbtree_init(const struct nft_set *set,
 	rwlock_init(&priv->lock);
 	seqcount_rwlock_init(&priv->count, &priv->lock);
 	priv->root = RB_ROOT;
+	priv->nelems = 0;
+	RCU_INIT_POINTER(priv->array, NULL);
 
+	INIT_DELAYED_WORK(&priv->array_work, nft_rbtree_array_build);
 	INIT_DEFERRABLE_WORK(&priv->gc_work, nft_rbtree_gc);
 	if (set->flags & NFT_SET_TIMEOUT)
 		queue_delayed_work(system_power_efficient_wq, &priv->gc_work,
@@ -584,6 +744,8 @@ static void nft_rbtree_destroy(const struct nft_set *set)
 	struct rb_node *node;
 
 	cancel_delayed_work_sync(&priv->gc_work);
+	cancel_delayed_work_sync(&priv->array_work);
+	kvfree(rcu_dereference_protected(priv->array, true));
 	rcu_barrier();
 	while ((node = priv->root.rb_node) != NULL) {
 		rb_erase(node, &priv->root);
@@ -1354,6 +1354,12 @@ xprt_request_enqueue_transmit(struct rpc_task *task)
 		INIT_LIST_HEAD(&req->rq_xmit2);
 out:
 		atomic_long_inc(&xprt->xmit_queuelen);
+		if (!req->rq_inflight_bytes) {
+			req->rq_inflight_bytes = req->rq_snd_buf.len +
+						 req->rq_rcv_buf.buflen;
+			atomic_long_add(req->rq_inflight_bytes,
+					&xprt->inflight_bytes);
+		}
 		set_bit(RPC_TASK_NEED_XMIT, &task->tk_runstate);
 		spin_unlock(&xprt->queue_lock);
 	}
@@ -1831,6 +1837,7 @@ xprt_request_init(struct rpc_task *task)
 	req->rq_snd_buf.bvec = NULL;
 	req->rq_rcv_buf.bvec = NULL;
 	req->rq_release_snd_buf = NULL;
+	req->rq_inflight_bytes = 0;
 	xprt_init_majortimeo(task, req);
 
 	trace_xprt_reserve(req);
@@ -1906,6 +1913,8 @@ void xprt_release(struct rpc_task *task)
 
 	xprt = req->rq_xprt;
 	xprt_request_dequeue_xprt(task);
+	if (req->rq_inflight_bytes)
+		atomic_long_sub(req->rq_inflight_bytes, &xprt->inflight_bytes);
 	spin_lock(&xprt->transport_lock);
 	xprt->ops->release_xprt(xprt, task);
 	if (xprt->ops->release_request)
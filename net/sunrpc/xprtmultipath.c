@@ -326,29 +326,35 @@ struct rpc_xprt *__xprt_switch_find_next_entry_roundrobin(struct list_head *head
 	return xprt_switch_find_first_entry(head);
 }
 
+/*
+ * Pick the transport with the fewest call and reply bytes outstanding, so
+ * that a few large READs or WRITEs queued on one connection do not hold up
+ * everything else sent on it.  The scan starts after @cur, so transports
+ * that are equally loaded are still used in a round-robin fashion.
+ */
 static
 struct rpc_xprt *xprt_switch_find_next_entry_roundrobin(struct rpc_xprt_switch *xps,
 		const struct rpc_xprt *cur)
 {
 	struct list_head *head = &xps->xps_xprt_list;
-	struct rpc_xprt *xprt;
-	unsigned int nactive;
-
-	for (;;) {
-		unsigned long xprt_queuelen, xps_queuelen;
+	unsigned int nxprts = READ_ONCE(xps->xps_nxprts);
+	unsigned long bytes, best_bytes = ULONG_MAX;
+	struct rpc_xprt *xprt, *best = NULL;
 
+	while (nxprts--) {
 		xprt = __xprt_switch_find_next_entry_roundrobin(head, cur);
 		if (!xprt)
 			break;
-		xprt_queuelen = atomic_long_read(&xprt->queuelen);
-		xps_queuelen = atomic_long_read(&xps->xps_queuelen);
-		nactive = READ_ONCE(xps->xps_nactive);
-		/* Exit loop if xprt_queuelen <= average queue length */
-		if (xprt_queuelen * nactive <= xps_queuelen)
-			break;
+		bytes = atomic_long_read(&xprt->inflight_bytes);
+		if (bytes < best_bytes) {
+			best = xprt;
+			best_bytes = bytes;
+			if (!bytes)
+				break;
+		}
 		cur = xprt;
 	}
-	return xprt;
+	return best;
 }
 
 static
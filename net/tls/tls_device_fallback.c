@@ -34,6 +34,8 @@
 #include <crypto/scatterwalk.h>
 #include <net/ip6_checksum.h>
 
+#include "trace.h"
+
 static void chain_to_walk(struct scatterlist *sg, struct scatter_walk *walk)
 {
 	struct scatterlist *src = walk->sg;
@@ -392,6 +394,9 @@ static struct sk_buff *tls_sw_fallback(struct sock *sk, struct sk_buff *skb)
 	if (!payload_len)
 		return skb;
 
+	trace_tls_device_tx_sw_fallback(sk, ntohl(tcp_hdr(skb)->seq),
+					payload_len);
+
 	sg_in = kmalloc_array(sg_in_max_elements, sizeof(*sg_in), GFP_ATOMIC);
 	if (!sg_in)
 		goto free_orig;
@@ -43,6 +43,8 @@
 #include <net/strparser.h>
 #include <net/tls.h>
 
+#include "trace.h"
+
 static int __skb_nsg(struct sk_buff *skb, int offset, int len,
                      unsigned int recursion_level)
 {
@@ -1418,7 +1420,8 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 
 	if (*zc && (out_iov || out_sg)) {
 		if (out_iov)
-			n_sgout = iov_iter_npages(out_iov, INT_MAX) + 1;
+			n_sgout = iov_iter_npages(out_iov, INT_MAX) + 1 +
+				  prot->tail_size;
 		else
 			n_sgout = sg_nents(out_sg);
 		n_sgin = skb_nsg(skb, rxm->offset + prot->prepend_size,
@@ -1502,11 +1505,22 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 			sg_set_buf(&sgout[0], aad, prot->aad_size);
 
 			*chunk = 0;
-			err = tls_setup_from_iter(sk, out_iov, data_len,
+			err = tls_setup_from_iter(sk, out_iov,
+						  data_len - prot->tail_size,
 						  &pages, chunk, &sgout[1],
-						  (n_sgout - 1));
+						  n_sgout - 1 - prot->tail_size);
 			if (err < 0)
 				goto fallback_to_reg_recv;
+			/* The TLS 1.3 inner content type stays in the
+			 * kernel, the caller checks it before trusting
+			 * what landed in the user buffer.
+			 */
+			if (prot->tail_size) {
+				sg_unmark_end(&sgout[pages]);
+				sg_set_buf(&sgout[pages + 1], &ctx->zc_tail,
+					   prot->tail_size);
+				sg_mark_end(&sgout[pages + 1]);
+			}
 		} else if (out_sg) {
 			memcpy(sgout, out_sg, n_sgout * sizeof(*sgout));
 		} else {
@@ -1564,13 +1578,46 @@ static int decrypt_skb_update(struct sock *sk, struct sk_buff *skb,
 						      LINUX_MIB_TLSDECRYPTERROR);
 				return err;
 			}
+
+			/* A zero-copy TLS 1.3 record that turns out padded
+			 * or not to carry data can't be handed out as is.
+			 * The ciphertext is untouched, decrypt it again in
+			 * place and let it take the regular path.
+			 */
+			if (*zc && prot->tail_size &&
+			    unlikely(ctx->zc_tail != TLS_RECORD_TYPE_DATA)) {
+				trace_tls_sw_rx_zc_retry(sk, tls_ctx->rx.rec_seq,
+							 ctx->zc_tail);
+				if (!ctx->zc_tail)
+					TLS_INC_STATS(sock_net(sk),
+						      LINUX_MIB_TLSRXNOPADVIOL);
+				TLS_INC_STATS(sock_net(sk),
+					      LINUX_MIB_TLSDECRYPTRETRY);
+
+				iov_iter_revert(dest, *chunk);
+				*zc = false;
+				err = decrypt_internal(sk, skb, NULL, NULL,
+						       chunk, zc, false);
+				if (err < 0) {
+					if (err == -EBADMSG)
+						TLS_INC_STATS(sock_net(sk),
+							      LINUX_MIB_TLSDECRYPTERROR);
+					return err;
+				}
+			}
 		} else {
 			*zc = false;
 		}
 
-		pad = padding_length(ctx, prot, skb);
-		if (pad < 0)
-			return pad;
+		if (*zc && prot->tail_size) {
+			/* Content type was decrypted into zc_tail */
+			ctx->control = ctx->zc_tail;
+			pad = 0;
+		} else {
+			pad = padding_length(ctx, prot, skb);
+			if (pad < 0)
+				return pad;
+		}
 
 		rxm->full_len -= pad;
 		rxm->offset += prot->prepend_size;
@@ -1814,7 +1861,7 @@ int tls_sw_recvmsg(struct sock *sk,
 
 		if (to_decrypt <= len && !is_kvec && !is_peek &&
 		    ctx->control == TLS_RECORD_TYPE_DATA &&
-		    prot->version != TLS_1_3_VERSION &&
+		    (prot->version != TLS_1_3_VERSION || tls_ctx->rx_no_pad) &&
 		    !bpf_strp_enabled)
 			zc = true;
 
@@ -192,6 +192,54 @@ TRACE_EVENT(tls_device_tx_resync_send,
 	)
 );
 
+TRACE_EVENT(tls_device_tx_sw_fallback,
+
+	TP_PROTO(struct sock *sk, u32 tcp_seq, int payload_len),
+
+	TP_ARGS(sk, tcp_seq, payload_len),
+
+	TP_STRUCT__entry(
+		__field(	struct sock *,	sk		)
+		__field(	u32,		tcp_seq		)
+		__field(	int,		payload_len	)
+	),
+
+	TP_fast_assign(
+		__entry->sk = sk;
+		__entry->tcp_seq = tcp_seq;
+		__entry->payload_len = payload_len;
+	),
+
+	TP_printk(
+		"sk=%p tcp_seq=%u payload_len=%d",
+		__entry->sk, __entry->tcp_seq, __entry->payload_len
+	)
+);
+
+TRACE_EVENT(tls_sw_rx_zc_retry,
+
+	TP_PROTO(struct sock *sk, u8 *rec_no, u8 content_type),
+
+	TP_ARGS(sk, rec_no, content_type),
+
+	TP_STRUCT__entry(
+		__field(	struct sock *,	sk		)
+		__field(	u64,		rec_no		)
+		__field(	u8,		content_type	)
+	),
+
+	TP_fast_assign(
+		__entry->sk = sk;
+		__entry->rec_no = get_unaligned_be64(rec_no);
+		__entry->content_type = content_type;
+	),
+
+	TP_printk(
+		"sk=%p rec_no=%llu content_type=%u",
+		__entry->sk, __entry->rec_no, __entry->content_type
+	)
+);
+
 #endif /* _TLS_TRACE_H_ */
 
 #undef TRACE_INCLUDE_PATH
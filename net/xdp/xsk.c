@@ -149,14 +149,15 @@ static u64 xp_get_handle(struct xdp_buff_xsk *xskb)
 	return xskb->orig_addr + (offset << XSK_UNALIGNED_BUF_OFFSET_SHIFT);
 }
 
-static int __xsk_rcv_zc(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
+static int __xsk_rcv_zc(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len,
+			u32 options)
 {
 	struct xdp_buff_xsk *xskb = container_of(xdp, struct xdp_buff_xsk, xdp);
 	u64 addr;
 	int err;
 
 	addr = xp_get_handle(xskb);
-	err = xskq_prod_reserve_desc(xs->rx, addr, len);
+	err = xskq_prod_reserve_desc(xs->rx, addr, len, options);
 	if (err) {
 		xs->rx_queue_full++;
 		return err;
@@ -184,18 +185,91 @@ static void xsk_copy_xdp(struct xdp_buff *to, struct xdp_buff *from, u32 len)
 	memcpy(to_buf, from_buf, len + metalen);
 }
 
+/*
+ * Copies a packet that does not fit into one UMEM frame, or comes as a
+ * multi-buffer XDP frame, into as many frames as needed.  All but the
+ * last Rx descriptor carry XDP_PKT_CONTD.
+ */
+static int __xsk_rcv_mb(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len,
+			u32 frame_size)
+{
+	struct skb_shared_info *sinfo = NULL;
+	u32 num_desc, from_len, metalen;
+	struct xdp_buff *xsk_xdp;
+	void *from;
+	int frag = 0;
+
+	num_desc = DIV_ROUND_UP(len, frame_size);
+	if (!xsk_buff_can_alloc(xs->pool, num_desc)) {
+		xs->rx_dropped++;
+		return -ENOSPC;
+	}
+	if (xskq_prod_nb_free(xs->rx, num_desc) < num_desc) {
+		xs->rx_queue_full++;
+		return -ENOBUFS;
+	}
+
+	if (xdp_buff_has_frags(xdp))
+		sinfo = xdp_get_shared_info_from_buff(xdp);
+	metalen = xdp_data_meta_unsupported(xdp) ? 0 :
+		  xdp->data - xdp->data_meta;
+
+	from = xdp->data;
+	from_len = xdp->data_end - xdp->data;
+	while (len) {
+		u32 to_len = min(len, frame_size), copied = 0;
+		void *to;
+
+		/* Cannot fail, the fill ring was checked above. */
+		xsk_xdp = xsk_buff_alloc(xs->pool);
+		to = xsk_xdp->data;
+
+		/* Metadata goes in front of the first frame only */
+		if (metalen) {
+			memcpy(to - metalen, xdp->data_meta, metalen);
+			metalen = 0;
+		}
+
+		while (copied < to_len) {
+			u32 n;
+
+			if (!from_len) {
+				from = skb_frag_address(&sinfo->frags[frag]);
+				from_len = skb_frag_size(&sinfo->frags[frag]);
+				frag++;
+				continue;
+			}
+
+			n = min(from_len, to_len - copied);
+			memcpy(to + copied, from, n);
+			copied += n;
+			from += n;
+			from_len -= n;
+		}
+
+		len -= to_len;
+		__xsk_rcv_zc(xs, xsk_xdp, to_len, len ? XDP_PKT_CONTD : 0);
+	}
+
+	return 0;
+}
+
 static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 {
+	u32 frame_size = xsk_pool_get_rx_frame_size(xs->pool);
 	struct xdp_buff *xsk_xdp;
 	int err;
 	u32 len;
 
-	len = xdp->data_end - xdp->data;
-	if (len > xsk_pool_get_rx_frame_size(xs->pool)) {
+	len = xdp_get_buff_len(xdp);
+	if (len > frame_size && !xs->pool->sg) {
 		xs->rx_dropped++;
 		return -ENOSPC;
 	}
 
+	if (unlikely(len > frame_size || xdp_buff_has_frags(xdp)))
+		return __xsk_rcv_mb(xs, xdp, len, frame_size);
+
 	xsk_xdp = xsk_buff_alloc(xs->pool);
 	if (!xsk_xdp) {
 		xs->rx_dropped++;
@@ -203,7 +277,7 @@ static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 	}
 
 	xsk_copy_xdp(xsk_xdp, xdp, len);
-	err = __xsk_rcv_zc(xs, xsk_xdp, len);
+	err = __xsk_rcv_zc(xs, xsk_xdp, len, 0);
 	if (err) {
 		xsk_buff_free(xsk_xdp);
 		return err;
@@ -273,7 +347,7 @@ static int xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 
 	if (xdp->rxq->mem.type == MEM_TYPE_XSK_BUFF_POOL) {
 		len = xdp->data_end - xdp->data;
-		return __xsk_rcv_zc(xs, xdp, len);
+		return __xsk_rcv_zc(xs, xdp, len, 0);
 	}
 
 	err = __xsk_rcv(xs, xdp);
@@ -432,6 +506,9 @@ static int xsk_zc_xmit(struct xdp_sock *xs)
 	return xsk_wakeup(xs, XDP_WAKEUP_TX);
 }
 
+/* A multi-buffer Tx packet becomes one skb, bounded by its frags */
+#define XSK_TX_MAX_DESCS	MAX_SKB_FRAGS
+
 static void xsk_destruct_skb(struct sk_buff *skb)
 {
 	u64 addr = (u64)(long)skb_shinfo(skb)->destructor_arg;
@@ -445,15 +522,37 @@ static void xsk_destruct_skb(struct sk_buff *skb)
 	sock_wfree(skb);
 }
 
+/* Umem addresses of a packet built from several Tx descriptors */
+struct xsk_tx_addrs {
+	u32 nr;
+	u64 addr[];
+};
+
+static void xsk_destruct_skb_mb(struct sk_buff *skb)
+{
+	struct xsk_tx_addrs *addrs = skb_shinfo(skb)->destructor_arg;
+	struct xdp_sock *xs = xdp_sk(skb->sk);
+	unsigned long flags;
+	u32 i;
+
+	spin_lock_irqsave(&xs->pool->cq_lock, flags);
+	for (i = 0; i < addrs->nr; i++)
+		xskq_prod_submit_addr(xs->pool->cq, addrs->addr[i]);
+	spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
+
+	kfree(addrs);
+	sock_wfree(skb);
+}
+
 static struct sk_buff *xsk_build_skb_zerocopy(struct xdp_sock *xs,
-					      struct xdp_desc *desc)
+					      struct xdp_desc *descs, u32 nr)
 {
 	struct xsk_buff_pool *pool = xs->pool;
-	u32 hr, len, ts, offset, copy, copied;
+	u32 hr, len, ts, offset, copy, copied, d;
 	struct sk_buff *skb;
 	struct page *page;
 	void *buffer;
-	int err, i;
+	int err, i = 0;
 	u64 addr;
 
 	hr = max(NET_SKB_PAD, L1_CACHE_ALIGN(xs->dev->needed_headroom));
@@ -464,53 +563,62 @@ static struct sk_buff *xsk_build_skb_zerocopy(struct xdp_sock *xs,
 
 	skb_reserve(skb, hr);
 
-	addr = desc->addr;
-	len = desc->len;
-	ts = pool->unaligned ? len : pool->chunk_size;
+	for (d = 0; d < nr; d++) {
+		len = descs[d].len;
+		ts = pool->unaligned ? len : pool->chunk_size;
 
-	buffer = xsk_buff_raw_get_data(pool, addr);
-	offset = offset_in_page(buffer);
-	addr = buffer - pool->addrs;
+		buffer = xsk_buff_raw_get_data(pool, descs[d].addr);
+		offset = offset_in_page(buffer);
+		addr = buffer - pool->addrs;
 
-	for (copied = 0, i = 0; copied < len; i++) {
-		page = pool->umem->pgs[addr >> PAGE_SHIFT];
-		get_page(page);
+		for (copied = 0; copied < len; i++) {
+			if (unlikely(i == MAX_SKB_FRAGS)) {
+				kfree_skb(skb);
+				return ERR_PTR(-EOVERFLOW);
+			}
 
-		copy = min_t(u32, PAGE_SIZE - offset, len - copied);
-		skb_fill_page_desc(skb, i, page, offset, copy);
+			page = pool->umem->pgs[addr >> PAGE_SHIFT];
+			get_page(page);
 
-		copied += copy;
-		addr += copy;
-		offset = 0;
-	}
+			copy = min_t(u32, PAGE_SIZE - offset, len - copied);
+			skb_fill_page_desc(skb, i, page, offset, copy);
 
-	skb->len += len;
-	skb->data_len += len;
-	skb->truesize += ts;
+			copied += copy;
+			addr += copy;
+			offset = 0;
+		}
 
-	refcount_add(ts, &xs->sk.sk_wmem_alloc);
+		skb->len += len;
+		skb->data_len += len;
+		skb->truesize += ts;
+
+		refcount_add(ts, &xs->sk.sk_wmem_alloc);
+	}
 
 	return skb;
 }
 
 static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
-				     struct xdp_desc *desc)
+				     struct xdp_desc *descs, u32 nr)
 {
 	struct net_device *dev = xs->dev;
+	struct xsk_tx_addrs *addrs;
 	struct sk_buff *skb;
+	u32 i;
 
 	if (dev->priv_flags & IFF_TX_SKB_NO_LINEAR) {
-		skb = xsk_build_skb_zerocopy(xs, desc);
+		skb = xsk_build_skb_zerocopy(xs, descs, nr);
 		if (IS_ERR(skb))
 			return skb;
 	} else {
-		u32 hr, tr, len;
+		u32 hr, tr, len = 0, off = 0;
 		void *buffer;
 		int err;
 
 		hr = max(NET_SKB_PAD, L1_CACHE_ALIGN(dev->needed_headroom));
 		tr = dev->needed_tailroom;
-		len = desc->len;
+		for (i = 0; i < nr; i++)
+			len += descs[i].len;
 
 		skb = sock_alloc_send_skb(&xs->sk, hr + len + tr, 1, &err);
 		if (unlikely(!skb))
@@ -519,48 +627,104 @@ static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
 		skb_reserve(skb, hr);
 		skb_put(skb, len);
 
-		buffer = xsk_buff_raw_get_data(xs->pool, desc->addr);
-		err = skb_store_bits(skb, 0, buffer, len);
-		if (unlikely(err)) {
-			kfree_skb(skb);
-			return ERR_PTR(err);
+		for (i = 0; i < nr; i++) {
+			buffer = xsk_buff_raw_get_data(xs->pool, descs[i].addr);
+			err = skb_store_bits(skb, off, buffer, descs[i].len);
+			if (unlikely(err)) {
+				kfree_skb(skb);
+				return ERR_PTR(err);
+			}
+			off += descs[i].len;
 		}
 	}
 
 	skb->dev = dev;
 	skb->priority = xs->sk.sk_priority;
 	skb->mark = xs->sk.sk_mark;
-	skb_shinfo(skb)->destructor_arg = (void *)(long)desc->addr;
-	skb->destructor = xsk_destruct_skb;
+
+	if (likely(nr == 1)) {
+		skb_shinfo(skb)->destructor_arg = (void *)(long)descs[0].addr;
+		skb->destructor = xsk_destruct_skb;
+		return skb;
+	}
+
+	addrs = kmalloc(struct_size(addrs, addr, nr), GFP_KERNEL);
+	if (unlikely(!addrs)) {
+		kfree_skb(skb);
+		return ERR_PTR(-ENOMEM);
+	}
+	addrs->nr = nr;
+	for (i = 0; i < nr; i++)
+		addrs->addr[i] = descs[i].addr;
+	skb_shinfo(skb)->destructor_arg = addrs;
+	skb->destructor = xsk_destruct_skb_mb;
 
 	return skb;
 }
 
+/*
+ * Peeks at the descriptors of the next Tx packet, all but the last one
+ * carrying XDP_PKT_CONTD, without consuming them.  Returns the number of
+ * descriptors, 0 if no complete packet has been posted yet, or minus the
+ * number of descriptors to drop if the packet is invalid or too long.
+ */
+static int xsk_tx_peek_pkt(struct xdp_sock *xs, struct xdp_desc *descs)
+{
+	struct xsk_queue *tx = xs->tx;
+	struct xdp_desc desc;
+	bool valid = true;
+	u32 nr = 1;
+
+	if (!xskq_cons_peek_desc(tx, &descs[0], xs->pool))
+		return 0;
+
+	desc = descs[0];
+	while (xp_mb_desc(&desc)) {
+		/* The end of the packet would never fit in the ring */
+		if (nr == tx->nentries)
+			return -(int)nr;
+		if (!xskq_cons_peek_desc_at(tx, nr, &desc))
+			return 0;
+
+		if (!xp_validate_desc(xs->pool, &desc))
+			valid = false;
+		else if (nr < XSK_TX_MAX_DESCS)
+			descs[nr] = desc;
+		nr++;
+	}
+
+	if (unlikely(!valid || nr > XSK_TX_MAX_DESCS))
+		return -(int)nr;
+	return nr;
+}
+
 static int xsk_generic_xmit(struct sock *sk)
 {
+	struct xdp_desc descs[XSK_TX_MAX_DESCS];
 	struct xdp_sock *xs = xdp_sk(sk);
 	u32 max_batch = TX_BATCH_SIZE;
 	bool sent_frame = false;
-	struct xdp_desc desc;
 	struct sk_buff *skb;
 	unsigned long flags;
 	int err = 0;
+	int nr;
 
 	mutex_lock(&xs->mutex);
 
 	if (xs->queue_id >= xs->dev->real_num_tx_queues)
 		goto out;
 
-	while (xskq_cons_peek_desc(xs->tx, &desc, xs->pool)) {
+	while ((nr = xsk_tx_peek_pkt(xs, descs))) {
 		if (max_batch-- == 0) {
 			err = -EAGAIN;
 			goto out;
 		}
 
-		skb = xsk_build_skb(xs, &desc);
-		if (IS_ERR(skb)) {
-			err = PTR_ERR(skb);
-			goto out;
+		if (unlikely(nr < 0)) {
+			/* Drop the whole packet, not just the bad part */
+			xskq_cons_release_n(xs->tx, -nr);
+			xs->tx->invalid_descs++;
+			continue;
 		}
 
 		/* This is the backpressure mechanism for the Tx path.
@@ -569,19 +733,36 @@ static int xsk_generic_xmit(struct sock *sk)
 		 * any buffering in the Tx path.
 		 */
 		spin_lock_irqsave(&xs->pool->cq_lock, flags);
-		if (xskq_prod_reserve(xs->pool->cq)) {
+		if (xskq_prod_reserve_n(xs->pool->cq, nr)) {
 			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
-			kfree_skb(skb);
 			goto out;
 		}
 		spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
 
+		skb = xsk_build_skb(xs, descs, nr);
+		if (IS_ERR(skb)) {
+			spin_lock_irqsave(&xs->pool->cq_lock, flags);
+			xskq_prod_cancel_n(xs->pool->cq, nr);
+			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
+			err = PTR_ERR(skb);
+			if (err == -EOVERFLOW) {
+				/* Too many pages for one skb, drop it */
+				xskq_cons_release_n(xs->tx, nr);
+				xs->tx->invalid_descs++;
+				err = 0;
+				continue;
+			}
+			goto out;
+		}
+
 		err = __dev_direct_xmit(skb, xs->queue_id);
 		if  (err == NETDEV_TX_BUSY) {
 			/* Tell user-space to retry the send */
+			if (skb->destructor == xsk_destruct_skb_mb)
+				kfree(skb_shinfo(skb)->destructor_arg);
 			skb->destructor = sock_wfree;
 			spin_lock_irqsave(&xs->pool->cq_lock, flags);
-			xskq_prod_cancel(xs->pool->cq);
+			xskq_prod_cancel_n(xs->pool->cq, nr);
 			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
 			/* Free skb without triggering the perf drop trace */
 			consume_skb(skb);
@@ -589,7 +770,7 @@ static int xsk_generic_xmit(struct sock *sk)
 			goto out;
 		}
 
-		xskq_cons_release(xs->tx);
+		xskq_cons_release_n(xs->tx, nr);
 		/* Ignore NET_XMIT_CN as packet might have been sent */
 		if (err == NET_XMIT_DROP) {
 			/* SKB completed but not sent */
@@ -870,7 +1051,7 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 
 	flags = sxdp->sxdp_flags;
 	if (flags & ~(XDP_SHARED_UMEM | XDP_COPY | XDP_ZEROCOPY |
-		      XDP_USE_NEED_WAKEUP))
+		      XDP_USE_NEED_WAKEUP | XDP_USE_SG))
 		return -EINVAL;
 
 	rtnl_lock();
@@ -898,7 +1079,7 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 		struct socket *sock;
 
 		if ((flags & XDP_COPY) || (flags & XDP_ZEROCOPY) ||
-		    (flags & XDP_USE_NEED_WAKEUP)) {
+		    (flags & XDP_USE_NEED_WAKEUP) || (flags & XDP_USE_SG)) {
 			/* Cannot specify flags for shared sockets. */
 			err = -EINVAL;
 			goto out_unlock;
@@ -935,8 +1116,8 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 				goto out_unlock;
 			}
 
-			err = xp_assign_dev_shared(xs->pool, umem_xs->umem,
-						   dev, qid);
+			err = xp_assign_dev_shared(xs->pool, umem_xs, dev,
+						   qid);
 			if (err) {
 				xp_destroy(xs->pool);
 				xs->pool = NULL;
@@ -134,6 +134,13 @@ int xp_assign_dev(struct xsk_buff_pool *pool,
 	if (force_zc && force_copy)
 		return -EINVAL;
 
+	/* Drivers do not chain buffers of one packet in zero-copy mode. */
+	if (flags & XDP_USE_SG) {
+		if (force_zc)
+			return -EOPNOTSUPP;
+		force_copy = true;
+	}
+
 	if (xsk_get_pool_from_qid(netdev, queue_id))
 		return -EBUSY;
 
@@ -145,6 +152,8 @@ int xp_assign_dev(struct xsk_buff_pool *pool,
 
 	if (flags & XDP_USE_NEED_WAKEUP)
 		pool->uses_need_wakeup = true;
+	if (flags & XDP_USE_SG)
+		pool->sg = true;
 	/* Tx needs to be explicitly woken up the first time.  Also
 	 * for supporting drivers that do not implement this
 	 * feature. They will always have to call sendto() or poll().
@@ -191,7 +200,7 @@ int xp_assign_dev(struct xsk_buff_pool *pool,
 	return err;
 }
 
-int xp_assign_dev_shared(struct xsk_buff_pool *pool, struct xdp_umem *umem,
+int xp_assign_dev_shared(struct xsk_buff_pool *pool, struct xdp_sock *umem_xs,
 			 struct net_device *dev, u16 queue_id)
 {
 	u16 flags;
@@ -200,9 +209,12 @@ int xp_assign_dev_shared(struct xsk_buff_pool *pool, struct xdp_umem *umem,
 	if (!pool->fq || !pool->cq)
 		return -EINVAL;
 
-	flags = umem->zc ? XDP_ZEROCOPY : XDP_COPY;
-	if (pool->uses_need_wakeup)
+	/* Inherit the mode and options of the socket owning the umem */
+	flags = umem_xs->umem->zc ? XDP_ZEROCOPY : XDP_COPY;
+	if (umem_xs->pool->uses_need_wakeup)
 		flags |= XDP_USE_NEED_WAKEUP;
+	if (umem_xs->pool->sg)
+		flags |= XDP_USE_SG;
 
 	return xp_assign_dev(pool, dev, queue_id, flags);
 }
@@ -133,7 +133,7 @@ sub find_initcalls {
 
 		# parse initcall level
 		my ($function, $level) = $symbol =~
-			/^(.*)((early|rootfs|con|[0-9])s?)$/;
+			/^(.*)((early|rootfs|con|[0-9])[as]?)$/;
 
 		die "$0: ERROR: invalid initcall name $symbol in $file($path)"
 			if (!defined($function) || !defined($level));
@@ -129,6 +129,9 @@
 		.off   = 0,					\
 		.imm   = IMM })
 
+/* Kernel-internal mov64 resolving a per-cpu pointer, see xlated dumps */
+#define BPF_ADDR_PERCPU	(-1)
+
 /* Direct packet access, R0 = *(uint *) (skb->data + imm32) */
 
 #define BPF_LD_ABS(SIZE, IMM)					\
@@ -490,6 +490,97 @@ struct perf_event_query_bpf {
 	__u32	ids[0];
 };
 
+/*
+ * Structure used by below PERF_EVENT_IOC_ADDR_AGGR command to count the
+ * samples of a PERF_SAMPLE_ADDR event per page or cache line in the
+ * kernel instead of writing them to the ring buffer.
+ */
+struct perf_event_addr_aggr {
+	/*
+	 * log2 of the bytes counted together, e.g. 6 for cache lines or
+	 * 12 for pages; 0 goes back to regular sampling
+	 */
+	__u32	shift;
+	/*
+	 * Number of addresses that can be counted between two drains,
+	 * a power of two
+	 */
+	__u32	nr_slots;
+};
+
+/*
+ * One address returned by PERF_EVENT_IOC_ADDR_AGGR_DRAIN
+ */
+struct perf_addr_aggr_entry {
+	__u64	addr;		/* start of the page or cache line */
+	__u64	count;		/* samples since the last drain */
+	__u64	weight;		/* sum of PERF_SAMPLE_WEIGHT{,_STRUCT} */
+	__u64	hitm;		/* samples with PERF_MEM_SNOOP_HITM */
+};
+
+/*
+ * Structure used by below PERF_EVENT_IOC_ADDR_AGGR_DRAIN command to
+ * return and reset the counts of an aggregating event
+ */
+struct perf_event_addr_aggr_drain {
+	/*
+	 * User provided array of struct perf_addr_aggr_entry
+	 */
+	__u64	entries;
+	/*
+	 * Array length, set by the kernel to the number of entries filled
+	 */
+	__u32	nr;
+	__u32	__reserved;
+	/*
+	 * Set by the kernel to the number of samples since the last drain
+	 * that found no free slot
+	 */
+	__u64	lost;
+};
+
+/*
+ * Structure used by below PERF_EVENT_IOC_SET_CGROUP_TABLE command to count
+ * a per-CPU event separately for each of a set of perf_event cgroups.
+ */
+struct perf_event_cgroup_table {
+	/*
+	 * User provided array of cgroup ids; a task counts towards its
+	 * cgroup and all of that cgroup's ancestors
+	 */
+	__u64	ids;
+	/*
+	 * Array length, 0 removes the table
+	 */
+	__u32	nr;
+	__u32	__reserved;
+};
+
+/*
+ * One cgroup returned by PERF_EVENT_IOC_READ_CGROUP_TABLE
+ */
+struct perf_cgroup_value {
+	__u64	id;
+	__u64	count;		/* counted while tasks of @id ran */
+};
+
+/*
+ * Structure used by below PERF_EVENT_IOC_READ_CGROUP_TABLE command to read
+ * the counts of all cgroups in the table at once
+ */
+struct perf_event_cgroup_read {
+	/*
+	 * User provided array of struct perf_cgroup_value
+	 */
+	__u64	values;
+	/*
+	 * Array length, set by the kernel to the number of cgroups in the
+	 * table; -ENOSPC is returned if the array is too short
+	 */
+	__u32	nr;
+	__u32	__reserved;
+};
+
 /*
  * Ioctls that can be done on a perf event fd:
  */
@@ -505,6 +596,10 @@ struct perf_event_query_bpf {
 #define PERF_EVENT_IOC_PAUSE_OUTPUT		_IOW('$', 9, __u32)
 #define PERF_EVENT_IOC_QUERY_BPF		_IOWR('$', 10, struct perf_event_query_bpf *)
 #define PERF_EVENT_IOC_MODIFY_ATTRIBUTES	_IOW('$', 11, struct perf_event_attr *)
+#define PERF_EVENT_IOC_ADDR_AGGR		_IOW('$', 12, struct perf_event_addr_aggr *)
+#define PERF_EVENT_IOC_ADDR_AGGR_DRAIN		_IOWR('$', 13, struct perf_event_addr_aggr_drain *)
+#define PERF_EVENT_IOC_SET_CGROUP_TABLE		_IOW('$', 14, struct perf_event_cgroup_table *)
+#define PERF_EVENT_IOC_READ_CGROUP_TABLE	_IOWR('$', 15, struct perf_event_cgroup_read *)
 
 enum perf_event_ioc_flags {
 	PERF_IOC_FLAG_GROUP		= 1U << 0,
@@ -48,11 +48,21 @@ int bench_epoll_ctl(int argc, const char **argv);
 int bench_synthesize(int argc, const char **argv);
 int bench_kallsyms_parse(int argc, const char **argv);
 int bench_inject_build_id(int argc, const char **argv);
+int bench_io_uring(int argc, const char **argv);
+int bench_io_read(int argc, const char **argv);
+int bench_io_fault(int argc, const char **argv);
+int bench_io_mmap(int argc, const char **argv);
+int bench_net_tcp_rr(int argc, const char **argv);
+int bench_net_tcp_stream(int argc, const char **argv);
+int bench_net_udp(int argc, const char **argv);
+int bench_net_xdp(int argc, const char **argv);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
 #define BENCH_FORMAT_SIMPLE_STR		"simple"
 #define BENCH_FORMAT_SIMPLE		1
+#define BENCH_FORMAT_JSON_STR		"json"
+#define BENCH_FORMAT_JSON		2
 
 #define BENCH_FORMAT_UNKNOWN		-1
 
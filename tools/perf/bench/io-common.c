@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io-common.c
+ *
+ * Test file handling of the 'perf bench io' benchmarks.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/kernel.h>
+#include <linux/zalloc.h>
+
+#include "bench.h"
+#include "io.h"
+
+#define BENCH_IO_FILE_TEMPLATE	"perf-bench-io.XXXXXX"
+#define BENCH_IO_FILL_SIZE	(1 << 20)
+
+/*
+ * Open @path, or a temporary file in the current directory if @path is
+ * NULL, and make sure it holds @size bytes of data.  The data is written
+ * rather than left sparse so that reads reach the device.
+ */
+int bench_io_file_open(struct bench_io_file *file, const char *path,
+		       u64 size, int flags)
+{
+	struct stat st;
+	char *buf;
+	u64 off;
+	int fd;
+
+	memset(file, 0, sizeof(*file));
+
+	if (path) {
+		file->path = strdup(path);
+		if (!file->path)
+			return -ENOMEM;
+		fd = open(path, O_RDWR | O_CREAT, 0600);
+	} else {
+		file->path = strdup(BENCH_IO_FILE_TEMPLATE);
+		if (!file->path)
+			return -ENOMEM;
+		fd = mkstemp(file->path);
+		file->created = true;
+	}
+	if (fd < 0)
+		goto err;
+
+	if (fstat(fd, &st) < 0)
+		goto err_close;
+
+	if ((u64)st.st_size < size) {
+		buf = malloc(BENCH_IO_FILL_SIZE);
+		if (!buf)
+			goto err_close;
+		memset(buf, 0x5a, BENCH_IO_FILL_SIZE);
+
+		for (off = st.st_size; off < size; ) {
+			ssize_t len = min_t(u64, size - off, BENCH_IO_FILL_SIZE);
+
+			len = pwrite(fd, buf, len, off);
+			if (len <= 0) {
+				free(buf);
+				goto err_close;
+			}
+			off += len;
+		}
+		free(buf);
+
+		if (fsync(fd) < 0)
+			goto err_close;
+	}
+	close(fd);
+
+	/* reopen with the flags the benchmark asked for, e.g. O_DIRECT */
+	file->fd = open(file->path, flags);
+	if (file->fd < 0)
+		goto err;
+
+	file->size = size;
+	return 0;
+
+err_close:
+	close(fd);
+err:
+	fprintf(stderr, "%s: %s\n", file->path, strerror(errno));
+	if (file->created)
+		unlink(file->path);
+	zfree(&file->path);
+	return -1;
+}
+
+void bench_io_file_close(struct bench_io_file *file)
+{
+	if (!file->path)
+		return;
+
+	close(file->fd);
+	if (file->created)
+		unlink(file->path);
+	zfree(&file->path);
+}
+
+/* Write back and evict the file from the page cache for a cold start. */
+int bench_io_file_drop_cache(struct bench_io_file *file)
+{
+	if (fdatasync(file->fd) < 0)
+		return -errno;
+
+	return -posix_fadvise(file->fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
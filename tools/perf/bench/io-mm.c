@@ -0,0 +1,282 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io-mm.c
+ *
+ * fault: page fault rate of threads touching disjoint parts of one
+ * anonymous or file backed mapping.
+ *
+ * mmap: mmap()/munmap() rate of threads that each map, touch and unmap
+ * a small region in a loop, all against the same mm.
+ */
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <linux/kernel.h>
+#include <linux/zalloc.h>
+
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "io.h"
+
+static unsigned int nthreads = 1;
+static u64 map_size = BENCH_IO_FILE_SIZE_DEFAULT;
+static const char *file_path;
+static bool file_backed, read_only;
+static unsigned int nr_maps = 1 << 16;
+static unsigned int map_pages = 1;
+
+static const struct option fault_options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads,	"Number of threads faulting"),
+	OPT_U64('s', "size",	&map_size,	"Size of the mapping"),
+	OPT_BOOLEAN('f', "file-backed", &file_backed, "Map a file instead of anonymous memory"),
+	OPT_STRING('F', "file",	&file_path,	"path", "With --file-backed, map this file instead of a temporary one"),
+	OPT_BOOLEAN( 0 , "read", &read_only,	"Read fault the pages instead of writing them"),
+	OPT_END()
+};
+
+static const struct option mmap_options[] = {
+	OPT_UINTEGER('t', "threads", &nthreads,	"Number of threads mapping"),
+	OPT_UINTEGER('n', "maps", &nr_maps,	"Number of mmap()s per thread and run"),
+	OPT_UINTEGER('p', "pages", &map_pages,	"Number of pages in each mapping, all touched"),
+	OPT_END()
+};
+
+static const char * const bench_io_fault_usage[] = {
+	"perf bench io fault <options>",
+	NULL
+};
+
+static const char * const bench_io_mmap_usage[] = {
+	"perf bench io mmap <options>",
+	NULL
+};
+
+struct worker {
+	pthread_t	thread;
+	char		*start;
+	size_t		len;
+	int		err;
+};
+
+static pthread_barrier_t barrier;
+static long page_size;
+
+static void *fault_worker(void *arg)
+{
+	struct worker *w = arg;
+	volatile char *p;
+	char sum = 0;
+
+	pthread_barrier_wait(&barrier);
+
+	for (p = w->start; p < w->start + w->len; p += page_size) {
+		if (read_only)
+			sum += *p;
+		else
+			*p = 1;
+	}
+	(void)sum;
+
+	pthread_barrier_wait(&barrier);
+	return NULL;
+}
+
+static void *mmap_worker(void *arg)
+{
+	size_t len = map_pages * page_size;
+	struct worker *w = arg;
+	unsigned int i;
+	char *p, *q;
+
+	pthread_barrier_wait(&barrier);
+
+	for (i = 0; i < nr_maps; i++) {
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			w->err = errno;
+			break;
+		}
+		for (q = p; q < p + len; q += page_size)
+			*(volatile char *)q = 1;
+		munmap(p, len);
+	}
+
+	pthread_barrier_wait(&barrier);
+	return NULL;
+}
+
+/*
+ * Start the workers, time them from the first to the last one and
+ * return the nanoseconds between, or a negative errno.
+ */
+static s64 run_workers(struct worker *workers, void *(*fn)(void *))
+{
+	unsigned int i;
+	u64 start;
+	s64 ns;
+
+	pthread_barrier_init(&barrier, NULL, nthreads + 1);
+
+	for (i = 0; i < nthreads; i++) {
+		workers[i].err = 0;
+		if (pthread_create(&workers[i].thread, NULL, fn, &workers[i]))
+			err(EXIT_FAILURE, "pthread_create");
+	}
+
+	pthread_barrier_wait(&barrier);
+	start = bench_now_ns();
+	pthread_barrier_wait(&barrier);
+	ns = bench_now_ns() - start ?: 1;
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (workers[i].err)
+			ns = -workers[i].err;
+	}
+
+	pthread_barrier_destroy(&barrier);
+	return ns;
+}
+
+static void print_results(const char *bench, struct bench_metric *metrics,
+			  int nr_metrics, const char *extra_name,
+			  const char *extra_value)
+{
+	char s_threads[16];
+	struct bench_param params[] = {
+		{ "threads",	s_threads },
+		{ extra_name,	extra_value },
+	};
+
+	scnprintf(s_threads, sizeof(s_threads), "%u", nthreads);
+	bench_print_results(bench, params, ARRAY_SIZE(params), metrics, nr_metrics);
+}
+
+int bench_io_fault(int argc, const char **argv)
+{
+	struct bench_metric metrics[] = {
+		{ .name = "faults", .unit = "faults/sec" },
+	};
+	struct bench_io_file file = { .fd = -1 };
+	struct worker *workers;
+	size_t chunk, pages;
+	unsigned int i, r;
+	char s_type[64];
+	int ret = 1;
+	char *map;
+	s64 ns;
+
+	argc = parse_options(argc, argv, fault_options, bench_io_fault_usage, 0);
+	if (argc)
+		usage_with_options(bench_io_fault_usage, fault_options);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	pages = map_size / page_size;
+	if (!nthreads || pages < nthreads) {
+		fprintf(stderr, "Invalid threads or size\n");
+		return 1;
+	}
+	/* whole pages per thread */
+	chunk = pages / nthreads * page_size;
+	map_size = chunk * nthreads;
+
+	workers = calloc(nthreads, sizeof(*workers));
+	if (!workers)
+		return 1;
+
+	if (file_backed &&
+	    bench_io_file_open(&file, file_path, map_size,
+			       read_only ? O_RDONLY : O_RDWR))
+		goto out;
+
+	init_stats(&metrics[0].stats);
+
+	for (r = 0; r < bench_repeat; r++) {
+		/* file pages stay cached, so only the mapping is faulted */
+		map = mmap(NULL, map_size,
+			   read_only ? PROT_READ : PROT_READ | PROT_WRITE,
+			   file_backed ? MAP_SHARED : MAP_PRIVATE | MAP_ANONYMOUS,
+			   file.fd, 0);
+		if (map == MAP_FAILED) {
+			fprintf(stderr, "mmap: %s\n", strerror(errno));
+			goto out_file;
+		}
+
+		for (i = 0; i < nthreads; i++) {
+			workers[i].start = map + i * chunk;
+			workers[i].len = chunk;
+		}
+
+		ns = run_workers(workers, fault_worker);
+		munmap(map, map_size);
+
+		update_stats(&metrics[0].stats, (map_size / page_size) * 1e9 / ns);
+	}
+
+	scnprintf(s_type, sizeof(s_type), "%s-%s,%llu",
+		  file_backed ? "file" : "anon", read_only ? "read" : "write",
+		  (unsigned long long)map_size);
+	print_results("io/fault", metrics, ARRAY_SIZE(metrics), "mapping", s_type);
+	ret = 0;
+
+out_file:
+	bench_io_file_close(&file);
+out:
+	free(workers);
+	return ret;
+}
+
+int bench_io_mmap(int argc, const char **argv)
+{
+	struct bench_metric metrics[] = {
+		{ .name = "maps", .unit = "maps/sec" },
+		{ .name = "per-thread", .unit = "maps/sec" },
+	};
+	struct worker *workers;
+	char s_pages[16];
+	unsigned int r;
+	int ret = 1;
+	s64 ns;
+
+	argc = parse_options(argc, argv, mmap_options, bench_io_mmap_usage, 0);
+	if (argc)
+		usage_with_options(bench_io_mmap_usage, mmap_options);
+
+	if (!nthreads || !nr_maps || !map_pages) {
+		fprintf(stderr, "Invalid threads, maps or pages\n");
+		return 1;
+	}
+	page_size = sysconf(_SC_PAGESIZE);
+
+	workers = calloc(nthreads, sizeof(*workers));
+	if (!workers)
+		return 1;
+
+	init_stats(&metrics[0].stats);
+	init_stats(&metrics[1].stats);
+
+	for (r = 0; r < bench_repeat; r++) {
+		ns = run_workers(workers, mmap_worker);
+		if (ns < 0) {
+			fprintf(stderr, "mmap: %s\n", strerror(-ns));
+			goto out;
+		}
+
+		update_stats(&metrics[0].stats, (double)nr_maps * nthreads * 1e9 / ns);
+		update_stats(&metrics[1].stats, (double)nr_maps * 1e9 / ns);
+	}
+
+	scnprintf(s_pages, sizeof(s_pages), "%u", map_pages);
+	print_results("io/mmap", metrics, ARRAY_SIZE(metrics), "pages", s_pages);
+	ret = 0;
+out:
+	free(workers);
+	return ret;
+}
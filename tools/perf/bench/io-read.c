@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io-read.c
+ *
+ * read: sequential read(2) throughput of a file read through the page
+ * cache from the device (cold), from the page cache alone (cached), and
+ * bypassing it with O_DIRECT (direct).
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/kernel.h>
+
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "io.h"
+
+static const char *file_path;
+static u64 file_size = BENCH_IO_FILE_SIZE_DEFAULT;
+static unsigned int block_size = 128 << 10;
+
+static const struct option options[] = {
+	OPT_STRING('F', "file",	&file_path,	"path", "Read this file instead of a temporary one"),
+	OPT_U64('s', "size",	&file_size,	"Size of the file read"),
+	OPT_UINTEGER('b', "block", &block_size,	"Size of each read"),
+	OPT_END()
+};
+
+static const char * const bench_io_read_usage[] = {
+	"perf bench io read <options>",
+	NULL
+};
+
+/* Returns the time taken to read all of @fd, or a negative errno. */
+static s64 read_file(int fd, void *buf)
+{
+	u64 off, start;
+	ssize_t len;
+
+	start = bench_now_ns();
+
+	for (off = 0; off < file_size; off += len) {
+		len = pread(fd, buf, block_size, off);
+		if (len < 0)
+			return -errno;
+		if (!len)
+			return -EIO;
+	}
+
+	return bench_now_ns() - start ?: 1;
+}
+
+static void update_bandwidth(struct bench_metric *metric, s64 ns)
+{
+	update_stats(&metric->stats, (file_size / 1024.0) * 1e9 / ns);
+}
+
+int bench_io_read(int argc, const char **argv)
+{
+	struct bench_metric metrics[] = {
+		{ .name = "cold", .unit = "KiB/sec" },
+		{ .name = "cached", .unit = "KiB/sec" },
+		{ .name = "direct", .unit = "KiB/sec" },
+	};
+	char s_block[16], s_size[32];
+	struct bench_param params[] = {
+		{ "block",	s_block },
+		{ "size",	s_size },
+	};
+	struct bench_io_file file;
+	int direct_fd, err;
+	unsigned int i, r;
+	int ret = 1;
+	void *buf;
+	s64 ns;
+
+	argc = parse_options(argc, argv, options, bench_io_read_usage, 0);
+	if (argc)
+		usage_with_options(bench_io_read_usage, options);
+
+	if (!block_size || block_size % BENCH_IO_ALIGN || !file_size) {
+		fprintf(stderr, "Invalid block or size\n");
+		return 1;
+	}
+
+	if (posix_memalign(&buf, BENCH_IO_ALIGN, block_size))
+		return 1;
+
+	if (bench_io_file_open(&file, file_path, file_size, O_RDONLY))
+		goto out_buf;
+
+	/* not every file system supports O_DIRECT, that result is skipped */
+	direct_fd = open(file.path, O_RDONLY | O_DIRECT);
+
+	for (i = 0; i < ARRAY_SIZE(metrics); i++)
+		init_stats(&metrics[i].stats);
+
+	for (r = 0; r < bench_repeat; r++) {
+		err = bench_io_file_drop_cache(&file);
+		if (err) {
+			fprintf(stderr, "posix_fadvise: %s\n", strerror(-err));
+			goto out_file;
+		}
+
+		ns = read_file(file.fd, buf);
+		if (ns < 0)
+			goto err_read;
+		update_bandwidth(&metrics[0], ns);
+
+		/* the cold run left the whole file in the page cache */
+		ns = read_file(file.fd, buf);
+		if (ns < 0)
+			goto err_read;
+		update_bandwidth(&metrics[1], ns);
+
+		if (direct_fd < 0)
+			continue;
+
+		ns = read_file(direct_fd, buf);
+		if (ns < 0)
+			goto err_read;
+		update_bandwidth(&metrics[2], ns);
+	}
+
+	scnprintf(s_block, sizeof(s_block), "%u", block_size);
+	scnprintf(s_size, sizeof(s_size), "%llu", (unsigned long long)file_size);
+
+	bench_print_results("io/read", params, ARRAY_SIZE(params),
+			    metrics, ARRAY_SIZE(metrics));
+	ret = 0;
+	goto out_file;
+
+err_read:
+	fprintf(stderr, "read: %s\n", strerror(-ns));
+out_file:
+	if (direct_fd >= 0)
+		close(direct_fd);
+	bench_io_file_close(&file);
+out_buf:
+	free(buf);
+	return ret;
+}
@@ -0,0 +1,389 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io-uring.c
+ *
+ * io_uring: submission and completion rate of random reads (or nops)
+ * through an io_uring, optionally with a kernel submission thread
+ * (SQPOLL), completion polling (IOPOLL) and registered buffers.
+ *
+ * The ring is driven with the raw system calls so that liburing is not
+ * needed to build perf.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <linux/kernel.h>
+#include <linux/zalloc.h>
+
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "io.h"
+
+#ifndef __NR_io_uring_setup
+# define __NR_io_uring_setup	425
+#endif
+#ifndef __NR_io_uring_enter
+# define __NR_io_uring_enter	426
+#endif
+#ifndef __NR_io_uring_register
+# define __NR_io_uring_register	427
+#endif
+
+static const char *file_path;
+static u64 file_size = BENCH_IO_FILE_SIZE_DEFAULT;
+static unsigned int block_size = 4096;
+static unsigned int depth = 32;
+static unsigned int nr_ios = 1 << 18;
+static u64 seed = 1;
+static bool nop, direct, sqpoll, iopoll, fixed;
+
+static const struct option options[] = {
+	OPT_STRING('F', "file",	&file_path,	"path", "Read from this file instead of a temporary one"),
+	OPT_U64('s', "size",	&file_size,	"Size of the file read from"),
+	OPT_UINTEGER('b', "block", &block_size,	"Size of each read"),
+	OPT_UINTEGER('d', "depth", &depth,	"Number of reads in flight"),
+	OPT_UINTEGER('n', "ios", &nr_ios,	"Number of reads per run"),
+	OPT_U64('S', "seed",	&seed,		"Seed of the random read offsets"),
+	OPT_BOOLEAN( 0 , "nop",	&nop,		"Submit nops, to measure the ring alone"),
+	OPT_BOOLEAN('D', "direct", &direct,	"Read with O_DIRECT"),
+	OPT_BOOLEAN( 0 , "sqpoll", &sqpoll,	"Submit from a kernel thread (IORING_SETUP_SQPOLL)"),
+	OPT_BOOLEAN( 0 , "iopoll", &iopoll,	"Poll for completions (IORING_SETUP_IOPOLL, implies --direct)"),
+	OPT_BOOLEAN( 0 , "fixed", &fixed,	"Read into registered buffers"),
+	OPT_END()
+};
+
+static const char * const bench_io_uring_usage[] = {
+	"perf bench io uring <options>",
+	NULL
+};
+
+struct ring {
+	int			fd;
+	unsigned int		sq_entries;
+	unsigned int		*sq_head, *sq_tail, *sq_mask, *sq_flags, *sq_array;
+	unsigned int		*cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe	*sqes;
+	struct io_uring_cqe	*cqes;
+	void			*sq_ring, *cq_ring;
+	size_t			sq_ring_size, cq_ring_size, sqes_size;
+	bool			single_mmap;
+};
+
+static int ring_setup(struct ring *ring, unsigned int entries)
+{
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+	if (sqpoll)
+		p.flags |= IORING_SETUP_SQPOLL;
+	if (iopoll)
+		p.flags |= IORING_SETUP_IOPOLL;
+
+	ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+		return -errno;
+
+	ring->sq_entries = p.sq_entries;
+	ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring->single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+	if (ring->single_mmap)
+		ring->sq_ring_size = ring->cq_ring_size =
+			max(ring->sq_ring_size, ring->cq_ring_size);
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		goto err;
+
+	if (ring->single_mmap) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size,
+				     PROT_READ | PROT_WRITE,
+				     MAP_SHARED | MAP_POPULATE, ring->fd,
+				     IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED)
+			goto err_sq;
+	}
+
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto err_cq;
+
+	ring->sq_head = ring->sq_ring + p.sq_off.head;
+	ring->sq_tail = ring->sq_ring + p.sq_off.tail;
+	ring->sq_mask = ring->sq_ring + p.sq_off.ring_mask;
+	ring->sq_flags = ring->sq_ring + p.sq_off.flags;
+	ring->sq_array = ring->sq_ring + p.sq_off.array;
+	ring->cq_head = ring->cq_ring + p.cq_off.head;
+	ring->cq_tail = ring->cq_ring + p.cq_off.tail;
+	ring->cq_mask = ring->cq_ring + p.cq_off.ring_mask;
+	ring->cqes = ring->cq_ring + p.cq_off.cqes;
+	return 0;
+
+err_cq:
+	if (!ring->single_mmap)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+err_sq:
+	munmap(ring->sq_ring, ring->sq_ring_size);
+err:
+	close(ring->fd);
+	return -errno;
+}
+
+static void ring_exit(struct ring *ring)
+{
+	munmap(ring->sqes, ring->sqes_size);
+	if (!ring->single_mmap)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	munmap(ring->sq_ring, ring->sq_ring_size);
+	close(ring->fd);
+}
+
+static int ring_enter(struct ring *ring, unsigned int to_submit,
+		      unsigned int min_complete)
+{
+	unsigned int flags = 0;
+
+	if (min_complete)
+		flags |= IORING_ENTER_GETEVENTS;
+
+	if (sqpoll) {
+		/* the kernel thread picks up new entries by itself */
+		to_submit = 0;
+		if (__atomic_load_n(ring->sq_flags, __ATOMIC_ACQUIRE) &
+		    IORING_SQ_NEED_WAKEUP)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+		if (!flags)
+			return 0;
+	}
+
+	if (syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete,
+		    flags, NULL, 0) < 0 && errno != EINTR && errno != EAGAIN &&
+	    errno != EBUSY)
+		return -errno;
+
+	return 0;
+}
+
+struct run {
+	struct ring		*ring;
+	struct bench_io_file	*file;
+	char			**bufs;
+	unsigned int		*free_slots;
+	unsigned int		nr_free;
+	u64			rand;
+	u64			nr_blocks;
+};
+
+static void prep_sqe(struct run *run, struct io_uring_sqe *sqe)
+{
+	unsigned int slot = run->free_slots[--run->nr_free];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = slot;
+
+	if (nop) {
+		sqe->opcode = IORING_OP_NOP;
+		return;
+	}
+
+	sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+	sqe->fd = run->file->fd;
+	sqe->addr = (unsigned long)run->bufs[slot];
+	sqe->len = block_size;
+	sqe->off = (bench_io_rand(&run->rand) % run->nr_blocks) * block_size;
+	if (fixed)
+		sqe->buf_index = slot;
+}
+
+/* Returns the run time in nanoseconds, or a negative errno. */
+static s64 do_run(struct run *run)
+{
+	struct ring *ring = run->ring;
+	unsigned int submitted = 0, completed = 0, inflight = 0;
+	unsigned int tail, head, to_submit;
+	struct io_uring_cqe *cqe;
+	u64 start;
+	int err;
+
+	start = bench_now_ns();
+
+	while (completed < nr_ios) {
+		tail = *ring->sq_tail;
+		for (to_submit = 0; inflight + to_submit < depth &&
+				    submitted + to_submit < nr_ios; to_submit++) {
+			unsigned int idx = tail & *ring->sq_mask;
+
+			prep_sqe(run, &ring->sqes[idx]);
+			ring->sq_array[idx] = idx;
+			tail++;
+		}
+		__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+		submitted += to_submit;
+		inflight += to_submit;
+
+		err = ring_enter(ring, to_submit, 1);
+		if (err)
+			return err;
+
+		head = *ring->cq_head;
+		while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+			cqe = &ring->cqes[head & *ring->cq_mask];
+			if (cqe->res < 0)
+				return cqe->res;
+			if (!nop && (unsigned int)cqe->res != block_size)
+				return -EIO;
+
+			run->free_slots[run->nr_free++] = cqe->user_data;
+			inflight--;
+			completed++;
+			head++;
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	return bench_now_ns() - start;
+}
+
+int bench_io_uring(int argc, const char **argv)
+{
+	struct bench_metric metrics[] = {
+		{ .name = "ios", .unit = "ios/sec" },
+		{ .name = "bandwidth", .unit = "KiB/sec" },
+		{ .name = "latency", .unit = "nsecs/io" },
+	};
+	char s_block[16], s_depth[16], s_ios[16], s_size[32];
+	struct bench_param params[] = {
+		{ "op",		NULL },
+		{ "block",	s_block },
+		{ "depth",	s_depth },
+		{ "ios",	s_ios },
+		{ "size",	s_size },
+		{ "sqpoll",	NULL },
+		{ "iopoll",	NULL },
+		{ "fixed",	NULL },
+	};
+	struct bench_io_file file = { .fd = -1 };
+	struct iovec *iovs = NULL;
+	struct ring ring;
+	struct run run;
+	unsigned int i, r;
+	int ret = 1;
+	s64 ns;
+
+	argc = parse_options(argc, argv, options, bench_io_uring_usage, 0);
+	if (argc)
+		usage_with_options(bench_io_uring_usage, options);
+
+	if (iopoll)
+		direct = true;
+
+	if (!depth || !nr_ios || !block_size || block_size % BENCH_IO_ALIGN ||
+	    file_size < block_size) {
+		fprintf(stderr, "Invalid depth, ios, block or size\n");
+		return 1;
+	}
+
+	memset(&run, 0, sizeof(run));
+	run.file = &file;
+	run.ring = &ring;
+	run.nr_blocks = file_size / block_size;
+
+	if (!nop && bench_io_file_open(&file, file_path, file_size,
+				       O_RDONLY | (direct ? O_DIRECT : 0)))
+		return 1;
+
+	ret = ring_setup(&ring, depth);
+	if (ret) {
+		fprintf(stderr, "io_uring_setup: %s\n", strerror(-ret));
+		ret = 1;
+		goto out_file;
+	}
+	ret = 1;
+	if (ring.sq_entries < depth)
+		depth = ring.sq_entries;
+
+	run.bufs = calloc(depth, sizeof(*run.bufs));
+	run.free_slots = calloc(depth, sizeof(*run.free_slots));
+	iovs = calloc(depth, sizeof(*iovs));
+	if (!run.bufs || !run.free_slots || !iovs)
+		goto out_ring;
+
+	for (i = 0; i < depth; i++) {
+		if (posix_memalign((void **)&run.bufs[i], BENCH_IO_ALIGN,
+				   block_size))
+			goto out_bufs;
+		iovs[i].iov_base = run.bufs[i];
+		iovs[i].iov_len = block_size;
+	}
+
+	if (fixed && !nop &&
+	    syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS,
+		    iovs, depth) < 0) {
+		fprintf(stderr, "IORING_REGISTER_BUFFERS: %s\n", strerror(errno));
+		goto out_bufs;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(metrics); i++)
+		init_stats(&metrics[i].stats);
+
+	for (r = 0; r < bench_repeat; r++) {
+		/* every run reads the same offsets */
+		run.rand = seed ?: 1;
+		run.nr_free = depth;
+		for (i = 0; i < depth; i++)
+			run.free_slots[i] = i;
+
+		ns = do_run(&run);
+		if (ns < 0) {
+			fprintf(stderr, "io_uring: %s\n", strerror(-ns));
+			goto out_bufs;
+		}
+		if (!ns)
+			ns = 1;
+
+		update_stats(&metrics[0].stats, nr_ios * 1e9 / ns);
+		if (!nop)
+			update_stats(&metrics[1].stats,
+				     nr_ios * (block_size / 1024.0) * 1e9 / ns);
+		update_stats(&metrics[2].stats, ns / nr_ios);
+	}
+
+	params[0].value = nop ? "nop" : fixed ? "read_fixed" : "read";
+	scnprintf(s_block, sizeof(s_block), "%u", block_size);
+	scnprintf(s_depth, sizeof(s_depth), "%u", depth);
+	scnprintf(s_ios, sizeof(s_ios), "%u", nr_ios);
+	scnprintf(s_size, sizeof(s_size), "%llu", (unsigned long long)file_size);
+	params[5].value = sqpoll ? "yes" : "no";
+	params[6].value = iopoll ? "yes" : "no";
+	params[7].value = fixed ? "yes" : "no";
+
+	bench_print_results("io/uring", params, ARRAY_SIZE(params),
+			    metrics, ARRAY_SIZE(metrics));
+	ret = 0;
+
+out_bufs:
+	for (i = 0; i < depth; i++)
+		free(run.bufs[i]);
+out_ring:
+	free(iovs);
+	free(run.free_slots);
+	free(run.bufs);
+	ring_exit(&ring);
+out_file:
+	bench_io_file_close(&file);
+	return ret;
+}
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Glue shared by the 'perf bench io' benchmarks.
+ */
+#ifndef _BENCH_IO_H
+#define _BENCH_IO_H
+
+#include <stdbool.h>
+#include <linux/types.h>
+#include "results.h"
+
+#define BENCH_IO_FILE_SIZE_DEFAULT	(256 << 20)
+#define BENCH_IO_ALIGN			4096
+
+struct bench_io_file {
+	int		fd;
+	u64		size;
+	char		*path;
+	bool		created;	/* ours to unlink on close */
+};
+
+int bench_io_file_open(struct bench_io_file *file, const char *path,
+		       u64 size, int flags);
+void bench_io_file_close(struct bench_io_file *file);
+int bench_io_file_drop_cache(struct bench_io_file *file);
+
+/* xorshift64, so that random patterns are the same on every run */
+static inline u64 bench_io_rand(u64 *state)
+{
+	u64 x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return *state = x;
+}
+
+#endif /* _BENCH_IO_H */
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * net-common.c
+ *
+ * Cycle counting and loopback sockets of the 'perf bench net' benchmarks.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/perf_event.h>
+#include <linux/zalloc.h>
+#include <perf/cpumap.h>
+
+#include "../perf-sys.h"
+#include "bench.h"
+#include "net.h"
+
+static int cycles_open(struct perf_event_attr *attr, pid_t pid, int cpu)
+{
+	return sys_perf_event_open(attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+int bench_cycles_open(struct bench_cycles *cycles)
+{
+	struct perf_event_attr attr = {
+		.type		= PERF_TYPE_HARDWARE,
+		.size		= sizeof(attr),
+		.config		= PERF_COUNT_HW_CPU_CYCLES,
+		.read_format	= PERF_FORMAT_TOTAL_TIME_ENABLED |
+				  PERF_FORMAT_TOTAL_TIME_RUNNING,
+		.disabled	= 1,
+	};
+	struct perf_cpu_map *cpus;
+	int i, fd = -1;
+
+	memset(cycles, 0, sizeof(*cycles));
+
+	cpus = perf_cpu_map__new(NULL);
+	if (!cpus)
+		return -ENOMEM;
+
+	cycles->fds = calloc(perf_cpu_map__nr(cpus), sizeof(int));
+	if (!cycles->fds) {
+		perf_cpu_map__put(cpus);
+		return -ENOMEM;
+	}
+
+	cycles->system_wide = true;
+	for (i = 0; i < perf_cpu_map__nr(cpus); i++) {
+		fd = cycles_open(&attr, -1, perf_cpu_map__cpu(cpus, i));
+		if (fd < 0)
+			break;
+		cycles->fds[cycles->nr++] = fd;
+	}
+	perf_cpu_map__put(cpus);
+
+	if (fd >= 0)
+		return 0;
+
+	/* not allowed to count system wide, count ourselves instead */
+	while (cycles->nr)
+		close(cycles->fds[--cycles->nr]);
+	cycles->system_wide = false;
+
+	attr.inherit = 1;
+	fd = cycles_open(&attr, 0, -1);
+	if (fd < 0) {
+		zfree(&cycles->fds);
+		return -errno;
+	}
+	cycles->fds[cycles->nr++] = fd;
+	return 0;
+}
+
+void bench_cycles_close(struct bench_cycles *cycles)
+{
+	while (cycles->nr)
+		close(cycles->fds[--cycles->nr]);
+	zfree(&cycles->fds);
+}
+
+void bench_cycles_start(struct bench_cycles *cycles)
+{
+	int i;
+
+	for (i = 0; i < cycles->nr; i++) {
+		ioctl(cycles->fds[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(cycles->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+u64 bench_cycles_stop(struct bench_cycles *cycles)
+{
+	struct {
+		u64 value, enabled, running;
+	} count;
+	double total = 0;
+	int i;
+
+	for (i = 0; i < cycles->nr; i++)
+		ioctl(cycles->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+	for (i = 0; i < cycles->nr; i++) {
+		if (read(cycles->fds[i], &count, sizeof(count)) != sizeof(count))
+			return 0;
+		if (count.running)
+			total += (double)count.value * count.enabled / count.running;
+	}
+
+	return total;
+}
+
+const char *bench_cycles_scope(struct bench_cycles *cycles)
+{
+	if (!cycles->nr)
+		return "none";
+	return cycles->system_wide ? "system-wide" : "process";
+}
+
+static void loopback_addr(struct sockaddr_in *addr, u16 port)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr->sin_port = htons(port);
+}
+
+int bench_net_listen(int type, u16 *port, bool reuseport)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int fd, err, one = 1;
+
+	fd = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+
+	if (reuseport &&
+	    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)
+		goto err;
+
+	loopback_addr(&addr, *port);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		goto err;
+
+	if (type == SOCK_STREAM && listen(fd, 16) < 0)
+		goto err;
+
+	if (getsockname(fd, (struct sockaddr *)&addr, &len) < 0)
+		goto err;
+	*port = ntohs(addr.sin_port);
+	return fd;
+
+err:
+	err = -errno;
+	close(fd);
+	return err;
+}
+
+int bench_net_connect(int type, u16 port)
+{
+	struct sockaddr_in addr;
+	int fd;
+
+	fd = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+
+	loopback_addr(&addr, port);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		int err = -errno;
+
+		close(fd);
+		return err;
+	}
+
+	return fd;
+}
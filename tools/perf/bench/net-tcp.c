@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * net-tcp.c
+ *
+ * tcp-rr: request/response transactions over a loopback TCP connection,
+ * the cost of a round trip through the stack.
+ *
+ * tcp-stream: bulk transfer over a loopback TCP connection.
+ */
+#include <err.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/kernel.h>
+#include <linux/tcp.h>
+
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "net.h"
+
+static unsigned int msg_size;
+static unsigned int nr_trans = 100000;
+static u64 stream_size = 1ULL << 30;
+
+static const struct option rr_options[] = {
+	OPT_UINTEGER('m', "size", &msg_size,	"Size of requests and responses (default: 1)"),
+	OPT_UINTEGER('n', "transactions", &nr_trans, "Number of transactions per run"),
+	OPT_END()
+};
+
+static const struct option stream_options[] = {
+	OPT_UINTEGER('m', "size", &msg_size,	"Size of each send (default: 65536)"),
+	OPT_U64('s', "bytes",	&stream_size,	"Number of bytes sent per run"),
+	OPT_END()
+};
+
+static const char * const bench_net_tcp_rr_usage[] = {
+	"perf bench net tcp-rr <options>",
+	NULL
+};
+
+static const char * const bench_net_tcp_stream_usage[] = {
+	"perf bench net tcp-stream <options>",
+	NULL
+};
+
+struct server {
+	pthread_t	thread;
+	int		listen_fd;
+	bool		echo;
+	int		err;
+};
+
+static int recv_all(int fd, char *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = recv(fd, buf, len, 0);
+		if (ret <= 0)
+			return ret;
+		buf += ret;
+		len -= ret;
+	}
+	return 1;
+}
+
+/* Echo every message back (tcp-rr) or swallow the stream (tcp-stream). */
+static void *server_thread(void *arg)
+{
+	struct server *s = arg;
+	char *buf;
+	ssize_t ret;
+	int fd;
+
+	buf = malloc(msg_size);
+	fd = accept(s->listen_fd, NULL, NULL);
+	if (!buf || fd < 0) {
+		s->err = buf ? errno : ENOMEM;
+		free(buf);
+		return NULL;
+	}
+
+	for (;;) {
+		if (s->echo) {
+			ret = recv_all(fd, buf, msg_size);
+			if (ret > 0 && send(fd, buf, msg_size, 0) != (ssize_t)msg_size)
+				ret = -1;
+		} else {
+			ret = recv(fd, buf, msg_size, 0);
+		}
+		if (ret <= 0)
+			break;
+	}
+	if (ret < 0)
+		s->err = errno;
+
+	close(fd);
+	free(buf);
+	return NULL;
+}
+
+static int start_server(struct server *s, u16 *port, bool echo)
+{
+	*port = 0;
+	s->err = 0;
+	s->echo = echo;
+	s->listen_fd = bench_net_listen(SOCK_STREAM, port, false);
+	if (s->listen_fd < 0)
+		return s->listen_fd;
+
+	if (pthread_create(&s->thread, NULL, server_thread, s))
+		err(EXIT_FAILURE, "pthread_create");
+	return 0;
+}
+
+static int stop_server(struct server *s)
+{
+	pthread_join(s->thread, NULL);
+	close(s->listen_fd);
+	return -s->err;
+}
+
+static int client_connect(u16 port)
+{
+	int fd, one = 1;
+
+	fd = bench_net_connect(SOCK_STREAM, port);
+	if (fd >= 0)
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fd;
+}
+
+static u32 segs_out(int fd)
+{
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+
+	memset(&info, 0, sizeof(info));
+	getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len);
+	return info.tcpi_segs_out;
+}
+
+static void print_results(const char *bench, struct bench_metric *metrics,
+			  int nr_metrics, struct bench_cycles *cycles)
+{
+	char s_size[16], s_count[32];
+	struct bench_param params[] = {
+		{ "size",	s_size },
+		{ "count",	s_count },
+		{ "cycles",	bench_cycles_scope(cycles) },
+	};
+
+	scnprintf(s_size, sizeof(s_size), "%u", msg_size);
+	if (!strcmp(bench, "net/tcp-rr"))
+		scnprintf(s_count, sizeof(s_count), "%u", nr_trans);
+	else
+		scnprintf(s_count, sizeof(s_count), "%llu",
+			  (unsigned long long)stream_size);
+
+	bench_print_results(bench, params, ARRAY_SIZE(params),
+			    metrics, nr_metrics);
+}
+
+int bench_net_tcp_rr(int argc, const char **argv)
+{
+	struct bench_metric metrics[] = {
+		{ .name = "transactions", .unit = "trans/sec" },
+		{ .name = "latency", .unit = "nsecs/trans" },
+		{ .name = "cycles", .unit = "cycles/trans" },
+	};
+	struct bench_cycles cycles;
+	struct server server;
+	unsigned int i, r;
+	int fd, ret = 1;
+	u64 start, c;
+	char *buf;
+	s64 ns;
+	u16 port;
+
+	msg_size = 1;
+	argc = parse_options(argc, argv, rr_options, bench_net_tcp_rr_usage, 0);
+	if (argc)
+		usage_with_options(bench_net_tcp_rr_usage, rr_options);
+
+	if (!msg_size || !nr_trans) {
+		fprintf(stderr, "Invalid size or transactions\n");
+		return 1;
+	}
+
+	buf = calloc(1, msg_size);
+	if (!buf)
+		return 1;
+
+	/* before the server thread is created, so that it inherits it */
+	ret = bench_cycles_open(&cycles);
+	if (ret)
+		fprintf(stderr, "Not counting cycles: %s\n", strerror(-ret));
+	ret = 1;
+
+	for (i = 0; i < ARRAY_SIZE(metrics); i++)
+		init_stats(&metrics[i].stats);
+
+	for (r = 0; r < bench_repeat; r++) {
+		if (start_server(&server, &port, true) < 0)
+			goto out;
+
+		fd = client_connect(port);
+		if (fd < 0) {
+			stop_server(&server);
+			goto out;
+		}
+
+		bench_cycles_start(&cycles);
+		start = bench_now_ns();
+		for (i = 0; i < nr_trans; i++) {
+			if (send(fd, buf, msg_size, 0) != (ssize_t)msg_size ||
+			    recv_all(fd, buf, msg_size) <= 0)
+				break;
+		}
+		ns = bench_now_ns() - start ?: 1;
+		c = bench_cycles_stop(&cycles);
+
+		close(fd);
+		if (stop_server(&server) || i < nr_trans) {
+			fprintf(stderr, "tcp-rr: transaction failed\n");
+			goto out;
+		}
+
+		update_stats(&metrics[0].stats, nr_trans * 1e9 / ns);
+		update_stats(&metrics[1].stats, ns / nr_trans);
+		if (c)
+			update_stats(&metrics[2].stats, c / nr_trans);
+	}
+
+	print_results("net/tcp-rr", metrics, ARRAY_SIZE(metrics), &cycles);
+	ret = 0;
+out:
+	bench_cycles_close(&cycles);
+	free(buf);
+	return ret;
+}
+
+int bench_net_tcp_stream(int argc, const char **argv)
+{
+	struct bench_metric metrics[] = {
+		{ .name = "bandwidth", .unit = "KiB/sec" },
+		{ .name = "segments", .unit = "segs/sec" },
+		{ .name = "cycles", .unit = "cycles/seg" },
+	};
+	struct bench_cycles cycles;
+	struct server server;
+	unsigned int i, r;
+	int fd, ret = 1;
+	u64 start, c, sent;
+	u32 segs;
+	char *buf;
+	s64 ns;
+	u16 port;
+
+	msg_size = 65536;
+	argc = parse_options(argc, argv, stream_options,
+			     bench_net_tcp_stream_usage, 0);
+	if (argc)
+		usage_with_options(bench_net_tcp_stream_usage, stream_options);
+
+	if (!msg_size || !stream_size) {
+		fprintf(stderr, "Invalid size or bytes\n");
+		return 1;
+	}
+
+	buf = calloc(1, msg_size);
+	if (!buf)
+		return 1;
+
+	ret = bench_cycles_open(&cycles);
+	if (ret)
+		fprintf(stderr, "Not counting cycles: %s\n", strerror(-ret));
+	ret = 1;
+
+	for (i = 0; i < ARRAY_SIZE(metrics); i++)
+		init_stats(&metrics[i].stats);
+
+	for (r = 0; r < bench_repeat; r++) {
+		if (start_server(&server, &port, false) < 0)
+			goto out;
+
+		fd = client_connect(port);
+		if (fd < 0) {
+			stop_server(&server);
+			goto out;
+		}
+
+		bench_cycles_start(&cycles);
+		start = bench_now_ns();
+		for (sent = 0; sent < stream_size; ) {
+			ssize_t len = min_t(u64, stream_size - sent, msg_size);
+
+			len = send(fd, buf, len, 0);
+			if (len <= 0)
+				break;
+			sent += len;
+		}
+		/* the run ends once the server has received everything */
+		shutdown(fd, SHUT_WR);
+		segs = segs_out(fd);
+		pthread_join(server.thread, NULL);
+		ns = bench_now_ns() - start ?: 1;
+		c = bench_cycles_stop(&cycles);
+
+		close(fd);
+		close(server.listen_fd);
+		if (server.err || sent < stream_size) {
+			fprintf(stderr, "tcp-stream: transfer failed\n");
+			goto out;
+		}
+
+		update_stats(&metrics[0].stats, (stream_size / 1024.0) * 1e9 / ns);
+		update_stats(&metrics[1].stats, segs * 1e9 / ns);
+		if (c && segs)
+			update_stats(&metrics[2].stats, c / segs);
+	}
+
+	print_results("net/tcp-stream", metrics, ARRAY_SIZE(metrics), &cycles);
+	ret = 0;
+out:
+	bench_cycles_close(&cycles);
+	free(buf);
+	return ret;
+}
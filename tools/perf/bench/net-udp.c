@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * net-udp.c
+ *
+ * udp: small datagram rate over loopback from several senders to a
+ * SO_REUSEPORT group of receivers, each on its own socket and thread.
+ */
+#include <err.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "net.h"
+
+/* what fits into a 1500 byte MTU */
+#define UDP_SIZE_MAX	1472
+
+static unsigned int nr_receivers = 4;
+static unsigned int nr_senders = 4;
+static unsigned int msg_size = 64;
+static unsigned int nr_packets = 200000;
+
+static const struct option options[] = {
+	OPT_UINTEGER('r', "receivers", &nr_receivers, "Number of SO_REUSEPORT receivers"),
+	OPT_UINTEGER('s', "senders", &nr_senders, "Number of senders"),
+	OPT_UINTEGER('m', "size", &msg_size,	"Size of each datagram"),
+	OPT_UINTEGER('n', "packets", &nr_packets, "Number of datagrams per sender and run"),
+	OPT_END()
+};
+
+static const char * const bench_net_udp_usage[] = {
+	"perf bench net udp <options>",
+	NULL
+};
+
+struct worker {
+	pthread_t	thread;
+	int		fd;
+	u64		packets;
+};
+
+static pthread_barrier_t start_barrier;
+static bool done;
+
+static void *receiver_thread(void *arg)
+{
+	struct worker *w = arg;
+	char buf[UDP_SIZE_MAX];
+	ssize_t ret;
+
+	pthread_barrier_wait(&start_barrier);
+
+	for (;;) {
+		ret = recv(w->fd, buf, sizeof(buf), 0);
+		if (ret >= 0) {
+			w->packets++;
+			continue;
+		}
+		/* timed out, the senders may be done */
+		if (READ_ONCE(done))
+			break;
+	}
+	return NULL;
+}
+
+static void *sender_thread(void *arg)
+{
+	struct worker *w = arg;
+	char buf[UDP_SIZE_MAX] = { 0 };
+	unsigned int i;
+
+	pthread_barrier_wait(&start_barrier);
+
+	for (i = 0; i < nr_packets; i++) {
+		if (send(w->fd, buf, msg_size, 0) == (ssize_t)msg_size)
+			w->packets++;
+	}
+	return NULL;
+}
+
+static void start_workers(struct worker *workers, unsigned int nr,
+			  void *(*fn)(void *))
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		workers[i].packets = 0;
+		if (pthread_create(&workers[i].thread, NULL, fn, &workers[i]))
+			err(EXIT_FAILURE, "pthread_create");
+	}
+}
+
+static u64 join_workers(struct worker *workers, unsigned int nr, u64 *max)
+{
+	u64 total = 0;
+	unsigned int i;
+
+	*max = 0;
+	for (i = 0; i < nr; i++) {
+		pthread_join(workers[i].thread, NULL);
+		total += workers[i].packets;
+		*max = max(*max, workers[i].packets);
+	}
+	return total;
+}
+
+int bench_net_udp(int argc, const char **argv)
+{
+	struct bench_metric metrics[] = {
+		{ .name = "sent", .unit = "pkts/sec" },
+		{ .name = "received", .unit = "pkts/sec" },
+		{ .name = "dropped", .unit = "pkts/sec" },
+		{ .name = "imbalance", .unit = "% over mean" },
+		{ .name = "cycles", .unit = "cycles/pkt" },
+	};
+	struct timeval timeout = { .tv_usec = 100000 };
+	char s_receivers[16], s_senders[16], s_size[16], s_packets[16];
+	struct bench_param params[] = {
+		{ "receivers",	s_receivers },
+		{ "senders",	s_senders },
+		{ "size",	s_size },
+		{ "packets",	s_packets },
+		{ "cycles",	NULL },
+	};
+	struct worker *receivers, *senders;
+	u64 start, c, sent, received, max;
+	struct bench_cycles cycles;
+	unsigned int i, r;
+	int ret = 1;
+	u16 port = 0;
+	s64 ns;
+
+	argc = parse_options(argc, argv, options, bench_net_udp_usage, 0);
+	if (argc)
+		usage_with_options(bench_net_udp_usage, options);
+
+	if (!nr_receivers || !nr_senders || !msg_size || msg_size > UDP_SIZE_MAX ||
+	    !nr_packets) {
+		fprintf(stderr, "Invalid receivers, senders, size or packets\n");
+		return 1;
+	}
+
+	receivers = calloc(nr_receivers, sizeof(*receivers));
+	senders = calloc(nr_senders, sizeof(*senders));
+	if (!receivers || !senders)
+		goto out_free;
+
+	/* all receivers share the port of the first one */
+	for (i = 0; i < nr_receivers; i++) {
+		receivers[i].fd = bench_net_listen(SOCK_DGRAM, &port, true);
+		if (receivers[i].fd < 0) {
+			fprintf(stderr, "udp: %s\n", strerror(-receivers[i].fd));
+			goto out_close;
+		}
+		setsockopt(receivers[i].fd, SOL_SOCKET, SO_RCVTIMEO,
+			   &timeout, sizeof(timeout));
+	}
+
+	/* a socket, and so a source port and reuseport hash, per sender */
+	for (i = 0; i < nr_senders; i++) {
+		senders[i].fd = bench_net_connect(SOCK_DGRAM, port);
+		if (senders[i].fd < 0) {
+			fprintf(stderr, "udp: %s\n", strerror(-senders[i].fd));
+			goto out_close;
+		}
+	}
+
+	ret = bench_cycles_open(&cycles);
+	if (ret)
+		fprintf(stderr, "Not counting cycles: %s\n", strerror(-ret));
+	ret = 1;
+
+	for (i = 0; i < ARRAY_SIZE(metrics); i++)
+		init_stats(&metrics[i].stats);
+
+	for (r = 0; r < bench_repeat; r++) {
+		done = false;
+		pthread_barrier_init(&start_barrier, NULL,
+				     nr_receivers + nr_senders + 1);
+		start_workers(receivers, nr_receivers, receiver_thread);
+		start_workers(senders, nr_senders, sender_thread);
+
+		bench_cycles_start(&cycles);
+		pthread_barrier_wait(&start_barrier);
+		start = bench_now_ns();
+
+		sent = join_workers(senders, nr_senders, &max);
+		ns = bench_now_ns() - start ?: 1;
+		WRITE_ONCE(done, true);
+
+		received = join_workers(receivers, nr_receivers, &max);
+		c = bench_cycles_stop(&cycles);
+		pthread_barrier_destroy(&start_barrier);
+
+		update_stats(&metrics[0].stats, sent * 1e9 / ns);
+		update_stats(&metrics[1].stats, received * 1e9 / ns);
+		update_stats(&metrics[2].stats,
+			     (sent > received ? sent - received : 0) * 1e9 / ns);
+		if (received)
+			update_stats(&metrics[3].stats,
+				     (max * nr_receivers * 100 / received) - 100);
+		if (c && received)
+			update_stats(&metrics[4].stats, c / received);
+	}
+
+	scnprintf(s_receivers, sizeof(s_receivers), "%u", nr_receivers);
+	scnprintf(s_senders, sizeof(s_senders), "%u", nr_senders);
+	scnprintf(s_size, sizeof(s_size), "%u", msg_size);
+	scnprintf(s_packets, sizeof(s_packets), "%u", nr_packets);
+	params[4].value = bench_cycles_scope(&cycles);
+
+	bench_print_results("net/udp", params, ARRAY_SIZE(params),
+			    metrics, ARRAY_SIZE(metrics));
+	bench_cycles_close(&cycles);
+	ret = 0;
+
+out_close:
+	for (i = 0; i < nr_senders; i++)
+		if (senders[i].fd > 0)
+			close(senders[i].fd);
+	for (i = 0; i < nr_receivers; i++)
+		if (receivers[i].fd > 0)
+			close(receivers[i].fd);
+out_free:
+	free(senders);
+	free(receivers);
+	return ret;
+}
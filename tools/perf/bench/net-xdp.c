@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * net-xdp.c
+ *
+ * xdp: per packet cost of running an XDP program that bounds checks the
+ * Ethernet header and returns a verdict, measured with BPF_PROG_TEST_RUN
+ * so that neither a NIC nor a veth setup is needed.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <bpf/bpf.h>
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/kernel.h>
+
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "net.h"
+
+#define XDP_PKT_SIZE_MIN	64
+#define XDP_PKT_SIZE_MAX	1514
+#define ETH_HLEN		14
+
+static unsigned int pkt_size = XDP_PKT_SIZE_MIN;
+static unsigned int nr_packets = 1000000;
+static const char *action_str = "drop";
+
+static const struct option options[] = {
+	OPT_UINTEGER('m', "size", &pkt_size,	"Size of the packet, including the Ethernet header"),
+	OPT_UINTEGER('n', "packets", &nr_packets, "Number of program runs per run"),
+	OPT_STRING('a', "action", &action_str, "drop|pass|tx", "Verdict of the program"),
+	OPT_END()
+};
+
+static const char * const bench_net_xdp_usage[] = {
+	"perf bench net xdp <options>",
+	NULL
+};
+
+static int load_prog(int action)
+{
+	struct bpf_insn insns[] = {
+		BPF_LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_1,
+			    offsetof(struct xdp_md, data)),
+		BPF_LDX_MEM(BPF_W, BPF_REG_3, BPF_REG_1,
+			    offsetof(struct xdp_md, data_end)),
+		BPF_MOV64_REG(BPF_REG_4, BPF_REG_2),
+		BPF_ALU64_IMM(BPF_ADD, BPF_REG_4, ETH_HLEN),
+		BPF_JMP_REG(BPF_JGT, BPF_REG_4, BPF_REG_3, 2),
+		BPF_MOV64_IMM(BPF_REG_0, action),
+		BPF_EXIT_INSN(),
+		BPF_MOV64_IMM(BPF_REG_0, XDP_ABORTED),
+		BPF_EXIT_INSN(),
+	};
+
+	return bpf_load_program(BPF_PROG_TYPE_XDP, insns, ARRAY_SIZE(insns),
+				"GPL", 0, NULL, 0);
+}
+
+int bench_net_xdp(int argc, const char **argv)
+{
+	struct bench_metric metrics[] = {
+		{ .name = "packets", .unit = "pkts/sec" },
+		{ .name = "latency", .unit = "nsecs/pkt" },
+		{ .name = "cycles", .unit = "cycles/pkt" },
+	};
+	char s_size[16], s_packets[16];
+	struct bench_param params[] = {
+		{ "action",	NULL },
+		{ "size",	s_size },
+		{ "packets",	s_packets },
+		{ "cycles",	NULL },
+	};
+	char pkt[XDP_PKT_SIZE_MAX];
+	struct bench_cycles cycles;
+	__u32 retval, duration;
+	int action, fd, ret;
+	unsigned int i, r;
+	u64 c;
+
+	argc = parse_options(argc, argv, options, bench_net_xdp_usage, 0);
+	if (argc)
+		usage_with_options(bench_net_xdp_usage, options);
+
+	if (!strcmp(action_str, "drop"))
+		action = XDP_DROP;
+	else if (!strcmp(action_str, "pass"))
+		action = XDP_PASS;
+	else if (!strcmp(action_str, "tx"))
+		action = XDP_TX;
+	else
+		usage_with_options(bench_net_xdp_usage, options);
+
+	if (pkt_size < XDP_PKT_SIZE_MIN || pkt_size > XDP_PKT_SIZE_MAX ||
+	    !nr_packets) {
+		fprintf(stderr, "Invalid size or packets\n");
+		return 1;
+	}
+
+	fd = load_prog(action);
+	if (fd < 0) {
+		fprintf(stderr, "Loading the XDP program: %s\n", strerror(errno));
+		return 1;
+	}
+
+	/* broadcast to an IPv4 ethertype, the program only looks at the size */
+	memset(pkt, 0, sizeof(pkt));
+	memset(pkt, 0xff, 6);
+	pkt[12] = 0x08;
+
+	ret = bench_cycles_open(&cycles);
+	if (ret)
+		fprintf(stderr, "Not counting cycles: %s\n", strerror(-ret));
+	ret = 1;
+
+	for (i = 0; i < ARRAY_SIZE(metrics); i++)
+		init_stats(&metrics[i].stats);
+
+	for (r = 0; r < bench_repeat; r++) {
+		bench_cycles_start(&cycles);
+		if (bpf_prog_test_run(fd, nr_packets, pkt, pkt_size, NULL, NULL,
+				      &retval, &duration)) {
+			fprintf(stderr, "BPF_PROG_TEST_RUN: %s\n", strerror(errno));
+			goto out;
+		}
+		c = bench_cycles_stop(&cycles);
+
+		if (retval != (__u32)action) {
+			fprintf(stderr, "Unexpected verdict %u\n", retval);
+			goto out;
+		}
+
+		/* duration is the mean time of a single program run */
+		update_stats(&metrics[0].stats, duration ? 1e9 / duration : 0);
+		update_stats(&metrics[1].stats, duration);
+		if (c)
+			update_stats(&metrics[2].stats, c / nr_packets);
+	}
+
+	params[0].value = action_str;
+	scnprintf(s_size, sizeof(s_size), "%u", pkt_size);
+	scnprintf(s_packets, sizeof(s_packets), "%u", nr_packets);
+	params[3].value = bench_cycles_scope(&cycles);
+
+	bench_print_results("net/xdp", params, ARRAY_SIZE(params),
+			    metrics, ARRAY_SIZE(metrics));
+	ret = 0;
+out:
+	bench_cycles_close(&cycles);
+	close(fd);
+	return ret;
+}
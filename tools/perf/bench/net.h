@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Glue shared by the 'perf bench net' benchmarks.
+ */
+#ifndef _BENCH_NET_H
+#define _BENCH_NET_H
+
+#include <stdbool.h>
+#include <linux/types.h>
+#include "results.h"
+
+/*
+ * CPU cycles spent while a benchmark runs.  System wide if the
+ * perf_event_paranoid setting allows it, so that softirq processing on
+ * other CPUs is included; otherwise only the benchmark process and the
+ * threads it creates after bench_cycles_open().
+ */
+struct bench_cycles {
+	int		*fds;
+	int		nr;
+	bool		system_wide;
+};
+
+int bench_cycles_open(struct bench_cycles *cycles);
+void bench_cycles_close(struct bench_cycles *cycles);
+void bench_cycles_start(struct bench_cycles *cycles);
+/* cycles since bench_cycles_start(), scaled for multiplexing; 0 if none */
+u64 bench_cycles_stop(struct bench_cycles *cycles);
+/* "system-wide", "process" or "none", for the parameters of a run */
+const char *bench_cycles_scope(struct bench_cycles *cycles);
+
+/* loopback sockets, bound to an ephemeral port unless *port is set */
+int bench_net_listen(int type, u16 *port, bool reuseport);
+int bench_net_connect(int type, u16 port);
+
+#endif /* _BENCH_NET_H */
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * results.c
+ *
+ * Summary of benchmark metrics over bench_repeat runs, printed in the
+ * default, simple or json format; json prints one object per benchmark
+ * so that runs can be compared by scripts.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench.h"
+#include "results.h"
+
+u64 bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void print_default(const char *bench,
+			  const struct bench_param *params, int nr_params,
+			  struct bench_metric *metrics, int nr_metrics)
+{
+	double avg, stddev;
+	int i;
+
+	printf("# %s, %u run%s:", bench, bench_repeat,
+	       bench_repeat > 1 ? "s" : "");
+	for (i = 0; i < nr_params; i++)
+		printf(" %s=%s", params[i].name, params[i].value);
+	printf("\n\n");
+
+	for (i = 0; i < nr_metrics; i++) {
+		if (!metrics[i].stats.n) {
+			printf(" %20s: skipped\n", metrics[i].name);
+			continue;
+		}
+
+		avg = avg_stats(&metrics[i].stats);
+		stddev = stddev_stats(&metrics[i].stats);
+		printf(" %20s: %'16.0f %s ( +- %5.2f%% )\n",
+		       metrics[i].name, avg, metrics[i].unit,
+		       rel_stddev_stats(stddev, avg));
+	}
+}
+
+static void print_json(const char *bench,
+		       const struct bench_param *params, int nr_params,
+		       struct bench_metric *metrics, int nr_metrics)
+{
+	struct stats *stats;
+	int i;
+
+	printf("{\"benchmark\": \"%s\", \"runs\": %u, \"params\": {",
+	       bench, bench_repeat);
+	for (i = 0; i < nr_params; i++)
+		printf("%s\"%s\": \"%s\"", i ? ", " : "",
+		       params[i].name, params[i].value);
+	printf("}, \"results\": {");
+	for (i = 0; i < nr_metrics; i++) {
+		stats = &metrics[i].stats;
+
+		printf("%s\"%s\": ", i ? ", " : "", metrics[i].name);
+		if (!stats->n) {
+			printf("null");
+			continue;
+		}
+		printf("{\"unit\": \"%s\", \"mean\": %.0f, \"stddev\": %.0f, "
+		       "\"min\": %llu, \"max\": %llu}",
+		       metrics[i].unit, avg_stats(stats), stddev_stats(stats),
+		       (unsigned long long)stats->min,
+		       (unsigned long long)stats->max);
+	}
+	printf("}}\n");
+}
+
+void bench_print_results(const char *bench,
+			 const struct bench_param *params, int nr_params,
+			 struct bench_metric *metrics, int nr_metrics)
+{
+	int i;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		print_default(bench, params, nr_params, metrics, nr_metrics);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		for (i = 0; i < nr_metrics; i++)
+			printf("%s%.0f", i ? " " : "",
+			       metrics[i].stats.n ? avg_stats(&metrics[i].stats) : 0);
+		printf("\n");
+		break;
+
+	case BENCH_FORMAT_JSON:
+		print_json(bench, params, nr_params, metrics, nr_metrics);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+	}
+}
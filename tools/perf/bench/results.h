@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _BENCH_RESULTS_H
+#define _BENCH_RESULTS_H
+
+#include <linux/types.h>
+#include "../util/stat.h"
+
+/* one value per run, summarized over all bench_repeat runs */
+struct bench_metric {
+	const char	*name;
+	const char	*unit;
+	struct stats	stats;
+};
+
+/* a parameter of the run, echoed with the results */
+struct bench_param {
+	const char	*name;
+	const char	*value;
+};
+
+u64 bench_now_ns(void);
+
+void bench_print_results(const char *bench,
+			 const struct bench_param *params, int nr_params,
+			 struct bench_metric *metrics, int nr_metrics);
+
+#endif /* _BENCH_RESULTS_H */
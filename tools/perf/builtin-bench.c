@@ -16,6 +16,8 @@
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
  *  epoll ... Event poll performance
+ *  io    ... io_uring, read and page fault performance
+ *  net   ... Network stack performance
  */
 #include <subcmd/parse-options.h>
 #include "builtin.h"
@@ -84,6 +86,26 @@ static struct bench epoll_benchmarks[] = {
 };
 #endif // HAVE_EVENTFD_SUPPORT
 
+static struct bench io_benchmarks[] = {
+	{ "uring",	"Benchmark io_uring submission and completion",	bench_io_uring		},
+	{ "read",	"Benchmark buffered and direct read throughput",	bench_io_read		},
+	{ "fault",	"Benchmark page fault rate",			bench_io_fault		},
+	{ "mmap",	"Benchmark concurrent mmap/munmap",		bench_io_mmap		},
+	{ "all",	"Run all io benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench net_benchmarks[] = {
+	{ "tcp-rr",	"Benchmark loopback TCP request/response",	bench_net_tcp_rr	},
+	{ "tcp-stream",	"Benchmark loopback TCP bulk transfer",		bench_net_tcp_stream	},
+	{ "udp",	"Benchmark loopback UDP with SO_REUSEPORT receivers", bench_net_udp	},
+#ifdef HAVE_LIBBPF_SUPPORT
+	{ "xdp",	"Benchmark XDP program runs",			bench_net_xdp		},
+#endif
+	{ "all",	"Run all net benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
 static struct bench internals_benchmarks[] = {
 	{ "synthesize", "Benchmark perf event synthesis",	bench_synthesize	},
 	{ "kallsyms-parse", "Benchmark kallsyms parsing",	bench_kallsyms_parse	},
@@ -108,6 +130,8 @@ static struct collection collections[] = {
 #ifdef HAVE_EVENTFD_SUPPORT
 	{"epoll",       "Epoll stressing benchmarks",                   epoll_benchmarks        },
 #endif
+	{ "io",		"Storage and page cache benchmarks",		io_benchmarks		},
+	{ "net",	"Network stack benchmarks",			net_benchmarks		},
 	{ "internals",	"Perf-internals benchmarks",			internals_benchmarks	},
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
@@ -140,7 +164,7 @@ int bench_format = BENCH_FORMAT_DEFAULT;
 unsigned int bench_repeat = 10; /* default number of times to repeat the run */
 
 static const struct option bench_options[] = {
-	OPT_STRING('f', "format", &bench_format_str, "default|simple", "Specify the output formatting style"),
+	OPT_STRING('f', "format", &bench_format_str, "default|simple|json", "Specify the output formatting style"),
 	OPT_UINTEGER('r', "repeat",  &bench_repeat,   "Specify amount of times to repeat the run"),
 	OPT_END()
 };
@@ -176,6 +200,8 @@ static int bench_str2int(const char *str)
 		return BENCH_FORMAT_DEFAULT;
 	else if (!strcmp(str, BENCH_FORMAT_SIMPLE_STR))
 		return BENCH_FORMAT_SIMPLE;
+	else if (!strcmp(str, BENCH_FORMAT_JSON_STR))
+		return BENCH_FORMAT_JSON;
 
 	return BENCH_FORMAT_UNKNOWN;
 }
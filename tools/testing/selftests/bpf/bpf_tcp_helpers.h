@@ -127,6 +127,15 @@ struct ack_sample {
 	__u32 in_flight;
 } __attribute__((preserve_access_index));
 
+struct tcp_ack_batch {
+	__u32 acks;
+	__u32 ack;
+	__u32 pkts_acked;
+	__u32 acked_sacked;
+	__s32 rtt_us;
+	__u32 in_flight;
+} __attribute__((preserve_access_index));
+
 struct rate_sample {
 	__u64  prior_mstamp; /* starting timestamp for interval */
 	__u32  prior_delivered;	/* tp->delivered at "prior_mstamp" */
@@ -177,6 +186,10 @@ struct tcp_congestion_ops {
 	 * after all the ca_state processing. (optional)
 	 */
 	void (*cong_control)(struct sock *sk, const struct rate_sample *rs);
+	/* replaces pkts_acked and cong_avoid with one call per batch of
+	 * ACKs (optional)
+	 */
+	void (*ack_batch)(struct sock *sk, const struct tcp_ack_batch *batch);
 	void *owner;
 };
 
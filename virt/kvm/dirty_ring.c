@@ -36,10 +36,19 @@ static bool kvm_dirty_ring_full(struct kvm_dirty_ring *ring)
 	return kvm_dirty_ring_used(ring) >= ring->size;
 }
 
+/*
+ * Returns NULL if the page was not dirtied on behalf of a vcpu, it then has
+ * to be logged in the memslot's dirty bitmap.
+ */
 struct kvm_dirty_ring *kvm_dirty_ring_get(struct kvm *kvm)
 {
 	struct kvm_vcpu *vcpu = kvm_get_running_vcpu();
 
+	if (!vcpu) {
+		WARN_ON_ONCE(!kvm->dirty_ring_with_bitmap);
+		return NULL;
+	}
+
 	WARN_ON_ONCE(vcpu->kvm != kvm);
 
 	return &vcpu->dirty_ring;
@@ -77,6 +86,7 @@ int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, int index, u32 size)
 	ring->dirty_index = 0;
 	ring->reset_index = 0;
 	ring->index = index;
+	mutex_init(&ring->reset_lock);
 
 	return 0;
 }
@@ -113,6 +123,8 @@ int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
 	/* This is only needed to make compilers happy */
 	cur_slot = cur_offset = mask = 0;
 
+	mutex_lock(&ring->reset_lock);
+
 	while (true) {
 		entry = &ring->dirty_gfns[ring->reset_index & (ring->size - 1)];
 
@@ -125,7 +137,11 @@ int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
 		/* Update the flags to reflect that this GFN is reset */
 		kvm_dirty_gfn_set_invalid(entry);
 
-		ring->reset_index++;
+		/*
+		 * The vcpu may reuse the entry as soon as it sees the new
+		 * reset_index, so be done reading it first.
+		 */
+		smp_store_release(&ring->reset_index, ring->reset_index + 1);
 		count++;
 		/*
 		 * Try to coalesce the reset operations when the guest is
@@ -154,19 +170,27 @@ int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
 		first_round = false;
 	}
 
-	kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
+	if (count)
+		kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
 
 	trace_kvm_dirty_ring_reset(ring);
 
+	mutex_unlock(&ring->reset_lock);
+
 	return count;
 }
 
-void kvm_dirty_ring_push(struct kvm_dirty_ring *ring, u32 slot, u64 offset)
+bool kvm_dirty_ring_push(struct kvm_dirty_ring *ring, u32 slot, u64 offset)
 {
 	struct kvm_dirty_gfn *entry;
 
-	/* It should never get full */
-	WARN_ON_ONCE(kvm_dirty_ring_full(ring));
+	/*
+	 * The vcpu exits to userspace once the ring is soft full, so this
+	 * only happens if a single exit dirties more than the reserved
+	 * entries.
+	 */
+	if (kvm_dirty_ring_full(ring))
+		return false;
 
 	entry = &ring->dirty_gfns[ring->dirty_index & (ring->size - 1)];
 
@@ -180,6 +204,8 @@ void kvm_dirty_ring_push(struct kvm_dirty_ring *ring, u32 slot, u64 offset)
 	kvm_dirty_gfn_set_dirtied(entry);
 	ring->dirty_index++;
 	trace_kvm_dirty_ring_push(ring, slot, offset);
+
+	return true;
 }
 
 struct page *kvm_dirty_ring_get_page(struct kvm_dirty_ring *ring, u32 offset)
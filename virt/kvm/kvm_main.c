@@ -1522,7 +1522,8 @@ int __kvm_set_memory_region(struct kvm *kvm,
 	/* Allocate/free page dirty bitmap as needed */
 	if (!(new.flags & KVM_MEM_LOG_DIRTY_PAGES))
 		new.dirty_bitmap = NULL;
-	else if (!new.dirty_bitmap && !kvm->dirty_ring_size) {
+	else if (!new.dirty_bitmap &&
+		 (!kvm->dirty_ring_size || kvm->dirty_ring_with_bitmap)) {
 		r = kvm_alloc_dirty_bitmap(&new);
 		if (r)
 			return r;
@@ -1584,7 +1585,7 @@ int kvm_get_dirty_log(struct kvm *kvm, struct kvm_dirty_log *log,
 	unsigned long any = 0;
 
 	/* Dirty ring tracking is exclusive to dirty log tracking */
-	if (kvm->dirty_ring_size)
+	if (kvm->dirty_ring_size && !kvm->dirty_ring_with_bitmap)
 		return -ENXIO;
 
 	*memslot = NULL;
@@ -1649,7 +1650,7 @@ static int kvm_get_dirty_log_protect(struct kvm *kvm, struct kvm_dirty_log *log)
 	bool flush;
 
 	/* Dirty ring tracking is exclusive to dirty log tracking */
-	if (kvm->dirty_ring_size)
+	if (kvm->dirty_ring_size && !kvm->dirty_ring_with_bitmap)
 		return -ENXIO;
 
 	as_id = log->slot >> 16;
@@ -1761,7 +1762,7 @@ static int kvm_clear_dirty_log_protect(struct kvm *kvm,
 	bool flush;
 
 	/* Dirty ring tracking is exclusive to dirty log tracking */
-	if (kvm->dirty_ring_size)
+	if (kvm->dirty_ring_size && !kvm->dirty_ring_with_bitmap)
 		return -ENXIO;
 
 	as_id = log->slot >> 16;
@@ -2845,11 +2846,21 @@ void mark_page_dirty_in_slot(struct kvm *kvm,
 		unsigned long rel_gfn = gfn - memslot->base_gfn;
 		u32 slot = (memslot->as_id << 16) | memslot->id;
 
-		if (kvm->dirty_ring_size)
-			kvm_dirty_ring_push(kvm_dirty_ring_get(kvm),
-					    slot, rel_gfn);
-		else
-			set_bit_le(rel_gfn, memslot->dirty_bitmap);
+		if (kvm->dirty_ring_size) {
+			struct kvm_dirty_ring *ring = kvm_dirty_ring_get(kvm);
+
+			if (ring && kvm_dirty_ring_push(ring, slot, rel_gfn))
+				return;
+
+			/*
+			 * Pages dirtied outside of a vcpu, or that do not fit
+			 * the ring, go to the bitmap if userspace has one.
+			 */
+			if (WARN_ON_ONCE(!memslot->dirty_bitmap))
+				return;
+		}
+
+		set_bit_le(rel_gfn, memslot->dirty_bitmap);
 	}
 }
 EXPORT_SYMBOL_GPL(mark_page_dirty_in_slot);
@@ -3426,6 +3437,28 @@ static int kvm_vcpu_ioctl_set_sigmask(struct kvm_vcpu *vcpu, sigset_t *sigset)
 	return 0;
 }
 
+/*
+ * Reset the dirty ring of a single vcpu, which userspace can do for each
+ * vcpu as soon as it has harvested that vcpu's ring.
+ */
+static int kvm_vcpu_reset_dirty_ring(struct kvm_vcpu *vcpu, unsigned long arg)
+{
+	struct kvm *kvm = vcpu->kvm;
+	int cleared, idx;
+
+	if (!kvm->dirty_ring_size || arg)
+		return -EINVAL;
+
+	idx = srcu_read_lock(&kvm->srcu);
+	cleared = kvm_dirty_ring_reset(kvm, &vcpu->dirty_ring);
+	srcu_read_unlock(&kvm->srcu, idx);
+
+	if (cleared)
+		kvm_flush_remote_tlbs(kvm);
+
+	return cleared;
+}
+
 static long kvm_vcpu_ioctl(struct file *filp,
 			   unsigned int ioctl, unsigned long arg)
 {
@@ -3449,6 +3482,10 @@ static long kvm_vcpu_ioctl(struct file *filp,
 	if (r != -ENOIOCTLCMD)
 		return r;
 
+	/* The ring has its own lock, no need to kick the vcpu out of KVM_RUN */
+	if (ioctl == KVM_RESET_DIRTY_RING)
+		return kvm_vcpu_reset_dirty_ring(vcpu, arg);
+
 	if (mutex_lock_killable(&vcpu->mutex))
 		return -EINTR;
 	switch (ioctl) {
@@ -3881,6 +3918,8 @@ static long kvm_vm_ioctl_check_extension_generic(struct kvm *kvm, long arg)
 #else
 		return 0;
 #endif
+	case KVM_CAP_DIRTY_LOG_RING_WITH_BITMAP:
+		return KVM_DIRTY_LOG_PAGE_OFFSET > 0;
 	default:
 		break;
 	}
@@ -3925,21 +3964,59 @@ static int kvm_vm_ioctl_enable_dirty_log_ring(struct kvm *kvm, u32 size)
 	return r;
 }
 
+/*
+ * Back the dirty rings with the memslots' dirty bitmaps.  Pages dirtied
+ * without a running vcpu, or while its ring is full, are logged there and
+ * collected with KVM_GET_DIRTY_LOG, which also write-protects them again.
+ */
+static int kvm_vm_ioctl_enable_dirty_log_ring_bitmap(struct kvm *kvm,
+						     struct kvm_enable_cap *cap)
+{
+	struct kvm_memslots *slots;
+	struct kvm_memory_slot *memslot;
+	int i, r = 0;
+
+	if (!KVM_DIRTY_LOG_PAGE_OFFSET || !kvm->dirty_ring_size ||
+	    cap->flags || cap->args[0])
+		return -EINVAL;
+
+	mutex_lock(&kvm->slots_lock);
+
+	/* Memslots already logging dirty pages have no bitmap to fall back to */
+	for (i = 0; i < KVM_ADDRESS_SPACE_NUM; i++) {
+		slots = __kvm_memslots(kvm, i);
+		kvm_for_each_memslot(memslot, slots) {
+			if (memslot->flags & KVM_MEM_LOG_DIRTY_PAGES)
+				r = -EBUSY;
+		}
+	}
+
+	if (!r)
+		kvm->dirty_ring_with_bitmap = true;
+
+	mutex_unlock(&kvm->slots_lock);
+	return r;
+}
+
 static int kvm_vm_ioctl_reset_dirty_pages(struct kvm *kvm)
 {
-	int i;
+	int i, idx;
 	struct kvm_vcpu *vcpu;
 	int cleared = 0;
 
 	if (!kvm->dirty_ring_size)
 		return -EINVAL;
 
-	mutex_lock(&kvm->slots_lock);
+	/*
+	 * Each ring is protected by its own lock, SRCU keeps the memslots
+	 * stable without serializing against memslot updates.
+	 */
+	idx = srcu_read_lock(&kvm->srcu);
 
 	kvm_for_each_vcpu(i, vcpu, kvm)
 		cleared += kvm_dirty_ring_reset(vcpu->kvm, &vcpu->dirty_ring);
 
-	mutex_unlock(&kvm->slots_lock);
+	srcu_read_unlock(&kvm->srcu, idx);
 
 	if (cleared)
 		kvm_flush_remote_tlbs(kvm);
@@ -3979,6 +4056,8 @@ static int kvm_vm_ioctl_enable_cap_generic(struct kvm *kvm,
 	}
 	case KVM_CAP_DIRTY_LOG_RING:
 		return kvm_vm_ioctl_enable_dirty_log_ring(kvm, cap->args[0]);
+	case KVM_CAP_DIRTY_LOG_RING_WITH_BITMAP:
+		return kvm_vm_ioctl_enable_dirty_log_ring_bitmap(kvm, cap);
 	default:
 		return kvm_vm_ioctl_enable_cap(kvm, cap);
 	}